@@ -17,10 +17,17 @@
 from __future__ import print_function
 
 import argparse
+import csv
 import glob
+import json
 import os.path
+import shutil
+import string
+import struct
 import subprocess
 import sys
+import tempfile
+import timeit
 
 SWIFTSHADER_SUPPRESSIONS = [
     'images/write_image2d_r32f.amber',
@@ -40,6 +47,301 @@ SWIFTSHADER_SUPPRESSIONS = [
     'integer/sub_sat_short.amber',
     'integer/sub_sat_ushort.amber']
 
+# The option sets the benchmarks are compiled with when no --option-set is
+# given.
+PERF_OPTION_SETS = [
+    ('default', []),
+    ('O0', ['-O0']),
+    ('cluster-pod-args', ['-cluster-pod-kernel-args']),
+]
+
+SPIRV_MAGIC = 0x07230203
+SPIRV_OP_FUNCTION = 54
+SPIRV_OP_FUNCTION_END = 56
+
+def count_instructions(binary):
+  """Returns the number of instructions in a SPIR-V binary, and the number of
+  those within function bodies."""
+  words = struct.unpack('<{}I'.format(len(binary) // 4), binary)
+  if not words or words[0] != SPIRV_MAGIC:
+    raise RuntimeError('Not a SPIR-V binary')
+  total = 0
+  in_functions = 0
+  in_function = False
+  i = 5
+  while i < len(words):
+    word_count = words[i] >> 16
+    opcode = words[i] & 0xffff
+    if word_count == 0:
+      raise RuntimeError('Malformed SPIR-V binary')
+    total += 1
+    if opcode == SPIRV_OP_FUNCTION:
+      in_function = True
+    if in_function:
+      in_functions += 1
+    if opcode == SPIRV_OP_FUNCTION_END:
+      in_function = False
+    i += word_count
+  return total, in_functions
+
+def kernel_source(template):
+  """Returns the OpenCL C source of the benchmark |template|."""
+  lines = template.splitlines()
+  for i, line in enumerate(lines):
+    if line.startswith('SHADER compute') and line.endswith('OPENCL-C'):
+      end = lines.index('END', i)
+      return '\n'.join(lines[i + 1:end]) + '\n'
+  raise RuntimeError('No OpenCL C shader in benchmark')
+
+def compile_options_block(template, options):
+  """Returns the COMPILE_OPTIONS block passing |options| to the shader of
+  |template|."""
+  if not options:
+    return ''
+  for line in template.splitlines():
+    if line.startswith('SHADER compute') and line.endswith('OPENCL-C'):
+      shader = line.split()[2]
+      body = ''.join('    {}\n'.format(option) for option in options)
+      return '  COMPILE_OPTIONS {}\n{}  END'.format(shader, body)
+  raise RuntimeError('No OpenCL C shader in benchmark')
+
+def time_amber(amber, script, tmp_dir):
+  """Runs the Amber |script| and returns the wall time it took."""
+  path = os.path.join(tmp_dir, 'benchmark.amber')
+  with open(path, 'w') as f:
+    f.write(script)
+  start = timeit.default_timer()
+  p = subprocess.Popen([amber, '-d', path], stdout=subprocess.PIPE)
+  (stdout, _) = p.communicate()
+  elapsed = timeit.default_timer() - start
+  if p.returncode != 0:
+    raise RuntimeError('Failed benchmark \'{}\''.format(
+        stdout.decode("utf-8")))
+  return elapsed
+
+def run_perf(args, option_sets):
+  """Runs every benchmark under every option set and reports the time per
+  dispatch and the instruction counts of the generated SPIR-V."""
+  tmp_dir = tempfile.mkdtemp()
+  results = []
+  try:
+    benchmarks = sorted(glob.glob(os.path.join(args.perf_dir, '*.amber.in')))
+    for benchmark in benchmarks:
+      name = os.path.basename(benchmark)[:-len('.amber.in')]
+      with open(benchmark) as f:
+        template = string.Template(f.read())
+      for set_name, options in option_sets:
+        result = {'benchmark': name, 'option_set': set_name,
+                  'options': options}
+        block = compile_options_block(template.template, options)
+        # The difference between the two runs leaves out Amber start-up and
+        # shader compilation.
+        once = time_amber(args.amber, template.substitute(
+            COMPILE_OPTIONS=block, REPEAT=1), tmp_dir)
+        repeated = time_amber(args.amber, template.substitute(
+            COMPILE_OPTIONS=block, REPEAT=args.iterations), tmp_dir)
+        result['dispatch_us'] = max(
+            0.0, (repeated - once) / (args.iterations - 1) * 1e6)
+
+        if args.clspv:
+          source = os.path.join(tmp_dir, name + '.cl')
+          binary = os.path.join(tmp_dir, name + '.spv')
+          with open(source, 'w') as f:
+            f.write(kernel_source(template.template))
+          subprocess.check_call([args.clspv] + options +
+                                [source, '-o', binary])
+          with open(binary, 'rb') as f:
+            total, in_functions = count_instructions(f.read())
+          result['instructions'] = total
+          result['function_instructions'] = in_functions
+
+        results.append(result)
+        print('{:<20} {:<20} {:>12.1f} us {:>8} {:>8}'.format(
+            name, set_name, result['dispatch_us'],
+            result.get('instructions', '-'),
+            result.get('function_instructions', '-')))
+  finally:
+    shutil.rmtree(tmp_dir)
+
+  if args.json:
+    with open(args.json, 'w') as f:
+      json.dump(results, f, indent=2)
+
+# Scalar integer types the builtin benchmarks are instantiated for, as
+# (OpenCL C type, Amber data type, unsigned OpenCL C type).
+BUILTIN_TYPES = [
+    ('char', 'int8', 'uchar'),
+    ('uchar', 'uint8', 'uchar'),
+    ('short', 'int16', 'ushort'),
+    ('ushort', 'uint16', 'ushort'),
+    ('int', 'int32', 'uint'),
+    ('uint', 'uint32', 'uint'),
+    ('long', 'int64', 'ulong'),
+    ('ulong', 'uint64', 'ulong'),
+]
+
+BUILTIN_VECTOR_SIZES = [1, 2, 3, 4]
+
+UPSAMPLE_TYPES = {
+    'char': 'short', 'uchar': 'ushort',
+    'short': 'int', 'ushort': 'uint',
+    'int': 'long', 'uint': 'ulong',
+}
+
+def unsigned_type(scalar):
+  return [t for t in BUILTIN_TYPES if t[0] == scalar][0][2]
+
+# The integer builtins lowered by ReplaceOpenCLBuiltinPass, as (name, number of
+# arguments, function returning the scalar result type for a scalar argument
+# type or None if the builtin is not defined for it, function returning the
+# scalar type of each argument).
+BUILTINS = [
+    ('abs', 1, unsigned_type, None),
+    ('abs_diff', 2, unsigned_type, None),
+    ('add_sat', 2, lambda t: t, None),
+    ('sub_sat', 2, lambda t: t, None),
+    ('hadd', 2, lambda t: t, None),
+    ('rhadd', 2, lambda t: t, None),
+    ('mad_sat', 3, lambda t: t, None),
+    ('mul_hi', 2, lambda t: t, None),
+    ('mad_hi', 3, lambda t: t, None),
+    ('clz', 1, lambda t: t, None),
+    ('ctz', 1, lambda t: t, None),
+    ('popcount', 1, lambda t: t, None),
+    ('rotate', 2, lambda t: t, None),
+    ('upsample', 2, UPSAMPLE_TYPES.get,
+     lambda t: [t, unsigned_type(t)]),
+]
+
+BUILTIN_ARG_NAMES = ['a', 'b', 'c']
+
+def vector_type(scalar, size):
+  return scalar if size == 1 else '{}{}'.format(scalar, size)
+
+def builtin_kernel(name, arity, result, arg_types, size):
+  """Returns the OpenCL C source of a kernel applying the builtin |name| to
+  |arity| vectors of |size| elements loaded from buffers of |arg_types|, or
+  copying the first argument to the output when |name| is None."""
+  params = ['global {} *out'.format(result)]
+  params += ['global const {} *{}'.format(arg_types[i], BUILTIN_ARG_NAMES[i])
+             for i in range(arity)]
+  src = 'kernel void __attribute__((reqd_work_group_size(64, 1, 1)))\n'
+  src += 'bench({}) {{\n'.format(', '.join(params))
+  src += '  size_t i = get_global_id(0);\n'
+  args = []
+  for i in range(arity):
+    arg = BUILTIN_ARG_NAMES[i]
+    if size == 1:
+      args.append('{}[i]'.format(arg))
+    else:
+      args.append('vload{}(i, {})'.format(size, arg))
+  if name:
+    value = '{}({})'.format(name, ', '.join(args))
+  else:
+    value = 'convert_{}({})'.format(vector_type(result, size), args[0])
+  if size == 1:
+    src += '  out[i] = {};\n'.format(value)
+  else:
+    src += '  vstore{}({}, i, out);\n'.format(size, value)
+  src += '}\n'
+  return src
+
+def amber_type(scalar):
+  return [t for t in BUILTIN_TYPES if t[0] == scalar][0][1]
+
+def builtin_script(source, result, arg_types, size, count):
+  """Returns an Amber script template running the kernel |source| over
+  |count| vectors of |size| elements."""
+  elements = count * size
+  script = '#!amber\n\nSHADER compute bench OPENCL-C\n{}END\n\n'.format(
+      source)
+  script += 'BUFFER out DATA_TYPE {} SIZE {} FILL 0\n'.format(
+      amber_type(result), elements)
+  for i, arg_type in enumerate(arg_types):
+    script += 'BUFFER {} DATA_TYPE {} SIZE {} SERIES_FROM {} INC_BY 1\n'.format(
+        BUILTIN_ARG_NAMES[i], amber_type(arg_type), elements, i + 1)
+  script += '\nPIPELINE compute pipe\n  ATTACH bench ENTRY_POINT bench\n'
+  script += '  BIND BUFFER out KERNEL ARG_NAME out\n'
+  for i in range(len(arg_types)):
+    script += '  BIND BUFFER {0} KERNEL ARG_NAME {0}\n'.format(
+        BUILTIN_ARG_NAMES[i])
+  script += '${COMPILE_OPTIONS}\nEND\n\n'
+  script += 'REPEAT ${{REPEAT}}\n  RUN pipe {} 1 1\nEND\n'.format(count // 64)
+  return script
+
+def compile_and_count(clspv, options, source, tmp_dir):
+  """Compiles the OpenCL C |source| with |options| and returns the instruction
+  counts of the generated SPIR-V."""
+  source_path = os.path.join(tmp_dir, 'builtin.cl')
+  binary_path = os.path.join(tmp_dir, 'builtin.spv')
+  with open(source_path, 'w') as f:
+    f.write(source)
+  subprocess.check_call([clspv] + options + [source_path, '-o', binary_path])
+  with open(binary_path, 'rb') as f:
+    return count_instructions(f.read())
+
+def run_builtins(args, options):
+  """Compiles every lowered integer builtin for every scalar and vector type and
+  reports the instruction counts of the generated SPIR-V and, with --amber, the
+  time per dispatch."""
+  tmp_dir = tempfile.mkdtemp()
+  results = []
+  selected = args.builtins.split(',') if args.builtins != 'all' else None
+  try:
+    for name, arity, result_type, arg_types_of in BUILTINS:
+      if selected and name not in selected:
+        continue
+      for scalar, _, _ in BUILTIN_TYPES:
+        result = result_type(scalar)
+        if result is None:
+          continue
+        arg_types = (arg_types_of(scalar) if arg_types_of
+                     else [scalar] * arity)
+        for size in BUILTIN_VECTOR_SIZES:
+          source = builtin_kernel(name, arity, result, arg_types, size)
+          # The same kernel without the builtin measures the instructions
+          # needed to load and store the values.
+          baseline = builtin_kernel(None, arity, result, arg_types, size)
+          total, in_functions = compile_and_count(args.clspv, options, source,
+                                                  tmp_dir)
+          _, baseline_functions = compile_and_count(args.clspv, options,
+                                                    baseline, tmp_dir)
+          entry = {'builtin': name, 'type': vector_type(scalar, size),
+                   'instructions': total,
+                   'function_instructions': in_functions,
+                   'lowering_instructions': in_functions - baseline_functions}
+
+          if args.amber:
+            template = string.Template(builtin_script(
+                source, result, arg_types, size, args.builtin_count))
+            block = compile_options_block(template.template, options)
+            once = time_amber(args.amber, template.substitute(
+                COMPILE_OPTIONS=block, REPEAT=1), tmp_dir)
+            repeated = time_amber(args.amber, template.substitute(
+                COMPILE_OPTIONS=block, REPEAT=args.iterations), tmp_dir)
+            entry['dispatch_us'] = max(
+                0.0, (repeated - once) / (args.iterations - 1) * 1e6)
+
+          results.append(entry)
+          print('{:<10} {:<8} {:>8} {:>8} {:>8} {:>12}'.format(
+              name, entry['type'], total, in_functions,
+              entry['lowering_instructions'],
+              '{:.1f} us'.format(entry['dispatch_us'])
+              if 'dispatch_us' in entry else '-'))
+  finally:
+    shutil.rmtree(tmp_dir)
+
+  if args.json:
+    with open(args.json, 'w') as f:
+      json.dump(results, f, indent=2)
+  if args.csv:
+    fields = ['builtin', 'type', 'instructions', 'function_instructions',
+              'lowering_instructions', 'dispatch_us']
+    with open(args.csv, 'w') as f:
+      writer = csv.DictWriter(f, fieldnames=fields)
+      writer.writeheader()
+      writer.writerows(results)
+
 def main():
   parser = argparse.ArgumentParser("Run Amber tests (without validation layers)")
   parser.add_argument('--dir', dest='test_dir', default='.',
@@ -48,9 +350,65 @@ def main():
                       help='Specify the path to the amber executable')
   parser.add_argument('--swiftshader', dest='swiftshader', action='store_true',
                       help='Only run tests compatible with Swiftshader')
+  parser.add_argument('--perf', dest='perf', action='store_true',
+                      help='Time the benchmarks instead of running the tests')
+  parser.add_argument('--perf-dir', dest='perf_dir',
+                      help='Specify the directory of the benchmarks '
+                           '(default: <dir>/perf)')
+  parser.add_argument('--clspv', dest='clspv',
+                      help='Specify the path to the clspv executable, used '
+                           'to count the instructions of each benchmark')
+  parser.add_argument('--iterations', dest='iterations', type=int,
+                      default=100,
+                      help='Number of dispatches timed per benchmark')
+  parser.add_argument('--option-set', dest='option_sets', action='append',
+                      metavar='NAME=OPTIONS',
+                      help='Compile the benchmarks with the given clspv '
+                           'options; may be repeated')
+  parser.add_argument('--json', dest='json',
+                      help='Also write the benchmark results to the given '
+                           'file as JSON')
+  parser.add_argument('--builtins', dest='builtins', nargs='?', const='all',
+                      metavar='NAME,...',
+                      help='Measure the lowering of the integer builtins '
+                           '(all of them, or a comma separated list) instead '
+                           'of running the tests')
+  parser.add_argument('--builtin-count', dest='builtin_count', type=int,
+                      default=65536,
+                      help='Number of vectors each builtin benchmark '
+                           'dispatch processes')
+  parser.add_argument('--builtin-options', dest='builtin_options', default='',
+                      help='clspv options the builtins are compiled with')
+  parser.add_argument('--csv', dest='csv',
+                      help='Also write the builtin results to the given file '
+                           'as CSV')
 
   args = parser.parse_args()
 
+  if args.builtins:
+    if not args.clspv:
+      parser.error('--builtins requires --clspv')
+    if args.amber and args.iterations < 2:
+      parser.error('--iterations must be at least 2')
+    if args.builtin_count % 64:
+      parser.error('--builtin-count must be a multiple of 64')
+    run_builtins(args, args.builtin_options.split())
+    sys.exit(0)
+
+  if args.perf:
+    if args.iterations < 2:
+      parser.error('--iterations must be at least 2')
+    if not args.perf_dir:
+      args.perf_dir = os.path.join(args.test_dir, 'perf')
+    option_sets = PERF_OPTION_SETS
+    if args.option_sets:
+      option_sets = []
+      for option_set in args.option_sets:
+        (name, _, options) = option_set.partition('=')
+        option_sets.append((name, options.split()))
+    run_perf(args, option_sets)
+    sys.exit(0)
+
   tests = glob.glob(os.path.join(args.test_dir, "**/*.amber"))
   if args.swiftshader:
     for suppress in SWIFTSHADER_SUPPRESSIONS:
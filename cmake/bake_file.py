@@ -25,6 +25,8 @@ def main():
             type=str, required=True, help='input OpenCL C header file')
     parser.add_argument('--input-base-file', metavar='<path>',
             type=str, required=True, help='input base OpenCL C header file')
+    parser.add_argument('--input-extra-file', metavar='<path>',
+            type=str, required=True, help='input extra builtins header file')
     parser.add_argument('--output-file', metavar='<path>',
             type=str, required=True, help='output file')
     parser.add_argument('--header-var', type=str, required=True,
@@ -35,6 +37,10 @@ def main():
             help='Base header variable name')
     parser.add_argument('--base-size-var', type=str, required=True,
             help='Base header size variable name')
+    parser.add_argument('--extra-var', type=str, required=True,
+            help='Extra builtins header variable name')
+    parser.add_argument('--extra-size-var', type=str, required=True,
+            help='Extra builtins header size variable name')
 
     args = parser.parse_args()
 
@@ -90,6 +96,20 @@ def main():
                 byte = input.read(1)
         output.write("  '\\0'\n};\n\n")
 
+        # Write the contents of the array for the extra builtins header.
+        extra_size = os.stat(args.input_extra_file).st_size + 1
+        output.write("static const unsigned int %s = %d;\n"
+                % (args.extra_size_var, extra_size))
+        output.write("static const char %s[%s] = {\n"
+                % (args.extra_var, args.extra_size_var))
+        with open(args.input_extra_file, "rb") as input:
+            byte = input.read(1)
+            while byte != b"":
+                output.write("  '\\x%s',\n"
+                        % binascii.hexlify(byte).decode('utf-8'))
+                byte = input.read(1)
+        output.write("  '\\0'\n};\n\n")
+
         output.write("\n\n")
         output.write("#ifdef __cplusplus\n")
         output.write("}\n")
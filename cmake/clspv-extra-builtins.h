@@ -0,0 +1,34 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The builtins clspv declares on top of Clang's opencl-c.h.
+// strip_banned_opencl_features.py appends them to openclc.h, and
+// -fdeclare-opencl-builtins includes them as clspv-extra-builtins.h, since
+// Clang's builtin table does not know them.
+
+float4 __attribute((overloadable)) __clspv_vloada_half4(size_t, const __global uint2*);
+float4 __attribute((overloadable)) __clspv_vloada_half4(size_t, const __local uint2*);
+float4 __attribute((overloadable)) __clspv_vloada_half4(size_t, const __private uint2*);
+float2 __attribute((overloadable)) __clspv_vloada_half2(size_t, const __global uint*);
+float2 __attribute((overloadable)) __clspv_vloada_half2(size_t, const __local uint*);
+float2 __attribute((overloadable)) __clspv_vloada_half2(size_t, const __private uint*);
+
+// Define the OpenCL 2.0 work_group_barrier alias.
+#if !defined(__OPENCL_CPP_VERSION__) && (__OPENCL_C_VERSION__ < CL_VERSION_2_0)
+#define __ovld __attribute__((overloadable))
+#define __conv __attribute__((convergent))
+void __ovld __conv work_group_barrier(cl_mem_fence_flags flags);
+#undef __ovld
+#undef __conv
+#endif
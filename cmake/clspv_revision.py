@@ -0,0 +1,56 @@
+#!/usr/bin/env python
+# Copyright 2021 The Clspv Authors. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+import os.path
+import subprocess
+
+def describe(source_dir):
+    """Returns the git revision of |source_dir|, or 'unknown' outside of git."""
+    try:
+        output = subprocess.check_output(
+                ['git', 'describe', '--always', '--long', '--dirty'],
+                cwd=source_dir, stderr=subprocess.DEVNULL)
+        return output.decode('utf-8').strip()
+    except (OSError, subprocess.CalledProcessError):
+        return 'unknown'
+
+def main():
+    import argparse
+    parser = argparse.ArgumentParser(
+            description='Generate the clspv revision header')
+
+    parser.add_argument('--source-dir', metavar='<path>',
+            type=str, required=True, help='clspv source directory')
+    parser.add_argument('--output-file', metavar='<path>',
+            type=str, required=True, help='output file')
+
+    args = parser.parse_args()
+
+    contents = ("// THIS FILE IS AUTOGENERATED - DO NOT EDIT!\n"
+                "#ifndef CLSPV_REVISION\n"
+                "#define CLSPV_REVISION \"%s\"\n"
+                "#endif // CLSPV_REVISION\n" % describe(args.source_dir))
+
+    # Only touch the output when the revision changes, so that the files
+    # including it are not rebuilt every time.
+    if os.path.exists(args.output_file):
+        with open(args.output_file, "r") as existing:
+            if existing.read() == contents:
+                return
+    with open(args.output_file, "w") as output:
+        output.write(contents)
+
+if __name__ == '__main__':
+    main()
@@ -26,6 +26,9 @@ def main():
     parser.add_argument('--output-file', metavar='<path>',
             type=str, required=True,
             help='output stripped OpenCL C header')
+    parser.add_argument('--extra-file', metavar='<path>',
+            type=str, required=True,
+            help='header of the builtins to add to the output')
 
     args = parser.parse_args()
 
@@ -37,24 +40,11 @@ def main():
                 if re.search(regex, line) is None:
                     output.write(line)
 
-    # Add some customs builtins.
-    with open(args.output_file, "a") as output:
-        output.write("\n");
-        output.write("\nfloat4 __attribute((overloadable)) __clspv_vloada_half4(size_t, const __global uint2*);")
-        output.write("\nfloat4 __attribute((overloadable)) __clspv_vloada_half4(size_t, const __local uint2*);")
-        output.write("\nfloat4 __attribute((overloadable)) __clspv_vloada_half4(size_t, const __private uint2*);")
-        output.write("\nfloat2 __attribute((overloadable)) __clspv_vloada_half2(size_t, const __global uint*);")
-        output.write("\nfloat2 __attribute((overloadable)) __clspv_vloada_half2(size_t, const __local uint*);")
-        output.write("\nfloat2 __attribute((overloadable)) __clspv_vloada_half2(size_t, const __private uint*);")
-        output.write("\n");
-        # Define the OpenCL 2.0 work_group_barrier alias.
-        output.write("\n#if !defined(__OPENCL_CPP_VERSION__) && (__OPENCL_C_VERSION__ < CL_VERSION_2_0)\n")
-        output.write("#define __ovld __attribute__((overloadable))\n")
-        output.write("#define __conv __attribute__((convergent))\n")
-        output.write("void __ovld __conv work_group_barrier(cl_mem_fence_flags flags);\n")
-        output.write("#undef __ovld\n")
-        output.write("#undef __conv\n")
-        output.write("#endif\n");
+    # Add the builtins clspv declares on top of opencl-c.h.
+    with open(args.extra_file, "r") as input:
+        with open(args.output_file, "a") as output:
+            output.write("\n")
+            output.write(input.read())
 
 if __name__ == '__main__':
     main()
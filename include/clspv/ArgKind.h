@@ -15,6 +15,7 @@
 #ifndef CLSPV_INCLUDE_CLSPV_ARG_KIND_H_
 #define CLSPV_INCLUDE_CLSPV_ARG_KIND_H_
 
+#include <cstdint>
 #include <string>
 
 namespace clspv {
@@ -31,6 +32,16 @@ enum class ArgKind : int {
   Sampler,
 };
 
+// Bit mask of how the kernels of a module access the memory bound to an
+// argument. The SPIR-V producer derives it from the uses of the argument and
+// records it as NonWritable and NonReadable decorations of the variable.
+enum ArgAccess : uint32_t {
+  kArgAccessRead = 1u << 0,
+  kArgAccessWrite = 1u << 1,
+  // Atomics also set the read and write bits of the accesses they perform.
+  kArgAccessAtomic = 1u << 2,
+};
+
 // Converts an ArgKind to its string name.
 const char *GetArgKindName(ArgKind);
 
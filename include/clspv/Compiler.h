@@ -15,7 +15,10 @@
 #ifndef CLSPV_INCLUDE_CLSPV_COMPILER_H_
 #define CLSPV_INCLUDE_CLSPV_COMPILER_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace clspv {
@@ -28,11 +31,125 @@ int Compile(const int argc, const char *const argv[]);
 // |sampler_map| is non-empty, it will be used as the sampler map, otherwise
 // the sampler map source falls back on command line options. Command line
 // options to clspv are passed as |options|. |output_binary| must be non-null.
+//
+// Each call captures its own copy of the clspv options, so several programs
+// may be compiled concurrently from different threads.  Options belonging to
+// LLVM itself (rather than clspv) remain process-wide and should be the same
+// for all concurrent calls.
 int CompileFromSourceString(const std::string &program,
                             const std::string &sampler_map,
                             const std::string &options,
                             std::vector<uint32_t> *output_binary,
                             std::string *output_log = nullptr);
+
+// Like CompileFromSourceString, but compiles the |program_size| bytes at
+// |program| without copying them, e.g. from a mapped file.  If they are LLVM
+// bitcode, such as the output of -emit-ir, they are compiled as LLVM IR.
+// Otherwise they are OpenCL C and |program|[|program_size|] must be a null
+// character; memory mapped by llvm::MemoryBuffer and std::string both
+// satisfy this.
+int CompileFromBuffer(const char *program, size_t program_size,
+                      const std::string &sampler_map,
+                      const std::string &options,
+                      std::vector<uint32_t> *output_binary,
+                      std::string *output_log = nullptr);
+
+// A sampler map parsed by PrecompileSamplerMap.  It is never modified by a
+// compilation, so one object may be shared by any number of compilations,
+// including concurrent ones.
+struct PrecompiledSamplerMap {
+  // The sampler map text, which is part of compile cache keys.
+  std::string source;
+  // The value of each sampler and its canonical expression, in map order.
+  std::vector<std::pair<unsigned, std::string>> entries;
+};
+
+// Parses |sampler_map| into |precompiled|, so that the same sampler map is
+// not parsed again by every compilation.  Returns 0 if successful.
+int PrecompileSamplerMap(const std::string &sampler_map,
+                         PrecompiledSamplerMap *precompiled);
+
+// Like the function above, but with a sampler map prepared by
+// PrecompileSamplerMap.  The -samplermap option is ignored.
+int CompileFromSourceString(const std::string &program,
+                            const PrecompiledSamplerMap &sampler_map,
+                            const std::string &options,
+                            std::vector<uint32_t> *output_binary,
+                            std::string *output_log = nullptr);
+
+// A program to compile with CompileBatch.
+struct BatchProgram {
+  // The program source.
+  std::string program;
+  // The sampler map for the program.  See CompileFromSourceString.
+  std::string sampler_map;
+  // If non-null, used instead of |sampler_map|.  It must outlive the batch.
+  const PrecompiledSamplerMap *precompiled_sampler_map = nullptr;
+  // The kernels to compile.  If non-empty, this replaces any -entry-points
+  // option for this program only.
+  std::vector<std::string> entry_points;
+};
+
+// The result of compiling one program with CompileBatch.
+struct BatchResult {
+  // 0 if the program was compiled successfully.
+  int status = 0;
+  // The SPIR-V binary.
+  std::vector<uint32_t> binary;
+  // The compilation log.
+  std::string log;
+};
+
+// Compiles each of |programs| with the same |options|, using up to
+// |num_threads| threads.  If |num_threads| is 0, one thread per hardware
+// thread is used.  The options are parsed and the passes are registered once
+// for the whole batch.  |results| must be non-null and receives one result
+// per program, in order.  Returns 0 if every program compiled successfully.
+int CompileBatch(const std::vector<BatchProgram> &programs,
+                 const std::string &options,
+                 std::vector<BatchResult> *results,
+                 unsigned num_threads = 0);
+
+// An argument of a kernel reported by ValidateProgram.
+struct KernelArgSignature {
+  std::string name;
+  // The type as written, without qualifiers, e.g. "float4*" or "image2d_t".
+  // Unsigned types are spelled as in OpenCL C, e.g. "uint".
+  std::string type;
+  // "global", "constant" or "local" for pointer arguments, "private" for the
+  // other arguments.
+  std::string address_space;
+  // "read_only", "write_only" or "read_write" for images and pipes, "none"
+  // for the other arguments.
+  std::string access_qualifier;
+  // The type qualifiers separated by spaces: "const", "restrict" and
+  // "volatile" for pointer arguments, "pipe" for pipes.
+  std::string type_qualifiers;
+};
+
+// A kernel reported by ValidateProgram.
+struct KernelSignature {
+  std::string name;
+  std::vector<KernelArgSignature> args;
+  // The reqd_work_group_size attribute of the kernel, or zeros if it has none.
+  uint32_t reqd_work_group_size[3] = {0, 0, 0};
+  // The work_group_size_hint attribute of the kernel, or zeros.
+  uint32_t work_group_size_hint[3] = {0, 0, 0};
+  // The type of the vec_type_hint attribute of the kernel, or empty.
+  std::string vec_type_hint;
+};
+
+// Checks |program| without generating code, e.g. for clCompileProgram or
+// editor tooling. The program is only parsed and checked by Clang and the
+// clspv frontend checks, so the diagnostics are the same as those of
+// CompileFromSourceString, whose |options| this takes too. The builtin headers
+// are precompiled once per -builtins-pch-dir, which makes repeated calls
+// cheap. |kernels| must be non-null and receives the kernels of the program,
+// in source order, including those parsed before an error. Returns 0 if the
+// program has no errors.
+int ValidateProgram(const std::string &program, const std::string &options,
+                    std::vector<KernelSignature> *kernels,
+                    std::string *output_log = nullptr);
 } // namespace clspv
 
 #endif // CLSPV_INCLUDE_CLSPV_COMPILER_H_
@@ -0,0 +1,117 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_INCLUDE_CLSPV_COMPRESSED_SPIRV_H_
+#define CLSPV_INCLUDE_CLSPV_COMPRESSED_SPIRV_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace clspv {
+
+// Compact, lossless container for a SPIR-V module, written by -mfmt=cspv.
+//
+// The file is a CompressedSPIRVHeader, the reflection sidecar of the module
+// (see clspv/ReflectionSidecar.h) and the encoded instruction stream. The
+// sidecar is stored as is, so the reflection can be read without decoding the
+// module.
+//
+// In the stream every word is a LEB128 varint. An instruction starts with its
+// opcode shifted left by 4 bits, or'ed with its word count minus one, capped
+// at 15; a capped count is followed by the rest of it. Each operand is then
+// encoded depending on the opcode: a result id as the difference from the
+// previous result id plus one, another id as its distance to the previous
+// result id, both zigzag encoded, and a literal as is. IDs are mostly
+// allocated in order and refer to recent values, so most operands take a
+// single byte. The stream may be further compressed with zlib.
+//
+// Every header field is a little-endian uint32_t. The version is bumped on
+// any change to the encoding.
+const uint32_t kCompressedSPIRVMagic = 0x56505343; // "CSPV"
+const uint32_t kCompressedSPIRVVersion = 1;
+
+// Set in |flags| if the stream is compressed with zlib.
+const uint32_t kCompressedSPIRVEntropy = 1;
+
+struct CompressedSPIRVHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t flags;
+  // Number of words of the decoded module, header included.
+  uint32_t num_words;
+  // Size in bytes of the reflection sidecar following the header, a multiple
+  // of 4. Zero if the module has no reflection.
+  uint32_t reflection_size;
+  // Size in bytes of the stream following the sidecar, as stored.
+  uint32_t stream_size;
+  // Size in bytes of the stream before the zlib stage.
+  uint32_t encoded_size;
+};
+
+// Encodes the |num_words| words of SPIR-V at |words| into |out|. The zlib
+// stage is applied if |entropy| is set, zlib is available and it makes the
+// stream smaller. Returns false if |words| is not a SPIR-V module.
+bool CompressSPIRV(const uint32_t *words, size_t num_words, bool entropy,
+                   std::vector<char> *out);
+
+// Returns true if the |size| bytes at |data| start with a compressed SPIR-V
+// header.
+bool IsCompressedSPIRV(const void *data, size_t size);
+
+// Streaming decoder of a compressed SPIR-V module.
+class SPIRVDecompressor {
+public:
+  // Checks the header and section bounds of the |size| bytes at |data|, which
+  // must be 4-byte aligned and outlive the decoder. Returns false if they are
+  // not a compressed module of this version, or if its stream is compressed
+  // with zlib and zlib is not available.
+  bool init(const void *data, size_t size);
+
+  uint32_t num_words() const { return header_->num_words; }
+
+  // The reflection sidecar, which reflection::SidecarView can read in place.
+  const void *reflection() const { return header_ + 1; }
+  size_t reflection_size() const { return header_->reflection_size; }
+
+  // Appends the words of the SPIR-V header on the first call and of one
+  // instruction on each following call to |words|. Returns false once the
+  // module is complete, or if the stream is malformed, which failed() tells
+  // apart.
+  bool next(std::vector<uint32_t> *words);
+
+  bool failed() const { return failed_; }
+
+private:
+  // Reads a varint from the stream into |value|.
+  bool read(uint32_t *value);
+
+  const CompressedSPIRVHeader *header_ = nullptr;
+  // The zlib stage expanded, if the stream had one.
+  std::vector<uint8_t> inflated_;
+  const uint8_t *pos_ = nullptr;
+  const uint8_t *end_ = nullptr;
+  uint32_t decoded_words_ = 0;
+  uint32_t last_result_ = 0;
+  bool failed_ = false;
+};
+
+// Decodes the whole compressed module in the |size| bytes at |data| into
+// |words|. Returns false if it is malformed.
+bool DecompressSPIRV(const void *data, size_t size,
+                     std::vector<uint32_t> *words);
+
+} // namespace clspv
+
+#endif // CLSPV_INCLUDE_CLSPV_COMPRESSED_SPIRV_H_
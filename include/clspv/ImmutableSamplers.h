@@ -0,0 +1,38 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_INCLUDE_CLSPV_IMMUTABLE_SAMPLERS_H_
+#define CLSPV_INCLUDE_CLSPV_IMMUTABLE_SAMPLERS_H_
+
+#include <cstdint>
+
+namespace clspv {
+
+// Name of the non-semantic extended instruction set describing literal
+// samplers as immutable samplers with -immutable-literal-samplers.
+const char kImmutableSamplersImportName[] =
+    "NonSemantic.ClspvImmutableSamplers.1";
+
+// Instructions of that set. Their operands are ids of 32-bit integer
+// constants.
+enum ImmutableSamplersExtInst : uint32_t {
+  // Operands: the descriptor set and binding of a literal sampler, followed by
+  // its VkFilter, VkSamplerAddressMode, unnormalizedCoordinates and
+  // VkBorderColor (see clspv::GetVulkanSamplerState).
+  kImmutableSampler = 1,
+};
+
+} // namespace clspv
+
+#endif // CLSPV_INCLUDE_CLSPV_IMMUTABLE_SAMPLERS_H_
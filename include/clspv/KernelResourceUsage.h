@@ -0,0 +1,44 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_INCLUDE_CLSPV_KERNEL_RESOURCE_USAGE_H_
+#define CLSPV_INCLUDE_CLSPV_KERNEL_RESOURCE_USAGE_H_
+
+#include <cstdint>
+
+namespace clspv {
+
+// Name of the non-semantic extended instruction set reporting the resources
+// used by each kernel with -kernel-resource-usage. It sits next to
+// NonSemantic.ClspvReflection, whose grammar is owned by SPIRV-Headers.
+const char kKernelResourceUsageImportName[] =
+    "NonSemantic.ClspvKernelResourceUsage.1";
+
+// Instructions of that set. Their first operand is the Kernel instruction of
+// NonSemantic.ClspvReflection they describe, and the others are ids of 32-bit
+// integer constants.
+enum KernelResourceUsageExtInst : uint32_t {
+  // Operands: the bytes of workgroup memory statically allocated by the
+  // kernel, the bytes of private memory of its function variables, and the
+  // bytes of push constants it reads. Pointer-to-local arguments, sized at
+  // dispatch, are not counted.
+  kKernelResourceUsage = 1,
+  // Operands: the X, Y and Z local size suggested for the kernel. It is
+  // reqd_work_group_size when specified.
+  kKernelSuggestedLocalSize = 2,
+};
+
+} // namespace clspv
+
+#endif // CLSPV_INCLUDE_CLSPV_KERNEL_RESOURCE_USAGE_H_
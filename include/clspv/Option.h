@@ -16,10 +16,38 @@
 #define CLSPV_INCLUDE_CLSPV_OPTION_H_
 
 #include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace clspv {
 namespace Option {
 
+// Captures the current values of all clspv options and makes them the values
+// returned by the accessors below on the calling thread, for the lifetime of
+// this object.  Each compilation holds one of these so that the option globals
+// can be reparsed by another compilation on another thread without affecting
+// it.  When no state is active on a thread, the accessors read the option
+// globals directly.
+class ScopedOptionState {
+public:
+  ScopedOptionState();
+  ~ScopedOptionState();
+
+  // Makes a copy of the values captured by |other| active on the calling
+  // thread.  This lets the same options be used by compilations on several
+  // threads.
+  explicit ScopedOptionState(const ScopedOptionState &other);
+  ScopedOptionState &operator=(const ScopedOptionState &) = delete;
+
+  // The captured option values.  Defined in Option.cpp.
+  struct Values;
+
+private:
+  std::unique_ptr<Values> values_;
+  Values *previous_;
+};
+
 // Returns true if each kernel must use its own descriptor set for all
 // arguments.
 bool DistinctKernelDescriptorSets();
@@ -110,7 +138,7 @@ uint32_t MaxPushConstantsSize();
 bool RelaxedUniformBufferLayout();
 
 // Returns true if clspv should allow UBOs that conform to std430 (SSBO) layout
-// requirements.
+// requirements.  This is implied by ScalarBlockLayout().
 bool Std430UniformBufferLayout();
 
 // Returns true if clspv should not remove unused arguments of non-kernel
@@ -172,6 +200,10 @@ bool GlobalOffset();
 // Returns true when support for global offset is enabled using push constants.
 bool GlobalOffsetPushConstant();
 
+// Returns true when kernels reading the global offset or the non-uniform
+// NDRange push constants get a variant assuming neither is used.
+bool UniformNDRangeVariants();
+
 // Returns true when support for non uniform NDRanges is enabled.
 static bool NonUniformNDRangeSupported() {
   return (Language() == SourceLanguage::OpenCL_CPP) ||
@@ -179,6 +211,218 @@ static bool NonUniformNDRangeSupported() {
          (Language() == SourceLanguage::OpenCL_C_30);
 }
 
+// Returns true if the SPIR-V producer should encode each function as soon as it
+// is complete, to lower peak memory.
+bool StreamFunctions();
+
+// Returns true if the compiler releases the frontend, local value names and
+// the IR of each encoded function as early as it can, to lower peak memory.
+bool LeanMemory();
+
+// Returns true if the IDs of the SPIR-V module are renumbered in the order they
+// first appear.
+bool CanonicalIds();
+
+// Returns true if barriers are narrowed to the storage classes the kernels
+// write and consecutive barriers are merged.
+bool OptimizeBarriers();
+
+// Returns the kernels to compile. If empty, every kernel is compiled.
+std::vector<std::string> EntryPoints();
+
+// Sets the kernels to compile.
+void SetEntryPoints(const std::vector<std::string> &names);
+
+// Returns the -fuse-kernels entries as given.
+std::vector<std::string> FuseKernels();
+
+// Parses the -fuse-kernels |entry| into the |first| and |second| kernels and
+// the ordinals of their argument pointing to the buffer passed between them.
+// Returns false if it is malformed.
+bool ParseFuseKernels(const std::string &entry, std::string *first,
+                      unsigned *first_ordinal, std::string *second,
+                      unsigned *second_ordinal);
+
+// Returns the -local-arg-size entries as given.
+std::vector<std::string> LocalArgSizes();
+
+// Parses the -local-arg-size |entry| into the |kernel|, argument |ordinal| and
+// size in |bytes| it gives. Returns false if it is malformed or the size is 0.
+bool ParseLocalArgSize(const std::string &entry, std::string *kernel,
+                       unsigned *ordinal, uint32_t *bytes);
+
+// Returns the size in bytes given for the __local pointer argument |ordinal|
+// of |kernel|, or 0 if its size is left to a specialization constant.
+uint32_t LocalArgSize(const std::string &kernel, unsigned ordinal);
+
+// Returns the -pod-spec-constants entries as given.
+std::vector<std::string> PodSpecConstants();
+
+// Parses the -pod-spec-constants |entry| into the |kernel| and argument
+// |ordinal| it gives. Returns false if it is malformed.
+bool ParsePodSpecConstant(const std::string &entry, std::string *kernel,
+                          unsigned *ordinal);
+
+// Returns true if the POD argument |ordinal| of |kernel| is read from a
+// specialization constant.
+bool IsPodSpecConstant(const std::string &kernel, unsigned ordinal);
+
+// Returns the width of the vectors that long vectors are split into, or 1 if
+// they are split into scalars.
+unsigned LongVectorChunkWidth();
+
+// Returns the cost threshold for cost based inlining, or 0 if it is disabled.
+unsigned InlineCostThreshold();
+
+// Returns the cost reduction of a call site for each constant argument in cost
+// based inlining.
+unsigned InlineConstantArgBonus();
+
+// Returns the number of values live across a call in a loop above which large
+// functions are not inlined in cost based inlining, or 0 if it is disabled.
+unsigned InlinePressureThreshold();
+
+// Returns the instruction count above which a function is not inlined at call
+// sites under register pressure.
+unsigned InlinePressureCalleeSize();
+
+// Returns the local size the program is specialized for, or an empty vector if
+// it is not specialized.
+std::vector<unsigned> LocalSize();
+
+// Returns true if clustered POD arguments are reordered to minimize padding.
+bool PackPodArgs();
+
+// Returns true if kernel argument bindings are assigned so that all kernels can
+// share one descriptor set layout.
+bool SharedDescriptorLayout();
+
+// Returns true if __global and __constant pointer kernel arguments are passed
+// as 64-bit device addresses instead of descriptors.
+bool PhysicalStorageBuffers();
+
+// Returns true if __local variables used by one kernel can share storage when
+// a barrier separates their lifetimes.
+bool PackLocalMemory();
+
+// Returns the size in bytes up to which module-scope constants that are only
+// loaded from stay out of the storage buffer of
+// -module-constants-in-storage-buffer.
+unsigned ModuleConstantsInlineThreshold();
+
+// Returns the number of instructions direct resource access may add to the
+// module by cloning functions called with different resources.
+unsigned DirectResourceAccessCloneLimit();
+
+// Returns true if scalar buffer kernel arguments only accessed by vload and
+// vstore of one width are retyped as buffers of that vector type.
+bool VectorBufferArgs();
+
+// Returns true if floating-point atomic adds are lowered to
+// SPV_EXT_shader_atomic_float_add.
+bool AtomicFloatAdd();
+
+// Returns true if atomic operations on 64-bit integers may use the Int64Atomics
+// capability.
+bool Int64Atomics();
+
+// Returns true if integer arithmetic on 8- and 16-bit values should stay at
+// that width.
+bool NarrowIntegerArithmetic();
+
+// Returns true if half precision arithmetic should be computed in 16 bits.
+bool NativeFp16();
+
+// Returns true if the CFG structurizer should skip functions whose control flow
+// is already structured.
+bool StructurizeUnstructuredOnly();
+
+// Returns true if kernel arguments that are unused after optimization get no
+// descriptor and no argument reflection.
+bool SkipUnusedKernelArgs();
+
+// Returns the number of element stores or copies up to which llvm.memset and
+// llvm.memcpy are unrolled.
+unsigned MemIntrinsicUnrollLimit();
+
+// Returns true if chains of insertvalue instructions whose only use is a store
+// are replaced by stores of the inserted members.
+bool MemberStoresForInserts();
+
+// Returns true if sampled reads with integer coordinates and a literal
+// non-normalized, nearest sampler are lowered to image fetches.
+bool ImageFetchIntCoords();
+
+// Returns true if the SPIR-V producer decorates values with the uniformity it
+// proves.
+bool UniformityDecorations();
+
+enum class ProfileCounters : int {
+  kNone = 0,
+  kBlocks,
+  kLoops,
+};
+
+// Returns what -profile-counters counts.
+ProfileCounters ProfileCountersMode();
+
+enum class RelaxedPrecision : int {
+  kNone = 0,
+  kBuiltins,
+  kRelaxedMath,
+};
+
+// Returns which float results -relaxed-precision decorates RelaxedPrecision.
+RelaxedPrecision RelaxedPrecisionMode();
+
+// Returns true if identical getelementptrs are merged and loop-invariant ones
+// hoisted right before SPIR-V generation.
+bool HoistAccessChains();
+
+// Returns true if 3-element vector accesses through pointers to 4-element
+// vectors are widened to whole 4-element vector accesses.
+bool WidenVec3Accesses();
+
+// Returns true if the module uses the Vulkan memory model instead of GLSL450.
+bool VulkanMemoryModel();
+
+// Returns true if the reflection reports the memory used by each kernel and a
+// suggested local size.
+bool KernelResourceUsage();
+
+// Returns true if the reflection reports the Vulkan sampler state of each
+// literal sampler, to be created as an immutable sampler.
+bool ImmutableLiteralSamplers();
+
+// Returns true if the buffers accessed with several types are declared as
+// arrays of 32-bit words.
+bool UntypedBuffers();
+
+// Returns true if 64-bit integer arithmetic known to fit in 32 bits is
+// computed at 32 bits.
+bool NarrowInt64Arithmetic();
+
+// Returns the -int64-arg-range entries as given.
+std::vector<std::string> Int64ArgRanges();
+
+// Parses the -int64-arg-range |entry| into the |kernel|, argument |ordinal|
+// and the inclusive range [|min|, |max|] it gives. Returns false if it is
+// malformed or the range is empty.
+bool ParseInt64ArgRange(const std::string &entry, std::string *kernel,
+                        unsigned *ordinal, int64_t *min, int64_t *max);
+
+// Returns the most elements of a dynamically indexed private array kept in
+// registers, or 0 if such arrays are not promoted.
+unsigned PrivateArrayPromotionThreshold();
+
+// Returns true if storage buffer variables are decorated Restrict when their
+// kernel arguments are restrict, and Aliased otherwise.
+bool BufferAliasDecorations();
+
+// Returns true if atomic additions to a subgroup-uniform address are
+// performed once per subgroup.
+bool SubgroupAtomicAggregation();
+
 enum class StorageClass : int {
   kSSBO = 0,
   kUBO,
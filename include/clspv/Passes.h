@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cstdint>
 #include <string>
 #include <utility>
 #include <vector>
@@ -20,6 +21,7 @@ namespace llvm {
 // This is against Google C++ style guide.
 class FunctionPass;
 class ModulePass;
+class PassBuilder;
 class raw_pwrite_stream;
 class raw_ostream;
 template <typename T> class ArrayRef;
@@ -106,6 +108,14 @@ llvm::ModulePass *createInlineFuncWithPointerToFunctionArgPass();
 /// Inline functions that have a single call site.
 llvm::ModulePass *createInlineFuncWithSingleCallSitePass();
 
+/// Inline call instructions selected by a size/benefit cost model.
+/// @return An LLVM module pass.
+///
+/// Visiting callees bottom-up, inline the calls to functions whose size, less
+/// a bonus for each constant argument, is within -inline-cost-threshold.
+/// Functions with a single call site are inlined up to twice the threshold.
+llvm::ModulePass *createInlineByCostPass();
+
 /// Zero-initialize allocas.
 /// @return An LLVM module pass.
 ///
@@ -118,6 +128,13 @@ llvm::ModulePass *createZeroInitializeAllocasPass();
 /// @return An LLVM module pass.
 llvm::ModulePass *createRewriteConstantExpressionsPass();
 
+/// Fuse the kernels given by -fuse-kernels.
+/// @return An LLVM module pass.
+///
+/// Each pair of kernels becomes a new kernel running both bodies in turn,
+/// with the buffer passed from the first to the second as a single argument.
+llvm::ModulePass *createFuseKernelsPass();
+
 /// Create a simple OpenCL inliner.
 /// @return An LLVM module pass.
 ///
@@ -125,6 +142,51 @@ llvm::ModulePass *createRewriteConstantExpressionsPass();
 /// builtins where appropriate.
 llvm::ModulePass *createOpenCLInlinerPass();
 
+/// Run the LLVM optimization pipeline on groups of kernels in parallel.
+/// @return An LLVM module pass.
+///
+/// The kernels are split into at most |jobs| partitions, 0 meaning one per
+/// hardware thread, that are optimized in their own context and linked back.
+/// |opt_level| and |size_level| configure the PassBuilder pipeline. With a
+/// |cache_dir|, each kernel gets its own partition, whose optimized bitcode
+/// is cached there, up to |cache_max_size| bytes.
+llvm::ModulePass *createParallelOptimizePass(unsigned jobs, unsigned opt_level,
+                                             unsigned size_level,
+                                             const std::string &cache_dir = "",
+                                             uint64_t cache_max_size = 0);
+
+/// Rewrite __global and __constant pointer kernel arguments as 64-bit device
+/// addresses.
+/// @return An LLVM module pass.
+///
+/// Each such argument becomes an i64 POD argument that is converted back to
+/// a pointer in the kernel. Only runs with -physical-storage-buffers.
+llvm::ModulePass *createPhysicalStorageBufferArgsPass();
+
+/// Read the POD kernel arguments selected by -pod-spec-constants from
+/// specialization constants.
+/// @return An LLVM module pass.
+///
+/// The uses of each such argument in the kernel are replaced by the value of
+/// a new specialization constant. The argument itself is left in place.
+llvm::ModulePass *createPodSpecConstantArgsPass();
+
+/// Aggregate atomic additions to a subgroup-uniform address, for
+/// -subgroup-atomic-aggregation.
+/// @return An LLVM module pass.
+///
+/// The subgroup sums its values with a reduction and its lowest active
+/// invocation performs a single atomic. The results are rebuilt with an
+/// exclusive scan.
+llvm::ModulePass *createAggregateAtomicsPass();
+
+/// Count the executions of basic blocks or loop headers for -profile-counters.
+/// @return An LLVM module pass.
+///
+/// Each counted block atomically increments its own counter in a storage
+/// buffer variable, once per subgroup from SPIR-V 1.3.
+llvm::ModulePass *createProfileCountersPass();
+
 /// Create a re-order basic blocks pass.
 /// @return An LLVM module pass.
 ///
@@ -152,10 +214,15 @@ llvm::ModulePass *createReplaceOpenCLBuiltinPass();
 
 /// Create a pass to emit SPIR-V for the module.
 /// @return An LLVM module pass.
+///
+/// If |outputWords| is given, a binary module is left in it instead of being
+/// written to |out|.  A C initializer list is always written to |out|.  If
+/// |optimizeSize| is true, the module is shrunk before it is output.
 llvm::ModulePass *createSPIRVProducerPass(
     llvm::raw_pwrite_stream &out,
     llvm::ArrayRef<std::pair<unsigned, std::string>> samplerMap,
-    bool outputCInitList);
+    bool outputCInitList, std::vector<uint32_t> *outputWords = nullptr,
+    bool optimizeSize = false);
 
 /// Undo LLVM's bitcast instructions with pointer type.
 /// @return An LLVM module pass.
@@ -165,6 +232,28 @@ llvm::ModulePass *createSPIRVProducerPass(
 /// pointer type into other instructions' sequence.
 llvm::ModulePass *createReplacePointerBitcastPass();
 
+/// Declare the type-punned buffer arguments of kernels as arrays of 32-bit
+/// words, and access them one word at a time.
+/// @return An LLVM module pass.
+///
+/// Added before ReplacePointerBitcastPass with -untyped-buffers.
+llvm::ModulePass *createUntypedBuffersPass();
+
+/// Widens the loads and stores of 3-element vectors through bitcasts of
+/// pointers to 4-element vectors into 4-element vector accesses, which
+/// ReplacePointerBitcastPass would otherwise split per element.
+/// @return An LLVM function pass.
+llvm::FunctionPass *createWidenVec3AccessesPass();
+
+/// Remove the kernels not listed by -entry-points.
+/// @return An LLVM module pass.
+///
+/// Kernels not listed are deleted, along with the functions only they call.
+/// A kernel that is called by a kept kernel becomes an internal helper
+/// function instead. Running this first keeps the rest of the pipeline from
+/// spending time on code that is never dispatched.
+llvm::ModulePass *createSelectEntryPointsPass();
+
 /// Simplify LLVM's bitcast instructions with pointer type.
 /// @return An LLVM module pass.
 ///
@@ -272,6 +361,39 @@ llvm::ModulePass *createUndoTranslateSamplerFoldPass();
 /// malformed types" that would make this pass redundant.
 llvm::ModulePass *createUndoTruncateToOddIntegerPass();
 
+/// Computes truncated integer arithmetic at the 8- or 16-bit width of the
+/// truncation instead of at the promoted width.
+/// @return An LLVM module pass.
+llvm::ModulePass *createNarrowIntegerArithmeticPass();
+
+/// Computes float arithmetic and math builtins truncated to half at half
+/// precision instead of in float.
+/// @return An LLVM module pass.
+llvm::ModulePass *createNarrowHalfArithmeticPass();
+
+/// Adds llvm.assume calls for the ranges of 64-bit kernel arguments given with
+/// -int64-arg-range.
+/// @return An LLVM module pass.
+llvm::ModulePass *createAssumeInt64ArgRangesPass();
+
+/// Computes 64-bit integer arithmetic whose values are known to fit in 32 bits
+/// at 32 bits, and removes the llvm.assume calls.
+/// @return An LLVM function pass.
+llvm::FunctionPass *createNarrowInt64ArithmeticPass();
+
+/// Keeps small dynamically indexed private arrays of scalars in registers,
+/// with -private-array-promotion-threshold.
+/// @return An LLVM function pass.
+///
+/// Arrays of up to 4 elements become vectors, and larger ones one value per
+/// element accessed through select chains.
+llvm::FunctionPass *createPromotePrivateArraysPass();
+
+/// Narrows the memory semantics of barriers to the storage classes the kernels
+/// executing them write, and merges consecutive barriers.
+/// @return An LLVM module pass.
+llvm::ModulePass *createOptimizeBarriersPass();
+
 /// Cluster module-scope __constant variables.
 /// @return An LLVM module pass.
 ///
@@ -390,6 +512,11 @@ llvm::ModulePass *createRemoveUnusedArgumentsPass();
 /// requirements.
 llvm::ModulePass *createMultiVersionUBOFunctionsPass();
 
+/// Specializes or inlines functions with generic pointer arguments by the
+/// address space of the pointers they are called with.
+/// @return An LLVM module pass
+llvm::ModulePass *createSpecializeGenericAddressSpacePass();
+
 /// Specialize image types.
 llvm::ModulePass *createSpecializeImageTypesPass();
 
@@ -398,6 +525,37 @@ llvm::ModulePass *createSpecializeImageTypesPass();
 /// * Add a block to split a continue block used a merge block.
 llvm::FunctionPass *createFixupStructuredCFGPass();
 
+/// Register the clspv passes with |PB|, for new pass manager pipelines.
+///
+/// FixupStructuredCFG and ReorderBasicBlocks are function passes sharing the
+/// dominator tree and loop info of the analysis manager. Any other clspv pass
+/// runs as the module pass legacy<PassName>.
+void registerNewPMPasses(llvm::PassBuilder &PB);
+
+/// Merges identical getelementptrs and hoists loop-invariant ones into the
+/// preheader of their loop, without changing the CFG.
+/// @return An LLVM function pass.
+llvm::FunctionPass *createHoistAccessChainsPass();
+
+/// Marks the loops whose llvm.loop metadata asks not to unroll them, so that
+/// hint can be told apart from the one the LLVM unroller adds to the loops it
+/// has unrolled.
+/// @return An LLVM function pass.
+llvm::FunctionPass *createMarkSourceLoopHintsPass();
+
+/// Copies the llvm.loop metadata of each loop into its header, where it
+/// survives CFG structurization, so the SPIR-V producer can turn it into loop
+/// controls.
+/// @return An LLVM function pass.
+llvm::FunctionPass *createPreserveLoopMetadataPass();
+
+/// Runs the LLVM CFG structurizer only on functions whose control flow is not
+/// already in the structured form the SPIR-V producer expects. Loops with
+/// early exits are first given single exit blocks, and only the functions
+/// still unstructured after that go through the structurizer.
+/// @return An LLVM module pass.
+llvm::ModulePass *createSelectiveStructurizeCFGPass();
+
 /// Adds attributes to intrinsic and builtin functions to produce a better
 /// optimization outcome.
 llvm::ModulePass *createAddFunctionAttributesPass();
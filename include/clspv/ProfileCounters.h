@@ -0,0 +1,41 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_INCLUDE_CLSPV_PROFILE_COUNTERS_H_
+#define CLSPV_INCLUDE_CLSPV_PROFILE_COUNTERS_H_
+
+#include <cstdint>
+
+namespace clspv {
+
+// Name of the non-semantic extended instruction set reporting the counters
+// added by -profile-counters. It sits next to NonSemantic.ClspvReflection,
+// whose grammar is owned by SPIRV-Headers.
+const char kProfileCountersImportName[] = "NonSemantic.ClspvProfileCounters.1";
+
+// Instructions of that set. Their operands are ids of 32-bit integer
+// constants unless noted.
+enum ProfileCountersExtInst : uint32_t {
+  // Operands: the descriptor set and binding of the storage buffer holding
+  // the counters, and the number of 32-bit counters in it.
+  kProfileCountersBuffer = 1,
+  // Operands: the index of a counter in the buffer and an OpString naming
+  // what it counts, as function:block, followed by :line when the block has a
+  // debug location.
+  kProfileCounter = 2,
+};
+
+} // namespace clspv
+
+#endif // CLSPV_INCLUDE_CLSPV_PROFILE_COUNTERS_H_
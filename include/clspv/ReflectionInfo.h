@@ -0,0 +1,147 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_INCLUDE_CLSPV_REFLECTION_INFO_H_
+#define CLSPV_INCLUDE_CLSPV_REFLECTION_INFO_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "clspv/ArgKind.h"
+#include "clspv/PushConstant.h"
+#include "clspv/SpecConstant.h"
+
+namespace clspv {
+namespace reflection {
+
+// A string that lives inside the parsed SPIR-V blob. |data| is always null
+// terminated and is only valid while the blob is.
+struct BlobString {
+  const char *data = "";
+  uint32_t size = 0;
+};
+
+// Marks the absence of a kernel index.
+constexpr uint32_t kNoKernel = ~0u;
+
+struct KernelInfo {
+  BlobString name;
+  // Index of the first argument of this kernel in ReflectionInfo::args.
+  // Arguments of a kernel are contiguous and sorted by ordinal.
+  uint32_t first_arg = 0;
+  uint32_t num_args = 0;
+  // reqd_work_group_size, or all zeros when not specified.
+  uint32_t required_workgroup_size[3] = {0, 0, 0};
+  // Index in ReflectionInfo::kernels of the <name>.uniform variant of this
+  // kernel emitted with -uniform-ndrange-variants, or kNoKernel. The variant
+  // takes the same arguments and may be dispatched instead when the global
+  // offset is zero and the NDRange is uniform.
+  uint32_t uniform_variant = kNoKernel;
+};
+
+struct ArgInfo {
+  // Index of the owning kernel in ReflectionInfo::kernels.
+  uint32_t kernel = 0;
+  BlobString name;
+  ArgKind kind = ArgKind::Buffer;
+  uint32_t ordinal = 0;
+  // Valid for resource arguments (everything except push constant and
+  // workgroup arguments).
+  uint32_t descriptor_set = 0;
+  uint32_t binding = 0;
+  // Valid for POD arguments.
+  uint32_t offset = 0;
+  uint32_t size = 0;
+  // Valid for workgroup (local) arguments. |size| holds the element size.
+  uint32_t spec_id = 0;
+  // ArgAccess mask, valid for resource arguments. Read and write unless the
+  // variables bound to the argument are decorated NonReadable or NonWritable.
+  // kArgAccessAtomic is set for atomics on pointers derived from the
+  // variables within a function; atomics through function parameters are not
+  // seen.
+  uint32_t access = kArgAccessRead | kArgAccessWrite;
+};
+
+struct PushConstantInfo {
+  PushConstant kind = PushConstant::GlobalOffset;
+  uint32_t offset = 0;
+  uint32_t size = 0;
+};
+
+struct SpecConstantInfo {
+  SpecConstant kind = SpecConstant::kWorkgroupSizeX;
+  uint32_t spec_id = 0;
+  // For SpecConstant::kPodArgument, the index in ReflectionInfo::kernels and
+  // the ordinal of the argument read from the spec constant.
+  uint32_t kernel = kNoKernel;
+  uint32_t ordinal = 0;
+};
+
+struct ConstantDataInfo {
+  // Either ArgKind::Buffer or ArgKind::BufferUBO.
+  ArgKind kind = ArgKind::Buffer;
+  uint32_t descriptor_set = 0;
+  uint32_t binding = 0;
+  // Hex encoded initializer bytes.
+  BlobString hex_bytes;
+};
+
+struct LiteralSamplerInfo {
+  uint32_t mask = 0;
+  uint32_t descriptor_set = 0;
+  uint32_t binding = 0;
+};
+
+// A descriptor binding used by the arguments of several kernels.
+struct SharedBindingInfo {
+  uint32_t descriptor_set = 0;
+  uint32_t binding = 0;
+  // Kind of the first argument using the binding.
+  ArgKind kind = ArgKind::Buffer;
+  uint32_t num_kernels = 0;
+};
+
+// Compact form of the NonSemantic.ClspvReflection instructions of a module.
+struct ReflectionInfo {
+  std::vector<KernelInfo> kernels;
+  std::vector<ArgInfo> args;
+  std::vector<PushConstantInfo> push_constants;
+  std::vector<SpecConstantInfo> spec_constants;
+  std::vector<ConstantDataInfo> constant_data;
+  std::vector<LiteralSamplerInfo> literal_samplers;
+
+  void clear();
+};
+
+// Fills |info| from the |num_words| words of SPIR-V at |words|, which may be
+// a read-only memory mapping. No copy of the module is made: strings in
+// |info| point into |words|. Instructions are skipped by their word count,
+// so only the bound, the reflection import, 32-bit integer constants, strings
+// and the reflection instructions are decoded. The module is assumed to be
+// valid SPIR-V; returns false if it is malformed or has no reflection
+// import.
+bool ParseReflectionInfo(const uint32_t *words, size_t num_words,
+                         ReflectionInfo *info);
+
+// Returns the descriptor bindings used by arguments of more than one kernel
+// of |info|, ordered by descriptor set and binding. With
+// -shared-descriptor-layout every kernel can then be dispatched with one
+// pipeline layout and the shared bindings written once.
+std::vector<SharedBindingInfo> SharedBindings(const ReflectionInfo &info);
+
+} // namespace reflection
+} // namespace clspv
+
+#endif // CLSPV_INCLUDE_CLSPV_REFLECTION_INFO_H_
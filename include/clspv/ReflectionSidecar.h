@@ -0,0 +1,173 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_INCLUDE_CLSPV_REFLECTION_SIDECAR_H_
+#define CLSPV_INCLUDE_CLSPV_REFLECTION_SIDECAR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "clspv/ReflectionInfo.h"
+
+namespace clspv {
+namespace reflection {
+
+// Binary sidecar holding the reflection information of a module.
+//
+// The file is a SidecarHeader followed by one table per entry kind and a
+// string table. Every field is a uint32_t in the byte order of the host that
+// wrote the file, as for the SPIR-V words clspv writes, so a mapping of the
+// file can be indexed in place. A reader of the other byte order sees a
+// swapped magic number and rejects the file. Table offsets are in bytes from
+// the start of the file. String fields are byte offsets into the string
+// table, which holds null-terminated strings. Enum fields hold the integer
+// value of ArgKind, PushConstant and SpecConstant.
+//
+// The version is bumped on any layout or enum value change.
+const uint32_t kSidecarMagic = 0x46524c43; // "CLRF"
+const uint32_t kSidecarVersion = 3;
+
+struct SidecarTable {
+  uint32_t offset;
+  uint32_t count;
+};
+
+struct SidecarHeader {
+  uint32_t magic;
+  uint32_t version;
+  // Size of the whole file in bytes.
+  uint32_t size;
+  SidecarTable kernels;
+  SidecarTable args;
+  SidecarTable push_constants;
+  SidecarTable spec_constants;
+  SidecarTable constant_data;
+  SidecarTable literal_samplers;
+  // |count| is the size of the string table in bytes.
+  SidecarTable strings;
+};
+
+struct SidecarKernel {
+  uint32_t name;
+  uint32_t first_arg;
+  uint32_t num_args;
+  uint32_t required_workgroup_size[3];
+};
+
+struct SidecarArg {
+  uint32_t kernel;
+  uint32_t name;
+  uint32_t kind;
+  uint32_t ordinal;
+  uint32_t descriptor_set;
+  uint32_t binding;
+  uint32_t offset;
+  uint32_t size;
+  uint32_t spec_id;
+  uint32_t access;
+};
+
+struct SidecarPushConstant {
+  uint32_t kind;
+  uint32_t offset;
+  uint32_t size;
+};
+
+struct SidecarSpecConstant {
+  uint32_t kind;
+  uint32_t spec_id;
+  // See SpecConstantInfo.
+  uint32_t kernel;
+  uint32_t ordinal;
+};
+
+struct SidecarConstantData {
+  uint32_t kind;
+  uint32_t descriptor_set;
+  uint32_t binding;
+  uint32_t hex_bytes;
+};
+
+struct SidecarLiteralSampler {
+  uint32_t mask;
+  uint32_t descriptor_set;
+  uint32_t binding;
+};
+
+// Serializes |info| into |out|.
+void WriteSidecar(const ReflectionInfo &info, std::vector<uint32_t> *out);
+
+// Read-only view over a sidecar, typically a memory mapping of the file.
+class SidecarView {
+public:
+  // Checks the header, table bounds and string references of the |size| bytes
+  // at |data|, which must be 4-byte aligned. Returns false if they are not a
+  // sidecar of this version and host byte order. On success the view refers
+  // to |data|, which must outlive it.
+  bool init(const void *data, size_t size);
+
+  const SidecarHeader &header() const { return *header_; }
+
+  uint32_t num_kernels() const { return header_->kernels.count; }
+  const SidecarKernel &kernel(uint32_t i) const {
+    return table<SidecarKernel>(header_->kernels)[i];
+  }
+
+  uint32_t num_args() const { return header_->args.count; }
+  const SidecarArg &arg(uint32_t i) const {
+    return table<SidecarArg>(header_->args)[i];
+  }
+
+  uint32_t num_push_constants() const { return header_->push_constants.count; }
+  const SidecarPushConstant &push_constant(uint32_t i) const {
+    return table<SidecarPushConstant>(header_->push_constants)[i];
+  }
+
+  uint32_t num_spec_constants() const { return header_->spec_constants.count; }
+  const SidecarSpecConstant &spec_constant(uint32_t i) const {
+    return table<SidecarSpecConstant>(header_->spec_constants)[i];
+  }
+
+  uint32_t num_constant_data() const { return header_->constant_data.count; }
+  const SidecarConstantData &constant_data(uint32_t i) const {
+    return table<SidecarConstantData>(header_->constant_data)[i];
+  }
+
+  uint32_t num_literal_samplers() const {
+    return header_->literal_samplers.count;
+  }
+  const SidecarLiteralSampler &literal_sampler(uint32_t i) const {
+    return table<SidecarLiteralSampler>(header_->literal_samplers)[i];
+  }
+
+  // Returns the string at byte offset |offset| of the string table.
+  const char *string(uint32_t offset) const {
+    return reinterpret_cast<const char *>(base_) + header_->strings.offset +
+           offset;
+  }
+
+private:
+  template <typename T> const T *table(const SidecarTable &t) const {
+    return reinterpret_cast<const T *>(base_ + t.offset);
+  }
+
+  const uint8_t *base_ = nullptr;
+  const SidecarHeader *header_ = nullptr;
+};
+
+} // namespace reflection
+} // namespace clspv
+
+#endif // CLSPV_INCLUDE_CLSPV_REFLECTION_SIDECAR_H_
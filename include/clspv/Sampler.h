@@ -52,6 +52,24 @@ const char *GetSamplerAddressingModeName(uint32_t mask);
 // Returns the name of the filter mode in |mask|.
 const char *GetSamplerFilteringModeName(uint32_t mask);
 
+// The members of VkSamplerCreateInfo describing a literal sampler.
+struct VulkanSamplerState {
+  // VkFilter, for both magFilter and minFilter.
+  uint32_t filter;
+  // VkSamplerAddressMode, for addressModeU, V and W.
+  uint32_t address_mode;
+  // VkBool32.
+  uint32_t unnormalized_coordinates;
+  // VkBorderColor.
+  uint32_t border_color;
+};
+
+// Returns the Vulkan sampler state equivalent to the sampler in |mask|.
+// CLK_ADDRESS_NONE becomes VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, as the
+// coordinates are then expected to be in range, and the border color is
+// always VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK.
+VulkanSamplerState GetVulkanSamplerState(uint32_t mask);
+
 } // namespace clspv
 
 #endif // CLSPV_INCLUDE_CLSPV_SAMPLER_H_
@@ -15,6 +15,7 @@
 #ifndef CLSPV_INCLUDE_CLSPV_SPEC_CONSTANT_H_
 #define CLSPV_INCLUDE_CLSPV_SPEC_CONSTANT_H_
 
+#include <cstdint>
 #include <string>
 
 namespace clspv {
@@ -32,6 +33,21 @@ enum class SpecConstant : int {
   kGlobalOffsetX,
   kGlobalOffsetY,
   kGlobalOffsetZ,
+  // POD kernel argument, see -pod-spec-constants.
+  kPodArgument,
+};
+
+// Name of the non-semantic extended instruction set reporting the POD
+// arguments read from specialization constants. It sits next to
+// NonSemantic.ClspvReflection, whose grammar is owned by SPIRV-Headers.
+const char kPodSpecConstantImportName[] = "NonSemantic.ClspvPodSpecConstant.1";
+
+// Instructions of that set. Their operands are ids of 32-bit integer
+// constants unless noted.
+enum PodSpecConstantExtInst : uint32_t {
+  // Operands: the ClspvReflection Kernel instruction, the argument ordinal and
+  // the spec id of the specialization constant holding its value.
+  kPodSpecConstantArgument = 1,
 };
 
 // Converts an SpecConstant to its string name.
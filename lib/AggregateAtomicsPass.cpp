@@ -0,0 +1,232 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Aggregates atomic additions to a subgroup-uniform address, for
+// -subgroup-atomic-aggregation.
+//
+// A kernel such as
+//   if (keep) out[atomic_inc(&count[0])] = value;
+// performs one atomic per invocation on the same counter. When every
+// invocation of a subgroup adds to the same address, the subgroup instead
+// sums its values with a reduction, and only its lowest active invocation
+// performs the atomic:
+//   %id = get_sub_group_local_id()
+//   %leader = sub_group_reduce_min(%id)
+//   %total = sub_group_reduce_add(%value)
+//   br (%id == %leader), label %then, label %tail
+// then:
+//   %old = atomicrmw add %ptr, %total
+// tail:
+// When the result is used, each invocation gets the value it would have seen
+// had the invocations of the subgroup performed their atomic in order:
+//   %base = sub_group_broadcast(phi [%old, %then], [undef, ...], %leader)
+//   %result = %base + sub_group_scan_exclusive_add(%value)
+//
+// This handles 32-bit atomic_add, atomic_sub, atomic_inc, atomic_dec and
+// their atomic_fetch_* counterparts.
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+#include "spirv/unified1/spirv.hpp"
+
+#include "clspv/Option.h"
+
+#include "Builtins.h"
+#include "Passes.h"
+#include "SPIRVOp.h"
+#include "UniformityAnalysis.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "AggregateAtomics"
+
+STATISTIC(NumAggregated, "Number of atomics aggregated per subgroup");
+
+namespace {
+struct AggregateAtomicsPass : public ModulePass {
+  static char ID;
+  AggregateAtomicsPass() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override;
+
+private:
+  // An atomic addition or subtraction of |Operand| to |Pointer|.
+  struct Atomic {
+    Instruction *Inst;
+    Value *Pointer;
+    Value *Operand;
+    bool IsSub;
+  };
+
+  // Returns true and fills |A| if |I| is an atomic |Aggregate| handles.
+  static bool Match(Instruction &I, Atomic *A);
+
+  // Replaces |A| by one atomic per subgroup.
+  void Aggregate(const Atomic &A);
+
+  // Returns the declaration of the OpenCL builtin |name| of type |type|.
+  Function *getBuiltin(Module &M, StringRef name, FunctionType *type);
+};
+} // namespace
+
+char AggregateAtomicsPass::ID = 0;
+INITIALIZE_PASS(AggregateAtomicsPass, "AggregateAtomics",
+                "Aggregate atomics on uniform addresses per subgroup", false,
+                false)
+
+namespace clspv {
+ModulePass *createAggregateAtomicsPass() { return new AggregateAtomicsPass(); }
+} // namespace clspv
+
+bool AggregateAtomicsPass::runOnModule(Module &M) {
+  if (!clspv::Option::SubgroupAtomicAggregation() ||
+      clspv::Option::SpvVersion() < clspv::Option::SPIRVVersion::SPIRV_1_3)
+    return false;
+
+  // Find all the candidates before changing anything, as the analysis does
+  // not follow the changes.
+  clspv::UniformityAnalysis Uniformity(M);
+  SmallVector<Atomic, 8> Atomics;
+  for (auto &F : M) {
+    for (auto &BB : F) {
+      for (auto &I : BB) {
+        Atomic A;
+        if (Match(I, &A) && Uniformity.isSubgroupUniform(A.Pointer))
+          Atomics.push_back(A);
+      }
+    }
+  }
+
+  for (auto &A : Atomics) {
+    Aggregate(A);
+    ++NumAggregated;
+  }
+  return !Atomics.empty();
+}
+
+bool AggregateAtomicsPass::Match(Instruction &I, Atomic *A) {
+  if (!I.getType()->isIntegerTy(32))
+    return false;
+
+  if (auto *RMW = dyn_cast<AtomicRMWInst>(&I)) {
+    if (RMW->isVolatile() || (RMW->getOperation() != AtomicRMWInst::Add &&
+                              RMW->getOperation() != AtomicRMWInst::Sub))
+      return false;
+    *A = {&I, RMW->getPointerOperand(), RMW->getValOperand(),
+          RMW->getOperation() == AtomicRMWInst::Sub};
+    return true;
+  }
+
+  auto *Call = dyn_cast<CallInst>(&I);
+  if (!Call || !Call->getCalledFunction() ||
+      clspv::Builtins::Lookup(Call->getCalledFunction()).getType() !=
+          clspv::Builtins::kSpirvOp)
+    return false;
+  // The operands are the opcode, the pointer, the scope, the semantics and,
+  // but for increments and decrements, the value.
+  auto *One = ConstantInt::get(I.getType(), 1);
+  switch (cast<ConstantInt>(Call->getArgOperand(0))->getZExtValue()) {
+  case spv::OpAtomicIAdd:
+    *A = {&I, Call->getArgOperand(1), Call->getArgOperand(4), false};
+    break;
+  case spv::OpAtomicISub:
+    *A = {&I, Call->getArgOperand(1), Call->getArgOperand(4), true};
+    break;
+  case spv::OpAtomicIIncrement:
+    *A = {&I, Call->getArgOperand(1), One, false};
+    break;
+  case spv::OpAtomicIDecrement:
+    *A = {&I, Call->getArgOperand(1), One, true};
+    break;
+  default:
+    return false;
+  }
+  // The subgroup must be within the scope of the atomic.
+  auto *Scope = dyn_cast<ConstantInt>(Call->getArgOperand(2));
+  return Scope && Scope->getZExtValue() <= spv::ScopeSubgroup;
+}
+
+void AggregateAtomicsPass::Aggregate(const Atomic &A) {
+  auto *I = A.Inst;
+  auto &M = *I->getModule();
+  auto *Int32Ty = Type::getInt32Ty(M.getContext());
+  auto *LocalIdTy = FunctionType::get(Int32Ty, false);
+  auto *UnaryTy = FunctionType::get(Int32Ty, {Int32Ty}, false);
+  auto *BinaryTy = FunctionType::get(Int32Ty, {Int32Ty, Int32Ty}, false);
+
+  IRBuilder<> Builder(I);
+  auto *LocalId = Builder.CreateCall(
+      getBuiltin(M, "_Z22get_sub_group_local_idv", LocalIdTy));
+  auto *Leader = Builder.CreateCall(
+      getBuiltin(M, "_Z20sub_group_reduce_minj", UnaryTy), {LocalId});
+  auto *Total = Builder.CreateCall(
+      getBuiltin(M, "_Z20sub_group_reduce_addj", UnaryTy), {A.Operand});
+  Value *Prefix = nullptr;
+  if (!I->use_empty()) {
+    Prefix = Builder.CreateCall(
+        getBuiltin(M, "_Z28sub_group_scan_exclusive_addj", UnaryTy),
+        {A.Operand});
+  }
+  auto *IsLeader = Builder.CreateICmpEQ(LocalId, Leader);
+  auto *Head = I->getParent();
+  auto *Then = SplitBlockAndInsertIfThen(IsLeader, I, false);
+
+  // The leader performs the atomic for the whole subgroup, with the same
+  // scope and semantics.
+  Instruction *Old = nullptr;
+  if (auto *RMW = dyn_cast<AtomicRMWInst>(I)) {
+    auto *NewRMW = cast<AtomicRMWInst>(RMW->clone());
+    NewRMW->setOperand(1, Total);
+    NewRMW->insertBefore(Then);
+    Old = NewRMW;
+  } else {
+    auto *Call = cast<CallInst>(I);
+    SmallVector<Attribute::AttrKind, 1> Kinds;
+    if (Call->getCalledFunction()->isConvergent())
+      Kinds.push_back(Attribute::Convergent);
+    Old = clspv::InsertSPIRVOp(
+        Then, A.IsSub ? spv::OpAtomicISub : spv::OpAtomicIAdd, Kinds,
+        Int32Ty,
+        {A.Pointer, Call->getArgOperand(2), Call->getArgOperand(3), Total});
+  }
+
+  if (Prefix) {
+    Builder.SetInsertPoint(I);
+    auto *Phi = Builder.CreatePHI(Int32Ty, 2);
+    Phi->addIncoming(Old, Then->getParent());
+    Phi->addIncoming(UndefValue::get(Int32Ty), Head);
+    auto *Base = Builder.CreateCall(
+        getBuiltin(M, "_Z19sub_group_broadcastjj", BinaryTy), {Phi, Leader});
+    auto *Result = A.IsSub ? Builder.CreateSub(Base, Prefix)
+                           : Builder.CreateAdd(Base, Prefix);
+    Result->takeName(I);
+    I->replaceAllUsesWith(Result);
+  }
+  I->eraseFromParent();
+}
+
+Function *AggregateAtomicsPass::getBuiltin(Module &M, StringRef name,
+                                           FunctionType *type) {
+  auto *Fn = cast<Function>(M.getOrInsertFunction(name, type).getCallee());
+  Fn->setConvergent();
+  Fn->setDoesNotThrow();
+  return Fn;
+}
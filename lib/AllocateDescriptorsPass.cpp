@@ -12,16 +12,20 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <climits>
 #include <string>
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
@@ -42,6 +46,11 @@ using namespace llvm;
 
 #define DEBUG_TYPE "allocatedescriptors"
 
+STATISTIC(NumCoherentResources, "Number of kernel arguments made coherent");
+STATISTIC(NumCoherenceAvoided,
+          "Number of kernel arguments only accessed at the invocation's own "
+          "element, and not made coherent");
+
 namespace {
 
 // Constant that represents bitfield for UniformMemory Memory Semantics from
@@ -57,6 +66,147 @@ cl::opt<bool> ShowDescriptors("show-desc", cl::init(false), cl::Hidden,
 
 using SamplerMapType = llvm::ArrayRef<std::pair<unsigned, std::string>>;
 
+// Returns the ordinal in the source of the argument |arg_index| of the kernel
+// |F|, which differs once POD arguments are clustered.
+unsigned SourceOrdinal(const Function &F, unsigned arg_index) {
+  if (auto *arg_map = F.getMetadata(clspv::KernelArgMapMetadataName())) {
+    for (const auto &op : arg_map->operands()) {
+      auto *arg_node = cast<MDNode>(op.get());
+      auto *new_index = mdconst::extract<ConstantInt>(arg_node->getOperand(2));
+      if (new_index->getSExtValue() == static_cast<int64_t>(arg_index))
+        return static_cast<unsigned>(
+            mdconst::extract<ConstantInt>(arg_node->getOperand(1))
+                ->getZExtValue());
+    }
+  }
+  return arg_index;
+}
+
+// An array index that is distinct for each invocation of a workgroup, given
+// the size of the workgroup is 1 in the other dimensions: a component of the
+// global or local invocation ID, plus an offset that is the same for the
+// whole workgroup.
+struct InvocationIndex {
+  const GlobalVariable *builtin = nullptr;
+  uint64_t dim = 0;
+  const Value *offset = nullptr;
+
+  bool operator==(const InvocationIndex &other) const {
+    return builtin == other.builtin && dim == other.dim &&
+           offset == other.offset;
+  }
+  bool operator!=(const InvocationIndex &other) const {
+    return !(*this == other);
+  }
+};
+
+// Returns the invocation ID builtin variable |V| is, or nullptr.
+const GlobalVariable *AsInvocationIdBuiltin(const Value *V) {
+  auto *GV = dyn_cast<GlobalVariable>(V);
+  if (GV && (GV->getName() == "__spirv_GlobalInvocationId" ||
+             GV->getName() == "__spirv_LocalInvocationId"))
+    return GV;
+  return nullptr;
+}
+
+// Returns true if |V|, an index offset, is the same for all the invocations of
+// a workgroup: a constant, a scalar kernel argument or a push constant.
+bool IsWorkgroupUniformOffset(const Value *V) {
+  if (isa<Constant>(V))
+    return true;
+  if (auto *arg = dyn_cast<Argument>(V))
+    return !arg->getType()->isPointerTy() &&
+           arg->getParent()->getCallingConv() == CallingConv::SPIR_KERNEL;
+  if (auto *load = dyn_cast<LoadInst>(V))
+    return load->getPointerAddressSpace() == clspv::AddressSpace::PushConstant;
+  return false;
+}
+
+// Returns true if |V| is a component of an invocation ID, and writes it to
+// |index|. Extensions and an added workgroup-uniform offset are looked
+// through.
+bool GetInvocationIndex(const Value *V, InvocationIndex *index) {
+  if (isa<ZExtInst>(V) || isa<SExtInst>(V))
+    V = cast<Instruction>(V)->getOperand(0);
+
+  if (auto *add = dyn_cast<BinaryOperator>(V)) {
+    if (add->getOpcode() != Instruction::Add)
+      return false;
+    for (unsigned i = 0; i < 2; ++i) {
+      const Value *offset = add->getOperand(1 - i);
+      if (IsWorkgroupUniformOffset(offset) &&
+          GetInvocationIndex(add->getOperand(i), index) && !index->offset) {
+        index->offset = offset;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // The component is loaded alone, or extracted from the loaded vector.
+  const ConstantInt *dim = nullptr;
+  if (auto *load = dyn_cast<LoadInst>(V)) {
+    auto *gep = dyn_cast<GEPOperator>(load->getPointerOperand());
+    if (!gep || gep->getNumIndices() != 2 ||
+        !AsInvocationIdBuiltin(gep->getPointerOperand()))
+      return false;
+    index->builtin = AsInvocationIdBuiltin(gep->getPointerOperand());
+    dim = dyn_cast<ConstantInt>(gep->getOperand(2));
+  } else if (auto *extract = dyn_cast<ExtractElementInst>(V)) {
+    auto *load = dyn_cast<LoadInst>(extract->getVectorOperand());
+    if (!load || !AsInvocationIdBuiltin(load->getPointerOperand()))
+      return false;
+    index->builtin = AsInvocationIdBuiltin(load->getPointerOperand());
+    dim = dyn_cast<ConstantInt>(extract->getIndexOperand());
+  }
+  if (!dim || dim->getZExtValue() > 2)
+    return false;
+  index->dim = dim->getZExtValue();
+  index->offset = nullptr;
+  return true;
+}
+
+// Returns true if the pointer |V| is only loaded from and stored to, directly
+// or through GEPs into the element it points to.
+bool OnlyAccessesElement(const Value *V) {
+  for (const User *user : V->users()) {
+    if (isa<LoadInst>(user))
+      continue;
+    if (auto *store = dyn_cast<StoreInst>(user)) {
+      if (store->getValueOperand() == V)
+        return false;
+      continue;
+    }
+    auto *gep = dyn_cast<GetElementPtrInst>(user);
+    if (!gep || !gep->hasAllConstantIndices() ||
+        !cast<ConstantInt>(gep->getOperand(1))->isZero() ||
+        !OnlyAccessesElement(gep))
+      return false;
+  }
+  return true;
+}
+
+// Returns a value identifying the Vulkan descriptor type of arguments of kind
+// |kind|.
+int DescriptorTypeClass(clspv::ArgKind kind) {
+  switch (kind) {
+  case clspv::ArgKind::Buffer:
+  case clspv::ArgKind::Pod:
+    return 0;
+  case clspv::ArgKind::BufferUBO:
+  case clspv::ArgKind::PodUBO:
+    return 1;
+  case clspv::ArgKind::SampledImage:
+    return 2;
+  case clspv::ArgKind::StorageImage:
+    return 3;
+  case clspv::ArgKind::Sampler:
+    return 4;
+  default:
+    return 5;
+  }
+}
+
 class AllocateDescriptorsPass final : public ModulePass {
 public:
   static char ID;
@@ -80,6 +230,9 @@ private:
   // changed the module.
   bool AllocateKernelArgDescriptors(Module &M);
 
+  // Allocate spec ids for the sizes of pointer-to-local kernel arguments, or
+  // fixed-size arrays for those given a size by -local-arg-size.  Returns true
+  // if we changed the module.
   bool AllocateLocalKernelArgSpecIds(Module &M);
 
   // Allocates the next descriptor set and resets the tracked binding number to
@@ -110,6 +263,13 @@ private:
   // instructions that can read or write to memory.
   std::pair<bool, bool> HasReadsAndWrites(Value *V);
 
+  // Returns true if the buffer |Arg| of the kernel |F| is only accessed at the
+  // element indexed by an invocation ID, the same one everywhere, including in
+  // the functions it is passed to. As the workgroup size of |F| is 1 in the
+  // other dimensions, no invocation then reads what another one wrote, and the
+  // buffer does not need to be coherent despite barriers.
+  bool HasInvocationPrivateAccesses(Function *F, Argument *Arg);
+
   // Cache for which functions' call trees contain a global barrier.
   DenseMap<Function *, bool> barrier_map_;
 
@@ -253,7 +413,7 @@ bool AllocateDescriptorsPass::AllocateLiteralSamplerDescriptors(Module &M) {
   DenseMap<unsigned, unsigned> index_for_value;
   unsigned index = 0;
   if (!sampler_map_.empty()) {
-    for (auto sampler_info : sampler_map_) {
+    for (const auto &sampler_info : sampler_map_) {
       const unsigned value = sampler_info.first;
       const std::string &expr = sampler_info.second;
       if (0 == binding_for_value.count(value)) {
@@ -387,6 +547,10 @@ bool AllocateDescriptorsPass::AllocateKernelArgDescriptors(Module &M) {
   // resourcee variable.
   const bool always_distinct_image_sampler =
       clspv::Option::HackDistinctImageSampler();
+  // With a shared layout, a binding must have the same descriptor type in
+  // every kernel, so arguments at the same index only share a binding when
+  // their descriptor types match.
+  const bool shared_layout = clspv::Option::SharedDescriptorLayout();
 
   // Bookkeeping:
   //  - Each discriminant remembers which functions use it.
@@ -413,6 +577,10 @@ bool AllocateDescriptorsPass::AllocateKernelArgDescriptors(Module &M) {
   // This is in module-order.
   SmallVector<Function *, 3> kernels_with_bodies;
 
+  // Maps the accessor of each storage buffer variable to whether all the
+  // kernel arguments it replaces are restrict (noalias).
+  DenseMap<Function *, bool> restrict_var_fns;
+
   int num_image_sampler_arguments = 0;
   for (Function &F : M) {
     // Only scan arguments of kernel functions that have bodies.
@@ -451,6 +619,12 @@ bool AllocateDescriptorsPass::AllocateKernelArgDescriptors(Module &M) {
         bool writes = false;
         std::tie(reads, writes) = HasReadsAndWrites(&Arg);
         coherent = (reads && writes) ? 1 : 0;
+        if (coherent && arg_kind == clspv::ArgKind::Buffer &&
+            HasInvocationPrivateAccesses(&F, &Arg)) {
+          coherent = 0;
+          ++NumCoherenceAvoided;
+        }
+        NumCoherentResources += coherent;
       }
 
       KernelArgDiscriminant key(argTy, arg_index, separation_token, coherent);
@@ -463,6 +637,12 @@ bool AllocateDescriptorsPass::AllocateKernelArgDescriptors(Module &M) {
         if (ShowDescriptors) {
           errs() << "DBA: skip pointer-to-local\n\n";
         }
+      } else if (clspv::Option::SkipUnusedKernelArgs() && Arg.use_empty()) {
+        // The runtime does not need to bind anything for this argument, and
+        // the bindings of the other arguments stay contiguous.
+        if (ShowDescriptors) {
+          errs() << "DBA: skip unused argument\n\n";
+        }
       } else {
         int index;
         auto where = discriminant_map.find(key);
@@ -499,9 +679,9 @@ bool AllocateDescriptorsPass::AllocateKernelArgDescriptors(Module &M) {
   // The kUnallocated descriptor set value means "not yet allocated".
   enum { kUnallocated = UINT_MAX };
   unsigned all_kernels_descriptor_set = kUnallocated;
-  // Map the arg index to the binding to use in the all-descriptors descriptor
-  // set.
-  DenseMap<int, unsigned> all_kernels_binding_for_arg_index;
+  // Map the arg index, and with a shared layout the descriptor type, to the
+  // binding to use in the all-descriptors descriptor set.
+  DenseMap<std::pair<int, int>, unsigned> all_kernels_binding_for_arg_index;
 
   // Maps a function to the list of set and binding to use, per argument.
   // For an argument that does not use a descriptor, its set and binding are
@@ -546,9 +726,11 @@ bool AllocateDescriptorsPass::AllocateKernelArgDescriptors(Module &M) {
           // This argument will map to a resource.
           unsigned set = kUnallocated;
           unsigned binding = kUnallocated;
+          const auto arg_kind = clspv::GetArgKind(*f_ptr->getArg(arg_index));
           const bool is_push_constant_arg =
-              clspv::GetArgKind(*f_ptr->getArg(arg_index)) ==
-              clspv::ArgKind::PodPushConstant;
+              arg_kind == clspv::ArgKind::PodPushConstant;
+          const std::pair<int, int> binding_key(
+              arg_index, shared_layout ? DescriptorTypeClass(arg_kind) : 0);
           if (always_single_kernel_descriptor ||
               functions_used_by_discriminant[info.index].size() ==
                   kernels_with_bodies.size() ||
@@ -566,10 +748,10 @@ bool AllocateDescriptorsPass::AllocateKernelArgDescriptors(Module &M) {
               }
               set = all_kernels_descriptor_set;
             }
-            auto where = all_kernels_binding_for_arg_index.find(arg_index);
+            auto where = all_kernels_binding_for_arg_index.find(binding_key);
             if (where == all_kernels_binding_for_arg_index.end()) {
               binding = all_kernels_binding_for_arg_index.size();
-              all_kernels_binding_for_arg_index[arg_index] = binding;
+              all_kernels_binding_for_arg_index[binding_key] = binding;
             } else {
               binding = where->second;
             }
@@ -790,6 +972,11 @@ bool AllocateDescriptorsPass::AllocateKernelArgDescriptors(Module &M) {
             var_fn, {set_arg, binding_arg, arg_kind_arg, arg_index_arg,
                      discriminant_index_arg, coherent_arg});
 
+        if (arg_kind == clspv::ArgKind::Buffer) {
+          auto inserted = restrict_var_fns.try_emplace(var_fn, true);
+          inserted.first->second &= Arg.hasNoAliasAttr();
+        }
+
         Value *replacement = nullptr;
         Value *zero = Builder.getInt32(0);
         switch (arg_kind) {
@@ -839,6 +1026,16 @@ bool AllocateDescriptorsPass::AllocateKernelArgDescriptors(Module &M) {
       arg_index++;
     }
   }
+
+  // The variables are decorated Restrict or Aliased by the SPIR-V producer.
+  for (auto &entry : restrict_var_fns) {
+    if (entry.second) {
+      entry.first->setMetadata(
+          clspv::RestrictMetadataName(),
+          MDNode::get(M.getContext(), ArrayRef<Metadata *>()));
+    }
+  }
+
   return Changed;
 }
 
@@ -898,7 +1095,37 @@ bool AllocateDescriptorsPass::AllocateLocalKernelArgSpecIds(Module &M) {
     for (Argument &Arg : F.args()) {
       Type *argTy = Arg.getType();
       const auto arg_kind = clspv::GetArgKind(Arg);
-      if (arg_kind == clspv::ArgKind::Local) {
+      const uint32_t static_size =
+          arg_kind == clspv::ArgKind::Local
+              ? clspv::Option::LocalArgSize(F.getName().str(),
+                                            SourceOrdinal(F, arg_index))
+              : 0;
+      if (static_size) {
+        // The size is known, so back the argument with a Workgroup array like
+        // a __local variable of the kernel. It is not given a SpecId and is
+        // left out of the reflection.
+        auto *elem_ty = argTy->getPointerElementType();
+        const uint64_t elem_size = M.getDataLayout().getTypeAllocSize(elem_ty);
+        auto *array_ty = ArrayType::get(
+            elem_ty, std::max<uint64_t>(1, (static_size + elem_size - 1) /
+                                               elem_size));
+        auto *var = new GlobalVariable(
+            M, array_ty, false, GlobalValue::InternalLinkage,
+            UndefValue::get(array_ty), F.getName() + "." + Arg.getName(),
+            nullptr, GlobalValue::NotThreadLocal,
+            argTy->getPointerAddressSpace());
+
+        if (ShowDescriptors) {
+          outs() << "DBA: " << F.getName() << " arg " << arg_index << " " << Arg
+                 << " allocated " << *array_ty << "\n";
+        }
+
+        auto *zero = Builder.getInt32(0);
+        auto *replacement = Builder.Insert(
+            GetElementPtrInst::CreateInBounds(array_ty, var, {zero, zero}));
+        Arg.replaceAllUsesWith(replacement);
+        Changed = true;
+      } else if (arg_kind == clspv::ArgKind::Local) {
         // Assign a SpecId to this argument.
         int spec_id = GetSpecId(Arg.getType());
 
@@ -1111,3 +1338,61 @@ std::pair<bool, bool> AllocateDescriptorsPass::HasReadsAndWrites(Value *V) {
 
   return std::make_pair(read, write);
 }
+
+bool AllocateDescriptorsPass::HasInvocationPrivateAccesses(Function *F,
+                                                           Argument *Arg) {
+  InvocationIndex index;
+  Type *element_type = nullptr;
+  DenseSet<Value *> visited;
+  SmallVector<Value *, 8> worklist{Arg};
+  while (!worklist.empty()) {
+    Value *pointer = worklist.pop_back_val();
+    if (!visited.insert(pointer).second)
+      continue;
+
+    for (User *user : pointer->users()) {
+      if (auto *call = dyn_cast<CallInst>(user)) {
+        // Follow the buffer into the functions it is passed to.
+        auto *callee = call->getCalledFunction();
+        if (!callee || callee->isDeclaration())
+          return false;
+        for (unsigned i = 0; i < call->arg_size(); ++i) {
+          if (call->getArgOperand(i) == pointer)
+            worklist.push_back(callee->getArg(i));
+        }
+        continue;
+      }
+
+      auto *gep = dyn_cast<GetElementPtrInst>(user);
+      if (!gep || gep->getPointerOperand() != pointer)
+        return false;
+      InvocationIndex gep_index;
+      if (!GetInvocationIndex(gep->getOperand(1), &gep_index))
+        return false;
+      for (unsigned i = 2; i < gep->getNumOperands(); ++i) {
+        if (!isa<ConstantInt>(gep->getOperand(i)))
+          return false;
+      }
+      if (element_type && (gep_index != index ||
+                           gep->getSourceElementType() != element_type))
+        return false;
+      if (!OnlyAccessesElement(gep))
+        return false;
+      index = gep_index;
+      element_type = gep->getSourceElementType();
+    }
+  }
+  if (!element_type)
+    return false;
+
+  // Each invocation of the workgroup must have its own index.
+  auto *size = F->getMetadata("reqd_work_group_size");
+  if (!size)
+    return false;
+  for (unsigned i = 0; i < 3; ++i) {
+    if (i != index.dim &&
+        mdconst::extract<ConstantInt>(size->getOperand(i))->getZExtValue() != 1)
+      return false;
+  }
+  return true;
+}
@@ -12,11 +12,14 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <memory>
+
 #include "llvm/IR/CallingConv.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/Debug.h"
 #include "llvm/Support/MathExtras.h"
 
 #include "spirv/unified1/spirv.hpp"
@@ -34,6 +37,18 @@
 using namespace llvm;
 
 namespace {
+// What the POD arguments of a kernel need from each implementation.
+struct PodArgsRequirements {
+  Function *kernel = nullptr;
+  // Size of the clustered POD arguments, rounded up to 4 bytes.
+  uint64_t size = 0;
+  // The arguments can be a per-kernel push constant block: no arrays and the
+  // 8- and 16-bit types are supported in push constants.
+  bool per_kernel_push_constant = false;
+  // The arguments can be a uniform buffer.
+  bool ubo = false;
+};
+
 class AutoPodArgsPass : public ModulePass {
 public:
   static char ID;
@@ -42,8 +57,12 @@ public:
   bool runOnModule(Module &M) override;
 
 private:
-  // Decides the pod args implementation for each kernel individually.
-  void runOnFunction(Function &F);
+  // Returns the requirements of the pod args of kernel |F|.
+  PodArgsRequirements GetRequirements(Function &F);
+
+  // Decides the pod args implementation for each kernel of |M|, sharing the
+  // push constant budget with the module-wide push constants.
+  void SolveBudget(Module &M, ArrayRef<PodArgsRequirements> kernels);
 
   // Makes all kernels use |impl| for pod args.
   void AnnotateAllKernels(Module &M, clspv::PodArgImpl impl);
@@ -58,6 +77,9 @@ private:
   // Returns true if |type| contains a |width|-bit integer or floating-point
   // type. Does not look through pointer since we are dealing with pod args.
   bool ContainsSizedType(Type *type, uint32_t width) const;
+
+  // Layout of the types of the module being processed.
+  std::unique_ptr<clspv::TypeLayoutCache> layout_;
 };
 } // namespace
 
@@ -79,19 +101,24 @@ bool AutoPodArgsPass::runOnModule(Module &M) {
     return true;
   }
 
+  layout_.reset(new clspv::TypeLayoutCache(M));
+  SmallVector<PodArgsRequirements, 8> kernels;
   for (auto &F : M) {
     if (F.isDeclaration() || F.getCallingConv() != CallingConv::SPIR_KERNEL)
       continue;
 
-    runOnFunction(F);
+    kernels.push_back(GetRequirements(F));
   }
+  SolveBudget(M, kernels);
 
   return true;
 }
 
-void AutoPodArgsPass::runOnFunction(Function &F) {
+PodArgsRequirements AutoPodArgsPass::GetRequirements(Function &F) {
   auto &M = *F.getParent();
   const auto &DL = M.getDataLayout();
+  PodArgsRequirements requirements;
+  requirements.kernel = &F;
   SmallVector<Type *, 8> pod_types;
   bool satisfies_ubo = true;
   for (auto &Arg : F.args()) {
@@ -117,18 +144,19 @@ void AutoPodArgsPass::runOnFunction(Function &F) {
       // Only check individual arguments as clustering will fix the layout with
       // padding if necessary.
       satisfies_ubo &=
-          clspv::isValidExplicitLayout(M, struct_ty, spv::StorageClassUniform);
+          layout_->isValidExplicitLayout(struct_ty, spv::StorageClassUniform);
     }
   }
 
-  // Per-kernel push constant interface requires:
-  // 1. Clustered pod args.
-  // 2. No global push constants.
-  // 3. Args must fit in push constant size limit.
-  // 4. No arrays.
-  // 5. If 16-bit types are used, 16-bit push constants are supported.
-  // 6. If 8-bit types are used, 8-bit push constants are supported.
-  const auto pod_struct_ty = StructType::get(M.getContext(), pod_types);
+  requirements.ubo = satisfies_ubo;
+
+  // Per-kernel push constants additionally require no arrays and, if 8- or
+  // 16-bit types are used, 8- or 16-bit push constant support.
+  SmallVector<Type *, 8> ordered_pod_types;
+  for (unsigned i : clspv::PodArgsLayoutOrder(DL, pod_types)) {
+    ordered_pod_types.push_back(pod_types[i]);
+  }
+  const auto pod_struct_ty = StructType::get(M.getContext(), ordered_pod_types);
   const bool contains_array = ContainsArrayType(pod_struct_ty);
   const bool support_16bit_pc = !ContainsSizedType(pod_struct_ty, 16) ||
                                 clspv::Option::Supports16BitStorageClass(
@@ -136,58 +164,75 @@ void AutoPodArgsPass::runOnFunction(Function &F) {
   const bool support_8bit_pc = !ContainsSizedType(pod_struct_ty, 8) ||
                                clspv::Option::Supports8BitStorageClass(
                                    clspv::Option::StorageClass::kPushConstant);
+  requirements.per_kernel_push_constant =
+      support_16bit_pc && support_8bit_pc && !contains_array;
+
   // Align to 4 to use i32s.
-  const uint64_t pod_struct_size =
+  requirements.size =
       alignTo(DL.getTypeStoreSize(pod_struct_ty).getKnownMinSize(), 4);
-  const bool fits_push_constant =
-      pod_struct_size <= clspv::Option::MaxPushConstantsSize();
-  const bool satisfies_push_constant =
-      clspv::Option::ClusterPodKernelArgs() && support_16bit_pc &&
-      support_8bit_pc && fits_push_constant &&
-      !clspv::UsesGlobalPushConstants(M) && !contains_array;
-
-  // Global type-mangled push constants require:
-  // 1. Clustered pod args.
-  // 2. Args and global push constants must fit size limit.
-  // 3. Size / 4 must be less than max struct members.
-  //    (In order to satisfy SPIR-V limit).
+  return requirements;
+}
+
+void AutoPodArgsPass::SolveBudget(Module &M,
+                                  ArrayRef<PodArgsRequirements> kernels) {
+  const uint64_t budget = clspv::Option::MaxPushConstantsSize();
+
+  // The push constants declared by DeclarePushConstantsPass (global offset,
+  // region offset, global size, ...) are shared by every kernel and come
+  // first in the push constant block. The work dimensions and, without
+  // -global-offset-push-constant or non-uniform NDRange support, the global
+  // offset are specialization constants instead and use none of the budget.
+  const bool module_push_constants = clspv::UsesGlobalPushConstants(M);
+  const uint64_t module_size = clspv::GlobalPushConstantsSize(M);
+  LLVM_DEBUG(dbgs() << "Push constant budget: " << budget << " bytes, "
+                    << module_size << " used by the module\n");
+
+  // Leave some extra room for other push constants. The type-mangled struct
+  // has one i32 member per 4 bytes and must satisfy the SPIR-V limit on
+  // struct members.
+  const uint64_t max_struct_members = 0x3fff - 64;
+
+  // Every kernel that fits gets a push constant implementation, so as many
+  // kernels as possible need no POD buffer:
+  // 1. A per-kernel push constant block, when there are no module-wide push
+  //    constants since an entry point can only use one block.
+  // 2. The shared type-mangled block: the module-wide push constants followed
+  //    by the POD arguments. Its size is that of the largest kernel using it,
+  //    so each kernel fitting on its own keeps the whole block in budget.
+  // 3. UBO
+  // 4. SSBO
   //
   // Note: There is a potential tradeoff in representations. We could use
-  // either a packed or unpacked struct. A packed struct would allow more
-  // arguments to fit in the size limit, but potentially results in more
-  // instructions to undo the type-mangling. Currently we opt for an unpacked
-  // struct for two reasons:
+  // either a packed or unpacked struct for the shared block. A packed struct
+  // would allow more arguments to fit in the size limit, but potentially
+  // results in more instructions to undo the type-mangling. Currently we opt
+  // for an unpacked struct for two reasons:
   // 1. The offsets of individual members make more sense at a higher level and
   //    are consistent with other clustered implementations.
   // 2. The type demangling code is simpler (but may result in wasted space).
   //
   // TODO: We should generate a better pod struct by default (e.g. { i32, i8 }
-  // is preferable to { i8, i32 }). Also we could support packed structs as
-  // fallback to fit arguments depending on the performance cost.
-  const auto global_size = clspv::GlobalPushConstantsSize(M) + pod_struct_size;
-  const auto fits_global_size =
-      global_size <= clspv::Option::MaxPushConstantsSize();
-  // Leave some extra room for other push constants.
-  const uint64_t max_struct_members = 0x3fff - 64;
-  const auto enough_members = (global_size / 4) < max_struct_members;
-  const bool satisfies_global_push_constant =
-      clspv::Option::ClusterPodKernelArgs() && fits_global_size &&
-      enough_members;
-
-  // Priority:
-  // 1. Per-kernel push constant interface.
-  // 2. Global type mangled push constant interface.
-  // 3. UBO
-  // 4. SSBO
-  clspv::PodArgImpl impl = clspv::PodArgImpl::kSSBO;
-  if (satisfies_push_constant) {
-    impl = clspv::PodArgImpl::kPushConstant;
-  } else if (satisfies_global_push_constant) {
-    impl = clspv::PodArgImpl::kGlobalPushConstant;
-  } else if (satisfies_ubo) {
-    impl = clspv::PodArgImpl::kUBO;
+  // is preferable to { i8, i32 }), as -pack-pod-args does. Also we could
+  // support packed structs as fallback to fit arguments depending on the
+  // performance cost.
+  const bool clustered = clspv::Option::ClusterPodKernelArgs();
+  for (const auto &requirements : kernels) {
+    const uint64_t shared_size = module_size + requirements.size;
+    clspv::PodArgImpl impl = clspv::PodArgImpl::kSSBO;
+    if (clustered && !module_push_constants &&
+        requirements.per_kernel_push_constant && requirements.size <= budget) {
+      impl = clspv::PodArgImpl::kPushConstant;
+    } else if (clustered && shared_size <= budget &&
+               shared_size / 4 < max_struct_members) {
+      impl = clspv::PodArgImpl::kGlobalPushConstant;
+    } else if (requirements.ubo) {
+      impl = clspv::PodArgImpl::kUBO;
+    }
+    LLVM_DEBUG(dbgs() << requirements.kernel->getName() << ": "
+                      << requirements.size << " bytes of POD args, impl "
+                      << static_cast<uint32_t>(impl) << "\n");
+    AddMetadata(*requirements.kernel, impl);
   }
-  AddMetadata(F, impl);
 }
 
 void AutoPodArgsPass::AnnotateAllKernels(Module &M, clspv::PodArgImpl impl) {
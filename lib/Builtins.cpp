@@ -14,9 +14,15 @@
 
 #include "Builtins.h"
 
+#include <atomic>
 #include <cstdlib>
+#include <mutex>
 #include <unordered_map>
 
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Allocator.h"
+
 using namespace llvm;
 using namespace clspv;
 
@@ -265,15 +271,90 @@ bool Builtins::ParamTypeInfo::isSampler() const {
 ////  Lookup interface
 ////   - only demangle once for any name encountered
 ////////////////////////////////////////////////////////////////////////////////
-const Builtins::FunctionInfo &
-Builtins::Lookup(const std::string &mangled_name) {
-  static std::unordered_map<std::string, FunctionInfo> s_mangled_map;
-  auto fi = s_mangled_map.emplace(mangled_name, mangled_name);
-  return (*fi.first).second;
+namespace {
+// The memoized lookups are split into shards, each with its own lock, so that
+// compilations on different threads rarely contend.  Names are interned in
+// each shard's arena, and entries never move once inserted.
+struct LookupShard {
+  std::mutex mutex;
+  StringMap<Builtins::FunctionInfo, BumpPtrAllocator> map;
+};
+
+const unsigned kNumLookupShards = 16;
+
+LookupShard &GetLookupShard(StringRef mangled_name) {
+  static LookupShard shards[kNumLookupShards];
+  return shards[hash_value(mangled_name) % kNumLookupShards];
+}
+
+std::atomic<uint64_t> lookup_hits(0);
+std::atomic<uint64_t> lookup_misses(0);
+} // namespace
+
+const Builtins::FunctionInfo &Builtins::Lookup(StringRef mangled_name) {
+  auto &shard = GetLookupShard(mangled_name);
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto iter = shard.map.find(mangled_name);
+    if (iter != shard.map.end()) {
+      ++lookup_hits;
+      return iter->second;
+    }
+  }
+
+  // Demangle without holding the lock.  If another thread inserted the same
+  // name in the meantime, its entry is kept.
+  ++lookup_misses;
+  FunctionInfo info(mangled_name.str());
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  return shard.map.try_emplace(mangled_name, std::move(info)).first->second;
+}
+
+Builtins::LookupStats Builtins::GetLookupStats() {
+  LookupStats stats;
+  stats.hits = lookup_hits;
+  stats.misses = lookup_misses;
+  return stats;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // Generate a mangled name loosely based on Itanium mangling
+bool Builtins::IsRelaxedPrecisionBuiltin(BuiltinType type) {
+  switch (type) {
+  case kHalfCos:
+  case kNativeCos:
+  case kHalfDivide:
+  case kNativeDivide:
+  case kHalfExp:
+  case kNativeExp:
+  case kHalfExp2:
+  case kNativeExp2:
+  case kHalfExp10:
+  case kNativeExp10:
+  case kHalfLog:
+  case kNativeLog:
+  case kHalfLog2:
+  case kNativeLog2:
+  case kHalfLog10:
+  case kNativeLog10:
+  case kHalfPowr:
+  case kNativePowr:
+  case kHalfRecip:
+  case kNativeRecip:
+  case kHalfRsqrt:
+  case kNativeRsqrt:
+  case kHalfSin:
+  case kNativeSin:
+  case kHalfSqrt:
+  case kNativeSqrt:
+  case kHalfTan:
+  case kNativeTan:
+    return true;
+  default:
+    return false;
+  }
+}
+
 std::string Builtins::GetMangledFunctionName(const char *name, Type *type) {
   assert(name);
   std::string mangled_name =
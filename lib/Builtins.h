@@ -15,6 +15,7 @@
 #ifndef CLSPV_LIB_BUILTINS_H_
 #define CLSPV_LIB_BUILTINS_H_
 
+#include <cstdint>
 #include <string>
 
 #include "llvm/ADT/StringRef.h"
@@ -67,14 +68,28 @@ private:
 
 /// Primary Interface
 // returns a FunctionInfo representation of the mangled name
-const FunctionInfo &Lookup(const std::string &mangled_name);
-inline const FunctionInfo &Lookup(llvm::StringRef mangled_name) {
-  return Lookup(mangled_name.str());
+// Results are memoized for the whole process, and this is safe to call from
+// several threads at once.
+const FunctionInfo &Lookup(llvm::StringRef mangled_name);
+inline const FunctionInfo &Lookup(const std::string &mangled_name) {
+  return Lookup(llvm::StringRef(mangled_name));
 }
 inline const FunctionInfo &Lookup(llvm::Function *func) {
   return Lookup(func->getName());
 }
 
+// Counts of memoized lookups that found an existing entry (hits) and that had
+// to demangle the name (misses), since the start of the process.
+struct LookupStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+};
+LookupStats GetLookupStats();
+
+// Returns true if |type| is a half_ or native_ math builtin, whose precision
+// is implementation defined.
+bool IsRelaxedPrecisionBuiltin(BuiltinType type);
+
 // Generate a mangled name loosely based on Itanium mangled naming but
 // reversible by GetFromMangledName
 std::string GetMangledFunctionName(const char *name, llvm::Type *type);
@@ -24,6 +24,8 @@ enum BuiltinType {
   kType_Clspv_Start,
   kClspvResource,
   kClspvLocal,
+  kClspvPhysicalPointer,
+  kClspvPodSpecConstant,
   kSpirvOp,
   kSpirvAtomicXor,
   kSpirvCopyMemory,
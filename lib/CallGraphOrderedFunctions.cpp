@@ -12,7 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include <set>
+#include <algorithm>
 
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
@@ -24,19 +24,19 @@ using namespace llvm;
 
 namespace clspv {
 
-UniqueVector<Function *> CallGraphOrderedFunctions(Module &M) {
+SetVector<Function *> CallGraphOrderedFunctions(Module &M) {
   // Use a topological sort.
 
-  // Make an ordered list of all functions having bodies, with kernel entry
+  // Number all functions having bodies in module order, with kernel entry
   // points listed first.
-  UniqueVector<Function *> functions;
+  DenseMap<Function *, unsigned> order;
   SmallVector<Function *, 10> entry_points;
   for (Function &F : M) {
     if (F.isDeclaration()) {
       continue;
     }
     if (F.getCallingConv() == CallingConv::SPIR_KERNEL) {
-      functions.insert(&F);
+      order.try_emplace(&F, order.size());
       entry_points.push_back(&F);
     }
   }
@@ -46,60 +46,58 @@ UniqueVector<Function *> CallGraphOrderedFunctions(Module &M) {
       continue;
     }
     if (F.getCallingConv() != CallingConv::SPIR_KERNEL) {
-      functions.insert(&F);
+      order.try_emplace(&F, order.size());
     }
   }
 
-  // This will be a complete set of reveresed edges, i.e. with all pairs
-  // of (callee, caller).
-  using Edge = std::pair<unsigned, unsigned>;
-  auto make_edge = [&functions](Function *callee, Function *caller) {
-    return std::pair<unsigned, unsigned>{functions.idFor(callee),
-                                         functions.idFor(caller)};
-  };
-  std::set<Edge> reverse_edges;
-  // Map each function to the functions it calls, and populate |reverse_edges|.
-  std::map<Function *, SmallVector<Function *, 3>> calls_functions;
-  for (Function *callee : functions) {
-    for (auto &use : callee->uses()) {
+  // Map each function to the functions it calls.
+  DenseMap<Function *, SmallVector<Function *, 3>> calls_functions;
+  for (Function &callee : M) {
+    if (callee.isDeclaration()) {
+      continue;
+    }
+    for (auto &use : callee.uses()) {
       if (auto *call = dyn_cast<CallInst>(use.getUser())) {
         Function *caller = call->getParent()->getParent();
-        calls_functions[caller].push_back(callee);
-        reverse_edges.insert(make_edge(callee, caller));
+        calls_functions[caller].push_back(&callee);
       }
     }
   }
-  // Sort the callees in module-order.  This helps us produce a deterministic
-  // result.
+  // Sort the callees in module-order, without repeats.  This helps us produce
+  // a deterministic result.  Count the distinct callers of each function.
+  DenseMap<Function *, unsigned> num_callers;
   for (auto &pair : calls_functions) {
     auto &callees = pair.second;
     std::sort(callees.begin(), callees.end(),
-              [&functions](Function *lhs, Function *rhs) {
-                return functions.idFor(lhs) < functions.idFor(rhs);
+              [&order](Function *lhs, Function *rhs) {
+                return order.lookup(lhs) < order.lookup(rhs);
               });
+    callees.erase(std::unique(callees.begin(), callees.end()), callees.end());
+    for (auto *callee : callees) {
+      ++num_callers[callee];
+    }
   }
 
   // Use Kahn's algorithm for topoological sort.
-  UniqueVector<Function *> result;
+  SetVector<Function *> result;
   SmallVector<Function *, 10> work_list(entry_points.begin(),
                                         entry_points.end());
   while (!work_list.empty()) {
-    Function *caller = work_list.back();
-    work_list.pop_back();
+    Function *caller = work_list.pop_back_val();
     result.insert(caller);
-    auto &callees = calls_functions[caller];
-    for (auto *callee : callees) {
-      reverse_edges.erase(make_edge(callee, caller));
-      auto lower_bound = reverse_edges.lower_bound(make_edge(callee, nullptr));
-      if (lower_bound == reverse_edges.end() ||
-          lower_bound->first != functions.idFor(callee)) {
+    auto where = calls_functions.find(caller);
+    if (where == calls_functions.end()) {
+      continue;
+    }
+    for (auto *callee : where->second) {
+      if (--num_callers[callee] == 0) {
         // Callee has no other unvisited callers.
         work_list.push_back(callee);
       }
     }
   }
-  // If reverse_edges is not empty then there was a cycle.  But we don't care
-  // about that erroneous case.
+  // If some function still has unvisited callers then there was a cycle.  But
+  // we don't care about that erroneous case.
 
   return result;
 }
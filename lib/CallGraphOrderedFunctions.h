@@ -12,7 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include "llvm/ADT/UniqueVector.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Module.h"
 
@@ -22,6 +22,6 @@ namespace clspv {
 // callers appear before callees.  OpenCL C does not permit recursion
 // or function or pointers, so this is always well defined.  The ordering
 // should be reproducible from one run to the next.
-llvm::UniqueVector<llvm::Function *> CallGraphOrderedFunctions(llvm::Module &M);
+llvm::SetVector<llvm::Function *> CallGraphOrderedFunctions(llvm::Module &M);
 
 } // namespace clspv
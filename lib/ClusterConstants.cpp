@@ -13,12 +13,20 @@
 // limitations under the License.
 
 // Cluster module-scope __constant variables.  But only if option
-// ModuleScopeConstantsInUniformBuffer is true.
+// ModuleScopeConstantsInUniformBuffer is true.  Small constants that are only
+// read are left out with -module-constants-inline-threshold.
+//
+// Variables with the same initializer share a member of the cluster. So does
+// a variable whose initializer is found within the initializer of another one,
+// e.g. a row of a larger table, or a run of elements of a larger array, such
+// as its trailing elements.
 
+#include <algorithm>
 #include <cassert>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallVector.h"
-#include "llvm/ADT/UniqueVector.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
@@ -33,6 +41,7 @@
 #include "clspv/Option.h"
 
 #include "ArgKind.h"
+#include "Constants.h"
 #include "NormalizeGlobalVariable.h"
 #include "Passes.h"
 
@@ -48,6 +57,122 @@ struct ClusterModuleScopeConstantVars : public ModulePass {
   bool runOnModule(Module &M) override;
 };
 
+// Returns true if |GV| is small enough to stay out of the cluster and is only
+// loaded from, directly or through GEPs. Such a lookup table is better emitted
+// as an initialized Private variable than read from the storage buffer.
+bool KeepInline(const DataLayout &DL, GlobalVariable &GV) {
+  const uint64_t threshold = clspv::Option::ModuleConstantsInlineThreshold();
+  if (threshold == 0 ||
+      DL.getTypeAllocSize(GV.getValueType()).getFixedSize() > threshold)
+    return false;
+
+  SmallVector<const User *, 8> worklist(GV.users());
+  while (!worklist.empty()) {
+    const User *user = worklist.pop_back_val();
+    if (isa<LoadInst>(user))
+      continue;
+    auto *gep = dyn_cast<GetElementPtrInst>(user);
+    if (!gep)
+      return false;
+    worklist.append(gep->user_begin(), gep->user_end());
+  }
+  return true;
+}
+
+// Where an initializer is found within the initializer of a member of the
+// clustered constant.
+struct SharedLocation {
+  // The initializer of the member.
+  Constant *host = nullptr;
+  // The indices leading from the member to the initializer, or to the array
+  // it is a run of elements of.
+  SmallVector<unsigned, 4> path;
+  // Set if the initializer is the elements of that array from |offset| on.
+  bool slice = false;
+  uint64_t offset = 0;
+};
+
+// Returns true if all the users of |GV| index into it as an array, so that
+// they can index into a larger array at an offset instead.
+bool CanSlice(GlobalVariable &GV) {
+  for (const User *user : GV.users()) {
+    auto *gep = dyn_cast<GetElementPtrInst>(user);
+    if (!gep || gep->getPointerOperand() != &GV || gep->getNumIndices() < 2)
+      return false;
+    auto *first = dyn_cast<ConstantInt>(gep->getOperand(1));
+    if (!first || !first->isZero())
+      return false;
+  }
+  return true;
+}
+
+// Returns true if the array |init| is the elements of the array |host| from
+// some offset on, which is written to |offset|. Trailing data are tried first.
+bool FindSlice(Constant *host, Constant *init, uint64_t *offset) {
+  auto *host_ty = cast<ArrayType>(host->getType());
+  auto *init_ty = cast<ArrayType>(init->getType());
+  const uint64_t host_size = host_ty->getNumElements();
+  const uint64_t init_size = init_ty->getNumElements();
+  if (host_ty->getElementType() != init_ty->getElementType() ||
+      host_size <= init_size)
+    return false;
+
+  auto *host_data = dyn_cast<ConstantDataSequential>(host);
+  auto *init_data = dyn_cast<ConstantDataSequential>(init);
+  for (uint64_t start = host_size - init_size + 1; start-- > 0;) {
+    bool match = true;
+    if (host_data && init_data) {
+      const uint64_t elem_size = host_data->getElementByteSize();
+      match = host_data->getRawDataValues()
+                  .substr(start * elem_size, init_size * elem_size)
+                  .equals(init_data->getRawDataValues());
+    } else {
+      for (uint64_t i = 0; match && i < init_size; ++i) {
+        match = host->getAggregateElement(start + i) ==
+                init->getAggregateElement(i);
+      }
+    }
+    if (match) {
+      *offset = start;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Looks for |init| within |host|, the initializer, or part of it, at |loc|.
+// Runs of array elements are only considered if |slice| is set. Updates |loc|
+// and returns true if it is found.
+bool FindWithin(Constant *host, Constant *init, bool slice,
+                SharedLocation *loc) {
+  if (host == init)
+    return true;
+  Type *host_ty = host->getType();
+  if (!host_ty->isArrayTy() && !host_ty->isStructTy())
+    return false;
+
+  if (slice && host_ty->isArrayTy() &&
+      FindSlice(host, init, &loc->offset)) {
+    loc->slice = true;
+    return true;
+  }
+
+  const unsigned num_elements = host_ty->isArrayTy()
+                                    ? host_ty->getArrayNumElements()
+                                    : host_ty->getStructNumElements();
+  for (unsigned i = 0; i < num_elements; ++i) {
+    Type *elem_ty = host_ty->isArrayTy() ? host_ty->getArrayElementType()
+                                         : host_ty->getStructElementType(i);
+    if (!elem_ty->isArrayTy() && !elem_ty->isStructTy())
+      continue;
+    loc->path.push_back(i);
+    if (FindWithin(host->getAggregateElement(i), init, slice, loc))
+      return true;
+    loc->path.pop_back();
+  }
+  return false;
+}
+
 } // namespace
 
 char ClusterModuleScopeConstantVars::ID = 0;
@@ -68,7 +193,7 @@ bool ClusterModuleScopeConstantVars::runOnModule(Module &M) {
   clspv::NormalizeGlobalVariables(M);
 
   SmallVector<GlobalVariable *, 8> global_constants;
-  UniqueVector<Constant *> initializers;
+  SetVector<Constant *> initializers;
   SmallVector<GlobalVariable *, 8> dead_global_constants;
   for (GlobalVariable &GV : M.globals()) {
     if (GV.hasInitializer() && GV.getType()->getPointerAddressSpace() ==
@@ -76,7 +201,7 @@ bool ClusterModuleScopeConstantVars::runOnModule(Module &M) {
       // Only keep live __constant variables.
       if (GV.use_empty()) {
         dead_global_constants.push_back(&GV);
-      } else {
+      } else if (!KeepInline(M.getDataLayout(), GV)) {
         global_constants.push_back(&GV);
         initializers.insert(GV.getInitializer());
       }
@@ -94,23 +219,64 @@ bool ClusterModuleScopeConstantVars::runOnModule(Module &M) {
 
     Changed = true;
 
-    // Make the struct type.
+    // An initializer can only be sliced out of a larger array if all the
+    // variables it initializes are indexed as arrays.
+    DenseMap<Constant *, bool> sliceable;
+    for (GlobalVariable *GV : global_constants) {
+      auto *init = GV->getInitializer();
+      bool can_slice = init->getType()->isArrayTy() && CanSlice(*GV);
+      auto inserted = sliceable.try_emplace(init, can_slice);
+      if (!inserted.second)
+        inserted.first->second &= can_slice;
+    }
+
+    // Look for each aggregate initializer within the larger ones that are
+    // members of the cluster, from the largest down.
+    const DataLayout &DL = M.getDataLayout();
+    SmallVector<Constant *, 8> by_size(initializers.begin(),
+                                       initializers.end());
+    std::stable_sort(by_size.begin(), by_size.end(),
+                     [&DL](Constant *lhs, Constant *rhs) {
+                       return DL.getTypeAllocSize(lhs->getType()) >
+                              DL.getTypeAllocSize(rhs->getType());
+                     });
+    DenseMap<Constant *, SharedLocation> shared;
+    SmallVector<Constant *, 8> hosts;
+    for (Constant *init : by_size) {
+      if (init->getType()->isArrayTy() || init->getType()->isStructTy()) {
+        SharedLocation loc;
+        auto found = std::find_if(hosts.begin(), hosts.end(), [&](Constant *h) {
+          loc = SharedLocation();
+          return FindWithin(h, init, sliceable[init], &loc);
+        });
+        if (found != hosts.end()) {
+          loc.host = *found;
+          shared[init] = loc;
+          continue;
+        }
+      }
+      hosts.push_back(init);
+    }
+
+    // Make the struct type. The members keep the order of the variables.
+    SmallVector<Constant *, 8> initializers_as_vec;
     SmallVector<Type *, 8> types;
-    types.reserve(initializers.size());
-    for (Value *init : initializers) {
-      Type *ty = init->getType();
-      types.push_back(ty);
+    DenseMap<Constant *, unsigned> member_index;
+    for (Constant *init : initializers) {
+      if (shared.count(init))
+        continue;
+      member_index[init] = initializers_as_vec.size();
+      initializers_as_vec.push_back(init);
+      types.push_back(init->getType());
     }
     StructType *type = StructType::get(Context, types);
 
     // Make the global variable.
-    SmallVector<Constant *, 8> initializers_as_vec(initializers.begin(),
-                                                   initializers.end());
     Constant *clustered_initializer =
         ConstantStruct::get(type, initializers_as_vec);
     GlobalVariable *clustered_gv = new GlobalVariable(
         M, type, true, GlobalValue::InternalLinkage, clustered_initializer,
-        "clspv.clustered_constants", nullptr,
+        clspv::ClusteredConstantsName(), nullptr,
         GlobalValue::ThreadLocalMode::NotThreadLocal,
         clspv::AddressSpace::Constant);
     assert(clustered_gv);
@@ -120,14 +286,40 @@ bool ClusterModuleScopeConstantVars::runOnModule(Module &M) {
     IRBuilder<> Builder(Context);
     Value *zero = Builder.getInt32(0);
     for (GlobalVariable *GV : global_constants) {
+      // The indices from the clustered constant to the data of |GV|, or to
+      // the array they are a slice of.
+      auto *init = GV->getInitializer();
+      auto loc = shared.find(init);
+      SmallVector<Value *, 8> indices{zero};
+      if (loc == shared.end()) {
+        indices.push_back(Builder.getInt32(member_index[init]));
+      } else {
+        indices.push_back(Builder.getInt32(member_index[loc->second.host]));
+        for (unsigned index : loc->second.path)
+          indices.push_back(Builder.getInt32(index));
+      }
+
       SmallVector<User *, 8> users(GV->users());
       for (User *user : users) {
         if (GV == user) {
           // This is the original global variable declaration.  Skip it.
+        } else if (loc != shared.end() && loc->second.slice) {
+          // Index into the larger array at the offset of the slice.
+          auto *gep = cast<GetElementPtrInst>(user);
+          IRBuilder<> GEPBuilder(gep);
+          SmallVector<Value *, 8> slice_indices(indices);
+          Value *index = gep->getOperand(2);
+          slice_indices.push_back(GEPBuilder.CreateAdd(
+              index, ConstantInt::get(index->getType(), loc->second.offset)));
+          slice_indices.append(gep->idx_begin() + 2, gep->idx_end());
+          Instruction *new_gep = GetElementPtrInst::CreateInBounds(
+              clustered_gv, slice_indices, "", gep);
+          new_gep->takeName(gep);
+          gep->replaceAllUsesWith(new_gep);
+          gep->eraseFromParent();
         } else if (auto *inst = dyn_cast<Instruction>(user)) {
-          unsigned index = initializers.idFor(GV->getInitializer()) - 1;
           Instruction *gep = GetElementPtrInst::CreateInBounds(
-              clustered_gv, {zero, Builder.getInt32(index)}, "", inst);
+              clustered_gv, indices, "", inst);
           user->replaceUsesOfWith(GV, gep);
         } else {
           errs() << "Don't know how to handle updating user of __constant: "
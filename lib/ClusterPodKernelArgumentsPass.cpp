@@ -47,6 +47,7 @@
 
 #include "ArgKind.h"
 #include "Constants.h"
+#include "Layout.h"
 #include "Passes.h"
 #include "PushConstant.h"
 
@@ -155,11 +156,11 @@ bool ClusterPodKernelArgumentsPass::runOnModule(Module &M) {
 
     SmallVector<Type *, 8> PtrArgTys;
     SmallVector<Type *, 8> PodArgTys;
+    SmallVector<Argument *, 8> PodArgs;
     SmallVector<ArgMapping, 8> RemapInfo;
     DenseMap<Argument *, unsigned> PodIndexMap;
     unsigned arg_index = 0;
     int new_index = 0;
-    unsigned pod_index = 0;
     for (Argument &Arg : F->args()) {
       Type *ArgTy = Arg.getType();
       if (isa<PointerType>(ArgTy)) {
@@ -168,12 +169,26 @@ bool ClusterPodKernelArgumentsPass::runOnModule(Module &M) {
         RemapInfo.push_back(
             {std::string(Arg.getName()), arg_index, new_index++, 0u, 0u, kind});
       } else {
-        PodIndexMap[&Arg] = pod_index++;
+        PodArgs.push_back(&Arg);
         PodArgTys.push_back(ArgTy);
       }
       arg_index++;
     }
 
+    // Place the POD arguments in the struct in layout order.
+    {
+      const auto Order =
+          clspv::PodArgsLayoutOrder(M.getDataLayout(), PodArgTys);
+      SmallVector<Argument *, 8> OrderedPodArgs;
+      PodArgTys.clear();
+      for (unsigned i : Order) {
+        PodIndexMap[PodArgs[i]] = OrderedPodArgs.size();
+        OrderedPodArgs.push_back(PodArgs[i]);
+        PodArgTys.push_back(PodArgs[i]->getType());
+      }
+      PodArgs = OrderedPodArgs;
+    }
+
     // Put the pointer arguments first, and then POD arguments struct last.
     // Use StructType::get so we reuse types where possible.
     auto PodArgsStructTy = StructType::get(Context, PodArgTys);
@@ -185,10 +200,8 @@ bool ClusterPodKernelArgumentsPass::runOnModule(Module &M) {
       const DataLayout DL(&M);
       const auto StructLayout = DL.getStructLayout(PodArgsStructTy);
       unsigned pod_index = 0;
-      for (auto &Arg : F->args()) {
-        auto arg_type = Arg.getType();
-        if (arg_type->isPointerTy())
-          continue;
+      for (auto *Arg : PodArgs) {
+        auto arg_type = Arg->getType();
 
         // The frontend has validated individual POD arguments. When the
         // unified struct is constructed, pad struct and array elements as
@@ -205,7 +218,7 @@ bool ClusterPodKernelArgumentsPass::runOnModule(Module &M) {
                    "Char in UBO struct without char support");
             // Fix the index for the offset of the argument.
             // Add char padding first.
-            PodIndexMap[&Arg] += num_ints + num_chars;
+            PodIndexMap[Arg] += num_ints + num_chars;
             for (size_t i = 0; i < num_chars; ++i) {
               PaddedPodArgTys.push_back(char_ty);
             }
@@ -433,9 +446,14 @@ ClusterPodKernelArgumentsPass::GetTypeMangledPodArgsStruct(Module &M) {
       }
     }
 
+    SmallVector<Type *, 8> OrderedPodArgTys;
+    for (unsigned i : clspv::PodArgsLayoutOrder(DL, PodArgTys)) {
+      OrderedPodArgTys.push_back(PodArgTys[i]);
+    }
+
     // TODO: The type-mangling code will need updated if we want to support
     // packed structs.
-    auto struct_ty = StructType::get(M.getContext(), PodArgTys);
+    auto struct_ty = StructType::get(M.getContext(), OrderedPodArgTys);
     uint64_t size = alignTo(DL.getTypeStoreSize(struct_ty), kIntBytes);
     if (size > max_pod_args_size)
       max_pod_args_size = size;
@@ -0,0 +1,255 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "clang/Basic/Version.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include "clspv/CompressedSPIRV.h"
+#include "clspv/clspv_revision.h"
+
+#include "CompileCache.h"
+
+using namespace llvm;
+
+namespace {
+
+// Bump this whenever the format of the entries changes. The key also covers
+// CLSPV_REVISION, the git revision clspv was built from, so that entries
+// written by another build of the compiler are not reused.
+const char *kCacheFormatVersion = "clspv-cache-2";
+
+const char *kEntryExtension = ".spvcache";
+
+// Returns the path of the entry for |key| in |dir|.
+SmallString<256> EntryPath(StringRef dir, StringRef key) {
+  SmallString<256> path(dir);
+  sys::path::append(path, key + kEntryExtension);
+  return path;
+}
+
+// Evicts the least recently used entries in |dir| until it holds at most
+// |max_size| bytes of entries.
+void Trim(StringRef dir, uint64_t max_size) {
+  struct Entry {
+    std::string path;
+    uint64_t size;
+    sys::TimePoint<> last_use;
+  };
+  std::vector<Entry> entries;
+  uint64_t total_size = 0;
+
+  std::error_code ec;
+  for (sys::fs::directory_iterator it(dir, ec), end; it != end && !ec;
+       it.increment(ec)) {
+    if (sys::path::extension(it->path()) != kEntryExtension)
+      continue;
+    sys::fs::file_status status;
+    if (sys::fs::status(it->path(), status))
+      continue;
+    entries.push_back(
+        {it->path(), status.getSize(), status.getLastModificationTime()});
+    total_size += status.getSize();
+  }
+
+  if (total_size <= max_size)
+    return;
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &lhs, const Entry &rhs) {
+              return lhs.last_use < rhs.last_use;
+            });
+  for (const auto &entry : entries) {
+    if (total_size <= max_size)
+      break;
+    // Another process may have removed the entry already.
+    sys::fs::remove(entry.path);
+    total_size -= entry.size;
+  }
+}
+
+} // namespace
+
+namespace clspv {
+namespace CompileCache {
+
+std::string Key(StringRef source, StringRef sampler_map,
+                ArrayRef<std::string> options) {
+  SHA1 hasher;
+  // Each field is followed by a separator that cannot appear in options, so
+  // that different splits of the same bytes produce different keys.
+  auto add = [&hasher](StringRef field) {
+    hasher.update(field);
+    hasher.update(StringRef("\0", 1));
+  };
+  add(kCacheFormatVersion);
+  add(CLSPV_REVISION);
+  add(clang::getClangFullRepositoryVersion());
+  add(utostr(source.size()));
+  add(source);
+  add(utostr(sampler_map.size()));
+  add(sampler_map);
+  for (const auto &option : options) {
+    add(option);
+  }
+  return toHex(hasher.final(), /*LowerCase=*/true);
+}
+
+std::string ReachableIR(const Module &module) {
+  // Walk the call graph from the kernels. Any function used as an operand
+  // counts as reachable, not only direct callees.
+  SmallPtrSet<const Function *, 32> reachable;
+  SmallVector<const Function *, 32> worklist;
+  for (const auto &F : module) {
+    if (F.getCallingConv() == CallingConv::SPIR_KERNEL &&
+        reachable.insert(&F).second)
+      worklist.push_back(&F);
+  }
+  while (!worklist.empty()) {
+    const Function *F = worklist.pop_back_val();
+    for (const auto &BB : *F) {
+      for (const auto &I : BB) {
+        for (const auto &op : I.operands()) {
+          if (auto *callee = dyn_cast<Function>(op->stripPointerCasts())) {
+            if (reachable.insert(callee).second)
+              worklist.push_back(callee);
+          }
+        }
+      }
+    }
+  }
+
+  ValueToValueMapTy VMap;
+  auto clone = CloneModule(module, VMap, [&reachable](const GlobalValue *GV) {
+    auto *F = dyn_cast<Function>(GV);
+    return !F || reachable.count(F);
+  });
+  // Unreachable functions are left as declarations; drop the unused ones so
+  // changing their signature does not change the text either.
+  for (auto iter = clone->begin(); iter != clone->end();) {
+    Function &F = *iter++;
+    if (F.isDeclaration() && F.use_empty())
+      F.eraseFromParent();
+  }
+  clone->setModuleIdentifier("");
+  clone->setSourceFileName("");
+
+  std::string text;
+  raw_string_ostream str(text);
+  clone->print(str, nullptr);
+  return str.str();
+}
+
+bool HasIncludeDirective(StringRef source) {
+  SmallVector<StringRef, 64> lines;
+  source.split(lines, '\n');
+  for (auto line : lines) {
+    line = line.ltrim();
+    if (!line.consume_front("#"))
+      continue;
+    if (line.ltrim().startswith("include"))
+      return true;
+  }
+  return false;
+}
+
+bool Lookup(StringRef dir, StringRef key, std::vector<char> *contents) {
+  const auto path = EntryPath(dir, key);
+  auto buffer = MemoryBuffer::getFile(path);
+  if (!buffer)
+    return false;
+
+  // SPIR-V entries are stored compressed. The buffer is word aligned.
+  const auto *start = (*buffer)->getBufferStart();
+  const size_t size = (*buffer)->getBufferSize();
+  if (clspv::IsCompressedSPIRV(start, size)) {
+    std::vector<uint32_t> words;
+    if (!clspv::DecompressSPIRV(start, size, &words))
+      return false;
+    const auto *bytes = reinterpret_cast<const char *>(words.data());
+    contents->assign(bytes, bytes + words.size() * sizeof(uint32_t));
+  } else {
+    contents->assign(start, start + size);
+  }
+
+  // Mark the entry as recently used for eviction.
+  int fd;
+  if (!sys::fs::openFileForWrite(path, fd, sys::fs::CD_OpenExisting,
+                                 sys::fs::OF_Append)) {
+    sys::fs::setLastAccessAndModificationTime(fd,
+                                              std::chrono::system_clock::now());
+    sys::Process::SafelyCloseFileDescriptor(fd);
+  }
+
+  return true;
+}
+
+void Store(StringRef dir, StringRef key, StringRef contents,
+           uint64_t max_size) {
+  if (sys::fs::create_directories(dir))
+    return;
+
+  SmallString<256> model(dir);
+  sys::path::append(model, key + "-%%%%%%%%.tmp");
+  int fd;
+  SmallString<256> temp_path;
+  if (sys::fs::createUniqueFile(model, fd, temp_path))
+    return;
+
+  // Compress SPIR-V entries to cut the cache I/O.
+  std::vector<char> compressed;
+  if (contents.size() % sizeof(uint32_t) == 0) {
+    std::vector<uint32_t> words(contents.size() / sizeof(uint32_t));
+    memcpy(words.data(), contents.data(), contents.size());
+    if (clspv::CompressSPIRV(words.data(), words.size(), /*entropy=*/true,
+                             &compressed))
+      contents = StringRef(compressed.data(), compressed.size());
+  }
+
+  {
+    raw_fd_ostream out(fd, /*shouldClose=*/true);
+    out << contents;
+    out.close();
+    if (out.has_error()) {
+      out.clear_error();
+      sys::fs::remove(temp_path);
+      return;
+    }
+  }
+
+  if (sys::fs::rename(temp_path, EntryPath(dir, key))) {
+    sys::fs::remove(temp_path);
+    return;
+  }
+
+  Trim(dir, max_size);
+}
+
+} // namespace CompileCache
+} // namespace clspv
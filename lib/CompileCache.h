@@ -0,0 +1,70 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_LIB_COMPILE_CACHE_H_
+#define CLSPV_LIB_COMPILE_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace llvm {
+class Module;
+} // namespace llvm
+
+namespace clspv {
+namespace CompileCache {
+
+// Returns the cache key of a compilation of |source| with the given sampler
+// map contents and command line options.  |options| should only contain the
+// options that affect the output of the compilation.  The key also covers the
+// git revision clspv was built from and the version of Clang.
+std::string Key(llvm::StringRef source, llvm::StringRef sampler_map,
+                llvm::ArrayRef<std::string> options);
+
+// Returns the textual IR of |module| restricted to what its kernels can
+// reach: global variables, metadata, the kernels and the functions in their
+// call-graph closure.  Edits that leave that part of the module unchanged,
+// such as comments, unused macros or changes to functions no kernel calls,
+// leave the text unchanged, so it can stand in for the source in Key.  The
+// text covers the whole program, as the cache stores one module per key, so
+// an edit to any reachable function changes it; ParallelOptimizePass caches
+// the optimizations of each kernel separately.
+std::string ReachableIR(const llvm::Module &module);
+
+// Returns true if |source| contains an #include directive.  The contents of
+// included files are not part of the key, so such compilations are not
+// cached.
+bool HasIncludeDirective(llvm::StringRef source);
+
+// Reads the entry for |key| in the cache directory |dir| into |contents|.
+// Returns true on a hit.  A hit marks the entry as recently used.
+bool Lookup(llvm::StringRef dir, llvm::StringRef key,
+            std::vector<char> *contents);
+
+// Stores |contents| as the entry for |key| in the cache directory |dir|,
+// then evicts the least recently used entries until the cache holds at most
+// |max_size| bytes.  The entry is written under a temporary name and renamed
+// into place, so processes may share the directory.  Failures are not
+// reported: the cache is only an optimization.
+void Store(llvm::StringRef dir, llvm::StringRef key, llvm::StringRef contents,
+           uint64_t max_size);
+
+} // namespace CompileCache
+} // namespace clspv
+
+#endif // CLSPV_LIB_COMPILE_CACHE_H_
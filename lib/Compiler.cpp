@@ -12,41 +12,70 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/Attr.h"
+#include "clang/AST/Decl.h"
 #include "clang/Basic/FileManager.h"
 #include "clang/Basic/TargetInfo.h"
+#include "clang/Basic/Version.h"
 #include "clang/CodeGen/CodeGenAction.h"
 #include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendActions.h"
 #include "clang/Frontend/FrontendPluginRegistry.h"
 #include "clang/Frontend/TextDiagnosticPrinter.h"
 #include "clang/Lex/PreprocessorOptions.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriterPass.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
 #include "llvm/InitializePasses.h"
 #include "llvm/LinkAllPasses.h"
+#include "llvm/Linker/Linker.h"
 #include "llvm/Support/Allocator.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/StringSaver.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/raw_ostream.h"
-#include "llvm/Transforms/IPO/PassManagerBuilder.h"
 
 #include "clspv/AddressSpace.h"
+#include "clspv/Compiler.h"
+#include "clspv/CompressedSPIRV.h"
 #include "clspv/Option.h"
 #include "clspv/Passes.h"
+#include "clspv/ReflectionSidecar.h"
 #include "clspv/Sampler.h"
 #include "clspv/opencl_builtins_header.h"
 
+#include "CompileCache.h"
+#include "Constants.h"
+#include "CostReport.h"
 #include "FrontendPlugin.h"
+#include "KernelSplitter.h"
+#include "PassStats.h"
 #include "Passes.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstring>
+#include <mutex>
 #include <numeric>
 #include <sstream>
 #include <string>
+#include <thread>
 
 using namespace clang;
 
@@ -118,9 +147,9 @@ static llvm::cl::list<std::string>
             llvm::cl::desc("Define a #define directive."), llvm::cl::ZeroOrMore,
             llvm::cl::value_desc("define"));
 
-static llvm::cl::opt<std::string>
-    InputFilename(llvm::cl::Positional, llvm::cl::desc("<input .cl file>"),
-                  llvm::cl::init("-"));
+static llvm::cl::list<std::string>
+    InputFilenames(llvm::cl::Positional, llvm::cl::desc("<input .cl files>"),
+                   llvm::cl::ZeroOrMore);
 
 static llvm::cl::opt<clang::Language> InputLanguage(
     "x", llvm::cl::desc("Select input type"),
@@ -132,17 +161,24 @@ static llvm::cl::opt<std::string>
     OutputFilename("o", llvm::cl::desc("Override output filename"),
                    llvm::cl::value_desc("filename"));
 
-static llvm::cl::opt<char>
-    OptimizationLevel(llvm::cl::Prefix, "O", llvm::cl::init('2'),
-                      llvm::cl::desc("Optimization level to use"),
-                      llvm::cl::value_desc("level"));
+static llvm::cl::opt<std::string> OptimizationLevel(
+    llvm::cl::Prefix, "O", llvm::cl::init("2"),
+    llvm::cl::desc("Optimization level to use: 0, 1, 2, 3, s, z, or fast to "
+                   "compile as quickly as possible"),
+    llvm::cl::value_desc("level"));
 
 static llvm::cl::opt<std::string> OutputFormat(
     "mfmt", llvm::cl::init(""),
     llvm::cl::desc(
-        "Specify special output format. 'c' is as a C initializer list"),
+        "Specify special output format. 'c' is as a C initializer list, "
+        "'cspv' as compressed SPIR-V with its reflection readable in place"),
     llvm::cl::value_desc("format"));
 
+static llvm::cl::opt<bool> CompressEntropy(
+    "cspv-entropy", llvm::cl::init(true),
+    llvm::cl::desc("Compress the instruction stream of -mfmt=cspv output with "
+                   "zlib when it is available and makes the output smaller."));
+
 static llvm::cl::opt<std::string>
     SamplerMap("samplermap", llvm::cl::desc("DEPRECATED - Literal sampler map"),
                llvm::cl::value_desc("filename"));
@@ -161,12 +197,210 @@ static llvm::cl::opt<bool>
 static llvm::cl::opt<std::string> IROutputFile(
     "emit-ir",
     llvm::cl::desc(
-        "Emit LLVM IR to the given file after parsing and stop compilation."),
+        "Emit LLVM IR to the given file after parsing and stop compilation. "
+        "The IR is written as bitcode if the file name ends in .bc."),
+    llvm::cl::value_desc("filename"));
+
+static llvm::cl::list<std::string> LinkBitcode(
+    "link-bitcode",
+    llvm::cl::desc(
+        "Link the functions the program uses from the given LLVM IR or "
+        "bitcode file, e.g. a helper library written by -emit-ir, before "
+        "running the clspv passes. May be given several times."),
+    llvm::cl::ZeroOrMore, llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<std::string> BuiltinsPCHDir(
+    "builtins-pch-dir",
+    llvm::cl::desc(
+        "Cache precompiled builtin headers in the given directory. The "
+        "builtin declarations are parsed once for each distinct set of "
+        "language options and defines, and loaded from the cache afterwards."),
+    llvm::cl::value_desc("directory"));
+
+static llvm::cl::opt<bool> DeclareOpenCLBuiltins(
+    "fdeclare-opencl-builtins", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Declare the OpenCL builtin functions from Clang's builtin table as "
+        "the program uses them, instead of parsing the declarations of every "
+        "overload from the builtin header. Cuts frontend time and memory, "
+        "mostly for small programs."));
+
+static llvm::cl::opt<std::string> CacheDir(
+    "cache-dir",
+    llvm::cl::desc(
+        "Cache compiled SPIR-V in the given directory, keyed on the source, "
+        "sampler map, options and compiler version.  Programs that #include "
+        "other files are not cached."),
+    llvm::cl::value_desc("directory"));
+
+static llvm::cl::opt<bool> CacheIR(
+    "cache-ir", llvm::cl::init(false),
+    llvm::cl::desc(
+        "With -cache-dir, also key the cache on the IR produced by the "
+        "frontend, restricted to the kernels and the functions they call. A "
+        "hit skips the clspv pass pipeline and SPIR-V generation, including "
+        "for edits that change the source but not that IR and for programs "
+        "that #include other files. On a miss, the LLVM optimizations of "
+        "each kernel and the functions it calls are also cached, so that "
+        "editing a helper only optimizes again the kernels that call it. The "
+        "clspv passes and SPIR-V generation still run on the whole "
+        "program."));
+
+static llvm::cl::opt<unsigned> CacheMaxSize(
+    "cache-max-size", llvm::cl::init(1024),
+    llvm::cl::desc("Maximum size of the compile cache in MiB. Least recently "
+                   "used entries are evicted beyond this size."),
+    llvm::cl::value_desc("MiB"));
+
+static llvm::cl::opt<std::string> PassStatsFile(
+    "pass-stats",
+    llvm::cl::desc(
+        "Write the wall time, and the IR instruction count, malloc usage and "
+        "basic block count before and after, of every pass in the pipeline "
+        "to the given file as JSON. A compilation answered from the cache "
+        "writes no pass and sets \"cache_hit\"."),
+    llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<std::string> ReflectionSidecarFile(
+    "reflection-sidecar",
+    llvm::cl::desc("Also write the reflection information of the module to "
+                   "the given file in the binary sidecar format of "
+                   "clspv/ReflectionSidecar.h."),
+    llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<std::string> CostReportFile(
+    "cost-report",
+    llvm::cl::desc("Write static statistics of the SPIR-V of every kernel, "
+                   "such as its instruction mix, memory operations by "
+                   "storage class and barriers, to the given file as JSON."),
+    llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<std::string> TargetProfile(
+    "target-profile",
+    llvm::cl::desc("Use the driver workarounds and code generation options "
+                   "suited to a family of drivers: conformant, "
+                   "uniform-standard-layout or compatible.  Options given "
+                   "explicitly override those of the profile."),
+    llvm::cl::value_desc("name"));
+
+static llvm::cl::opt<bool> SplitKernels(
+    "split-kernels", llvm::cl::init(false),
+    llvm::cl::desc("Write one SPIR-V module per kernel instead of a single "
+                   "module. The module of kernel K is written to "
+                   "<output>.K.spv and holds only what K uses."));
+
+static llvm::cl::opt<bool> ValidateOnly(
+    "validate-only", llvm::cl::init(false),
+    llvm::cl::desc("Only parse and check the program, as "
+                   "clspv::ValidateProgram does, and write the signature of "
+                   "each kernel to the output file, or to stdout if none is "
+                   "given, instead of compiling it."));
+
+static llvm::cl::opt<std::string> Manifest(
+    "manifest",
+    llvm::cl::desc("Compile the inputs listed in the given file, one "
+                   "'<input> <output>' pair per line, in this process. Empty "
+                   "lines and lines starting with '#' are ignored."),
     llvm::cl::value_desc("filename"));
 
+static llvm::cl::opt<unsigned> Jobs(
+    "j", llvm::cl::init(1),
+    llvm::cl::desc("Number of inputs to compile in parallel when several are "
+                   "given, directly or through -manifest. 0 uses one per "
+                   "hardware thread."),
+    llvm::cl::value_desc("N"));
+
+static llvm::cl::opt<unsigned> OptJobs(
+    "opt-jobs", llvm::cl::init(1),
+    llvm::cl::desc("Number of threads running the LLVM optimizations on the "
+                   "kernels of a program, each on its own group of kernels. "
+                   "0 uses one per hardware thread."),
+    llvm::cl::value_desc("N"));
+
+// Guards the option globals.  Options are parsed and then captured into the
+// per-compilation state while holding this, so compilations on other threads
+// never observe a partially parsed command line.
+std::mutex OptionParseMutex;
+
+// The values of the frontend and driver options above for a single
+// compilation.  These are copied out of the option globals while holding
+// OptionParseMutex.
+struct FrontendOptions {
+  FrontendOptions()
+      : cl_single_precision_constants(::cl_single_precision_constants),
+        cl_mad_enable(::cl_mad_enable),
+        cl_unsafe_math_optimizations(::cl_unsafe_math_optimizations),
+        cl_finite_math_only(::cl_finite_math_only),
+        cl_fast_relaxed_math(::cl_fast_relaxed_math),
+        Includes(::Includes.begin(), ::Includes.end()),
+        Defines(::Defines.begin(), ::Defines.end()),
+        InputFilename(::InputFilenames.empty() ? std::string("-")
+                                               : ::InputFilenames.front()),
+        InputFilenames(::InputFilenames.begin(), ::InputFilenames.end()),
+        InputLanguage(::InputLanguage),
+        OutputFilename(::OutputFilename),
+        OptimizationLevel(::OptimizationLevel), OutputFormat(::OutputFormat),
+        CompressEntropy(::CompressEntropy),
+        SamplerMap(::SamplerMap), verify(::verify),
+        IgnoreWarnings(::IgnoreWarnings), WarningsAsErrors(::WarningsAsErrors),
+        IROutputFile(::IROutputFile),
+        LinkBitcode(::LinkBitcode.begin(), ::LinkBitcode.end()),
+        BuiltinsPCHDir(::BuiltinsPCHDir),
+        DeclareOpenCLBuiltins(::DeclareOpenCLBuiltins),
+        CacheDir(::CacheDir), CacheIR(::CacheIR),
+        CacheMaxSize(::CacheMaxSize),
+        PassStatsFile(::PassStatsFile),
+        ReflectionSidecarFile(::ReflectionSidecarFile),
+        CostReportFile(::CostReportFile), SplitKernels(::SplitKernels),
+        ValidateOnly(::ValidateOnly), Manifest(::Manifest), Jobs(::Jobs),
+        OptJobs(::OptJobs) {}
+
+  bool cl_single_precision_constants;
+  bool cl_mad_enable;
+  bool cl_unsafe_math_optimizations;
+  bool cl_finite_math_only;
+  bool cl_fast_relaxed_math;
+  std::vector<std::string> Includes;
+  std::vector<std::string> Defines;
+  std::string InputFilename;
+  std::vector<std::string> InputFilenames;
+  clang::Language InputLanguage;
+  std::string OutputFilename;
+  std::string OptimizationLevel;
+  std::string OutputFormat;
+  bool CompressEntropy;
+  std::string SamplerMap;
+  bool verify;
+  bool IgnoreWarnings;
+  bool WarningsAsErrors;
+  std::string IROutputFile;
+  std::vector<std::string> LinkBitcode;
+  std::string BuiltinsPCHDir;
+  bool DeclareOpenCLBuiltins;
+  std::string CacheDir;
+  bool CacheIR;
+  unsigned CacheMaxSize;
+  std::string PassStatsFile;
+  std::string ReflectionSidecarFile;
+  std::string CostReportFile;
+  bool SplitKernels;
+  bool ValidateOnly;
+  std::string Manifest;
+  unsigned Jobs;
+  unsigned OptJobs;
+};
+
+// Appends the entries of the sampler map |contents| to |SamplerMapEntries|.
+// Returns 0 if successful.
+int ParseSamplerMapEntries(
+    llvm::StringRef contents,
+    llvm::SmallVectorImpl<std::pair<unsigned, std::string>>
+        *SamplerMapEntries);
+
 // Populates |SamplerMapEntries| with data from the input sampler map. Returns 0
 // if successful.
-int ParseSamplerMap(const std::string &sampler_map,
+int ParseSamplerMap(const FrontendOptions &options,
+                    const std::string &sampler_map,
                     llvm::SmallVectorImpl<std::pair<unsigned, std::string>>
                         *SamplerMapEntries) {
   std::unique_ptr<llvm::MemoryBuffer> samplerMapBuffer(nullptr);
@@ -175,19 +409,19 @@ int ParseSamplerMap(const std::string &sampler_map,
     samplerMapBuffer = llvm::MemoryBuffer::getMemBuffer(sampler_map);
 
     clspv::Option::SetUseSamplerMap(true);
-    if (!SamplerMap.empty()) {
+    if (!options.SamplerMap.empty()) {
       llvm::outs() << "Warning: -samplermap is ignored when the sampler map is "
                       "provided through a string.\n";
     }
-  } else if (!SamplerMap.empty()) {
+  } else if (!options.SamplerMap.empty()) {
     // Parse the sampler map from the option provided file.
     auto errorOrSamplerMapFile =
-        llvm::MemoryBuffer::getFile(SamplerMap.getValue());
+        llvm::MemoryBuffer::getFile(options.SamplerMap);
 
     // If there was an error in getting the sampler map file.
     if (!errorOrSamplerMapFile) {
       llvm::errs() << "Error: " << errorOrSamplerMapFile.getError().message()
-                   << " '" << SamplerMap.getValue() << "'\n";
+                   << " '" << options.SamplerMap << "'\n";
       return -1;
     }
 
@@ -208,13 +442,24 @@ int ParseSamplerMap(const std::string &sampler_map,
   if (!samplerMapBuffer || 0 == samplerMapBuffer->getBufferSize())
     return 0;
 
+  return ParseSamplerMapEntries(samplerMapBuffer->getBuffer(),
+                                SamplerMapEntries);
+}
+
+int ParseSamplerMapEntries(
+    llvm::StringRef contents,
+    llvm::SmallVectorImpl<std::pair<unsigned, std::string>>
+        *SamplerMapEntries) {
+  if (contents.empty())
+    return 0;
+
   llvm::SmallVector<llvm::StringRef, 3> samplerStrings;
 
   // We need to keep track of the beginning of the current entry.
-  const char *b = samplerMapBuffer->getBufferStart();
-  for (const char *i = b, *e = samplerMapBuffer->getBufferEnd();; i++) {
+  const char *b = contents.begin();
+  for (const char *i = b, *e = contents.end();; i++) {
     // If we have a separator between declarations.
-    if ((*i == '|') || (*i == ',') || (i == e)) {
+    if ((i == e) || (*i == '|') || (*i == ',')) {
       if (i == b) {
         llvm::errs() << "Error: Sampler map contained an empty entry!\n";
         return -1;
@@ -227,7 +472,7 @@ int ParseSamplerMap(const std::string &sampler_map,
     }
 
     // If we have a separator between declarations within a single sampler.
-    if ((*i == ',') || (i == e)) {
+    if ((i == e) || (*i == ',')) {
 
       clspv::SamplerNormalizedCoords NormalizedCoord =
           clspv::CLK_NORMALIZED_COORDS_NOT_SET;
@@ -352,31 +597,58 @@ int ParseSamplerMap(const std::string &sampler_map,
   return 0;
 }
 
-// Sets |instance|'s options for compiling. Returns 0 if successful.
+// Returns true if |buffer| holds LLVM bitcode.
+bool IsBitcode(llvm::StringRef buffer) {
+  return llvm::isBitcode(buffer.bytes_begin(), buffer.bytes_end());
+}
+
+// Reads the input file of |options| into |buffer|. LLVM IR input is first
+// read without a null terminator, which lets large bitcode files be mapped
+// rather than copied; only text IR needs the terminator. Returns 0 if
+// successful.
+int ReadInputFile(const FrontendOptions &options,
+                  std::unique_ptr<llvm::MemoryBuffer> *buffer) {
+  const bool ir = options.InputLanguage == clang::Language::LLVM_IR;
+  auto errorOrInputFile = llvm::MemoryBuffer::getFileOrSTDIN(
+      options.InputFilename, -1, /* RequiresNullTerminator = */ !ir);
+  if (errorOrInputFile && ir && options.InputFilename != "-" &&
+      !IsBitcode((*errorOrInputFile)->getBuffer())) {
+    errorOrInputFile = llvm::MemoryBuffer::getFile(options.InputFilename);
+  }
+
+  // If there was an error in getting the input file.
+  if (!errorOrInputFile) {
+    llvm::errs() << "Error: " << errorOrInputFile.getError().message() << " '"
+                 << options.InputFilename << "'\n";
+    return -1;
+  }
+  *buffer = std::move(errorOrInputFile.get());
+  return 0;
+}
+
+// Sets |instance|'s options for compiling. If |program| is empty, the input
+// file of |options| is compiled. Otherwise |program| is used without a copy;
+// unless it is bitcode, it must be followed by a null character. If
+// |builtins_pch| is non-empty, the builtin headers are loaded from that
+// precompiled header instead of being parsed. Returns 0 if successful.
 int SetCompilerInstanceOptions(CompilerInstance &instance,
+                               const FrontendOptions &options,
                                const llvm::StringRef &overiddenInputFilename,
                                const clang::FrontendInputFile &kernelFile,
-                               const std::string &program,
+                               llvm::StringRef program,
+                               const std::string &builtins_pch,
                                llvm::raw_string_ostream *diagnosticsStream) {
   std::unique_ptr<llvm::MemoryBuffer> memory_buffer(nullptr);
-  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> errorOrInputFile(nullptr);
   if (program.empty()) {
-    auto errorOrInputFile =
-        llvm::MemoryBuffer::getFileOrSTDIN(InputFilename.getValue());
-
-    // If there was an error in getting the input file.
-    if (!errorOrInputFile) {
-      llvm::errs() << "Error: " << errorOrInputFile.getError().message() << " '"
-                   << InputFilename.getValue() << "'\n";
-      return -1;
-    }
-    memory_buffer.reset(errorOrInputFile.get().release());
+    if (auto error = ReadInputFile(options, &memory_buffer))
+      return error;
   } else {
-    memory_buffer = llvm::MemoryBuffer::getMemBuffer(program.c_str(),
-                                                     overiddenInputFilename);
+    memory_buffer = llvm::MemoryBuffer::getMemBuffer(
+        program, overiddenInputFilename,
+        /* RequiresNullTerminator = */ !IsBitcode(program));
   }
 
-  if (verify) {
+  if (options.verify) {
     instance.getDiagnosticOpts().VerifyDiagnostics = true;
     instance.getDiagnosticOpts().VerifyPrefixes.push_back("expected");
   }
@@ -417,35 +689,40 @@ int SetCompilerInstanceOptions(CompilerInstance &instance,
   instance.getCodeGenOpts().SimplifyLibCalls = false;
   instance.getCodeGenOpts().EmitOpenCLArgMetadata = false;
   instance.getCodeGenOpts().DisableO0ImplyOptNone = true;
-  instance.getDiagnosticOpts().IgnoreWarnings = IgnoreWarnings;
+  if (clspv::Option::LeanMemory()) {
+    // The kernel argument names are then read from kernel_arg_name metadata.
+    instance.getCodeGenOpts().DiscardValueNames = true;
+    instance.getCodeGenOpts().EmitOpenCLArgMetadata = true;
+  }
+  instance.getDiagnosticOpts().IgnoreWarnings = options.IgnoreWarnings;
 
   instance.getLangOpts().SinglePrecisionConstants =
-      cl_single_precision_constants;
+      options.cl_single_precision_constants;
   // cl_denorms_are_zero ignored for now!
   // cl_fp32_correctly_rounded_divide_sqrt ignored for now!
   instance.getCodeGenOpts().LessPreciseFPMAD =
-      cl_mad_enable || cl_unsafe_math_optimizations;
+      options.cl_mad_enable || options.cl_unsafe_math_optimizations;
   // cl_no_signed_zeros ignored for now!
   instance.getLangOpts().UnsafeFPMath =
-      cl_unsafe_math_optimizations || cl_fast_relaxed_math;
+      options.cl_unsafe_math_optimizations || options.cl_fast_relaxed_math;
   instance.getLangOpts().FiniteMathOnly =
-      cl_finite_math_only || cl_fast_relaxed_math;
-  instance.getLangOpts().FastRelaxedMath = cl_fast_relaxed_math;
+      options.cl_finite_math_only || options.cl_fast_relaxed_math;
+  instance.getLangOpts().FastRelaxedMath = options.cl_fast_relaxed_math;
 
   // Preprocessor options
   if (!clspv::Option::ImageSupport()) {
     instance.getPreprocessorOpts().addMacroUndef("__IMAGE_SUPPORT__");
   }
-  if (cl_fast_relaxed_math) {
+  if (options.cl_fast_relaxed_math) {
     instance.getPreprocessorOpts().addMacroDef("__FAST_RELAXED_MATH__");
   }
 
-  for (auto define : Defines) {
+  for (auto define : options.Defines) {
     instance.getPreprocessorOpts().addMacroDef(define);
   }
 
   // Header search options
-  for (auto include : Includes) {
+  for (auto include : options.Includes) {
     instance.getHeaderSearchOpts().AddPath(include, clang::frontend::After,
                                            false, false);
   }
@@ -471,12 +748,15 @@ int SetCompilerInstanceOptions(CompilerInstance &instance,
   // programs in the wild.
   instance.getLangOpts().GNUInline = true;
 
+  // Let Sema declare the builtin overloads referenced by the program.
+  instance.getLangOpts().DeclareOpenCLBuiltins = options.DeclareOpenCLBuiltins;
+
   // Set up diagnostics
   instance.createDiagnostics(
       new clang::TextDiagnosticPrinter(*diagnosticsStream,
                                        &instance.getDiagnosticOpts()),
       true);
-  instance.getDiagnostics().setWarningsAsErrors(WarningsAsErrors);
+  instance.getDiagnostics().setWarningsAsErrors(options.WarningsAsErrors);
   instance.getDiagnostics().setEnableAllWarnings(true);
 
   instance.getTargetOpts().Triple = triple.str();
@@ -506,13 +786,32 @@ int SetCompilerInstanceOptions(CompilerInstance &instance,
       new OpenCLBuiltinMemoryBuffer(opencl_builtins_header_data,
                                     opencl_builtins_header_size - 1));
 
-  instance.getPreprocessorOpts().Includes.push_back("openclc.h");
-
   std::unique_ptr<llvm::MemoryBuffer> openCLBaseBuiltinMemoryBuffer(
       new OpenCLBuiltinMemoryBuffer(opencl_base_builtins_header_data,
                                     opencl_base_builtins_header_size - 1));
 
-  instance.getPreprocessorOpts().Includes.push_back("opencl-c-base.h");
+  // The builtins clspv adds, which openclc.h already holds. They are not in
+  // Clang's builtin table, so -fdeclare-opencl-builtins parses them from
+  // this header instead.
+  std::unique_ptr<llvm::MemoryBuffer> extraBuiltinMemoryBuffer(
+      new OpenCLBuiltinMemoryBuffer(opencl_extra_builtins_header_data,
+                                    opencl_extra_builtins_header_size - 1));
+
+  if (builtins_pch.empty()) {
+    if (options.DeclareOpenCLBuiltins) {
+      // opencl-c-base.h holds the types and macros the builtin table needs.
+      instance.getPreprocessorOpts().Includes.push_back("opencl-c-base.h");
+      instance.getPreprocessorOpts().Includes.push_back(
+          "clspv-extra-builtins.h");
+    } else {
+      instance.getPreprocessorOpts().Includes.push_back("openclc.h");
+      instance.getPreprocessorOpts().Includes.push_back("opencl-c-base.h");
+    }
+  } else {
+    // The virtual header files below are still required: the precompiled
+    // header refers to them.
+    instance.getPreprocessorOpts().ImplicitPCHInclude = builtins_pch;
+  }
 
   // Add the VULKAN macro.
   instance.getPreprocessorOpts().addMacroDef("VULKAN=100");
@@ -547,60 +846,205 @@ int SetCompilerInstanceOptions(CompilerInstance &instance,
   instance.getSourceManager().overrideFileContents(
       base_entry, std::move(openCLBaseBuiltinMemoryBuffer));
 
+  auto extra_entry = instance.getFileManager().getVirtualFile(
+      includePrefix + "clspv-extra-builtins.h",
+      extraBuiltinMemoryBuffer->getBufferSize(), 0);
+
+  instance.getSourceManager().overrideFileContents(
+      extra_entry, std::move(extraBuiltinMemoryBuffer));
+
+  return 0;
+}
+
+// Returns a hash of everything that affects the precompiled builtin headers:
+// the header contents, the version of Clang, and the options that change how
+// the headers are preprocessed or parsed. The hash is a SHA1, as for the
+// compile cache, so that it stays the same across runs and hosts.
+std::string BuiltinsPCHKey(const FrontendOptions &options) {
+  llvm::SHA1 hasher;
+  // Each field is followed by a separator so that different splits of the
+  // same bytes produce different keys.
+  auto add = [&hasher](llvm::StringRef field) {
+    hasher.update(field);
+    hasher.update(llvm::StringRef("\0", 1));
+  };
+  add(llvm::StringRef(opencl_builtins_header_data,
+                      opencl_builtins_header_size));
+  add(llvm::StringRef(opencl_base_builtins_header_data,
+                      opencl_base_builtins_header_size));
+  add(llvm::StringRef(opencl_extra_builtins_header_data,
+                      opencl_extra_builtins_header_size));
+  add(clang::getClangFullRepositoryVersion());
+  add(llvm::utostr(static_cast<unsigned>(clspv::Option::Language())));
+  for (bool flag :
+       {clspv::Option::ImageSupport(), options.cl_single_precision_constants,
+        options.cl_mad_enable, options.cl_unsafe_math_optimizations,
+        options.cl_finite_math_only, options.cl_fast_relaxed_math,
+        options.DeclareOpenCLBuiltins}) {
+    add(flag ? "1" : "0");
+  }
+  for (const auto &define : options.Defines) {
+    add(define);
+  }
+  return llvm::toHex(hasher.final(), /*LowerCase=*/true);
+}
+
+// Precompiles the builtin headers for the options of this compilation into
+// |pch_path|. The file is written under a temporary name and then renamed, so
+// that concurrent compilations sharing the directory never load a partially
+// written file. Returns 0 if successful.
+int GenerateBuiltinsPCH(const FrontendOptions &options,
+                        const std::string &pch_path) {
+  const llvm::StringRef pchSourceFilename = "clspv-builtins.h";
+  clang::CompilerInstance instance;
+  clang::FrontendInputFile pchSourceFile(
+      pchSourceFilename, clang::InputKind(clang::Language::OpenCL).getHeader());
+  std::string log;
+  llvm::raw_string_ostream diagnosticsStream(log);
+  if (auto error = SetCompilerInstanceOptions(instance, options,
+                                              pchSourceFilename, pchSourceFile,
+                                              "\n", "", &diagnosticsStream))
+    return error;
+
+  const std::string temp_path =
+      pch_path + "." + std::to_string(llvm::sys::Process::getProcessId()) +
+      "." + std::to_string(llvm::get_threadid()) + ".tmp";
+  instance.getFrontendOpts().OutputFile = temp_path;
+
+  clang::GeneratePCHAction action;
+  if (!action.BeginSourceFile(instance, pchSourceFile)) {
+    return -1;
+  }
+
+  auto result = action.Execute();
+  action.EndSourceFile();
+
+  clang::DiagnosticConsumer *const consumer =
+      instance.getDiagnostics().getClient();
+  consumer->finish();
+
+  if (result || consumer->getNumErrors() > 0) {
+    llvm::errs() << log;
+    llvm::sys::fs::remove(temp_path);
+    return -1;
+  }
+
+  if (auto ec = llvm::sys::fs::rename(temp_path, pch_path)) {
+    llvm::errs() << "Unable to write precompiled builtins '" << pch_path
+                 << "': " << ec.message() << '\n';
+    llvm::sys::fs::remove(temp_path);
+    return -1;
+  }
+
+  return 0;
+}
+
+// Sets |builtins_pch| to the precompiled builtin headers to use for this
+// compilation, generating them first if they are not in the cache yet. Leaves
+// |builtins_pch| empty if no cache directory was given. Returns 0 if
+// successful.
+int PrepareBuiltinsPCH(const FrontendOptions &options,
+                       std::string *builtins_pch) {
+  builtins_pch->clear();
+  if (options.BuiltinsPCHDir.empty() ||
+      options.InputLanguage != clang::Language::OpenCL) {
+    return 0;
+  }
+
+  if (auto ec = llvm::sys::fs::create_directories(options.BuiltinsPCHDir)) {
+    llvm::errs() << "Unable to create directory '" << options.BuiltinsPCHDir
+                 << "': " << ec.message() << '\n';
+    return -1;
+  }
+
+  llvm::SmallString<256> pch_path(options.BuiltinsPCHDir);
+  llvm::sys::path::append(pch_path,
+                          "clspv-builtins-" + BuiltinsPCHKey(options) + ".pch");
+
+  if (!llvm::sys::fs::exists(pch_path)) {
+    if (auto error = GenerateBuiltinsPCH(options, pch_path.str().str()))
+      return error;
+  }
+
+  *builtins_pch = pch_path.str().str();
   return 0;
 }
 
-// Populates |pm| with necessary passes to optimize and legalize the IR.
+// Populates |pm| with necessary passes to optimize and legalize the IR.  If
+// |binaryWords| is given, a binary module is produced directly into it;
+// otherwise the output is written to |binaryStream|.
 int PopulatePassManager(
-    llvm::legacy::PassManager *pm, llvm::raw_svector_ostream *binaryStream,
+    llvm::legacy::PassManager *pm, const FrontendOptions &options,
+    llvm::raw_svector_ostream *binaryStream,
+    std::vector<uint32_t> *binaryWords,
     llvm::SmallVectorImpl<std::pair<unsigned, std::string>>
         *SamplerMapEntries) {
-  llvm::PassManagerBuilder pmBuilder;
-
-  switch (OptimizationLevel) {
-  case '0':
-  case '1':
-  case '2':
-  case '3':
-  case 's':
-  case 'z':
-    break;
-  default:
-    llvm::errs() << "Unknown optimization level -O" << OptimizationLevel
+  // -Os and -Oz keep the optimization level of -O2.
+  unsigned OptLevel = 2;
+  unsigned SizeLevel = 0;
+
+  // -Ofast only runs the passes needed to produce valid SPIR-V, followed by
+  // cheap local cleanups, for runtimes compiling kernels on first use.
+  const bool fast_compile = options.OptimizationLevel == "fast";
+  if (!fast_compile && (options.OptimizationLevel.size() != 1 ||
+                        !strchr("0123sz", options.OptimizationLevel[0]))) {
+    llvm::errs() << "Unknown optimization level -O" << options.OptimizationLevel
                  << " specified!\n";
     return -1;
   }
 
-  switch (OptimizationLevel) {
+  switch (options.OptimizationLevel[0]) {
   case '0':
-    pmBuilder.OptLevel = 0;
+    OptLevel = 0;
     break;
   case '1':
-    pmBuilder.OptLevel = 1;
+    OptLevel = 1;
     break;
   case '2':
-    pmBuilder.OptLevel = 2;
+    OptLevel = 2;
     break;
   case '3':
-    pmBuilder.OptLevel = 3;
+    OptLevel = 3;
     break;
   case 's':
-    pmBuilder.SizeLevel = 1;
+    SizeLevel = 1;
     break;
   case 'z':
-    pmBuilder.SizeLevel = 2;
+    SizeLevel = 2;
+    break;
+  case 'f':
+    OptLevel = 0;
     break;
   default:
     break;
   }
 
+  // Fused kernels can be selected as entry points.
+  if (!clspv::Option::FuseKernels().empty()) {
+    pm->add(clspv::createFuseKernelsPass());
+  }
+  if (!clspv::Option::EntryPoints().empty()) {
+    pm->add(clspv::createSelectEntryPointsPass());
+  }
   pm->add(clspv::createZeroInitializeAllocasPass());
   pm->add(clspv::createAddFunctionAttributesPass());
+  // Before the LLVM unroller adds its own llvm.loop.unroll.disable hints.
+  pm->add(clspv::createMarkSourceLoopHintsPass());
+  if (clspv::Option::NarrowInt64Arithmetic()) {
+    // The arguments still have their ordinals.
+    pm->add(clspv::createAssumeInt64ArgRangesPass());
+  }
+  if (clspv::Option::PhysicalStorageBuffers()) {
+    pm->add(clspv::createPhysicalStorageBufferArgsPass());
+  }
+  if (!clspv::Option::PodSpecConstants().empty()) {
+    pm->add(clspv::createPodSpecConstantArgsPass());
+  }
   pm->add(clspv::createAutoPodArgsPass());
   pm->add(clspv::createDeclarePushConstantsPass());
   pm->add(clspv::createDefineOpenCLWorkItemBuiltinsPass());
 
-  if (0 < pmBuilder.OptLevel) {
+  if (0 < OptLevel) {
     pm->add(clspv::createOpenCLInlinerPass());
   }
 
@@ -633,6 +1077,9 @@ int PopulatePassManager(
   // could be handled. It should be run again after other optimizations (e.g
   // InlineFuncWithPointerBitCastArgPass).
   pm->add(clspv::createSimplifyPointerBitcastPass());
+  if (clspv::Option::WidenVec3Accesses()) {
+    pm->add(clspv::createWidenVec3AccessesPass());
+  }
   pm->add(clspv::createReplacePointerBitcastPass());
   pm->add(llvm::createDeadCodeEliminationPass());
 
@@ -649,13 +1096,22 @@ int PopulatePassManager(
     pm->add(clspv::createInlineFuncWithPointerBitCastArgPass());
     pm->add(clspv::createInlineFuncWithPointerToFunctionArgPass());
     pm->add(clspv::createInlineFuncWithSingleCallSitePass());
+    // Cost based inlining runs after the inlining required for legality.
+    if (!fast_compile && clspv::Option::InlineCostThreshold() != 0) {
+      pm->add(clspv::createInlineByCostPass());
+    }
   }
 
   if (clspv::Option::LanguageUsesGenericAddressSpace()) {
+    // Without -inline-entry-points, generic pointers can still cross calls.
+    // Specialize the callees so every function can be inferred on its own.
+    if (!clspv::Option::InlineEntryPoints()) {
+      pm->add(clspv::createSpecializeGenericAddressSpacePass());
+    }
     pm->add(llvm::createInferAddressSpacesPass(clspv::AddressSpace::Generic));
   }
 
-  if (0 == pmBuilder.OptLevel) {
+  if (0 == OptLevel) {
     // Mem2Reg pass should be run early because O0 level optimization leaves
     // redundant alloca, load and store instructions from function arguments.
     // clspv needs to remove them ahead of transformation.
@@ -670,8 +1126,22 @@ int PopulatePassManager(
     pm->add(llvm::createInstructionCombiningPass());
   }
 
-  // Now we add any of the LLVM optimizations we wanted
-  pmBuilder.populateModulePassManager(*pm);
+  if (fast_compile) {
+    // Local cleanups instead of the LLVM scalar and loop optimizations.
+    pm->add(llvm::createEarlyCSEPass());
+    pm->add(llvm::createCFGSimplificationPass());
+    pm->add(llvm::createDeadCodeEliminationPass());
+  } else {
+    // Now we add any of the LLVM optimizations we wanted. They come from
+    // PassBuilder, which runs them with the new pass manager, in place with a
+    // single job. With -cache-ir, the optimized kernels are cached one by
+    // one.
+    const std::string cache_dir =
+        options.CacheIR ? options.CacheDir : std::string();
+    pm->add(clspv::createParallelOptimizePass(
+        options.OptJobs, OptLevel, SizeLevel, cache_dir,
+        uint64_t(options.CacheMaxSize) << 20));
+  }
 
   // No point attempting to handle freeze currently so strip them from the IR.
   pm->add(clspv::createStripFreezePass());
@@ -685,9 +1155,42 @@ int PopulatePassManager(
   pm->add(clspv::createReplaceLLVMIntrinsicsPass());
   // Replace LLVM intrinsics can leave dead code around.
   pm->add(llvm::createDeadCodeEliminationPass());
+  // Memory intrinsics on private arrays are replaced by element stores by now.
+  if (clspv::Option::PrivateArrayPromotionThreshold()) {
+    pm->add(clspv::createPromotePrivateArraysPass());
+  }
+  // Barrier semantics are folded to constants and inlining has brought
+  // barriers together by now.
+  if (clspv::Option::OptimizeBarriers()) {
+    pm->add(clspv::createOptimizeBarriersPass());
+  }
+  // Like the profile counters, the aggregation adds a branch.
+  if (clspv::Option::SubgroupAtomicAggregation()) {
+    pm->add(clspv::createAggregateAtomicsPass());
+  }
+  // Counters are added once the CFG is final but not yet structurized, as the
+  // subgroup aggregation adds a branch.
+  if (clspv::Option::ProfileCountersMode() !=
+      clspv::Option::ProfileCounters::kNone) {
+    pm->add(clspv::createProfileCountersPass());
+  }
   pm->add(clspv::createUndoBoolPass());
   pm->add(clspv::createUndoTruncateToOddIntegerPass());
-  pm->add(llvm::createStructurizeCFGPass(false));
+  if (clspv::Option::NarrowIntegerArithmetic()) {
+    pm->add(clspv::createNarrowIntegerArithmeticPass());
+  }
+  if (clspv::Option::NarrowInt64Arithmetic()) {
+    pm->add(clspv::createNarrowInt64ArithmeticPass());
+  }
+  if (clspv::Option::NativeFp16()) {
+    pm->add(clspv::createNarrowHalfArithmeticPass());
+  }
+  pm->add(clspv::createPreserveLoopMetadataPass());
+  if (clspv::Option::StructurizeUnstructuredOnly()) {
+    pm->add(clspv::createSelectiveStructurizeCFGPass());
+  } else {
+    pm->add(llvm::createStructurizeCFGPass(false));
+  }
   // Must be run after structurize cfg.
   pm->add(clspv::createFixupStructuredCFGPass());
   // Must be run after structured cfg fixup.
@@ -695,6 +1198,12 @@ int PopulatePassManager(
   pm->add(clspv::createUndoGetElementPtrConstantExprPass());
   pm->add(clspv::createSplatArgPass());
   pm->add(clspv::createSimplifyPointerBitcastPass());
+  if (clspv::Option::WidenVec3Accesses()) {
+    pm->add(clspv::createWidenVec3AccessesPass());
+  }
+  if (clspv::Option::UntypedBuffers()) {
+    pm->add(clspv::createUntypedBuffersPass());
+  }
   pm->add(clspv::createReplacePointerBitcastPass());
 
   pm->add(clspv::createUndoTranslateSamplerFoldPass());
@@ -741,16 +1250,97 @@ int PopulatePassManager(
     // DCE cleans up callers of the specialized functions.
     pm->add(llvm::createDeadCodeEliminationPass());
   }
+  // The pointer lowering passes above undo the GEP CSE and LICM of the LLVM
+  // optimizations.
+  if (clspv::Option::HoistAccessChains()) {
+    pm->add(clspv::createHoistAccessChainsPass());
+  }
   // This pass mucks with types to point where you shouldn't rely on DataLayout
   // anymore so leave this right before SPIR-V generation.
   pm->add(clspv::createUBOTypeTransformPass());
+  // -Os and -Oz also shrink the SPIR-V module itself.
+  const bool optimize_size =
+      options.OptimizationLevel == "s" || options.OptimizationLevel == "z";
   pm->add(clspv::createSPIRVProducerPass(*binaryStream, *SamplerMapEntries,
-                                         OutputFormat == "c"));
+                                         options.OutputFormat == "c",
+                                         binaryWords, optimize_size));
+
+  return 0;
+}
+
+// The options implied by each -target-profile. -scalar-block-layout is left
+// out: it needs VK_EXT_scalar_block_layout, which none of the profiles
+// assume, and can be given along with any of them.
+struct TargetProfileOptions {
+  const char *name;
+  std::vector<const char *> options;
+};
+
+const std::vector<TargetProfileOptions> &TargetProfiles() {
+  static const std::vector<TargetProfileOptions> profiles = {
+      // Drivers that follow the specification need no workarounds.
+      {"conformant", {"-member-stores-for-inserts"}},
+      // Conformant drivers that also accept std430 layout for uniform
+      // buffers, as with VK_KHR_uniform_buffer_standard_layout.
+      {"uniform-standard-layout",
+       {"-member-stores-for-inserts", "-std430-ubo-layout"}},
+      // Every workaround, for drivers whose requirements are unknown.
+      {"compatible",
+       {"-hack-initializers", "-hack-dis", "-hack-inserts", "-hack-scf",
+        "-hack-undef", "-hack-phis", "-hack-block-order"}},
+  };
+  return profiles;
+}
+
+// Fills |args| with the |argc| arguments in |argv|, preceded by the options
+// of the -target-profile they select that they do not give explicitly.
+// Returns 0 if successful.
+int ExpandTargetProfile(const int argc, const char *const argv[],
+                        std::vector<const char *> *args) {
+  llvm::StringRef profile_name;
+  llvm::StringSet<> given;
+  for (int i = 1; i < argc; ++i) {
+    llvm::StringRef arg(argv[i]);
+    if (!arg.startswith("-"))
+      continue;
+    const auto name_and_value = arg.ltrim('-').split('=');
+    given.insert(name_and_value.first);
+    if (name_and_value.first == "target-profile") {
+      profile_name = name_and_value.second;
+      if (!arg.contains('=') && i + 1 < argc)
+        profile_name = argv[i + 1];
+    }
+  }
 
+  args->assign(argv, argv + 1);
+  if (!profile_name.empty()) {
+    const auto &profiles = TargetProfiles();
+    auto profile = std::find_if(profiles.begin(), profiles.end(),
+                                [profile_name](const TargetProfileOptions &p) {
+                                  return profile_name == p.name;
+                                });
+    if (profile == profiles.end()) {
+      llvm::errs() << "unknown target profile '" << profile_name << "'\n";
+      return -1;
+    }
+    for (const char *option : profile->options) {
+      if (!given.count(llvm::StringRef(option).ltrim('-')))
+        args->push_back(option);
+    }
+  }
+  args->insert(args->end(), argv + 1, argv + argc);
   return 0;
 }
 
-int ParseOptions(const int argc, const char *const argv[]) {
+// Parses the command line options and validates them.  On success, the option
+// values are captured into |options| and |option_state|, and the latter is
+// made active on the calling thread.  Returns 0 if successful.
+int ParseOptions(const int argc, const char *const argv[],
+                 std::unique_ptr<FrontendOptions> *options,
+                 std::unique_ptr<clspv::Option::ScopedOptionState>
+                     *option_state) {
+  std::lock_guard<std::mutex> lock(OptionParseMutex);
+
   // We need to change how some of the called passes works by spoofing
   // ParseCommandLineOptions with the specific options.
   bool has_pre = false;
@@ -779,22 +1369,117 @@ int ParseOptions(const int argc, const char *const argv[]) {
     llvmArgv[llvmArgc++] = "-enable-load-pre=0";
   }
 
+  std::vector<const char *> args;
+  if (auto error = ExpandTargetProfile(argc, argv, &args))
+    return error;
+
   llvm::cl::ResetAllOptionOccurrences();
   llvm::cl::ParseCommandLineOptions(llvmArgc, llvmArgv);
-  llvm::cl::ParseCommandLineOptions(argc, argv);
+  llvm::cl::ParseCommandLineOptions(static_cast<int>(args.size()),
+                                    args.data());
 
-  if (clspv::Option::LanguageUsesGenericAddressSpace() &&
-      !clspv::Option::InlineEntryPoints()) {
-    llvm::errs() << "cannot compile languages that use the generic address "
-                    "space (e.g. CLC++, CL2.0) without -inline-entry-points\n";
+  const unsigned chunk_width = clspv::Option::LongVectorChunkWidth();
+  if (chunk_width != 1 && chunk_width != 2 && chunk_width != 4) {
+    llvm::errs() << "-long-vector-chunk-width must be 1, 2 or 4\n";
+    return -1;
+  }
+
+  if (clspv::Option::SharedDescriptorLayout() &&
+      clspv::Option::DistinctKernelDescriptorSets()) {
+    llvm::errs() << "cannot use -shared-descriptor-layout with "
+                    "-distinct-kernel-descriptor-sets\n";
+    return -1;
+  }
+
+  // Device addresses are POD arguments, and the storage buffers that could
+  // otherwise hold them are not addressed physically.
+  if (clspv::Option::PhysicalStorageBuffers() &&
+      (!clspv::Option::ClusterPodKernelArgs() ||
+       !(clspv::Option::PodArgsInPushConstants() ||
+         clspv::Option::PodArgsInUniformBuffer()))) {
+    llvm::errs() << "-physical-storage-buffers requires clustered POD "
+                    "arguments in push constants or uniform buffers\n";
+    return -1;
+  }
+
+  // __constant memory is then addressed physically, so neither the clustered
+  // module-scope constants nor the pointer-to-constant arguments can live in
+  // descriptors.
+  if (clspv::Option::PhysicalStorageBuffers() &&
+      (clspv::Option::ModuleConstantsInStorageBuffer() ||
+       clspv::Option::ConstantArgsInUniformBuffer())) {
+    llvm::errs() << "cannot use -physical-storage-buffers with "
+                    "-module-constants-in-storage-buffer or "
+                    "-constant-args-ubo\n";
+    return -1;
+  }
+
+  // The counters live in a storage buffer variable, which cannot be addressed
+  // physically.
+  if (clspv::Option::PhysicalStorageBuffers() &&
+      clspv::Option::ProfileCountersMode() !=
+          clspv::Option::ProfileCounters::kNone) {
+    llvm::errs() << "cannot use -profile-counters with "
+                    "-physical-storage-buffers\n";
     return -1;
   }
 
-  if (clspv::Option::ScalarBlockLayout()) {
-    llvm::errs() << "scalar block layout support unimplemented\n";
+  const auto local_size = clspv::Option::LocalSize();
+  if (!local_size.empty() &&
+      (local_size.size() != 3 ||
+       std::find(local_size.begin(), local_size.end(), 0u) !=
+           local_size.end())) {
+    llvm::errs() << "-local-size must be three non-zero sizes: x,y,z\n";
     return -1;
   }
 
+  for (const auto &entry : clspv::Option::FuseKernels()) {
+    std::string first, second;
+    unsigned first_ordinal, second_ordinal;
+    if (!clspv::Option::ParseFuseKernels(entry, &first, &first_ordinal,
+                                         &second, &second_ordinal)) {
+      llvm::errs() << "-fuse-kernels must be first:ordinal:second:ordinal, "
+                      "got '"
+                   << entry << "'\n";
+      return -1;
+    }
+  }
+
+  for (const auto &entry : clspv::Option::LocalArgSizes()) {
+    std::string kernel;
+    unsigned ordinal;
+    uint32_t bytes;
+    if (!clspv::Option::ParseLocalArgSize(entry, &kernel, &ordinal, &bytes)) {
+      llvm::errs() << "-local-arg-size must be kernel:ordinal:bytes with a "
+                      "non-zero size, got '"
+                   << entry << "'\n";
+      return -1;
+    }
+  }
+
+  for (const auto &entry : clspv::Option::Int64ArgRanges()) {
+    std::string kernel;
+    unsigned ordinal;
+    int64_t min, max;
+    if (!clspv::Option::ParseInt64ArgRange(entry, &kernel, &ordinal, &min,
+                                           &max)) {
+      llvm::errs() << "-int64-arg-range must be kernel:ordinal:min:max with "
+                      "min <= max, got '"
+                   << entry << "'\n";
+      return -1;
+    }
+  }
+
+  for (const auto &entry : clspv::Option::PodSpecConstants()) {
+    std::string kernel;
+    unsigned ordinal;
+    if (!clspv::Option::ParsePodSpecConstant(entry, &kernel, &ordinal)) {
+      llvm::errs() << "-pod-spec-constants must be kernel:ordinal, got '"
+                   << entry << "'\n";
+      return -1;
+    }
+  }
+
   // Push constant option validation.
   if (clspv::Option::PodArgsInPushConstants()) {
     if (clspv::Option::PodArgsInUniformBuffer()) {
@@ -821,80 +1506,619 @@ int ParseOptions(const int argc, const char *const argv[]) {
     }
   }
 
+  options->reset(new FrontendOptions);
+  option_state->reset(new clspv::Option::ScopedOptionState);
+
   return 0;
 }
 
-int GenerateIRFile(llvm::legacy::PassManager *pm, llvm::Module &module,
-                   std::string output) {
-  std::error_code ec;
-  std::unique_ptr<llvm::ToolOutputFile> out(
-      new llvm::ToolOutputFile(output, ec, llvm::sys::fs::F_None));
-  if (ec) {
-    llvm::errs() << output << ": " << ec.message() << '\n';
-    return -1;
+// Returns the arguments of the command line that can change the output of the
+// compilation, for use in a compile cache key.  This leaves out the program
+// name, the input and output files, and options that only affect caching.
+std::vector<std::string> CacheKeyOptions(const int argc,
+                                         const char *const argv[],
+                                         const FrontendOptions &options) {
+  const llvm::StringRef ignored[] = {"o", "cache-dir", "cache-max-size",
+                                     "builtins-pch-dir", "pass-stats",
+                                     "reflection-sidecar", "cost-report",
+                                     "entry-points",
+                                     "manifest", "j"};
+  // Options without a value.
+  const llvm::StringRef ignored_flags[] = {"cache-ir", "split-kernels"};
+  std::vector<std::string> key_options;
+  for (int i = 1; i < argc; ++i) {
+    llvm::StringRef arg(argv[i]);
+    if (arg == options.InputFilename ||
+        std::find(options.InputFilenames.begin(), options.InputFilenames.end(),
+                  arg) != options.InputFilenames.end())
+      continue;
+    if (arg.startswith("-")) {
+      const auto name_and_value = arg.ltrim('-').split('=');
+      if (std::find(std::begin(ignored_flags), std::end(ignored_flags),
+                    name_and_value.first) != std::end(ignored_flags))
+        continue;
+      if (std::find(std::begin(ignored), std::end(ignored),
+                    name_and_value.first) != std::end(ignored)) {
+        // Skip the value too when it is a separate argument.
+        if (!arg.contains('='))
+          ++i;
+        continue;
+      }
+    }
+    key_options.push_back(arg.str());
+  }
+
+  // The kernels to compile may also come from the API rather than the command
+  // line, so the effective list is keyed instead.
+  const auto entry_points = clspv::Option::EntryPoints();
+  if (!entry_points.empty()) {
+    key_options.push_back("-entry-points=" +
+                          llvm::join(entry_points.begin(), entry_points.end(),
+                                     ","));
+  }
+
+  // The libraries can change without their names changing.
+  for (const auto &library : options.LinkBitcode) {
+    auto buffer = llvm::MemoryBuffer::getFile(library, -1, false);
+    key_options.push_back(
+        "<link-bitcode " +
+        (buffer ? llvm::toHex(llvm::SHA1::hash(llvm::arrayRefFromStringRef(
+                      (*buffer)->getBuffer())))
+                : std::string("missing")) +
+        ">");
+  }
+  return key_options;
+}
+
+// Links the functions |module| uses from the -link-bitcode libraries into
+// it. Bitcode libraries are loaded lazily, so only the bodies of the
+// functions that get linked are read. Returns 0 if successful.
+int LinkBitcodeLibraries(const FrontendOptions &options,
+                         llvm::Module &module) {
+  for (const auto &library : options.LinkBitcode) {
+    llvm::SMDiagnostic error;
+    std::unique_ptr<llvm::Module> library_module =
+        llvm::getLazyIRFileModule(library, error, module.getContext());
+    if (!library_module) {
+      error.print("clspv", llvm::errs());
+      return -1;
+    }
+    if (llvm::Linker::linkModules(module, std::move(library_module),
+                                  llvm::Linker::Flags::LinkOnlyNeeded)) {
+      llvm::errs() << "Unable to link '" << library << "'\n";
+      return -1;
+    }
   }
-  pm->add(llvm::createPrintModulePass(out->os(), "", false));
-  pm->run(module);
-  out->keep();
   return 0;
 }
 
-} // namespace
+// Records the argument names of the kernels of |module| in module metadata,
+// from their kernel_arg_name metadata or else the arguments themselves, so
+// that they survive the passes recreating kernels once value names are
+// discarded.
+void RecordKernelArgNames(llvm::Module &module) {
+  auto &context = module.getContext();
+  auto *names =
+      module.getOrInsertNamedMetadata(clspv::KernelArgNamesMetadataName());
+  for (auto &F : module) {
+    if (F.isDeclaration() ||
+        F.getCallingConv() != llvm::CallingConv::SPIR_KERNEL)
+      continue;
+    llvm::SmallVector<llvm::Metadata *, 8> operands{
+        llvm::MDString::get(context, F.getName())};
+    auto *arg_names = F.getMetadata("kernel_arg_name");
+    for (auto &arg : F.args()) {
+      if (arg_names && arg.getArgNo() < arg_names->getNumOperands()) {
+        operands.push_back(arg_names->getOperand(arg.getArgNo()));
+      } else {
+        operands.push_back(llvm::MDString::get(context, arg.getName()));
+      }
+    }
+    names->addOperand(llvm::MDNode::get(context, operands));
+  }
+}
 
-namespace clspv {
-int Compile(const int argc, const char *const argv[]) {
+// With -lean-memory, destroys the frontend |instance| that produced |module|
+// and makes the context of |module| discard the names of the values created
+// from now on.
+void ReleaseFrontend(std::unique_ptr<clang::CompilerInstance> &instance,
+                     llvm::Module &module) {
+  if (!clspv::Option::LeanMemory())
+    return;
+  RecordKernelArgNames(module);
+  module.getContext().setDiscardValueNames(true);
+  instance.reset();
+}
 
-  if (auto error = ParseOptions(argc, argv))
-    return error;
+// Returns the contents of the sampler map used by this compilation: either
+// |sampler_map| or the contents of the -samplermap file.
+std::string SamplerMapContents(const FrontendOptions &options,
+                               const std::string &sampler_map) {
+  if (!sampler_map.empty() || options.SamplerMap.empty())
+    return sampler_map;
+  auto file = llvm::MemoryBuffer::getFile(options.SamplerMap);
+  if (!file)
+    return "";
+  return (*file)->getBuffer().str();
+}
 
-  llvm::SmallVector<std::pair<unsigned, std::string>, 8> SamplerMapEntries;
-  if (auto error = ParseSamplerMap("", &SamplerMapEntries))
-    return error;
+// Returns the cache key of the frontend output |module|, or an empty string
+// if the IR cache is not in use.
+std::string IRCacheKey(const FrontendOptions &options, const int argc,
+                       const char *const argv[], const llvm::Module &module,
+                       const std::string &sampler_map_contents) {
+  if (!options.CacheIR || options.CacheDir.empty())
+    return "";
+  auto key_options = CacheKeyOptions(argc, argv, options);
+  // Keeps IR keys apart from source keys.
+  key_options.push_back("<ir>");
+  return clspv::CompileCache::Key(clspv::CompileCache::ReachableIR(module),
+                                  sampler_map_contents, key_options);
+}
 
-  // if no output file was provided, use a default
-  llvm::StringRef overiddenInputFilename = InputFilename.getValue();
+// Writes |contents| to the output file of the compilation. Returns 0 if
+// successful.
+int WriteOutputFile(const FrontendOptions &options, llvm::StringRef contents) {
+  std::error_code error;
 
-  // If we are reading our input file from stdin.
-  if ("-" == InputFilename) {
-    // We need to overwrite the file name we use.
-    switch (InputLanguage) {
-    case clang::Language::OpenCL:
-      overiddenInputFilename = "stdin.cl";
-      break;
-    case clang::Language::LLVM_IR:
-      overiddenInputFilename = "stdin.ll";
-      break;
-    default:
-      // Default to fix compiler warnings/errors. Option parsing will reject a
-      // bad enum value for the option so there is no need for a message.
+  std::string OutputFilename = options.OutputFilename;
+  if (OutputFilename.empty()) {
+    if (options.OutputFormat == "c") {
+      OutputFilename = "a.spvinc";
+    } else if (options.OutputFormat == "cspv") {
+      OutputFilename = "a.cspv";
+    } else {
+      OutputFilename = "a.spv";
+    }
+  }
+
+  std::vector<char> compressed;
+  if (options.OutputFormat == "cspv") {
+    std::vector<uint32_t> words(contents.size() / sizeof(uint32_t));
+    memcpy(words.data(), contents.data(), words.size() * sizeof(uint32_t));
+    if (!clspv::CompressSPIRV(words.data(), words.size(),
+                              options.CompressEntropy, &compressed)) {
+      llvm::errs() << "Unable to compress the SPIR-V of the module\n";
       return -1;
     }
+    contents = llvm::StringRef(compressed.data(), compressed.size());
   }
+  llvm::raw_fd_ostream outStream(OutputFilename, error,
+                                 llvm::sys::fs::FA_Write);
 
-  clang::CompilerInstance instance;
-  clang::FrontendInputFile kernelFile(overiddenInputFilename,
-                                      clang::InputKind(InputLanguage));
-  std::string log;
-  llvm::raw_string_ostream diagnosticsStream(log);
-  if (auto error = SetCompilerInstanceOptions(
-          instance, overiddenInputFilename, kernelFile, "", &diagnosticsStream))
-    return error;
+  if (error) {
+    llvm::errs() << "Unable to open output file '" << OutputFilename
+                 << "': " << error.message() << '\n';
+    return -1;
+  }
+  outStream << contents;
 
-  // Parse.
-  llvm::LLVMContext context;
-  clang::EmitLLVMOnlyAction action(&context);
+  return 0;
+}
 
-  // Prepare the action for processing kernelFile
-  const bool success = action.BeginSourceFile(instance, kernelFile);
-  if (!success) {
+// Writes one output file per kernel of the binary module |binary|, named after
+// the output file with the kernel name inserted before the extension. Returns
+// 0 if successful.
+int WriteSplitOutputFiles(const FrontendOptions &options,
+                          llvm::StringRef binary) {
+  if (options.OutputFormat == "c" || options.OutputFilename == "-") {
+    llvm::errs() << "-split-kernels requires binary output to a file\n";
     return -1;
   }
 
-  auto result = action.Execute();
-  action.EndSourceFile();
+  std::vector<uint32_t> words(binary.size() / sizeof(uint32_t));
+  memcpy(words.data(), binary.data(), words.size() * sizeof(uint32_t));
+  std::vector<clspv::KernelModule> modules;
+  if (!clspv::SplitSPIRVByKernel(words, &modules)) {
+    llvm::errs() << "Unable to split the module by kernel\n";
+    return -1;
+  }
 
-  clang::DiagnosticConsumer *const consumer =
-      instance.getDiagnostics().getClient();
+  llvm::SmallString<128> stem(options.OutputFilename.empty()
+                                  ? "a.spv"
+                                  : options.OutputFilename);
+  const std::string extension = llvm::sys::path::extension(stem).str();
+  llvm::sys::path::replace_extension(stem, "");
+  for (const auto &module : modules) {
+    FrontendOptions kernel_options = options;
+    kernel_options.OutputFilename =
+        (llvm::Twine(stem) + "." + module.name + extension).str();
+    if (auto error = WriteOutputFile(
+            kernel_options,
+            llvm::StringRef(reinterpret_cast<const char *>(module.words.data()),
+                            module.words.size() * sizeof(uint32_t))))
+      return error;
+  }
+
+  return 0;
+}
+
+// Returns the words of the binary module |binary|, which may not be word
+// aligned in memory.
+std::vector<uint32_t> BinaryWords(llvm::StringRef binary) {
+  std::vector<uint32_t> words(binary.size() / sizeof(uint32_t));
+  memcpy(words.data(), binary.data(), words.size() * sizeof(uint32_t));
+  return words;
+}
+
+// Writes the reflection sidecar of the binary module |binary|, if one was
+// requested. Returns 0 if successful.
+int WriteReflectionSidecar(const FrontendOptions &options,
+                           llvm::StringRef binary) {
+  if (options.ReflectionSidecarFile.empty())
+    return 0;
+  if (options.OutputFormat == "c") {
+    llvm::errs() << "-reflection-sidecar requires binary output\n";
+    return -1;
+  }
+
+  const auto words = BinaryWords(binary);
+  clspv::reflection::ReflectionInfo info;
+  if (!clspv::reflection::ParseReflectionInfo(words.data(), words.size(),
+                                              &info)) {
+    llvm::errs() << "Unable to read the reflection information of the "
+                    "module\n";
+    return -1;
+  }
+  std::vector<uint32_t> sidecar;
+  clspv::reflection::WriteSidecar(info, &sidecar);
+
+  std::error_code error;
+  llvm::raw_fd_ostream outStream(options.ReflectionSidecarFile, error,
+                                 llvm::sys::fs::FA_Write);
+  if (error) {
+    llvm::errs() << "Unable to open reflection sidecar file '"
+                 << options.ReflectionSidecarFile << "': " << error.message()
+                 << '\n';
+    return -1;
+  }
+  outStream.write(reinterpret_cast<const char *>(sidecar.data()),
+                  sidecar.size() * sizeof(uint32_t));
+
+  return 0;
+}
+
+// Writes the cost report of the binary module |binary|, if one was requested.
+// Returns 0 if successful.
+int WriteCostReport(const FrontendOptions &options, llvm::StringRef binary) {
+  if (options.CostReportFile.empty())
+    return 0;
+  if (options.OutputFormat == "c") {
+    llvm::errs() << "-cost-report requires binary output\n";
+    return -1;
+  }
+
+  const auto words = BinaryWords(binary);
+  clspv::CostReport report;
+  if (!report.parse(words.data(), words.size())) {
+    llvm::errs() << "Unable to read the SPIR-V of the module\n";
+    return -1;
+  }
+  return report.writeJSONFile(options.CostReportFile);
+}
+
+// Writes the -pass-stats file, if requested, of a compilation answered from
+// the compile cache. No pass ran, so it only records the cache hit. Returns 0
+// if successful.
+int WriteCacheHitStats(const FrontendOptions &options) {
+  if (options.PassStatsFile.empty())
+    return 0;
+  clspv::PassStats stats;
+  stats.setCacheHit();
+  return stats.writeJSONFile(options.PassStatsFile);
+}
+
+// Writes the files describing the binary module |binary| that were requested
+// along with it. Returns 0 if successful.
+int WriteModuleReports(const FrontendOptions &options,
+                       llvm::StringRef binary) {
+  if (auto error = WriteReflectionSidecar(options, binary))
+    return error;
+  return WriteCostReport(options, binary);
+}
+
+// Writes the output files of a command line compilation of |binary|. Returns 0
+// if successful.
+int WriteOutputs(const FrontendOptions &options, llvm::StringRef binary) {
+  if (auto error = options.SplitKernels
+                       ? WriteSplitOutputFiles(options, binary)
+                       : WriteOutputFile(options, binary))
+    return error;
+  return WriteModuleReports(options, binary);
+}
+
+// Initializes the pass registry.  This only needs to happen once per process.
+void InitializePasses() {
+  static std::once_flag once;
+  std::call_once(once, []() {
+    llvm::PassRegistry &Registry = *llvm::PassRegistry::getPassRegistry();
+    llvm::initializeCore(Registry);
+    llvm::initializeScalarOpts(Registry);
+    llvm::initializeClspvPasses(Registry);
+  });
+}
+
+// Writes |module| to |output|, as bitcode if its extension is .bc and as text
+// IR otherwise.
+int GenerateIRFile(llvm::legacy::PassManager *pm, llvm::Module &module,
+                   std::string output) {
+  const bool bitcode = llvm::sys::path::extension(output) == ".bc";
+  std::error_code ec;
+  std::unique_ptr<llvm::ToolOutputFile> out(
+      new llvm::ToolOutputFile(output, ec, llvm::sys::fs::F_None));
+  if (ec) {
+    llvm::errs() << output << ": " << ec.message() << '\n';
+    return -1;
+  }
+  if (bitcode) {
+    pm->add(llvm::createBitcodeWriterPass(out->os()));
+  } else {
+    pm->add(llvm::createPrintModulePass(out->os(), "", false));
+  }
+  pm->run(module);
+  out->keep();
+  return 0;
+}
+
+// Compiles |program| from a string, with |options| and the clspv options
+// already parsed from the |argc| arguments in |argv|.  The clspv options must
+// be active on the calling thread.  |program| is OpenCL C followed by a null
+// character, or LLVM bitcode.  If |precompiled_sampler_map| is non-null, it is
+// used instead of |sampler_map| and the -samplermap option.  Returns 0 if
+// successful.
+int CompileProgramFromString(
+    FrontendOptions options, const int argc, const char *const argv[],
+    llvm::StringRef program, const std::string &sampler_map,
+    const clspv::PrecompiledSamplerMap *precompiled_sampler_map,
+    std::vector<uint32_t> *output_binary, std::string *output_log) {
+  llvm::SmallVector<std::pair<unsigned, std::string>, 8> SamplerMapEntries;
+  std::string sampler_map_contents;
+  if (precompiled_sampler_map) {
+    if (!precompiled_sampler_map->source.empty()) {
+      clspv::Option::SetUseSamplerMap(true);
+      llvm::outs()
+          << "Warning: use of the sampler map is deprecated and unnecessary\n";
+    }
+    SamplerMapEntries.append(precompiled_sampler_map->entries.begin(),
+                             precompiled_sampler_map->entries.end());
+    sampler_map_contents = precompiled_sampler_map->source;
+  } else {
+    if (auto error =
+            ParseSamplerMap(options, sampler_map, &SamplerMapEntries))
+      return error;
+    sampler_map_contents = SamplerMapContents(options, sampler_map);
+  }
+
+  // Return a cached result before doing any work, if there is one.
+  std::string cache_key;
+  if (!options.CacheDir.empty() &&
+      !clspv::CompileCache::HasIncludeDirective(program)) {
+    cache_key = clspv::CompileCache::Key(program, sampler_map_contents,
+                                         CacheKeyOptions(argc, argv, options));
+    std::vector<char> contents;
+    if (clspv::CompileCache::Lookup(options.CacheDir, cache_key, &contents) &&
+        contents.size() % 4 == 0) {
+      assert(output_binary && "Valid binary container is required.");
+      output_binary->resize(contents.size() / 4);
+      memcpy(output_binary->data(), contents.data(), contents.size());
+      if (output_log != nullptr) {
+        output_log->clear();
+      }
+      if (auto error = WriteCacheHitStats(options))
+        return error;
+      return WriteModuleReports(
+          options, llvm::StringRef(contents.data(), contents.size()));
+    }
+  }
+
+  if (IsBitcode(program)) {
+    options.InputFilename = "source.bc";
+    options.InputLanguage = clang::Language::LLVM_IR;
+  } else {
+    options.InputFilename = "source.cl";
+    options.InputLanguage = clang::Language::OpenCL;
+  }
+  llvm::StringRef overiddenInputFilename = options.InputFilename;
+
+  std::string builtins_pch;
+  if (options.InputLanguage == clang::Language::OpenCL) {
+    if (auto error = PrepareBuiltinsPCH(options, &builtins_pch))
+      return error;
+  }
+
+  auto instance = std::make_unique<clang::CompilerInstance>();
+  clang::FrontendInputFile kernelFile(overiddenInputFilename,
+                                      clang::InputKind(options.InputLanguage));
+  std::string log;
+  llvm::raw_string_ostream diagnosticsStream(log);
+  if (auto error = SetCompilerInstanceOptions(
+          *instance, options, overiddenInputFilename, kernelFile, program,
+          builtins_pch, &diagnosticsStream))
+    return error;
+
+  // Parse.
+  llvm::LLVMContext context;
+  clang::EmitLLVMOnlyAction action(&context);
+
+  // Prepare the action for processing kernelFile
+  const bool success = action.BeginSourceFile(*instance, kernelFile);
+  if (!success) {
+    return -1;
+  }
+
+  auto result = action.Execute();
+  action.EndSourceFile();
+
+  clang::DiagnosticConsumer *const consumer =
+      instance->getDiagnostics().getClient();
+  consumer->finish();
+
+  if (output_log != nullptr) {
+    *output_log = log;
+  }
+
+  auto num_errors = consumer->getNumErrors();
+  if (result || num_errors > 0) {
+    return -1;
+  }
+
+  std::unique_ptr<llvm::Module> module(action.takeModule());
+  ReleaseFrontend(instance, *module);
+  if (auto error = LinkBitcodeLibraries(options, *module))
+    return error;
+
+  // Return a cached result for the same IR, if there is one.
+  assert(output_binary && "Valid binary container is required.");
+  const std::string ir_cache_key =
+      IRCacheKey(options, argc, argv, *module, sampler_map_contents);
+  if (!ir_cache_key.empty()) {
+    std::vector<char> contents;
+    if (clspv::CompileCache::Lookup(options.CacheDir, ir_cache_key,
+                                    &contents) &&
+        contents.size() % 4 == 0) {
+      output_binary->resize(contents.size() / 4);
+      memcpy(output_binary->data(), contents.data(), contents.size());
+      llvm::StringRef binary(contents.data(), contents.size());
+      if (!cache_key.empty()) {
+        clspv::CompileCache::Store(options.CacheDir, cache_key, binary,
+                                   uint64_t(options.CacheMaxSize) << 20);
+      }
+      if (auto error = WriteCacheHitStats(options))
+        return error;
+      return WriteModuleReports(options, binary);
+    }
+  }
+
+  InitializePasses();
+
+  // Optimize.
+  // A binary module is produced directly into |output_binary|.  Only a C
+  // initializer list goes through this buffer.
+  SmallVector<char, 0> text;
+  llvm::raw_svector_ostream textStream(text);
+  clspv::PassStats stats;
+  clspv::PassStatsManager pm(options.PassStatsFile.empty() ? nullptr : &stats);
+  if (auto error = PopulatePassManager(&pm, options, &textStream,
+                                       output_binary, &SamplerMapEntries))
+    return error;
+  pm.run(*module);
+
+  if (!options.PassStatsFile.empty()) {
+    if (auto error = stats.writeJSONFile(options.PassStatsFile))
+      return error;
+  }
+
+  // The SPIR-V producer writes nothing if SPIRV-Tools failed on the module.
+  if (output_binary->empty() && text.empty())
+    return -1;
+
+  // Write the resulting binary.
+  // Wait until now to try writing the file so that we only write it on
+  // successful compilation.
+  if (!options.OutputFilename.empty()) {
+    llvm::outs()
+        << "Warning: -o is ignored when binary container is provided.\n";
+  }
+  if (!text.empty()) {
+    output_binary->assign((text.size() + 3) / 4, 0);
+    memcpy(output_binary->data(), text.data(), text.size());
+  }
+
+  for (const auto &key : {cache_key, ir_cache_key}) {
+    if (key.empty())
+      continue;
+    clspv::CompileCache::Store(
+        options.CacheDir, key,
+        llvm::StringRef(reinterpret_cast<const char *>(output_binary->data()),
+                        output_binary->size() * sizeof(uint32_t)),
+        uint64_t(options.CacheMaxSize) << 20);
+  }
+
+  return WriteModuleReports(
+      options,
+      llvm::StringRef(reinterpret_cast<const char *>(output_binary->data()),
+                      output_binary->size() * sizeof(uint32_t)));
+}
+
+// Compiles the input file of |options| to its output file, with the clspv
+// options already parsed from the |argc| arguments in |argv|.  The clspv
+// options must be active on the calling thread.  Returns 0 if successful.
+int CompileFile(const FrontendOptions &options, const int argc,
+                const char *const argv[]) {
+  llvm::SmallVector<std::pair<unsigned, std::string>, 8> SamplerMapEntries;
+  if (auto error = ParseSamplerMap(options, "", &SamplerMapEntries))
+    return error;
+
+  // if no output file was provided, use a default
+  llvm::StringRef overiddenInputFilename = options.InputFilename;
+
+  // If we are reading our input file from stdin.
+  if ("-" == options.InputFilename) {
+    // We need to overwrite the file name we use.
+    switch (options.InputLanguage) {
+    case clang::Language::OpenCL:
+      overiddenInputFilename = "stdin.cl";
+      break;
+    case clang::Language::LLVM_IR:
+      overiddenInputFilename = "stdin.ll";
+      break;
+    default:
+      // Default to fix compiler warnings/errors. Option parsing will reject a
+      // bad enum value for the option so there is no need for a message.
+      return -1;
+    }
+  }
+
+  // Return a cached result before doing any work, if there is one.
+  std::string cache_key;
+  if (!options.CacheDir.empty() && options.InputFilename != "-" &&
+      options.IROutputFile.empty() && !options.verify) {
+    auto source = llvm::MemoryBuffer::getFile(options.InputFilename);
+    if (source &&
+        !clspv::CompileCache::HasIncludeDirective((*source)->getBuffer())) {
+      cache_key = clspv::CompileCache::Key(
+          (*source)->getBuffer(), SamplerMapContents(options, ""),
+          CacheKeyOptions(argc, argv, options));
+      std::vector<char> contents;
+      if (clspv::CompileCache::Lookup(options.CacheDir, cache_key,
+                                      &contents)) {
+        if (auto error = WriteCacheHitStats(options))
+          return error;
+        return WriteOutputs(
+            options, llvm::StringRef(contents.data(), contents.size()));
+      }
+    }
+  }
+
+  std::string builtins_pch;
+  if (auto error = PrepareBuiltinsPCH(options, &builtins_pch))
+    return error;
+
+  auto instance = std::make_unique<clang::CompilerInstance>();
+  clang::FrontendInputFile kernelFile(overiddenInputFilename,
+                                      clang::InputKind(options.InputLanguage));
+  std::string log;
+  llvm::raw_string_ostream diagnosticsStream(log);
+  if (auto error = SetCompilerInstanceOptions(
+          *instance, options, overiddenInputFilename, kernelFile, "",
+          builtins_pch, &diagnosticsStream))
+    return error;
+
+  // Parse.
+  llvm::LLVMContext context;
+  clang::EmitLLVMOnlyAction action(&context);
+
+  // Prepare the action for processing kernelFile
+  const bool success = action.BeginSourceFile(*instance, kernelFile);
+  if (!success) {
+    return -1;
+  }
+
+  auto result = action.Execute();
+  action.EndSourceFile();
+
+  clang::DiagnosticConsumer *const consumer =
+      instance->getDiagnostics().getClient();
   consumer->finish();
 
   auto num_warnings = consumer->getNumWarnings();
@@ -908,57 +2132,429 @@ int Compile(const int argc, const char *const argv[]) {
 
   // Don't run the passes or produce any output in verify mode.
   // Clang doesn't always produce a valid module.
-  if (verify) {
+  if (options.verify) {
     return 0;
   }
 
-  llvm::PassRegistry &Registry = *llvm::PassRegistry::getPassRegistry();
-  llvm::initializeCore(Registry);
-  llvm::initializeScalarOpts(Registry);
-  llvm::initializeClspvPasses(Registry);
-
   std::unique_ptr<llvm::Module> module(action.takeModule());
+  ReleaseFrontend(instance, *module);
+  if (auto error = LinkBitcodeLibraries(options, *module))
+    return error;
+
+  // Return a cached result for the same IR, if there is one.
+  std::string ir_cache_key;
+  if (options.IROutputFile.empty()) {
+    ir_cache_key = IRCacheKey(options, argc, argv, *module,
+                              SamplerMapContents(options, ""));
+  }
+  if (!ir_cache_key.empty()) {
+    std::vector<char> contents;
+    if (clspv::CompileCache::Lookup(options.CacheDir, ir_cache_key,
+                                    &contents)) {
+      llvm::StringRef binary(contents.data(), contents.size());
+      if (!cache_key.empty()) {
+        clspv::CompileCache::Store(options.CacheDir, cache_key, binary,
+                                   uint64_t(options.CacheMaxSize) << 20);
+      }
+      if (auto error = WriteCacheHitStats(options))
+        return error;
+      return WriteOutputs(options, binary);
+    }
+  }
+
+  InitializePasses();
 
   // Optimize.
   // Create a memory buffer for temporarily writing the result.
   SmallVector<char, 10000> binary;
   llvm::raw_svector_ostream binaryStream(binary);
-  llvm::legacy::PassManager pm;
+  clspv::PassStats stats;
+  clspv::PassStatsManager pm(options.PassStatsFile.empty() ? nullptr : &stats);
 
   // If --emit-ir was requested, emit the initial LLVM IR and stop compilation.
-  if (!IROutputFile.empty()) {
-    return GenerateIRFile(&pm, *module, IROutputFile);
+  if (!options.IROutputFile.empty()) {
+    return GenerateIRFile(&pm, *module, options.IROutputFile);
   }
 
   // Otherwise, populate the pass manager and run the regular passes.
-  if (auto error = PopulatePassManager(&pm, &binaryStream, &SamplerMapEntries))
+  if (auto error = PopulatePassManager(&pm, options, &binaryStream, nullptr,
+                                       &SamplerMapEntries))
     return error;
   pm.run(*module);
 
-  // Write outputs
-  std::error_code error;
+  if (!options.PassStatsFile.empty()) {
+    if (auto error = stats.writeJSONFile(options.PassStatsFile))
+      return error;
+  }
+
+  // The SPIR-V producer writes nothing if SPIRV-Tools failed on the module.
+  if (binary.empty())
+    return -1;
+
+  for (const auto &key : {cache_key, ir_cache_key}) {
+    if (key.empty())
+      continue;
+    clspv::CompileCache::Store(options.CacheDir, key, binaryStream.str(),
+                               uint64_t(options.CacheMaxSize) << 20);
+  }
 
   // Write the resulting binary.
   // Wait until now to try writing the file so that we only write it on
   // successful compilation.
-  if (OutputFilename.empty()) {
-    if (OutputFormat == "c") {
-      OutputFilename = "a.spvinc";
+  return WriteOutputs(options, binaryStream.str());
+}
+
+// Collects the input and output file of every compilation requested by
+// |options|: the -manifest entries, or else the input files, each written next
+// to itself with the extension of the output format.  Returns 0 if successful.
+int CollectJobs(const FrontendOptions &options,
+                std::vector<std::pair<std::string, std::string>> *jobs) {
+  // These name a single file per compilation.
+  const std::pair<const char *, const std::string *> single_file_options[] = {
+      {"-o", &options.OutputFilename},
+      {"-emit-ir", &options.IROutputFile},
+      {"-pass-stats", &options.PassStatsFile},
+      {"-reflection-sidecar", &options.ReflectionSidecarFile},
+      {"-cost-report", &options.CostReportFile}};
+  for (const auto &option : single_file_options) {
+    if (!option.second->empty()) {
+      llvm::errs() << option.first
+                   << " cannot be used when compiling several inputs\n";
+      return -1;
+    }
+  }
+
+  if (!options.Manifest.empty()) {
+    if (!options.InputFilenames.empty()) {
+      llvm::errs() << "cannot give input files with -manifest\n";
+      return -1;
+    }
+
+    auto manifest = llvm::MemoryBuffer::getFile(options.Manifest);
+    if (!manifest) {
+      llvm::errs() << "Error: " << manifest.getError().message() << " '"
+                   << options.Manifest << "'\n";
+      return -1;
+    }
+
+    llvm::SmallVector<llvm::StringRef, 64> lines;
+    (*manifest)->getBuffer().split(lines, '\n');
+    for (unsigned i = 0; i < lines.size(); ++i) {
+      const auto line = lines[i].trim();
+      if (line.empty() || line.startswith("#"))
+        continue;
+      llvm::SmallVector<llvm::StringRef, 2> fields;
+      line.split(fields, ' ', -1, false);
+      if (fields.size() != 2) {
+        llvm::errs() << options.Manifest << ":" << i + 1
+                     << ": expected '<input> <output>'\n";
+        return -1;
+      }
+      jobs->emplace_back(fields[0].trim().str(), fields[1].trim().str());
+    }
+    return 0;
+  }
+
+  const char *extension = options.OutputFormat == "c"      ? "spvinc"
+                          : options.OutputFormat == "cspv" ? "cspv"
+                                                           : "spv";
+  for (const auto &input : options.InputFilenames) {
+    if (input == "-") {
+      llvm::errs() << "cannot read stdin when compiling several inputs\n";
+      return -1;
+    }
+    llvm::SmallString<128> output(input);
+    llvm::sys::path::replace_extension(output, extension);
+    jobs->emplace_back(input, output.str().str());
+  }
+  return 0;
+}
+
+// Returns the name of |type| as in the kernel_arg_type metadata of Clang: no
+// qualifiers, no image access qualifier, and "uint" for "unsigned int".
+std::string KernelArgTypeName(clang::QualType type,
+                              const clang::PrintingPolicy &policy) {
+  std::string name = type.getUnqualifiedType().getAsString(policy);
+  if (type->isImageType()) {
+    name = llvm::StringRef(name).rsplit(' ').second.str();
+  } else if (llvm::StringRef(name).startswith("unsigned ")) {
+    name = "u" + name.substr(9);
+  }
+  return name;
+}
+
+// Returns the signature of the kernel |FD|.
+clspv::KernelSignature GetKernelSignature(const clang::FunctionDecl &FD) {
+  const clang::PrintingPolicy policy(FD.getASTContext().getLangOpts());
+  clspv::KernelSignature kernel;
+  kernel.name = FD.getName().str();
+
+  for (const auto *P : FD.parameters()) {
+    clspv::KernelArgSignature arg;
+    arg.name = P->getName().str();
+    arg.address_space = "private";
+    arg.access_qualifier = "none";
+
+    auto type = P->getType();
+    std::vector<std::string> qualifiers;
+    if (type->isPointerType()) {
+      auto pointee = type->getPointeeType();
+      switch (pointee.getAddressSpace()) {
+      case clang::LangAS::opencl_global:
+        arg.address_space = "global";
+        break;
+      case clang::LangAS::opencl_constant:
+        arg.address_space = "constant";
+        break;
+      case clang::LangAS::opencl_local:
+        arg.address_space = "local";
+        break;
+      default:
+        break;
+      }
+      arg.type = KernelArgTypeName(pointee, policy) + "*";
+      if (pointee.isConstQualified())
+        qualifiers.push_back("const");
+      if (type.isRestrictQualified())
+        qualifiers.push_back("restrict");
+      if (pointee.isVolatileQualified())
+        qualifiers.push_back("volatile");
     } else {
-      OutputFilename = "a.spv";
+      arg.type = KernelArgTypeName(type, policy);
+      if (type->isPipeType())
+        qualifiers.push_back("pipe");
+    }
+    arg.type_qualifiers = llvm::join(qualifiers, " ");
+
+    if (const auto *access = P->getAttr<clang::OpenCLAccessAttr>()) {
+      arg.access_qualifier = access->isWriteOnly()   ? "write_only"
+                             : access->isReadWrite() ? "read_write"
+                                                     : "read_only";
+    } else if (type->isImageType() || type->isPipeType()) {
+      arg.access_qualifier = "read_only";
     }
+
+    kernel.args.push_back(arg);
   }
-  llvm::raw_fd_ostream outStream(OutputFilename, error,
-                                 llvm::sys::fs::FA_Write);
 
+  if (const auto *attr = FD.getAttr<clang::ReqdWorkGroupSizeAttr>()) {
+    kernel.reqd_work_group_size[0] = attr->getXDim();
+    kernel.reqd_work_group_size[1] = attr->getYDim();
+    kernel.reqd_work_group_size[2] = attr->getZDim();
+  }
+  if (const auto *attr = FD.getAttr<clang::WorkGroupSizeHintAttr>()) {
+    kernel.work_group_size_hint[0] = attr->getXDim();
+    kernel.work_group_size_hint[1] = attr->getYDim();
+    kernel.work_group_size_hint[2] = attr->getZDim();
+  }
+  if (const auto *attr = FD.getAttr<clang::VecTypeHintAttr>()) {
+    kernel.vec_type_hint = attr->getTypeHint().getAsString(policy);
+  }
+  return kernel;
+}
+
+// Records the signature of each kernel defined in the translation unit.
+class KernelSignatureConsumer final : public clang::ASTConsumer {
+public:
+  explicit KernelSignatureConsumer(
+      std::vector<clspv::KernelSignature> *kernels)
+      : kernels_(kernels) {}
+
+  bool HandleTopLevelDecl(clang::DeclGroupRef group) override {
+    for (auto *decl : group) {
+      const auto *FD = llvm::dyn_cast<clang::FunctionDecl>(decl);
+      if (FD && FD->hasBody() && FD->hasAttr<clang::OpenCLKernelAttr>())
+        kernels_->push_back(GetKernelSignature(*FD));
+    }
+    return true;
+  }
+
+private:
+  std::vector<clspv::KernelSignature> *kernels_;
+};
+
+// Parses and checks a program without generating code. The clspv frontend
+// checks run too, as they are added before any main action.
+class ValidateAction final : public clang::SyntaxOnlyAction {
+public:
+  explicit ValidateAction(std::vector<clspv::KernelSignature> *kernels)
+      : kernels_(kernels) {}
+
+protected:
+  std::unique_ptr<clang::ASTConsumer>
+  CreateASTConsumer(clang::CompilerInstance &, llvm::StringRef) override {
+    return std::make_unique<KernelSignatureConsumer>(kernels_);
+  }
+
+private:
+  std::vector<clspv::KernelSignature> *kernels_;
+};
+
+// Checks the OpenCL C |program| with the frontend only, with the clspv
+// options already parsed, and records its kernels in |kernels|. Diagnostics
+// refer to the input file of |options|. Returns 0 if the program has no
+// errors.
+int ValidateProgramFromString(FrontendOptions options,
+                              llvm::StringRef program,
+                              std::vector<clspv::KernelSignature> *kernels,
+                              std::string *output_log) {
+  assert(kernels && "Valid kernels container is required.");
+  kernels->clear();
+
+  options.InputLanguage = clang::Language::OpenCL;
+  llvm::StringRef overiddenInputFilename = options.InputFilename;
+
+  std::string builtins_pch;
+  if (auto error = PrepareBuiltinsPCH(options, &builtins_pch))
+    return error;
+
+  auto instance = std::make_unique<clang::CompilerInstance>();
+  clang::FrontendInputFile kernelFile(overiddenInputFilename,
+                                      clang::InputKind(options.InputLanguage));
+  std::string log;
+  llvm::raw_string_ostream diagnosticsStream(log);
+  if (auto error = SetCompilerInstanceOptions(
+          *instance, options, overiddenInputFilename, kernelFile, program,
+          builtins_pch, &diagnosticsStream))
+    return error;
+
+  ValidateAction action(kernels);
+  if (!action.BeginSourceFile(*instance, kernelFile)) {
+    return -1;
+  }
+  auto result = action.Execute();
+  action.EndSourceFile();
+
+  clang::DiagnosticConsumer *const consumer =
+      instance->getDiagnostics().getClient();
+  consumer->finish();
+
+  if (output_log != nullptr) {
+    *output_log = log;
+  }
+
+  if (result || consumer->getNumErrors() > 0) {
+    return -1;
+  }
+  return 0;
+}
+
+// Writes |kernels| in the format of -validate-only: a kernel line with the
+// attributes of each kernel followed by one line per argument.
+void WriteKernelSignatures(const std::vector<clspv::KernelSignature> &kernels,
+                           llvm::raw_ostream &out) {
+  for (const auto &kernel : kernels) {
+    out << "kernel," << kernel.name << ",reqd_work_group_size,"
+        << kernel.reqd_work_group_size[0] << ","
+        << kernel.reqd_work_group_size[1] << ","
+        << kernel.reqd_work_group_size[2] << ",work_group_size_hint,"
+        << kernel.work_group_size_hint[0] << ","
+        << kernel.work_group_size_hint[1] << ","
+        << kernel.work_group_size_hint[2] << ",vec_type_hint,"
+        << kernel.vec_type_hint << "\n";
+    for (size_t i = 0; i < kernel.args.size(); ++i) {
+      const auto &arg = kernel.args[i];
+      out << "kernel," << kernel.name << ",arg," << i << ",name," << arg.name
+          << ",type," << arg.type << ",address_space," << arg.address_space
+          << ",access_qualifier," << arg.access_qualifier
+          << ",type_qualifiers," << arg.type_qualifiers << "\n";
+    }
+  }
+}
+
+// Checks the input file of |options| as ValidateProgram does and writes the
+// signatures of its kernels to the output file. Returns 0 if the program has
+// no errors.
+int ValidateFile(FrontendOptions options) {
+  if (options.InputLanguage != clang::Language::OpenCL) {
+    llvm::errs() << "-validate-only requires OpenCL C input\n";
+    return -1;
+  }
+  std::unique_ptr<llvm::MemoryBuffer> source;
+  if (auto error = ReadInputFile(options, &source))
+    return error;
+  if (options.InputFilename == "-") {
+    options.InputFilename = "stdin.cl";
+  }
+
+  std::vector<clspv::KernelSignature> kernels;
+  std::string log;
+  const int status = ValidateProgramFromString(options, source->getBuffer(),
+                                               &kernels, &log);
+  llvm::errs() << log;
+
+  const std::string output_filename =
+      options.OutputFilename.empty() ? "-" : options.OutputFilename;
+  std::error_code error;
+  llvm::raw_fd_ostream out(output_filename, error, llvm::sys::fs::OF_Text);
   if (error) {
-    llvm::errs() << "Unable to open output file '" << OutputFilename
+    llvm::errs() << "Unable to open output file '" << output_filename
                  << "': " << error.message() << '\n';
     return -1;
   }
-  outStream << binaryStream.str();
+  WriteKernelSignatures(kernels, out);
+  return status;
+}
 
-  return 0;
+} // namespace
+
+namespace clspv {
+int Compile(const int argc, const char *const argv[]) {
+
+  std::unique_ptr<FrontendOptions> options;
+  std::unique_ptr<clspv::Option::ScopedOptionState> option_state;
+  if (auto error = ParseOptions(argc, argv, &options, &option_state))
+    return error;
+
+  if (options->ValidateOnly) {
+    if (options->InputFilenames.size() > 1 || !options->Manifest.empty()) {
+      llvm::errs() << "-validate-only takes a single input\n";
+      return -1;
+    }
+    return ValidateFile(*options);
+  }
+
+  if (options->InputFilenames.size() <= 1 && options->Manifest.empty())
+    return CompileFile(*options, argc, argv);
+
+  std::vector<std::pair<std::string, std::string>> jobs;
+  if (auto error = CollectJobs(*options, &jobs))
+    return error;
+
+  // Each input is compiled with the options of the command line and its own
+  // input and output files.
+  unsigned num_threads = options->Jobs;
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  num_threads = std::min(num_threads, static_cast<unsigned>(jobs.size()));
+
+  std::atomic<size_t> next(0);
+  std::atomic<int> status(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < jobs.size(); i = next++) {
+      // Sampler map parsing updates the option state.
+      clspv::Option::ScopedOptionState job_state(*option_state);
+      FrontendOptions job_options = *options;
+      job_options.InputFilename = jobs[i].first;
+      job_options.OutputFilename = jobs[i].second;
+      if (auto error = CompileFile(job_options, argc, argv)) {
+        llvm::errs() << "error: failed to compile '" << jobs[i].first
+                     << "'\n";
+        status = error;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < num_threads; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  return status;
 }
 
 int CompileFromSourceString(const std::string &program,
@@ -974,79 +2570,159 @@ int CompileFromSourceString(const std::string &program,
   llvm::cl::TokenizeGNUCommandLine(options, Saver, argv);
   int argc = static_cast<int>(argv.size());
 
-  if (auto error = ParseOptions(argc, &argv[0]))
+  std::unique_ptr<FrontendOptions> frontend_options;
+  std::unique_ptr<clspv::Option::ScopedOptionState> option_state;
+  if (auto error =
+          ParseOptions(argc, &argv[0], &frontend_options, &option_state))
     return error;
 
+  return CompileProgramFromString(*frontend_options, argc, &argv[0], program,
+                                  sampler_map, nullptr, output_binary,
+                                  output_log);
+}
+
+int CompileFromBuffer(const char *program, size_t program_size,
+                      const std::string &sampler_map,
+                      const std::string &options,
+                      std::vector<uint32_t> *output_binary,
+                      std::string *output_log) {
+  llvm::SmallVector<const char *, 20> argv;
+  llvm::BumpPtrAllocator A;
+  llvm::StringSaver Saver(A);
+  argv.push_back(Saver.save("clspv").data());
+  llvm::cl::TokenizeGNUCommandLine(options, Saver, argv);
+  int argc = static_cast<int>(argv.size());
+
+  std::unique_ptr<FrontendOptions> frontend_options;
+  std::unique_ptr<clspv::Option::ScopedOptionState> option_state;
+  if (auto error =
+          ParseOptions(argc, &argv[0], &frontend_options, &option_state))
+    return error;
+
+  return CompileProgramFromString(
+      *frontend_options, argc, &argv[0], llvm::StringRef(program, program_size),
+      sampler_map, nullptr, output_binary, output_log);
+}
+
+int PrecompileSamplerMap(const std::string &sampler_map,
+                         PrecompiledSamplerMap *precompiled) {
+  assert(precompiled && "Valid precompiled sampler map is required.");
   llvm::SmallVector<std::pair<unsigned, std::string>, 8> SamplerMapEntries;
-  if (auto error = ParseSamplerMap(sampler_map, &SamplerMapEntries))
+  if (auto error = ParseSamplerMapEntries(sampler_map, &SamplerMapEntries))
     return error;
 
-  InputFilename = "source.cl";
-  llvm::StringRef overiddenInputFilename = InputFilename.getValue();
+  precompiled->source = sampler_map;
+  precompiled->entries.assign(SamplerMapEntries.begin(),
+                              SamplerMapEntries.end());
+  return 0;
+}
 
-  clang::CompilerInstance instance;
-  clang::FrontendInputFile kernelFile(
-      overiddenInputFilename, clang::InputKind(clang::Language::OpenCL));
-  std::string log;
-  llvm::raw_string_ostream diagnosticsStream(log);
+int CompileFromSourceString(const std::string &program,
+                            const PrecompiledSamplerMap &sampler_map,
+                            const std::string &options,
+                            std::vector<uint32_t> *output_binary,
+                            std::string *output_log) {
+  llvm::SmallVector<const char *, 20> argv;
+  llvm::BumpPtrAllocator A;
+  llvm::StringSaver Saver(A);
+  argv.push_back(Saver.save("clspv").data());
+  llvm::cl::TokenizeGNUCommandLine(options, Saver, argv);
+  int argc = static_cast<int>(argv.size());
+
+  std::unique_ptr<FrontendOptions> frontend_options;
+  std::unique_ptr<clspv::Option::ScopedOptionState> option_state;
   if (auto error =
-          SetCompilerInstanceOptions(instance, overiddenInputFilename,
-                                     kernelFile, program, &diagnosticsStream))
+          ParseOptions(argc, &argv[0], &frontend_options, &option_state))
     return error;
 
-  // Parse.
-  llvm::LLVMContext context;
-  clang::EmitLLVMOnlyAction action(&context);
+  return CompileProgramFromString(*frontend_options, argc, &argv[0], program,
+                                  "", &sampler_map, output_binary, output_log);
+}
 
-  // Prepare the action for processing kernelFile
-  const bool success = action.BeginSourceFile(instance, kernelFile);
-  if (!success) {
-    return -1;
-  }
+int ValidateProgram(const std::string &program, const std::string &options,
+                    std::vector<KernelSignature> *kernels,
+                    std::string *output_log) {
+  llvm::SmallVector<const char *, 20> argv;
+  llvm::BumpPtrAllocator A;
+  llvm::StringSaver Saver(A);
+  argv.push_back(Saver.save("clspv").data());
+  llvm::cl::TokenizeGNUCommandLine(options, Saver, argv);
+  int argc = static_cast<int>(argv.size());
 
-  auto result = action.Execute();
-  action.EndSourceFile();
+  std::unique_ptr<FrontendOptions> frontend_options;
+  std::unique_ptr<clspv::Option::ScopedOptionState> option_state;
+  if (auto error =
+          ParseOptions(argc, &argv[0], &frontend_options, &option_state))
+    return error;
 
-  clang::DiagnosticConsumer *const consumer =
-      instance.getDiagnostics().getClient();
-  consumer->finish();
+  frontend_options->InputFilename = "source.cl";
+  return ValidateProgramFromString(*frontend_options, program, kernels,
+                                   output_log);
+}
 
-  if (output_log != nullptr) {
-    *output_log = log;
-  }
+int CompileBatch(const std::vector<BatchProgram> &programs,
+                 const std::string &options,
+                 std::vector<BatchResult> *results, unsigned num_threads) {
+  assert(results && "Valid results container is required.");
+  results->clear();
+  results->resize(programs.size());
 
-  auto num_errors = consumer->getNumErrors();
-  if (result || num_errors > 0) {
-    return -1;
-  }
+  llvm::SmallVector<const char *, 20> argv;
+  llvm::BumpPtrAllocator A;
+  llvm::StringSaver Saver(A);
+  argv.push_back(Saver.save("clspv").data());
+  llvm::cl::TokenizeGNUCommandLine(options, Saver, argv);
+  int argc = static_cast<int>(argv.size());
 
-  llvm::PassRegistry &Registry = *llvm::PassRegistry::getPassRegistry();
-  llvm::initializeCore(Registry);
-  llvm::initializeScalarOpts(Registry);
-  llvm::initializeClspvPasses(Registry);
+  // Parse the options once for the whole batch.
+  std::unique_ptr<FrontendOptions> frontend_options;
+  std::unique_ptr<clspv::Option::ScopedOptionState> option_state;
+  if (auto error =
+          ParseOptions(argc, &argv[0], &frontend_options, &option_state))
+    return error;
 
-  std::unique_ptr<llvm::Module> module(action.takeModule());
+  InitializePasses();
 
-  // Optimize.
-  // Create a memory buffer for temporarily writing the result.
-  SmallVector<char, 10000> binary;
-  llvm::raw_svector_ostream binaryStream(binary);
-  llvm::legacy::PassManager pm;
-  if (auto error = PopulatePassManager(&pm, &binaryStream, &SamplerMapEntries))
-    return error;
-  pm.run(*module);
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  num_threads = std::min(num_threads, static_cast<unsigned>(programs.size()));
+
+  // Each worker takes the next program until there are none left, so that
+  // long compilations do not hold up a statically assigned share of the batch.
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < programs.size(); i = next++) {
+      // Each program gets a fresh copy of the batch's option state, since
+      // sampler map parsing updates it.
+      clspv::Option::ScopedOptionState program_state(*option_state);
+      if (!programs[i].entry_points.empty()) {
+        clspv::Option::SetEntryPoints(programs[i].entry_points);
+      }
+      auto &result = (*results)[i];
+      result.status = CompileProgramFromString(
+          *frontend_options, argc, &argv[0], programs[i].program,
+          programs[i].sampler_map, programs[i].precompiled_sampler_map,
+          &result.binary, &result.log);
+    }
+  };
 
-  // Write the resulting binary.
-  // Wait until now to try writing the file so that we only write it on
-  // successful compilation.
-  assert(output_binary && "Valid binary container is required.");
-  if (!OutputFilename.empty()) {
-    llvm::outs()
-        << "Warning: -o is ignored when binary container is provided.\n";
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < num_threads; ++i) {
+    threads.emplace_back(worker);
+  }
+  // The calling thread does its share of the work too.
+  worker();
+  for (auto &thread : threads) {
+    thread.join();
   }
-  output_binary->resize(binary.size() / 4);
-  memcpy(output_binary->data(), binary.data(), binary.size());
 
-  return 0;
+  int status = 0;
+  for (const auto &result : *results) {
+    if (result.status != 0) {
+      status = result.status;
+    }
+  }
+  return status;
 }
 } // namespace clspv
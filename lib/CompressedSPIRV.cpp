@@ -0,0 +1,398 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstring>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Compression.h"
+#include "llvm/Support/Error.h"
+
+#include "spirv/unified1/spirv.hpp"
+
+#include "clspv/CompressedSPIRV.h"
+#include "clspv/ReflectionInfo.h"
+#include "clspv/ReflectionSidecar.h"
+
+namespace {
+
+// Number of words of the SPIR-V header.
+const uint32_t kHeaderWords = 5;
+
+// Instruction word counts from this value on are continued in another varint.
+const uint32_t kMaxInlineCount = 15;
+
+enum class Operand { Literal, Id, ResultId };
+
+// Returns true if instructions with |opcode| have neither a result type nor a
+// result id.
+bool HasNoResult(spv::Op opcode) {
+  switch (opcode) {
+  case spv::OpNop:
+  case spv::OpSource:
+  case spv::OpSourceExtension:
+  case spv::OpName:
+  case spv::OpMemberName:
+  case spv::OpLine:
+  case spv::OpNoLine:
+  case spv::OpExtension:
+  case spv::OpMemoryModel:
+  case spv::OpEntryPoint:
+  case spv::OpExecutionMode:
+  case spv::OpExecutionModeId:
+  case spv::OpCapability:
+  case spv::OpDecorate:
+  case spv::OpDecorateId:
+  case spv::OpMemberDecorate:
+  case spv::OpTypeForwardPointer:
+  case spv::OpFunctionEnd:
+  case spv::OpStore:
+  case spv::OpCopyMemory:
+  case spv::OpCopyMemorySized:
+  case spv::OpImageWrite:
+  case spv::OpAtomicStore:
+  case spv::OpControlBarrier:
+  case spv::OpMemoryBarrier:
+  case spv::OpLoopMerge:
+  case spv::OpSelectionMerge:
+  case spv::OpBranch:
+  case spv::OpBranchConditional:
+  case spv::OpSwitch:
+  case spv::OpKill:
+  case spv::OpReturn:
+  case spv::OpReturnValue:
+  case spv::OpUnreachable:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Returns how operand |index|, counted from 1, of an instruction with
+// |opcode| is encoded. The encoding only has to agree with the decoder: an
+// operand classified wrongly still round-trips, it just takes more bytes.
+Operand OperandKind(spv::Op opcode, uint32_t index) {
+  switch (opcode) {
+  case spv::OpString:
+  case spv::OpExtInstImport:
+  case spv::OpTypeInt:
+  case spv::OpTypeFloat:
+    return index == 1 ? Operand::ResultId : Operand::Literal;
+  case spv::OpTypeVector:
+  case spv::OpTypeImage:
+    return index == 1 ? Operand::ResultId
+                      : index == 2 ? Operand::Id : Operand::Literal;
+  case spv::OpTypePointer:
+    return index == 1 ? Operand::ResultId
+                      : index == 2 ? Operand::Literal : Operand::Id;
+  case spv::OpExecutionMode:
+  case spv::OpDecorate:
+  case spv::OpMemberDecorate:
+  case spv::OpSelectionMerge:
+  case spv::OpName:
+  case spv::OpMemberName:
+    return index == 1 ? Operand::Id : Operand::Literal;
+  case spv::OpStore:
+  case spv::OpCopyMemory:
+  case spv::OpLoopMerge:
+    return index <= 2 ? Operand::Id : Operand::Literal;
+  case spv::OpBranchConditional:
+    return index <= 3 ? Operand::Id : Operand::Literal;
+  case spv::OpSwitch:
+    // Selector, default, then pairs of a literal and a label.
+    return index <= 2 || (index - 3) % 2 == 1 ? Operand::Id
+                                               : Operand::Literal;
+  case spv::OpConstant:
+  case spv::OpSpecConstant:
+    return index == 1 ? Operand::Id
+                      : index == 2 ? Operand::ResultId : Operand::Literal;
+  case spv::OpVariable:
+  case spv::OpFunction:
+    // Storage class and function control.
+    return index == 1 ? Operand::Id
+                      : index == 2 ? Operand::ResultId
+                                   : index == 3 ? Operand::Literal
+                                                : Operand::Id;
+  case spv::OpExtInst:
+    // Instruction number.
+    return index == 2 ? Operand::ResultId
+                      : index == 4 ? Operand::Literal : Operand::Id;
+  case spv::OpLoad:
+  case spv::OpCompositeExtract:
+    // Memory operands and indices.
+    return index == 2 ? Operand::ResultId
+                      : index <= 3 ? Operand::Id : Operand::Literal;
+  case spv::OpCompositeInsert:
+  case spv::OpVectorShuffle:
+    return index == 2 ? Operand::ResultId
+                      : index <= 4 ? Operand::Id : Operand::Literal;
+  default:
+    break;
+  }
+
+  if (HasNoResult(opcode))
+    return Operand::Id;
+  if (opcode >= spv::OpTypeVoid && opcode <= spv::OpTypeForwardPointer)
+    return index == 1 ? Operand::ResultId : Operand::Id;
+  if (opcode == spv::OpLabel)
+    return Operand::ResultId;
+  return index == 2 ? Operand::ResultId : Operand::Id;
+}
+
+// Maps the two's complement differences around zero to small values.
+uint32_t ZigZag(uint32_t value) {
+  return (value << 1) ^ (0u - (value >> 31));
+}
+
+uint32_t UnZigZag(uint32_t value) { return (value >> 1) ^ (0u - (value & 1)); }
+
+void WriteVarint(uint32_t value, std::vector<char> *out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+void WriteWord(uint32_t value, std::vector<char> *out) {
+  char bytes[sizeof(uint32_t)];
+  memcpy(bytes, &value, sizeof(value));
+  out->insert(out->end(), bytes, bytes + sizeof(bytes));
+}
+
+} // namespace
+
+namespace clspv {
+
+bool CompressSPIRV(const uint32_t *words, size_t num_words, bool entropy,
+                   std::vector<char> *out) {
+  if (num_words < kHeaderWords || words[0] != spv::MagicNumber)
+    return false;
+
+  std::vector<char> stream;
+  stream.reserve(num_words * 2);
+  for (uint32_t i = 1; i < kHeaderWords; ++i) {
+    WriteVarint(words[i], &stream);
+  }
+  uint32_t last_result = 0;
+  for (size_t i = kHeaderWords; i < num_words;) {
+    const uint32_t word_count = words[i] >> 16;
+    const auto opcode = static_cast<spv::Op>(words[i] & spv::OpCodeMask);
+    if (word_count == 0 || i + word_count > num_words)
+      return false;
+
+    const uint32_t count = word_count - 1;
+    const uint32_t inline_count = std::min(count, kMaxInlineCount);
+    WriteVarint((static_cast<uint32_t>(opcode) << 4) | inline_count, &stream);
+    if (inline_count == kMaxInlineCount)
+      WriteVarint(count - kMaxInlineCount, &stream);
+
+    for (uint32_t index = 1; index < word_count; ++index) {
+      const uint32_t word = words[i + index];
+      switch (OperandKind(opcode, index)) {
+      case Operand::ResultId:
+        WriteVarint(ZigZag(word - (last_result + 1)), &stream);
+        last_result = word;
+        break;
+      case Operand::Id:
+        WriteVarint(ZigZag(last_result - word), &stream);
+        break;
+      case Operand::Literal:
+        WriteVarint(word, &stream);
+        break;
+      }
+    }
+    i += word_count;
+  }
+
+  llvm::SmallVector<char, 0> deflated;
+  bool deflate = entropy && llvm::zlib::isAvailable();
+  if (deflate) {
+    if (auto error =
+            llvm::zlib::compress(llvm::StringRef(stream.data(), stream.size()),
+                                 deflated, llvm::zlib::BestSizeCompression)) {
+      llvm::consumeError(std::move(error));
+      deflate = false;
+    } else {
+      deflate = deflated.size() < stream.size();
+    }
+  }
+
+  // The sidecar keeps the reflection readable without decoding. A module
+  // without reflection has an empty one.
+  std::vector<uint32_t> sidecar;
+  reflection::ReflectionInfo info;
+  if (reflection::ParseReflectionInfo(words, num_words, &info))
+    reflection::WriteSidecar(info, &sidecar);
+
+  out->clear();
+  WriteWord(kCompressedSPIRVMagic, out);
+  WriteWord(kCompressedSPIRVVersion, out);
+  WriteWord(deflate ? kCompressedSPIRVEntropy : 0, out);
+  WriteWord(static_cast<uint32_t>(num_words), out);
+  WriteWord(static_cast<uint32_t>(sidecar.size() * sizeof(uint32_t)), out);
+  WriteWord(static_cast<uint32_t>(deflate ? deflated.size() : stream.size()),
+            out);
+  WriteWord(static_cast<uint32_t>(stream.size()), out);
+  for (uint32_t word : sidecar) {
+    WriteWord(word, out);
+  }
+  if (deflate) {
+    out->insert(out->end(), deflated.begin(), deflated.end());
+  } else {
+    out->insert(out->end(), stream.begin(), stream.end());
+  }
+  return true;
+}
+
+bool IsCompressedSPIRV(const void *data, size_t size) {
+  uint32_t magic;
+  if (size < sizeof(CompressedSPIRVHeader))
+    return false;
+  memcpy(&magic, data, sizeof(magic));
+  return magic == kCompressedSPIRVMagic;
+}
+
+bool SPIRVDecompressor::init(const void *data, size_t size) {
+  if (!IsCompressedSPIRV(data, size))
+    return false;
+  header_ = static_cast<const CompressedSPIRVHeader *>(data);
+  if (header_->version != kCompressedSPIRVVersion ||
+      header_->reflection_size % sizeof(uint32_t) != 0 ||
+      header_->num_words < kHeaderWords)
+    return false;
+  const uint64_t stream_offset =
+      sizeof(CompressedSPIRVHeader) + uint64_t(header_->reflection_size);
+  if (stream_offset + header_->stream_size > size)
+    return false;
+
+  pos_ = static_cast<const uint8_t *>(data) + stream_offset;
+  end_ = pos_ + header_->stream_size;
+  if (header_->flags & kCompressedSPIRVEntropy) {
+    if (!llvm::zlib::isAvailable())
+      return false;
+    inflated_.resize(header_->encoded_size);
+    size_t inflated_size = inflated_.size();
+    if (auto error = llvm::zlib::uncompress(
+            llvm::StringRef(reinterpret_cast<const char *>(pos_),
+                            header_->stream_size),
+            reinterpret_cast<char *>(inflated_.data()), inflated_size)) {
+      llvm::consumeError(std::move(error));
+      return false;
+    }
+    if (inflated_size != inflated_.size())
+      return false;
+    pos_ = inflated_.data();
+    end_ = pos_ + inflated_.size();
+  }
+
+  decoded_words_ = 0;
+  last_result_ = 0;
+  failed_ = false;
+  return true;
+}
+
+bool SPIRVDecompressor::read(uint32_t *value) {
+  uint32_t result = 0;
+  for (uint32_t shift = 0; shift < 35; shift += 7) {
+    if (pos_ == end_)
+      return false;
+    const uint8_t byte = *pos_++;
+    result |= static_cast<uint32_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SPIRVDecompressor::next(std::vector<uint32_t> *words) {
+  if (failed_ || decoded_words_ == header_->num_words)
+    return false;
+  auto fail = [this]() {
+    failed_ = true;
+    return false;
+  };
+
+  if (decoded_words_ == 0) {
+    words->push_back(spv::MagicNumber);
+    for (uint32_t i = 1; i < kHeaderWords; ++i) {
+      uint32_t word;
+      if (!read(&word))
+        return fail();
+      words->push_back(word);
+    }
+    decoded_words_ = kHeaderWords;
+    return true;
+  }
+
+  uint32_t first;
+  if (!read(&first))
+    return fail();
+  if ((first >> 4) > spv::OpCodeMask)
+    return fail();
+  const auto opcode = static_cast<spv::Op>(first >> 4);
+  uint32_t count = first & kMaxInlineCount;
+  if (count == kMaxInlineCount) {
+    uint32_t rest;
+    if (!read(&rest) || rest > UINT16_MAX)
+      return fail();
+    count += rest;
+  }
+  const uint32_t word_count = count + 1;
+  if (word_count > UINT16_MAX ||
+      word_count > header_->num_words - decoded_words_)
+    return fail();
+
+  words->push_back((word_count << 16) | static_cast<uint32_t>(opcode));
+  for (uint32_t index = 1; index < word_count; ++index) {
+    uint32_t value;
+    if (!read(&value))
+      return fail();
+    switch (OperandKind(opcode, index)) {
+    case Operand::ResultId:
+      last_result_ += 1 + UnZigZag(value);
+      value = last_result_;
+      break;
+    case Operand::Id:
+      value = last_result_ - UnZigZag(value);
+      break;
+    case Operand::Literal:
+      break;
+    }
+    words->push_back(value);
+  }
+  decoded_words_ += word_count;
+
+  // The stream must end with the module.
+  if (decoded_words_ == header_->num_words && pos_ != end_)
+    return fail();
+  return true;
+}
+
+bool DecompressSPIRV(const void *data, size_t size,
+                     std::vector<uint32_t> *words) {
+  SPIRVDecompressor decoder;
+  if (!decoder.init(data, size))
+    return false;
+  words->clear();
+  words->reserve(decoder.num_words());
+  while (decoder.next(words)) {
+  }
+  return !decoder.failed();
+}
+
+} // namespace clspv
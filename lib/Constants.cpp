@@ -35,6 +35,18 @@ const std::string &ResourceAccessorFunction() {
   return func_name;
 }
 
+const std::string &PhysicalPointerFunction() {
+  static std::string func_name =
+      Builtins::GetMangledFunctionName("clspv.physical_pointer");
+  return func_name;
+}
+
+const std::string &PodSpecConstantFunction() {
+  static std::string func_name =
+      Builtins::GetMangledFunctionName("clspv.pod_spec_constant");
+  return func_name;
+}
+
 const std::string &RemappedTypeOffsetMetadataName() {
   static std::string func_name =
       Builtins::GetMangledFunctionName("clspv.remapped_offsets");
@@ -28,6 +28,13 @@ const std::string &WorkgroupAccessorFunction();
 // Base name for resource variable accessor function.
 const std::string &ResourceAccessorFunction();
 
+// Base name for the function converting a device address to a global pointer.
+const std::string &PhysicalPointerFunction();
+
+// Base name for the function reading a POD argument from a specialization
+// constant.
+const std::string &PodSpecConstantFunction();
+
 // Name for module level metadata storing UBO remapped type offsets.
 const std::string &RemappedTypeOffsetMetadataName();
 
@@ -73,12 +80,63 @@ inline std::string SpecConstantMetadataName() {
   return "clspv.spec_constant_list";
 }
 
+// Name for module level metadata storing the kernel, argument ordinal and spec
+// id of each POD argument read from a specialization constant.
+inline std::string PodSpecConstantMetadataName() {
+  return "clspv.pod_spec_constants";
+}
+
 // Pod args implementation metadata name.
 inline std::string PodArgsImplMetadataName() { return "clspv.pod_args_impl"; }
 
 // Clustered arguments mapping metadata name.
 inline std::string KernelArgMapMetadataName() { return "kernel_arg_map"; }
 
+// Name for module level metadata storing the argument names of each kernel,
+// for when the context discards value names.
+inline std::string KernelArgNamesMetadataName() {
+  return "clspv.kernel_arg_names";
+}
+
+// Name of the variable clustering the module-scope __constant variables.
+inline std::string ClusteredConstantsName() {
+  return "clspv.clustered_constants";
+}
+
+// Name of the storage buffer variable holding the -profile-counters counters.
+inline std::string ProfileCountersName() { return "clspv.profile_counters"; }
+
+// Name for module level metadata storing the location of each profiling
+// counter, in counter order.
+inline std::string ProfileCountersMetadataName() {
+  return "clspv.profile_counter_locations";
+}
+
+// Instruction metadata holding a copy of the llvm.loop metadata of the loop
+// whose header contains the instruction.
+inline std::string LoopMetadataName() { return "clspv.loop"; }
+
+// Loop ID hint marking a loop the source asks not to unroll, as opposed to a
+// loop the LLVM unroller has already unrolled.
+inline std::string SourceDontUnrollHintName() {
+  return "clspv.loop.source.dont_unroll";
+}
+
+// Function metadata on the accessor of a storage buffer variable whose kernel
+// arguments are all restrict, so the variable is decorated Restrict rather
+// than Aliased with -buffer-alias-decorations.
+inline std::string RestrictMetadataName() { return "clspv.restrict"; }
+
+// Instruction metadata marking the result of a half_ or native_ builtin
+// lowered to LLVM arithmetic, for -relaxed-precision.
+inline std::string RelaxedPrecisionMetadataName() {
+  return "clspv.relaxed_precision";
+}
+
+// Suffix of the name of the variant of a kernel that assumes a zero global
+// offset and a uniform NDRange.
+inline std::string UniformNDRangeKernelSuffix() { return ".uniform"; }
+
 } // namespace clspv
 
 #endif
@@ -0,0 +1,478 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CostReport.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "spirv/unified1/spirv.hpp"
+
+namespace {
+
+struct Instruction {
+  const uint32_t *words;
+  uint32_t word_count;
+  spv::Op opcode;
+};
+
+struct Function {
+  std::vector<Instruction> body;
+  std::vector<uint32_t> callees;
+};
+
+// Returns the word holding the result id of |inst|, or 0 if it has none.
+// Only valid for instructions in a function body.
+uint32_t ResultWord(const Instruction &inst) {
+  switch (inst.opcode) {
+  case spv::OpLabel:
+    return 1;
+  case spv::OpNop:
+  case spv::OpLine:
+  case spv::OpNoLine:
+  case spv::OpFunctionEnd:
+  case spv::OpStore:
+  case spv::OpCopyMemory:
+  case spv::OpCopyMemorySized:
+  case spv::OpImageWrite:
+  case spv::OpAtomicStore:
+  case spv::OpAtomicFlagClear:
+  case spv::OpControlBarrier:
+  case spv::OpMemoryBarrier:
+  case spv::OpLifetimeStart:
+  case spv::OpLifetimeStop:
+  case spv::OpLoopMerge:
+  case spv::OpSelectionMerge:
+  case spv::OpBranch:
+  case spv::OpBranchConditional:
+  case spv::OpSwitch:
+  case spv::OpKill:
+  case spv::OpReturn:
+  case spv::OpReturnValue:
+  case spv::OpUnreachable:
+    return 0;
+  default:
+    return inst.word_count > 2 ? 2 : 0;
+  }
+}
+
+// Calls |f| on each id operand of |inst|.  Literal operands are skipped for
+// the instructions that commonly have them; labels are not visited.
+template <typename F> void ForEachIdOperand(const Instruction &inst, F f) {
+  uint32_t begin = ResultWord(inst) ? 3 : 1;
+  uint32_t end = inst.word_count;
+  switch (inst.opcode) {
+  case spv::OpLabel:
+  case spv::OpLoopMerge:
+  case spv::OpSelectionMerge:
+  case spv::OpBranch:
+    return;
+  case spv::OpBranchConditional:
+  case spv::OpSwitch:
+    end = std::min(end, 2u);
+    break;
+  case spv::OpStore:
+    end = std::min(end, 3u);
+    break;
+  case spv::OpLoad:
+  case spv::OpCompositeExtract:
+    end = std::min(end, 4u);
+    break;
+  case spv::OpCompositeInsert:
+  case spv::OpVectorShuffle:
+    end = std::min(end, 5u);
+    break;
+  case spv::OpExtInst:
+    begin = 5;
+    break;
+  default:
+    break;
+  }
+  for (uint32_t i = begin; i < end; ++i) {
+    f(inst.words[i]);
+  }
+}
+
+// Returns the class of |opcode| reported in the instruction mix, or null if
+// it is not counted as an instruction.
+const char *OpcodeClass(spv::Op opcode) {
+  switch (opcode) {
+  case spv::OpFunction:
+  case spv::OpFunctionParameter:
+  case spv::OpFunctionEnd:
+  case spv::OpLabel:
+  case spv::OpLine:
+  case spv::OpNoLine:
+  case spv::OpNop:
+    return nullptr;
+  case spv::OpVariable:
+  case spv::OpLoad:
+  case spv::OpStore:
+  case spv::OpCopyMemory:
+  case spv::OpCopyMemorySized:
+  case spv::OpAccessChain:
+  case spv::OpInBoundsAccessChain:
+  case spv::OpPtrAccessChain:
+  case spv::OpInBoundsPtrAccessChain:
+  case spv::OpArrayLength:
+    return "memory";
+  case spv::OpControlBarrier:
+  case spv::OpMemoryBarrier:
+    return "barrier";
+  case spv::OpExtInst:
+    return "ext_inst";
+  case spv::OpFunctionCall:
+  case spv::OpPhi:
+  case spv::OpLoopMerge:
+  case spv::OpSelectionMerge:
+  case spv::OpBranch:
+  case spv::OpBranchConditional:
+  case spv::OpSwitch:
+  case spv::OpKill:
+  case spv::OpReturn:
+  case spv::OpReturnValue:
+  case spv::OpUnreachable:
+    return "control_flow";
+  case spv::OpAtomicFlagTestAndSet:
+  case spv::OpAtomicFlagClear:
+    return "atomic";
+  default:
+    break;
+  }
+  if (opcode >= spv::OpSNegate && opcode <= spv::OpSMulExtended)
+    return "arithmetic";
+  if (opcode >= spv::OpShiftRightLogical && opcode <= spv::OpBitCount)
+    return "bitwise";
+  if (opcode >= spv::OpAny && opcode <= spv::OpFUnordGreaterThanEqual)
+    return "comparison";
+  if (opcode >= spv::OpConvertFToU && opcode <= spv::OpBitcast)
+    return "conversion";
+  if (opcode >= spv::OpVectorExtractDynamic && opcode <= spv::OpTranspose)
+    return "composite";
+  if (opcode >= spv::OpSampledImage && opcode <= spv::OpImageQuerySamples)
+    return "image";
+  if (opcode >= spv::OpAtomicLoad && opcode <= spv::OpAtomicXor)
+    return "atomic";
+  return "other";
+}
+
+const char *StorageClassName(uint32_t storage_class) {
+  switch (storage_class) {
+  case spv::StorageClassUniformConstant:
+    return "UniformConstant";
+  case spv::StorageClassInput:
+    return "Input";
+  case spv::StorageClassUniform:
+    return "Uniform";
+  case spv::StorageClassWorkgroup:
+    return "Workgroup";
+  case spv::StorageClassPrivate:
+    return "Private";
+  case spv::StorageClassFunction:
+    return "Function";
+  case spv::StorageClassPushConstant:
+    return "PushConstant";
+  case spv::StorageClassImage:
+    return "Image";
+  case spv::StorageClassStorageBuffer:
+    return "StorageBuffer";
+  case spv::StorageClassPhysicalStorageBuffer:
+    return "PhysicalStorageBuffer";
+  default:
+    return "Unknown";
+  }
+}
+
+// Adds the statistics of |function| to |kernel|.
+void AddFunction(
+    const Function &function,
+    const llvm::DenseMap<uint32_t, uint32_t> &value_storage,
+    const llvm::DenseMap<uint32_t, uint32_t> &pointer_types,
+    const llvm::DenseSet<uint32_t> &uniform_ids,
+    const llvm::DenseSet<uint32_t> &non_uniform_ids,
+    const llvm::DenseSet<uint32_t> &coherent_variables,
+    llvm::DenseSet<uint32_t> *coherent_used,
+    clspv::CostReport::Kernel *kernel) {
+  auto storage_class = [&value_storage](uint32_t id) {
+    auto iter = value_storage.find(id);
+    return StorageClassName(iter == value_storage.end() ? ~0u : iter->second);
+  };
+
+  // The position of each value and label defined in the function.
+  llvm::DenseMap<uint32_t, size_t> defs;
+  llvm::DenseMap<uint32_t, size_t> labels;
+  const auto &body = function.body;
+  for (size_t i = 0; i < body.size(); ++i) {
+    const auto &inst = body[i];
+    if (inst.opcode == spv::OpLabel) {
+      labels[inst.words[1]] = i;
+    } else if (inst.opcode != spv::OpFunction) {
+      if (auto word = ResultWord(inst))
+        defs[inst.words[word]] = i;
+    }
+  }
+
+  size_t block = 0;
+  for (size_t i = 0; i < body.size(); ++i) {
+    const auto &inst = body[i];
+    if (const char *name = OpcodeClass(inst.opcode)) {
+      ++kernel->instructions;
+      ++kernel->classes[name];
+    }
+    if (inst.opcode != spv::OpLabel) {
+      if (auto word = ResultWord(inst)) {
+        kernel->uniform_values += uniform_ids.count(inst.words[word]);
+        kernel->non_uniform_pointers += non_uniform_ids.count(inst.words[word]);
+      }
+    }
+    ForEachIdOperand(inst, [&](uint32_t id) {
+      if (coherent_variables.count(id))
+        coherent_used->insert(id);
+    });
+
+    switch (inst.opcode) {
+    case spv::OpLabel:
+      block = i;
+      break;
+    case spv::OpPhi:
+    case spv::OpSelect:
+      if (inst.opcode == spv::OpPhi)
+        ++kernel->phis;
+      if (pointer_types.count(inst.words[1]))
+        ++kernel->variable_pointers;
+      break;
+    case spv::OpControlBarrier:
+    case spv::OpMemoryBarrier:
+      ++kernel->barriers;
+      break;
+    case spv::OpAccessChain:
+    case spv::OpInBoundsAccessChain:
+    case spv::OpPtrAccessChain:
+    case spv::OpInBoundsPtrAccessChain:
+      ++kernel->access_chains;
+      kernel->max_access_chain_depth =
+          std::max<uint64_t>(kernel->max_access_chain_depth,
+                             inst.word_count > 4 ? inst.word_count - 4 : 0);
+      break;
+    case spv::OpLoad:
+      if (inst.word_count > 3)
+        ++kernel->loads[storage_class(inst.words[3])];
+      break;
+    case spv::OpStore:
+      if (inst.word_count > 2)
+        ++kernel->stores[storage_class(inst.words[1])];
+      break;
+    case spv::OpLoopMerge: {
+      ++kernel->loops;
+      auto merge = labels.find(inst.word_count > 1 ? inst.words[1] : 0);
+      if (merge == labels.end() || merge->second <= block)
+        break;
+      // Values defined before the header and used in the loop are live in
+      // the header, as are its phis.
+      llvm::DenseSet<uint32_t> live;
+      uint64_t header_phis = 0;
+      while (body[block + 1 + header_phis].opcode == spv::OpPhi)
+        ++header_phis;
+      for (size_t j = block; j < merge->second; ++j) {
+        ForEachIdOperand(body[j], [&](uint32_t id) {
+          auto def = defs.find(id);
+          if (def != defs.end() && def->second < block)
+            live.insert(id);
+        });
+      }
+      kernel->max_loop_live_values = std::max<uint64_t>(
+          kernel->max_loop_live_values, live.size() + header_phis);
+      break;
+    }
+    default:
+      break;
+    }
+  }
+}
+
+} // namespace
+
+namespace clspv {
+
+bool CostReport::parse(const uint32_t *words, size_t num_words) {
+  kernels_.clear();
+  // Header: magic, version, generator, bound, schema.
+  if (num_words < 5 || words[0] != spv::MagicNumber)
+    return false;
+
+  std::vector<std::pair<uint32_t, std::string>> entry_points;
+  // The storage class of each pointer type, and of each pointer value.
+  llvm::DenseMap<uint32_t, uint32_t> pointer_types;
+  llvm::DenseMap<uint32_t, uint32_t> value_storage;
+  // The ids decorated Uniform and NonUniformEXT.
+  llvm::DenseSet<uint32_t> uniform_ids;
+  llvm::DenseSet<uint32_t> non_uniform_ids;
+  // The ids decorated Coherent, and the module-scope variables among them.
+  llvm::DenseSet<uint32_t> coherent_ids;
+  llvm::DenseSet<uint32_t> coherent_variables;
+  std::vector<Function> functions;
+  llvm::DenseMap<uint32_t, size_t> function_index;
+  Function *current = nullptr;
+
+  for (size_t i = 5; i < num_words;) {
+    const uint32_t *inst = words + i;
+    const uint32_t word_count = inst[0] >> 16;
+    const auto opcode = static_cast<spv::Op>(inst[0] & spv::OpCodeMask);
+    if (word_count == 0 || i + word_count > num_words)
+      return false;
+    i += word_count;
+
+    switch (opcode) {
+    case spv::OpEntryPoint:
+      if (word_count > 3) {
+        const char *name = reinterpret_cast<const char *>(inst + 3);
+        entry_points.emplace_back(
+            inst[2],
+            std::string(name, strnlen(name, (word_count - 3) *
+                                                sizeof(uint32_t))));
+      }
+      break;
+    case spv::OpDecorate:
+      if (word_count == 3 && inst[2] == spv::DecorationUniform)
+        uniform_ids.insert(inst[1]);
+      if (word_count == 3 && inst[2] == spv::DecorationNonUniformEXT)
+        non_uniform_ids.insert(inst[1]);
+      if (word_count == 3 && inst[2] == spv::DecorationCoherent)
+        coherent_ids.insert(inst[1]);
+      break;
+    case spv::OpTypePointer:
+      if (word_count == 4)
+        pointer_types[inst[1]] = inst[2];
+      break;
+    case spv::OpVariable:
+      if (!current && word_count >= 4) {
+        value_storage[inst[2]] = inst[3];
+        if (coherent_ids.count(inst[2]))
+          coherent_variables.insert(inst[2]);
+      }
+      break;
+    case spv::OpFunction:
+      if (current || word_count != 5)
+        return false;
+      function_index[inst[2]] = functions.size();
+      functions.emplace_back();
+      current = &functions.back();
+      break;
+    default:
+      break;
+    }
+
+    if (!current)
+      continue;
+    const Instruction instruction{inst, word_count, opcode};
+    current->body.push_back(instruction);
+    if (opcode == spv::OpFunctionCall && word_count > 3)
+      current->callees.push_back(inst[3]);
+    if (ResultWord(instruction) == 2) {
+      auto pointer = pointer_types.find(inst[1]);
+      if (pointer != pointer_types.end())
+        value_storage[inst[2]] = pointer->second;
+    }
+    if (opcode == spv::OpFunctionEnd)
+      current = nullptr;
+  }
+  if (current)
+    return false;
+
+  for (const auto &entry_point : entry_points) {
+    Kernel kernel;
+    kernel.name = entry_point.second;
+    // Every function reachable from the entry point is counted once.
+    llvm::DenseSet<uint32_t> visited;
+    llvm::DenseSet<uint32_t> coherent_used;
+    llvm::SmallVector<uint32_t, 8> worklist{entry_point.first};
+    while (!worklist.empty()) {
+      const uint32_t id = worklist.pop_back_val();
+      auto index = function_index.find(id);
+      if (index == function_index.end() || !visited.insert(id).second)
+        continue;
+      const auto &function = functions[index->second];
+      AddFunction(function, value_storage, pointer_types, uniform_ids,
+                  non_uniform_ids, coherent_variables, &coherent_used,
+                  &kernel);
+      worklist.append(function.callees.begin(), function.callees.end());
+    }
+    kernel.coherent_resources = coherent_used.size();
+    kernels_.push_back(std::move(kernel));
+  }
+  return true;
+}
+
+void CostReport::writeJSON(llvm::raw_ostream &out) const {
+  auto counts = [](llvm::json::OStream &json, llvm::StringRef name,
+                   const std::map<std::string, uint64_t> &values) {
+    json.attributeObject(name, [&] {
+      for (const auto &value : values) {
+        json.attribute(value.first, int64_t(value.second));
+      }
+    });
+  };
+
+  llvm::json::OStream json(out, 2);
+  json.object([&] {
+    json.attributeArray("kernels", [&] {
+      for (const auto &kernel : kernels_) {
+        json.object([&] {
+          json.attribute("name", kernel.name);
+          json.attribute("instructions", int64_t(kernel.instructions));
+          counts(json, "classes", kernel.classes);
+          json.attribute("phis", int64_t(kernel.phis));
+          json.attribute("barriers", int64_t(kernel.barriers));
+          json.attribute("access_chains", int64_t(kernel.access_chains));
+          json.attribute("max_access_chain_depth",
+                         int64_t(kernel.max_access_chain_depth));
+          counts(json, "loads", kernel.loads);
+          counts(json, "stores", kernel.stores);
+          json.attribute("variable_pointers",
+                         int64_t(kernel.variable_pointers));
+          json.attribute("loops", int64_t(kernel.loops));
+          json.attribute("max_loop_live_values",
+                         int64_t(kernel.max_loop_live_values));
+          json.attribute("uniform_values", int64_t(kernel.uniform_values));
+          json.attribute("non_uniform_pointers",
+                         int64_t(kernel.non_uniform_pointers));
+          json.attribute("coherent_resources",
+                         int64_t(kernel.coherent_resources));
+        });
+      }
+    });
+  });
+  out << "\n";
+}
+
+int CostReport::writeJSONFile(llvm::StringRef filename) const {
+  std::error_code error;
+  llvm::raw_fd_ostream out(filename, error, llvm::sys::fs::OF_Text);
+  if (error) {
+    llvm::errs() << "Unable to open cost report file '" << filename
+                 << "': " << error.message() << '\n';
+    return -1;
+  }
+  writeJSON(out);
+  return 0;
+}
+
+} // namespace clspv
@@ -0,0 +1,81 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_LIB_COST_REPORT_H_
+#define CLSPV_LIB_COST_REPORT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+
+namespace llvm {
+class raw_ostream;
+} // namespace llvm
+
+namespace clspv {
+
+// Static statistics of the entry points of a SPIR-V module, used to triage
+// the code generated for a kernel without running it.
+class CostReport {
+public:
+  struct Kernel {
+    std::string name;
+    // Counts over the entry point and every function it calls.
+    uint64_t instructions = 0;
+    std::map<std::string, uint64_t> classes;
+    uint64_t phis = 0;
+    uint64_t barriers = 0;
+    uint64_t access_chains = 0;
+    uint64_t max_access_chain_depth = 0;
+    std::map<std::string, uint64_t> loads;
+    std::map<std::string, uint64_t> stores;
+    // OpPhi and OpSelect producing a pointer.
+    uint64_t variable_pointers = 0;
+    uint64_t loops = 0;
+    // The most values defined before a loop and used in it, plus the phis of
+    // its header, over the loops of the kernel.  The loop is taken to span
+    // the blocks laid out from its header to its merge block.
+    uint64_t max_loop_live_values = 0;
+    // Values decorated Uniform and pointers decorated NonUniformEXT, with
+    // -uniformity-decorations.
+    uint64_t uniform_values = 0;
+    uint64_t non_uniform_pointers = 0;
+    // Resource variables decorated Coherent the kernel accesses.
+    uint64_t coherent_resources = 0;
+  };
+
+  // Computes the statistics of the |num_words| words of SPIR-V in |words|.
+  // Returns false if the binary is malformed.
+  bool parse(const uint32_t *words, size_t num_words);
+
+  const std::vector<Kernel> &kernels() const { return kernels_; }
+
+  // Writes the statistics as a JSON object to |out|.
+  void writeJSON(llvm::raw_ostream &out) const;
+
+  // Writes the statistics as JSON to the file |filename|.  Returns 0 if
+  // successful.
+  int writeJSONFile(llvm::StringRef filename) const;
+
+private:
+  std::vector<Kernel> kernels_;
+};
+
+} // namespace clspv
+
+#endif // CLSPV_LIB_COST_REPORT_H_
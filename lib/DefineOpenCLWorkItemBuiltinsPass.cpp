@@ -12,11 +12,15 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 
 #include "clspv/AddressSpace.h"
 #include "clspv/Option.h"
@@ -51,8 +55,28 @@ struct DefineOpenCLWorkItemBuiltinsPass final : public ModulePass {
   bool defineGlobalOffsetBuiltin(Module &M);
   bool defineWorkDimBuiltin(Module &M);
   bool defineEnqueuedLocalSizeBuiltin(Module &M);
+  bool defineSpecializedLocalSizeBuiltin(Module &M, StringRef FuncName);
 
   bool addWorkgroupSizeIfRequired(Module &M);
+
+  // Applies -local-size to the kernels of |M| and sets LocalSize.
+  bool specializeLocalSize(Module &M);
+
+  // Applies -uniform-ndrange-variants: clones the kernels of |M| reaching a
+  // work-item builtin that reads the global offset or the NDRange region,
+  // together with the functions they call on the way, and computes those
+  // builtins in the clones as if the global offset was zero and the NDRange
+  // uniform.
+  bool createUniformNDRangeVariants(Module &M);
+
+  // Returns the value of the work-item builtin called by |Call| for a
+  // dispatch with a zero global offset and a uniform NDRange. Instructions
+  // are inserted before |Call|.
+  Value *uniformNDRangeBuiltin(Module &M, CallInst *Call);
+
+  // The <3 x i32> local size of every kernel when the module is specialized
+  // with -local-size, or nullptr otherwise.
+  Constant *LocalSize = nullptr;
 };
 } // namespace
 
@@ -70,12 +94,20 @@ ModulePass *createDefineOpenCLWorkItemBuiltinsPass() {
 bool DefineOpenCLWorkItemBuiltinsPass::runOnModule(Module &M) {
   bool changed = false;
 
+  changed |= specializeLocalSize(M);
+  changed |= createUniformNDRangeVariants(M);
   changed |= defineGlobalOffsetBuiltin(M);
   changed |= defineGlobalIDBuiltin(M);
 
-  changed |=
-      defineMappedBuiltin(M, "_Z14get_local_sizej", "__spirv_WorkgroupSize", 1,
-                          AddressSpace::ModuleScopePrivate);
+  // With a non-uniform NDRange the last workgroup can be smaller, so only the
+  // enqueued local size is known.
+  if (LocalSize && !clspv::Option::NonUniformNDRangeSupported()) {
+    changed |= defineSpecializedLocalSizeBuiltin(M, "_Z14get_local_sizej");
+  } else {
+    changed |= defineMappedBuiltin(M, "_Z14get_local_sizej",
+                                   "__spirv_WorkgroupSize", 1,
+                                   AddressSpace::ModuleScopePrivate);
+  }
   changed |= defineMappedBuiltin(M, "_Z12get_local_idj",
                                  "__spirv_LocalInvocationId", 0);
   changed |= defineNumGroupsBuiltin(M);
@@ -91,6 +123,11 @@ bool DefineOpenCLWorkItemBuiltinsPass::runOnModule(Module &M) {
 GlobalVariable *DefineOpenCLWorkItemBuiltinsPass::createGlobalVariable(
     Module &M, StringRef GlobalVarName, Type *Ty,
     AddressSpace::Type AddrSpace) {
+  // The uniform NDRange variants of kernels share the builtin variables.
+  if (auto GV = M.getGlobalVariable(GlobalVarName)) {
+    return GV;
+  }
+
   auto GV = new GlobalVariable(
       M, Ty, false, GlobalValue::ExternalLinkage, nullptr, GlobalVarName,
       nullptr, GlobalValue::ThreadLocalMode::NotThreadLocal, AddrSpace);
@@ -257,8 +294,10 @@ bool DefineOpenCLWorkItemBuiltinsPass::defineGlobalSizeBuiltin(Module &M) {
       NWG = createGlobalVariable(M, NumWorkgroups, VT, AddressSpace::Input);
     }
 
-    // Load the workgroup size.
-    Value *LoadWGS = Builder.CreateLoad(Builder.CreateGEP(WGS, Indices));
+    // Load the workgroup size, unless it is known.
+    Value *LoadWGS =
+        LocalSize ? Builder.CreateExtractElement(LocalSize, InBoundsDim)
+                  : Builder.CreateLoad(Builder.CreateGEP(WGS, Indices));
 
     // And the number of workgroups.
     Value *LoadNWG = Builder.CreateLoad(Builder.CreateGEP(NWG, Indices));
@@ -438,6 +477,10 @@ bool DefineOpenCLWorkItemBuiltinsPass::defineWorkDimBuiltin(Module &M) {
 bool DefineOpenCLWorkItemBuiltinsPass::defineEnqueuedLocalSizeBuiltin(
     Module &M) {
 
+  if (LocalSize) {
+    return defineSpecializedLocalSizeBuiltin(M, "_Z23get_enqueued_local_sizej");
+  }
+
   Function *F = M.getFunction("_Z23get_enqueued_local_sizej");
 
   // If the builtin was not used in the module, don't create it!
@@ -485,3 +528,198 @@ bool DefineOpenCLWorkItemBuiltinsPass::addWorkgroupSizeIfRequired(Module &M) {
 
   return false;
 }
+
+bool DefineOpenCLWorkItemBuiltinsPass::defineSpecializedLocalSizeBuiltin(
+    Module &M, StringRef FuncName) {
+  Function *F = M.getFunction(FuncName);
+
+  // If the builtin was not used in the module, don't create it!
+  if (nullptr == F) {
+    return false;
+  }
+
+  BasicBlock *BB = BasicBlock::Create(M.getContext(), "body", F);
+  IRBuilder<> Builder(BB);
+
+  auto Dim = &*F->arg_begin();
+  auto InBoundsDim = inBoundsDimensionIndex(Builder, Dim);
+  auto Size = Builder.CreateExtractElement(LocalSize, InBoundsDim);
+  auto Ret = inBoundsDimensionOrDefaultValue(Builder, Dim, Size, 1);
+  Builder.CreateRet(Ret);
+
+  return true;
+}
+
+bool DefineOpenCLWorkItemBuiltinsPass::specializeLocalSize(Module &M) {
+  LocalSize = nullptr;
+  const auto Sizes = clspv::Option::LocalSize();
+  if (Sizes.empty()) {
+    return false;
+  }
+
+  auto &C = M.getContext();
+  IntegerType *IT = IntegerType::get(C, 32);
+  Constant *Values[] = {ConstantInt::get(IT, Sizes[0]),
+                        ConstantInt::get(IT, Sizes[1]),
+                        ConstantInt::get(IT, Sizes[2])};
+
+  bool changed = false;
+  for (auto &F : M) {
+    if (F.isDeclaration() || F.getCallingConv() != CallingConv::SPIR_KERNEL) {
+      continue;
+    }
+
+    // The frontend diagnoses conflicting attributes in OpenCL C sources, so
+    // only IR inputs can get to the error below.
+    if (const MDNode *MD = F.getMetadata("reqd_work_group_size")) {
+      for (unsigned i = 0; i < 3; ++i) {
+        if (mdconst::extract<ConstantInt>(MD->getOperand(i))->getZExtValue() !=
+            Sizes[i]) {
+          errs() << "error: kernel " << F.getName()
+                 << " has a reqd_work_group_size different from -local-size\n";
+          llvm_unreachable("reqd_work_group_size conflicts with -local-size!");
+        }
+      }
+      continue;
+    }
+
+    // Give the kernel the same attribute the source could have used, so the
+    // SPIR-V producer emits the size as the LocalSize execution mode and in
+    // the reflection.
+    Metadata *MDs[] = {ConstantAsMetadata::get(Values[0]),
+                       ConstantAsMetadata::get(Values[1]),
+                       ConstantAsMetadata::get(Values[2])};
+    F.setMetadata("reqd_work_group_size", MDNode::get(C, MDs));
+    changed = true;
+  }
+
+  LocalSize = ConstantVector::get(Values);
+  return changed;
+}
+
+bool DefineOpenCLWorkItemBuiltinsPass::createUniformNDRangeVariants(Module &M) {
+  if (!clspv::Option::UniformNDRangeVariants()) {
+    return false;
+  }
+
+  // With a non-uniform NDRange the builtins read the region of the NDRange
+  // being dispatched from push constants. Otherwise only the global ID and the
+  // global offset depend on the global offset.
+  SmallVector<StringRef, 5> Names;
+  if (clspv::Option::NonUniformNDRangeSupported()) {
+    Names.append({"_Z13get_global_idj", "_Z12get_group_idj",
+                  "_Z15get_global_sizej", "_Z14get_num_groupsj"});
+  }
+  if (clspv::Option::GlobalOffset() ||
+      clspv::Option::GlobalOffsetPushConstant()) {
+    if (Names.empty()) {
+      Names.push_back("_Z13get_global_idj");
+    }
+    Names.push_back("_Z17get_global_offsetj");
+  }
+
+  SmallPtrSet<Function *, 5> Builtins;
+  SmallVector<Function *, 8> WorkList;
+  for (auto Name : Names) {
+    if (auto F = M.getFunction(Name)) {
+      Builtins.insert(F);
+      WorkList.push_back(F);
+    }
+  }
+
+  // Find the functions calling the builtins, directly or not.
+  SmallPtrSet<Function *, 16> Callers;
+  while (!WorkList.empty()) {
+    auto F = WorkList.pop_back_val();
+    for (auto U : F->users()) {
+      if (auto Call = dyn_cast<CallInst>(U)) {
+        auto Caller = Call->getFunction();
+        if (Callers.insert(Caller).second) {
+          WorkList.push_back(Caller);
+        }
+      }
+    }
+  }
+
+  SmallVector<Function *, 16> Functions;
+  bool HasKernel = false;
+  for (auto &F : M) {
+    if (Callers.count(&F)) {
+      Functions.push_back(&F);
+      HasKernel |= F.getCallingConv() == CallingConv::SPIR_KERNEL;
+    }
+  }
+  if (!HasKernel) {
+    return false;
+  }
+
+  MapVector<Function *, Function *> Variants;
+  for (auto F : Functions) {
+    ValueToValueMapTy VMap;
+    auto Variant = CloneFunction(F, VMap);
+    Variant->setName(F->getName() + clspv::UniformNDRangeKernelSuffix());
+    Variants[F] = Variant;
+  }
+
+  for (auto &Entry : Variants) {
+    for (auto &BB : *Entry.second) {
+      for (auto &I : make_early_inc_range(BB)) {
+        auto Call = dyn_cast<CallInst>(&I);
+        if (!Call) {
+          continue;
+        }
+        auto Callee = Call->getCalledFunction();
+        if (Variants.count(Callee)) {
+          Call->setCalledFunction(Variants[Callee]);
+        } else if (Builtins.count(Callee)) {
+          Call->replaceAllUsesWith(uniformNDRangeBuiltin(M, Call));
+          Call->eraseFromParent();
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+Value *DefineOpenCLWorkItemBuiltinsPass::uniformNDRangeBuiltin(Module &M,
+                                                              CallInst *Call) {
+  IRBuilder<> Builder(Call);
+  auto Name = Call->getCalledFunction()->getName();
+  auto Dim = Call->getArgOperand(0);
+
+  if (Name == "_Z17get_global_offsetj") {
+    return Builder.getInt32(0);
+  }
+
+  IntegerType *IT = IntegerType::get(M.getContext(), 32);
+  VectorType *VT = FixedVectorType::get(IT, 3);
+  auto InBoundsDim = inBoundsDimensionIndex(Builder, Dim);
+  Value *Indices[] = {Builder.getInt32(0), InBoundsDim};
+  auto LoadBuiltin = [&](StringRef GlobalVarName,
+                         AddressSpace::Type AddrSpace) -> Value * {
+    auto GV = createGlobalVariable(M, GlobalVarName, VT, AddrSpace);
+    return Builder.CreateLoad(Builder.CreateGEP(GV, Indices));
+  };
+
+  if (Name == "_Z13get_global_idj") {
+    auto Gid = LoadBuiltin("__spirv_GlobalInvocationId", AddressSpace::Input);
+    return inBoundsDimensionOrDefaultValue(Builder, Dim, Gid, 0);
+  } else if (Name == "_Z12get_group_idj") {
+    auto GroupID = LoadBuiltin("__spirv_WorkgroupId", AddressSpace::Input);
+    return inBoundsDimensionOrDefaultValue(Builder, Dim, GroupID, 0);
+  }
+
+  auto NumGroups = LoadBuiltin("__spirv_NumWorkgroups", AddressSpace::Input);
+  if (Name == "_Z14get_num_groupsj") {
+    return inBoundsDimensionOrDefaultValue(Builder, Dim, NumGroups, 1);
+  }
+
+  // A uniform NDRange is made of whole workgroups.
+  Value *WorkgroupSize =
+      LocalSize ? Builder.CreateExtractElement(LocalSize, InBoundsDim)
+                : LoadBuiltin("__spirv_WorkgroupSize",
+                              AddressSpace::ModuleScopePrivate);
+  auto GlobalSize = Builder.CreateMul(WorkgroupSize, NumGroups);
+  return inBoundsDimensionOrDefaultValue(Builder, Dim, GlobalSize, 1);
+}
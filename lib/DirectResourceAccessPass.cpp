@@ -12,9 +12,11 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <climits>
 #include <map>
 #include <set>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -30,6 +32,7 @@
 #include "llvm/Pass.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 
 #include "clspv/Option.h"
 
@@ -57,6 +60,44 @@ public:
   bool runOnModule(Module &M) override;
 
 private:
+  // Describes the resource access a pointer parameter is derived from.
+  struct ParamInfo {
+    // The base value. It is either a global variable or a resource-access
+    // builtin function. (@clspv.resource.var.* or @clspv.local.var.*)
+    Value *base;
+    // The descriptor set.
+    uint32_t set;
+    // The binding.
+    uint32_t binding;
+    // If the parameter is a GEP, then this is the number of zero-indices
+    // the GEP used.
+    unsigned num_gep_zeroes;
+    // An example call fitting
+    CallInst *sample_call;
+
+    // Returns true if |other| accesses the same resource in the same way.
+    bool Matches(const ParamInfo &other) const {
+      return base == other.base && set == other.set &&
+             binding == other.binding &&
+             num_gep_zeroes == other.num_gep_zeroes;
+    }
+  };
+
+  // Returns true if |arg| maps to a resource variable (descriptor) or to a
+  // workgroup variable.
+  bool IsResourceArg(Argument &arg);
+
+  // Returns true if |value| is a direct call to a resource access builtin or a
+  // global variable, possibly through GEPs with only zero indices, and
+  // describes it in |info|.
+  bool GetParamInfo(Value *value, ParamInfo *info);
+
+  // If the callers of |fn| pass different resources to it, clones |fn| so that
+  // each group of call sites passing the same resources calls its own copy.
+  // Cloning stops once it would add more than |*budget| instructions, and the
+  // instructions added are taken from |*budget|.  Returns the clones.
+  SmallVector<Function *, 4> CloneForResources(Function *fn, unsigned *budget);
+
   // For each kernel argument that will map to a resource variable (descriptor),
   // try to rewrite the uses of the argument as a direct access of the resource.
   // We can only do this if all the callees of the function use the same
@@ -94,31 +135,166 @@ bool DirectResourceAccessPass::runOnModule(Module &M) {
       }
     }
 
+    unsigned budget = clspv::Option::DirectResourceAccessCloneLimit();
     for (auto *fn : ordered_functions) {
+      // Clones are rewritten right away. Their callees come later in the
+      // order, so they see the calls from the clones.
+      auto clones = CloneForResources(fn, &budget);
+      Changed |= !clones.empty();
       Changed |= RewriteResourceAccesses(fn);
+      for (auto *clone : clones) {
+        Changed |= RewriteResourceAccesses(clone);
+      }
     }
   }
 
   return Changed;
 }
 
+bool DirectResourceAccessPass::IsResourceArg(Argument &arg) {
+  switch (clspv::GetArgKind(arg)) {
+  case clspv::ArgKind::Buffer:
+  case clspv::ArgKind::BufferUBO:
+  case clspv::ArgKind::SampledImage:
+  case clspv::ArgKind::StorageImage:
+  case clspv::ArgKind::Sampler:
+  case clspv::ArgKind::Local:
+    return true;
+  default:
+    // Should not happen
+    return false;
+  }
+}
+
+bool DirectResourceAccessPass::GetParamInfo(Value *value, ParamInfo *info) {
+  // We care about two cases:
+  //     - a direct call to clspv.resource.var.*
+  //     - a GEP with only zero indices, where the base pointer is
+
+  // Unpack GEPs with zeros, if we can.  Rewrite |value| as we go along.
+  unsigned num_gep_zeroes = 0;
+  bool first_gep = true;
+  for (auto *gep = dyn_cast<GetElementPtrInst>(value); gep;
+       gep = dyn_cast<GetElementPtrInst>(value)) {
+    if (!gep->hasAllZeroIndices()) {
+      return false;
+    }
+    // If not the first GEP, then ignore the "element" index (which I call
+    // "slide") since that will be combined with the last index of the
+    // previous GEP.
+    num_gep_zeroes += gep->getNumIndices() + (first_gep ? 0 : -1);
+    value = gep->getPointerOperand();
+    first_gep = false;
+  }
+  if (auto *call = dyn_cast<CallInst>(value)) {
+    // If the call is a call to a @clspv.resource.var.* function, then use it,
+    // assuming the given number of GEP zero-indices so far.
+    auto *callee = call->getCalledFunction();
+    auto &func_info = clspv::Builtins::Lookup(callee);
+    if (func_info.getType() == clspv::Builtins::kClspvResource) {
+      const auto set =
+          uint32_t(dyn_cast<ConstantInt>(call->getOperand(0))->getZExtValue());
+      const auto binding =
+          uint32_t(dyn_cast<ConstantInt>(call->getOperand(1))->getZExtValue());
+      *info = {callee, set, binding, num_gep_zeroes, call};
+      return true;
+    } else if (func_info.getType() == clspv::Builtins::kClspvLocal) {
+      const uint32_t spec_id =
+          uint32_t(dyn_cast<ConstantInt>(call->getOperand(0))->getZExtValue());
+      *info = {callee, spec_id, 0, num_gep_zeroes, call};
+      return true;
+    }
+    // A call but not to a resource access builtin function.
+    return false;
+  } else if (isa<GlobalValue>(value)) {
+    *info = {value, 0, 0, num_gep_zeroes, nullptr};
+    return true;
+  }
+  // Not a call.
+  return false;
+}
+
+SmallVector<Function *, 4>
+DirectResourceAccessPass::CloneForResources(Function *fn, unsigned *budget) {
+  SmallVector<Function *, 4> clones;
+  if (*budget == 0 || fn->getCallingConv() == CallingConv::SPIR_KERNEL)
+    return clones;
+
+  SmallVector<unsigned, 4> resource_args;
+  for (Argument &arg : fn->args()) {
+    if (IsResourceArg(arg))
+      resource_args.push_back(arg.getArgNo());
+  }
+  if (resource_args.empty())
+    return clones;
+
+  // Group the call sites by the resources they pass, in the order of the
+  // uses.  An argument that is not a resource access matches nothing, so its
+  // call site gets a group of its own.
+  struct CallGroup {
+    SmallVector<ParamInfo, 4> params;
+    SmallVector<bool, 4> known;
+    SmallVector<CallInst *, 4> calls;
+  };
+  SmallVector<CallGroup, 4> groups;
+  for (auto &use : fn->uses()) {
+    auto *call = dyn_cast<CallInst>(use.getUser());
+    if (!call)
+      return clones;
+
+    CallGroup key;
+    for (auto arg_index : resource_args) {
+      ParamInfo info{nullptr, 0, 0, 0, nullptr};
+      key.known.push_back(GetParamInfo(call->getArgOperand(arg_index), &info));
+      key.params.push_back(info);
+    }
+    auto match = [&key](const CallGroup &group) {
+      for (size_t i = 0; i < key.params.size(); ++i) {
+        if (!key.known[i] || !group.known[i] ||
+            !key.params[i].Matches(group.params[i]))
+          return false;
+      }
+      return true;
+    };
+    auto iter = std::find_if(groups.begin(), groups.end(), match);
+    if (iter == groups.end()) {
+      groups.push_back(std::move(key));
+      iter = groups.end() - 1;
+    }
+    iter->calls.push_back(call);
+  }
+  if (groups.size() < 2)
+    return clones;
+
+  unsigned size = 0;
+  for (auto &BB : *fn)
+    size += BB.size();
+
+  // The first group keeps calling |fn|.
+  for (size_t i = 1; i < groups.size() && size <= *budget; ++i) {
+    *budget -= size;
+    ValueToValueMapTy remapped;
+    auto *clone = CloneFunction(fn, remapped);
+    clone->setName(fn->getName() + "_clspv_dra_" + std::to_string(i));
+    for (auto *call : groups[i].calls) {
+      call->setCalledFunction(clone);
+    }
+    if (ShowDRA) {
+      outs() << "DRA:  Clone " << fn->getName() << " as " << clone->getName()
+             << " for " << groups[i].calls.size() << " call(s)\n";
+    }
+    clones.push_back(clone);
+  }
+
+  return clones;
+}
+
 bool DirectResourceAccessPass::RewriteResourceAccesses(Function *fn) {
   bool Changed = false;
   int arg_index = 0;
   for (Argument &arg : fn->args()) {
-    switch (clspv::GetArgKind(arg)) {
-    case clspv::ArgKind::Buffer:
-    case clspv::ArgKind::BufferUBO:
-    case clspv::ArgKind::SampledImage:
-    case clspv::ArgKind::StorageImage:
-    case clspv::ArgKind::Sampler:
-    case clspv::ArgKind::Local:
+    if (IsResourceArg(arg))
       Changed |= RewriteAccessesForArg(fn, arg_index, arg);
-      break;
-    default:
-      // Should not happen
-      break;
-    }
     arg_index++;
   }
   return Changed;
@@ -135,22 +311,7 @@ bool DirectResourceAccessPass::RewriteAccessesForArg(Function *fn,
   // We can convert a parameter to a direct resource access if it is
   // either a direct call to a clspv.resource.var.* or if it a GEP of
   // such a thing (where the GEP can only have zero indices).
-  struct ParamInfo {
-    // The base value. It is either a global variable or a resource-access
-    // builtin function. (@clspv.resource.var.* or @clspv.local.var.*)
-    Value *base;
-    // The descriptor set.
-    uint32_t set;
-    // The binding.
-    uint32_t binding;
-    // If the parameter is a GEP, then this is the number of zero-indices
-    // the GEP used.
-    unsigned num_gep_zeroes;
-    // An example call fitting
-    CallInst *sample_call;
-  };
   // The common valid parameter info across all the callers seen soo far.
-
   bool seen_one = false;
   ParamInfo common;
   // Tries to merge the given parameter info into |common|.  If it is the first
@@ -161,61 +322,15 @@ bool DirectResourceAccessPass::RewriteAccessesForArg(Function *fn,
       seen_one = true;
       return true;
     }
-    return pi.base == common.base && pi.set == common.set &&
-           pi.binding == common.binding &&
-           pi.num_gep_zeroes == common.num_gep_zeroes;
+    return pi.Matches(common);
   };
 
   for (auto &use : fn->uses()) {
     if (auto *caller = dyn_cast<CallInst>(use.getUser())) {
-      Value *value = caller->getArgOperand(arg_index);
-      // We care about two cases:
-      //     - a direct call to clspv.resource.var.*
-      //     - a GEP with only zero indices, where the base pointer is
-
-      // Unpack GEPs with zeros, if we can.  Rewrite |value| as we go along.
-      unsigned num_gep_zeroes = 0;
-      bool first_gep = true;
-      for (auto *gep = dyn_cast<GetElementPtrInst>(value); gep;
-           gep = dyn_cast<GetElementPtrInst>(value)) {
-        if (!gep->hasAllZeroIndices()) {
-          return false;
-        }
-        // If not the first GEP, then ignore the "element" index (which I call
-        // "slide") since that will be combined with the last index of the
-        // previous GEP.
-        num_gep_zeroes += gep->getNumIndices() + (first_gep ? 0 : -1);
-        value = gep->getPointerOperand();
-        first_gep = false;
-      }
-      if (auto *call = dyn_cast<CallInst>(value)) {
-        // If the call is a call to a @clspv.resource.var.* function, then try
-        // to merge it, assuming the given number of GEP zero-indices so far.
-        auto *callee = call->getCalledFunction();
-        auto &func_info = clspv::Builtins::Lookup(callee);
-        if (func_info.getType() == clspv::Builtins::kClspvResource) {
-          const auto set = uint32_t(
-              dyn_cast<ConstantInt>(call->getOperand(0))->getZExtValue());
-          const auto binding = uint32_t(
-              dyn_cast<ConstantInt>(call->getOperand(1))->getZExtValue());
-          if (!merge_param_info({callee, set, binding, num_gep_zeroes, call}))
-            return false;
-        } else if (func_info.getType() == clspv::Builtins::kClspvLocal) {
-          const uint32_t spec_id = uint32_t(
-              dyn_cast<ConstantInt>(call->getOperand(0))->getZExtValue());
-          if (!merge_param_info({callee, spec_id, 0, num_gep_zeroes, call}))
-            return false;
-        } else {
-          // A call but not to a resource access builtin function.
-          return false;
-        }
-      } else if (isa<GlobalValue>(value)) {
-        if (!merge_param_info({value, 0, 0, num_gep_zeroes, nullptr}))
-          return false;
-      } else {
-        // Not a call.
+      ParamInfo info;
+      if (!GetParamInfo(caller->getArgOperand(arg_index), &info) ||
+          !merge_param_info(info))
         return false;
-      }
     } else {
       // There isn't enough commonality.  Bail out without changing anything.
       return false;
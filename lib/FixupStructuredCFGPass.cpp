@@ -14,49 +14,70 @@
 
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/PassManager.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include "NewPassManager.h"
 #include "Passes.h"
 
 using namespace llvm;
 
 namespace {
-struct FixupStructuredCFGPass : public FunctionPass {
+// Splits the exit of inner loops that is also the latch of the outer loop, so
+// that each loop gets its own merge block. Keeps |DT| and |LI| up to date.
+bool FixLoopMerges(Function &F, DominatorTree &DT, LoopInfo &LI);
+
+struct FixupStructuredCFGLegacyPass : public FunctionPass {
   static char ID;
-  FixupStructuredCFGPass() : FunctionPass(ID) {}
+  FixupStructuredCFGLegacyPass() : FunctionPass(ID) {}
 
   void getAnalysisUsage(AnalysisUsage &AU) const override {
+    // The structurizer preserves the dominator tree, and both analyses are
+    // kept up to date here for ReorderBasicBlocksPass.
+    AU.addRequired<DominatorTreeWrapperPass>();
     AU.addRequired<LoopInfoWrapperPass>();
+    AU.addPreserved<DominatorTreeWrapperPass>();
+    AU.addPreserved<LoopInfoWrapperPass>();
   }
 
   bool runOnFunction(Function &F) override;
-
-private:
-  bool FixLoopMerges(Function &F);
 };
 } // namespace
 
-char FixupStructuredCFGPass::ID = 0;
-INITIALIZE_PASS(FixupStructuredCFGPass, "FixupStructuredCFG",
+char FixupStructuredCFGLegacyPass::ID = 0;
+INITIALIZE_PASS(FixupStructuredCFGLegacyPass, "FixupStructuredCFG",
                 "Fixup structured cfg", false, false)
 
 namespace clspv {
 FunctionPass *createFixupStructuredCFGPass() {
-  return new FixupStructuredCFGPass();
+  return new FixupStructuredCFGLegacyPass();
 }
-} // namespace clspv
 
-bool FixupStructuredCFGPass::runOnFunction(Function &F) {
-  bool Changed = FixLoopMerges(F);
+PreservedAnalyses FixupStructuredCFGPass::run(Function &F,
+                                              FunctionAnalysisManager &FAM) {
+  auto &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+  auto &LI = FAM.getResult<LoopAnalysis>(F);
+  if (!FixLoopMerges(F, DT, LI))
+    return PreservedAnalyses::all();
+
+  PreservedAnalyses PA;
+  PA.preserve<DominatorTreeAnalysis>();
+  PA.preserve<LoopAnalysis>();
+  return PA;
+}
+} // namespace clspv
 
-  return Changed;
+bool FixupStructuredCFGLegacyPass::runOnFunction(Function &F) {
+  DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  return FixLoopMerges(F, DT, LI);
 }
 
-bool FixupStructuredCFGPass::FixLoopMerges(Function &F) {
+namespace {
+bool FixLoopMerges(Function &F, DominatorTree &DT, LoopInfo &LI) {
   // Assumes CFG has been structurized.
-  const LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
-
   SmallVector<Loop *, 16> loops;
   for (auto loop : LI) {
     loops.push_back(loop);
@@ -85,7 +106,7 @@ bool FixupStructuredCFGPass::FixLoopMerges(Function &F) {
           auto new_exit =
               BasicBlock::Create(F.getContext(), "", &F, exit_block);
           BranchInst::Create(exit_block, new_exit);
-          parent->addBlockEntry(new_exit);
+          parent->addBasicBlockToLoop(new_exit, LI);
 
           // Collect the exit's predecessors from within the loop.
           SmallVector<BasicBlock *, 4> loop_preds;
@@ -123,10 +144,15 @@ bool FixupStructuredCFGPass::FixLoopMerges(Function &F) {
             }
           }
           // Remove the loop predecessors from the old exit block.
+          SmallVector<DominatorTree::UpdateType, 8> updates;
+          updates.push_back({DominatorTree::Insert, new_exit, exit_block});
           for (auto pred : loop_preds) {
             exit_block->removePredecessor(&*pred);
             pred->getTerminator()->replaceUsesOfWith(exit_block, new_exit);
+            updates.push_back({DominatorTree::Insert, pred, new_exit});
+            updates.push_back({DominatorTree::Delete, pred, exit_block});
           }
+          DT.applyUpdates(updates);
 
           Changed = true;
         }
@@ -136,3 +162,4 @@ bool FixupStructuredCFGPass::FixLoopMerges(Function &F) {
 
   return Changed;
 }
+} // namespace
@@ -32,8 +32,6 @@ using namespace clang;
 
 namespace {
 
-static uint32_t kClusteredCount = 0;
-
 struct ExtraValidationConsumer final : public ASTConsumer {
 private:
   CompilerInstance &Instance;
@@ -66,10 +64,27 @@ private:
     CustomDiagnosticPushConstantContainsArray,
     CustomDiagnosticUnsupported16BitStorage,
     CustomDiagnosticUnsupported8BitStorage,
+    CustomDiagnosticLocalSizeConflict,
     CustomDiagnosticTotal
   };
   std::vector<unsigned> CustomDiagnosticsIDMap;
 
+  // Number of clustered argument records built so far. Used to give each
+  // record a unique name.
+  uint32_t ClusteredCount = 0;
+
+  // Per-compile caches of the type queries below, keyed on canonical types.
+  // Structs declared in headers are otherwise walked again for every
+  // declaration that uses them. Only successful support and layout checks are
+  // cached so that every failing use still gets its own diagnostic. The
+  // Contains*Type caches are seeded with false before recursing, which also
+  // stops the walk on recursive structs.
+  llvm::DenseMap<std::pair<const Type *, uint32_t>, bool> SizedTypeCache;
+  llvm::DenseMap<const Type *, bool> PointerTypeCache;
+  llvm::DenseMap<const Type *, bool> ArrayTypeCache;
+  llvm::DenseSet<std::pair<const Type *, bool>> SupportedTypes;
+  llvm::DenseSet<std::pair<const Type *, uint64_t>> SupportedLayouts[2];
+
   clspv::Option::StorageClass ConvertToStorageClass(clang::LangAS aspace) {
     switch (aspace) {
     case LangAS::opencl_constant:
@@ -86,6 +101,18 @@ private:
 
   bool ContainsSizedType(QualType QT, uint32_t width) {
     auto canonical = QT.getCanonicalType();
+    const auto key = std::make_pair(canonical.getTypePtr(), width);
+    auto where = SizedTypeCache.find(key);
+    if (where != SizedTypeCache.end())
+      return where->second;
+
+    SizedTypeCache[key] = false;
+    const bool result = ComputeContainsSizedType(canonical, width);
+    SizedTypeCache[key] = result;
+    return result;
+  }
+
+  bool ComputeContainsSizedType(QualType canonical, uint32_t width) {
     if (auto *BT = dyn_cast<BuiltinType>(canonical)) {
       switch (BT->getKind()) {
       case BuiltinType::UShort:
@@ -119,6 +146,17 @@ private:
 
   bool ContainsPointerType(QualType QT) {
     auto canonical = QT.getCanonicalType();
+    auto where = PointerTypeCache.find(canonical.getTypePtr());
+    if (where != PointerTypeCache.end())
+      return where->second;
+
+    PointerTypeCache[canonical.getTypePtr()] = false;
+    const bool result = ComputeContainsPointerType(canonical);
+    PointerTypeCache[canonical.getTypePtr()] = result;
+    return result;
+  }
+
+  bool ComputeContainsPointerType(QualType canonical) {
     if (canonical->isPointerType()) {
       return true;
     } else if (auto *AT = dyn_cast<ArrayType>(canonical)) {
@@ -135,6 +173,17 @@ private:
 
   bool ContainsArrayType(QualType QT) {
     auto canonical = QT.getCanonicalType();
+    auto where = ArrayTypeCache.find(canonical.getTypePtr());
+    if (where != ArrayTypeCache.end())
+      return where->second;
+
+    ArrayTypeCache[canonical.getTypePtr()] = false;
+    const bool result = ComputeContainsArrayType(canonical);
+    ArrayTypeCache[canonical.getTypePtr()] = result;
+    return result;
+  }
+
+  bool ComputeContainsArrayType(QualType canonical) {
     if (auto *PT = dyn_cast<PointerType>(canonical)) {
       return ContainsArrayType(PT->getPointeeType());
     } else if (isa<ArrayType>(canonical)) {
@@ -172,6 +221,19 @@ private:
   }
 
   bool IsSupportedType(QualType QT, SourceRange SR, bool IsKernelParameter) {
+    const auto key = std::make_pair(QT.getCanonicalType().getTypePtr(),
+                                    IsKernelParameter);
+    if (SupportedTypes.count(key))
+      return true;
+
+    if (!ComputeIsSupportedType(QT, SR, IsKernelParameter))
+      return false;
+    SupportedTypes.insert(key);
+    return true;
+  }
+
+  bool ComputeIsSupportedType(QualType QT, SourceRange SR,
+                              bool IsKernelParameter) {
     auto *Ty = QT.getTypePtr();
 
     // First check if we have a pointer type.
@@ -294,6 +356,21 @@ private:
                          ASTContext &context, SourceRange arg_range,
                          SourceRange specific_range) {
     const auto canonical = QT.getCanonicalType();
+    const auto key = std::make_pair(canonical.getTypePtr(), offset);
+    if (SupportedLayouts[layout].count(key))
+      return true;
+
+    if (!ComputeIsSupportedLayout(canonical, offset, layout, context, arg_range,
+                                  specific_range))
+      return false;
+    SupportedLayouts[layout].insert(key);
+    return true;
+  }
+
+  bool ComputeIsSupportedLayout(QualType canonical, uint64_t offset,
+                                const Layout &layout, ASTContext &context,
+                                SourceRange arg_range,
+                                SourceRange specific_range) {
     if (canonical->isScalarType()) {
       if (!IsSupportedScalarLayout(canonical, offset, layout, context,
                                    arg_range, specific_range))
@@ -358,6 +435,12 @@ private:
     const auto *VT = llvm::cast<VectorType>(QT);
     const auto ele_size =
         context.getTypeSizeInChars(VT->getElementType()).getQuantity();
+    // With scalar block layout, vectors only need the alignment of their
+    // elements and may straddle.
+    if (clspv::Option::ScalarBlockLayout()) {
+      return IsSupportedLayout(VT->getElementType(), offset, layout, context,
+                               arg_range, specific_range);
+    }
     if (VT->getNumElements() == 2) {
       if (offset % (ele_size * 2) != 0) {
         Report(CustomDiagnosticUnalignedVec2, arg_range, specific_range);
@@ -451,7 +534,8 @@ private:
         return false;
       }
 
-      if (prev) {
+      // Scalar block layout lets members follow arrays and structs closely.
+      if (prev && !clspv::Option::ScalarBlockLayout()) {
         const auto prev_canonical = prev->getType().getCanonicalType();
         const uint64_t prev_offset =
             record_layout.getFieldOffset(field_no - 1) / context.getCharWidth();
@@ -608,6 +692,10 @@ public:
         DE.getCustomDiagID(DiagnosticsEngine::Error,
                            "8-bit storage is not supported for "
                            "%select{SSBOs|UBOs|push constants}0");
+    CustomDiagnosticsIDMap[CustomDiagnosticLocalSizeConflict] =
+        DE.getCustomDiagID(DiagnosticsEngine::Error,
+                           "reqd_work_group_size conflicts with "
+                           "-local-size=%0,%1,%2");
   }
 
   virtual bool HandleTopLevelDecl(DeclGroupRef DG) override {
@@ -637,12 +725,24 @@ public:
             } else {
               Kernels.insert(FD->getName().str());
             }
+
+            const auto local_size = clspv::Option::LocalSize();
+            auto *reqd = FD->getAttr<ReqdWorkGroupSizeAttr>();
+            if (reqd && !local_size.empty() &&
+                (reqd->getXDim() != local_size[0] ||
+                 reqd->getYDim() != local_size[1] ||
+                 reqd->getZDim() != local_size[2])) {
+              Instance.getDiagnostics().Report(
+                  reqd->getLocation(),
+                  CustomDiagnosticsIDMap[CustomDiagnosticLocalSizeConflict])
+                  << local_size[0] << local_size[1] << local_size[2];
+            }
           }
 
           RecordDecl *clustered_args = nullptr;
           if (is_opencl_kernel && clspv::Option::PodArgsInPushConstants()) {
             clustered_args = FD->getASTContext().buildImplicitRecord(
-                "__clspv.clustered_args." + std::to_string(kClusteredCount++));
+                "__clspv.clustered_args." + std::to_string(ClusteredCount++));
             clustered_args->startDefinition();
           }
           for (auto *P : FD->parameters()) {
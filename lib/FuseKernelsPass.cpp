@@ -0,0 +1,321 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Fuses the pairs of kernels given by -fuse-kernels=first:a:second:b, which
+// the host runs back to back over the same NDRange. The new kernel
+// first_second takes the arguments of the first kernel followed by those of
+// the second but b, which is replaced by argument a of the first. Its body is
+// the body of the first kernel followed by that of the second, inlined.
+//
+// This is only correct if no invocation of the second kernel reads what
+// another invocation of the first kernel wrote. Every access through a and b
+// must therefore be a load or store at get_global_id(d), for the same d. The
+// stores of the first body are then forwarded to the loads of the second by
+// the usual optimizations, so the values stay in registers.
+//
+// The pass runs right after the frontend, on IR that still copies parameters
+// and locals through allocas.
+
+#include <string>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include "clspv/AddressSpace.h"
+#include "clspv/Option.h"
+
+#include "Builtins.h"
+#include "Constants.h"
+#include "Passes.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "FuseKernels"
+
+namespace {
+struct FuseKernelsPass : public ModulePass {
+  static char ID;
+  FuseKernelsPass() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override;
+
+private:
+  // Creates the kernel fusing |First| and |Second| as described by |entry|.
+  void fuse(Module &M, const std::string &entry, Function *First,
+            unsigned FirstOrdinal, Function *Second, unsigned SecondOrdinal);
+};
+
+[[noreturn]] void Fail(const std::string &entry, const Twine &reason) {
+  errs() << "error: -fuse-kernels cannot fuse " << entry << ": " << reason
+         << "\n";
+  llvm_unreachable("Invalid -fuse-kernels entry");
+}
+
+// Returns the only store to |Ptr| if it is an alloca that is otherwise only
+// loaded from.
+StoreInst *SingleStore(Value *Ptr) {
+  auto *Alloca = dyn_cast<AllocaInst>(Ptr);
+  if (!Alloca)
+    return nullptr;
+  StoreInst *Store = nullptr;
+  for (auto *U : Alloca->users()) {
+    if (auto *S = dyn_cast<StoreInst>(U)) {
+      if (S->getPointerOperand() != Alloca || Store)
+        return nullptr;
+      Store = S;
+    } else if (!isa<LoadInst>(U)) {
+      return nullptr;
+    }
+  }
+  return Store;
+}
+
+// Returns |V| without its integer casts and copies through allocas stored
+// once.
+Value *StripCopies(Value *V) {
+  while (true) {
+    if (auto *Cast = dyn_cast<CastInst>(V)) {
+      if (!Cast->isIntegerCast())
+        return V;
+      V = Cast->getOperand(0);
+    } else if (auto *Load = dyn_cast<LoadInst>(V)) {
+      auto *Store = SingleStore(Load->getPointerOperand());
+      if (!Store)
+        return V;
+      V = Store->getValueOperand();
+    } else {
+      return V;
+    }
+  }
+}
+
+// Returns true if every access through |Arg| is a load or store at
+// get_global_id(*Dim). A negative |*Dim| is set to the first dimension found.
+bool AccessesOwnElement(Argument *Arg, int *Dim) {
+  SmallVector<Value *, 4> Pointers{Arg};
+  while (!Pointers.empty()) {
+    Value *Ptr = Pointers.pop_back_val();
+    for (auto *U : Ptr->users()) {
+      // The frontend copies the argument to an alloca.
+      if (auto *Store = dyn_cast<StoreInst>(U)) {
+        if (SingleStore(Store->getPointerOperand()) != Store)
+          return false;
+        for (auto *Copy : Store->getPointerOperand()->users()) {
+          if (Copy != Store)
+            Pointers.push_back(Copy);
+        }
+        continue;
+      }
+
+      auto *GEP = dyn_cast<GetElementPtrInst>(U);
+      if (!GEP || GEP->getPointerOperand() != Ptr || GEP->getNumIndices() != 1)
+        return false;
+      auto *Call = dyn_cast<CallInst>(StripCopies(GEP->getOperand(1)));
+      if (!Call || !Call->getCalledFunction() ||
+          clspv::Builtins::Lookup(Call->getCalledFunction()) !=
+              clspv::Builtins::kGetGlobalId)
+        return false;
+      auto *D = dyn_cast<ConstantInt>(Call->getArgOperand(0));
+      if (!D || (*Dim >= 0 && D->getZExtValue() != unsigned(*Dim)))
+        return false;
+      *Dim = static_cast<int>(D->getZExtValue());
+
+      for (auto *Access : GEP->users()) {
+        auto *Load = dyn_cast<LoadInst>(Access);
+        auto *Store = dyn_cast<StoreInst>(Access);
+        if (!(Load && Load->getPointerOperand() == GEP) &&
+            !(Store && Store->getPointerOperand() == GEP &&
+              Store->getValueOperand() != GEP))
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Returns the concatenation of the operands of the metadata |Name| of |First|
+// and |Second|, without operand |SecondOrdinal| of the latter, or null if
+// either has none.
+MDNode *FuseArgMetadata(StringRef Name, Function *First, Function *Second,
+                        unsigned SecondOrdinal) {
+  auto *FirstMD = First->getMetadata(Name);
+  auto *SecondMD = Second->getMetadata(Name);
+  if (!FirstMD || !SecondMD)
+    return nullptr;
+  SmallVector<Metadata *, 16> Ops(FirstMD->op_begin(), FirstMD->op_end());
+  for (unsigned i = 0; i < SecondMD->getNumOperands(); ++i) {
+    if (i != SecondOrdinal)
+      Ops.push_back(SecondMD->getOperand(i));
+  }
+  return MDNode::get(First->getContext(), Ops);
+}
+} // namespace
+
+char FuseKernelsPass::ID = 0;
+INITIALIZE_PASS(FuseKernelsPass, "FuseKernels", "Fuse Kernels Pass", false,
+                false)
+
+namespace clspv {
+ModulePass *createFuseKernelsPass() { return new FuseKernelsPass(); }
+} // namespace clspv
+
+bool FuseKernelsPass::runOnModule(Module &M) {
+  bool Changed = false;
+  for (const auto &entry : clspv::Option::FuseKernels()) {
+    std::string FirstName, SecondName;
+    unsigned FirstOrdinal, SecondOrdinal;
+    if (!clspv::Option::ParseFuseKernels(entry, &FirstName, &FirstOrdinal,
+                                         &SecondName, &SecondOrdinal))
+      continue;
+
+    // An earlier entry may have created the first kernel, so chains fuse
+    // one kernel at a time.
+    auto is_kernel = [](Function *F) {
+      return F && !F->isDeclaration() &&
+             F->getCallingConv() == CallingConv::SPIR_KERNEL;
+    };
+    auto *First = M.getFunction(FirstName);
+    auto *Second = M.getFunction(SecondName);
+    if (!is_kernel(First))
+      Fail(entry, FirstName + " is not a kernel of the program");
+    if (!is_kernel(Second))
+      Fail(entry, SecondName + " is not a kernel of the program");
+    if (First == Second)
+      Fail(entry, "a kernel cannot be fused with itself");
+
+    fuse(M, entry, First, FirstOrdinal, Second, SecondOrdinal);
+    Changed = true;
+  }
+  return Changed;
+}
+
+void FuseKernelsPass::fuse(Module &M, const std::string &entry,
+                           Function *First, unsigned FirstOrdinal,
+                           Function *Second, unsigned SecondOrdinal) {
+  const std::string Name =
+      First->getName().str() + "_" + Second->getName().str();
+  if (M.getFunction(Name))
+    Fail(entry, "the program already has a function named " + Name);
+  if (FirstOrdinal >= First->arg_size() || SecondOrdinal >= Second->arg_size())
+    Fail(entry, "no argument with that ordinal");
+
+  auto *FirstArg = First->getArg(FirstOrdinal);
+  auto *SecondArg = Second->getArg(SecondOrdinal);
+  auto *PTy = dyn_cast<PointerType>(FirstArg->getType());
+  if (!PTy || PTy->getAddressSpace() != clspv::AddressSpace::Global ||
+      SecondArg->getType() != PTy)
+    Fail(entry, "the arguments are not __global pointers of the same type");
+
+  int Dim = -1;
+  if (!AccessesOwnElement(FirstArg, &Dim) ||
+      !AccessesOwnElement(SecondArg, &Dim))
+    Fail(entry, "the buffer is not only accessed at get_global_id");
+
+  auto *FirstSize = First->getMetadata("reqd_work_group_size");
+  auto *SecondSize = Second->getMetadata("reqd_work_group_size");
+  if (FirstSize && SecondSize && FirstSize != SecondSize)
+    Fail(entry, "the kernels require different work-group sizes");
+
+  // The arguments of the first kernel, then those of the second but the
+  // buffer.
+  SmallVector<Type *, 16> ParamTys;
+  SmallVector<AttributeSet, 16> ParamAttrs;
+  auto Attributes = First->getAttributes();
+  for (auto &Arg : First->args()) {
+    ParamTys.push_back(Arg.getType());
+    ParamAttrs.push_back(Attributes.getParamAttributes(Arg.getArgNo()));
+  }
+  auto SecondAttributes = Second->getAttributes();
+  for (auto &Arg : Second->args()) {
+    if (Arg.getArgNo() == SecondOrdinal)
+      continue;
+    ParamTys.push_back(Arg.getType());
+    ParamAttrs.push_back(SecondAttributes.getParamAttributes(Arg.getArgNo()));
+  }
+
+  auto &Context = M.getContext();
+  auto *FTy = FunctionType::get(Type::getVoidTy(Context), ParamTys, false);
+  auto *Fused = Function::Create(FTy, First->getLinkage(), Name, M);
+  Fused->setCallingConv(CallingConv::SPIR_KERNEL);
+  Fused->setAttributes(AttributeList::get(Context,
+                                          Attributes.getFnAttributes(),
+                                          AttributeSet(), ParamAttrs));
+  if (auto *Size = FirstSize ? FirstSize : SecondSize)
+    Fused->setMetadata("reqd_work_group_size", Size);
+  for (auto MDName : {"kernel_arg_addr_space", "kernel_arg_access_qual",
+                      "kernel_arg_type", "kernel_arg_base_type",
+                      "kernel_arg_type_qual", "kernel_arg_name"}) {
+    if (auto *MD = FuseArgMetadata(MDName, First, Second, SecondOrdinal))
+      Fused->setMetadata(MDName, MD);
+  }
+
+  SmallVector<Value *, 16> FirstArgs, SecondArgs;
+  auto NewArg = Fused->arg_begin();
+  for (auto &Arg : First->args()) {
+    NewArg->setName(Arg.getName());
+    FirstArgs.push_back(&*NewArg++);
+  }
+  for (auto &Arg : Second->args()) {
+    if (Arg.getArgNo() == SecondOrdinal) {
+      SecondArgs.push_back(FirstArgs[FirstOrdinal]);
+      continue;
+    }
+    NewArg->setName(Arg.getName());
+    SecondArgs.push_back(&*NewArg++);
+  }
+
+  // With -lean-memory the argument names were recorded per kernel.
+  if (auto *names_md =
+          M.getNamedMetadata(clspv::KernelArgNamesMetadataName())) {
+    MDNode *FirstNames = nullptr;
+    MDNode *SecondNames = nullptr;
+    for (auto *node : names_md->operands()) {
+      auto kernel = cast<MDString>(node->getOperand(0))->getString();
+      if (kernel == First->getName())
+        FirstNames = node;
+      else if (kernel == Second->getName())
+        SecondNames = node;
+    }
+    if (FirstNames && SecondNames) {
+      SmallVector<Metadata *, 16> Ops(FirstNames->op_begin(),
+                                      FirstNames->op_end());
+      Ops[0] = MDString::get(Context, Name);
+      for (unsigned i = 1; i < SecondNames->getNumOperands(); ++i) {
+        if (i != SecondOrdinal + 1)
+          Ops.push_back(SecondNames->getOperand(i));
+      }
+      names_md->addOperand(MDNode::get(Context, Ops));
+    }
+  }
+
+  IRBuilder<> Builder(BasicBlock::Create(Context, "entry", Fused));
+  auto *FirstCall = Builder.CreateCall(First, FirstArgs);
+  FirstCall->setCallingConv(First->getCallingConv());
+  auto *SecondCall = Builder.CreateCall(Second, SecondArgs);
+  SecondCall->setCallingConv(Second->getCallingConv());
+  Builder.CreateRetVoid();
+
+  for (auto *Call : {FirstCall, SecondCall}) {
+    InlineFunctionInfo IFI;
+    InlineFunction(*Call, IFI, nullptr, false);
+  }
+}
@@ -0,0 +1,150 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Cleans up the getelementptrs, which become access chains, right before
+// SPIR-V generation. UndoGetElementPtrConstantExpr gives each use of a
+// constant GEP its own instruction, and the pointer bitcast passes rebuild
+// GEPs next to their users, so the CSE and LICM of the LLVM optimizations are
+// undone by then. This pass:
+// - moves each GEP whose operands are loop invariant to the preheader of its
+//   loop, innermost loops first so that a GEP can leave a whole loop nest;
+// - replaces each GEP by an identical one dominating it.
+// Computing an access chain has no side effect, so the GEPs may be moved out
+// of conditional code. The CFG is left untouched, as it is already
+// structured.
+
+#include <map>
+#include <vector>
+
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+
+#include "Passes.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "HoistAccessChains"
+
+namespace {
+struct HoistAccessChainsPass : public FunctionPass {
+  static char ID;
+  HoistAccessChainsPass() : FunctionPass(ID) {}
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  // Moves the loop-invariant GEPs of |L| to its preheader.
+  bool hoistFromLoop(Loop *L);
+
+  // Replaces the GEPs of |F| by identical GEPs dominating them.
+  bool mergeIdentical(Function &F, DominatorTree &DT);
+};
+} // namespace
+
+char HoistAccessChainsPass::ID = 0;
+INITIALIZE_PASS(HoistAccessChainsPass, "HoistAccessChains",
+                "Hoist Access Chains Pass", false, false)
+
+namespace clspv {
+FunctionPass *createHoistAccessChainsPass() {
+  return new HoistAccessChainsPass();
+}
+} // namespace clspv
+
+bool HoistAccessChainsPass::runOnFunction(Function &F) {
+  auto &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  auto &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+
+  // Inner loops come after their parent in preorder.
+  bool Changed = false;
+  auto Loops = LI.getLoopsInPreorder();
+  for (auto it = Loops.rbegin(); it != Loops.rend(); ++it) {
+    Changed |= hoistFromLoop(*it);
+  }
+
+  Changed |= mergeIdentical(F, DT);
+  return Changed;
+}
+
+bool HoistAccessChainsPass::hoistFromLoop(Loop *L) {
+  auto *Preheader = L->getLoopPreheader();
+  if (!Preheader)
+    return false;
+
+  // A GEP may use another GEP of the loop, so go over the loop until nothing
+  // moves.
+  bool Changed = false;
+  bool Moved = true;
+  while (Moved) {
+    Moved = false;
+    for (auto *BB : L->blocks()) {
+      for (auto I = BB->begin(); I != BB->end();) {
+        auto *GEP = dyn_cast<GetElementPtrInst>(&*I++);
+        if (GEP && L->hasLoopInvariantOperands(GEP)) {
+          GEP->moveBefore(Preheader->getTerminator());
+          Moved = true;
+        }
+      }
+    }
+    Changed |= Moved;
+  }
+  return Changed;
+}
+
+bool HoistAccessChainsPass::mergeIdentical(Function &F, DominatorTree &DT) {
+  // The GEPs seen so far, by operands. In dominator tree preorder, a GEP
+  // dominating another one is always seen first.
+  std::map<std::vector<Value *>, SmallVector<GetElementPtrInst *, 2>> Seen;
+  SmallVector<GetElementPtrInst *, 16> Dead;
+  for (auto *Node : depth_first(DT.getRootNode())) {
+    for (auto &I : *Node->getBlock()) {
+      auto *GEP = dyn_cast<GetElementPtrInst>(&I);
+      if (!GEP)
+        continue;
+
+      std::vector<Value *> Key(GEP->op_begin(), GEP->op_end());
+      auto &Candidates = Seen[Key];
+      GetElementPtrInst *Replacement = nullptr;
+      for (auto *Candidate : Candidates) {
+        if (Candidate->isInBounds() == GEP->isInBounds() &&
+            DT.dominates(Candidate, GEP)) {
+          Replacement = Candidate;
+          break;
+        }
+      }
+
+      if (Replacement) {
+        GEP->replaceAllUsesWith(Replacement);
+        Dead.push_back(GEP);
+      } else {
+        Candidates.push_back(GEP);
+      }
+    }
+  }
+
+  for (auto *GEP : Dead) {
+    GEP->eraseFromParent();
+  }
+  return !Dead.empty();
+}
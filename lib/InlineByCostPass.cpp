@@ -0,0 +1,272 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/CFG.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/CallingConv.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include "clspv/Option.h"
+
+#include "Passes.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "InlineByCost"
+
+STATISTIC(NumInlined, "Number of calls inlined by cost");
+STATISTIC(NumNotInlinedForPressure,
+          "Number of calls not inlined because of register pressure");
+
+namespace {
+class InlineByCostPass : public ModulePass {
+public:
+  static char ID;
+  InlineByCostPass() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override;
+
+private:
+  // Inlines the calls to |F| that the cost model accepts. Returns true if any
+  // call was inlined.
+  bool InlineCallsTo(Function &F);
+
+  // Returns the number of instructions of |F|, ignoring debug intrinsics.
+  static unsigned Size(const Function &F);
+
+  // The analyses of a caller needed to estimate register pressure.
+  struct CallerInfo {
+    explicit CallerInfo(Function &F) : DT(F), LI(DT) {}
+    DominatorTree DT;
+    LoopInfo LI;
+  };
+
+  // Returns an estimate of the number of values live across |call|: the
+  // arguments and instructions defined before it with a use reachable from
+  // it.
+  static unsigned LiveAcross(CallInst *call, const CallerInfo &info);
+
+  // Returns true if inlining |F|, of |size| instructions, at |call| would add
+  // to the register pressure of a loop that is already under pressure.
+  static bool UnderPressure(Function &F, unsigned size, CallInst *call,
+                            std::map<Function *, std::unique_ptr<CallerInfo>>
+                                &callers);
+};
+} // namespace
+
+namespace clspv {
+ModulePass *createInlineByCostPass() { return new InlineByCostPass(); }
+} // namespace clspv
+
+char InlineByCostPass::ID = 0;
+INITIALIZE_PASS(InlineByCostPass, "InlineByCost",
+                "Inline function calls selected by a cost model", false, false)
+
+bool InlineByCostPass::runOnModule(Module &M) {
+  // Visit the functions bottom-up, so that the size of each function accounts
+  // for everything already inlined into it.
+  std::vector<Function *> post_order;
+  DenseSet<Function *> visited;
+  std::vector<std::pair<Function *, bool>> stack;
+  for (auto &F : M) {
+    if (F.isDeclaration() || visited.count(&F))
+      continue;
+    stack.push_back({&F, false});
+    while (!stack.empty()) {
+      auto entry = stack.back();
+      stack.pop_back();
+      if (entry.second) {
+        post_order.push_back(entry.first);
+        continue;
+      }
+      if (!visited.insert(entry.first).second)
+        continue;
+      stack.push_back({entry.first, true});
+      for (auto &BB : *entry.first) {
+        for (auto &I : BB) {
+          auto *call = dyn_cast<CallInst>(&I);
+          auto *callee = call ? call->getCalledFunction() : nullptr;
+          if (callee && !callee->isDeclaration() && !visited.count(callee))
+            stack.push_back({callee, false});
+        }
+      }
+    }
+  }
+
+  bool Changed = false;
+  for (auto *F : post_order) {
+    if (F->getCallingConv() == CallingConv::SPIR_KERNEL ||
+        F->hasFnAttribute(Attribute::NoInline))
+      continue;
+    Changed |= InlineCallsTo(*F);
+  }
+
+  // Clean up dead functions.
+  std::vector<Function *> to_delete;
+  for (auto &F : M) {
+    if (F.isDeclaration() || F.getCallingConv() == CallingConv::SPIR_KERNEL)
+      continue;
+
+    if (F.user_empty())
+      to_delete.push_back(&F);
+  }
+  for (auto func : to_delete) {
+    func->eraseFromParent();
+  }
+
+  return Changed;
+}
+
+unsigned InlineByCostPass::Size(const Function &F) {
+  unsigned size = 0;
+  for (auto &BB : F) {
+    for (auto &I : BB) {
+      if (!isa<DbgInfoIntrinsic>(I))
+        ++size;
+    }
+  }
+  return size;
+}
+
+unsigned InlineByCostPass::LiveAcross(CallInst *call, const CallerInfo &info) {
+  auto live = [call, &info](Value &value) {
+    for (auto *user : value.users()) {
+      auto *inst = dyn_cast<Instruction>(user);
+      if (!inst || inst == call)
+        continue;
+      // A phi uses its value at the end of the incoming block.
+      if (auto *phi = dyn_cast<PHINode>(inst)) {
+        for (unsigned i = 0; i < phi->getNumIncomingValues(); ++i) {
+          if (phi->getIncomingValue(i) == &value &&
+              isPotentiallyReachable(
+                  call, phi->getIncomingBlock(i)->getTerminator(), nullptr,
+                  &info.DT, &info.LI))
+            return true;
+        }
+      } else if (isPotentiallyReachable(call, inst, nullptr, &info.DT,
+                                        &info.LI)) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  auto *F = call->getFunction();
+  unsigned count = 0;
+  for (auto &arg : F->args()) {
+    if (live(arg))
+      ++count;
+  }
+  for (auto &BB : *F) {
+    if (!info.DT.dominates(&BB, call->getParent()))
+      continue;
+    for (auto &I : BB) {
+      if (&I == call)
+        break;
+      if (!I.getType()->isVoidTy() && live(I))
+        ++count;
+    }
+  }
+  return count;
+}
+
+bool InlineByCostPass::UnderPressure(
+    Function &F, unsigned size, CallInst *call,
+    std::map<Function *, std::unique_ptr<CallerInfo>> &callers) {
+  const unsigned threshold = clspv::Option::InlinePressureThreshold();
+  if (threshold == 0 || size <= clspv::Option::InlinePressureCalleeSize())
+    return false;
+
+  auto *caller = call->getFunction();
+  auto &info = callers[caller];
+  if (!info)
+    info.reset(new CallerInfo(*caller));
+  if (!info->LI.getLoopFor(call->getParent()))
+    return false;
+
+  const unsigned live = LiveAcross(call, *info);
+  if (live < threshold)
+    return false;
+
+  LLVM_DEBUG(dbgs() << "Not inlining " << F.getName() << " (size " << size
+                    << ") into " << caller->getName() << ": " << live
+                    << " values live across the call in a loop\n");
+  return true;
+}
+
+bool InlineByCostPass::InlineCallsTo(Function &F) {
+  const unsigned threshold = clspv::Option::InlineCostThreshold();
+  const unsigned constant_bonus = clspv::Option::InlineConstantArgBonus();
+  const unsigned size = Size(F);
+
+  std::vector<CallInst *> to_inline;
+  if (F.hasOneUse()) {
+    // A function with a single call site is removed once inlined, so inlining
+    // it does not grow the module.
+    auto *call = dyn_cast<CallInst>(*F.user_begin());
+    if (call && call->getCalledFunction() == &F && size <= 2 * threshold)
+      to_inline.push_back(call);
+  } else {
+    for (auto *user : F.users()) {
+      auto *call = dyn_cast<CallInst>(user);
+      if (!call || call->getCalledFunction() != &F)
+        continue;
+
+      // Constant arguments let the inlined body fold.
+      unsigned bonus = 0;
+      for (auto &arg : call->args()) {
+        if (isa<Constant>(arg))
+          bonus += constant_bonus;
+      }
+      const unsigned cost = size > bonus ? size - bonus : 0;
+      if (cost <= threshold)
+        to_inline.push_back(call);
+    }
+  }
+
+  // Drop the calls in loops that are already under register pressure. The
+  // analyses of each caller are computed once, before anything is inlined.
+  std::map<Function *, std::unique_ptr<CallerInfo>> callers;
+  auto pressure = [&F, size, &callers](CallInst *call) {
+    return UnderPressure(F, size, call, callers);
+  };
+  const auto end = std::remove_if(to_inline.begin(), to_inline.end(), pressure);
+  NumNotInlinedForPressure += std::distance(end, to_inline.end());
+  to_inline.erase(end, to_inline.end());
+
+  bool Changed = false;
+  for (auto call : to_inline) {
+    ++NumInlined;
+    LLVM_DEBUG(dbgs() << "Inlining " << F.getName() << " (size " << size
+                      << ") into " << call->getFunction()->getName() << "\n");
+    InlineFunctionInfo IFI;
+    // Disable generation of lifetime intrinsic.
+    Changed |= InlineFunction(*call, IFI, nullptr, false).isSuccess();
+  }
+
+  return Changed;
+}
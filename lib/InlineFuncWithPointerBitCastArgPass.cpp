@@ -12,8 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallSet.h"
-#include "llvm/ADT/UniqueVector.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
@@ -65,7 +65,7 @@ bool InlineFuncWithPointerBitCastArgPass::runOnModule(Module &M) {
 bool InlineFuncWithPointerBitCastArgPass::InlineFunctions(Module &M) {
   bool Changed = false;
 
-  UniqueVector<CallInst *> WorkList;
+  SetVector<CallInst *> WorkList;
   for (Function &F : M) {
     for (BasicBlock &BB : F) {
       for (Instruction &I : BB) {
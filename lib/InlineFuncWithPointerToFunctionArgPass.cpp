@@ -12,7 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include "llvm/ADT/UniqueVector.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
@@ -90,7 +90,7 @@ bool InlineFuncWithPointerToFunctionArgPass::runOnModule(Module &M) {
 bool InlineFuncWithPointerToFunctionArgPass::InlineFunctions(Module &M) {
   bool Changed = false;
 
-  UniqueVector<CallInst *> WorkList;
+  SetVector<CallInst *> WorkList;
   for (Function &F : M) {
     for (BasicBlock &BB : F) {
       for (Instruction &I : BB) {
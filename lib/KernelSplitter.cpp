@@ -0,0 +1,208 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "KernelSplitter.h"
+
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "spirv/unified1/spirv.hpp"
+
+#include "clspv/SpecConstant.h"
+#include "clspv/spirv_reflection.hpp"
+
+#include "SizeOptimizer.h"
+
+namespace {
+
+const char kReflectionImportPrefix[] = "NonSemantic.ClspvReflection.";
+
+// Word offset of the first operand of an OpExtInst.
+const uint32_t kExtInstFirstOperand = 5;
+
+// Returns the ID of the ArgumentInfo operand of the argument reflection
+// instruction |inst|, or 0 if it has none or is not an argument instruction.
+uint32_t ArgumentInfoOperand(const uint32_t *inst, uint32_t word_count) {
+  const uint32_t num_ops = word_count - kExtInstFirstOperand;
+  const uint32_t *ops = inst + kExtInstFirstOperand;
+  switch (static_cast<clspv::reflection::ExtInst>(inst[4])) {
+  case clspv::reflection::ExtInstArgumentStorageBuffer:
+  case clspv::reflection::ExtInstArgumentUniform:
+  case clspv::reflection::ExtInstArgumentSampledImage:
+  case clspv::reflection::ExtInstArgumentStorageImage:
+  case clspv::reflection::ExtInstArgumentSampler:
+  case clspv::reflection::ExtInstArgumentPodPushConstant:
+  case clspv::reflection::ExtInstArgumentWorkgroup:
+    return num_ops > 4 ? ops[4] : 0;
+  case clspv::reflection::ExtInstArgumentPodStorageBuffer:
+  case clspv::reflection::ExtInstArgumentPodUniform:
+    return num_ops > 6 ? ops[6] : 0;
+  default:
+    return 0;
+  }
+}
+
+// Returns true if the reflection instruction |inst| belongs to a single
+// kernel, given by its first operand.
+bool IsPerKernelExtInst(const uint32_t *inst) {
+  switch (static_cast<clspv::reflection::ExtInst>(inst[4])) {
+  case clspv::reflection::ExtInstArgumentStorageBuffer:
+  case clspv::reflection::ExtInstArgumentUniform:
+  case clspv::reflection::ExtInstArgumentSampledImage:
+  case clspv::reflection::ExtInstArgumentStorageImage:
+  case clspv::reflection::ExtInstArgumentSampler:
+  case clspv::reflection::ExtInstArgumentPodPushConstant:
+  case clspv::reflection::ExtInstArgumentWorkgroup:
+  case clspv::reflection::ExtInstArgumentPodStorageBuffer:
+  case clspv::reflection::ExtInstArgumentPodUniform:
+  case clspv::reflection::ExtInstPropertyRequiredWorkgroupSize:
+    return true;
+  default:
+    return false;
+  }
+}
+
+struct EntryPoint {
+  uint32_t function;
+  std::string name;
+};
+
+} // namespace
+
+namespace clspv {
+
+bool SplitSPIRVByKernel(const std::vector<uint32_t> &words,
+                        std::vector<KernelModule> *modules) {
+  const size_t kHeaderWords = 5;
+  if (words.size() < kHeaderWords || words[0] != spv::MagicNumber)
+    return false;
+
+  // Find the entry points, the reflection import, the function of every
+  // reflection Kernel instruction, and the kernel of every ArgumentInfo.
+  std::vector<EntryPoint> entry_points;
+  std::unordered_set<uint32_t> entry_functions;
+  uint32_t import_id = 0;
+  uint32_t pod_spec_constant_import_id = 0;
+  std::unordered_map<uint32_t, uint32_t> decl_function;
+  std::unordered_map<uint32_t, uint32_t> arg_info_decl;
+  for (size_t i = kHeaderWords; i < words.size();) {
+    const uint32_t *inst = words.data() + i;
+    const uint32_t word_count = inst[0] >> 16;
+    if (word_count == 0 || i + word_count > words.size())
+      return false;
+    i += word_count;
+
+    switch (inst[0] & spv::OpCodeMask) {
+    case spv::OpEntryPoint: {
+      if (word_count < 4)
+        return false;
+      const char *name = reinterpret_cast<const char *>(inst + 3);
+      entry_points.push_back(
+          {inst[2], std::string(name, strnlen(name, (word_count - 3) *
+                                                        sizeof(uint32_t)))});
+      entry_functions.insert(inst[2]);
+      break;
+    }
+    case spv::OpExtInstImport:
+      if (word_count > 2 &&
+          strncmp(reinterpret_cast<const char *>(inst + 2),
+                  kReflectionImportPrefix,
+                  sizeof(kReflectionImportPrefix) - 1) == 0)
+        import_id = inst[1];
+      else if (word_count > 2 &&
+               strncmp(reinterpret_cast<const char *>(inst + 2),
+                       clspv::kPodSpecConstantImportName,
+                       (word_count - 2) * sizeof(uint32_t)) == 0)
+        pod_spec_constant_import_id = inst[1];
+      break;
+    case spv::OpExtInst:
+      if (import_id == 0 || word_count <= kExtInstFirstOperand ||
+          inst[3] != import_id)
+        break;
+      if (inst[4] == clspv::reflection::ExtInstKernel) {
+        decl_function[inst[2]] = inst[kExtInstFirstOperand];
+      } else if (auto arg_info = ArgumentInfoOperand(inst, word_count)) {
+        arg_info_decl[arg_info] = inst[kExtInstFirstOperand];
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  modules->clear();
+  for (const auto &entry : entry_points) {
+    // Returns true if the kernel declaration |decl| is for another kernel.
+    auto other_kernel = [&decl_function, &entry](uint32_t decl) {
+      auto iter = decl_function.find(decl);
+      return iter != decl_function.end() && iter->second != entry.function;
+    };
+
+    modules->emplace_back();
+    auto &module = modules->back();
+    module.name = entry.name;
+    module.words.reserve(words.size());
+    module.words.insert(module.words.end(), words.begin(),
+                        words.begin() + kHeaderWords);
+    for (size_t i = kHeaderWords; i < words.size();) {
+      const uint32_t *inst = words.data() + i;
+      const uint32_t word_count = inst[0] >> 16;
+      i += word_count;
+
+      bool keep = true;
+      switch (inst[0] & spv::OpCodeMask) {
+      case spv::OpEntryPoint:
+        keep = inst[2] == entry.function;
+        break;
+      case spv::OpExecutionMode:
+      case spv::OpExecutionModeId:
+        keep = inst[1] == entry.function || !entry_functions.count(inst[1]);
+        break;
+      case spv::OpExtInst:
+        // Every instruction of the POD spec constant set is per kernel.
+        if (pod_spec_constant_import_id != 0 &&
+            word_count > kExtInstFirstOperand &&
+            inst[3] == pod_spec_constant_import_id) {
+          keep = !other_kernel(inst[kExtInstFirstOperand]);
+          break;
+        }
+        if (import_id == 0 || word_count <= kExtInstFirstOperand ||
+            inst[3] != import_id)
+          break;
+        if (inst[4] == clspv::reflection::ExtInstKernel) {
+          keep = !other_kernel(inst[2]);
+        } else if (inst[4] == clspv::reflection::ExtInstArgumentInfo) {
+          auto iter = arg_info_decl.find(inst[2]);
+          keep = iter == arg_info_decl.end() || !other_kernel(iter->second);
+        } else if (IsPerKernelExtInst(inst)) {
+          keep = !other_kernel(inst[kExtInstFirstOperand]);
+        }
+        break;
+      default:
+        break;
+      }
+      if (keep)
+        module.words.insert(module.words.end(), inst, inst + word_count);
+    }
+
+    // Drop what the other kernels left unreferenced.
+    if (!OptimizeSPIRVForSize(&module.words))
+      return false;
+  }
+
+  return true;
+}
+
+} // namespace clspv
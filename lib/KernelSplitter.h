@@ -0,0 +1,40 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_LIB_KERNEL_SPLITTER_H_
+#define CLSPV_LIB_KERNEL_SPLITTER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace clspv {
+
+struct KernelModule {
+  // Name of the single entry point of |words|.
+  std::string name;
+  std::vector<uint32_t> words;
+};
+
+// Splits the SPIR-V module in |words| into one module per entry point, in
+// entry point order. Each module keeps only its entry point, the reflection
+// instructions of that kernel and the module-wide ones, and the functions,
+// global variables and constants still reachable from them. Returns false if
+// the module could not be split.
+bool SplitSPIRVByKernel(const std::vector<uint32_t> &words,
+                        std::vector<KernelModule> *modules);
+
+} // namespace clspv
+
+#endif // CLSPV_LIB_KERNEL_SPLITTER_H_
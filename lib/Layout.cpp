@@ -12,8 +12,15 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <numeric>
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Metadata.h"
+
 #include "clspv/Option.h"
 
+#include "Constants.h"
 #include "Layout.h"
 
 using namespace llvm;
@@ -23,116 +30,260 @@ bool isScalarType(Type *type) {
   return type->isIntegerTy() || type->isFloatingPointTy();
 }
 
-uint64_t structAlignment(StructType *type,
-                         std::function<uint64_t(Type *)> alignFn) {
-  uint64_t maxAlign = 1;
-  for (unsigned i = 0; i < type->getStructNumElements(); i++) {
-    uint64_t align = alignFn(type->getStructElementType(i));
-    maxAlign = std::max(align, maxAlign);
+bool improperlyStraddles(const DataLayout &DL, Type *type, unsigned offset) {
+  assert(type->isVectorTy());
+
+  auto size = DL.getTypeStoreSize(type);
+
+  // It is a vector with total size less than or equal to 16 bytes, and has
+  // Offset decorations placing its first byte at F and its last byte at L,
+  // where floor(F / 16) != floor(L / 16).
+  if ((size <= 16) && (offset % 16 + size > 16)) {
+    return true;
+  }
+
+  // It is a vector with total size greater than 16 bytes and has its Offset
+  // decorations placing its first byte at a non-integer multiple of 16
+  if ((size > 16) && (offset % 16 != 0)) {
+    return true;
   }
-  return maxAlign;
+
+  return false;
 }
+} // namespace
 
-uint64_t scalarAlignment(Type *type) {
-  // A scalar of size N has a scalar alignment of N.
-  if (isScalarType(type)) {
-    return type->getScalarSizeInBits() / 8;
+namespace clspv {
+
+SmallVector<unsigned, 8> PodArgsLayoutOrder(const DataLayout &DL,
+                                            ArrayRef<Type *> Types) {
+  SmallVector<unsigned, 8> Order(Types.size());
+  std::iota(Order.begin(), Order.end(), 0);
+  if (clspv::Option::PackPodArgs()) {
+    std::stable_sort(Order.begin(), Order.end(),
+                     [&DL, Types](unsigned lhs, unsigned rhs) {
+                       return DL.getABITypeAlignment(Types[lhs]) >
+                              DL.getABITypeAlignment(Types[rhs]);
+                     });
   }
+  return Order;
+}
 
-  // A vector or matrix type has a scalar alignment equal to that of its
-  // component type.
-  if (auto vec_type = dyn_cast<VectorType>(type)) {
-    return scalarAlignment(vec_type->getElementType());
+UBOTypeLayout::UBOTypeLayout(Module &M) : M(M) {
+  auto integer = [](const Metadata *md) {
+    return cast<ConstantInt>(cast<ConstantAsMetadata>(md)->getValue())
+        ->getZExtValue();
+  };
+
+  // Metadata is stored as key-value pair operands. The first element of each
+  // operand is a null constant of the type and the second is a vector of
+  // offsets.
+  if (auto *offsets_md =
+          M.getNamedMetadata(clspv::RemappedTypeOffsetMetadataName())) {
+    for (const auto *operand : offsets_md->operands()) {
+      const auto *pair = cast<MDTuple>(operand);
+      auto *type =
+          cast<ConstantAsMetadata>(pair->getOperand(0))->getValue()->getType();
+      const auto *offset_vector = cast<MDTuple>(pair->getOperand(1));
+      auto &offsets = Offsets[type];
+      for (const auto &offset_md : offset_vector->operands())
+        offsets.push_back(static_cast<uint32_t>(integer(offset_md)));
+    }
   }
 
-  // An array type has a scalar alignment equal to that of its element type.
-  if (type->isArrayTy()) {
-    return scalarAlignment(type->getArrayElementType());
+  // The second element is a triple of sizes instead: type size in bits, store
+  // size and alloc size.
+  if (auto *sizes_md =
+          M.getNamedMetadata(clspv::RemappedTypeSizesMetadataName())) {
+    for (const auto *operand : sizes_md->operands()) {
+      const auto *pair = cast<MDTuple>(operand);
+      auto *type =
+          cast<ConstantAsMetadata>(pair->getOperand(0))->getValue()->getType();
+      const auto *triple = cast<MDTuple>(pair->getOperand(1));
+      TypeSizes[type] = {integer(triple->getOperand(0)),
+                         integer(triple->getOperand(1)),
+                         integer(triple->getOperand(2))};
+    }
   }
+}
 
-  // A structure has a scalar alignment equal to the largest scalar alignment of
-  // any of its members.
-  if (type->isStructTy()) {
-    return structAlignment(cast<StructType>(type), scalarAlignment);
+void UBOTypeLayout::addOffsets(StructType *replacement,
+                               ArrayRef<uint64_t> offsets) {
+  auto &recorded = Offsets[replacement];
+  auto *i32 = Type::getInt32Ty(M.getContext());
+  SmallVector<Metadata *, 8> offset_values;
+  for (auto offset : offsets) {
+    recorded.push_back(static_cast<uint32_t>(offset));
+    offset_values.push_back(
+        ConstantAsMetadata::get(ConstantInt::get(i32, offset)));
   }
 
-  llvm_unreachable("Unsupported type");
+  NamedMDNode *offsets_md =
+      M.getOrInsertNamedMetadata(clspv::RemappedTypeOffsetMetadataName());
+  MDTuple *values_md = MDTuple::get(M.getContext(), offset_values);
+  offsets_md->addOperand(MDTuple::get(
+      M.getContext(),
+      {ConstantAsMetadata::get(Constant::getNullValue(replacement)),
+       values_md}));
 }
 
-uint64_t baseAlignment(Type *type) {
-  // A scalar has a base alignment equal to its scalar alignment.
-  if (isScalarType(type)) {
-    return scalarAlignment(type);
-  }
+void UBOTypeLayout::addSizes(Type *remapped, Type *original) {
+  const auto &DL = M.getDataLayout();
+  const Sizes sizes = {DL.getTypeSizeInBits(original),
+                       DL.getTypeStoreSize(original),
+                       DL.getTypeAllocSize(original)};
+  TypeSizes[remapped] = sizes;
+
+  NamedMDNode *sizes_md =
+      M.getOrInsertNamedMetadata(clspv::RemappedTypeSizesMetadataName());
+  auto *i32 = Type::getInt32Ty(M.getContext());
+  Metadata *size_values[3] = {
+      ConstantAsMetadata::get(ConstantInt::get(i32, sizes.size_in_bits)),
+      ConstantAsMetadata::get(ConstantInt::get(i32, sizes.store_size)),
+      ConstantAsMetadata::get(ConstantInt::get(i32, sizes.alloc_size))};
+  MDTuple *values_md = MDTuple::get(M.getContext(), size_values);
+  sizes_md->addOperand(MDTuple::get(
+      M.getContext(),
+      {ConstantAsMetadata::get(Constant::getNullValue(remapped)), values_md}));
+}
 
-  if (auto vec_type = dyn_cast<VectorType>(type)) {
-    unsigned numElems = vec_type->getElementCount().getKnownMinValue();
+const SmallVectorImpl<uint32_t> *UBOTypeLayout::getOffsets(Type *type) const {
+  auto iter = Offsets.find(type);
+  return iter == Offsets.end() ? nullptr : &iter->second;
+}
 
-    // A two-component vector has a base alignment equal to twice its scalar
-    // alignment.
-    if (numElems == 2) {
-      return 2 * scalarAlignment(type);
-    }
-    // A three- or four-component vector has a base alignment equal to four
-    // times its scalar alignment.
-    if ((numElems == 3) || (numElems == 4)) {
-      return 4 * scalarAlignment(type);
-    }
-  }
+const UBOTypeLayout::Sizes *UBOTypeLayout::getSizes(Type *type) const {
+  auto iter = TypeSizes.find(type);
+  return iter == TypeSizes.end() ? nullptr : &iter->second;
+}
 
-  // An array has a base alignment equal to the base alignment of its element
-  // type.
-  if (type->isArrayTy()) {
-    return baseAlignment(type->getArrayElementType());
+TypeLayoutCache::TypeLayoutCache(Module &M)
+    : DL(M.getDataLayout()), UBOLayout(M) {}
+
+uint64_t TypeLayoutCache::getTypeSizeInBits(Type *type) const {
+  if (auto *sizes = UBOLayout.getSizes(type)) {
+    return sizes->size_in_bits;
   }
+  return DL.getTypeSizeInBits(type);
+}
 
-  // A structure has a base alignment equal to the largest base alignment of any
-  // of its members.
-  if (type->isStructTy()) {
-    return structAlignment(cast<StructType>(type), baseAlignment);
+uint64_t TypeLayoutCache::getTypeStoreSize(Type *type) const {
+  if (auto *sizes = UBOLayout.getSizes(type)) {
+    return sizes->store_size;
   }
+  return DL.getTypeStoreSize(type);
+}
 
-  // TODO A row-major matrix of C columns has a base alignment equal to the base
-  // alignment of a vector of C matrix components.
-  // TODO A column-major matrix has a base alignment equal to the base alignment
-  // of the matrix column type.
+uint64_t TypeLayoutCache::getTypeAllocSize(Type *type) const {
+  if (auto *sizes = UBOLayout.getSizes(type)) {
+    return sizes->alloc_size;
+  }
+  return DL.getTypeAllocSize(type);
+}
 
-  llvm_unreachable("Unsupported type");
+uint32_t TypeLayoutCache::getMemberOffset(StructType *type,
+                                          unsigned member) const {
+  // The data layout of a rebuilt type does not give the correct offsets.
+  if (auto *offsets = UBOLayout.getOffsets(type)) {
+    return (*offsets)[member];
+  }
+  return static_cast<uint32_t>(
+      DL.getStructLayout(type)->getElementOffset(member));
 }
 
-uint64_t extendedAlignment(Type *type) {
-  // A scalar, vector or matrix type has an extended alignment equal to its base
-  // alignment.
-  // TODO matrix type
-  if (isScalarType(type) || type->isVectorTy()) {
-    return baseAlignment(type);
+uint64_t TypeLayoutCache::getAlignment(Type *type, AlignmentRule rule) {
+  const auto key = std::make_pair(type, static_cast<unsigned>(rule));
+  auto iter = Alignments.find(key);
+  if (iter != Alignments.end()) {
+    return iter->second;
   }
 
-  // An array or structure type has an extended alignment equal to the largest
-  // extended alignment of any of its members, rounded up to a multiple of 16
-  if (type->isStructTy()) {
-    auto salign = structAlignment(cast<StructType>(type), extendedAlignment);
-    return alignTo(salign, 16);
+  // Computing the alignment inserts into the cache, so |iter| cannot be reused.
+  const uint64_t align = computeAlignment(type, rule);
+  Alignments[key] = align;
+  return align;
+}
+
+uint64_t TypeLayoutCache::computeAlignment(Type *type, AlignmentRule rule) {
+  // A structure has the largest alignment of any of its members, for any
+  // rule. The extended alignment is additionally rounded up below.
+  if (auto struct_type = dyn_cast<StructType>(type)) {
+    uint64_t maxAlign = 1;
+    for (auto *element : struct_type->elements()) {
+      maxAlign = std::max(getAlignment(element, rule), maxAlign);
+    }
+    return rule == kExtended ? alignTo(maxAlign, 16) : maxAlign;
   }
 
+  // An array type has the alignment of its element type. The extended
+  // alignment is additionally rounded up to a multiple of 16.
   if (type->isArrayTy()) {
-    auto salign = extendedAlignment(type->getArrayElementType());
-    return alignTo(salign, 16);
+    auto align = getAlignment(type->getArrayElementType(), rule);
+    return rule == kExtended ? alignTo(align, 16) : align;
+  }
+
+  switch (rule) {
+  case kScalar:
+    // A scalar of size N has a scalar alignment of N.
+    if (isScalarType(type)) {
+      return type->getScalarSizeInBits() / 8;
+    }
+
+    // A vector or matrix type has a scalar alignment equal to that of its
+    // component type.
+    if (auto vec_type = dyn_cast<VectorType>(type)) {
+      return getAlignment(vec_type->getElementType(), kScalar);
+    }
+    break;
+  case kBase:
+    // A scalar has a base alignment equal to its scalar alignment.
+    if (isScalarType(type)) {
+      return getAlignment(type, kScalar);
+    }
+
+    if (auto vec_type = dyn_cast<VectorType>(type)) {
+      unsigned numElems = vec_type->getElementCount().getKnownMinValue();
+
+      // A two-component vector has a base alignment equal to twice its scalar
+      // alignment.
+      if (numElems == 2) {
+        return 2 * getAlignment(type, kScalar);
+      }
+      // A three- or four-component vector has a base alignment equal to four
+      // times its scalar alignment.
+      if ((numElems == 3) || (numElems == 4)) {
+        return 4 * getAlignment(type, kScalar);
+      }
+    }
+
+    // TODO A row-major matrix of C columns has a base alignment equal to the
+    // base alignment of a vector of C matrix components.
+    // TODO A column-major matrix has a base alignment equal to the base
+    // alignment of the matrix column type.
+    break;
+  case kExtended:
+    // A scalar, vector or matrix type has an extended alignment equal to its
+    // base alignment.
+    // TODO matrix type
+    if (isScalarType(type) || type->isVectorTy()) {
+      return getAlignment(type, kBase);
+    }
+    break;
   }
 
   llvm_unreachable("Unsupported type");
 }
 
-uint64_t standardAlignment(Type *type, spv::StorageClass sclass) {
+uint64_t TypeLayoutCache::getStandardAlignment(Type *type,
+                                               spv::StorageClass sclass) {
   // If the scalarBlockLayout feature is enabled on the device then every member
   // must be aligned according to its scalar alignment
   if (clspv::Option::ScalarBlockLayout()) {
-    return scalarAlignment(type);
+    return getAlignment(type, kScalar);
   }
 
   // All vectors must be aligned according to their scalar alignment
   if (type->isVectorTy()) {
-    return scalarAlignment(type);
+    return getAlignment(type, kScalar);
   }
 
   // If the uniformBufferStandardLayout feature is not enabled on the device,
@@ -140,45 +291,21 @@ uint64_t standardAlignment(Type *type, spv::StorageClass sclass) {
   // decoration of Block must be aligned according to its extended alignment.
   if (!clspv::Option::Std430UniformBufferLayout() &&
       sclass == spv::StorageClassUniform) {
-    return extendedAlignment(type);
+    return getAlignment(type, kExtended);
   }
 
   // Every other member must be aligned according to its base alignment
-  return baseAlignment(type);
-}
-
-bool improperlyStraddles(const DataLayout &DL, Type *type, unsigned offset) {
-  assert(type->isVectorTy());
-
-  auto size = DL.getTypeStoreSize(type);
-
-  // It is a vector with total size less than or equal to 16 bytes, and has
-  // Offset decorations placing its first byte at F and its last byte at L,
-  // where floor(F / 16) != floor(L / 16).
-  if ((size <= 16) && (offset % 16 + size > 16)) {
-    return true;
-  }
-
-  // It is a vector with total size greater than 16 bytes and has its Offset
-  // decorations placing its first byte at a non-integer multiple of 16
-  if ((size > 16) && (offset % 16 != 0)) {
-    return true;
-  }
-
-  return false;
+  return getAlignment(type, kBase);
 }
-} // namespace
-
-namespace clspv {
 
 // See 14.5 Shader Resource Interface in Vulkan spec
-bool isValidExplicitLayout(Module &M, StructType *STy, unsigned Member,
-                           spv::StorageClass SClass, unsigned Offset,
-                           unsigned PreviousMemberOffset) {
+bool TypeLayoutCache::isValidExplicitLayout(StructType *STy, unsigned Member,
+                                            spv::StorageClass SClass,
+                                            unsigned Offset,
+                                            unsigned PreviousMemberOffset) {
 
   auto MemberType = STy->getElementType(Member);
-  auto Align = standardAlignment(MemberType, SClass);
-  auto &DL = M.getDataLayout();
+  auto Align = getStandardAlignment(MemberType, SClass);
 
   // The Offset decoration of any member must be a multiple of its alignment
   if (Offset % Align != 0) {
@@ -201,7 +328,7 @@ bool isValidExplicitLayout(Module &M, StructType *STy, unsigned Member,
     if (Member > 0) {
       auto PType = STy->getElementType(Member - 1);
       if (PType->isStructTy() || PType->isArrayTy()) {
-        auto PAlign = standardAlignment(PType, SClass);
+        auto PAlign = getStandardAlignment(PType, SClass);
         if (Offset - PreviousMemberOffset < PAlign) {
           return false;
         }
@@ -212,15 +339,13 @@ bool isValidExplicitLayout(Module &M, StructType *STy, unsigned Member,
   return true;
 }
 
-bool isValidExplicitLayout(llvm::Module &M, llvm::StructType *STy,
-                           spv::StorageClass SClass) {
-  auto const &DL = M.getDataLayout();
-  const auto StructLayout = DL.getStructLayout(STy);
+bool TypeLayoutCache::isValidExplicitLayout(StructType *STy,
+                                            spv::StorageClass SClass) {
   bool ok = true;
-  auto previous_offset = 0;
+  unsigned previous_offset = 0;
   for (unsigned i = 0; ok && i < STy->getNumElements(); i++) {
-    auto offset = StructLayout->getElementOffset(i);
-    ok &= isValidExplicitLayout(M, STy, i, SClass, offset, previous_offset);
+    auto offset = getMemberOffset(STy, i);
+    ok &= isValidExplicitLayout(STy, i, SClass, offset, previous_offset);
     previous_offset = offset;
   }
 
@@ -12,6 +12,12 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <utility>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/DataLayout.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Module.h"
 
@@ -19,14 +25,104 @@
 
 namespace clspv {
 
-// Returns true if member |Member| is a valid layout in |STy| for storage class
-// |SClass|.
-bool isValidExplicitLayout(llvm::Module &M, llvm::StructType *STy,
-                           unsigned Member, spv::StorageClass SClass,
-                           unsigned offset, unsigned PreviousMemberOffset);
+// Returns the indices of |Types| in the order they are laid out in a struct.
+// With -pack-pod-args this is by decreasing alignment, which minimizes the
+// padding between members, keeping the original order among equally aligned
+// types. Otherwise it is the original order.
+llvm::SmallVector<unsigned, 8>
+PodArgsLayoutOrder(const llvm::DataLayout &DL,
+                   llvm::ArrayRef<llvm::Type *> Types);
+
+// Explicit layout of the types UBOTypeTransformPass rebuilds for uniform
+// buffers. A rebuilt type keeps the member offsets and sizes of the type it
+// replaces, which the data layout cannot compute from it.
+//
+// The layout is recorded in module metadata so that it survives between
+// passes and in IR files. Each user decodes it once into this object instead
+// of walking the metadata for every query.
+class UBOTypeLayout {
+public:
+  struct Sizes {
+    uint64_t size_in_bits;
+    uint64_t store_size;
+    uint64_t alloc_size;
+  };
+
+  // Decodes the layout already recorded in |M|.
+  explicit UBOTypeLayout(llvm::Module &M);
+
+  // Records that the members of |replacement| are at |offsets|.
+  void addOffsets(llvm::StructType *replacement,
+                  llvm::ArrayRef<uint64_t> offsets);
+
+  // Records that |remapped| has the sizes of |original|.
+  void addSizes(llvm::Type *remapped, llvm::Type *original);
+
+  // Returns the member offsets recorded for |type|, or null if it was not
+  // rebuilt.
+  const llvm::SmallVectorImpl<uint32_t> *getOffsets(llvm::Type *type) const;
+
+  // Returns the sizes recorded for |type|, or null if it was not rebuilt.
+  const Sizes *getSizes(llvm::Type *type) const;
+
+private:
+  llvm::Module &M;
+  llvm::DenseMap<llvm::Type *, llvm::SmallVector<uint32_t, 8>> Offsets;
+  llvm::DenseMap<llvm::Type *, Sizes> TypeSizes;
+};
+
+// Sizes, member offsets and Vulkan alignments of the types of a module.
+//
+// Sizes and offsets come from the layout recorded for the types rebuilt by
+// UBOTypeTransformPass and from the data layout otherwise. Alignments follow
+// the rules of 14.5 Shader Resource Interface in the Vulkan spec and are
+// memoized per type and rule, since they recurse through every member.
+//
+// Types are never mutated in place, so the cache stays valid for the lifetime
+// of a pass. A pass that rebuilds types records them through addOffsets and
+// addSizes.
+class TypeLayoutCache {
+public:
+  explicit TypeLayoutCache(llvm::Module &M);
+
+  uint64_t getTypeSizeInBits(llvm::Type *type) const;
+  uint64_t getTypeStoreSize(llvm::Type *type) const;
+  uint64_t getTypeAllocSize(llvm::Type *type) const;
+
+  // Returns the offset of member |member| of |type|.
+  uint32_t getMemberOffset(llvm::StructType *type, unsigned member) const;
+
+  // Returns the alignment required of |type| as a member of a block in
+  // storage class |SClass|.
+  uint64_t getStandardAlignment(llvm::Type *type, spv::StorageClass SClass);
+
+  // Returns true if member |Member| is a valid layout in |STy| for storage
+  // class |SClass|.
+  bool isValidExplicitLayout(llvm::StructType *STy, unsigned Member,
+                             spv::StorageClass SClass, unsigned Offset,
+                             unsigned PreviousMemberOffset);
+
+  // Returns true if |STy| is a valid layout for storage class |SClass|.
+  bool isValidExplicitLayout(llvm::StructType *STy, spv::StorageClass SClass);
+
+  // See UBOTypeLayout.
+  void addOffsets(llvm::StructType *replacement,
+                  llvm::ArrayRef<uint64_t> offsets) {
+    UBOLayout.addOffsets(replacement, offsets);
+  }
+  void addSizes(llvm::Type *remapped, llvm::Type *original) {
+    UBOLayout.addSizes(remapped, original);
+  }
+
+private:
+  enum AlignmentRule { kScalar, kBase, kExtended };
+
+  uint64_t getAlignment(llvm::Type *type, AlignmentRule rule);
+  uint64_t computeAlignment(llvm::Type *type, AlignmentRule rule);
 
-// Returns true if |STy| is a valid layout for storage class.
-bool isValidExplicitLayout(llvm::Module &M, llvm::StructType *STy,
-                           spv::StorageClass SClass);
+  const llvm::DataLayout &DL;
+  UBOTypeLayout UBOLayout;
+  llvm::DenseMap<std::pair<llvm::Type *, unsigned>, uint64_t> Alignments;
+};
 
 } // namespace clspv
@@ -26,6 +26,7 @@
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/Local.h"
 
+#include "clspv/Option.h"
 #include "clspv/Passes.h"
 
 #include "Builtins.h"
@@ -46,7 +47,8 @@ public:
   static char ID;
 
 public:
-  LongVectorLoweringPass() : ModulePass(ID) {}
+  LongVectorLoweringPass()
+      : ModulePass(ID), ChunkWidth(clspv::Option::LongVectorChunkWidth()) {}
 
   /// Lower the content of the given module @p M.
   bool runOnModule(Module &M) override;
@@ -127,7 +129,7 @@ private:
   bool runOnFunction(Function &F);
 
   /// Map the call @p CI to an OpenCL builtin function or an LLVM intrinsic to
-  /// calls to its scalar version.
+  /// calls to its scalar or chunk version.
   Value *convertBuiltinCall(CallInst &CI, Type *EquivalentReturnTy,
                             ArrayRef<Value *> EquivalentArgs);
 
@@ -148,6 +150,11 @@ private:
   void cleanDeadFunctions();
 
 private:
+  /// Number of elements of each member of the equivalent struct of a long
+  /// vector. 1 lowers long vectors to scalars; 2 and 4 lower them to vectors
+  /// of that many elements.
+  unsigned ChunkWidth;
+
   /// A map between long-vector types and their equivalent representation.
   DenseMap<Type *, Type *> TypeMap;
 
@@ -191,8 +198,10 @@ void partitionInstructions(ArrayRef<WeakTrackingVH> Instructions,
   }
 }
 
-/// Get the scalar overload for the given LLVM @p Intrinsic.
-Function *getIntrinsicScalarVersion(Function &Intrinsic) {
+/// Get the overload of the given LLVM @p Intrinsic operating on the members of
+/// the equivalent struct of a long vector: scalars if @p ChunkWidth is 1, and
+/// vectors of @p ChunkWidth elements otherwise.
+Function *getIntrinsicChunkVersion(Function &Intrinsic, unsigned ChunkWidth) {
   auto id = Intrinsic.getIntrinsicID();
   assert(id != Intrinsic::not_intrinsic);
 
@@ -210,11 +219,14 @@ Function *getIntrinsicScalarVersion(Function &Intrinsic) {
     assert(Success);
     (void)Success;
 
-    // Map vectors to scalars.
+    // Map vectors to scalars or chunks.
     for (auto *&Param : ParamTys) {
       // TODO Need support for other types, like pointers. Need test case.
       assert(Param->isVectorTy());
       Param = Param->getScalarType();
+      if (ChunkWidth > 1) {
+        Param = FixedVectorType::get(Param, ChunkWidth);
+      }
     }
 
     return Intrinsic::getDeclaration(Intrinsic.getParent(), id, ParamTys);
@@ -223,6 +235,33 @@ Function *getIntrinsicScalarVersion(Function &Intrinsic) {
   }
 }
 
+/// Return the element at @p Index of the long vector represented by the struct
+/// @p Aggregate, whose members are either scalars or vector chunks.
+Value *extractLongVectorElement(IRBuilder<> &B, Value *Aggregate,
+                                unsigned Index) {
+  auto *MemberTy = Aggregate->getType()->getStructElementType(0);
+  if (auto *ChunkTy = dyn_cast<FixedVectorType>(MemberTy)) {
+    unsigned Width = ChunkTy->getNumElements();
+    Value *Chunk = B.CreateExtractValue(Aggregate, Index / Width);
+    return B.CreateExtractElement(Chunk, Index % Width);
+  }
+  return B.CreateExtractValue(Aggregate, Index);
+}
+
+/// Return @p Aggregate with the element at @p Index of the long vector it
+/// represents replaced by @p Scalar.
+Value *insertLongVectorElement(IRBuilder<> &B, Value *Aggregate, Value *Scalar,
+                               unsigned Index) {
+  auto *MemberTy = Aggregate->getType()->getStructElementType(0);
+  if (auto *ChunkTy = dyn_cast<FixedVectorType>(MemberTy)) {
+    unsigned Width = ChunkTy->getNumElements();
+    Value *Chunk = B.CreateExtractValue(Aggregate, Index / Width);
+    Chunk = B.CreateInsertElement(Chunk, Scalar, Index % Width);
+    return B.CreateInsertValue(Aggregate, Chunk, Index / Width);
+  }
+  return B.CreateInsertValue(Aggregate, Scalar, Index);
+}
+
 /// Convert the given value @p V to a value of the given @p EquivalentTy.
 ///
 /// @return @p V when @p V's type is @p newType.
@@ -246,19 +285,19 @@ Value *convertEquivalentValue(IRBuilder<> &B, Value *V, Type *EquivalentTy) {
   if (EquivalentTy->isVectorTy()) {
     assert(V->getType()->isStructTy());
 
-    unsigned Arity = V->getType()->getNumContainedTypes();
+    unsigned Arity = cast<FixedVectorType>(EquivalentTy)->getNumElements();
     for (unsigned i = 0; i < Arity; ++i) {
-      Value *Scalar = B.CreateExtractValue(V, i);
+      Value *Scalar = extractLongVectorElement(B, V, i);
       NewValue = B.CreateInsertElement(NewValue, Scalar, i);
     }
   } else {
     assert(EquivalentTy->isStructTy());
     assert(V->getType()->isVectorTy());
 
-    unsigned Arity = EquivalentTy->getNumContainedTypes();
+    unsigned Arity = cast<FixedVectorType>(V->getType())->getNumElements();
     for (unsigned i = 0; i < Arity; ++i) {
       Value *Scalar = B.CreateExtractElement(V, i);
-      NewValue = B.CreateInsertValue(NewValue, Scalar, i);
+      NewValue = insertLongVectorElement(B, NewValue, Scalar, i);
     }
   }
 
@@ -268,8 +307,9 @@ Value *convertEquivalentValue(IRBuilder<> &B, Value *V, Type *EquivalentTy) {
 using ScalarOperationFactory =
     std::function<Value *(IRBuilder<> & /* B */, ArrayRef<Value *> /* Args */)>;
 
-/// Scalarise the vector instruction @p I element-wise by invoking the operation
-/// @p ScalarOperation.
+/// Split the vector instruction @p I member-wise by invoking the operation
+/// @p ScalarOperation on each member of the equivalent structs, which are
+/// either scalars or vector chunks.
 Value *convertVectorOperation(Instruction &I, Type *EquivalentReturnTy,
                               ArrayRef<Value *> EquivalentArgs,
                               ScalarOperationFactory ScalarOperation) {
@@ -432,7 +472,17 @@ Value *LongVectorLoweringPass::visitConstant(Constant &Cst) {
       Scalars.push_back(Vector->getElementAsConstant(i));
     }
 
-    return ConstantStruct::get(cast<StructType>(EquivalentTy), Scalars);
+    if (ChunkWidth == 1 ||
+        !EquivalentTy->getStructElementType(0)->isVectorTy()) {
+      return ConstantStruct::get(cast<StructType>(EquivalentTy), Scalars);
+    }
+
+    SmallVector<Constant *, 4> Chunks;
+    for (unsigned i = 0; i < Scalars.size(); i += ChunkWidth) {
+      Chunks.push_back(
+          ConstantVector::get(makeArrayRef(Scalars).slice(i, ChunkWidth)));
+    }
+    return ConstantStruct::get(cast<StructType>(EquivalentTy), Chunks);
   }
 
 #ifndef NDEBUG
@@ -570,7 +620,7 @@ Value *LongVectorLoweringPass::visitExtractElementInst(ExtractElementInst &I) {
   unsigned Index = CI->getZExtValue();
 
   IRBuilder<> B(&I);
-  auto *V = B.CreateExtractValue(EquivalentValue, Index);
+  auto *V = extractLongVectorElement(B, EquivalentValue, Index);
   registerReplacement(I, *V);
   return V;
 }
@@ -589,7 +639,7 @@ Value *LongVectorLoweringPass::visitInsertElementInst(InsertElementInst &I) {
   unsigned Index = CI->getZExtValue();
 
   IRBuilder<> B(&I);
-  auto *V = B.CreateInsertValue(EquivalentValue, ScalarElement, {Index});
+  auto *V = insertLongVectorElement(B, EquivalentValue, ScalarElement, Index);
   registerReplacement(I, *V);
   return V;
 }
@@ -631,7 +681,7 @@ Value *LongVectorLoweringPass::visitShuffleVectorInst(ShuffleVectorInst &I) {
       return B.CreateExtractElement(Vector, Index);
     } else {
       assert(Vector->getType()->isStructTy());
-      return B.CreateExtractValue(Vector, Index);
+      return extractLongVectorElement(B, Vector, Index);
     }
   };
 
@@ -641,7 +691,7 @@ Value *LongVectorLoweringPass::visitShuffleVectorInst(ShuffleVectorInst &I) {
       return B.CreateInsertElement(Vector, Scalar, Index);
     } else {
       assert(Vector->getType()->isStructTy());
-      return B.CreateInsertValue(Vector, Scalar, Index);
+      return insertLongVectorElement(B, Vector, Scalar, Index);
     }
   };
 
@@ -765,8 +815,16 @@ Type *LongVectorLoweringPass::getEquivalentTypeImpl(Type *Ty) {
       assert((ScalarTy->isFloatingPointTy() || ScalarTy->isIntegerTy()) &&
              "Unsupported scalar type");
 
-      SmallVector<Type *, 16> AggregateBody(Arity, ScalarTy);
+      // Split into vector chunks when requested, falling back to scalars
+      // when the arity is not a multiple of the chunk width.
       auto &C = Ty->getContext();
+      if (ChunkWidth > 1 && Arity % ChunkWidth == 0) {
+        SmallVector<Type *, 8> AggregateBody(
+            Arity / ChunkWidth, FixedVectorType::get(ScalarTy, ChunkWidth));
+        return StructType::get(C, AggregateBody);
+      }
+
+      SmallVector<Type *, 16> AggregateBody(Arity, ScalarTy);
       return StructType::get(C, AggregateBody);
     }
 
@@ -873,7 +931,7 @@ LongVectorLoweringPass::convertBuiltinCall(CallInst &VectorCall,
     // and LLVM intrinsics.
     // TODO Implement support for OpenCL builtins.
     assert(VectorFunction->isIntrinsic());
-    ScalarFunction = getIntrinsicScalarVersion(*VectorFunction);
+    ScalarFunction = getIntrinsicChunkVersion(*VectorFunction, ChunkWidth);
     FunctionMap[VectorFunction] = ScalarFunction;
   }
   assert(ScalarFunction);
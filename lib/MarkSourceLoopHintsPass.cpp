@@ -0,0 +1,102 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Marks the loops the source asks not to unroll, before the LLVM
+// optimizations run. The LLVM unroller adds llvm.loop.unroll.disable to every
+// loop it has unrolled, which the SPIR-V producer cannot tell apart from a
+// #pragma nounroll. The marker added here is not an llvm.loop.unroll hint, so
+// the unroller keeps it, and only the marked loops get DontUnroll.
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/Pass.h"
+
+#include "Constants.h"
+#include "Passes.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "MarkSourceLoopHints"
+
+namespace {
+struct MarkSourceLoopHintsPass : public FunctionPass {
+  static char ID;
+  MarkSourceLoopHintsPass() : FunctionPass(ID) {}
+
+  bool runOnFunction(Function &F) override;
+};
+
+// Returns true if the loop ID |loop_id| holds the hint |name|.
+bool HasHint(const MDNode *loop_id, StringRef name) {
+  // Operand 0 is the self reference.
+  for (unsigned i = 1; i < loop_id->getNumOperands(); ++i) {
+    auto *hint = dyn_cast<MDNode>(loop_id->getOperand(i));
+    if (!hint || hint->getNumOperands() == 0)
+      continue;
+    auto *hint_name = dyn_cast<MDString>(hint->getOperand(0));
+    if (hint_name && hint_name->getString() == name)
+      return true;
+  }
+  return false;
+}
+} // namespace
+
+char MarkSourceLoopHintsPass::ID = 0;
+INITIALIZE_PASS(MarkSourceLoopHintsPass, "MarkSourceLoopHints",
+                "Mark Source Loop Hints Pass", false, false)
+
+namespace clspv {
+FunctionPass *createMarkSourceLoopHintsPass() {
+  return new MarkSourceLoopHintsPass();
+}
+} // namespace clspv
+
+bool MarkSourceLoopHintsPass::runOnFunction(Function &F) {
+  auto &Ctx = F.getContext();
+  const auto marker_name = clspv::SourceDontUnrollHintName();
+  auto *marker = MDNode::get(Ctx, MDString::get(Ctx, marker_name));
+
+  bool Changed = false;
+  // The latches of a loop share its loop ID, so each ID is rewritten once.
+  DenseMap<MDNode *, MDNode *> marked;
+  for (auto &BB : F) {
+    auto *term = BB.getTerminator();
+    if (!term)
+      continue;
+    auto *loop_id = term->getMetadata(LLVMContext::MD_loop);
+    if (!loop_id || loop_id->getNumOperands() == 0 ||
+        loop_id->getOperand(0) != loop_id)
+      continue;
+
+    auto it = marked.find(loop_id);
+    if (it == marked.end()) {
+      MDNode *new_id = nullptr;
+      if (HasHint(loop_id, "llvm.loop.unroll.disable") &&
+          !HasHint(loop_id, marker_name)) {
+        SmallVector<Metadata *, 4> ops(loop_id->op_begin(), loop_id->op_end());
+        ops.push_back(marker);
+        new_id = MDNode::getDistinct(Ctx, ops);
+        new_id->replaceOperandWith(0, new_id);
+      }
+      it = marked.insert({loop_id, new_id}).first;
+    }
+    if (it->second) {
+      term->setMetadata(LLVMContext::MD_loop, it->second);
+      Changed = true;
+    }
+  }
+
+  return Changed;
+}
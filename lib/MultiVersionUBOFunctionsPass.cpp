@@ -20,8 +20,8 @@
 
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallVector.h"
-#include "llvm/ADT/UniqueVector.h"
 #include "llvm/IR/CallingConv.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/IRBuilder.h"
@@ -94,7 +94,7 @@ ModulePass *createMultiVersionUBOFunctionsPass() {
 
 bool MultiVersionUBOFunctionsPass::runOnModule(Module &M) {
   bool changed = false;
-  UniqueVector<Function *> ordered_functions =
+  SetVector<Function *> ordered_functions =
       clspv::CallGraphOrderedFunctions(M);
 
   for (auto fn : ordered_functions) {
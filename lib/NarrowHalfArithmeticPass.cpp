@@ -0,0 +1,292 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Computes float arithmetic truncated to half at half precision. Mixing half
+// values with float values or calling math builtins on converted half values
+// produces expressions such as
+//   %r = fptrunc (call float @_Z3sinf(float (fpext half %a to float))) to half
+// which instcombine leaves alone because the result may differ from the one
+// computed in float. With -native-fp16 the whole expression is evaluated as
+//   %r = call half @_Z3sinDh(half %a)
+// so that the GLSL.std.450 extended instructions run at half precision.
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Pass.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+#include "clspv/Option.h"
+
+#include "Builtins.h"
+#include "Passes.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "NarrowHalfArithmetic"
+
+namespace {
+struct NarrowHalfArithmeticPass : public ModulePass {
+  static char ID;
+  NarrowHalfArithmeticPass() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override;
+
+private:
+  // Returns true if |v|, which has a float type, can be computed at half
+  // precision without affecting any other user of the values involved.
+  bool CanNarrow(Value *v);
+
+  // Returns |v| computed at half precision. New instructions are inserted by
+  // |builder|.
+  Value *Narrow(Value *v, IRBuilder<> &builder);
+
+  // Returns the half precision overload of the builtin called by |call|.
+  FunctionCallee GetHalfBuiltin(CallInst *call);
+};
+
+// Returns |type| with its float elements replaced by half.
+Type *HalfType(Type *type) {
+  auto *half_ty = Type::getHalfTy(type->getContext());
+  if (auto *vec_ty = dyn_cast<VectorType>(type))
+    return VectorType::get(half_ty, vec_ty->getElementCount());
+  return half_ty;
+}
+
+// Returns true if the builtin |info| maps to a GLSL.std.450 extended
+// instruction that supports 16-bit floats.
+bool IsHalfExtInstBuiltin(const clspv::Builtins::FunctionInfo &info) {
+  switch (info.getType()) {
+  case clspv::Builtins::kAcos:
+  case clspv::Builtins::kAsin:
+  case clspv::Builtins::kAtan:
+  case clspv::Builtins::kAtan2:
+  case clspv::Builtins::kCeil:
+  case clspv::Builtins::kClamp:
+  case clspv::Builtins::kCos:
+  case clspv::Builtins::kCosh:
+  case clspv::Builtins::kDegrees:
+  case clspv::Builtins::kExp:
+  case clspv::Builtins::kExp2:
+  case clspv::Builtins::kFabs:
+  case clspv::Builtins::kFloor:
+  case clspv::Builtins::kFma:
+  case clspv::Builtins::kFmax:
+  case clspv::Builtins::kFmin:
+  case clspv::Builtins::kLog:
+  case clspv::Builtins::kLog2:
+  case clspv::Builtins::kMax:
+  case clspv::Builtins::kMin:
+  case clspv::Builtins::kMix:
+  case clspv::Builtins::kPow:
+  case clspv::Builtins::kRadians:
+  case clspv::Builtins::kRint:
+  case clspv::Builtins::kRound:
+  case clspv::Builtins::kRsqrt:
+  case clspv::Builtins::kSign:
+  case clspv::Builtins::kSin:
+  case clspv::Builtins::kSinh:
+  case clspv::Builtins::kSmoothstep:
+  case clspv::Builtins::kSqrt:
+  case clspv::Builtins::kStep:
+  case clspv::Builtins::kTan:
+  case clspv::Builtins::kTanh:
+  case clspv::Builtins::kTrunc:
+    return true;
+  default:
+    return false;
+  }
+}
+} // namespace
+
+char NarrowHalfArithmeticPass::ID = 0;
+INITIALIZE_PASS(NarrowHalfArithmeticPass, "NarrowHalfArithmetic",
+                "Narrow Half Arithmetic Pass", false, false)
+
+namespace clspv {
+ModulePass *createNarrowHalfArithmeticPass() {
+  return new NarrowHalfArithmeticPass();
+}
+} // namespace clspv
+
+bool NarrowHalfArithmeticPass::runOnModule(Module &M) {
+  // Narrowing one expression can delete truncations that are leaves of it.
+  SmallVector<WeakVH, 16> WorkList;
+  for (auto &F : M) {
+    for (auto &BB : F) {
+      for (auto &I : BB) {
+        auto *trunc = dyn_cast<FPTruncInst>(&I);
+        if (trunc && trunc->getType()->getScalarType()->isHalfTy() &&
+            trunc->getSrcTy()->getScalarType()->isFloatTy())
+          WorkList.push_back(trunc);
+      }
+    }
+  }
+
+  bool Changed = false;
+  for (auto &handle : WorkList) {
+    auto *trunc = cast_or_null<FPTruncInst>(handle);
+    if (!trunc)
+      continue;
+
+    // A truncation of an extension is left to instcombine.
+    auto *src = trunc->getOperand(0);
+    if (!isa<BinaryOperator>(src) && !isa<UnaryOperator>(src) &&
+        !isa<SelectInst>(src) && !isa<CallInst>(src))
+      continue;
+    if (!CanNarrow(src))
+      continue;
+
+    IRBuilder<> builder(trunc);
+    auto *narrow = Narrow(src, builder);
+    if (isa<Instruction>(narrow))
+      narrow->takeName(trunc);
+    trunc->replaceAllUsesWith(narrow);
+    trunc->eraseFromParent();
+    RecursivelyDeleteTriviallyDeadInstructions(src);
+    Changed = true;
+  }
+
+  return Changed;
+}
+
+bool NarrowHalfArithmeticPass::CanNarrow(Value *v) {
+  if (!v->getType()->getScalarType()->isFloatTy())
+    return false;
+
+  // Only constants that are exactly representable in half keep their value.
+  if (auto *c = dyn_cast<Constant>(v)) {
+    auto *narrow = ConstantExpr::getFPTrunc(c, HalfType(c->getType()));
+    return ConstantExpr::getFPExtend(narrow, c->getType()) == c;
+  }
+
+  // Extensions from half are the leaves of the expression. Their operand is
+  // reused, so they may have other users.
+  if (auto *ext = dyn_cast<FPExtInst>(v))
+    return ext->getSrcTy()->getScalarType()->isHalfTy();
+
+  auto *inst = dyn_cast<Instruction>(v);
+  if (!inst || !inst->hasOneUse())
+    return false;
+
+  switch (inst->getOpcode()) {
+  case Instruction::FAdd:
+  case Instruction::FSub:
+  case Instruction::FMul:
+  case Instruction::FDiv:
+    return CanNarrow(inst->getOperand(0)) && CanNarrow(inst->getOperand(1));
+  case Instruction::FNeg:
+    return CanNarrow(inst->getOperand(0));
+  case Instruction::Select:
+    return CanNarrow(inst->getOperand(1)) && CanNarrow(inst->getOperand(2));
+  case Instruction::Call: {
+    auto *call = cast<CallInst>(inst);
+    auto *callee = call->getCalledFunction();
+    if (!callee || !callee->isDeclaration() ||
+        !IsHalfExtInstBuiltin(clspv::Builtins::Lookup(callee)))
+      return false;
+    for (auto &arg : call->args()) {
+      if (!CanNarrow(arg))
+        return false;
+    }
+    return true;
+  }
+  default:
+    break;
+  }
+  return false;
+}
+
+Value *NarrowHalfArithmeticPass::Narrow(Value *v, IRBuilder<> &builder) {
+  if (auto *c = dyn_cast<Constant>(v))
+    return ConstantExpr::getFPTrunc(c, HalfType(c->getType()));
+
+  if (auto *ext = dyn_cast<FPExtInst>(v))
+    return ext->getOperand(0);
+
+  auto *inst = cast<Instruction>(v);
+  Value *narrow = nullptr;
+  switch (inst->getOpcode()) {
+  case Instruction::FNeg:
+    narrow = builder.CreateFNeg(Narrow(inst->getOperand(0), builder));
+    break;
+  case Instruction::Select: {
+    auto *sel = cast<SelectInst>(inst);
+    auto *true_value = Narrow(sel->getTrueValue(), builder);
+    auto *false_value = Narrow(sel->getFalseValue(), builder);
+    narrow = builder.CreateSelect(sel->getCondition(), true_value, false_value);
+    break;
+  }
+  case Instruction::Call: {
+    auto *call = cast<CallInst>(inst);
+    SmallVector<Value *, 3> args;
+    for (auto &arg : call->args()) {
+      args.push_back(Narrow(arg, builder));
+    }
+    auto *new_call = builder.CreateCall(GetHalfBuiltin(call), args);
+    new_call->setCallingConv(call->getCallingConv());
+    new_call->setAttributes(call->getAttributes());
+    narrow = new_call;
+    break;
+  }
+  default: {
+    auto *lhs = Narrow(inst->getOperand(0), builder);
+    auto *rhs = Narrow(inst->getOperand(1), builder);
+    narrow = builder.CreateBinOp(cast<BinaryOperator>(inst)->getOpcode(), lhs,
+                                 rhs);
+    break;
+  }
+  }
+
+  if (auto *narrow_inst = dyn_cast<Instruction>(narrow))
+    narrow_inst->copyIRFlags(inst);
+  return narrow;
+}
+
+FunctionCallee NarrowHalfArithmeticPass::GetHalfBuiltin(CallInst *call) {
+  auto *callee = call->getCalledFunction();
+  const auto &info = clspv::Builtins::Lookup(callee);
+
+  // Mangle the half overload. A builtin has at most one vector parameter type,
+  // and its repetitions are substitutions.
+  std::string name =
+      clspv::Builtins::GetMangledFunctionName(info.getName().c_str());
+  SmallVector<Type *, 3> params;
+  Type *vec_ty = nullptr;
+  for (auto &arg : call->args()) {
+    auto *ty = HalfType(arg->getType());
+    params.push_back(ty);
+    if (ty == vec_ty) {
+      name += "S_";
+    } else {
+      name += clspv::Builtins::GetMangledTypeName(ty);
+      if (ty->isVectorTy())
+        vec_ty = ty;
+    }
+  }
+
+  auto *fn_ty =
+      FunctionType::get(HalfType(call->getType()), params, callee->isVarArg());
+  auto *M = callee->getParent();
+  auto *existing = M->getFunction(name);
+  auto half_fn = M->getOrInsertFunction(name, fn_ty);
+  if (!existing) {
+    auto *fn = cast<Function>(half_fn.getCallee());
+    fn->setCallingConv(callee->getCallingConv());
+    fn->setAttributes(callee->getAttributes());
+  }
+  return half_fn;
+}
@@ -0,0 +1,431 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Computes 64-bit integer arithmetic whose values fit in 32 bits at 32 bits,
+// so that kernels using long only for small values do not need the Int64
+// capability, which many devices emulate. For example, with %n known to be
+// in [0, 1024),
+//   %a = zext i32 %n to i64
+//   %b = add i64 %a, 1
+//   %c = icmp ult i64 %b, %limit64
+// becomes
+//   %b = add i32 %n, 1
+//   %c = icmp ult i32 %b, %limit32
+// when %limit64 also fits in 32 bits.
+//
+// The ranges come from LazyValueInfo, which also uses the llvm.assume calls
+// added by AssumeInt64ArgRangesPass for the ranges of kernel arguments given
+// with -int64-arg-range. Those calls are removed once the ranges are used.
+// When the range of an argument fits in 32 bits, AssumeInt64ArgRangesPass
+// also retypes the argument to <2 x i32>, which has the same size and
+// alignment, and only reads its low word, so that the argument does not need
+// the Int64 capability either.
+
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LazyValueInfo.h"
+#include "llvm/IR/ConstantRange.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Pass.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+#include "clspv/Option.h"
+
+#include "Passes.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "NarrowInt64Arithmetic"
+
+namespace {
+// How a 64-bit value is computed at 32 bits and extended back.
+enum class Narrowing { kNone, kSigned, kUnsigned };
+
+struct AssumeInt64ArgRangesPass : public ModulePass {
+  static char ID;
+  AssumeInt64ArgRangesPass() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override;
+
+private:
+  // Replaces the kernel |F| by a copy whose argument |ordinal| is a <2 x i32>
+  // and returns the 64-bit value of the argument, rebuilt from the low word
+  // by sign or zero extension depending on |is_signed|.
+  Value *ReadLowWord(Function *F, unsigned ordinal, bool is_signed);
+};
+
+struct NarrowInt64ArithmeticPass : public FunctionPass {
+  static char ID;
+  NarrowInt64ArithmeticPass() : FunctionPass(ID) {}
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<LazyValueInfoWrapperPass>();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  // Returns how |inst| can be computed at 32 bits.
+  Narrowing GetNarrowing(Instruction *inst);
+
+  // Returns the range of |v| at |context|.
+  ConstantRange GetRange(Value *v, Instruction *context);
+
+  // Returns the low 32 bits of |v|, inserting any new instruction before
+  // |insert_before|.
+  Value *GetNarrowValue(Value *v, Instruction *insert_before);
+
+  LazyValueInfo *LVI = nullptr;
+};
+
+bool FitsSigned(const ConstantRange &range) {
+  return range.getMinSignedBits() <= 32;
+}
+
+bool FitsUnsigned(const ConstantRange &range) {
+  return range.getActiveBits() <= 32;
+}
+} // namespace
+
+char AssumeInt64ArgRangesPass::ID = 0;
+INITIALIZE_PASS(AssumeInt64ArgRangesPass, "AssumeInt64ArgRanges",
+                "Assume the ranges of 64-bit kernel arguments", false, false)
+
+char NarrowInt64ArithmeticPass::ID = 0;
+INITIALIZE_PASS(NarrowInt64ArithmeticPass, "NarrowInt64Arithmetic",
+                "Narrow 64-bit Integer Arithmetic Pass", false, false)
+
+namespace clspv {
+ModulePass *createAssumeInt64ArgRangesPass() {
+  return new AssumeInt64ArgRangesPass();
+}
+
+FunctionPass *createNarrowInt64ArithmeticPass() {
+  return new NarrowInt64ArithmeticPass();
+}
+} // namespace clspv
+
+bool AssumeInt64ArgRangesPass::runOnModule(Module &M) {
+  bool Changed = false;
+  for (const auto &entry : clspv::Option::Int64ArgRanges()) {
+    std::string kernel;
+    unsigned ordinal;
+    int64_t min, max;
+    if (!clspv::Option::ParseInt64ArgRange(entry, &kernel, &ordinal, &min,
+                                           &max))
+      continue;
+
+    auto *F = M.getFunction(kernel);
+    if (!F || F->isDeclaration() ||
+        F->getCallingConv() != CallingConv::SPIR_KERNEL ||
+        ordinal >= F->arg_size())
+      continue;
+    Value *Arg = F->getArg(ordinal);
+    if (!Arg->getType()->isIntegerTy(64))
+      continue;
+
+    // Only the low word is read when it holds the whole range. Kernels that
+    // are called, or whose argument is a specialization constant, keep their
+    // signature.
+    const bool is_signed = min >= INT32_MIN && max <= INT32_MAX;
+    const bool is_unsigned = min >= 0 && max <= UINT32_MAX;
+    if ((is_signed || is_unsigned) && F->use_empty() &&
+        !clspv::Option::IsPodSpecConstant(kernel, ordinal)) {
+      Arg = ReadLowWord(F, ordinal, is_signed);
+      F = cast<Instruction>(Arg)->getFunction();
+    }
+
+    IRBuilder<> Builder(&*F->getEntryBlock().getFirstInsertionPt());
+    if (auto *ArgInst = dyn_cast<Instruction>(Arg))
+      Builder.SetInsertPoint(ArgInst->getNextNode());
+    Builder.CreateAssumption(
+        Builder.CreateICmpSGE(Arg, Builder.getInt64(min)));
+    Builder.CreateAssumption(
+        Builder.CreateICmpSLE(Arg, Builder.getInt64(max)));
+    Changed = true;
+  }
+  return Changed;
+}
+
+Value *AssumeInt64ArgRangesPass::ReadLowWord(Function *F, unsigned ordinal,
+                                             bool is_signed) {
+  auto &C = F->getContext();
+  auto *FTy = F->getFunctionType();
+  SmallVector<Type *, 8> Params(FTy->param_begin(), FTy->param_end());
+  Params[ordinal] = FixedVectorType::get(Type::getInt32Ty(C), 2);
+  auto *NewFTy = FunctionType::get(FTy->getReturnType(), Params, false);
+
+  auto *NewF = Function::Create(NewFTy, F->getLinkage());
+  F->getParent()->getFunctionList().insert(F->getIterator(), NewF);
+  NewF->takeName(F);
+  NewF->setCallingConv(F->getCallingConv());
+  NewF->copyMetadata(F, 0);
+  // Attributes such as signext do not apply to the vector.
+  NewF->setAttributes(F->getAttributes().removeParamAttributes(C, ordinal));
+  NewF->getBasicBlockList().splice(NewF->begin(), F->getBasicBlockList());
+
+  Value *Result = nullptr;
+  for (unsigned i = 0; i < F->arg_size(); ++i) {
+    auto *Arg = F->getArg(i);
+    auto *NewArg = NewF->getArg(i);
+    NewArg->takeName(Arg);
+    if (i != ordinal) {
+      Arg->replaceAllUsesWith(NewArg);
+      continue;
+    }
+    IRBuilder<> Builder(&*NewF->getEntryBlock().getFirstInsertionPt());
+    auto *Low = Builder.CreateExtractElement(NewArg, uint64_t(0));
+    Result = is_signed ? Builder.CreateSExt(Low, Arg->getType())
+                       : Builder.CreateZExt(Low, Arg->getType());
+    Arg->replaceAllUsesWith(Result);
+  }
+  F->eraseFromParent();
+  return Result;
+}
+
+bool NarrowInt64ArithmeticPass::runOnFunction(Function &F) {
+  LVI = &getAnalysis<LazyValueInfoWrapperPass>().getLVI();
+
+  // Decide everything before changing the function, so that the analysis
+  // only sees the original instructions.
+  SmallVector<std::pair<Instruction *, Narrowing>, 16> Narrowed;
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  for (auto *BB : RPOT) {
+    for (auto &I : *BB) {
+      auto narrowing = GetNarrowing(&I);
+      if (narrowing != Narrowing::kNone)
+        Narrowed.emplace_back(&I, narrowing);
+    }
+  }
+
+  SmallVector<WeakTrackingVH, 16> MaybeDead;
+  SmallVector<std::pair<PHINode *, PHINode *>, 8> Phis;
+  SmallVector<Instruction *, 16> Extensions;
+  auto *Int32Ty = Type::getInt32Ty(F.getContext());
+  auto *Int64Ty = Type::getInt64Ty(F.getContext());
+  for (auto &entry : Narrowed) {
+    auto *I = entry.first;
+    const bool is_signed = entry.second == Narrowing::kSigned;
+    for (auto &Op : I->operands())
+      MaybeDead.push_back(Op.get());
+
+    Value *NewValue = nullptr;
+    IRBuilder<> Builder(I);
+    if (auto *Phi = dyn_cast<PHINode>(I)) {
+      // The incoming values are filled once all the instructions are
+      // narrowed, as some of them are defined later.
+      auto *NewPhi = Builder.CreatePHI(Int32Ty, Phi->getNumIncomingValues());
+      Phis.emplace_back(Phi, NewPhi);
+      Builder.SetInsertPoint(Phi->getParent()->getFirstNonPHI());
+      NewValue = NewPhi;
+    } else if (auto *Cmp = dyn_cast<ICmpInst>(I)) {
+      auto *NewCmp = Builder.CreateICmp(Cmp->getPredicate(),
+                                        GetNarrowValue(Cmp->getOperand(0), I),
+                                        GetNarrowValue(Cmp->getOperand(1), I));
+      NewCmp->takeName(Cmp);
+      Cmp->replaceAllUsesWith(NewCmp);
+      Cmp->eraseFromParent();
+      continue;
+    } else if (auto *Sel = dyn_cast<SelectInst>(I)) {
+      NewValue = Builder.CreateSelect(Sel->getCondition(),
+                                      GetNarrowValue(Sel->getTrueValue(), I),
+                                      GetNarrowValue(Sel->getFalseValue(), I));
+    } else {
+      // Wrapping flags do not hold at the narrow width.
+      NewValue = Builder.CreateBinOp(cast<BinaryOperator>(I)->getOpcode(),
+                                     GetNarrowValue(I->getOperand(0), I),
+                                     GetNarrowValue(I->getOperand(1), I));
+    }
+
+    if (isa<Instruction>(NewValue))
+      NewValue->takeName(I);
+    auto *Ext = is_signed ? Builder.CreateSExt(NewValue, Int64Ty)
+                          : Builder.CreateZExt(NewValue, Int64Ty);
+    if (auto *ExtInst = dyn_cast<Instruction>(Ext))
+      Extensions.push_back(ExtInst);
+    I->replaceAllUsesWith(Ext);
+    if (!isa<PHINode>(I))
+      I->eraseFromParent();
+  }
+
+  for (auto &entry : Phis) {
+    auto *Phi = entry.first;
+    for (unsigned i = 0; i < Phi->getNumIncomingValues(); ++i) {
+      auto *BB = Phi->getIncomingBlock(i);
+      entry.second->addIncoming(
+          GetNarrowValue(Phi->getIncomingValue(i), BB->getTerminator()), BB);
+    }
+    Phi->eraseFromParent();
+  }
+
+  // Truncations of the narrowed values now start from the 32-bit value.
+  for (auto *Ext : Extensions) {
+    auto *NewValue = Ext->getOperand(0);
+    for (auto *U : make_early_inc_range(Ext->users())) {
+      auto *Trunc = dyn_cast<TruncInst>(U);
+      if (!Trunc || Trunc->getType()->getIntegerBitWidth() > 32)
+        continue;
+      Value *Replacement = NewValue;
+      if (Trunc->getType() != Int32Ty)
+        Replacement =
+            IRBuilder<>(Trunc).CreateTrunc(NewValue, Trunc->getType());
+      Replacement->takeName(Trunc);
+      Trunc->replaceAllUsesWith(Replacement);
+      Trunc->eraseFromParent();
+    }
+    MaybeDead.push_back(Ext);
+  }
+
+  // The ranges of -int64-arg-range are no longer needed.
+  bool RemovedAssumptions = false;
+  for (auto &BB : F) {
+    for (auto &I : make_early_inc_range(BB)) {
+      if (auto *II = dyn_cast<IntrinsicInst>(&I)) {
+        if (II->getIntrinsicID() == Intrinsic::assume) {
+          MaybeDead.push_back(II->getArgOperand(0));
+          II->eraseFromParent();
+          RemovedAssumptions = true;
+        }
+      }
+    }
+  }
+
+  for (auto &V : MaybeDead) {
+    if (auto *I = dyn_cast_or_null<Instruction>(V))
+      RecursivelyDeleteTriviallyDeadInstructions(I);
+  }
+
+  return !Narrowed.empty() || RemovedAssumptions;
+}
+
+Narrowing NarrowInt64ArithmeticPass::GetNarrowing(Instruction *inst) {
+  if (auto *Cmp = dyn_cast<ICmpInst>(inst)) {
+    if (!Cmp->getOperand(0)->getType()->isIntegerTy(64))
+      return Narrowing::kNone;
+    auto LHS = GetRange(Cmp->getOperand(0), inst);
+    auto RHS = GetRange(Cmp->getOperand(1), inst);
+    const bool Signed = FitsSigned(LHS) && FitsSigned(RHS);
+    const bool Unsigned = FitsUnsigned(LHS) && FitsUnsigned(RHS);
+    // Comparisons produce no 64-bit value, so only the operands matter.
+    if ((Cmp->isEquality() && (Signed || Unsigned)) ||
+        (Cmp->isSigned() && Signed))
+      return Narrowing::kSigned;
+    if (Cmp->isUnsigned() && Unsigned)
+      return Narrowing::kUnsigned;
+    return Narrowing::kNone;
+  }
+
+  if (!inst->getType()->isIntegerTy(64))
+    return Narrowing::kNone;
+  auto Result = GetRange(inst, inst);
+  const bool ResultSigned = FitsSigned(Result);
+  const bool ResultUnsigned = FitsUnsigned(Result);
+  if (!ResultSigned && !ResultUnsigned)
+    return Narrowing::kNone;
+
+  // Phis and selects only forward one of their values, which is then in the
+  // range of the result.
+  if (isa<PHINode>(inst) || isa<SelectInst>(inst))
+    return ResultSigned ? Narrowing::kSigned : Narrowing::kUnsigned;
+
+  auto *BinOp = dyn_cast<BinaryOperator>(inst);
+  if (!BinOp)
+    return Narrowing::kNone;
+  auto LHS = GetRange(BinOp->getOperand(0), inst);
+  auto RHS = GetRange(BinOp->getOperand(1), inst);
+  const bool Signed = ResultSigned && FitsSigned(LHS) && FitsSigned(RHS);
+  const bool Unsigned =
+      ResultUnsigned && FitsUnsigned(LHS) && FitsUnsigned(RHS);
+
+  switch (BinOp->getOpcode()) {
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+    // The shift amount must stay below the narrow width.
+    if (RHS.getUnsignedMax().uge(32))
+      return Narrowing::kNone;
+    break;
+  case Instruction::SDiv:
+  case Instruction::SRem:
+    // INT_MIN / -1 overflows at 32 bits, and the remainder is undefined.
+    if (LHS.contains(APInt(64, INT32_MIN, true)) &&
+        RHS.contains(APInt(64, -1, true)))
+      return Narrowing::kNone;
+    break;
+  default:
+    break;
+  }
+
+  switch (BinOp->getOpcode()) {
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::Shl:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+    if (Signed)
+      return Narrowing::kSigned;
+    if (Unsigned)
+      return Narrowing::kUnsigned;
+    break;
+  case Instruction::SDiv:
+  case Instruction::SRem:
+  case Instruction::AShr:
+    if (Signed)
+      return Narrowing::kSigned;
+    break;
+  case Instruction::UDiv:
+  case Instruction::URem:
+  case Instruction::LShr:
+    if (Unsigned)
+      return Narrowing::kUnsigned;
+    break;
+  default:
+    break;
+  }
+  return Narrowing::kNone;
+}
+
+ConstantRange NarrowInt64ArithmeticPass::GetRange(Value *v,
+                                                  Instruction *context) {
+  return LVI->getConstantRange(v, context);
+}
+
+Value *NarrowInt64ArithmeticPass::GetNarrowValue(Value *v,
+                                                 Instruction *insert_before) {
+  auto *Int32Ty = Type::getInt32Ty(v->getContext());
+  if (auto *C = dyn_cast<Constant>(v))
+    return ConstantExpr::getTrunc(C, Int32Ty);
+
+  // Narrowed instructions and the arguments of the expression are extended
+  // from at most 32 bits.
+  if (isa<SExtInst>(v) || isa<ZExtInst>(v)) {
+    auto *Src = cast<CastInst>(v)->getOperand(0);
+    if (Src->getType() == Int32Ty)
+      return Src;
+    if (Src->getType()->getIntegerBitWidth() < 32) {
+      IRBuilder<> Builder(insert_before);
+      return isa<SExtInst>(v) ? Builder.CreateSExt(Src, Int32Ty)
+                              : Builder.CreateZExt(Src, Int32Ty);
+    }
+  }
+
+  return IRBuilder<>(insert_before).CreateTrunc(v, Int32Ty);
+}
@@ -0,0 +1,179 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Computes truncated integer arithmetic at the narrow width. OpenCL C
+// promotes char and short operands to int, and several clspv passes run
+// after the last instcombine, so expressions such as
+//   %r = trunc (add (sext i8 %a to i32), (sext i8 %b to i32)) to i8
+// reach the SPIR-V producer as 32-bit arithmetic. The low bits of add, sub,
+// mul, the bitwise operations and shifts by a constant only depend on the
+// low bits of their operands, so the whole expression can be evaluated as
+//   %r = add i8 %a, %b
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Pass.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+#include "clspv/Option.h"
+
+#include "Passes.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "NarrowIntegerArithmetic"
+
+namespace {
+struct NarrowIntegerArithmeticPass : public ModulePass {
+  static char ID;
+  NarrowIntegerArithmeticPass() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override;
+
+private:
+  // Returns true if |v| can be computed in |ty|, which is narrower than the
+  // type of |v|, without affecting any other user of the values involved.
+  bool CanNarrow(Value *v, Type *ty);
+
+  // Returns |v| computed in |ty|. New instructions are inserted by |builder|.
+  Value *Narrow(Value *v, Type *ty, IRBuilder<> &builder);
+};
+} // namespace
+
+char NarrowIntegerArithmeticPass::ID = 0;
+INITIALIZE_PASS(NarrowIntegerArithmeticPass, "NarrowIntegerArithmetic",
+                "Narrow Integer Arithmetic Pass", false, false)
+
+namespace clspv {
+ModulePass *createNarrowIntegerArithmeticPass() {
+  return new NarrowIntegerArithmeticPass();
+}
+} // namespace clspv
+
+bool NarrowIntegerArithmeticPass::runOnModule(Module &M) {
+  // Narrowing one expression can delete truncations that are leaves of it.
+  SmallVector<WeakVH, 16> WorkList;
+  for (auto &F : M) {
+    for (auto &BB : F) {
+      for (auto &I : BB) {
+        auto *trunc = dyn_cast<TruncInst>(&I);
+        if (!trunc)
+          continue;
+        const auto width = trunc->getType()->getScalarSizeInBits();
+        if ((width == 8 && clspv::Option::Int8Support()) || width == 16)
+          WorkList.push_back(trunc);
+      }
+    }
+  }
+
+  bool Changed = false;
+  for (auto &handle : WorkList) {
+    auto *trunc = cast_or_null<TruncInst>(handle);
+    if (!trunc)
+      continue;
+
+    // A trunc of an extension or of another trunc is left to instcombine;
+    // only arithmetic is worth narrowing here.
+    auto *src = trunc->getOperand(0);
+    if (!isa<BinaryOperator>(src) && !isa<SelectInst>(src))
+      continue;
+    if (!CanNarrow(src, trunc->getType()))
+      continue;
+
+    IRBuilder<> builder(trunc);
+    auto *narrow = Narrow(src, trunc->getType(), builder);
+    if (isa<Instruction>(narrow))
+      narrow->takeName(trunc);
+    trunc->replaceAllUsesWith(narrow);
+    trunc->eraseFromParent();
+    RecursivelyDeleteTriviallyDeadInstructions(src);
+    Changed = true;
+  }
+
+  return Changed;
+}
+
+bool NarrowIntegerArithmeticPass::CanNarrow(Value *v, Type *ty) {
+  if (isa<Constant>(v))
+    return true;
+
+  // Extensions and truncations are the leaves of the expression. Their
+  // operand is reused, so they may have other users.
+  if (isa<ZExtInst>(v) || isa<SExtInst>(v) || isa<TruncInst>(v))
+    return true;
+
+  auto *inst = dyn_cast<Instruction>(v);
+  if (!inst || !inst->hasOneUse())
+    return false;
+
+  switch (inst->getOpcode()) {
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+    return CanNarrow(inst->getOperand(0), ty) &&
+           CanNarrow(inst->getOperand(1), ty);
+  case Instruction::Shl: {
+    // The shift amount must be known to be less than the narrow width.
+    auto *shift = dyn_cast<Constant>(inst->getOperand(1));
+    if (shift && shift->getType()->isVectorTy())
+      shift = shift->getSplatValue();
+    auto *amount = dyn_cast_or_null<ConstantInt>(shift);
+    return amount && amount->getValue().ult(ty->getScalarSizeInBits()) &&
+           CanNarrow(inst->getOperand(0), ty);
+  }
+  case Instruction::Select:
+    return CanNarrow(inst->getOperand(1), ty) &&
+           CanNarrow(inst->getOperand(2), ty);
+  default:
+    break;
+  }
+  return false;
+}
+
+Value *NarrowIntegerArithmeticPass::Narrow(Value *v, Type *ty,
+                                           IRBuilder<> &builder) {
+  if (auto *c = dyn_cast<Constant>(v))
+    return ConstantExpr::getTrunc(c, ty);
+
+  if (auto *cast_inst = dyn_cast<CastInst>(v)) {
+    auto *src = cast_inst->getOperand(0);
+    const auto src_width = src->getType()->getScalarSizeInBits();
+    const auto width = ty->getScalarSizeInBits();
+    if (src_width == width)
+      return src;
+    if (src_width > width)
+      return builder.CreateTrunc(src, ty);
+    return isa<SExtInst>(cast_inst) ? builder.CreateSExt(src, ty)
+                                    : builder.CreateZExt(src, ty);
+  }
+
+  auto *inst = cast<Instruction>(v);
+  if (auto *sel = dyn_cast<SelectInst>(inst)) {
+    auto *true_value = Narrow(sel->getTrueValue(), ty, builder);
+    auto *false_value = Narrow(sel->getFalseValue(), ty, builder);
+    return builder.CreateSelect(sel->getCondition(), true_value, false_value);
+  }
+
+  // Wrapping flags do not hold at the narrow width.
+  auto *lhs = Narrow(inst->getOperand(0), ty, builder);
+  auto *rhs = Narrow(inst->getOperand(1), ty, builder);
+  return builder.CreateBinOp(cast<BinaryOperator>(inst)->getOpcode(), lhs,
+                             rhs);
+}
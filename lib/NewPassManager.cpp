@@ -0,0 +1,118 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Support for running clspv passes with the new pass manager.
+//
+// The stock LLVM optimizations come from PassBuilder, so that the analyses
+// are cached and invalidated precisely between its passes. Only the LLVM
+// optimizations run in the new pass manager in the driver; the clspv passes
+// around them still run in its legacy pipeline. The clspv passes
+// that use the dominator tree and loop info have a new pass manager version
+// sharing those analyses. The other clspv passes can be scheduled in a new
+// pass manager pipeline through LegacyPassAdaptor, as legacy<PassName>.
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Analysis/CGSCCPassManager.h"
+#include "llvm/Analysis/LoopAnalysisManager.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Pass.h"
+#include "llvm/PassRegistry.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Transforms/IPO/GlobalOpt.h"
+#include "llvm/Transforms/IPO/SCCP.h"
+
+#include "clspv/Passes.h"
+
+#include "NewPassManager.h"
+
+using namespace llvm;
+
+namespace clspv {
+
+void RunDefaultPipeline(Module &M, unsigned opt_level, unsigned size_level) {
+  // Like PassManagerBuilder, no optimization is done at -O0.
+  if (opt_level == 0 && size_level == 0)
+    return;
+
+  auto Level = PassBuilder::OptimizationLevel::O2;
+  if (size_level == 1)
+    Level = PassBuilder::OptimizationLevel::Os;
+  else if (size_level >= 2)
+    Level = PassBuilder::OptimizationLevel::Oz;
+  else if (opt_level == 1)
+    Level = PassBuilder::OptimizationLevel::O1;
+  else if (opt_level >= 3)
+    Level = PassBuilder::OptimizationLevel::O3;
+
+  LoopAnalysisManager LAM;
+  FunctionAnalysisManager FAM;
+  CGSCCAnalysisManager CGAM;
+  ModuleAnalysisManager MAM;
+  PassBuilder PB;
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  // The default pipeline of PassBuilder would run the LLVM inliner, which the
+  // PassManagerBuilder pipeline never did: clspv decides what to inline in
+  // its own passes, before this pipeline. So the simplification passes run on
+  // each function without the inliner, followed by the optimization pipeline.
+  ModulePassManager MPM;
+  MPM.addPass(IPSCCPPass());
+  MPM.addPass(GlobalOptPass());
+  MPM.addPass(createModuleToFunctionPassAdaptor(
+      PB.buildFunctionSimplificationPipeline(Level,
+                                             ThinOrFullLTOPhase::None)));
+  MPM.addPass(PB.buildModuleOptimizationPipeline(Level));
+  MPM.run(M, MAM);
+}
+
+PreservedAnalyses LegacyPassAdaptor::run(Module &M, ModuleAnalysisManager &) {
+  legacy::PassManager PM;
+  PM.add(Info->createPass());
+  return PM.run(M) ? PreservedAnalyses::none() : PreservedAnalyses::all();
+}
+
+void registerNewPMPasses(PassBuilder &PB) {
+  PB.registerPipelineParsingCallback(
+      [](StringRef Name, FunctionPassManager &FPM,
+         ArrayRef<PassBuilder::PipelineElement>) {
+        if (Name == "FixupStructuredCFG") {
+          FPM.addPass(FixupStructuredCFGPass());
+          return true;
+        }
+        if (Name == "ReorderBasicBlocks") {
+          FPM.addPass(ReorderBasicBlocksPass());
+          return true;
+        }
+        return false;
+      });
+  PB.registerPipelineParsingCallback(
+      [](StringRef Name, ModulePassManager &MPM,
+         ArrayRef<PassBuilder::PipelineElement>) {
+        if (!Name.consume_front("legacy<") || !Name.consume_back(">"))
+          return false;
+        auto *Info = PassRegistry::getPassRegistry()->getPassInfo(Name);
+        if (!Info || !Info->getNormalCtor())
+          return false;
+        MPM.addPass(LegacyPassAdaptor(Info));
+        return true;
+      });
+}
+
+} // namespace clspv
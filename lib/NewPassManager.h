@@ -0,0 +1,65 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_LIB_NEW_PASS_MANAGER_H_
+#define CLSPV_LIB_NEW_PASS_MANAGER_H_
+
+#include "llvm/IR/PassManager.h"
+
+namespace llvm {
+class PassInfo;
+} // namespace llvm
+
+namespace clspv {
+
+// Runs the LLVM optimization pipeline of PassBuilder on |M|, without the
+// LLVM inliner. |opt_level| and |size_level| have the meaning they have for
+// -O: a non-zero |size_level| selects -Os or -Oz.
+void RunDefaultPipeline(llvm::Module &M, unsigned opt_level,
+                        unsigned size_level);
+
+// New pass manager version of the pass created by
+// createFixupStructuredCFGPass. The dominator tree and loop info are taken
+// from the analysis manager and kept up to date.
+struct FixupStructuredCFGPass
+    : public llvm::PassInfoMixin<FixupStructuredCFGPass> {
+  llvm::PreservedAnalyses run(llvm::Function &F,
+                              llvm::FunctionAnalysisManager &FAM);
+};
+
+// New pass manager version of the pass created by
+// createReorderBasicBlocksPass. Preserves the analyses of the CFG.
+struct ReorderBasicBlocksPass
+    : public llvm::PassInfoMixin<ReorderBasicBlocksPass> {
+  llvm::PreservedAnalyses run(llvm::Function &F,
+                              llvm::FunctionAnalysisManager &FAM);
+};
+
+// Runs the legacy pass described by |Info| in a new pass manager pipeline.
+// The legacy pass computes the analyses it requires itself, and all the
+// analyses of the module are invalidated when it changes it.
+class LegacyPassAdaptor : public llvm::PassInfoMixin<LegacyPassAdaptor> {
+public:
+  explicit LegacyPassAdaptor(const llvm::PassInfo *Info) : Info(Info) {}
+
+  llvm::PreservedAnalyses run(llvm::Module &M,
+                              llvm::ModuleAnalysisManager &MAM);
+
+private:
+  const llvm::PassInfo *Info;
+};
+
+} // namespace clspv
+
+#endif // CLSPV_LIB_NEW_PASS_MANAGER_H_
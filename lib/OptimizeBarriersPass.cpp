@@ -0,0 +1,384 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Cheapens the OpControlBarrier and OpMemoryBarrier ReplaceOpenCLBuiltinPass
+// produces for barrier, work_group_barrier and the mem_fence builtins.
+//
+// The memory semantics of a barrier only need the storage classes written by
+// the kernels executing it: a kernel that never writes __local memory does not
+// need WorkgroupMemory, one that never writes __global memory does not need
+// UniformMemory and one that never writes an image does not need ImageMemory.
+// A memory barrier left without storage classes is removed, a control barrier
+// is kept as an execution barrier.
+//
+// Consecutive barriers of a block with no access to shared memory between them
+// are then merged into one with the union of their semantics.
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+#include "spirv/unified1/spirv.hpp"
+
+#include "clspv/AddressSpace.h"
+
+#include "Builtins.h"
+#include "Passes.h"
+#include "Types.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "OptimizeBarriers"
+
+STATISTIC(NumBarriersMerged, "Number of barriers merged into another one");
+STATISTIC(NumBarriersNarrowed, "Number of barriers with narrowed semantics");
+
+namespace {
+
+// The storage classes of the memory semantics this pass narrows.
+const uint32_t kNarrowedSemantics = spv::MemorySemanticsUniformMemoryMask |
+                                    spv::MemorySemanticsWorkgroupMemoryMask |
+                                    spv::MemorySemanticsImageMemoryMask;
+
+// All the storage classes of the memory semantics.
+const uint32_t kStorageClassSemantics =
+    kNarrowedSemantics | spv::MemorySemanticsSubgroupMemoryMask |
+    spv::MemorySemanticsCrossWorkgroupMemoryMask |
+    spv::MemorySemanticsAtomicCounterMemoryMask;
+
+// The memory ordering bits of the memory semantics, of which SPIR-V allows at
+// most one.
+const uint32_t kOrderingSemantics =
+    spv::MemorySemanticsAcquireMask | spv::MemorySemanticsReleaseMask |
+    spv::MemorySemanticsAcquireReleaseMask |
+    spv::MemorySemanticsSequentiallyConsistentMask;
+
+// Returns the union of the memory semantics |a| and |b|, with their orderings
+// collapsed to the weakest one at least as strong as both.
+uint32_t MergeSemantics(uint32_t a, uint32_t b) {
+  const uint32_t merged = a | b;
+  const uint32_t ordering = merged & kOrderingSemantics;
+  uint32_t strongest = ordering;
+  if (ordering & spv::MemorySemanticsSequentiallyConsistentMask) {
+    strongest = spv::MemorySemanticsSequentiallyConsistentMask;
+  } else if ((ordering & spv::MemorySemanticsAcquireReleaseMask) ||
+             ((ordering & spv::MemorySemanticsAcquireMask) &&
+              (ordering & spv::MemorySemanticsReleaseMask))) {
+    strongest = spv::MemorySemanticsAcquireReleaseMask;
+  }
+  return (merged & ~kOrderingSemantics) | strongest;
+}
+
+struct OptimizeBarriersPass : public ModulePass {
+  static char ID;
+  OptimizeBarriersPass() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override;
+
+private:
+  // Returns the memory semantics of the storage classes the instructions of
+  // |F| write, not counting the functions it calls.
+  uint32_t WrittenSemantics(Function &F);
+
+  // Removes the storage classes not in |needed| from the semantics of the
+  // barriers of |F|.
+  bool NarrowBarriers(Function &F, uint32_t needed);
+
+  // Merges the consecutive barriers of |F|.
+  bool MergeBarriers(Function &F);
+};
+
+// Returns the opcode of |I| if it is an OpControlBarrier or an
+// OpMemoryBarrier, and OpNop otherwise.
+spv::Op GetBarrierOpcode(const Instruction &I) {
+  auto *call = dyn_cast<CallInst>(&I);
+  if (!call || !call->getCalledFunction())
+    return spv::OpNop;
+  auto &info = clspv::Builtins::Lookup(call->getCalledFunction());
+  if (info.getType() != clspv::Builtins::kSpirvOp)
+    return spv::OpNop;
+  auto opcode = static_cast<spv::Op>(
+      cast<ConstantInt>(call->getArgOperand(0))->getZExtValue());
+  if (opcode == spv::OpControlBarrier || opcode == spv::OpMemoryBarrier)
+    return opcode;
+  return spv::OpNop;
+}
+
+unsigned MemoryScopeOperand(spv::Op opcode) {
+  return opcode == spv::OpControlBarrier ? 2 : 1;
+}
+
+unsigned SemanticsOperand(spv::Op opcode) {
+  return opcode == spv::OpControlBarrier ? 3 : 2;
+}
+
+// Returns the memory semantics of the storage class of pointers in
+// |addr_space| that barriers order.
+uint32_t AddressSpaceSemantics(unsigned addr_space) {
+  switch (addr_space) {
+  case clspv::AddressSpace::Global:
+    return spv::MemorySemanticsUniformMemoryMask;
+  case clspv::AddressSpace::Local:
+    return spv::MemorySemanticsWorkgroupMemoryMask;
+  case clspv::AddressSpace::Generic:
+    return spv::MemorySemanticsUniformMemoryMask |
+           spv::MemorySemanticsWorkgroupMemoryMask;
+  default:
+    // Other memory is either private to the invocation or read-only.
+    return 0;
+  }
+}
+
+// Returns true if |I| may access memory shared with other invocations.
+bool MayAccessSharedMemory(const Instruction &I) {
+  if (!I.mayReadOrWriteMemory())
+    return false;
+  const Value *ptr = nullptr;
+  if (auto *load = dyn_cast<LoadInst>(&I))
+    ptr = load->getPointerOperand();
+  else if (auto *store = dyn_cast<StoreInst>(&I))
+    ptr = store->getPointerOperand();
+  else
+    return true;
+  return AddressSpaceSemantics(ptr->getType()->getPointerAddressSpace()) != 0;
+}
+} // namespace
+
+char OptimizeBarriersPass::ID = 0;
+INITIALIZE_PASS(OptimizeBarriersPass, "OptimizeBarriers",
+                "Optimize Barriers Pass", false, false)
+
+namespace clspv {
+ModulePass *createOptimizeBarriersPass() { return new OptimizeBarriersPass(); }
+} // namespace clspv
+
+bool OptimizeBarriersPass::runOnModule(Module &M) {
+  DenseMap<Function *, uint32_t> written;
+  for (auto &F : M) {
+    if (!F.isDeclaration())
+      written[&F] = WrittenSemantics(F);
+  }
+
+  // A barrier orders the accesses of the whole call tree of the kernels that
+  // reach it, so it needs the storage classes any of them write.
+  DenseMap<Function *, uint32_t> needed;
+  for (auto &F : M) {
+    if (F.isDeclaration() || F.getCallingConv() != CallingConv::SPIR_KERNEL)
+      continue;
+
+    SetVector<Function *> call_tree;
+    call_tree.insert(&F);
+    uint32_t kernel_written = 0;
+    for (unsigned i = 0; i < call_tree.size(); ++i) {
+      auto *fn = call_tree[i];
+      kernel_written |= written[fn];
+      for (auto &BB : *fn) {
+        for (auto &I : BB) {
+          auto *call = dyn_cast<CallInst>(&I);
+          if (!call)
+            continue;
+          auto *callee = call->getCalledFunction();
+          if (callee && !callee->isDeclaration())
+            call_tree.insert(callee);
+        }
+      }
+    }
+
+    for (auto *fn : call_tree) {
+      needed[fn] |= kernel_written;
+    }
+  }
+
+  bool changed = false;
+  for (auto &entry : needed) {
+    changed |= NarrowBarriers(*entry.first, entry.second);
+  }
+  for (auto &F : M) {
+    if (!F.isDeclaration())
+      changed |= MergeBarriers(F);
+  }
+
+  return changed;
+}
+
+uint32_t OptimizeBarriersPass::WrittenSemantics(Function &F) {
+  uint32_t semantics = 0;
+  for (auto &BB : F) {
+    for (auto &I : BB) {
+      // Following pointers does not write memory.
+      if (isa<LoadInst>(I) || isa<GetElementPtrInst>(I) || isa<PHINode>(I) ||
+          isa<SelectInst>(I) || isa<CmpInst>(I) ||
+          (isa<CastInst>(I) && !isa<PtrToIntInst>(I)))
+        continue;
+
+      auto *call = dyn_cast<CallInst>(&I);
+      if (call && call->getCalledFunction()) {
+        auto *callee = call->getCalledFunction();
+        // The callee accounts for what it does with its arguments.
+        if (!callee->isDeclaration())
+          continue;
+        auto type = clspv::Builtins::Lookup(callee).getType();
+        if (type == clspv::Builtins::kWriteImagef ||
+            type == clspv::Builtins::kWriteImagei ||
+            type == clspv::Builtins::kWriteImageui ||
+            type == clspv::Builtins::kWriteImageh) {
+          semantics |= spv::MemorySemanticsImageMemoryMask;
+          continue;
+        }
+        if (type > clspv::Builtins::kType_Image_Start &&
+            type < clspv::Builtins::kType_Image_End)
+          continue;
+      }
+
+      for (auto &op : I.operands()) {
+        auto *ty = op->getType();
+        if (clspv::IsImageType(ty))
+          semantics |= spv::MemorySemanticsImageMemoryMask;
+        else if (ty->isPointerTy())
+          semantics |= AddressSpaceSemantics(ty->getPointerAddressSpace());
+      }
+    }
+  }
+  return semantics;
+}
+
+bool OptimizeBarriersPass::NarrowBarriers(Function &F, uint32_t needed) {
+  const uint32_t unused = kNarrowedSemantics & ~needed;
+  if (!unused)
+    return false;
+
+  bool changed = false;
+  SmallVector<Instruction *, 4> to_remove;
+  for (auto &BB : F) {
+    for (auto &I : BB) {
+      auto opcode = GetBarrierOpcode(I);
+      if (opcode == spv::OpNop)
+        continue;
+
+      auto *call = cast<CallInst>(&I);
+      auto *semantics =
+          dyn_cast<ConstantInt>(call->getArgOperand(SemanticsOperand(opcode)));
+      if (!semantics || !(semantics->getZExtValue() & unused))
+        continue;
+
+      uint32_t narrowed = semantics->getZExtValue() & ~unused;
+      // Without storage classes an ordering has nothing to order.
+      if (!(narrowed & kStorageClassSemantics)) {
+        if (opcode == spv::OpMemoryBarrier) {
+          to_remove.push_back(call);
+          continue;
+        }
+        narrowed = spv::MemorySemanticsMaskNone;
+      }
+      call->setArgOperand(SemanticsOperand(opcode),
+                          ConstantInt::get(semantics->getType(), narrowed));
+      ++NumBarriersNarrowed;
+      changed = true;
+    }
+  }
+
+  for (auto *inst : to_remove) {
+    inst->eraseFromParent();
+    ++NumBarriersNarrowed;
+    changed = true;
+  }
+  return changed;
+}
+
+bool OptimizeBarriersPass::MergeBarriers(Function &F) {
+  bool changed = false;
+  SmallVector<Instruction *, 4> to_remove;
+  for (auto &BB : F) {
+    // The last barrier of the block with no access to shared memory since.
+    CallInst *prev = nullptr;
+    for (auto &I : BB) {
+      auto opcode = GetBarrierOpcode(I);
+      if (opcode == spv::OpNop) {
+        if (MayAccessSharedMemory(I))
+          prev = nullptr;
+        continue;
+      }
+
+      auto *call = cast<CallInst>(&I);
+      if (!prev) {
+        prev = call;
+        continue;
+      }
+
+      // Merge into a control barrier if either is one, as an execution barrier
+      // cannot be removed.
+      auto prev_opcode = GetBarrierOpcode(*prev);
+      auto *into = prev;
+      auto *from = call;
+      auto into_opcode = prev_opcode;
+      auto from_opcode = opcode;
+      if (opcode == spv::OpControlBarrier &&
+          prev_opcode == spv::OpMemoryBarrier) {
+        std::swap(into, from);
+        std::swap(into_opcode, from_opcode);
+      }
+      prev = into;
+
+      if (into_opcode == spv::OpControlBarrier &&
+          from_opcode == spv::OpControlBarrier &&
+          into->getArgOperand(1) != from->getArgOperand(1)) {
+        prev = call;
+        continue;
+      }
+
+      auto *into_scope = dyn_cast<ConstantInt>(
+          into->getArgOperand(MemoryScopeOperand(into_opcode)));
+      auto *from_scope = dyn_cast<ConstantInt>(
+          from->getArgOperand(MemoryScopeOperand(from_opcode)));
+      auto *into_semantics = dyn_cast<ConstantInt>(
+          into->getArgOperand(SemanticsOperand(into_opcode)));
+      auto *from_semantics = dyn_cast<ConstantInt>(
+          from->getArgOperand(SemanticsOperand(from_opcode)));
+      if (!into_scope || !from_scope || !into_semantics || !from_semantics ||
+          into_scope->getZExtValue() > spv::ScopeInvocation ||
+          from_scope->getZExtValue() > spv::ScopeInvocation) {
+        prev = call;
+        continue;
+      }
+
+      // Scopes from CrossDevice to Invocation get narrower as they increase.
+      // The scope of a barrier without semantics does not matter.
+      auto *scope = into_scope;
+      if (!into_semantics->isZero() && !from_semantics->isZero())
+        scope = into_scope->getZExtValue() < from_scope->getZExtValue()
+                    ? into_scope
+                    : from_scope;
+      else if (into_semantics->isZero())
+        scope = from_scope;
+      into->setArgOperand(MemoryScopeOperand(into_opcode), scope);
+      into->setArgOperand(
+          SemanticsOperand(into_opcode),
+          ConstantInt::get(into_semantics->getType(),
+                           MergeSemantics(into_semantics->getZExtValue(),
+                                          from_semantics->getZExtValue())));
+      to_remove.push_back(from);
+      ++NumBarriersMerged;
+      changed = true;
+    }
+  }
+
+  for (auto *inst : to_remove) {
+    inst->eraseFromParent();
+  }
+  return changed;
+}
@@ -14,9 +14,13 @@
 
 // This translation unit defines all Clspv command line option variables.
 
+#include "llvm/ADT/StringRef.h"
 #include "llvm/PassRegistry.h"
 #include "llvm/Support/CommandLine.h"
 
+#include <tuple>
+#include <vector>
+
 #include "Passes.h"
 #include "clspv/Option.h"
 
@@ -199,6 +203,13 @@ static llvm::cl::opt<bool> global_offset_push_constant(
     "global-offset-push-constant", llvm::cl::init(false),
     llvm::cl::desc("Enable support for global offsets in push constants"));
 
+static llvm::cl::opt<bool> uniform_ndrange_variants(
+    "uniform-ndrange-variants", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Also emit a variant of every kernel that uses the global offset or "
+        "non-uniform NDRange push constants, named <kernel>.uniform, that "
+        "assumes a zero global offset and a uniform NDRange."));
+
 static bool use_sampler_map = false;
 
 static llvm::cl::opt<bool> cluster_non_pointer_kernel_args(
@@ -232,52 +243,999 @@ static llvm::cl::list<clspv::Option::StorageClass> no_8bit_storage(
         clEnumValN(clspv::Option::StorageClass::kPushConstant, "pushconstant",
                    "Disallow 8-bit types in push constant interfaces")));
 
+static llvm::cl::opt<bool> stream_functions(
+    "stream-functions", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Encode each function to SPIR-V words as soon as its body and deferred "
+        "instructions are complete, and release its intermediate instructions. "
+        "This lowers peak memory for large modules. Result IDs may be numbered "
+        "differently."));
+
+static llvm::cl::opt<bool> lean_memory(
+    "lean-memory", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Lower peak memory: release the frontend as soon as it has produced "
+        "the module, do not keep the names of local values, and free the IR "
+        "of each function once the SPIR-V producer has encoded it. Implies "
+        "-stream-functions."));
+
+static llvm::cl::opt<bool> canonical_ids(
+    "canonical-ids", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Renumber the IDs of the SPIR-V module in the order they first appear, "
+        "so that identical inputs produce byte-identical output whatever the "
+        "order in which the IDs were allocated."));
+
+static llvm::cl::opt<bool> optimize_barriers(
+    "optimize-barriers", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Narrow the memory semantics of barriers and memory fences to the "
+        "storage classes written by the kernels executing them, and merge "
+        "barriers with no shared memory access between them."));
+
+static llvm::cl::list<std::string> entry_points(
+    "entry-points",
+    llvm::cl::desc("Only compile the listed kernels. The other kernels are "
+                   "removed right after the frontend, together with the "
+                   "functions only they use."),
+    llvm::cl::CommaSeparated, llvm::cl::ZeroOrMore,
+    llvm::cl::value_desc("kernel,..."));
+
+static llvm::cl::list<std::string> fuse_kernels(
+    "fuse-kernels",
+    llvm::cl::desc(
+        "Fuse two kernels run back to back over the same NDRange into a new "
+        "kernel named first_second, which runs the body of the first kernel "
+        "and then the body of the second. The given __global pointer "
+        "arguments of the two kernels become a single argument. Each "
+        "invocation must only access that buffer at its get_global_id."),
+    llvm::cl::CommaSeparated, llvm::cl::ZeroOrMore,
+    llvm::cl::value_desc("first:ordinal:second:ordinal,..."));
+
+static llvm::cl::list<std::string> local_arg_sizes(
+    "local-arg-size",
+    llvm::cl::desc(
+        "Size in bytes of a __local pointer argument of a kernel, given by its "
+        "ordinal. The argument is backed by a Workgroup array of that size "
+        "instead of one sized by a specialization constant, and is left out "
+        "of the reflection."),
+    llvm::cl::CommaSeparated, llvm::cl::ZeroOrMore,
+    llvm::cl::value_desc("kernel:ordinal:bytes,..."));
+
+static llvm::cl::list<std::string> int64_arg_ranges(
+    "int64-arg-range",
+    llvm::cl::desc(
+        "Inclusive range of the values of a 64-bit integer argument of a "
+        "kernel, given by its ordinal. Used by -narrow-int64-arithmetic."),
+    llvm::cl::CommaSeparated, llvm::cl::ZeroOrMore,
+    llvm::cl::value_desc("kernel:ordinal:min:max,..."));
+
+static llvm::cl::list<std::string> pod_spec_constants(
+    "pod-spec-constants",
+    llvm::cl::desc(
+        "POD arguments of kernels, given by their ordinal, whose value is read "
+        "from a specialization constant instead of the argument, so it can be "
+        "folded when the pipeline is created. The arguments keep their POD "
+        "slot and the spec ids are reported in the reflection."),
+    llvm::cl::CommaSeparated, llvm::cl::ZeroOrMore,
+    llvm::cl::value_desc("kernel:ordinal,..."));
+
+static llvm::cl::opt<unsigned> long_vector_chunk_width(
+    "long-vector-chunk-width", llvm::cl::init(1),
+    llvm::cl::desc(
+        "With -long-vector, lower vectors of 8 and 16 elements to structs of "
+        "vectors of this many elements (2 or 4) instead of structs of "
+        "scalars, so that arithmetic, loads and stores stay vectorized. The "
+        "default of 1 lowers to scalars."));
+
+static llvm::cl::list<unsigned> local_size(
+    "local-size",
+    llvm::cl::desc(
+        "Specialize the program for the given local size. Kernels without a "
+        "reqd_work_group_size attribute are compiled as if they had one with "
+        "this size, and get_local_size and get_enqueued_local_size are folded "
+        "to constants."),
+    llvm::cl::CommaSeparated, llvm::cl::ZeroOrMore,
+    llvm::cl::value_desc("x,y,z"));
+
+static llvm::cl::opt<unsigned> inline_cost_threshold(
+    "inline-cost-threshold", llvm::cl::init(0),
+    llvm::cl::desc(
+        "Inline calls to functions whose estimated cost, their instruction "
+        "count less a bonus for each constant argument, is at most this value. "
+        "Functions with a single call site are inlined when their size is at "
+        "most twice this value. 0 disables cost based inlining. Ignored with "
+        "-inline-entry-points."));
+
+static llvm::cl::opt<unsigned> inline_constant_arg_bonus(
+    "inline-constant-arg-bonus", llvm::cl::init(5),
+    llvm::cl::desc(
+        "With -inline-cost-threshold, the cost reduction of a call site for "
+        "each of its arguments that is a constant."));
+
+static llvm::cl::opt<unsigned> inline_pressure_threshold(
+    "inline-pressure-threshold", llvm::cl::init(0),
+    llvm::cl::desc(
+        "With -inline-cost-threshold, do not inline functions larger than "
+        "-inline-pressure-callee-size into a loop at a call site where at "
+        "least this many values are live across the call, to limit register "
+        "pressure. 0 disables the register pressure heuristic."));
+
+static llvm::cl::opt<unsigned> inline_pressure_callee_size(
+    "inline-pressure-callee-size", llvm::cl::init(20),
+    llvm::cl::desc(
+        "With -inline-pressure-threshold, the instruction count above which a "
+        "function is not inlined at call sites under register pressure."));
+
+static llvm::cl::opt<bool> pack_pod_args(
+    "pack-pod-args", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Reorder clustered POD kernel arguments by decreasing alignment to "
+        "minimize padding, so that more arguments fit in push constants. "
+        "Reflection reports the offset of each argument."));
+
+static llvm::cl::opt<bool> shared_descriptor_layout(
+    "shared-descriptor-layout", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Assign kernel argument bindings so that every kernel of the program "
+        "can use one descriptor set layout: arguments of different kernels "
+        "only share a binding when they use the same descriptor type."));
+
+static llvm::cl::opt<bool> physical_storage_buffers(
+    "physical-storage-buffers", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Pass __global and __constant pointer kernel arguments as 64-bit "
+        "device addresses in POD arguments and access them through "
+        "PhysicalStorageBuffer pointers, instead of binding a descriptor per "
+        "argument. Requires VK_KHR_buffer_device_address."));
+
+static llvm::cl::opt<bool> pack_local_memory(
+    "pack-local-memory", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Also share __local variables of the same type that are used by a "
+        "single kernel when a work-group barrier separates all the accesses to "
+        "one from all the accesses to the other."));
+
+static llvm::cl::opt<unsigned> module_constants_inline_threshold(
+    "module-constants-inline-threshold", llvm::cl::init(0),
+    llvm::cl::desc(
+        "With -module-constants-in-storage-buffer, keep __constant variables "
+        "of at most this many bytes out of the storage buffer when they are "
+        "only loaded from, and emit them as initialized Private variables "
+        "instead. 0 puts every __constant variable in the storage buffer."));
+
+static llvm::cl::opt<unsigned> dra_clone_limit(
+    "dra-clone-limit", llvm::cl::init(0),
+    llvm::cl::desc(
+        "Clone helper functions whose callers pass different resources, so "
+        "that each resource combination gets its own copy that accesses the "
+        "resources directly. Cloning stops once it has added this many "
+        "instructions to the module. 0 disables cloning."));
+
+static llvm::cl::opt<bool> vector_buffer_args(
+    "vector-buffer-args", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Retype scalar __global and __constant pointer kernel arguments "
+        "accessed only by vload2/vstore2 or only by vload4/vstore4 as pointers "
+        "to that vector type, so that each access is a single vector load or "
+        "store. The host must bind such buffers at offsets aligned to the "
+        "vector size."));
+
+static llvm::cl::opt<bool> atomic_float_add(
+    "atomic-float-add", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Lower atomic_fetch_add and atomic_fetch_sub on float and double to "
+        "OpAtomicFAddEXT. Requires SPV_EXT_shader_atomic_float_add."));
+
+static llvm::cl::opt<bool> int64_atomics(
+    "int64-atomics", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Allow atomic operations on 64-bit integers, from "
+        "cl_khr_int64_base_atomics and cl_khr_int64_extended_atomics. Requires "
+        "the Int64Atomics capability."));
+
+static llvm::cl::opt<bool> narrow_integer_arithmetic(
+    "narrow-integer-arithmetic", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Keep integer arithmetic on 8- and 16-bit values at that width instead "
+        "of widening it. This requires the Int8 and Int16 capabilities."));
+
+static llvm::cl::opt<bool> native_fp16(
+    "native-fp16", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Keep half precision arithmetic and math builtins in 16 bits when "
+        "their result is converted back to half, instead of computing them in "
+        "float. Intermediate results are then rounded to half precision."));
+
+static llvm::cl::opt<bool> structurize_unstructured_only(
+    "structurize-unstructured-only", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Only run the CFG structurizer on functions whose control flow is not "
+        "already structured, after giving loops with early exits single "
+        "exit blocks. This saves compile time and avoids extra flow "
+        "blocks."));
+
+static llvm::cl::opt<bool> skip_unused_kernel_args(
+    "skip-unused-kernel-args", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Do not allocate descriptors or emit argument reflection for kernel "
+        "arguments that are unused after optimization."));
+
+static llvm::cl::opt<unsigned> mem_intrinsic_unroll_limit(
+    "mem-intrinsic-unroll-limit", llvm::cl::init(16),
+    llvm::cl::desc(
+        "The number of element stores or copies up to which llvm.memset and "
+        "llvm.memcpy are unrolled. Larger ones are lowered to a loop."));
+
+static llvm::cl::opt<bool> member_stores_for_inserts(
+    "member-stores-for-inserts", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Store the members of a chain of insertvalue instructions whose only "
+        "use is a store, instead of building the composite."));
+
+static llvm::cl::opt<bool> image_fetch_int_coords(
+    "image-fetch-int-coords", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Lower reads of images with integer coordinates and a literal "
+        "non-normalized, nearest sampler to OpImageFetch without the "
+        "sampler."));
+
+static llvm::cl::opt<bool> uniformity_decorations(
+    "uniformity-decorations", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Decorate loads and phis whose value is the same for the whole "
+        "workgroup with Uniform, and pointers whose resource is not with "
+        "NonUniformEXT (SPV_EXT_descriptor_indexing). Also folds subgroup "
+        "broadcasts, reductions and votes of subgroup-uniform values."));
+
+static llvm::cl::opt<clspv::Option::ProfileCounters> profile_counters(
+    "profile-counters",
+    llvm::cl::desc(
+        "Count the executions of basic blocks or loop headers with atomic "
+        "increments of a storage buffer at binding 0 of its own descriptor "
+        "set. The buffer and the location of each counter are reported in "
+        "the reflection."),
+    llvm::cl::init(clspv::Option::ProfileCounters::kNone),
+    llvm::cl::values(
+        clEnumValN(clspv::Option::ProfileCounters::kNone, "none",
+                   "No profiling counters"),
+        clEnumValN(clspv::Option::ProfileCounters::kBlocks, "blocks",
+                   "Count the executions of each basic block"),
+        clEnumValN(clspv::Option::ProfileCounters::kLoops, "loops",
+                   "Count the iterations of each loop")));
+
+static llvm::cl::opt<clspv::Option::RelaxedPrecision> relaxed_precision(
+    "relaxed-precision",
+    llvm::cl::desc(
+        "Decorate float results RelaxedPrecision, so drivers may compute them "
+        "at 16 bits, starting from the results of the half_ and native_ "
+        "builtins. The decoration is propagated to the arithmetic whose float "
+        "operands all have it."),
+    llvm::cl::init(clspv::Option::RelaxedPrecision::kNone),
+    llvm::cl::values(
+        clEnumValN(clspv::Option::RelaxedPrecision::kNone, "none",
+                   "No RelaxedPrecision decorations"),
+        clEnumValN(clspv::Option::RelaxedPrecision::kBuiltins, "builtins",
+                   "Decorate the results of half_ and native_ builtins"),
+        clEnumValN(clspv::Option::RelaxedPrecision::kRelaxedMath,
+                   "relaxed-math",
+                   "Also decorate all float arithmetic and builtins under "
+                   "-cl-fast-relaxed-math or -cl-unsafe-math-optimizations")));
+
+static llvm::cl::opt<bool> hoist_access_chains(
+    "hoist-access-chains", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Merge identical getelementptrs and hoist the loop-invariant ones out "
+        "of their loops right before SPIR-V generation, as the pointer "
+        "lowering passes duplicate them after the LLVM optimizations."));
+
+static llvm::cl::opt<bool> widen_vec3_accesses(
+    "widen-vec3-accesses", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Access the 3-element vectors read and written through pointers to "
+        "4-element vectors as whole 4-element vectors instead of one element "
+        "at a time. Stores then rewrite the fourth element with the value "
+        "loaded just before, so no other work-item may write it "
+        "concurrently."));
+
+static llvm::cl::opt<bool> vulkan_memory_model(
+    "vulkan-memory-model", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Use the Vulkan memory model instead of GLSL450. Relaxed atomics then "
+        "order nothing, only acquire and release operations make memory "
+        "available and visible, and no resource is decorated Coherent. "
+        "Requires VK_KHR_vulkan_memory_model."));
+
+static llvm::cl::opt<bool> kernel_resource_usage(
+    "kernel-resource-usage", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Report in the reflection the workgroup, private and push constant "
+        "memory used by each kernel, and a local size suggested for the "
+        "kernels without reqd_work_group_size."));
+
+static llvm::cl::opt<bool> untyped_buffers(
+    "untyped-buffers", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Declare the __global and __constant buffers accessed with several "
+        "types as arrays of 32-bit words, and access them one word at a time "
+        "followed by a bitcast, instead of combining accesses of the "
+        "declared type."));
+
+static llvm::cl::opt<bool> narrow_int64_arithmetic(
+    "narrow-int64-arithmetic", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Compute 64-bit integer arithmetic at 32 bits when its values are "
+        "known to fit, so that kernels using long for small values may not "
+        "need the Int64 capability."));
+
+static llvm::cl::opt<bool> immutable_literal_samplers(
+    "immutable-literal-samplers", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Report in the reflection the Vulkan sampler state of each literal "
+        "sampler, so the runtime can create it once and bake it in the "
+        "descriptor set layout as an immutable sampler."));
+
+static llvm::cl::opt<bool> buffer_alias_decorations(
+    "buffer-alias-decorations", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Decorate the storage buffer variables of restrict kernel arguments "
+        "Restrict, and the others Aliased, as the runtime may bind the same "
+        "buffer to several of them."));
+
+static llvm::cl::opt<bool> subgroup_atomic_aggregation(
+    "subgroup-atomic-aggregation", llvm::cl::init(false),
+    llvm::cl::desc(
+        "Replace 32-bit atomic additions and subtractions to an address the "
+        "same for the whole subgroup by a subgroup reduction and a single "
+        "atomic per subgroup. Requires -spv-version=1.3 or greater and "
+        "subgroup arithmetic support."));
+
+static llvm::cl::opt<unsigned> private_array_promotion_threshold(
+    "private-array-promotion-threshold", llvm::cl::init(0),
+    llvm::cl::desc(
+        "Keep dynamically indexed private arrays of scalars with at most this "
+        "many elements in registers instead of in a Function storage class "
+        "variable that drivers may spill to scratch memory. Arrays of up to 4 "
+        "elements become vectors, larger ones select chains. 0 disables the "
+        "promotion."));
+
 } // namespace
 
 namespace clspv {
 namespace Option {
 
-bool InlineEntryPoints() { return inline_entry_points; }
-bool InlineSingleCallSite() { return !no_inline_single_call_site; }
+// The value of every clspv option, as seen by a single compilation.
+struct ScopedOptionState::Values {
+  Values()
+      : inline_entry_points(::inline_entry_points),
+        no_inline_single_call_site(::no_inline_single_call_site),
+        no_direct_resource_access(::no_direct_resource_access),
+        no_share_module_scope_variables(::no_share_module_scope_variables),
+        distinct_kernel_descriptor_sets(::distinct_kernel_descriptor_sets),
+        hack_initializers(::hack_initializers), hack_dis(::hack_dis),
+        hack_inserts(::hack_inserts),
+        hack_signed_compare_fixup(::hack_signed_compare_fixup),
+        hack_undef(::hack_undef), hack_phis(::hack_phis),
+        hack_block_order(::hack_block_order), pod_ubo(::pod_ubo),
+        pod_pushconstant(::pod_pushconstant),
+        module_constants_in_storage_buffer(
+            ::module_constants_in_storage_buffer),
+        show_ids(::show_ids),
+        constant_args_in_uniform_buffer(::constant_args_in_uniform_buffer),
+        maximum_ubo_size(::maximum_ubo_size),
+        maximum_pushconstant_size(::maximum_pushconstant_size),
+        relaxed_ubo_layout(::relaxed_ubo_layout),
+        std430_ubo_layout(::std430_ubo_layout),
+        keep_unused_arguments(::keep_unused_arguments),
+        int8_support(::int8_support),
+        long_vector_support(::long_vector_support), cl_std(::cl_std),
+        spv_version(::spv_version), images(::images),
+        scalar_block_layout(::scalar_block_layout), work_dim(::work_dim),
+        global_offset(::global_offset),
+        global_offset_push_constant(::global_offset_push_constant),
+        uniform_ndrange_variants(::uniform_ndrange_variants),
+        use_sampler_map(::use_sampler_map),
+        cluster_non_pointer_kernel_args(::cluster_non_pointer_kernel_args),
+        no_16bit_storage(::no_16bit_storage.begin(),
+                         ::no_16bit_storage.end()),
+        no_8bit_storage(::no_8bit_storage.begin(), ::no_8bit_storage.end()),
+        entry_points(::entry_points.begin(), ::entry_points.end()),
+        fuse_kernels(::fuse_kernels.begin(), ::fuse_kernels.end()),
+        local_arg_sizes(::local_arg_sizes.begin(), ::local_arg_sizes.end()),
+        pod_spec_constants(::pod_spec_constants.begin(),
+                           ::pod_spec_constants.end()),
+        stream_functions(::stream_functions), lean_memory(::lean_memory),
+        canonical_ids(::canonical_ids),
+        optimize_barriers(::optimize_barriers),
+        long_vector_chunk_width(::long_vector_chunk_width),
+        inline_cost_threshold(::inline_cost_threshold),
+        inline_constant_arg_bonus(::inline_constant_arg_bonus),
+        inline_pressure_threshold(::inline_pressure_threshold),
+        inline_pressure_callee_size(::inline_pressure_callee_size),
+        local_size(::local_size.begin(), ::local_size.end()),
+        pack_pod_args(::pack_pod_args),
+        shared_descriptor_layout(::shared_descriptor_layout),
+        physical_storage_buffers(::physical_storage_buffers),
+        pack_local_memory(::pack_local_memory),
+        module_constants_inline_threshold(
+            ::module_constants_inline_threshold),
+        dra_clone_limit(::dra_clone_limit),
+        vector_buffer_args(::vector_buffer_args),
+        atomic_float_add(::atomic_float_add),
+        int64_atomics(::int64_atomics),
+        narrow_integer_arithmetic(::narrow_integer_arithmetic),
+        native_fp16(::native_fp16),
+        structurize_unstructured_only(::structurize_unstructured_only),
+        skip_unused_kernel_args(::skip_unused_kernel_args),
+        mem_intrinsic_unroll_limit(::mem_intrinsic_unroll_limit),
+        member_stores_for_inserts(::member_stores_for_inserts),
+        image_fetch_int_coords(::image_fetch_int_coords),
+        uniformity_decorations(::uniformity_decorations),
+        profile_counters(::profile_counters),
+        relaxed_precision(::relaxed_precision),
+        hoist_access_chains(::hoist_access_chains),
+        widen_vec3_accesses(::widen_vec3_accesses),
+        vulkan_memory_model(::vulkan_memory_model),
+        kernel_resource_usage(::kernel_resource_usage),
+        immutable_literal_samplers(::immutable_literal_samplers),
+        untyped_buffers(::untyped_buffers),
+        narrow_int64_arithmetic(::narrow_int64_arithmetic),
+        int64_arg_ranges(::int64_arg_ranges.begin(),
+                         ::int64_arg_ranges.end()),
+        private_array_promotion_threshold(
+            ::private_array_promotion_threshold),
+        buffer_alias_decorations(::buffer_alias_decorations),
+        subgroup_atomic_aggregation(::subgroup_atomic_aggregation) {}
+
+  bool inline_entry_points;
+  bool no_inline_single_call_site;
+  bool no_direct_resource_access;
+  bool no_share_module_scope_variables;
+  bool distinct_kernel_descriptor_sets;
+  bool hack_initializers;
+  bool hack_dis;
+  bool hack_inserts;
+  bool hack_signed_compare_fixup;
+  bool hack_undef;
+  bool hack_phis;
+  bool hack_block_order;
+  bool pod_ubo;
+  bool pod_pushconstant;
+  bool module_constants_in_storage_buffer;
+  bool show_ids;
+  bool constant_args_in_uniform_buffer;
+  int maximum_ubo_size;
+  int maximum_pushconstant_size;
+  bool relaxed_ubo_layout;
+  bool std430_ubo_layout;
+  bool keep_unused_arguments;
+  bool int8_support;
+  bool long_vector_support;
+  SourceLanguage cl_std;
+  SPIRVVersion spv_version;
+  bool images;
+  bool scalar_block_layout;
+  bool work_dim;
+  bool global_offset;
+  bool global_offset_push_constant;
+  bool uniform_ndrange_variants;
+  bool use_sampler_map;
+  bool cluster_non_pointer_kernel_args;
+  std::vector<StorageClass> no_16bit_storage;
+  std::vector<StorageClass> no_8bit_storage;
+  std::vector<std::string> entry_points;
+  std::vector<std::string> fuse_kernels;
+  std::vector<std::string> local_arg_sizes;
+  std::vector<std::string> pod_spec_constants;
+  bool stream_functions;
+  bool lean_memory;
+  bool canonical_ids;
+  bool optimize_barriers;
+  unsigned long_vector_chunk_width;
+  unsigned inline_cost_threshold;
+  unsigned inline_constant_arg_bonus;
+  unsigned inline_pressure_threshold;
+  unsigned inline_pressure_callee_size;
+  std::vector<unsigned> local_size;
+  bool pack_pod_args;
+  bool shared_descriptor_layout;
+  bool physical_storage_buffers;
+  bool pack_local_memory;
+  unsigned module_constants_inline_threshold;
+  unsigned dra_clone_limit;
+  bool vector_buffer_args;
+  bool atomic_float_add;
+  bool int64_atomics;
+  bool narrow_integer_arithmetic;
+  bool native_fp16;
+  bool structurize_unstructured_only;
+  bool skip_unused_kernel_args;
+  unsigned mem_intrinsic_unroll_limit;
+  bool member_stores_for_inserts;
+  bool image_fetch_int_coords;
+  bool uniformity_decorations;
+  ProfileCounters profile_counters;
+  RelaxedPrecision relaxed_precision;
+  bool hoist_access_chains;
+  bool widen_vec3_accesses;
+  bool vulkan_memory_model;
+  bool kernel_resource_usage;
+  bool immutable_literal_samplers;
+  bool untyped_buffers;
+  bool narrow_int64_arithmetic;
+  std::vector<std::string> int64_arg_ranges;
+  unsigned private_array_promotion_threshold;
+  bool buffer_alias_decorations;
+  bool subgroup_atomic_aggregation;
+};
+
+namespace {
+
+// The option state of the compilation running on this thread, if any.  When
+// there is none (e.g. in clspv-opt), the accessors read the option globals
+// directly.
+thread_local ScopedOptionState::Values *active_values = nullptr;
+
+// Returns the value of |field| in the active option state, or the value of the
+// option global |opt| if there is no active state.
+template <typename T, typename OptT>
+T Get(T ScopedOptionState::Values::*field, const OptT &opt) {
+  if (active_values)
+    return active_values->*field;
+  return opt;
+}
+
+} // namespace
+
+ScopedOptionState::ScopedOptionState()
+    : values_(new Values), previous_(active_values) {
+  active_values = values_.get();
+}
+
+ScopedOptionState::ScopedOptionState(const ScopedOptionState &other)
+    : values_(new Values(*other.values_)), previous_(active_values) {
+  active_values = values_.get();
+}
+
+ScopedOptionState::~ScopedOptionState() { active_values = previous_; }
+
+bool InlineEntryPoints() {
+  return Get(&ScopedOptionState::Values::inline_entry_points,
+             inline_entry_points);
+}
+bool InlineSingleCallSite() {
+  return !Get(&ScopedOptionState::Values::no_inline_single_call_site,
+              no_inline_single_call_site);
+}
 bool DirectResourceAccess() {
-  return !(no_direct_resource_access || distinct_kernel_descriptor_sets);
-}
-bool ShareModuleScopeVariables() { return !no_share_module_scope_variables; }
-bool DistinctKernelDescriptorSets() { return distinct_kernel_descriptor_sets; }
-bool HackDistinctImageSampler() { return hack_dis; }
-bool HackInitializers() { return hack_initializers; }
-bool HackInserts() { return hack_inserts; }
-bool HackSignedCompareFixup() { return hack_signed_compare_fixup; }
-bool HackUndef() { return hack_undef; }
-bool HackPhis() { return hack_phis; }
-bool HackBlockOrder() { return hack_block_order; }
+  return !(Get(&ScopedOptionState::Values::no_direct_resource_access,
+               no_direct_resource_access) ||
+           DistinctKernelDescriptorSets());
+}
+bool ShareModuleScopeVariables() {
+  return !Get(&ScopedOptionState::Values::no_share_module_scope_variables,
+              no_share_module_scope_variables);
+}
+bool DistinctKernelDescriptorSets() {
+  return Get(&ScopedOptionState::Values::distinct_kernel_descriptor_sets,
+             distinct_kernel_descriptor_sets);
+}
+bool HackDistinctImageSampler() {
+  return Get(&ScopedOptionState::Values::hack_dis, hack_dis);
+}
+bool HackInitializers() {
+  return Get(&ScopedOptionState::Values::hack_initializers, hack_initializers);
+}
+bool HackInserts() {
+  return Get(&ScopedOptionState::Values::hack_inserts, hack_inserts);
+}
+bool HackSignedCompareFixup() {
+  return Get(&ScopedOptionState::Values::hack_signed_compare_fixup,
+             hack_signed_compare_fixup);
+}
+bool HackUndef() {
+  return Get(&ScopedOptionState::Values::hack_undef, hack_undef);
+}
+bool HackPhis() {
+  return Get(&ScopedOptionState::Values::hack_phis, hack_phis);
+}
+bool HackBlockOrder() {
+  return Get(&ScopedOptionState::Values::hack_block_order, hack_block_order);
+}
 bool ModuleConstantsInStorageBuffer() {
-  return module_constants_in_storage_buffer;
-}
-bool PodArgsInUniformBuffer() { return pod_ubo; }
-bool PodArgsInPushConstants() { return pod_pushconstant; }
-bool ShowIDs() { return show_ids; }
-bool ConstantArgsInUniformBuffer() { return constant_args_in_uniform_buffer; }
-uint64_t MaxUniformBufferSize() { return maximum_ubo_size; }
-uint32_t MaxPushConstantsSize() { return maximum_pushconstant_size; }
-bool RelaxedUniformBufferLayout() { return relaxed_ubo_layout; }
-bool Std430UniformBufferLayout() { return std430_ubo_layout; }
-bool KeepUnusedArguments() { return keep_unused_arguments; }
-bool Int8Support() { return int8_support; }
-bool LongVectorSupport() { return long_vector_support; }
-bool ImageSupport() { return images; }
-bool UseSamplerMap() { return use_sampler_map; }
-void SetUseSamplerMap(bool use) { use_sampler_map = use; }
-SourceLanguage Language() { return cl_std; }
-SPIRVVersion SpvVersion() { return spv_version; }
-bool ScalarBlockLayout() { return scalar_block_layout; }
-bool WorkDim() { return work_dim; }
-bool GlobalOffset() { return global_offset; }
-bool GlobalOffsetPushConstant() { return global_offset_push_constant; }
-bool ClusterPodKernelArgs() { return cluster_non_pointer_kernel_args; }
+  return Get(&ScopedOptionState::Values::module_constants_in_storage_buffer,
+             module_constants_in_storage_buffer);
+}
+bool PodArgsInUniformBuffer() {
+  return Get(&ScopedOptionState::Values::pod_ubo, pod_ubo);
+}
+bool PodArgsInPushConstants() {
+  return Get(&ScopedOptionState::Values::pod_pushconstant, pod_pushconstant);
+}
+bool ShowIDs() { return Get(&ScopedOptionState::Values::show_ids, show_ids); }
+bool ConstantArgsInUniformBuffer() {
+  return Get(&ScopedOptionState::Values::constant_args_in_uniform_buffer,
+             constant_args_in_uniform_buffer);
+}
+uint64_t MaxUniformBufferSize() {
+  return Get(&ScopedOptionState::Values::maximum_ubo_size, maximum_ubo_size);
+}
+uint32_t MaxPushConstantsSize() {
+  return Get(&ScopedOptionState::Values::maximum_pushconstant_size,
+             maximum_pushconstant_size);
+}
+bool RelaxedUniformBufferLayout() {
+  return Get(&ScopedOptionState::Values::relaxed_ubo_layout,
+             relaxed_ubo_layout);
+}
+bool Std430UniformBufferLayout() {
+  // Scalar block layout relaxes the std430 rules further.
+  return Get(&ScopedOptionState::Values::std430_ubo_layout,
+             std430_ubo_layout) ||
+         ScalarBlockLayout();
+}
+bool KeepUnusedArguments() {
+  return Get(&ScopedOptionState::Values::keep_unused_arguments,
+             keep_unused_arguments);
+}
+bool Int8Support() {
+  return Get(&ScopedOptionState::Values::int8_support, int8_support);
+}
+bool LongVectorSupport() {
+  return Get(&ScopedOptionState::Values::long_vector_support,
+             long_vector_support);
+}
+bool ImageSupport() { return Get(&ScopedOptionState::Values::images, images); }
+bool UseSamplerMap() {
+  return Get(&ScopedOptionState::Values::use_sampler_map, use_sampler_map);
+}
+void SetUseSamplerMap(bool use) {
+  if (active_values) {
+    active_values->use_sampler_map = use;
+  } else {
+    use_sampler_map = use;
+  }
+}
+SourceLanguage Language() {
+  return Get(&ScopedOptionState::Values::cl_std, cl_std);
+}
+SPIRVVersion SpvVersion() {
+  return Get(&ScopedOptionState::Values::spv_version, spv_version);
+}
+bool ScalarBlockLayout() {
+  return Get(&ScopedOptionState::Values::scalar_block_layout,
+             scalar_block_layout);
+}
+bool WorkDim() { return Get(&ScopedOptionState::Values::work_dim, work_dim); }
+bool GlobalOffset() {
+  return Get(&ScopedOptionState::Values::global_offset, global_offset);
+}
+bool GlobalOffsetPushConstant() {
+  return Get(&ScopedOptionState::Values::global_offset_push_constant,
+             global_offset_push_constant);
+}
+bool UniformNDRangeVariants() {
+  return Get(&ScopedOptionState::Values::uniform_ndrange_variants,
+             uniform_ndrange_variants);
+}
+bool ClusterPodKernelArgs() {
+  return Get(&ScopedOptionState::Values::cluster_non_pointer_kernel_args,
+             cluster_non_pointer_kernel_args);
+}
+bool StreamFunctions() {
+  return Get(&ScopedOptionState::Values::stream_functions, stream_functions);
+}
+
+bool LeanMemory() {
+  return Get(&ScopedOptionState::Values::lean_memory, lean_memory);
+}
+
+bool CanonicalIds() {
+  return Get(&ScopedOptionState::Values::canonical_ids, canonical_ids);
+}
+
+bool OptimizeBarriers() {
+  return Get(&ScopedOptionState::Values::optimize_barriers,
+             optimize_barriers);
+}
+
+std::vector<std::string> EntryPoints() {
+  if (active_values)
+    return active_values->entry_points;
+  return std::vector<std::string>(entry_points.begin(), entry_points.end());
+}
+
+void SetEntryPoints(const std::vector<std::string> &names) {
+  if (active_values) {
+    active_values->entry_points = names;
+  } else {
+    entry_points.clear();
+    for (const auto &name : names)
+      entry_points.push_back(name);
+  }
+}
+
+std::vector<std::string> FuseKernels() {
+  if (active_values)
+    return active_values->fuse_kernels;
+  return std::vector<std::string>(fuse_kernels.begin(), fuse_kernels.end());
+}
+
+bool ParseFuseKernels(const std::string &entry, std::string *first,
+                      unsigned *first_ordinal, std::string *second,
+                      unsigned *second_ordinal) {
+  llvm::SmallVector<llvm::StringRef, 4> fields;
+  llvm::StringRef(entry).split(fields, ':');
+  if (fields.size() != 4 || fields[0].empty() || fields[2].empty() ||
+      fields[1].getAsInteger(10, *first_ordinal) ||
+      fields[3].getAsInteger(10, *second_ordinal))
+    return false;
+  *first = fields[0].str();
+  *second = fields[2].str();
+  return true;
+}
+
+std::vector<std::string> LocalArgSizes() {
+  if (active_values)
+    return active_values->local_arg_sizes;
+  return std::vector<std::string>(local_arg_sizes.begin(),
+                                  local_arg_sizes.end());
+}
+
+bool ParseLocalArgSize(const std::string &entry, std::string *kernel,
+                       unsigned *ordinal, uint32_t *bytes) {
+  // Kernel names cannot contain colons, so split from the end.
+  llvm::StringRef rest, bytes_str, ordinal_str;
+  std::tie(rest, bytes_str) = llvm::StringRef(entry).rsplit(':');
+  std::tie(rest, ordinal_str) = rest.rsplit(':');
+  if (rest.empty() || ordinal_str.getAsInteger(10, *ordinal) ||
+      bytes_str.getAsInteger(10, *bytes) || *bytes == 0)
+    return false;
+  *kernel = rest.str();
+  return true;
+}
+
+uint32_t LocalArgSize(const std::string &kernel, unsigned ordinal) {
+  uint32_t size = 0;
+  for (const auto &entry : LocalArgSizes()) {
+    std::string entry_kernel;
+    unsigned entry_ordinal;
+    uint32_t entry_bytes;
+    if (ParseLocalArgSize(entry, &entry_kernel, &entry_ordinal,
+                          &entry_bytes) &&
+        entry_kernel == kernel && entry_ordinal == ordinal)
+      size = entry_bytes;
+  }
+  return size;
+}
+
+std::vector<std::string> PodSpecConstants() {
+  if (active_values)
+    return active_values->pod_spec_constants;
+  return std::vector<std::string>(pod_spec_constants.begin(),
+                                  pod_spec_constants.end());
+}
+
+bool ParsePodSpecConstant(const std::string &entry, std::string *kernel,
+                          unsigned *ordinal) {
+  llvm::StringRef rest, ordinal_str;
+  std::tie(rest, ordinal_str) = llvm::StringRef(entry).rsplit(':');
+  if (rest.empty() || ordinal_str.getAsInteger(10, *ordinal))
+    return false;
+  *kernel = rest.str();
+  return true;
+}
+
+bool IsPodSpecConstant(const std::string &kernel, unsigned ordinal) {
+  for (const auto &entry : PodSpecConstants()) {
+    std::string entry_kernel;
+    unsigned entry_ordinal;
+    if (ParsePodSpecConstant(entry, &entry_kernel, &entry_ordinal) &&
+        entry_kernel == kernel && entry_ordinal == ordinal)
+      return true;
+  }
+  return false;
+}
+
+unsigned LongVectorChunkWidth() {
+  return Get(&ScopedOptionState::Values::long_vector_chunk_width,
+             long_vector_chunk_width);
+}
+
+unsigned InlineCostThreshold() {
+  return Get(&ScopedOptionState::Values::inline_cost_threshold,
+             inline_cost_threshold);
+}
+
+unsigned InlineConstantArgBonus() {
+  return Get(&ScopedOptionState::Values::inline_constant_arg_bonus,
+             inline_constant_arg_bonus);
+}
+
+unsigned InlinePressureThreshold() {
+  return Get(&ScopedOptionState::Values::inline_pressure_threshold,
+             inline_pressure_threshold);
+}
+
+unsigned InlinePressureCalleeSize() {
+  return Get(&ScopedOptionState::Values::inline_pressure_callee_size,
+             inline_pressure_callee_size);
+}
+
+std::vector<unsigned> LocalSize() {
+  if (active_values)
+    return active_values->local_size;
+  return std::vector<unsigned>(local_size.begin(), local_size.end());
+}
+
+bool PackPodArgs() {
+  return Get(&ScopedOptionState::Values::pack_pod_args, pack_pod_args);
+}
+
+bool SharedDescriptorLayout() {
+  return Get(&ScopedOptionState::Values::shared_descriptor_layout,
+             shared_descriptor_layout);
+}
+
+bool PhysicalStorageBuffers() {
+  return Get(&ScopedOptionState::Values::physical_storage_buffers,
+             physical_storage_buffers);
+}
+
+bool PackLocalMemory() {
+  return Get(&ScopedOptionState::Values::pack_local_memory, pack_local_memory);
+}
+
+unsigned ModuleConstantsInlineThreshold() {
+  return Get(&ScopedOptionState::Values::module_constants_inline_threshold,
+             module_constants_inline_threshold);
+}
+
+unsigned DirectResourceAccessCloneLimit() {
+  return Get(&ScopedOptionState::Values::dra_clone_limit, dra_clone_limit);
+}
+
+bool VectorBufferArgs() {
+  return Get(&ScopedOptionState::Values::vector_buffer_args,
+             vector_buffer_args);
+}
+
+bool AtomicFloatAdd() {
+  return Get(&ScopedOptionState::Values::atomic_float_add, atomic_float_add);
+}
+
+bool Int64Atomics() {
+  return Get(&ScopedOptionState::Values::int64_atomics, int64_atomics);
+}
+
+bool NarrowIntegerArithmetic() {
+  return Get(&ScopedOptionState::Values::narrow_integer_arithmetic,
+             narrow_integer_arithmetic);
+}
+
+bool NativeFp16() {
+  return Get(&ScopedOptionState::Values::native_fp16, native_fp16);
+}
+
+bool StructurizeUnstructuredOnly() {
+  return Get(&ScopedOptionState::Values::structurize_unstructured_only,
+             structurize_unstructured_only);
+}
+
+bool SkipUnusedKernelArgs() {
+  return Get(&ScopedOptionState::Values::skip_unused_kernel_args,
+             skip_unused_kernel_args);
+}
+
+unsigned MemIntrinsicUnrollLimit() {
+  return Get(&ScopedOptionState::Values::mem_intrinsic_unroll_limit,
+             mem_intrinsic_unroll_limit);
+}
+
+bool MemberStoresForInserts() {
+  return Get(&ScopedOptionState::Values::member_stores_for_inserts,
+             member_stores_for_inserts);
+}
+
+bool ImageFetchIntCoords() {
+  return Get(&ScopedOptionState::Values::image_fetch_int_coords,
+             image_fetch_int_coords);
+}
+
+bool UniformityDecorations() {
+  return Get(&ScopedOptionState::Values::uniformity_decorations,
+             uniformity_decorations);
+}
+
+ProfileCounters ProfileCountersMode() {
+  return Get(&ScopedOptionState::Values::profile_counters, profile_counters);
+}
+
+RelaxedPrecision RelaxedPrecisionMode() {
+  return Get(&ScopedOptionState::Values::relaxed_precision, relaxed_precision);
+}
+
+bool HoistAccessChains() {
+  return Get(&ScopedOptionState::Values::hoist_access_chains,
+             hoist_access_chains);
+}
+
+bool WidenVec3Accesses() {
+  return Get(&ScopedOptionState::Values::widen_vec3_accesses,
+             widen_vec3_accesses);
+}
+
+bool VulkanMemoryModel() {
+  return Get(&ScopedOptionState::Values::vulkan_memory_model,
+             vulkan_memory_model);
+}
+
+bool KernelResourceUsage() {
+  return Get(&ScopedOptionState::Values::kernel_resource_usage,
+             kernel_resource_usage);
+}
+
+bool ImmutableLiteralSamplers() {
+  return Get(&ScopedOptionState::Values::immutable_literal_samplers,
+             immutable_literal_samplers);
+}
+
+bool UntypedBuffers() {
+  return Get(&ScopedOptionState::Values::untyped_buffers, untyped_buffers);
+}
+
+bool NarrowInt64Arithmetic() {
+  return Get(&ScopedOptionState::Values::narrow_int64_arithmetic,
+             narrow_int64_arithmetic);
+}
+
+std::vector<std::string> Int64ArgRanges() {
+  if (active_values)
+    return active_values->int64_arg_ranges;
+  return std::vector<std::string>(int64_arg_ranges.begin(),
+                                  int64_arg_ranges.end());
+}
+
+bool ParseInt64ArgRange(const std::string &entry, std::string *kernel,
+                        unsigned *ordinal, int64_t *min, int64_t *max) {
+  // Kernel names cannot contain colons, so split from the end.
+  llvm::StringRef rest, ordinal_str, min_str, max_str;
+  std::tie(rest, max_str) = llvm::StringRef(entry).rsplit(':');
+  std::tie(rest, min_str) = rest.rsplit(':');
+  std::tie(rest, ordinal_str) = rest.rsplit(':');
+  if (rest.empty() || ordinal_str.getAsInteger(10, *ordinal) ||
+      min_str.getAsInteger(10, *min) || max_str.getAsInteger(10, *max) ||
+      *min > *max)
+    return false;
+  *kernel = rest.str();
+  return true;
+}
+
+unsigned PrivateArrayPromotionThreshold() {
+  return Get(&ScopedOptionState::Values::private_array_promotion_threshold,
+             private_array_promotion_threshold);
+}
+
+bool BufferAliasDecorations() {
+  return Get(&ScopedOptionState::Values::buffer_alias_decorations,
+             buffer_alias_decorations);
+}
+
+bool SubgroupAtomicAggregation() {
+  return Get(&ScopedOptionState::Values::subgroup_atomic_aggregation,
+             subgroup_atomic_aggregation);
+}
 
 bool Supports16BitStorageClass(StorageClass sc) {
   // -no-16bit-storage removes storage capabilities.
+  if (active_values) {
+    for (auto storage_class : active_values->no_16bit_storage) {
+      if (storage_class == sc)
+        return false;
+    }
+    return true;
+  }
+
   for (auto storage_class : no_16bit_storage) {
     if (storage_class == sc)
       return false;
@@ -288,6 +1246,14 @@ bool Supports16BitStorageClass(StorageClass sc) {
 
 bool Supports8BitStorageClass(StorageClass sc) {
   // -no-8bit-storage removes storage capabilities.
+  if (active_values) {
+    for (auto storage_class : active_values->no_8bit_storage) {
+      if (storage_class == sc)
+        return false;
+    }
+    return true;
+  }
+
   for (auto storage_class : no_8bit_storage) {
     if (storage_class == sc)
       return false;
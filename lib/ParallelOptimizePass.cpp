@@ -0,0 +1,352 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs the LLVM optimization pipeline of PassBuilder on groups of kernels in
+// parallel, for -opt-jobs. With a single job, the pipeline runs in place.
+//
+// An LLVMContext cannot be used from several threads, so the functions of
+// the module cannot simply be optimized in place concurrently. Instead, the
+// kernels are split into partitions, in call graph order, each owning its
+// kernels and the functions they are the first to reach. Every worker thread
+// parses a copy of the module into its own context, reduces it to the
+// functions of its partition, runs the pipeline and writes the result back as
+// bitcode. The optimized functions are then linked back into the module.
+//
+// The pass itself is a barrier: the module passes before and after it see
+// the whole module. Within a partition, the interprocedural passes of the
+// pipeline only see the functions of the partition. Callees owned by another
+// partition are kept as available_externally copies so their attributes can
+// still be inferred.
+//
+// With a cache directory, as for -cache-ir, every kernel gets its own
+// partition and the optimized bitcode of each partition is cached, keyed on
+// the reduced module it starts from: the owned functions, the copies of their
+// callees and the declarations of everything else. Editing a helper only
+// misses the cache for the partitions of the kernels that reach it, and the
+// other partitions are linked back from the cache without being optimized
+// again.
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/IPO.h"
+
+#include "CallGraphOrderedFunctions.h"
+#include "CompileCache.h"
+#include "NewPassManager.h"
+#include "Passes.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "ParallelOptimize"
+
+namespace {
+struct ParallelOptimizePass : public ModulePass {
+  static char ID;
+  ParallelOptimizePass(unsigned jobs = 0, unsigned opt_level = 2,
+                       unsigned size_level = 0, std::string cache_dir = "",
+                       uint64_t cache_max_size = 0)
+      : ModulePass(ID), Jobs(jobs), OptLevel(opt_level),
+        SizeLevel(size_level), CacheDir(std::move(cache_dir)),
+        CacheMaxSize(cache_max_size) {}
+
+  bool runOnModule(Module &M) override;
+
+private:
+  // The functions of a partition, by name.
+  struct Partition {
+    // The functions defined by the partition.
+    StringSet<> Owned;
+    // The callees of owned functions that another partition defines.
+    StringSet<> Copied;
+    // The number of instructions of the owned functions.
+    size_t Size = 0;
+    // The optimized partition, as bitcode.
+    SmallVector<char, 0> Result;
+  };
+
+  // Optimizes |P| in a new context, starting from the module in |Bitcode|,
+  // or takes the result from the cache.
+  void OptimizePartition(StringRef Bitcode, Partition &P) const;
+
+  unsigned Jobs;
+  unsigned OptLevel;
+  unsigned SizeLevel;
+  // The compile cache directory, or empty if partitions are not cached.
+  std::string CacheDir;
+  // The maximum size of the cache, in bytes.
+  uint64_t CacheMaxSize;
+};
+
+// Returns the defined functions called from |F|, directly or not, including
+// |F| itself, in the order of |Ordered|.
+SetVector<Function *> ReachedFunctions(Function *F,
+                                       const SetVector<Function *> &Ordered) {
+  SmallPtrSet<Function *, 8> Reached;
+  SmallVector<Function *, 8> Worklist{F};
+  Reached.insert(F);
+  while (!Worklist.empty()) {
+    auto *Caller = Worklist.pop_back_val();
+    for (auto &I : instructions(*Caller)) {
+      if (auto *Call = dyn_cast<CallInst>(&I)) {
+        auto *Callee = Call->getCalledFunction();
+        if (Callee && !Callee->isDeclaration() && Reached.insert(Callee).second)
+          Worklist.push_back(Callee);
+      }
+    }
+  }
+
+  SetVector<Function *> Result;
+  for (auto *G : Ordered) {
+    if (Reached.count(G))
+      Result.insert(G);
+  }
+  return Result;
+}
+} // namespace
+
+char ParallelOptimizePass::ID = 0;
+INITIALIZE_PASS(ParallelOptimizePass, "ParallelOptimize",
+                "Run the LLVM optimizations on kernels in parallel", false,
+                false)
+
+namespace clspv {
+ModulePass *createParallelOptimizePass(unsigned jobs, unsigned opt_level,
+                                       unsigned size_level,
+                                       const std::string &cache_dir,
+                                       uint64_t cache_max_size) {
+  return new ParallelOptimizePass(jobs, opt_level, size_level, cache_dir,
+                                  cache_max_size);
+}
+} // namespace clspv
+
+bool ParallelOptimizePass::runOnModule(Module &M) {
+  const auto Ordered = clspv::CallGraphOrderedFunctions(M);
+  SmallVector<Function *, 8> Kernels;
+  for (auto *F : Ordered) {
+    if (F->getCallingConv() == CallingConv::SPIR_KERNEL)
+      Kernels.push_back(F);
+  }
+
+  unsigned NumThreads = Jobs;
+  if (NumThreads == 0) {
+    NumThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // Cached partitions hold one kernel each, whatever the number of threads,
+  // so that they are reused for as many kernels as possible.
+  unsigned NumPartitions = CacheDir.empty() ? NumThreads : Kernels.size();
+  NumPartitions =
+      std::min(NumPartitions, static_cast<unsigned>(Kernels.size()));
+  NumThreads = std::min(NumThreads, NumPartitions);
+  if (NumPartitions <= 1) {
+    clspv::RunDefaultPipeline(M, OptLevel, SizeLevel);
+    return true;
+  }
+
+  // Every partition must be able to refer to the globals of the others, so
+  // local globals are made external, with a name, until the partitions are
+  // linked back.
+  struct SavedLinkage {
+    std::string Name;
+    GlobalValue::LinkageTypes Linkage;
+    bool HadName;
+  };
+  std::vector<SavedLinkage> Saved;
+  unsigned NextName = 0;
+  for (auto &GV : M.global_values()) {
+    if (!GV.hasLocalLinkage())
+      continue;
+    const bool HadName = GV.hasName();
+    if (!HadName)
+      GV.setName("clspv.parallel." + Twine(NextName++));
+    Saved.push_back({GV.getName().str(), GV.getLinkage(), HadName});
+    GV.setLinkage(GlobalValue::ExternalLinkage);
+  }
+
+  // Each kernel goes to the smallest partition so far, with the functions it
+  // is the first to reach. Functions no kernel reaches go to the first
+  // partition.
+  std::vector<Partition> Partitions(NumPartitions);
+  DenseMap<Function *, unsigned> Owner;
+  for (auto *Kernel : Kernels) {
+    unsigned Index = 0;
+    for (unsigned I = 1; I < NumPartitions; ++I) {
+      if (Partitions[I].Size < Partitions[Index].Size)
+        Index = I;
+    }
+    for (auto *F : ReachedFunctions(Kernel, Ordered)) {
+      auto Inserted = Owner.try_emplace(F, Index);
+      if (Inserted.second)
+        Partitions[Index].Size += F->getInstructionCount();
+      else if (Inserted.first->second != Index)
+        Partitions[Index].Copied.insert(F->getName());
+    }
+  }
+  for (auto &F : M) {
+    if (!F.isDeclaration())
+      Owner.try_emplace(&F, 0);
+  }
+
+  for (auto &Entry : Owner) {
+    Partitions[Entry.second].Owned.insert(Entry.first->getName());
+  }
+
+  SmallVector<char, 0> Bitcode;
+  {
+    raw_svector_ostream Stream(Bitcode);
+    WriteBitcodeToFile(M, Stream);
+  }
+  const StringRef BitcodeRef(Bitcode.data(), Bitcode.size());
+
+  std::atomic<unsigned> Next(0);
+  auto Worker = [this, BitcodeRef, &Partitions, &Next]() {
+    for (unsigned I = Next++; I < Partitions.size(); I = Next++) {
+      OptimizePartition(BitcodeRef, Partitions[I]);
+    }
+  };
+  std::vector<std::thread> Threads;
+  for (unsigned I = 1; I < NumThreads; ++I) {
+    Threads.emplace_back(Worker);
+  }
+  Worker();
+  for (auto &Thread : Threads) {
+    Thread.join();
+  }
+
+  // Replace the functions by their optimized definitions.
+  for (auto &Entry : Owner) {
+    Entry.first->deleteBody();
+  }
+  for (auto &P : Partitions) {
+    auto Optimized = parseBitcodeFile(
+        MemoryBufferRef(StringRef(P.Result.data(), P.Result.size()),
+                        "ParallelOptimize"),
+        M.getContext());
+    if (!Optimized) {
+      report_fatal_error(Twine("ParallelOptimize: ") +
+                         toString(Optimized.takeError()));
+    }
+    if (Linker::linkModules(M, std::move(*Optimized))) {
+      report_fatal_error("ParallelOptimize: failed to link a partition");
+    }
+  }
+
+  for (auto &S : Saved) {
+    if (auto *GV = M.getNamedValue(S.Name)) {
+      GV->setLinkage(S.Linkage);
+      if (!S.HadName)
+        GV->setName("");
+    }
+  }
+
+  // The partitions could not remove the local globals they no longer use.
+  legacy::PassManager Cleanup;
+  Cleanup.add(createGlobalDCEPass());
+  Cleanup.run(M);
+
+  return true;
+}
+
+void ParallelOptimizePass::OptimizePartition(StringRef Bitcode,
+                                             Partition &P) const {
+  LLVMContext Context;
+  auto Parsed =
+      parseBitcodeFile(MemoryBufferRef(Bitcode, "ParallelOptimize"), Context);
+  if (!Parsed) {
+    report_fatal_error(Twine("ParallelOptimize: ") +
+                       toString(Parsed.takeError()));
+  }
+  Module &M = **Parsed;
+
+  for (auto &F : M) {
+    if (F.isDeclaration() || P.Owned.count(F.getName()))
+      continue;
+    if (P.Copied.count(F.getName()))
+      F.setLinkage(GlobalValue::AvailableExternallyLinkage);
+    else
+      F.deleteBody();
+  }
+  // Constants keep their initializer so loads from them can still fold.
+  for (auto &GV : M.globals()) {
+    if (GV.isDeclaration())
+      continue;
+    if (GV.isConstant()) {
+      GV.setLinkage(GlobalValue::AvailableExternallyLinkage);
+    } else {
+      GV.setInitializer(nullptr);
+      GV.setLinkage(GlobalValue::ExternalLinkage);
+    }
+  }
+  // The module being optimized keeps its own.
+  while (!M.named_metadata_empty()) {
+    M.eraseNamedMetadata(&*M.named_metadata_begin());
+  }
+
+  // The reduced module is all the pipeline sees, so it determines the result.
+  std::string Key;
+  if (!CacheDir.empty()) {
+    std::string Text;
+    raw_string_ostream Str(Text);
+    M.print(Str, nullptr);
+    Key = clspv::CompileCache::Key(
+        Str.str(), "",
+        {"<partition>", std::to_string(OptLevel), std::to_string(SizeLevel)});
+    std::vector<char> Contents;
+    if (clspv::CompileCache::Lookup(CacheDir, Key, &Contents)) {
+      P.Result.assign(Contents.begin(), Contents.end());
+      return;
+    }
+  }
+
+  clspv::RunDefaultPipeline(M, OptLevel, SizeLevel);
+
+  // Only the owned functions, and the globals the pipeline created, are
+  // linked back.
+  for (auto &F : M) {
+    if (F.hasAvailableExternallyLinkage())
+      F.deleteBody();
+  }
+  for (auto &GV : M.globals()) {
+    if (GV.hasAvailableExternallyLinkage()) {
+      GV.setInitializer(nullptr);
+      GV.setLinkage(GlobalValue::ExternalLinkage);
+    }
+  }
+
+  raw_svector_ostream Stream(P.Result);
+  WriteBitcodeToFile(M, Stream);
+  if (!Key.empty()) {
+    clspv::CompileCache::Store(CacheDir, Key,
+                               StringRef(P.Result.data(), P.Result.size()),
+                               CacheMaxSize);
+  }
+}
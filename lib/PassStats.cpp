@@ -0,0 +1,163 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "PassStats.h"
+
+#include <algorithm>
+
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace {
+
+uint64_t CountInstructions(const llvm::Module &M) {
+  uint64_t count = 0;
+  for (const auto &F : M) {
+    count += F.getInstructionCount();
+  }
+  return count;
+}
+
+uint64_t CountBasicBlocks(const llvm::Module &M) {
+  uint64_t count = 0;
+  for (const auto &F : M) {
+    count += F.size();
+  }
+  return count;
+}
+
+// Marks the start of the pass that follows it.
+struct PassStatsBeginPass final : public llvm::ModulePass {
+  static char ID;
+  PassStatsBeginPass(clspv::PassStats *stats, llvm::StringRef name)
+      : ModulePass(ID), stats(stats), name(name) {}
+
+  llvm::StringRef getPassName() const override { return "PassStatsBegin"; }
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+  bool runOnModule(llvm::Module &M) override {
+    stats->begin(name, M);
+    return false;
+  }
+
+  clspv::PassStats *stats;
+  std::string name;
+};
+
+// Marks the end of the pass that precedes it.
+struct PassStatsEndPass final : public llvm::ModulePass {
+  static char ID;
+  explicit PassStatsEndPass(clspv::PassStats *stats)
+      : ModulePass(ID), stats(stats) {}
+
+  llvm::StringRef getPassName() const override { return "PassStatsEnd"; }
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+  bool runOnModule(llvm::Module &M) override {
+    stats->end(M);
+    return false;
+  }
+
+  clspv::PassStats *stats;
+};
+
+char PassStatsBeginPass::ID = 0;
+char PassStatsEndPass::ID = 0;
+
+} // namespace
+
+namespace clspv {
+
+void PassStats::begin(llvm::StringRef name, llvm::Module &M) {
+  Entry entry;
+  entry.name = name.str();
+  entry.instructions_before = CountInstructions(M);
+  entry.blocks_before = CountBasicBlocks(M);
+  entry.malloc_bytes_before = llvm::sys::Process::GetMallocUsage();
+  peak_malloc_bytes_ = std::max(peak_malloc_bytes_, entry.malloc_bytes_before);
+  entries_.push_back(entry);
+  start_ = std::chrono::steady_clock::now();
+}
+
+void PassStats::end(llvm::Module &M) {
+  auto &entry = entries_.back();
+  entry.wall_seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start_)
+          .count();
+  entry.instructions_after = CountInstructions(M);
+  entry.blocks_after = CountBasicBlocks(M);
+  entry.malloc_bytes_after = llvm::sys::Process::GetMallocUsage();
+  peak_malloc_bytes_ = std::max(peak_malloc_bytes_, entry.malloc_bytes_after);
+}
+
+void PassStats::writeJSON(llvm::raw_ostream &out) const {
+  double total_seconds = 0;
+  llvm::json::OStream json(out, 2);
+  json.object([&] {
+    json.attributeArray("passes", [&] {
+      for (const auto &entry : entries_) {
+        total_seconds += entry.wall_seconds;
+        json.object([&] {
+          json.attribute("name", entry.name);
+          json.attribute("wall_seconds", entry.wall_seconds);
+          json.attribute("instructions_before",
+                         int64_t(entry.instructions_before));
+          json.attribute("instructions_after",
+                         int64_t(entry.instructions_after));
+          json.attribute("malloc_bytes_before",
+                         int64_t(entry.malloc_bytes_before));
+          json.attribute("malloc_bytes_after",
+                         int64_t(entry.malloc_bytes_after));
+          json.attribute("blocks_before", int64_t(entry.blocks_before));
+          json.attribute("blocks_after", int64_t(entry.blocks_after));
+        });
+      }
+    });
+    json.attribute("cache_hit", cache_hit_);
+    json.attribute("total_wall_seconds", total_seconds);
+    json.attribute("peak_malloc_bytes", int64_t(peak_malloc_bytes_));
+  });
+  out << "\n";
+}
+
+int PassStats::writeJSONFile(llvm::StringRef filename) const {
+  std::error_code error;
+  llvm::raw_fd_ostream out(filename, error, llvm::sys::fs::OF_Text);
+  if (error) {
+    llvm::errs() << "Unable to open pass statistics file '" << filename
+                 << "': " << error.message() << '\n';
+    return -1;
+  }
+  writeJSON(out);
+  return 0;
+}
+
+void PassStatsManager::add(llvm::Pass *P) {
+  if (!stats_) {
+    llvm::legacy::PassManager::add(P);
+    return;
+  }
+  llvm::legacy::PassManager::add(
+      new PassStatsBeginPass(stats_, P->getPassName()));
+  llvm::legacy::PassManager::add(P);
+  llvm::legacy::PassManager::add(new PassStatsEndPass(stats_));
+}
+
+} // namespace clspv
@@ -0,0 +1,88 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_LIB_PASS_STATS_H_
+#define CLSPV_LIB_PASS_STATS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/LegacyPassManager.h"
+
+namespace llvm {
+class Module;
+class Pass;
+class raw_ostream;
+} // namespace llvm
+
+namespace clspv {
+
+// Collects per-pass statistics for one run of a pass pipeline.
+class PassStats {
+public:
+  struct Entry {
+    std::string name;
+    double wall_seconds = 0;
+    uint64_t instructions_before = 0;
+    uint64_t instructions_after = 0;
+    uint64_t malloc_bytes_before = 0;
+    uint64_t malloc_bytes_after = 0;
+    uint64_t blocks_before = 0;
+    uint64_t blocks_after = 0;
+  };
+
+  // Called right before and after the pass named |name| runs on |M|.
+  void begin(llvm::StringRef name, llvm::Module &M);
+  void end(llvm::Module &M);
+
+  const std::vector<Entry> &entries() const { return entries_; }
+
+  // Records that the compilation was answered from the compile cache, so no
+  // pass ran.
+  void setCacheHit() { cache_hit_ = true; }
+
+  // Writes the statistics as a JSON object to |out|.
+  void writeJSON(llvm::raw_ostream &out) const;
+
+  // Writes the statistics as JSON to the file |filename|.  Returns 0 if
+  // successful.
+  int writeJSONFile(llvm::StringRef filename) const;
+
+private:
+  std::vector<Entry> entries_;
+  std::chrono::steady_clock::time_point start_;
+  uint64_t peak_malloc_bytes_ = 0;
+  bool cache_hit_ = false;
+};
+
+// A pass manager that records statistics for every pass added to it into
+// |stats|.  This brackets each pass with a pair of module passes, so function
+// passes are no longer interleaved per function: only use it when statistics
+// were requested.  With a null |stats| this is a plain legacy pass manager.
+class PassStatsManager : public llvm::legacy::PassManager {
+public:
+  explicit PassStatsManager(PassStats *stats) : stats_(stats) {}
+
+  void add(llvm::Pass *P) override;
+
+private:
+  PassStats *stats_;
+};
+
+} // namespace clspv
+
+#endif // CLSPV_LIB_PASS_STATS_H_
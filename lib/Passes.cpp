@@ -18,6 +18,8 @@ namespace llvm {
 
 void initializeClspvPasses(PassRegistry &r) {
   initializeAddFunctionAttributesPassPass(r);
+  initializeAggregateAtomicsPassPass(r);
+  initializeAssumeInt64ArgRangesPassPass(r);
   initializeAutoPodArgsPassPass(r);
   initializeAllocateDescriptorsPassPass(r);
   initializeClusterModuleScopeConstantVarsPass(r);
@@ -25,29 +27,46 @@ void initializeClspvPasses(PassRegistry &r) {
   initializeDirectResourceAccessPassPass(r);
   initializeDeclarePushConstantsPassPass(r);
   initializeDefineOpenCLWorkItemBuiltinsPassPass(r);
-  initializeFixupStructuredCFGPassPass(r);
+  initializeFixupStructuredCFGLegacyPassPass(r);
   initializeFunctionInternalizerPassPass(r);
+  initializeFuseKernelsPassPass(r);
   initializeHideConstantLoadsPassPass(r);
+  initializeHoistAccessChainsPassPass(r);
   initializeUnhideConstantLoadsPassPass(r);
+  initializeInlineByCostPassPass(r);
   initializeInlineEntryPointsPassPass(r);
   initializeInlineFuncWithPointerBitCastArgPassPass(r);
   initializeInlineFuncWithPointerToFunctionArgPassPass(r);
   initializeInlineFuncWithSingleCallSitePassPass(r);
   initializeLongVectorLoweringPassPass(r);
+  initializeMarkSourceLoopHintsPassPass(r);
   initializeMultiVersionUBOFunctionsPassPass(r);
+  initializeNarrowHalfArithmeticPassPass(r);
+  initializeNarrowInt64ArithmeticPassPass(r);
+  initializeNarrowIntegerArithmeticPassPass(r);
   initializeOpenCLInlinerPassPass(r);
+  initializeOptimizeBarriersPassPass(r);
+  initializeParallelOptimizePassPass(r);
+  initializePhysicalStorageBufferArgsPassPass(r);
+  initializePodSpecConstantArgsPassPass(r);
+  initializePreserveLoopMetadataPassPass(r);
+  initializeProfileCountersPassPass(r);
+  initializePromotePrivateArraysPassPass(r);
   initializeRemoveUnusedArgumentsPass(r);
-  initializeReorderBasicBlocksPassPass(r);
+  initializeReorderBasicBlocksLegacyPassPass(r);
   initializeReplaceLLVMIntrinsicsPassPass(r);
   initializeReplaceOpenCLBuiltinPassPass(r);
   initializeReplacePointerBitcastPassPass(r);
   initializeRewriteInsertsPassPass(r);
   initializeScalarizePassPass(r);
+  initializeSelectEntryPointsPassPass(r);
+  initializeSelectiveStructurizeCFGPassPass(r);
   initializeShareModuleScopeVariablesPassPass(r);
   initializeSignedCompareFixupPassPass(r);
   initializeSimplifyPointerBitcastPassPass(r);
   initializeSplatArgPassPass(r);
   initializeSplatSelectConditionPassPass(r);
+  initializeSpecializeGenericAddressSpacePassPass(r);
   initializeSpecializeImageTypesPassPass(r);
   initializeStripFreezePassPass(r);
   initializeUBOTypeTransformPassPass(r);
@@ -58,6 +77,8 @@ void initializeClspvPasses(PassRegistry &r) {
   initializeUndoSRetPassPass(r);
   initializeUndoTranslateSamplerFoldPassPass(r);
   initializeUndoTruncateToOddIntegerPassPass(r);
+  initializeUntypedBuffersPassPass(r);
+  initializeWidenVec3AccessesPassPass(r);
   initializeZeroInitializeAllocasPassPass(r);
 }
 
@@ -21,6 +21,8 @@ class PassRegistry;
 // Individual pass initializers.  See the documentation for
 // initializeClspvPasses() in include/clspv/Passes.h.
 void initializeAddFunctionAttributesPassPass(PassRegistry &);
+void initializeAggregateAtomicsPassPass(PassRegistry &);
+void initializeAssumeInt64ArgRangesPassPass(PassRegistry &);
 void initializeAutoPodArgsPassPass(PassRegistry &);
 void initializeAllocateDescriptorsPassPass(PassRegistry &);
 void initializeClusterModuleScopeConstantVarsPass(PassRegistry &);
@@ -28,29 +30,46 @@ void initializeClusterPodKernelArgumentsPassPass(PassRegistry &);
 void initializeDeclarePushConstantsPassPass(PassRegistry &);
 void initializeDefineOpenCLWorkItemBuiltinsPassPass(PassRegistry &);
 void initializeDirectResourceAccessPassPass(PassRegistry &);
-void initializeFixupStructuredCFGPassPass(PassRegistry &);
+void initializeFixupStructuredCFGLegacyPassPass(PassRegistry &);
 void initializeFunctionInternalizerPassPass(PassRegistry &);
+void initializeFuseKernelsPassPass(PassRegistry &);
 void initializeHideConstantLoadsPassPass(PassRegistry &);
+void initializeHoistAccessChainsPassPass(PassRegistry &);
 void initializeUnhideConstantLoadsPassPass(PassRegistry &);
+void initializeInlineByCostPassPass(PassRegistry &);
 void initializeInlineEntryPointsPassPass(PassRegistry &);
 void initializeInlineFuncWithPointerBitCastArgPassPass(PassRegistry &);
 void initializeInlineFuncWithPointerToFunctionArgPassPass(PassRegistry &);
 void initializeInlineFuncWithSingleCallSitePassPass(PassRegistry &);
 void initializeLongVectorLoweringPassPass(PassRegistry &);
+void initializeMarkSourceLoopHintsPassPass(PassRegistry &);
 void initializeMultiVersionUBOFunctionsPassPass(PassRegistry &);
+void initializeNarrowHalfArithmeticPassPass(PassRegistry &);
+void initializeNarrowInt64ArithmeticPassPass(PassRegistry &);
+void initializeNarrowIntegerArithmeticPassPass(PassRegistry &);
 void initializeOpenCLInlinerPassPass(PassRegistry &);
+void initializeOptimizeBarriersPassPass(PassRegistry &);
+void initializeParallelOptimizePassPass(PassRegistry &);
+void initializePhysicalStorageBufferArgsPassPass(PassRegistry &);
+void initializePodSpecConstantArgsPassPass(PassRegistry &);
+void initializePreserveLoopMetadataPassPass(PassRegistry &);
+void initializeProfileCountersPassPass(PassRegistry &);
+void initializePromotePrivateArraysPassPass(PassRegistry &);
 void initializeRemoveUnusedArgumentsPass(PassRegistry &);
-void initializeReorderBasicBlocksPassPass(PassRegistry &);
+void initializeReorderBasicBlocksLegacyPassPass(PassRegistry &);
 void initializeReplaceLLVMIntrinsicsPassPass(PassRegistry &);
 void initializeReplaceOpenCLBuiltinPassPass(PassRegistry &);
 void initializeReplacePointerBitcastPassPass(PassRegistry &);
 void initializeRewriteInsertsPassPass(PassRegistry &);
 void initializeScalarizePassPass(PassRegistry &);
+void initializeSelectEntryPointsPassPass(PassRegistry &);
+void initializeSelectiveStructurizeCFGPassPass(PassRegistry &);
 void initializeShareModuleScopeVariablesPassPass(PassRegistry &);
 void initializeSignedCompareFixupPassPass(PassRegistry &);
 void initializeSimplifyPointerBitcastPassPass(PassRegistry &);
 void initializeSplatArgPassPass(PassRegistry &);
 void initializeSplatSelectConditionPassPass(PassRegistry &);
+void initializeSpecializeGenericAddressSpacePassPass(PassRegistry &);
 void initializeSpecializeImageTypesPassPass(PassRegistry &);
 void initializeStripFreezePassPass(PassRegistry &);
 void initializeUBOTypeTransformPassPass(PassRegistry &);
@@ -61,6 +80,8 @@ void initializeUndoInstCombinePassPass(PassRegistry &);
 void initializeUndoSRetPassPass(PassRegistry &);
 void initializeUndoTranslateSamplerFoldPassPass(PassRegistry &);
 void initializeUndoTruncateToOddIntegerPassPass(PassRegistry &);
+void initializeUntypedBuffersPassPass(PassRegistry &);
+void initializeWidenVec3AccessesPassPass(PassRegistry &);
 void initializeZeroInitializeAllocasPassPass(PassRegistry &);
 } // namespace llvm
 
@@ -0,0 +1,167 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Rewrites the __global and __constant pointer arguments of kernels as 64-bit
+// device addresses. Each such argument becomes an i64 POD argument, so it is
+// clustered with the other POD arguments, and its uses are fed by a call
+//   %p = call T addrspace(1)* @clspv.physical_pointer.N(i64 %addr)
+// which the SPIR-V producer turns into an OpConvertUToPtr to a
+// PhysicalStorageBuffer pointer. A call is used instead of an inttoptr
+// because the 32-bit pointers of the module would let LLVM truncate the
+// address. A __constant argument gets an addrspace(2) pointer, which the
+// producer conflates with __global.
+//
+// The buffers of a kernel then take a single push constant or uniform buffer
+// block, however many there are.
+
+#include <string>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "clspv/AddressSpace.h"
+#include "clspv/Option.h"
+
+#include "Constants.h"
+#include "Passes.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "PhysicalStorageBufferArgs"
+
+namespace {
+// Returns true if |type| is a pointer to memory passed as a device address.
+bool IsBufferPointer(Type *type) {
+  auto *PTy = dyn_cast<PointerType>(type);
+  return PTy && (PTy->getAddressSpace() == clspv::AddressSpace::Global ||
+                 PTy->getAddressSpace() == clspv::AddressSpace::Constant);
+}
+
+struct PhysicalStorageBufferArgsPass : public ModulePass {
+  static char ID;
+  PhysicalStorageBufferArgsPass() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override;
+
+private:
+  // Returns the function converting a device address to a pointer of type
+  // |type|, creating it if needed.
+  Function *getPhysicalPointerFunction(Module &M, PointerType *type);
+
+  DenseMap<PointerType *, Function *> PointerFunctions;
+};
+} // namespace
+
+char PhysicalStorageBufferArgsPass::ID = 0;
+INITIALIZE_PASS(PhysicalStorageBufferArgsPass, "PhysicalStorageBufferArgs",
+                "Physical Storage Buffer Arguments Pass", false, false)
+
+namespace clspv {
+ModulePass *createPhysicalStorageBufferArgsPass() {
+  return new PhysicalStorageBufferArgsPass();
+}
+} // namespace clspv
+
+bool PhysicalStorageBufferArgsPass::runOnModule(Module &M) {
+  if (!clspv::Option::PhysicalStorageBuffers())
+    return false;
+
+  SmallVector<Function *, 8> kernels;
+  for (auto &F : M) {
+    if (F.isDeclaration() || F.getCallingConv() != CallingConv::SPIR_KERNEL)
+      continue;
+    for (auto &Arg : F.args()) {
+      if (IsBufferPointer(Arg.getType())) {
+        kernels.push_back(&F);
+        break;
+      }
+    }
+  }
+
+  auto *Int64Ty = Type::getInt64Ty(M.getContext());
+  for (auto *F : kernels) {
+    // Callers would pass pointers, which cannot be turned back into device
+    // addresses.
+    if (!F->use_empty()) {
+      errs() << "error: -physical-storage-buffers cannot rewrite kernel "
+             << F->getName() << ", which is called from another kernel\n";
+      llvm_unreachable("Kernel with buffer pointer arguments is called");
+    }
+
+    SmallVector<Type *, 8> ParamTys;
+    for (auto &Arg : F->args()) {
+      if (IsBufferPointer(Arg.getType()))
+        ParamTys.push_back(Int64Ty);
+      else
+        ParamTys.push_back(Arg.getType());
+    }
+
+    auto *NewFTy = FunctionType::get(F->getReturnType(), ParamTys, false);
+    auto *NewF = Function::Create(NewFTy, F->getLinkage());
+    M.getFunctionList().insert(F->getIterator(), NewF);
+    NewF->takeName(F);
+    NewF->setCallingConv(F->getCallingConv());
+    NewF->copyMetadata(F, 0);
+
+    // Pointer attributes such as noalias do not apply to the addresses.
+    auto Attributes = F->getAttributes();
+    for (unsigned i = 0; i < ParamTys.size(); ++i) {
+      if (ParamTys[i] != F->getFunctionType()->getParamType(i))
+        Attributes = Attributes.removeParamAttributes(M.getContext(), i);
+    }
+    NewF->setAttributes(Attributes);
+
+    NewF->getBasicBlockList().splice(NewF->begin(), F->getBasicBlockList());
+
+    IRBuilder<> Builder(&*NewF->getEntryBlock().getFirstInsertionPt());
+    for (auto &Arg : F->args()) {
+      auto *NewArg = NewF->getArg(Arg.getArgNo());
+      NewArg->takeName(&Arg);
+      if (NewArg->getType() == Arg.getType()) {
+        Arg.replaceAllUsesWith(NewArg);
+        continue;
+      }
+
+      auto *PTy = cast<PointerType>(Arg.getType());
+      auto *Ptr = Builder.CreateCall(getPhysicalPointerFunction(M, PTy),
+                                     {NewArg}, NewArg->getName() + ".ptr");
+      Arg.replaceAllUsesWith(Ptr);
+    }
+
+    F->eraseFromParent();
+  }
+
+  return !kernels.empty();
+}
+
+Function *
+PhysicalStorageBufferArgsPass::getPhysicalPointerFunction(Module &M,
+                                                          PointerType *type) {
+  auto &Fn = PointerFunctions[type];
+  if (!Fn) {
+    // The name only needs to be unique per pointer type.
+    auto Name = clspv::PhysicalPointerFunction() + "." +
+                std::to_string(PointerFunctions.size() - 1);
+    auto *FTy = FunctionType::get(type, {Type::getInt64Ty(M.getContext())},
+                                  false);
+    Fn = Function::Create(FTy, GlobalValue::ExternalLinkage, Name, M);
+    Fn->setDoesNotAccessMemory();
+    Fn->setDoesNotThrow();
+  }
+  return Fn;
+}
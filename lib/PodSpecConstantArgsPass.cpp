@@ -0,0 +1,136 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Reads the POD kernel arguments selected by -pod-spec-constants from
+// specialization constants. The uses of each such argument are replaced by
+//   %v = call T @clspv.pod_spec_constant.N(i32 spec_id)
+// which the SPIR-V producer maps to an OpSpecConstant decorated with the spec
+// id. The argument stays in place, so it keeps its POD slot and reflection,
+// and the kernel, ordinal and spec id are recorded in the
+// clspv.pod_spec_constants metadata for the reflection.
+
+#include <string>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "clspv/Option.h"
+
+#include "Constants.h"
+#include "Passes.h"
+#include "SpecConstant.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "PodSpecConstantArgs"
+
+namespace {
+struct PodSpecConstantArgsPass : public ModulePass {
+  static char ID;
+  PodSpecConstantArgsPass() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override;
+
+private:
+  // Returns the function reading a specialization constant of type |type|,
+  // creating it if needed.
+  Function *getSpecConstantFunction(Module &M, Type *type);
+
+  DenseMap<Type *, Function *> SpecConstantFunctions;
+};
+} // namespace
+
+char PodSpecConstantArgsPass::ID = 0;
+INITIALIZE_PASS(PodSpecConstantArgsPass, "PodSpecConstantArgs",
+                "POD Specialization Constant Arguments Pass", false, false)
+
+namespace clspv {
+ModulePass *createPodSpecConstantArgsPass() {
+  return new PodSpecConstantArgsPass();
+}
+} // namespace clspv
+
+bool PodSpecConstantArgsPass::runOnModule(Module &M) {
+  auto *Int32Ty = Type::getInt32Ty(M.getContext());
+  NamedMDNode *md = nullptr;
+  bool Changed = false;
+  for (auto &F : M) {
+    if (F.isDeclaration() || F.getCallingConv() != CallingConv::SPIR_KERNEL)
+      continue;
+
+    IRBuilder<> Builder(&*F.getEntryBlock().getFirstInsertionPt());
+    for (auto &Arg : F.args()) {
+      const auto ordinal = Arg.getArgNo();
+      if (!clspv::Option::IsPodSpecConstant(F.getName().str(), ordinal))
+        continue;
+
+      // A specialization constant holds a single scalar.
+      auto *Ty = Arg.getType();
+      if (!(Ty->isIntegerTy() && !Ty->isIntegerTy(1)) &&
+          !Ty->isFloatingPointTy()) {
+        errs() << "error: -pod-spec-constants argument " << ordinal
+               << " of kernel " << F.getName()
+               << " is not a scalar integer or floating point argument\n";
+        llvm_unreachable("Unsupported -pod-spec-constants argument");
+      }
+      // Callers would pass other values than the specialization constant.
+      if (!F.use_empty()) {
+        errs() << "error: -pod-spec-constants cannot rewrite kernel "
+               << F.getName() << ", which is called from another kernel\n";
+        llvm_unreachable("Kernel with specialized arguments is called");
+      }
+
+      const auto spec_id =
+          clspv::AllocateSpecConstant(&M, clspv::SpecConstant::kPodArgument);
+      auto *Value = Builder.CreateCall(getSpecConstantFunction(M, Ty),
+                                       {ConstantInt::get(Int32Ty, spec_id)},
+                                       Arg.getName() + ".spec");
+      Arg.replaceAllUsesWith(Value);
+
+      if (!md)
+        md = M.getOrInsertNamedMetadata(
+            clspv::PodSpecConstantMetadataName());
+      md->addOperand(MDTuple::get(
+          M.getContext(),
+          {MDString::get(M.getContext(), F.getName()),
+           ConstantAsMetadata::get(ConstantInt::get(Int32Ty, ordinal)),
+           ConstantAsMetadata::get(ConstantInt::get(Int32Ty, spec_id))}));
+      Changed = true;
+    }
+  }
+
+  return Changed;
+}
+
+Function *PodSpecConstantArgsPass::getSpecConstantFunction(Module &M,
+                                                           Type *type) {
+  auto &Fn = SpecConstantFunctions[type];
+  if (!Fn) {
+    // The name only needs to be unique per type.
+    auto Name = clspv::PodSpecConstantFunction() + "." +
+                std::to_string(SpecConstantFunctions.size() - 1);
+    auto *FTy =
+        FunctionType::get(type, {Type::getInt32Ty(M.getContext())}, false);
+    Fn = Function::Create(FTy, GlobalValue::ExternalLinkage, Name, M);
+    Fn->setDoesNotAccessMemory();
+    Fn->setDoesNotThrow();
+  }
+  return Fn;
+}
@@ -0,0 +1,76 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Copies the llvm.loop metadata of every loop onto the first non-phi
+// instruction of its header. The CFG structurizer rebuilds the terminators
+// of the blocks it visits, which drops the metadata from the latch branch,
+// but it keeps the other instructions. The SPIR-V producer reads the copy
+// back to choose the loop controls of the OpLoopMerge.
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+
+#include "Constants.h"
+#include "Passes.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "PreserveLoopMetadata"
+
+namespace {
+struct PreserveLoopMetadataPass : public FunctionPass {
+  static char ID;
+  PreserveLoopMetadataPass() : FunctionPass(ID) {}
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+};
+} // namespace
+
+char PreserveLoopMetadataPass::ID = 0;
+INITIALIZE_PASS(PreserveLoopMetadataPass, "PreserveLoopMetadata",
+                "Preserve Loop Metadata Pass", false, false)
+
+namespace clspv {
+FunctionPass *createPreserveLoopMetadataPass() {
+  return new PreserveLoopMetadataPass();
+}
+} // namespace clspv
+
+bool PreserveLoopMetadataPass::runOnFunction(Function &F) {
+  const LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+
+  bool Changed = false;
+  for (auto *L : LI.getLoopsInPreorder()) {
+    auto *loop_id = L->getLoopID();
+    if (!loop_id)
+      continue;
+
+    // A header holding only phis and its branch has nowhere to keep the
+    // metadata; that loop gets the default loop controls.
+    auto *anchor = L->getHeader()->getFirstNonPHI();
+    if (anchor->isTerminator())
+      continue;
+
+    anchor->setMetadata(clspv::LoopMetadataName(), loop_id);
+    Changed = true;
+  }
+
+  return Changed;
+}
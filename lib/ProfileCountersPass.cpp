@@ -0,0 +1,191 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Instruments the module for -profile-counters. Each basic block, or each
+// loop header, gets a 32-bit counter in the storage buffer
+//   @clspv.profile_counters = external addrspace(1) global { [0 x i32] }
+// which is atomically incremented every time an invocation enters the block.
+// The location of each counter is recorded, in counter order, in the
+// clspv.profile_counter_locations metadata for the reflection.
+//
+// From SPIR-V 1.3 the invocations of a subgroup entering the block together
+// are counted with a subgroup reduction, and only the lowest of them performs
+// the atomic add, which keeps the contention on the counters low.
+
+#include <string>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugLoc.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+#include "clspv/AddressSpace.h"
+#include "clspv/Option.h"
+
+#include "Constants.h"
+#include "Passes.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "ProfileCounters"
+
+namespace {
+struct ProfileCountersPass : public ModulePass {
+  static char ID;
+  ProfileCountersPass() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override;
+
+private:
+  // Returns the name of the counter of |BB|, the |index|th block of its
+  // function.
+  std::string getLocation(BasicBlock &BB, unsigned index);
+
+  // Increments the counter |index| of |counters| when an invocation enters
+  // |BB|.
+  void addIncrement(BasicBlock &BB, GlobalVariable *counters, unsigned index);
+
+  // Returns the declaration of the OpenCL builtin |name| of type |type|.
+  Function *getBuiltin(Module &M, StringRef name, FunctionType *type);
+};
+} // namespace
+
+char ProfileCountersPass::ID = 0;
+INITIALIZE_PASS(ProfileCountersPass, "ProfileCounters",
+                "Profile Counters Pass", false, false)
+
+namespace clspv {
+ModulePass *createProfileCountersPass() { return new ProfileCountersPass(); }
+} // namespace clspv
+
+bool ProfileCountersPass::runOnModule(Module &M) {
+  const auto mode = clspv::Option::ProfileCountersMode();
+  if (mode == clspv::Option::ProfileCounters::kNone)
+    return false;
+
+  auto &Ctx = M.getContext();
+  auto *CountersTy = StructType::get(ArrayType::get(Type::getInt32Ty(Ctx), 0));
+  auto *Counters = new GlobalVariable(
+      M, CountersTy, false, GlobalValue::ExternalLinkage, nullptr,
+      clspv::ProfileCountersName(), nullptr, GlobalValue::NotThreadLocal,
+      clspv::AddressSpace::Global);
+  auto *md = M.getOrInsertNamedMetadata(clspv::ProfileCountersMetadataName());
+
+  unsigned NumCounters = 0;
+  for (auto &F : M) {
+    if (F.isDeclaration())
+      continue;
+
+    // Pick the blocks before instrumenting any of them, as the subgroup
+    // aggregation splits them.
+    SmallVector<std::pair<BasicBlock *, unsigned>, 16> Blocks;
+    if (mode == clspv::Option::ProfileCounters::kBlocks) {
+      unsigned index = 0;
+      for (auto &BB : F)
+        Blocks.emplace_back(&BB, index++);
+    } else {
+      DominatorTree DT(F);
+      LoopInfo LI(DT);
+      unsigned index = 0;
+      for (auto &BB : F) {
+        if (LI.isLoopHeader(&BB))
+          Blocks.emplace_back(&BB, index);
+        ++index;
+      }
+    }
+
+    for (auto &entry : Blocks) {
+      auto *location =
+          MDString::get(Ctx, getLocation(*entry.first, entry.second));
+      md->addOperand(MDTuple::get(Ctx, {location}));
+      addIncrement(*entry.first, Counters, NumCounters++);
+    }
+  }
+
+  // Without loops there is nothing to count.
+  if (NumCounters == 0) {
+    Counters->eraseFromParent();
+    M.eraseNamedMetadata(md);
+    return false;
+  }
+
+  return true;
+}
+
+std::string ProfileCountersPass::getLocation(BasicBlock &BB, unsigned index) {
+  std::string location = BB.getParent()->getName().str() + ":";
+  if (BB.hasName())
+    location += BB.getName().str();
+  else
+    location += "bb" + std::to_string(index);
+
+  for (auto &I : BB) {
+    if (const auto &loc = I.getDebugLoc()) {
+      location += ":" + std::to_string(loc.getLine());
+      break;
+    }
+  }
+  return location;
+}
+
+void ProfileCountersPass::addIncrement(BasicBlock &BB,
+                                       GlobalVariable *counters,
+                                       unsigned index) {
+  auto &M = *BB.getModule();
+  auto *Int32Ty = Type::getInt32Ty(M.getContext());
+
+  // Function variables must stay at the start of the entry block.
+  auto InsertPt = BB.getFirstInsertionPt();
+  while (isa<AllocaInst>(&*InsertPt))
+    ++InsertPt;
+
+  IRBuilder<> Builder(&*InsertPt);
+  Value *Increment = ConstantInt::get(Int32Ty, 1);
+  if (clspv::Option::SpvVersion() >= clspv::Option::SPIRVVersion::SPIRV_1_3) {
+    // Count the invocations of the subgroup entering the block and let the
+    // lowest of them add that count.
+    auto *LocalIdTy = FunctionType::get(Int32Ty, false);
+    auto *ReduceTy = FunctionType::get(Int32Ty, {Int32Ty}, false);
+    auto *LocalId = Builder.CreateCall(
+        getBuiltin(M, "_Z22get_sub_group_local_idv", LocalIdTy));
+    auto *Leader = Builder.CreateCall(
+        getBuiltin(M, "_Z20sub_group_reduce_minj", ReduceTy), {LocalId});
+    Increment = Builder.CreateCall(
+        getBuiltin(M, "_Z20sub_group_reduce_addj", ReduceTy), {Increment});
+    auto *IsLeader = Builder.CreateICmpEQ(LocalId, Leader);
+    auto *Then = SplitBlockAndInsertIfThen(IsLeader, &*InsertPt, false);
+    Builder.SetInsertPoint(Then);
+  }
+
+  auto *Zero = ConstantInt::get(Int32Ty, 0);
+  auto *Counter = Builder.CreateGEP(
+      counters, {Zero, Zero, ConstantInt::get(Int32Ty, index)});
+  Builder.CreateAtomicRMW(AtomicRMWInst::Add, Counter, Increment,
+                          AtomicOrdering::Monotonic);
+}
+
+Function *ProfileCountersPass::getBuiltin(Module &M, StringRef name,
+                                          FunctionType *type) {
+  auto *Fn = cast<Function>(M.getOrInsertFunction(name, type).getCallee());
+  Fn->setConvergent();
+  Fn->setDoesNotThrow();
+  return Fn;
+}
@@ -0,0 +1,276 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Keeps small dynamically indexed private arrays in registers.
+//
+// SROA leaves arrays such as
+//   float acc[8];
+//   for (int i = 0; i < 8; ++i) acc[i] += ...;
+// in memory when they are indexed by a value it cannot resolve. They become
+// Function storage class variables, which many drivers spill to scratch
+// memory. With -private-array-promotion-threshold, an array of at most that
+// many scalars, only accessed one element at a time, is rewritten as:
+//  - a vector of up to 4 elements, read with extractelement and written with
+//    insertelement, which map to OpVectorExtractDynamic and
+//    OpVectorInsertDynamic; or
+//  - one value per element, read with a chain of selects on the index and
+//    written by selecting, for every element, between its old value and the
+//    new one.
+// The new values are then promoted to registers.
+
+#include <functional>
+
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Pass.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
+
+#include "clspv/Option.h"
+
+#include "Passes.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "PromotePrivateArrays"
+
+STATISTIC(NumVectorArrays, "Number of private arrays promoted to vectors");
+STATISTIC(NumSelectArrays,
+          "Number of private arrays promoted to select chains");
+STATISTIC(NumArraysTooLarge,
+          "Number of private arrays not promoted because of their size");
+
+namespace {
+struct PromotePrivateArraysPass : public FunctionPass {
+  static char ID;
+  PromotePrivateArraysPass() : FunctionPass(ID) {}
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  using LoadFn = std::function<Value *(IRBuilder<> &, Value *)>;
+  using StoreFn = std::function<void(IRBuilder<> &, Value *, Value *)>;
+
+  // Returns true if |alloca| is an array of scalars only accessed one element
+  // at a time or initialized by a constant, whatever its size.
+  static bool IsPromotable(AllocaInst *alloca);
+
+  // Replaces the accesses to |alloca| by calls to |load| and |store| with the
+  // index of the element, and removes it.
+  static void Rewrite(AllocaInst *alloca, const LoadFn &load,
+                      const StoreFn &store);
+};
+} // namespace
+
+char PromotePrivateArraysPass::ID = 0;
+INITIALIZE_PASS(PromotePrivateArraysPass, "PromotePrivateArrays",
+                "Promote small dynamically indexed private arrays", false,
+                false)
+
+namespace clspv {
+FunctionPass *createPromotePrivateArraysPass() {
+  return new PromotePrivateArraysPass();
+}
+} // namespace clspv
+
+bool PromotePrivateArraysPass::runOnFunction(Function &F) {
+  const unsigned threshold = clspv::Option::PrivateArrayPromotionThreshold();
+  if (threshold == 0)
+    return false;
+
+  SmallVector<AllocaInst *, 4> candidates;
+  for (auto &I : F.getEntryBlock()) {
+    auto *alloca = dyn_cast<AllocaInst>(&I);
+    if (!alloca || !IsPromotable(alloca))
+      continue;
+    if (alloca->getAllocatedType()->getArrayNumElements() > threshold) {
+      ++NumArraysTooLarge;
+      continue;
+    }
+    candidates.push_back(alloca);
+  }
+  if (candidates.empty())
+    return false;
+
+  SmallVector<AllocaInst *, 16> promoted;
+  for (auto *alloca : candidates) {
+    auto *array_ty = cast<ArrayType>(alloca->getAllocatedType());
+    auto *element_ty = array_ty->getElementType();
+    const unsigned size = array_ty->getNumElements();
+    IRBuilder<> builder(alloca);
+
+    // Vectors of i8 are packed into an i32 without the Int8 capability.
+    if (size <= 4 && !element_ty->isIntegerTy(8)) {
+      auto *vector_ty = FixedVectorType::get(element_ty, size);
+      auto *vector = builder.CreateAlloca(vector_ty);
+      vector->takeName(alloca);
+      Rewrite(
+          alloca,
+          [vector_ty, vector](IRBuilder<> &b, Value *index) {
+            return b.CreateExtractElement(b.CreateLoad(vector_ty, vector),
+                                          index);
+          },
+          [vector_ty, vector](IRBuilder<> &b, Value *index, Value *value) {
+            b.CreateStore(b.CreateInsertElement(
+                              b.CreateLoad(vector_ty, vector), value, index),
+                          vector);
+          });
+      promoted.push_back(vector);
+      ++NumVectorArrays;
+      continue;
+    }
+
+    SmallVector<AllocaInst *, 16> elements;
+    for (unsigned i = 0; i < size; ++i) {
+      elements.push_back(builder.CreateAlloca(element_ty));
+    }
+    Rewrite(
+        alloca,
+        [element_ty, &elements](IRBuilder<> &b, Value *index) -> Value * {
+          if (auto *constant = dyn_cast<ConstantInt>(index)) {
+            const auto i = constant->getLimitedValue();
+            if (i >= elements.size())
+              return UndefValue::get(element_ty);
+            return b.CreateLoad(element_ty, elements[i]);
+          }
+          Value *result = b.CreateLoad(element_ty, elements[0]);
+          for (unsigned i = 1; i < elements.size(); ++i) {
+            auto *is_i =
+                b.CreateICmpEQ(index, ConstantInt::get(index->getType(), i));
+            result = b.CreateSelect(
+                is_i, b.CreateLoad(element_ty, elements[i]), result);
+          }
+          return result;
+        },
+        [element_ty, &elements](IRBuilder<> &b, Value *index, Value *value) {
+          if (auto *constant = dyn_cast<ConstantInt>(index)) {
+            const auto i = constant->getLimitedValue();
+            if (i < elements.size())
+              b.CreateStore(value, elements[i]);
+            return;
+          }
+          for (unsigned i = 0; i < elements.size(); ++i) {
+            auto *is_i =
+                b.CreateICmpEQ(index, ConstantInt::get(index->getType(), i));
+            auto *old_value = b.CreateLoad(element_ty, elements[i]);
+            b.CreateStore(b.CreateSelect(is_i, value, old_value), elements[i]);
+          }
+        });
+    promoted.append(elements.begin(), elements.end());
+    ++NumSelectArrays;
+  }
+
+  auto &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  PromoteMemToReg(promoted, DT);
+  return true;
+}
+
+bool PromotePrivateArraysPass::IsPromotable(AllocaInst *alloca) {
+  auto *array_ty = dyn_cast<ArrayType>(alloca->getAllocatedType());
+  if (!alloca->isStaticAlloca() || !array_ty ||
+      array_ty->getNumElements() < 2)
+    return false;
+  auto *element_ty = array_ty->getElementType();
+  if (!element_ty->isFloatingPointTy() &&
+      !(element_ty->isIntegerTy() && !element_ty->isIntegerTy(1)))
+    return false;
+
+  for (auto *user : alloca->users()) {
+    if (auto *store = dyn_cast<StoreInst>(user)) {
+      // A whole array initializer.
+      if (store->isVolatile() || store->getPointerOperand() != alloca ||
+          !isa<Constant>(store->getValueOperand()))
+        return false;
+    } else if (auto *gep = dyn_cast<GetElementPtrInst>(user)) {
+      auto *first = dyn_cast<ConstantInt>(gep->getOperand(1));
+      if (gep->getNumIndices() != 2 || !first || !first->isZero())
+        return false;
+      for (auto *gep_user : gep->users()) {
+        if (auto *load = dyn_cast<LoadInst>(gep_user)) {
+          if (load->isVolatile())
+            return false;
+        } else if (auto *store = dyn_cast<StoreInst>(gep_user)) {
+          if (store->isVolatile() || store->getValueOperand() == gep)
+            return false;
+        } else {
+          return false;
+        }
+      }
+    } else if (isa<BitCastInst>(user)) {
+      for (auto *cast_user : user->users()) {
+        auto *intrinsic = dyn_cast<IntrinsicInst>(cast_user);
+        if (!intrinsic || !intrinsic->isLifetimeStartOrEnd())
+          return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+void PromotePrivateArraysPass::Rewrite(AllocaInst *alloca, const LoadFn &load,
+                                       const StoreFn &store) {
+  const unsigned size = alloca->getAllocatedType()->getArrayNumElements();
+  SmallVector<Instruction *, 16> dead;
+  for (auto *user : alloca->users()) {
+    auto *inst = cast<Instruction>(user);
+    if (auto *init = dyn_cast<StoreInst>(inst)) {
+      auto *value = cast<Constant>(init->getValueOperand());
+      if (!isa<UndefValue>(value)) {
+        IRBuilder<> builder(init);
+        for (unsigned i = 0; i < size; ++i) {
+          store(builder, builder.getInt32(i), value->getAggregateElement(i));
+        }
+      }
+    } else if (isa<GetElementPtrInst>(inst)) {
+      Value *index = inst->getOperand(2);
+      for (auto *gep_user : inst->users()) {
+        auto *access = cast<Instruction>(gep_user);
+        IRBuilder<> builder(access);
+        if (auto *ld = dyn_cast<LoadInst>(access)) {
+          auto *value = load(builder, index);
+          if (isa<Instruction>(value))
+            value->takeName(ld);
+          ld->replaceAllUsesWith(value);
+        } else {
+          store(builder, index, cast<StoreInst>(access)->getValueOperand());
+        }
+        dead.push_back(access);
+      }
+    } else {
+      // Lifetime markers.
+      for (auto *cast_user : inst->users()) {
+        dead.push_back(cast<Instruction>(cast_user));
+      }
+    }
+    dead.push_back(inst);
+  }
+  dead.push_back(alloca);
+
+  for (auto *inst : dead) {
+    inst->dropAllReferences();
+  }
+  for (auto *inst : dead) {
+    inst->eraseFromParent();
+  }
+}
@@ -131,7 +131,9 @@ bool ShouldDeclareGlobalOffsetPushConstant(Module &M) {
 }
 
 bool ShouldDeclareEnqueuedLocalSizePushConstant(Module &M) {
-  bool isEnabled = clspv::Option::NonUniformNDRangeSupported();
+  // With -local-size the enqueued local size is a constant.
+  bool isEnabled = clspv::Option::NonUniformNDRangeSupported() &&
+                   clspv::Option::LocalSize().empty();
   bool isUsed = M.getFunction("_Z23get_enqueued_local_sizej") != nullptr;
   return isEnabled && isUsed;
 }
@@ -17,12 +17,14 @@
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/Dominators.h"
+#include "llvm/IR/PassManager.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "clspv/Option.h"
 
 #include "ComputeStructuredOrder.h"
+#include "NewPassManager.h"
 #include "Passes.h"
 
 using namespace llvm;
@@ -30,39 +32,57 @@ using namespace llvm;
 #define DEBUG_TYPE "reorderbbs"
 
 namespace {
-struct ReorderBasicBlocksPass : public FunctionPass {
+// Lays out the blocks of |F| in structured order, or in dominance order.
+void ReorderBlocks(Function &F, DominatorTree &DT, const LoopInfo &LI);
+
+struct ReorderBasicBlocksLegacyPass : public FunctionPass {
   static char ID;
-  ReorderBasicBlocksPass() : FunctionPass(ID) {}
+  ReorderBasicBlocksLegacyPass() : FunctionPass(ID) {}
 
   void getAnalysisUsage(AnalysisUsage &AU) const override {
     AU.addRequired<DominatorTreeWrapperPass>();
     AU.addRequired<LoopInfoWrapperPass>();
+    // Moving blocks does not change the edges of the CFG.
+    AU.setPreservesCFG();
   }
 
   bool runOnFunction(Function &F) override;
 };
 } // namespace
 
-char ReorderBasicBlocksPass::ID = 0;
-INITIALIZE_PASS(ReorderBasicBlocksPass, "ReorderBasicBlocks",
+char ReorderBasicBlocksLegacyPass::ID = 0;
+INITIALIZE_PASS(ReorderBasicBlocksLegacyPass, "ReorderBasicBlocks",
                 "Reorder Basic Blocks Pass", false, false)
 
 namespace clspv {
 FunctionPass *createReorderBasicBlocksPass() {
-  return new ReorderBasicBlocksPass();
+  return new ReorderBasicBlocksLegacyPass();
+}
+
+PreservedAnalyses ReorderBasicBlocksPass::run(Function &F,
+                                              FunctionAnalysisManager &FAM) {
+  ReorderBlocks(F, FAM.getResult<DominatorTreeAnalysis>(F),
+                FAM.getResult<LoopAnalysis>(F));
+  // Moving blocks does not change the edges of the CFG.
+  PreservedAnalyses PA;
+  PA.preserveSet<CFGAnalyses>();
+  return PA;
 }
 } // namespace clspv
 
-bool ReorderBasicBlocksPass::runOnFunction(Function &F) {
-  bool Changed = false;
+bool ReorderBasicBlocksLegacyPass::runOnFunction(Function &F) {
+  ReorderBlocks(F, getAnalysis<DominatorTreeWrapperPass>().getDomTree(),
+                getAnalysis<LoopInfoWrapperPass>().getLoopInfo());
+  return false;
+}
 
-  DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+namespace {
+void ReorderBlocks(Function &F, DominatorTree &DT, const LoopInfo &LI) {
   if (clspv::Option::HackBlockOrder()) {
     // Order basic blocks according to structured order. Structured subgraphs
     // will be ordered contiguously within the binary.
     //
     // Assumes CFG has been structurized.
-    const LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
     std::deque<BasicBlock *> order;
     DenseSet<BasicBlock *> visited;
     clspv::ComputeStructuredOrder(&*F.begin(), &DT, LI, &order, &visited);
@@ -82,6 +102,5 @@ bool ReorderBasicBlocksPass::runOnFunction(Function &F) {
       BB->moveAfter(&F.back());
     }
   }
-
-  return Changed;
 }
+} // namespace
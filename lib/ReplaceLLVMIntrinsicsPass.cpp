@@ -23,8 +23,11 @@
 
 #include "spirv/unified1/spirv.hpp"
 
+#include "clspv/Option.h"
+
 #include "Constants.h"
 #include "Passes.h"
+#include "SPIRVOp.h"
 
 using namespace llvm;
 
@@ -40,7 +43,32 @@ struct ReplaceLLVMIntrinsicsPass final : public ModulePass {
   bool replaceMemset(Module &M);
   bool replaceMemcpy(Module &M);
   bool removeLifetimeDeclarations(Module &M);
+
+  // The declarations of the copies replacing the memcpys.
+  clspv::DeclarationCache Declarations;
 };
+
+// Replaces |CI| by a loop running |Count| times, and leaves |Builder| in the
+// body of the loop.  |CI| is moved to the block following the loop.  Returns
+// the index of the loop, counting from 0.
+PHINode *CreateCountedLoop(CallInst *CI, uint64_t Count, IRBuilder<> &Builder) {
+  auto I32Ty = Type::getInt32Ty(CI->getContext());
+  auto Preheader = CI->getParent();
+  auto Exit = Preheader->splitBasicBlock(CI, "mem.exit");
+  auto Loop = BasicBlock::Create(CI->getContext(), "mem.loop",
+                                 Preheader->getParent(), Exit);
+  Preheader->getTerminator()->setSuccessor(0, Loop);
+
+  Builder.SetInsertPoint(Loop);
+  auto Index = Builder.CreatePHI(I32Ty, 2);
+  Index->addIncoming(ConstantInt::get(I32Ty, 0), Preheader);
+  auto Next = Builder.CreateAdd(Index, ConstantInt::get(I32Ty, 1));
+  auto Cond = Builder.CreateICmpULT(Next, ConstantInt::get(I32Ty, Count));
+  Builder.CreateCondBr(Cond, Loop, Exit);
+  Index->addIncoming(Next, Loop);
+  Builder.SetInsertPoint(cast<Instruction>(Next));
+  return Index;
+}
 } // namespace
 
 char ReplaceLLVMIntrinsicsPass::ID = 0;
@@ -55,6 +83,7 @@ ModulePass *createReplaceLLVMIntrinsicsPass() {
 
 bool ReplaceLLVMIntrinsicsPass::runOnModule(Module &M) {
   bool Changed = false;
+  Declarations.reset(M);
 
   // Remove lifetime annotations first.  They could be using memset
   // and memcpy calls.
@@ -177,17 +206,25 @@ bool ReplaceLLVMIntrinsicsPass::replaceMemset(Module &M) {
                "Null memset can't be divided evenly across multiple stores.");
         assert((num_stores & 0xFFFFFFFF) == num_stores);
 
-        // Generate the first store.
-        new StoreInst(Zero, NewArg, CI);
-
-        // Generate subsequent stores, but only if needed.
-        if (num_stores) {
-          auto I32Ty = Type::getInt32Ty(M.getContext());
-          auto One = ConstantInt::get(I32Ty, 1);
-          auto Ptr = NewArg;
-          for (uint32_t i = 1; i < num_stores; i++) {
-            Ptr = GetElementPtrInst::Create(PointeeTy, Ptr, {One}, "", CI);
-            new StoreInst(Zero, Ptr, CI);
+        if (num_stores > clspv::Option::MemIntrinsicUnrollLimit()) {
+          // Store in a loop rather than unrolling a lot of stores.
+          IRBuilder<> Builder(CI);
+          auto Index = CreateCountedLoop(CI, num_stores, Builder);
+          auto Ptr = Builder.CreateGEP(PointeeTy, NewArg, Index);
+          Builder.CreateStore(Zero, Ptr);
+        } else {
+          // Generate the first store.
+          new StoreInst(Zero, NewArg, CI);
+
+          // Generate subsequent stores, but only if needed.
+          if (num_stores) {
+            auto I32Ty = Type::getInt32Ty(M.getContext());
+            auto One = ConstantInt::get(I32Ty, 1);
+            auto Ptr = NewArg;
+            for (uint32_t i = 1; i < num_stores; i++) {
+              Ptr = GetElementPtrInst::Create(PointeeTy, Ptr, {One}, "", CI);
+              new StoreInst(Zero, Ptr, CI);
+            }
           }
         }
 
@@ -352,8 +389,7 @@ bool ReplaceLLVMIntrinsicsPass::replaceMemcpy(Module &M) {
           auto NewFType = FunctionType::get(
               F.getReturnType(), {Dst->getType(), Src->getType(), I32Ty, I32Ty},
               false);
-          auto NewF =
-              Function::Create(NewFType, F.getLinkage(), SPIRVIntrinsic, &M);
+          auto NewF = Declarations.getFunction(SPIRVIntrinsic, NewFType);
           Builder.CreateCall(NewF, {Dst, Src, Alignment, Volatile}, "");
         } else {
           auto Zero = ConstantInt::get(I32Ty, 0);
@@ -372,33 +408,36 @@ bool ReplaceLLVMIntrinsicsPass::replaceMemcpy(Module &M) {
           SrcIndices.push_back(Zero);
           DstIndices.push_back(Zero);
 
-          // Build the function and function type only once.
-          FunctionType *NewFType = nullptr;
-          Function *NewF = nullptr;
-
-          IRBuilder<> Builder(CI);
-          for (unsigned i = 0; i < Size / DstElemSize; ++i) {
-            auto Index = ConstantInt::get(I32Ty, i);
+          // Copies element |Index| before |InsertBefore|.
+          auto copy_element = [&](Value *Index, Instruction *InsertBefore) {
             SrcIndices.back() = Index;
             DstIndices.back() = Index;
 
             // Avoid the builder for Src in order to prevent the folder from
             // creating constant expressions for constant memcpys.
-            auto SrcElemPtr =
-                GetElementPtrInst::CreateInBounds(Src, SrcIndices, "", CI);
+            auto SrcElemPtr = GetElementPtrInst::CreateInBounds(
+                Src, SrcIndices, "", InsertBefore);
+            IRBuilder<> Builder(InsertBefore);
             auto DstElemPtr = Builder.CreateGEP(Dst, DstIndices);
-            NewFType =
-                NewFType != nullptr
-                    ? NewFType
-                    : FunctionType::get(F.getReturnType(),
-                                        {DstElemPtr->getType(),
-                                         SrcElemPtr->getType(), I32Ty, I32Ty},
-                                        false);
-            NewF = NewF != nullptr ? NewF
-                                   : Function::Create(NewFType, F.getLinkage(),
-                                                      SPIRVIntrinsic, &M);
+            auto NewFType = FunctionType::get(
+                F.getReturnType(),
+                {DstElemPtr->getType(), SrcElemPtr->getType(), I32Ty, I32Ty},
+                false);
+            auto NewF = Declarations.getFunction(SPIRVIntrinsic, NewFType);
             Builder.CreateCall(
                 NewF, {DstElemPtr, SrcElemPtr, Alignment, Volatile}, "");
+          };
+
+          const auto NumCopies = Size / DstElemSize;
+          if (NumCopies > clspv::Option::MemIntrinsicUnrollLimit()) {
+            // Copy in a loop rather than unrolling a lot of copies.
+            IRBuilder<> LoopBuilder(CI);
+            auto Index = CreateCountedLoop(CI, NumCopies, LoopBuilder);
+            copy_element(Index, &*LoopBuilder.GetInsertPoint());
+          } else {
+            for (unsigned i = 0; i < NumCopies; ++i) {
+              copy_element(ConstantInt::get(I32Ty, i), CI);
+            }
           }
         }
 
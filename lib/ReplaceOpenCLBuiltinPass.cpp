@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cctype>
 #include <math.h>
 #include <string>
 #include <tuple>
@@ -33,6 +34,7 @@
 
 #include "clspv/AddressSpace.h"
 #include "clspv/Option.h"
+#include "clspv/Sampler.h"
 
 #include "Builtins.h"
 #include "Constants.h"
@@ -76,6 +78,50 @@ Type *getIntOrIntVectorTyForCast(LLVMContext &C, Type *Ty) {
   return IntTy;
 }
 
+// Returns true if the builtins called from |F| may be lowered to their native
+// precision. Clang marks functions with "unsafe-fp-math" under
+// -cl-fast-relaxed-math and -cl-unsafe-math-optimizations.
+bool AllowsRelaxedMath(const Function &F) {
+  return F.getFnAttribute("unsafe-fp-math").getValueAsString() == "true";
+}
+
+// Returns the mangling of the integer or integer vector type |Ty| as a signed
+// type. GetMangledTypeName always mangles integers as unsigned.
+std::string GetSignedMangledTypeName(Type *Ty) {
+  if (auto *vec_ty = dyn_cast<FixedVectorType>(Ty)) {
+    return "Dv" + std::to_string(vec_ty->getNumElements()) + "_" +
+           GetSignedMangledTypeName(vec_ty->getElementType());
+  }
+  switch (Ty->getIntegerBitWidth()) {
+  case 8:
+    return "c";
+  case 16:
+    return "s";
+  case 32:
+    return "i";
+  default:
+    return "l";
+  }
+}
+
+// Returns |C| splatted to the shape of |Ty|.
+Constant *SplatLike(Type *Ty, Constant *C) {
+  if (auto *vec_ty = dyn_cast<VectorType>(Ty))
+    return ConstantVector::getSplat(vec_ty->getElementCount(), C);
+  return C;
+}
+
+// Marks |I|, computing a half_ or native_ builtin, so the SPIR-V producer
+// decorates it RelaxedPrecision.
+Instruction *MarkRelaxedPrecision(Instruction *I) {
+  if (clspv::Option::RelaxedPrecisionMode() !=
+      clspv::Option::RelaxedPrecision::kNone) {
+    I->setMetadata(clspv::RelaxedPrecisionMetadataName(),
+                   MDNode::get(I->getContext(), {}));
+  }
+  return I;
+}
+
 Value *MemoryOrderSemantics(Value *order, bool is_global,
                             Instruction *InsertBefore,
                             spv::MemorySemanticsMask base_semantics) {
@@ -184,6 +230,55 @@ Value *MemoryScope(Value *scope, bool is_global, Instruction *InsertBefore) {
   return scope;
 }
 
+// Returns the pointer to |vec_ty| that |ptr| is a cast of, or nullptr if there
+// is none. vloadn and vstoren at offset i through such a pointer access its
+// element i, except for 3-element vectors, which are padded to 4 elements.
+Value *GetVectorBase(Value *ptr, VectorType *vec_ty) {
+  if (vec_ty->getElementCount().getKnownMinValue() == 3)
+    return nullptr;
+  auto *base = ptr->stripPointerCasts();
+  auto *base_ty = cast<PointerType>(base->getType());
+  if (base == ptr || base_ty->getElementType() != vec_ty ||
+      base_ty->getAddressSpace() != ptr->getType()->getPointerAddressSpace())
+    return nullptr;
+  return base;
+}
+
+// Returns true if 16-bit values can be loaded from and stored to |ptr|.
+bool Supports16BitStorage(Value *ptr) {
+  switch (ptr->getType()->getPointerAddressSpace()) {
+  case clspv::AddressSpace::Global:
+    return clspv::Option::Supports16BitStorageClass(
+        clspv::Option::StorageClass::kSSBO);
+  case clspv::AddressSpace::Constant:
+    if (clspv::Option::ConstantArgsInUniformBuffer())
+      return clspv::Option::Supports16BitStorageClass(
+          clspv::Option::StorageClass::kUBO);
+    return clspv::Option::Supports16BitStorageClass(
+        clspv::Option::StorageClass::kSSBO);
+  default:
+    // Clspv will emit the Float16 capability if the half type is
+    // encountered. That capability covers private and local addressspaces.
+    return true;
+  }
+}
+
+// Returns true if |sampler| is a literal sampler, and sets |value| to its
+// value.
+bool GetLiteralSampler(Value *sampler, uint64_t *value) {
+  auto call = dyn_cast<CallInst>(sampler);
+  if (!call || !call->getCalledFunction() ||
+      call->getCalledFunction()->getName() !=
+          clspv::TranslateSamplerInitializerFunction()) {
+    return false;
+  }
+  auto literal = dyn_cast<ConstantInt>(call->getArgOperand(0));
+  if (!literal)
+    return false;
+  *value = literal->getZExtValue();
+  return true;
+}
+
 bool replaceCallsWithValue(Function &F,
                            std::function<Value *(CallInst *)> Replacer) {
 
@@ -224,6 +319,7 @@ struct ReplaceOpenCLBuiltinPass final : public ModulePass {
 
 private:
   bool runOnFunction(Function &F);
+  bool widenVectorBufferArgs(Module &M);
   bool replaceAbs(Function &F);
   bool replaceAbsDiff(Function &F, bool is_signed);
   bool replaceCopysign(Function &F);
@@ -243,7 +339,9 @@ private:
   bool replaceAllAndAny(Function &F, spv::Op SPIRVOp);
   bool replaceUpsample(Function &F);
   bool replaceRotate(Function &F);
-  bool replaceConvert(Function &F, bool SrcIsSigned, bool DstIsSigned);
+  // |Rounding| is Dynamic for the default rounding of the conversion.
+  bool replaceConvert(Function &F, bool SrcIsSigned, bool DstIsSigned,
+                      bool IsSat, RoundingMode Rounding);
   bool replaceMulHi(Function &F, bool is_signed, bool is_mad = false);
   bool replaceSelect(Function &F);
   bool replaceBitSelect(Function &F);
@@ -263,6 +361,9 @@ private:
   bool replaceHalfReadImage(Function &F);
   bool replaceHalfWriteImage(Function &F);
   bool replaceSampledReadImageWithIntCoords(Function &F);
+  // Returns an unsampled read replacing the sampled read |CI| with integer
+  // coordinates, or nullptr if its sampler may filter or wrap.
+  Value *replaceSampledReadWithFetch(CallInst *CI);
   bool replaceAtomics(Function &F, spv::Op Op);
   bool replaceAtomics(Function &F, llvm::AtomicRMWInst::BinOp Op);
   bool replaceAtomicLoad(Function &F);
@@ -270,6 +371,7 @@ private:
                               spv::MemorySemanticsMask semantics =
                                   spv::MemorySemanticsAcquireReleaseMask);
   bool replaceAtomicCompareExchange(Function &);
+  bool replaceAtomicFetchFAdd(Function &F, bool is_sub);
   bool replaceCross(Function &F);
   bool replaceFract(Function &F, int vec_size);
   bool replaceVload(Function &F);
@@ -288,7 +390,31 @@ private:
   // identical contents.
   Type *GetPairStruct(Type *type);
 
+  // Calls the OpenCL builtin |Name| on |Args|, which all have the type of the
+  // result, with its signed overload if |IsSigned|.
+  Value *CallBuiltin(IRBuilder<> &Builder, const char *Name,
+                     ArrayRef<Value *> Args, bool IsSigned);
+
+  // Converts the float |Src| to the integer type |DstTy|, rounding it first
+  // with |Rounding| and saturating it if |IsSat|.
+  Value *ConvertFloatToInt(IRBuilder<> &Builder, Value *Src, Type *DstTy,
+                           bool DstIsSigned, bool IsSat,
+                           RoundingMode Rounding);
+
+  // Converts the integer |Src| to the float type |DstTy|, rounding with
+  // |Rounding|.
+  Value *ConvertIntToFloat(IRBuilder<> &Builder, Value *Src, Type *DstTy,
+                           bool SrcIsSigned, RoundingMode Rounding);
+
+  // Converts the integer |Src| to the integer type |DstTy|, saturating it.
+  Value *ConvertIntToIntSat(IRBuilder<> &Builder, Value *Src, Type *DstTy,
+                            bool SrcIsSigned, bool DstIsSigned);
+
   DenseMap<Type *, Type *> PairStructMap;
+
+  // The declarations of the SPIR-V instructions and builtins called by the
+  // replacements.
+  DeclarationCache Declarations;
 };
 
 } // namespace
@@ -304,24 +430,140 @@ ModulePass *createReplaceOpenCLBuiltinPass() {
 } // namespace clspv
 
 bool ReplaceOpenCLBuiltinPass::runOnModule(Module &M) {
-  std::list<Function *> func_list;
+  Declarations.reset(M);
+
+  // Process declarations from a worklist. Replacements can declare further
+  // builtins, which getOrInsertFunction appends to the end of the function
+  // list, so only the tail of the list needs to be checked after each
+  // replacement rather than rescanning the whole module.
+  SmallVector<Function *, 64> worklist;
   for (auto &F : M.getFunctionList()) {
     // process only function declarations
-    if (F.isDeclaration() && runOnFunction(F)) {
-      func_list.push_front(&F);
+    if (F.isDeclaration()) {
+      worklist.push_back(&F);
     }
   }
-  if (func_list.size() != 0) {
-    // recursively convert functions, but first remove dead
-    for (auto *F : func_list) {
-      if (F->use_empty()) {
-        F->eraseFromParent();
+
+  bool Changed = false;
+  if (clspv::Option::VectorBufferArgs()) {
+    Changed |= widenVectorBufferArgs(M);
+  }
+
+  for (size_t i = 0; i < worklist.size(); ++i) {
+    auto *F = worklist[i];
+    auto *Last = &M.getFunctionList().back();
+    if (!runOnFunction(*F)) {
+      continue;
+    }
+    Changed = true;
+
+    for (auto I = std::next(Last->getIterator()),
+              E = M.getFunctionList().end();
+         I != E; ++I) {
+      if (I->isDeclaration()) {
+        worklist.push_back(&*I);
       }
     }
-    runOnModule(M);
-    return true;
+
+    // Remove the declaration once it is dead so later replacements that ask
+    // for the same name get a fresh declaration, which is queued above. A
+    // declaration that still has calls is revisited.
+    if (F->use_empty()) {
+      Declarations.forget(F);
+      F->eraseFromParent();
+    } else {
+      worklist.push_back(F);
+    }
   }
-  return false;
+  return Changed;
+}
+
+bool ReplaceOpenCLBuiltinPass::widenVectorBufferArgs(Module &M) {
+  // Returns the width of the vloads and vstores that are the only uses of
+  // |arg|, or 0 if there are other uses or different widths.
+  auto access_width = [](Argument &arg) -> unsigned {
+    auto *ptr_ty = dyn_cast<PointerType>(arg.getType());
+    if (!ptr_ty || !ptr_ty->getElementType()->isSingleValueType() ||
+        ptr_ty->getElementType()->isVectorTy() ||
+        (ptr_ty->getAddressSpace() != clspv::AddressSpace::Global &&
+         ptr_ty->getAddressSpace() != clspv::AddressSpace::Constant))
+      return 0;
+
+    unsigned width = 0;
+    for (auto &use : arg.uses()) {
+      auto *call = dyn_cast<CallInst>(use.getUser());
+      if (!call || !call->getCalledFunction())
+        return 0;
+      auto &info = Builtins::Lookup(call->getCalledFunction());
+      Type *vec_ty = nullptr;
+      if (info.getType() == Builtins::kVload && use.getOperandNo() == 1) {
+        vec_ty = call->getType();
+      } else if (info.getType() == Builtins::kVstore &&
+                 use.getOperandNo() == 2) {
+        vec_ty = call->getArgOperand(0)->getType();
+      }
+      auto *fixed_ty = dyn_cast_or_null<FixedVectorType>(vec_ty);
+      const unsigned call_width = fixed_ty ? fixed_ty->getNumElements() : 0;
+      if ((call_width != 2 && call_width != 4) ||
+          (width != 0 && width != call_width))
+        return 0;
+      width = call_width;
+    }
+    return width;
+  };
+
+  SmallVector<Function *, 8> kernels;
+  for (auto &F : M) {
+    if (!F.isDeclaration() && F.getCallingConv() == CallingConv::SPIR_KERNEL &&
+        F.use_empty())
+      kernels.push_back(&F);
+  }
+
+  bool Changed = false;
+  for (auto *F : kernels) {
+    SmallVector<Type *, 8> param_tys;
+    bool widened = false;
+    for (auto &arg : F->args()) {
+      param_tys.push_back(arg.getType());
+      if (auto width = access_width(arg)) {
+        auto *ptr_ty = cast<PointerType>(arg.getType());
+        param_tys.back() = PointerType::get(
+            FixedVectorType::get(ptr_ty->getElementType(), width),
+            ptr_ty->getAddressSpace());
+        widened = true;
+      }
+    }
+    if (!widened)
+      continue;
+    Changed = true;
+
+    // Rebuild the kernel with the vector arguments. The uses see a cast back
+    // to the scalar pointer, which replaceVload and replaceVstore look
+    // through.
+    auto *new_fty = FunctionType::get(F->getReturnType(), param_tys, false);
+    auto *new_f = Function::Create(new_fty, F->getLinkage());
+    M.getFunctionList().insert(F->getIterator(), new_f);
+    new_f->takeName(F);
+    new_f->setCallingConv(F->getCallingConv());
+    new_f->copyMetadata(F, 0);
+    new_f->setAttributes(F->getAttributes());
+    new_f->getBasicBlockList().splice(new_f->begin(), F->getBasicBlockList());
+
+    IRBuilder<> builder(&*new_f->getEntryBlock().getFirstInsertionPt());
+    for (auto &arg : F->args()) {
+      auto *new_arg = new_f->getArg(arg.getArgNo());
+      new_arg->takeName(&arg);
+      if (new_arg->getType() == arg.getType()) {
+        arg.replaceAllUsesWith(new_arg);
+      } else {
+        arg.replaceAllUsesWith(
+            builder.CreatePointerCast(new_arg, arg.getType()));
+      }
+    }
+    F->eraseFromParent();
+  }
+
+  return Changed;
 }
 
 bool ReplaceOpenCLBuiltinPass::runOnFunction(Function &F) {
@@ -448,9 +690,19 @@ bool ReplaceOpenCLBuiltinPass::runOnFunction(Function &F) {
   case Builtins::kRotate:
     return replaceRotate(F);
 
-  case Builtins::kConvert:
+  case Builtins::kConvert: {
+    // convert_<type>[_sat][_rte|_rtz|_rtp|_rtn]
+    StringRef name(FI.getName());
+    auto rounding = StringSwitch<RoundingMode>(name.take_back(4))
+                        .Case("_rte", RoundingMode::NearestTiesToEven)
+                        .Case("_rtz", RoundingMode::TowardZero)
+                        .Case("_rtp", RoundingMode::TowardPositive)
+                        .Case("_rtn", RoundingMode::TowardNegative)
+                        .Default(RoundingMode::Dynamic);
     return replaceConvert(F, FI.getParameter(0).is_signed,
-                          FI.getReturnType().is_signed);
+                          FI.getReturnType().is_signed,
+                          name.contains("_sat"), rounding);
+  }
 
   // OpenCL 2.0 explicit atomics have different default scopes and semantics
   // than legacy atomic functions.
@@ -466,9 +718,13 @@ bool ReplaceOpenCLBuiltinPass::runOnFunction(Function &F) {
     return replaceExplicitAtomics(F, spv::OpAtomicExchange);
   case Builtins::kAtomicFetchAdd:
   case Builtins::kAtomicFetchAddExplicit:
+    if (F.getFunctionType()->getParamType(1)->isFloatingPointTy())
+      return replaceAtomicFetchFAdd(F, false);
     return replaceExplicitAtomics(F, spv::OpAtomicIAdd);
   case Builtins::kAtomicFetchSub:
   case Builtins::kAtomicFetchSubExplicit:
+    if (F.getFunctionType()->getParamType(1)->isFloatingPointTy())
+      return replaceAtomicFetchFAdd(F, true);
     return replaceExplicitAtomics(F, spv::OpAtomicISub);
   case Builtins::kAtomicFetchOr:
   case Builtins::kAtomicFetchOrExplicit:
@@ -697,7 +953,8 @@ bool ReplaceOpenCLBuiltinPass::replaceRecip(Function &F) {
     // Recip has one arg.
     auto Arg = CI->getOperand(0);
     auto Cst1 = ConstantFP::get(Arg->getType(), 1.0);
-    return BinaryOperator::Create(Instruction::FDiv, Cst1, Arg, "", CI);
+    return MarkRelaxedPrecision(
+        BinaryOperator::Create(Instruction::FDiv, Cst1, Arg, "", CI));
   });
 }
 
@@ -705,19 +962,20 @@ bool ReplaceOpenCLBuiltinPass::replaceDivide(Function &F) {
   return replaceCallsWithValue(F, [](CallInst *CI) {
     auto Op0 = CI->getOperand(0);
     auto Op1 = CI->getOperand(1);
-    return BinaryOperator::Create(Instruction::FDiv, Op0, Op1, "", CI);
+    return MarkRelaxedPrecision(
+        BinaryOperator::Create(Instruction::FDiv, Op0, Op1, "", CI));
   });
 }
 
 bool ReplaceOpenCLBuiltinPass::replaceDot(Function &F) {
-  return replaceCallsWithValue(F, [](CallInst *CI) {
+  return replaceCallsWithValue(F, [this](CallInst *CI) {
     auto Op0 = CI->getOperand(0);
     auto Op1 = CI->getOperand(1);
 
     Value *V = nullptr;
     if (Op0->getType()->isVectorTy()) {
       V = clspv::InsertSPIRVOp(CI, spv::OpDot, {Attribute::ReadNone},
-                               CI->getType(), {Op0, Op1});
+                               CI->getType(), {Op0, Op1}, &Declarations);
     } else {
       V = BinaryOperator::Create(Instruction::FMul, Op0, Op1, "", CI);
     }
@@ -728,18 +986,35 @@ bool ReplaceOpenCLBuiltinPass::replaceDot(Function &F) {
 
 bool ReplaceOpenCLBuiltinPass::replaceExp10(Function &F,
                                             const std::string &basename) {
-  // convert to natural
+  // Convert to the natural exponential, or under relaxed math to the base 2
+  // exponential that GPUs implement in hardware.
   auto slen = basename.length() - 2;
   std::string NewFName = basename.substr(0, slen);
+  std::string RelaxedFName = Builtins::GetMangledFunctionName(
+      (NewFName + "2").c_str(), F.getFunctionType());
   NewFName =
       Builtins::GetMangledFunctionName(NewFName.c_str(), F.getFunctionType());
 
   Module &M = *F.getParent();
   return replaceCallsWithValue(F, [&](CallInst *CI) {
-    auto NewF = M.getOrInsertFunction(NewFName, F.getFunctionType());
-
     auto Arg = CI->getOperand(0);
 
+    if (AllowsRelaxedMath(*CI->getFunction())) {
+      auto NewF = M.getOrInsertFunction(RelaxedFName, F.getFunctionType());
+
+      // Constant of the base 2 log of 10 (log2(10)).
+      const double Log2_10 =
+          3.321928094887362347870319429489390175864831393024580612054;
+
+      auto Mul = BinaryOperator::Create(
+          Instruction::FMul, ConstantFP::get(Arg->getType(), Log2_10), Arg, "",
+          CI);
+
+      return CallInst::Create(NewF, Mul, "", CI);
+    }
+
+    auto NewF = M.getOrInsertFunction(NewFName, F.getFunctionType());
+
     // Constant of the natural log of 10 (ln(10)).
     const double Ln10 =
         2.302585092994045684017991454684364207601101488628772976033;
@@ -765,18 +1040,35 @@ bool ReplaceOpenCLBuiltinPass::replaceFmod(Function &F) {
 
 bool ReplaceOpenCLBuiltinPass::replaceLog10(Function &F,
                                             const std::string &basename) {
-  // convert to natural
+  // Convert to the natural logarithm, or under relaxed math to the base 2
+  // logarithm.
   auto slen = basename.length() - 2;
   std::string NewFName = basename.substr(0, slen);
+  std::string RelaxedFName = Builtins::GetMangledFunctionName(
+      (NewFName + "2").c_str(), F.getFunctionType());
   NewFName =
       Builtins::GetMangledFunctionName(NewFName.c_str(), F.getFunctionType());
 
   Module &M = *F.getParent();
   return replaceCallsWithValue(F, [&](CallInst *CI) {
-    auto NewF = M.getOrInsertFunction(NewFName, F.getFunctionType());
-
     auto Arg = CI->getOperand(0);
 
+    if (AllowsRelaxedMath(*CI->getFunction())) {
+      auto NewF = M.getOrInsertFunction(RelaxedFName, F.getFunctionType());
+
+      // Constant of the base 10 log of 2 (log10(2)).
+      const double Log10_2 =
+          0.301029995663981195213738894724493026768189881462108541310;
+
+      auto NewCI = CallInst::Create(NewF, Arg, "", CI);
+
+      return BinaryOperator::Create(Instruction::FMul,
+                                    ConstantFP::get(Arg->getType(), Log10_2),
+                                    NewCI, "", CI);
+    }
+
+    auto NewF = M.getOrInsertFunction(NewFName, F.getFunctionType());
+
     // Constant of the reciprocal of the natural log of 10 (ln(10)).
     const double Ln10 =
         0.434294481903251827651128918916605082294397005803666566114;
@@ -815,7 +1107,7 @@ bool ReplaceOpenCLBuiltinPass::replaceBarrier(Function &F, bool subgroup) {
     CLK_IMAGE_MEM_FENCE = 0x04
   };
 
-  return replaceCallsWithValue(F, [subgroup](CallInst *CI) {
+  return replaceCallsWithValue(F, [this, subgroup](CallInst *CI) {
     auto Arg = CI->getOperand(0);
 
     // We need to map the OpenCL constants to the SPIR-V equivalents.
@@ -907,7 +1199,8 @@ bool ReplaceOpenCLBuiltinPass::replaceBarrier(Function &F, bool subgroup) {
     return clspv::InsertSPIRVOp(CI, spv::OpControlBarrier,
                                 {Attribute::NoDuplicate, Attribute::Convergent},
                                 CI->getType(),
-                                {ExecutionScope, MemoryScope, MemorySemantics});
+                                {ExecutionScope, MemoryScope, MemorySemantics},
+                                &Declarations);
   });
 }
 
@@ -978,7 +1271,7 @@ bool ReplaceOpenCLBuiltinPass::replaceMemFence(Function &F,
 
     return clspv::InsertSPIRVOp(CI, spv::OpMemoryBarrier,
                                 {Attribute::Convergent}, CI->getType(),
-                                {MemoryScope, MemorySemantics});
+                                {MemoryScope, MemorySemantics}, &Declarations);
   });
 }
 
@@ -1042,7 +1335,8 @@ bool ReplaceOpenCLBuiltinPass::replaceIsInfAndIsNan(Function &F,
     }
 
     auto NewCI = clspv::InsertSPIRVOp(CI, SPIRVOp, {Attribute::ReadNone},
-                                      CorrespondingBoolTy, {CI->getOperand(0)});
+                                      CorrespondingBoolTy, {CI->getOperand(0)},
+                                      &Declarations);
 
     return SelectInst::Create(NewCI, TrueValue, FalseValue, "", CI);
   });
@@ -1128,7 +1422,7 @@ bool ReplaceOpenCLBuiltinPass::replaceAllAndAny(Function &F, spv::Op SPIRVOp) {
         const auto BoolTy = Type::getInt1Ty(M.getContext());
 
         const auto NewCI = clspv::InsertSPIRVOp(
-            CI, SPIRVOp, {Attribute::ReadNone}, BoolTy, {Cmp});
+            CI, SPIRVOp, {Attribute::ReadNone}, BoolTy, {Cmp}, &Declarations);
         SelectSource = NewCI;
 
       } else {
@@ -1236,7 +1530,8 @@ bool ReplaceOpenCLBuiltinPass::replaceRotate(Function &F) {
 }
 
 bool ReplaceOpenCLBuiltinPass::replaceConvert(Function &F, bool SrcIsSigned,
-                                              bool DstIsSigned) {
+                                              bool DstIsSigned, bool IsSat,
+                                              RoundingMode Rounding) {
   return replaceCallsWithValue(F, [&](CallInst *CI) -> llvm::Value * {
     Value *V = nullptr;
     // Get arguments
@@ -1273,25 +1568,27 @@ bool ReplaceOpenCLBuiltinPass::replaceConvert(Function &F, bool SrcIsSigned,
     bool SrcIsInt = SrcType->isIntOrIntVectorTy();
     bool DstIsInt = DstType->isIntOrIntVectorTy();
 
+    IRBuilder<> Builder(CI);
     if (SrcType == DstType && DstIsSigned == SrcIsSigned) {
       // Unnecessary cast operation.
       V = SrcValue;
     } else if (SrcIsFloat && DstIsFloat) {
+      // Narrowing conversions use the default rounding of the device.
       V = CastInst::CreateFPCast(SrcValue, DstType, "", CI);
     } else if (SrcIsFloat && DstIsInt) {
-      if (DstIsSigned) {
-        V = CastInst::Create(Instruction::FPToSI, SrcValue, DstType, "", CI);
-      } else {
-        V = CastInst::Create(Instruction::FPToUI, SrcValue, DstType, "", CI);
-      }
+      V = ConvertFloatToInt(Builder, SrcValue, DstType, DstIsSigned, IsSat,
+                            Rounding);
     } else if (SrcIsInt && DstIsFloat) {
-      if (SrcIsSigned) {
-        V = CastInst::Create(Instruction::SIToFP, SrcValue, DstType, "", CI);
+      V = ConvertIntToFloat(Builder, SrcValue, DstType, SrcIsSigned,
+                            Rounding);
+    } else if (SrcIsInt && DstIsInt) {
+      if (IsSat) {
+        V = ConvertIntToIntSat(Builder, SrcValue, DstType, SrcIsSigned,
+                               DstIsSigned);
       } else {
-        V = CastInst::Create(Instruction::UIToFP, SrcValue, DstType, "", CI);
+        V = CastInst::CreateIntegerCast(SrcValue, DstType, SrcIsSigned, "",
+                                        CI);
       }
-    } else if (SrcIsInt && DstIsInt) {
-      V = CastInst::CreateIntegerCast(SrcValue, DstType, SrcIsSigned, "", CI);
     } else {
       // Not something we're supposed to handle, just move on
     }
@@ -1300,6 +1597,221 @@ bool ReplaceOpenCLBuiltinPass::replaceConvert(Function &F, bool SrcIsSigned,
   });
 }
 
+Value *ReplaceOpenCLBuiltinPass::CallBuiltin(IRBuilder<> &Builder,
+                                             const char *Name,
+                                             ArrayRef<Value *> Args,
+                                             bool IsSigned) {
+  auto *Ty = Args[0]->getType();
+  SmallVector<Type *, 3> ArgTys(Args.size(), Ty);
+  auto *FTy = FunctionType::get(Ty, ArgTys, false);
+  std::string MangledName;
+  if (IsSigned && Ty->isIntOrIntVectorTy()) {
+    MangledName =
+        Builtins::GetMangledFunctionName(Name) + GetSignedMangledTypeName(Ty);
+    for (size_t i = 1; i < Args.size(); ++i) {
+      MangledName += "S_";
+    }
+  } else {
+    MangledName = Builtins::GetMangledFunctionName(Name, FTy);
+  }
+  auto *M = Builder.GetInsertBlock()->getModule();
+  return Builder.CreateCall(M->getOrInsertFunction(MangledName, FTy), Args);
+}
+
+Value *ReplaceOpenCLBuiltinPass::ConvertFloatToInt(IRBuilder<> &Builder,
+                                                   Value *Src, Type *DstTy,
+                                                   bool DstIsSigned,
+                                                   bool IsSat,
+                                                   RoundingMode Rounding) {
+  // Conversions to integers truncate by default. The other modes round to an
+  // integral value first, which is then converted exactly.
+  switch (Rounding) {
+  case RoundingMode::NearestTiesToEven:
+    Src = CallBuiltin(Builder, "rint", {Src}, false);
+    break;
+  case RoundingMode::TowardPositive:
+    Src = CallBuiltin(Builder, "ceil", {Src}, false);
+    break;
+  case RoundingMode::TowardNegative:
+    Src = CallBuiltin(Builder, "floor", {Src}, false);
+    break;
+  default:
+    break;
+  }
+
+  auto Op = DstIsSigned ? Instruction::FPToSI : Instruction::FPToUI;
+  if (!IsSat) {
+    return Builder.CreateCast(Op, Src, DstTy);
+  }
+
+  // Clamp to the closest floats within the range of the destination, so the
+  // conversion is defined. When the bounds of the range are not floats, or
+  // are out of the range of floats, the values beyond the clamp still
+  // saturate to the bounds.
+  auto *SrcTy = Src->getType();
+  auto &Ctx = SrcTy->getContext();
+  const unsigned Width = DstTy->getScalarSizeInBits();
+  const APInt Lo = DstIsSigned ? APInt::getSignedMinValue(Width)
+                               : APInt::getNullValue(Width);
+  const APInt Hi = DstIsSigned ? APInt::getSignedMaxValue(Width)
+                               : APInt::getMaxValue(Width);
+  const auto &Semantics = SrcTy->getScalarType()->getFltSemantics();
+  APFloat LoFloat(Semantics), HiFloat(Semantics);
+  const bool LoIsExact =
+      LoFloat.convertFromAPInt(Lo, DstIsSigned, APFloat::rmTowardPositive) ==
+      APFloat::opOK;
+  const bool HiIsExact =
+      HiFloat.convertFromAPInt(Hi, DstIsSigned, APFloat::rmTowardNegative) ==
+      APFloat::opOK;
+  auto *LoConst = SplatLike(SrcTy, ConstantFP::get(Ctx, LoFloat));
+  auto *HiConst = SplatLike(SrcTy, ConstantFP::get(Ctx, HiFloat));
+
+  auto *Clamped = CallBuiltin(Builder, "clamp", {Src, LoConst, HiConst}, false);
+  Value *V = Builder.CreateCast(Op, Clamped, DstTy);
+  if (!HiIsExact) {
+    V = Builder.CreateSelect(Builder.CreateFCmpOGT(Src, HiConst),
+                             ConstantInt::get(DstTy, Hi), V);
+  }
+  if (!LoIsExact) {
+    V = Builder.CreateSelect(Builder.CreateFCmpOLT(Src, LoConst),
+                             ConstantInt::get(DstTy, Lo), V);
+  }
+
+  // NaN converts to 0, unless the kernel assumes there is none. Comparing
+  // with a constant is a single OpIsNan.
+  auto *F = Builder.GetInsertBlock()->getParent();
+  if (F->getFnAttribute("no-nans-fp-math").getValueAsString() != "true") {
+    auto *IsNan = Builder.CreateFCmpUNO(Src, ConstantFP::get(SrcTy, 0.0));
+    V = Builder.CreateSelect(IsNan, ConstantInt::get(DstTy, 0), V);
+  }
+  return V;
+}
+
+Value *ReplaceOpenCLBuiltinPass::ConvertIntToFloat(IRBuilder<> &Builder,
+                                                   Value *Src, Type *DstTy,
+                                                   bool SrcIsSigned,
+                                                   RoundingMode Rounding) {
+  auto Op = SrcIsSigned ? Instruction::SIToFP : Instruction::UIToFP;
+  auto *Nearest = Builder.CreateCast(Op, Src, DstTy);
+
+  // The conversion rounds to nearest even. The rounding mode does not matter
+  // when every value of the source is a float.
+  auto *SrcTy = Src->getType();
+  const unsigned Width = SrcTy->getScalarSizeInBits();
+  const unsigned Magnitude = Width - (SrcIsSigned ? 1 : 0);
+  const auto &Semantics = DstTy->getScalarType()->getFltSemantics();
+  if (Rounding == RoundingMode::Dynamic ||
+      Rounding == RoundingMode::NearestTiesToEven ||
+      Magnitude <= APFloat::semanticsPrecision(Semantics)) {
+    return Nearest;
+  }
+  // The correction below needs 2^Magnitude to be a float. Narrower floats,
+  // e.g. int to half, keep the default rounding.
+  if (Magnitude > unsigned(APFloat::semanticsMaxExponent(Semantics))) {
+    return Nearest;
+  }
+
+  // Compare the rounded value with the source, converting it back. The only
+  // float out of range is 2^Magnitude, which is greater than any source.
+  auto &Ctx = DstTy->getContext();
+  APFloat LimitFloat(Semantics);
+  LimitFloat.convertFromAPInt(APInt::getOneBitSet(Magnitude + 1, Magnitude),
+                              false, APFloat::rmNearestTiesToEven);
+  APFloat BelowFloat = LimitFloat;
+  BelowFloat.next(true);
+  auto *Limit = SplatLike(DstTy, ConstantFP::get(Ctx, LimitFloat));
+  auto *Below = SplatLike(DstTy, ConstantFP::get(Ctx, BelowFloat));
+  auto *IsLimit = Builder.CreateFCmpOGE(Nearest, Limit);
+  auto *Back = Builder.CreateCast(
+      SrcIsSigned ? Instruction::FPToSI : Instruction::FPToUI,
+      CallBuiltin(Builder, "min", {Nearest, Below}, false), SrcTy);
+  auto *Greater = Builder.CreateOr(
+      IsLimit, SrcIsSigned ? Builder.CreateICmpSGT(Back, Src)
+                           : Builder.CreateICmpUGT(Back, Src));
+  auto *Less = Builder.CreateAnd(
+      Builder.CreateNot(IsLimit), SrcIsSigned
+                                      ? Builder.CreateICmpSLT(Back, Src)
+                                      : Builder.CreateICmpULT(Back, Src));
+
+  // An inexact float is not 0, so the next float of greater magnitude has
+  // the next encoding, and the previous one of smaller magnitude the previous
+  // encoding.
+  auto *BitsTy = getIntOrIntVectorTyForCast(Ctx, DstTy);
+  auto *Away = ConstantInt::get(BitsTy, 1);
+  auto *TowardZero = ConstantInt::getSigned(BitsTy, -1);
+  Value *IsNegative = nullptr;
+  if (SrcIsSigned) {
+    IsNegative = Builder.CreateICmpSLT(Src, ConstantInt::get(SrcTy, 0));
+  }
+
+  Value *Adjust = nullptr;
+  Value *Step = nullptr;
+  switch (Rounding) {
+  case RoundingMode::TowardZero:
+    Adjust = IsNegative ? Builder.CreateSelect(IsNegative, Less, Greater)
+                        : Greater;
+    Step = TowardZero;
+    break;
+  case RoundingMode::TowardPositive:
+    Adjust = Less;
+    Step = IsNegative ? Builder.CreateSelect(IsNegative, TowardZero, Away)
+                      : Away;
+    break;
+  default:
+    Adjust = Greater;
+    Step = IsNegative ? Builder.CreateSelect(IsNegative, Away, TowardZero)
+                      : TowardZero;
+    break;
+  }
+  auto *Bits = Builder.CreateBitCast(Nearest, BitsTy);
+  auto *Next = Builder.CreateBitCast(Builder.CreateAdd(Bits, Step), DstTy);
+  return Builder.CreateSelect(Adjust, Next, Nearest);
+}
+
+Value *ReplaceOpenCLBuiltinPass::ConvertIntToIntSat(IRBuilder<> &Builder,
+                                                    Value *Src, Type *DstTy,
+                                                    bool SrcIsSigned,
+                                                    bool DstIsSigned) {
+  auto *SrcTy = Src->getType();
+  const unsigned SrcWidth = SrcTy->getScalarSizeInBits();
+  const unsigned DstWidth = DstTy->getScalarSizeInBits();
+  // The bounds of the destination, in the source type.
+  auto Bound = [SrcTy, SrcWidth](const APInt &B, bool IsSigned) {
+    return ConstantInt::get(SrcTy, IsSigned ? B.sextOrTrunc(SrcWidth)
+                                            : B.zextOrTrunc(SrcWidth));
+  };
+
+  // Only the bounds of the destination the source can exceed are checked,
+  // with a single min, max or clamp.
+  Value *V = Src;
+  if (SrcIsSigned && DstIsSigned) {
+    if (DstWidth < SrcWidth) {
+      V = CallBuiltin(
+          Builder, "clamp",
+          {Src, Bound(APInt::getSignedMinValue(DstWidth), true),
+           Bound(APInt::getSignedMaxValue(DstWidth), true)},
+          true);
+    }
+  } else if (SrcIsSigned) {
+    auto *Zero = ConstantInt::get(SrcTy, 0);
+    if (DstWidth < SrcWidth) {
+      V = CallBuiltin(
+          Builder, "clamp",
+          {Src, Zero, Bound(APInt::getMaxValue(DstWidth), false)}, true);
+    } else {
+      V = CallBuiltin(Builder, "max", {Src, Zero}, true);
+    }
+  } else {
+    const APInt Max = DstIsSigned ? APInt::getSignedMaxValue(DstWidth)
+                                  : APInt::getMaxValue(DstWidth);
+    if (DstWidth < SrcWidth || (DstIsSigned && DstWidth == SrcWidth)) {
+      V = CallBuiltin(Builder, "min", {Src, Bound(Max, false)}, false);
+    }
+  }
+  // Once in range, extending from the source keeps the value.
+  return Builder.CreateIntCast(V, DstTy, SrcIsSigned && DstIsSigned);
+}
+
 bool ReplaceOpenCLBuiltinPass::replaceMulHi(Function &F, bool is_signed,
                                             bool is_mad) {
   return replaceCallsWithValue(F, [&](CallInst *CI) -> llvm::Value * {
@@ -1345,8 +1857,9 @@ bool ReplaceOpenCLBuiltinPass::replaceMulHi(Function &F, bool is_signed,
     spv::Op opcode = is_signed ? spv::OpSMulExtended : spv::OpUMulExtended;
 
     // Call the SPIR-V op
-    auto Call = clspv::InsertSPIRVOp(CI, opcode, {Attribute::ReadNone},
-                                     ExMulRetType, {AValue, BValue});
+    auto Call =
+        clspv::InsertSPIRVOp(CI, opcode, {Attribute::ReadNone}, ExMulRetType,
+                             {AValue, BValue}, &Declarations);
 
     // Get the high part of the result
     unsigned Idxs[] = {1};
@@ -1545,10 +2058,8 @@ bool ReplaceOpenCLBuiltinPass::replaceStep(Function &F, bool is_smooth) {
     SmallVector<Type *, 3> NewArgTypes(ArgsToSplat.size() + 1, VecType);
     const auto NewFType = FunctionType::get(CI->getType(), NewArgTypes, false);
 
-    std::string NewFName = Builtins::GetMangledFunctionName(
-        is_smooth ? "smoothstep" : "step", NewFType);
-
-    const auto NewF = M.getOrInsertFunction(NewFName, NewFType);
+    const auto NewF = Declarations.getBuiltin(
+        is_smooth ? "smoothstep" : "step", NewFType, NewFType);
 
     SmallVector<Value *, 3> NewArgs;
     for (auto arg : SplatArgs) {
@@ -1616,9 +2127,14 @@ bool ReplaceOpenCLBuiltinPass::replaceVstore(Function &F) {
     if (pointee_type != vec_data_type->getElementType())
       return V;
 
+    // A cast of a vector pointer is stored through in one go.
+    IRBuilder<> builder(CI);
+    if (auto base = GetVectorBase(ptr, vec_data_type)) {
+      return builder.CreateStore(data, builder.CreateGEP(base, offset));
+    }
+
     // Avoid pointer casts. Instead generate the correct number of stores
     // and rely on drivers to coalesce appropriately.
-    IRBuilder<> builder(CI);
     auto elems_const = builder.getInt32(elems);
     auto adjust = builder.CreateMul(offset, elems_const);
     for (auto i = 0; i < elems; ++i) {
@@ -1652,9 +2168,14 @@ bool ReplaceOpenCLBuiltinPass::replaceVload(Function &F) {
     if (pointee_type != vec_ret_type->getElementType())
       return V;
 
+    // A cast of a vector pointer is loaded from in one go.
+    IRBuilder<> builder(CI);
+    if (auto base = GetVectorBase(ptr, vec_ret_type)) {
+      return builder.CreateLoad(builder.CreateGEP(base, offset));
+    }
+
     // Avoid pointer casts. Instead generate the correct number of loads
     // and rely on drivers to coalesce appropriately.
-    IRBuilder<> builder(CI);
     auto elems_const = builder.getInt32(elems);
     V = UndefValue::get(ret_type);
     auto adjust = builder.CreateMul(offset, elems_const);
@@ -1713,27 +2234,19 @@ bool ReplaceOpenCLBuiltinPass::replaceVloadHalf(Function &F) {
 
     Value *V = nullptr;
 
-    bool supports_16bit_storage = true;
-    switch (Arg1->getType()->getPointerAddressSpace()) {
-    case clspv::AddressSpace::Global:
-      supports_16bit_storage = clspv::Option::Supports16BitStorageClass(
-          clspv::Option::StorageClass::kSSBO);
-      break;
-    case clspv::AddressSpace::Constant:
-      if (clspv::Option::ConstantArgsInUniformBuffer())
-        supports_16bit_storage = clspv::Option::Supports16BitStorageClass(
-            clspv::Option::StorageClass::kUBO);
-      else
-        supports_16bit_storage = clspv::Option::Supports16BitStorageClass(
-            clspv::Option::StorageClass::kSSBO);
-      break;
-    default:
-      // Clspv will emit the Float16 capability if the half type is
-      // encountered. That capability covers private and local addressspaces.
-      break;
-    }
-
-    if (supports_16bit_storage) {
+    const bool supports_16bit_storage = Supports16BitStorage(Arg1);
+
+    if (supports_16bit_storage && clspv::Option::NativeFp16()) {
+      // Load the half and extend it. The extension folds away when the result
+      // is converted back to half.
+      auto HalfTy = Type::getHalfTy(M.getContext());
+      auto HalfPointerTy =
+          PointerType::get(HalfTy, Arg1->getType()->getPointerAddressSpace());
+      auto Cast = CastInst::CreatePointerCast(Arg1, HalfPointerTy, "", CI);
+      auto Index = GetElementPtrInst::Create(HalfTy, Cast, Arg0, "", CI);
+      auto Load = new LoadInst(HalfTy, Index, "", CI);
+      V = CastInst::Create(Instruction::FPExt, Load, CI->getType(), "", CI);
+    } else if (supports_16bit_storage) {
       auto ShortTy = Type::getInt16Ty(M.getContext());
       auto ShortPointerTy =
           PointerType::get(ShortTy, Arg1->getType()->getPointerAddressSpace());
@@ -1982,7 +2495,7 @@ bool ReplaceOpenCLBuiltinPass::replaceVstoreHalf(Function &F, int vec_size) {
 
 bool ReplaceOpenCLBuiltinPass::replaceVstoreHalf(Function &F) {
   Module &M = *F.getParent();
-  return replaceCallsWithValue(F, [&](CallInst *CI) {
+  return replaceCallsWithValue(F, [&](CallInst *CI) -> Value * {
     // The value to store.
     auto Arg0 = CI->getOperand(0);
 
@@ -1992,6 +2505,19 @@ bool ReplaceOpenCLBuiltinPass::replaceVstoreHalf(Function &F) {
     // The pointer argument from vstore_half.
     auto Arg2 = CI->getOperand(2);
 
+    const bool supports_16bit_storage = Supports16BitStorage(Arg2);
+    if (supports_16bit_storage && clspv::Option::NativeFp16()) {
+      // Convert the value to half and store it. The conversion folds away
+      // when the value was extended from half.
+      auto HalfTy = Type::getHalfTy(M.getContext());
+      auto HalfPointerTy =
+          PointerType::get(HalfTy, Arg2->getType()->getPointerAddressSpace());
+      auto Trunc = CastInst::Create(Instruction::FPTrunc, Arg0, HalfTy, "", CI);
+      auto Cast = CastInst::CreatePointerCast(Arg2, HalfPointerTy, "", CI);
+      auto Index = GetElementPtrInst::Create(HalfTy, Cast, Arg1, "", CI);
+      return new StoreInst(Trunc, Index, CI);
+    }
+
     auto IntTy = Type::getInt32Ty(M.getContext());
     auto Float2Ty = FixedVectorType::get(Type::getFloatTy(M.getContext()), 2);
     auto NewFType = FunctionType::get(IntTy, Float2Ty, false);
@@ -2009,25 +2535,6 @@ bool ReplaceOpenCLBuiltinPass::replaceVstoreHalf(Function &F) {
     // Pack the float2 -> half2 (in an int).
     auto X = CallInst::Create(NewF, TempVec, "", CI);
 
-    bool supports_16bit_storage = true;
-    switch (Arg2->getType()->getPointerAddressSpace()) {
-    case clspv::AddressSpace::Global:
-      supports_16bit_storage = clspv::Option::Supports16BitStorageClass(
-          clspv::Option::StorageClass::kSSBO);
-      break;
-    case clspv::AddressSpace::Constant:
-      if (clspv::Option::ConstantArgsInUniformBuffer())
-        supports_16bit_storage = clspv::Option::Supports16BitStorageClass(
-            clspv::Option::StorageClass::kUBO);
-      else
-        supports_16bit_storage = clspv::Option::Supports16BitStorageClass(
-            clspv::Option::StorageClass::kSSBO);
-      break;
-    default:
-      // Clspv will emit the Float16 capability if the half type is
-      // encountered. That capability covers private and local addressspaces.
-      break;
-    }
 
     Value *V = nullptr;
     if (supports_16bit_storage) {
@@ -2248,10 +2755,7 @@ bool ReplaceOpenCLBuiltinPass::replaceHalfReadImage(Function &F) {
                                                    .getKnownMinValue()),
                           types, false);
 
-    std::string NewFName =
-        Builtins::GetMangledFunctionName("read_imagef", NewFType);
-
-    auto NewF = M.getOrInsertFunction(NewFName, NewFType);
+    auto NewF = Declarations.getBuiltin("read_imagef", NewFType, NewFType);
 
     auto NewCI = CallInst::Create(NewF, args, "", CI);
 
@@ -2285,10 +2789,7 @@ bool ReplaceOpenCLBuiltinPass::replaceHalfWriteImage(Function &F) {
     auto NewFType =
         FunctionType::get(Type::getVoidTy(M.getContext()), types, false);
 
-    std::string NewFName =
-        Builtins::GetMangledFunctionName("write_imagef", NewFType);
-
-    auto NewF = M.getOrInsertFunction(NewFName, NewFType);
+    auto NewF = Declarations.getBuiltin("write_imagef", NewFType, NewFType);
 
     // Convert data to the float type.
     auto Cast = CastInst::CreateFPCast(CI->getArgOperand(2), types[2], "", CI);
@@ -2312,6 +2813,12 @@ bool ReplaceOpenCLBuiltinPass::replaceSampledReadImageWithIntCoords(
     // The coordinate (integer type that we can't handle).
     auto Arg2 = CI->getOperand(2);
 
+    if (clspv::Option::ImageFetchIntCoords()) {
+      if (auto Fetch = replaceSampledReadWithFetch(CI)) {
+        return Fetch;
+      }
+    }
+
     uint32_t dim = clspv::ImageDimensionality(Arg0->getType());
     uint32_t components =
         dim + (clspv::IsArrayImageType(Arg0->getType()) ? 1 : 0);
@@ -2339,6 +2846,85 @@ bool ReplaceOpenCLBuiltinPass::replaceSampledReadImageWithIntCoords(
   });
 }
 
+Value *ReplaceOpenCLBuiltinPass::replaceSampledReadWithFetch(CallInst *CI) {
+  Module &M = *CI->getModule();
+  auto Image = CI->getOperand(0);
+  auto Sampler = CI->getOperand(1);
+  auto Coord = CI->getOperand(2);
+
+  // Integer coordinates address texels directly through a non-normalized,
+  // nearest sampler, so the read needs neither the sampler nor filtering.
+  uint64_t sampler = 0;
+  if (!GetLiteralSampler(Sampler, &sampler) ||
+      (sampler & clspv::kSamplerNormalizedCoordsMask) !=
+          clspv::CLK_NORMALIZED_COORDS_FALSE ||
+      (sampler & clspv::kSamplerFilterMask) != clspv::CLK_FILTER_NEAREST) {
+    return nullptr;
+  }
+
+  // Out of range coordinates are undefined with CLK_ADDRESS_NONE, but must be
+  // clamped to the edge explicitly for CLK_ADDRESS_CLAMP_TO_EDGE. Only 1D and
+  // 2D images are clamped; other addressing modes keep the sampler.
+  const auto addressing = sampler & clspv::kSamplerAddressMask;
+  const uint32_t dim = clspv::ImageDimensionality(Image->getType());
+  const bool is_array = clspv::IsArrayImageType(Image->getType());
+  if (addressing != clspv::CLK_ADDRESS_NONE &&
+      (addressing != clspv::CLK_ADDRESS_CLAMP_TO_EDGE || dim > 2 || is_array)) {
+    return nullptr;
+  }
+
+  // The unsampled overload is the same mangled name without the sampler, e.g.
+  // _Z11read_imagef14ocl_image2d_ro11ocl_samplerDv2_i becomes
+  // _Z11read_imagef14ocl_image2d_roDv2_i.
+  const std::string sampler_mangling = "11ocl_sampler";
+  const std::string name = CI->getCalledFunction()->getName().str();
+  const auto sampler_pos = name.find(sampler_mangling);
+  auto image_pos = name.find("ocl_image");
+  if (sampler_pos == std::string::npos || image_pos == std::string::npos ||
+      image_pos > sampler_pos) {
+    return nullptr;
+  }
+  while (std::isdigit(name[image_pos - 1])) {
+    --image_pos;
+  }
+  const std::string image_mangling =
+      name.substr(image_pos, sampler_pos - image_pos);
+
+  IRBuilder<> builder(CI);
+  if (addressing == clspv::CLK_ADDRESS_CLAMP_TO_EDGE) {
+    // coord = clamp(coord, 0, size - 1)
+    auto Int32Ty = builder.getInt32Ty();
+    Type *SizeTy = Coord->getType();
+    std::string size_name = "_Z15get_image_width";
+    std::string clamp_name = "_Z5clampiii";
+    if (dim == 2) {
+      size_name = "_Z13get_image_dim";
+      clamp_name = "_Z5clampDv2_iS_S_";
+    }
+    auto SizeF = M.getOrInsertFunction(
+        size_name + image_mangling,
+        FunctionType::get(SizeTy, {Image->getType()}, false));
+    auto Size = builder.CreateCall(SizeF, {Image});
+    Constant *One = ConstantInt::get(Int32Ty, 1);
+    Constant *Zero = Constant::getNullValue(SizeTy);
+    if (dim == 2) {
+      One = ConstantVector::getSplat(
+          cast<VectorType>(SizeTy)->getElementCount(), One);
+    }
+    auto Max = builder.CreateSub(Size, One);
+    auto ClampF = M.getOrInsertFunction(
+        clamp_name, FunctionType::get(SizeTy, {SizeTy, SizeTy, SizeTy}, false));
+    Coord = builder.CreateCall(ClampF, {Coord, Zero, Max});
+  }
+
+  auto FetchF = M.getOrInsertFunction(
+      name.substr(0, sampler_pos) +
+          name.substr(sampler_pos + sampler_mangling.size()),
+      FunctionType::get(CI->getType(), {Image->getType(), Coord->getType()},
+                        false));
+  return builder.CreateCall(FetchF, {Image, Coord});
+}
+
 bool ReplaceOpenCLBuiltinPass::replaceAtomics(Function &F, spv::Op Op) {
   return replaceCallsWithValue(F, [&](CallInst *CI) {
     auto IntTy = Type::getInt32Ty(F.getContext());
@@ -2374,7 +2960,8 @@ bool ReplaceOpenCLBuiltinPass::replaceAtomics(Function &F, spv::Op Op) {
       Params.push_back(CI->getArgOperand(1));
     }
 
-    return clspv::InsertSPIRVOp(CI, Op, {}, CI->getType(), Params);
+    return clspv::InsertSPIRVOp(CI, Op, {}, CI->getType(), Params,
+                                &Declarations);
   });
 }
 
@@ -2417,9 +3004,7 @@ bool ReplaceOpenCLBuiltinPass::replaceCross(Function &F) {
     auto Vec3Ty = Arg0->getType();
 
     auto NewFType = FunctionType::get(Vec3Ty, {Vec3Ty, Vec3Ty}, false);
-    auto NewFName = Builtins::GetMangledFunctionName("cross", NewFType);
-
-    auto Cross3Func = M.getOrInsertFunction(NewFName, NewFType);
+    auto Cross3Func = Declarations.getBuiltin("cross", NewFType, NewFType);
 
     auto DownResult = CallInst::Create(Cross3Func, {Arg0, Arg1}, "", CI);
 
@@ -2456,14 +3041,19 @@ bool ReplaceOpenCLBuiltinPass::replaceFract(Function &F, int vec_size) {
   // Mapping from the fract builtin to the floor, fmin, and clspv.fract builtins
   // we need.  The clspv.fract builtin is the same as GLSL.std.450 Fract.
 
-  Module &M = *F.getParent();
-  return replaceCallsWithValue(F, [&](CallInst *CI) {
+  // This is either float or a float vector.  All the float-like
+  // types are this type.
+  auto result_ty = F.getReturnType();
 
-    // This is either float or a float vector.  All the float-like
-    // types are this type.
-    auto result_ty = F.getReturnType();
+  // The names are the same for every call.
+  const string fmin_name = Builtins::GetMangledFunctionName("fmin", result_ty);
+  const string floor_name =
+      Builtins::GetMangledFunctionName("floor", result_ty);
+  const string clspv_fract_name =
+      Builtins::GetMangledFunctionName("clspv.fract", result_ty);
 
-    std::string fmin_name = Builtins::GetMangledFunctionName("fmin", result_ty);
+  Module &M = *F.getParent();
+  return replaceCallsWithValue(F, [&](CallInst *CI) {
     Function *fmin_fn = M.getFunction(fmin_name);
     if (!fmin_fn) {
       // Make the fmin function.
@@ -2475,8 +3065,6 @@ bool ReplaceOpenCLBuiltinPass::replaceFract(Function &F, int vec_size) {
       fmin_fn->setCallingConv(CallingConv::SPIR_FUNC);
     }
 
-    std::string floor_name =
-        Builtins::GetMangledFunctionName("floor", result_ty);
     Function *floor_fn = M.getFunction(floor_name);
     if (!floor_fn) {
       // Make the floor function.
@@ -2487,8 +3075,6 @@ bool ReplaceOpenCLBuiltinPass::replaceFract(Function &F, int vec_size) {
       floor_fn->setCallingConv(CallingConv::SPIR_FUNC);
     }
 
-    std::string clspv_fract_name =
-        Builtins::GetMangledFunctionName("clspv.fract", result_ty);
     Function *clspv_fract_fn = M.getFunction(clspv_fract_name);
     if (!clspv_fract_fn) {
       // Make the clspv_fract function.
@@ -2674,7 +3260,8 @@ bool ReplaceOpenCLBuiltinPass::replaceAddSubSat(Function &F, bool is_signed,
           is_add ? Constant::getAllOnesValue(ty) : Constant::getNullValue(ty);
       auto struct_ty = GetPairStruct(ty);
       auto call =
-          InsertSPIRVOp(Call, op, {Attribute::ReadNone}, struct_ty, {a, b});
+          InsertSPIRVOp(Call, op, {Attribute::ReadNone}, struct_ty, {a, b},
+                        &Declarations);
       auto add_sub = builder.CreateExtractValue(call, {0});
       auto carry_borrow = builder.CreateExtractValue(call, {1});
       auto cmp = builder.CreateICmpEQ(carry_borrow, Constant::getNullValue(ty));
@@ -2684,7 +3271,7 @@ bool ReplaceOpenCLBuiltinPass::replaceAddSubSat(Function &F, bool is_signed,
 }
 
 bool ReplaceOpenCLBuiltinPass::replaceAtomicLoad(Function &F) {
-  return replaceCallsWithValue(F, [](CallInst *Call) {
+  return replaceCallsWithValue(F, [this](CallInst *Call) {
     auto pointer = Call->getArgOperand(0);
     // Clang emits an address space cast to the generic address space. Skip the
     // cast and use the input directly.
@@ -2701,13 +3288,14 @@ bool ReplaceOpenCLBuiltinPass::replaceAtomicLoad(Function &F) {
                                       spv::MemorySemanticsAcquireMask);
     auto scope = MemoryScope(scope_arg, is_global, Call);
     return InsertSPIRVOp(Call, spv::OpAtomicLoad, {Attribute::Convergent},
-                         Call->getType(), {pointer, scope, order});
+                         Call->getType(), {pointer, scope, order},
+                         &Declarations);
   });
 }
 
 bool ReplaceOpenCLBuiltinPass::replaceExplicitAtomics(
     Function &F, spv::Op Op, spv::MemorySemanticsMask semantics) {
-  return replaceCallsWithValue(F, [Op, semantics](CallInst *Call) {
+  return replaceCallsWithValue(F, [this, Op, semantics](CallInst *Call) {
     auto pointer = Call->getArgOperand(0);
     // Clang emits an address space cast to the generic address space. Skip the
     // cast and use the input directly.
@@ -2724,12 +3312,47 @@ bool ReplaceOpenCLBuiltinPass::replaceExplicitAtomics(
     auto scope = MemoryScope(scope_arg, is_global, Call);
     auto order = MemoryOrderSemantics(order_arg, is_global, Call, semantics);
     return InsertSPIRVOp(Call, Op, {Attribute::Convergent}, Call->getType(),
-                         {pointer, scope, order, value});
+                         {pointer, scope, order, value}, &Declarations);
+  });
+}
+
+bool ReplaceOpenCLBuiltinPass::replaceAtomicFetchFAdd(Function &F,
+                                                      bool is_sub) {
+  if (!clspv::Option::AtomicFloatAdd()) {
+    errs() << "error: " << F.getName()
+           << " on a floating-point type requires -atomic-float-add\n";
+    llvm_unreachable("Floating-point atomic add is not enabled");
+  }
+
+  return replaceCallsWithValue(F, [this, is_sub](CallInst *Call) {
+    auto pointer = Call->getArgOperand(0);
+    // Clang emits an address space cast to the generic address space. Skip the
+    // cast and use the input directly.
+    if (auto cast = dyn_cast<AddrSpaceCastOperator>(pointer)) {
+      pointer = cast->getPointerOperand();
+    }
+    Value *value = Call->getArgOperand(1);
+    Value *order_arg =
+        Call->getNumArgOperands() > 2 ? Call->getArgOperand(2) : nullptr;
+    Value *scope_arg =
+        Call->getNumArgOperands() > 3 ? Call->getArgOperand(3) : nullptr;
+    bool is_global = pointer->getType()->getPointerAddressSpace() ==
+                     clspv::AddressSpace::Global;
+    auto scope = MemoryScope(scope_arg, is_global, Call);
+    auto order = MemoryOrderSemantics(order_arg, is_global, Call,
+                                      spv::MemorySemanticsAcquireReleaseMask);
+    // There is no atomic floating-point subtract, so add the negation.
+    if (is_sub) {
+      value = UnaryOperator::CreateFNeg(value, "", Call);
+    }
+    return InsertSPIRVOp(Call, spv::OpAtomicFAddEXT, {Attribute::Convergent},
+                         Call->getType(), {pointer, scope, order, value},
+                         &Declarations);
   });
 }
 
 bool ReplaceOpenCLBuiltinPass::replaceAtomicCompareExchange(Function &F) {
-  return replaceCallsWithValue(F, [](CallInst *Call) {
+  return replaceCallsWithValue(F, [this](CallInst *Call) {
     auto pointer = Call->getArgOperand(0);
     // Clang emits an address space cast to the generic address space. Skip the
     // cast and use the input directly.
@@ -2765,7 +3388,8 @@ bool ReplaceOpenCLBuiltinPass::replaceAtomicCompareExchange(Function &F) {
     auto load = builder.CreateLoad(expected);
     auto cmp_xchg = InsertSPIRVOp(
         Call, spv::OpAtomicCompareExchange, {Attribute::Convergent},
-        value->getType(), {pointer, scope, success, failure, value, load});
+        value->getType(), {pointer, scope, success, failure, value, load},
+        &Declarations);
     auto cmp = builder.CreateICmpEQ(cmp_xchg, load);
     auto not_cmp = builder.CreateNot(cmp);
     auto then_branch = SplitBlockAndInsertIfThen(not_cmp, Call, false);
@@ -2783,7 +3407,7 @@ bool ReplaceOpenCLBuiltinPass::replaceCountZeroes(Function &F, bool leading) {
   if (bitwidth == 32 || bitwidth > 64)
     return false;
 
-  return replaceCallsWithValue(F, [&F, bitwidth, leading](CallInst *Call) {
+  return replaceCallsWithValue(F, [this, bitwidth, leading](CallInst *Call) {
     auto in = Call->getArgOperand(0);
     IRBuilder<> builder(Call);
     auto int32_ty = builder.getInt32Ty();
@@ -2794,10 +3418,8 @@ bool ReplaceOpenCLBuiltinPass::replaceCountZeroes(Function &F, bool leading) {
       c32 = ConstantVector::getSplat(vec_ty->getElementCount(), c32);
     }
     auto func_32bit_ty = FunctionType::get(ty, {ty}, false);
-    std::string func_32bit_name =
-        Builtins::GetMangledFunctionName((leading ? "clz" : "ctz"), ty);
-    auto func_32bit =
-        F.getParent()->getOrInsertFunction(func_32bit_name, func_32bit_ty);
+    auto func_32bit = Declarations.getBuiltin((leading ? "clz" : "ctz"), ty,
+                                              func_32bit_ty);
     if (bitwidth < 32) {
       // Extend the input to 32-bits and perform a clz/ctz.
       auto zext = builder.CreateZExt(in, ty);
@@ -2904,70 +3526,49 @@ bool ReplaceOpenCLBuiltinPass::replaceMadSat(Function &F, bool is_signed) {
         auto clamp = builder.CreateCall(callee, {add, min, max});
         return builder.CreateTrunc(clamp, ty);
       } else {
+        // The product and the sign extended addend are summed as a double
+        // width integer {hi, lo}, which cannot overflow:
+        // {lo, hi} = smul_extended(a, b)
+        // {add, carry} = add_carry(lo, c)
+        // res_hi = hi + (c >> (bitwidth - 1)) + carry
+        // The sum fits in bitwidth bits iff res_hi is the sign extension of
+        // add, otherwise its sign is the sign of res_hi:
+        // fits = res_hi == (add >> (bitwidth - 1))
+        // mad_sat = fits ? add : (res_hi < 0 ? MIN : MAX)
         auto struct_ty = GetPairStruct(ty);
-        // Compute
-        // {hi, lo} = smul_extended(a, b)
-        // add = lo + c
         auto mul_ext = InsertSPIRVOp(Call, spv::OpSMulExtended,
-                                     {Attribute::ReadNone}, struct_ty, {a, b});
+                                     {Attribute::ReadNone}, struct_ty, {a, b},
+                                     &Declarations);
         auto mul_lo = builder.CreateExtractValue(mul_ext, {0});
         auto mul_hi = builder.CreateExtractValue(mul_ext, {1});
-        auto add = builder.CreateAdd(mul_lo, c);
+        auto add_carry =
+            InsertSPIRVOp(Call, spv::OpIAddCarry, {Attribute::ReadNone},
+                          struct_ty, {mul_lo, c}, &Declarations);
+        auto add = builder.CreateExtractValue(add_carry, {0});
+        auto carry = builder.CreateExtractValue(add_carry, {1});
 
-        // Constants for use in the calculation.
         Constant *min = ConstantInt::get(Call->getContext(),
                                          APInt::getSignedMinValue(bitwidth));
         Constant *max = ConstantInt::get(Call->getContext(),
                                          APInt::getSignedMaxValue(bitwidth));
-        Constant *max_plus_1 = ConstantInt::get(
-            Call->getContext(),
-            APInt::getSignedMaxValue(bitwidth) + APInt(bitwidth, 1));
+        Constant *sign_shift =
+            ConstantInt::get(Call->getContext(), APInt(bitwidth, bitwidth - 1));
         if (auto vec_ty = dyn_cast<VectorType>(ty)) {
           min = ConstantVector::getSplat(vec_ty->getElementCount(), min);
           max = ConstantVector::getSplat(vec_ty->getElementCount(), max);
-          max_plus_1 =
-              ConstantVector::getSplat(vec_ty->getElementCount(), max_plus_1);
+          sign_shift =
+              ConstantVector::getSplat(vec_ty->getElementCount(), sign_shift);
         }
 
-        auto a_xor_b = builder.CreateXor(a, b);
-        auto same_sign =
-            builder.CreateICmpSGT(a_xor_b, Constant::getAllOnesValue(ty));
-        auto different_sign = builder.CreateNot(same_sign);
-        auto hi_eq_0 = builder.CreateICmpEQ(mul_hi, Constant::getNullValue(ty));
-        auto hi_ne_0 = builder.CreateNot(hi_eq_0);
-        auto lo_ge_max = builder.CreateICmpUGE(mul_lo, max);
-        auto c_gt_0 = builder.CreateICmpSGT(c, Constant::getNullValue(ty));
-        auto c_lt_0 = builder.CreateICmpSLT(c, Constant::getNullValue(ty));
-        auto add_gt_max = builder.CreateICmpUGT(add, max);
-        auto hi_eq_m1 =
-            builder.CreateICmpEQ(mul_hi, Constant::getAllOnesValue(ty));
-        auto hi_ne_m1 = builder.CreateNot(hi_eq_m1);
-        auto lo_le_max_plus_1 = builder.CreateICmpULE(mul_lo, max_plus_1);
-        auto max_sub_lo = builder.CreateSub(max, mul_lo);
-        auto c_lt_max_sub_lo = builder.CreateICmpULT(c, max_sub_lo);
-
-        // Equivalent to:
-        // if (((x < 0) == (y < 0)) && mul_hi != 0)
-        //   return MAX
-        // if (mul_hi == 0 && mul_lo >= MAX && (z > 0 || add > MAX))
-        //   return MAX
-        // if (((x < 0) != (y < 0)) && mul_hi != -1)
-        //   return MIN
-        // if (hi == -1 && mul_lo <= (MAX + 1) && (z < 0 || z < (MAX - mul_lo))
-        //   return MIN
-        // return add
-        auto max_clamp_1 = builder.CreateAnd(same_sign, hi_ne_0);
-        auto max_clamp_2 = builder.CreateOr(c_gt_0, add_gt_max);
-        auto tmp = builder.CreateAnd(hi_eq_0, lo_ge_max);
-        max_clamp_2 = builder.CreateAnd(tmp, max_clamp_2);
-        auto max_clamp = builder.CreateOr(max_clamp_1, max_clamp_2);
-        auto min_clamp_1 = builder.CreateAnd(different_sign, hi_ne_m1);
-        auto min_clamp_2 = builder.CreateOr(c_lt_0, c_lt_max_sub_lo);
-        tmp = builder.CreateAnd(hi_eq_m1, lo_le_max_plus_1);
-        min_clamp_2 = builder.CreateAnd(tmp, min_clamp_2);
-        auto min_clamp = builder.CreateOr(min_clamp_1, min_clamp_2);
-        auto sel = builder.CreateSelect(min_clamp, min, add);
-        return builder.CreateSelect(max_clamp, max, sel);
+        auto c_hi = builder.CreateAShr(c, sign_shift);
+        auto hi_sum = builder.CreateAdd(mul_hi, c_hi);
+        auto res_hi = builder.CreateAdd(hi_sum, carry);
+        auto add_sign = builder.CreateAShr(add, sign_shift);
+        auto fits = builder.CreateICmpEQ(res_hi, add_sign);
+        auto negative =
+            builder.CreateICmpSLT(res_hi, Constant::getNullValue(ty));
+        auto clamp = builder.CreateSelect(negative, min, max);
+        return builder.CreateSelect(fits, add, clamp);
       }
     } else {
       // {lo, hi} = mul_extended(a, b)
@@ -2976,12 +3577,13 @@ bool ReplaceOpenCLBuiltinPass::replaceMadSat(Function &F, bool is_signed) {
       // mad_sat = cmp ? add : MAX
       auto struct_ty = GetPairStruct(ty);
       auto mul_ext = InsertSPIRVOp(Call, spv::OpUMulExtended,
-                                   {Attribute::ReadNone}, struct_ty, {a, b});
+                                   {Attribute::ReadNone}, struct_ty, {a, b},
+                                   &Declarations);
       auto mul_lo = builder.CreateExtractValue(mul_ext, {0});
       auto mul_hi = builder.CreateExtractValue(mul_ext, {1});
       auto add_carry =
           InsertSPIRVOp(Call, spv::OpIAddCarry, {Attribute::ReadNone},
-                        struct_ty, {mul_lo, c});
+                        struct_ty, {mul_lo, c}, &Declarations);
       auto add = builder.CreateExtractValue(add_carry, {0});
       auto carry = builder.CreateExtractValue(add_carry, {1});
       auto or_value = builder.CreateOr(mul_hi, carry);
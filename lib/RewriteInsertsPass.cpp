@@ -12,16 +12,18 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <string>
 #include <utility>
 
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/SmallVector.h"
-#include "llvm/ADT/UniqueVector.h"
 #include "llvm/IR/Attributes.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
@@ -49,6 +51,11 @@ public:
 private:
   using InsertionVector = SmallVector<Instruction *, 4>;
 
+  // Replaces chains of insertions whose only use is a store by a store of
+  // each inserted member, so the composite is never built.  Returns true if
+  // the module was modified.
+  bool ReplaceStoredInsertionChains(Module &M);
+
   // Replaces chains of insertions that cover the entire value.
   // Such a change always reduces the number of instructions, so
   // we always perform these.  Returns true if the module was modified.
@@ -262,7 +269,12 @@ llvm::ModulePass *createRewriteInsertsPass() {
 } // namespace clspv
 
 bool RewriteInsertsPass::runOnModule(Module &M) {
-  bool Changed = ReplaceCompleteInsertionChains(M);
+  bool Changed = false;
+  if (clspv::Option::MemberStoresForInserts()) {
+    Changed |= ReplaceStoredInsertionChains(M);
+  }
+
+  Changed |= ReplaceCompleteInsertionChains(M);
 
   if (clspv::Option::HackInserts()) {
     Changed |= ReplacePartialInsertions(M);
@@ -271,6 +283,79 @@ bool RewriteInsertsPass::runOnModule(Module &M) {
   return Changed;
 }
 
+bool RewriteInsertsPass::ReplaceStoredInsertionChains(Module &M) {
+  bool Changed = false;
+  const auto &DL = M.getDataLayout();
+
+  SmallVector<StoreInst *, 16> WorkList;
+  for (Function &F : M) {
+    for (BasicBlock &BB : F) {
+      for (Instruction &I : BB) {
+        if (auto *store = dyn_cast<StoreInst>(&I)) {
+          auto *iv = dyn_cast<InsertValueInst>(store->getValueOperand());
+          if (store->isSimple() && iv && iv->hasOneUse()) {
+            WorkList.push_back(store);
+          }
+        }
+      }
+    }
+  }
+
+  auto *i32 = Type::getInt32Ty(M.getContext());
+  for (StoreInst *store : WorkList) {
+    Changed = true;
+    auto *tail = cast<InsertValueInst>(store->getValueOperand());
+    auto *type = tail->getType();
+
+    // Gather the inserted members, walking back along insertions only used
+    // by the chain.  A member inserted later in the chain wins.
+    std::vector<Value *> members(GetNumElements(type), nullptr);
+    InsertionVector chain;
+    Value *base = tail;
+    while (auto *insertion = dyn_cast<InsertValueInst>(base)) {
+      if (insertion->getNumIndices() != 1 || !insertion->hasOneUse())
+        break;
+      chain.push_back(insertion);
+      auto &member = members[insertion->getIndices()[0]];
+      if (!member) {
+        member = insertion->getInsertedValueOperand();
+      }
+      base = insertion->getAggregateOperand();
+    }
+
+    // Store the base first if it provides any member.
+    IRBuilder<> Builder(store);
+    auto *ptr = store->getPointerOperand();
+    const auto alignment = store->getAlign();
+    if (!isa<UndefValue>(base) &&
+        std::find(members.begin(), members.end(), nullptr) != members.end()) {
+      Builder.CreateAlignedStore(base, ptr, alignment);
+    }
+    for (unsigned i = 0; i < members.size(); ++i) {
+      if (!members[i])
+        continue;
+      uint64_t offset = 0;
+      if (auto *struct_ty = dyn_cast<StructType>(type)) {
+        offset = DL.getStructLayout(struct_ty)->getElementOffset(i);
+      } else {
+        offset = i * DL.getTypeAllocSize(type->getArrayElementType());
+      }
+      auto *member_ptr = Builder.CreateInBoundsGEP(
+          type, ptr, {ConstantInt::get(i32, 0), ConstantInt::get(i32, i)});
+      Builder.CreateAlignedStore(members[i], member_ptr,
+                                 commonAlignment(alignment, offset));
+    }
+
+    // Remove the store and the chain, from the tail back to the head.
+    store->eraseFromParent();
+    for (auto *insertion : chain) {
+      insertion->eraseFromParent();
+    }
+  }
+
+  return Changed;
+}
+
 bool RewriteInsertsPass::ReplaceCompleteInsertionChains(Module &M) {
   bool Changed = false;
 
@@ -342,28 +427,30 @@ bool RewriteInsertsPass::ReplacePartialInsertions(Module &M) {
   // the number of new instructions, generate a construction for each
   // tail of an insertion chain.
 
-  UniqueVector<InsertValueInst *> insertions;
+  // |num_uses| maps each of them, in program order, to the number of times it
+  // is used by another InsertValue.
+  MapVector<InsertValueInst *, unsigned> num_uses;
   for (Function &F : M) {
     for (BasicBlock &BB : F) {
       for (Instruction &I : BB) {
         if (InsertValueInst *iv = dyn_cast<InsertValueInst>(&I)) {
           if (iv->getType()->isStructTy()) {
-            insertions.insert(iv);
+            num_uses.insert({iv, 0});
           }
         }
       }
     }
   }
 
-  // Now count how many times each InsertValue is used by another InsertValue.
-  // The |num_uses| vector is indexed by the unique id that |insertions|
-  // assigns to it.
-  std::vector<unsigned> num_uses(insertions.size() + 1);
-  // Count from the user's perspective.
-  for (InsertValueInst *insertion : insertions) {
+  // Now count the uses.  Count from the user's perspective.
+  for (auto &entry : num_uses) {
+    InsertValueInst *insertion = entry.first;
     if (auto *agg =
             dyn_cast<InsertValueInst>(insertion->getAggregateOperand())) {
-      ++(num_uses[insertions.idFor(agg)]);
+      auto where = num_uses.find(agg);
+      if (where != num_uses.end()) {
+        ++where->second;
+      }
     }
   }
 
@@ -372,9 +459,9 @@ bool RewriteInsertsPass::ReplacePartialInsertions(Module &M) {
 
   // Get the first list of insertion tails.
   InsertionVector WorkList;
-  for (InsertValueInst *insertion : insertions) {
-    if (num_uses[insertions.idFor(insertion)] == 0) {
-      WorkList.push_back(insertion);
+  for (auto &entry : num_uses) {
+    if (entry.second == 0) {
+      WorkList.push_back(entry.first);
     }
   }
 
@@ -433,8 +520,7 @@ bool RewriteInsertsPass::ReplacePartialInsertions(Module &M) {
       // we can.  Stop at the first element that has a remaining use.
       for (auto *chainElem : chain) {
         if (chainElem->hasNUsesOrMore(1)) {
-          unsigned &use_count =
-              num_uses[insertions.idFor(cast<InsertValueInst>(chainElem))];
+          unsigned &use_count = num_uses[cast<InsertValueInst>(chainElem)];
           assert(use_count > 0);
           --use_count;
           if (use_count == 0) {
@@ -26,20 +26,78 @@ namespace clspv {
 
 using namespace llvm;
 
-Instruction *InsertSPIRVOp(Instruction *Insert, spv::Op Opcode,
-                           ArrayRef<Attribute::AttrKind> Attributes,
-                           Type *RetType, ArrayRef<Value *> Args) {
+namespace {
 
-  // Prepare mangled name
+// Declares in |M| the function representing the SPIR-V instruction |Opcode|,
+// of type |FTy|. Its name is unique for each combination of the types of the
+// operands.
+Function *DeclareSPIRVOp(Module &M, spv::Op Opcode, FunctionType *FTy) {
   std::string MangledName = clspv::SPIRVOpIntrinsicFunction();
   MangledName += ".";
   MangledName += std::to_string(Opcode);
   MangledName += ".";
-  for (auto Arg : Args) {
-    MangledName += Builtins::GetMangledTypeName(Arg->getType());
+  for (auto ParamTy : FTy->params().drop_front()) {
+    MangledName += Builtins::GetMangledTypeName(ParamTy);
+  }
+  return cast<Function>(M.getOrInsertFunction(MangledName, FTy).getCallee());
+}
+
+} // namespace
+
+void DeclarationCache::reset(Module &Mod) {
+  M = &Mod;
+  SPIRVOps.clear();
+  MangledBuiltins.clear();
+  Functions.clear();
+}
+
+Function *DeclarationCache::getSPIRVOp(spv::Op Opcode, FunctionType *FTy) {
+  auto &F = SPIRVOps[{Opcode, FTy}];
+  if (!F)
+    F = DeclareSPIRVOp(*M, Opcode, FTy);
+  return F;
+}
+
+FunctionCallee DeclarationCache::getBuiltin(const char *Name, Type *MangleTy,
+                                            FunctionType *FTy) {
+  auto &F = MangledBuiltins[std::make_tuple(std::string(Name), MangleTy, FTy)];
+  if (!F)
+    F = M->getOrInsertFunction(Builtins::GetMangledFunctionName(Name, MangleTy),
+                               FTy);
+  return F;
+}
+
+Function *DeclarationCache::getFunction(StringRef Name, FunctionType *FTy) {
+  auto &F = Functions[std::make_pair(Name.str(), FTy)];
+  if (!F)
+    F = Function::Create(FTy, GlobalValue::ExternalLinkage, Name, M);
+  return F;
+}
+
+void DeclarationCache::forget(Function *F) {
+  for (auto it = SPIRVOps.begin(); it != SPIRVOps.end(); ++it) {
+    if (it->second == F)
+      SPIRVOps.erase(it);
   }
+  for (auto it = MangledBuiltins.begin(); it != MangledBuiltins.end();) {
+    if (it->second.getCallee()->stripPointerCasts() == F)
+      it = MangledBuiltins.erase(it);
+    else
+      ++it;
+  }
+  for (auto it = Functions.begin(); it != Functions.end();) {
+    if (it->second == F)
+      it = Functions.erase(it);
+    else
+      ++it;
+  }
+}
 
-  // Create a function in the module
+Instruction *InsertSPIRVOp(Instruction *Insert, spv::Op Opcode,
+                           ArrayRef<Attribute::AttrKind> Attributes,
+                           Type *RetType, ArrayRef<Value *> Args,
+                           DeclarationCache *Cache) {
+  // The opcode is passed as the first argument.
   auto M = Insert->getModule();
   auto Int32Ty = Type::getInt32Ty(M->getContext());
   SmallVector<Type *, 8> ArgTypes = {Int32Ty};
@@ -47,10 +105,11 @@ Instruction *InsertSPIRVOp(Instruction *Insert, spv::Op Opcode,
     ArgTypes.push_back(Arg->getType());
   }
   auto NewFType = FunctionType::get(RetType, ArgTypes, false);
-  auto NewFTyC = M->getOrInsertFunction(MangledName, NewFType);
-  auto NewF = cast<Function>(NewFTyC.getCallee());
+  auto NewF = Cache ? Cache->getSPIRVOp(Opcode, NewFType)
+                    : DeclareSPIRVOp(*M, Opcode, NewFType);
   for (auto A : Attributes) {
-    NewF->addFnAttr(A);
+    if (!NewF->hasFnAttribute(A))
+      NewF->addFnAttr(A);
   }
 
   // Now call it with the values we were passed
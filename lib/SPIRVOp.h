@@ -12,8 +12,16 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <map>
+#include <string>
+#include <tuple>
+#include <utility>
+
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/Attributes.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Value.h"
@@ -24,6 +32,38 @@ namespace clspv {
 
 using namespace llvm;
 
+// Caches the declarations a pass inserts calls to, so that a pass inserting
+// many calls to the same function builds its name and looks it up in the
+// symbol table once. The cache belongs to the pass and only holds
+// declarations of the module it was last reset to.
+class DeclarationCache {
+public:
+  // Forgets the cached declarations and starts caching those of |M|.
+  void reset(Module &M);
+
+  // Returns the function representing the SPIR-V instruction |Opcode|, of
+  // type |FTy| whose first parameter is the opcode.
+  Function *getSPIRVOp(spv::Op Opcode, FunctionType *FTy);
+
+  // Returns the builtin |Name| mangled for |MangleTy|, with type |FTy|.
+  FunctionCallee getBuiltin(const char *Name, Type *MangleTy,
+                            FunctionType *FTy);
+
+  // Returns a function named |Name| of type |FTy|. Each type gets its own
+  // function, whose name is made unique by the symbol table.
+  Function *getFunction(StringRef Name, FunctionType *FTy);
+
+  // Forgets |F|, which is about to be erased.
+  void forget(Function *F);
+
+private:
+  Module *M = nullptr;
+  DenseMap<std::pair<unsigned, FunctionType *>, Function *> SPIRVOps;
+  std::map<std::tuple<std::string, Type *, FunctionType *>, FunctionCallee>
+      MangledBuiltins;
+  std::map<std::pair<std::string, FunctionType *>, Function *> Functions;
+};
+
 // Insert a call to a specific SPIR-V instruction after Insert
 //
 // A function with a name guaranteed to be unique for each combination of types
@@ -36,8 +76,11 @@ using namespace llvm;
 // Since this function may modify the symbol table of the module containing
 // Insert, it shouldn't be used while iterating over the symbols of that module
 // unless the caller knows that no new function will be created.
+//
+// The function is looked up in Cache first, if given.
 Instruction *InsertSPIRVOp(Instruction *Insert, spv::Op Opcode,
                            ArrayRef<Attribute::AttrKind> Attributes,
-                           Type *RetType, ArrayRef<Value *> Args);
+                           Type *RetType, ArrayRef<Value *> Args,
+                           DeclarationCache *Cache = nullptr);
 
 }; // namespace clspv
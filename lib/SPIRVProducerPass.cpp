@@ -16,28 +16,33 @@
 #pragma warning(push, 0)
 #endif
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <deque>
 #include <iomanip>
 #include <list>
 #include <memory>
-#include <set>
-#include <sstream>
 #include <string>
 #include <tuple>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/StringSwitch.h"
-#include "llvm/ADT/UniqueVector.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
 #include "llvm/IR/ValueSymbolTable.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
@@ -48,8 +53,12 @@
 #include "spirv/unified1/spirv.hpp"
 
 #include "clspv/AddressSpace.h"
+#include "clspv/ImmutableSamplers.h"
+#include "clspv/KernelResourceUsage.h"
 #include "clspv/Option.h"
+#include "clspv/ProfileCounters.h"
 #include "clspv/PushConstant.h"
+#include "clspv/Sampler.h"
 #include "clspv/SpecConstant.h"
 #include "clspv/spirv_c_strings.hpp"
 #include "clspv/spirv_glsl.hpp"
@@ -64,8 +73,10 @@
 #include "Layout.h"
 #include "NormalizeGlobalVariable.h"
 #include "Passes.h"
+#include "SizeOptimizer.h"
 #include "SpecConstant.h"
 #include "Types.h"
+#include "UniformityAnalysis.h"
 
 #if defined(_MSC_VER)
 #pragma warning(pop)
@@ -134,14 +145,23 @@ public:
 
 enum SPIRVOperandType { NUMBERID, LITERAL_WORD, LITERAL_DWORD, LITERAL_STRING };
 
+// Copies |Str| into the running producer's arena as a null-terminated string
+// padded with zeros to a whole number of words.
+StringRef SaveOperandString(StringRef Str);
+
+// A single operand.  Operands are small and trivially copyable: string
+// literals live in the producer's arena rather than in the operand itself.
 struct SPIRVOperand {
   explicit SPIRVOperand(SPIRVOperandType Ty, uint32_t Num) : Type(Ty) {
     LiteralNum[0] = Num;
   }
+  explicit SPIRVOperand(SPIRVOperandType Ty, StringRef Str) : Type(Ty) {
+    auto Saved = SaveOperandString(Str);
+    LiteralStr = Saved.data();
+    LiteralStrSize = uint32_t(Saved.size());
+  }
   explicit SPIRVOperand(SPIRVOperandType Ty, const char *Str)
-      : Type(Ty), LiteralStr(Str) {}
-  explicit SPIRVOperand(SPIRVOperandType Ty, StringRef Str)
-      : Type(Ty), LiteralStr(Str) {}
+      : SPIRVOperand(Ty, StringRef(Str)) {}
   explicit SPIRVOperand(ArrayRef<uint32_t> NumVec) {
     auto sz = NumVec.size();
     assert(sz >= 1 && sz <= 2);
@@ -154,7 +174,9 @@ struct SPIRVOperand {
 
   SPIRVOperandType getType() const { return Type; }
   uint32_t getNumID() const { return LiteralNum[0]; }
-  std::string getLiteralStr() const { return LiteralStr; }
+  StringRef getLiteralStr() const {
+    return StringRef(LiteralStr, LiteralStrSize);
+  }
   const uint32_t *getLiteralNum() const { return LiteralNum; }
 
   uint32_t GetNumWords() const {
@@ -166,15 +188,18 @@ struct SPIRVOperand {
       return 2;
     case LITERAL_STRING:
       // Account for the terminating null character.
-      return uint32_t((LiteralStr.size() + 4) / 4);
+      return (LiteralStrSize + 4) / 4;
     }
     llvm_unreachable("Unhandled case in SPIRVOperand::GetNumWords()");
   }
 
 private:
   SPIRVOperandType Type;
-  std::string LiteralStr;
-  uint32_t LiteralNum[2];
+  uint32_t LiteralStrSize = 0;
+  union {
+    uint32_t LiteralNum[2];
+    const char *LiteralStr;
+  };
 };
 
 typedef SmallVector<SPIRVOperand, 4> SPIRVOperandVec;
@@ -186,16 +211,10 @@ struct SPIRVInstruction {
     setResult(ResID);
   }
 
-  // Creates an instruction with an opcode and no result ID, and with the given
-  // operands.  This calls primary constructor to initialize Opcode, WordCount.
-  // Takes ownership of the operands and clears |Ops|.
-  SPIRVInstruction(spv::Op Opc, SPIRVOperandVec &Ops) : SPIRVInstruction(Opc) {
-    setOperands(Ops);
-  }
-  // Creates an instruction with an opcode and no result ID, and with the given
+  // Creates an instruction with an opcode and result ID, and with the given
   // operands.  This calls primary constructor to initialize Opcode, WordCount.
-  // Takes ownership of the operands and clears |Ops|.
-  SPIRVInstruction(spv::Op Opc, SPIRVID ResID, SPIRVOperandVec &Ops)
+  // |Ops| must be owned by the producer's arena (see saveOperands).
+  SPIRVInstruction(spv::Op Opc, SPIRVID ResID, ArrayRef<SPIRVOperand> Ops)
       : SPIRVInstruction(Opc, ResID) {
     setOperands(Ops);
   }
@@ -203,7 +222,7 @@ struct SPIRVInstruction {
   uint32_t getWordCount() const { return WordCount; }
   uint16_t getOpcode() const { return Opcode; }
   SPIRVID getResultID() const { return ResultID; }
-  const SPIRVOperandVec &getOperands() const { return Operands; }
+  ArrayRef<SPIRVOperand> getOperands() const { return Operands; }
 
 private:
   void setResult(SPIRVID ResID = 0) {
@@ -211,9 +230,9 @@ private:
     ResultID = ResID;
   }
 
-  void setOperands(SPIRVOperandVec &Ops) {
+  void setOperands(ArrayRef<SPIRVOperand> Ops) {
     assert(Operands.empty());
-    Operands = std::move(Ops);
+    Operands = Ops;
     for (auto &opd : Operands) {
       WordCount += uint16_t(opd.GetNumWords());
     }
@@ -223,18 +242,21 @@ private:
   uint32_t WordCount; // Check the 16-bit bound at code generation time.
   uint16_t Opcode;
   SPIRVID ResultID;
-  SPIRVOperandVec Operands;
+  // Owned by the producer's arena.
+  ArrayRef<SPIRVOperand> Operands;
 };
 
 struct SPIRVProducerPass final : public ModulePass {
   typedef DenseMap<Type *, SPIRVID> TypeMapType;
-  typedef UniqueVector<Type *> TypeList;
+  typedef SetVector<Type *> TypeList;
   typedef DenseMap<Value *, SPIRVID> ValueMapType;
   typedef std::list<SPIRVID> SPIRVIDListType;
   typedef std::vector<std::pair<Value *, SPIRVID>> EntryPointVecType;
-  typedef std::set<uint32_t> CapabilitySetType;
-  typedef std::list<SPIRVInstruction> SPIRVInstructionList;
-  typedef std::map<spv::BuiltIn, SPIRVID> BuiltinConstantMapType;
+  typedef SetVector<uint32_t> CapabilitySetType;
+  // A deque keeps placeholder instructions at stable addresses while
+  // allocating instructions in blocks.
+  typedef std::deque<SPIRVInstruction> SPIRVInstructionList;
+  typedef DenseMap<uint32_t, SPIRVID> BuiltinConstantMapType;
   // A vector of pairs, each of which is:
   // - the LLVM instruction that we will later generate SPIR-V code for
   // - the SPIR-V instruction placeholder that will be replaced
@@ -246,10 +268,12 @@ struct SPIRVProducerPass final : public ModulePass {
   explicit SPIRVProducerPass(
       raw_pwrite_stream &out,
       ArrayRef<std::pair<unsigned, std::string>> samplerMap,
-      bool outputCInitList)
+      bool outputCInitList, std::vector<uint32_t> *outputWords,
+      bool optimizeSize)
       : ModulePass(ID), module(nullptr), samplerMap(samplerMap), out(out),
-        binaryTempOut(binaryTempUnderlyingVector), binaryOut(&out),
-        outputCInitList(outputCInitList), patchBoundOffset(0), nextID(1),
+        binaryWords(outputWords ? outputWords : &binaryTempWords),
+        outputCInitList(outputCInitList), optimizeSize(optimizeSize),
+        patchBoundIndex(0), nextID(1),
         OpExtInstImportID(0), HasVariablePointersStorageBuffer(false),
         HasVariablePointers(false), SamplerTy(nullptr), WorkgroupSizeValueID(0),
         WorkgroupSizeVarID(0) {
@@ -270,6 +294,9 @@ struct SPIRVProducerPass final : public ModulePass {
   // output the SPIR-V header block
   void outputHeader();
 
+  // Writes the words as a C initializer list to |out|.
+  void WriteCInitList();
+
   // patch the SPIR-V header block
   void patchHeader();
 
@@ -277,7 +304,11 @@ struct SPIRVProducerPass final : public ModulePass {
   TypeMapType &getImageTypeMap() { return ImageTypeMap; }
   TypeList &getTypeList() { return Types; }
   ValueMapType &getValueMap() { return ValueMap; }
+  // Instructions for the function section go to the buffer of the function
+  // being generated, if any.
   SPIRVInstructionList &getSPIRVInstList(SPIRVSection Section) {
+    if (Section == kFunctions && !FunctionBuffers.empty())
+      return FunctionBuffers.back().Insts;
     return SPIRVSections[Section];
   };
   EntryPointVecType &getEntryPointVec() { return EntryPointVec; }
@@ -357,11 +388,17 @@ struct SPIRVProducerPass final : public ModulePass {
   void GenerateModuleInfo();
   void GenerateGlobalVar(GlobalVariable &GV);
   void GenerateWorkgroupVars();
+  // Generate the OpSpecConstants of the POD arguments read from
+  // specialization constants.
+  void GeneratePodSpecConstants();
   // Generate reflection instructions for resource variables associated with
   // arguments to F.
   void GenerateSamplers();
   // Generate OpVariables for %clspv.resource.var.* calls.
   void GenerateResourceVars();
+  // Returns the clspv::ArgAccess mask of the accesses to the memory of the
+  // resource variable |info| in the module.
+  uint32_t GetResourceVarAccess(const ResourceVarInfo *info);
   void GenerateFuncPrologue(Function &F);
   void GenerateFuncBody(Function &F);
   void GenerateEntryPointInitialStores();
@@ -377,7 +414,18 @@ struct SPIRVProducerPass final : public ModulePass {
   SPIRVID GenerateInstructionFromCall(CallInst *Call);
   void GenerateInstruction(Instruction &I);
   void GenerateFuncEpilogue();
-  void HandleDeferredInstruction();
+  // Resolves the deferred instructions from index |Begin| onwards.
+  void HandleDeferredInstruction(size_t Begin = 0);
+  // Returns true if the deferred instructions of |F| can be resolved as soon
+  // as its body is generated: every function it calls already has an ID.
+  bool CanStreamFunction(Function &F);
+  // Resolves the deferred instructions of the function just generated, from
+  // index |FirstDeferred| onwards, encodes the function to words and releases
+  // its instructions.
+  void StreamFunction(size_t FirstDeferred);
+  // Frees the instructions of |F|, a streamed function, leaving a single
+  // unreachable block so that it stays a definition.
+  void ReleaseFunctionBody(Function &F);
   void HandleDeferredDecorations();
   bool is4xi8vec(Type *Ty) const;
   spv::StorageClass GetStorageClass(unsigned AddrSpace) const;
@@ -411,8 +459,12 @@ struct SPIRVProducerPass final : public ModulePass {
   // Populate the merge and continue block maps.
   void PopulateStructuredCFGMaps();
 
+  // Returns the loop control mask for the OpLoopMerge of |L| and the partial
+  // unroll count, which is only meaningful with LoopControlPartialCountMask.
+  std::pair<uint32_t, uint32_t> GetLoopControls(Loop *L);
+
   // Wrapped methods of DataLayout accessors. If |type| was remapped for UBOs,
-  // uses the internal map, otherwise it falls back on the data layout.
+  // uses the recorded layout, otherwise it falls back on the data layout.
   uint64_t GetTypeSizeInBits(Type *type, const DataLayout &DL);
   uint64_t GetTypeStoreSize(Type *type, const DataLayout &DL);
   uint64_t GetTypeAllocSize(Type *type, const DataLayout &DL);
@@ -424,12 +476,30 @@ struct SPIRVProducerPass final : public ModulePass {
   Value *GetBasePointer(Value *v);
 
   // Add Capability if not already (e.g. CapabilityGroupNonUniformBroadcast)
-  void addCapability(uint32_t c) { CapabilitySet.emplace(c); }
+  void addCapability(uint32_t c) { CapabilitySet.insert(c); }
 
   // Sets |HasVariablePointersStorageBuffer| or |HasVariablePointers| base on
   // |address_space|.
   void setVariablePointersCapabilities(unsigned address_space);
 
+  // Adds the memory access operands of a load or store through a pointer of
+  // type |ptr_type| to |Ops|: Aligned, required for PhysicalStorageBuffer
+  // pointers, and NonPrivatePointer, which makes accesses to memory shared
+  // with other invocations take part in the availability and visibility
+  // operations of the Vulkan memory model.
+  void addMemoryAccess(Type *ptr_type, Align alignment, SPIRVOperandVec &Ops);
+
+  // Adds |value|, operand |position| of the SPIR-V instruction |opcode|
+  // counted after its result type, to |Ops|. With -vulkan-memory-model,
+  // memory semantics are rewritten for that model and memory scopes add the
+  // capabilities they need.
+  void addMemoryModelOperand(spv::Op opcode, unsigned position, Value *value,
+                             SPIRVOperandVec &Ops);
+
+  // Adds the capabilities needed by the atomic |opcode| on values of type
+  // |type|. Does nothing if |opcode| is not an atomic.
+  void addAtomicCapabilities(spv::Op opcode, Type *type);
+
   // Returns true if |lhs| and |rhs| represent the same resource or workgroup
   // variable.
   bool sameResource(Value *lhs, Value *rhs) const;
@@ -441,6 +511,28 @@ struct SPIRVProducerPass final : public ModulePass {
   // Returns true if |Arg| is called with a coherent resource.
   bool CalledWithCoherentResource(Argument &Arg);
 
+  // Returns the uniformity of the values of the module, computing it on first
+  // use.
+  clspv::UniformityAnalysis &getUniformity() {
+    if (!Uniformity)
+      Uniformity.reset(new clspv::UniformityAnalysis(*module));
+    return *Uniformity;
+  }
+
+  // Decorates |RID|, the result of |V|, with Uniform if its value is the same
+  // for the whole workgroup and with NonUniformEXT if it is a pointer whose
+  // resource is not. Only loads, phis and parameters are decorated Uniform:
+  // the driver sees the uniformity of other values from their operands.
+  void GenerateUniformityDecorations(Value *V, SPIRVID RID);
+
+  // Finds the float results of |F| decorated RelaxedPrecision with
+  // -relaxed-precision: the results of half_ and native_ builtins, or of all
+  // float arithmetic under relaxed math, and the arithmetic whose float
+  // operands are all relaxed values or constants, at least one of them a
+  // relaxed value. Values are visited in reverse post-order, so a phi fed by
+  // a back edge is not relaxed.
+  void FindRelaxedPrecisionValues(Function &F);
+
   //
   // Primary interface for adding SPIRVInstructions to a SPIRVSection.
   template <enum SPIRVSection TSection = kFunctions>
@@ -448,7 +540,9 @@ struct SPIRVProducerPass final : public ModulePass {
     bool has_result, has_result_type;
     spv::HasResultAndType(Opcode, &has_result, &has_result_type);
     SPIRVID RID = has_result ? incrNextID() : 0;
-    SPIRVSections[TSection].emplace_back(Opcode, RID, Operands);
+    getSPIRVInstList(TSection).emplace_back(
+        Opcode, RID, saveOperands(Operands, TSection));
+    Operands.clear();
     return RID;
   }
   template <enum SPIRVSection TSection = kFunctions>
@@ -475,8 +569,9 @@ struct SPIRVProducerPass final : public ModulePass {
   SPIRVID addSPIRVPlaceholder(Value *I) {
     SPIRVID RID = incrNextID();
     SPIRVOperandVec Ops;
-    SPIRVSections[kFunctions].emplace_back(spv::OpExtInst, RID, Ops);
-    DeferredInstVec.push_back({I, &SPIRVSections[kFunctions].back()});
+    auto &InstList = getSPIRVInstList(kFunctions);
+    InstList.emplace_back(spv::OpExtInst, RID, ArrayRef<SPIRVOperand>());
+    DeferredInstVec.push_back({I, &InstList.back()});
     return RID;
   }
   // Replace placeholder with actual SPIRVInstruction on the final pass
@@ -486,7 +581,8 @@ struct SPIRVProducerPass final : public ModulePass {
     bool has_result, has_result_type;
     spv::HasResultAndType(Opcode, &has_result, &has_result_type);
     SPIRVID RID = has_result ? I->getResultID() : 0;
-    *I = SPIRVInstruction(Opcode, RID, Operands);
+    *I = SPIRVInstruction(Opcode, RID, saveOperands(Operands, kFunctions));
+    Operands.clear();
     return RID;
   }
 
@@ -496,8 +592,15 @@ struct SPIRVProducerPass final : public ModulePass {
                                  const SPIRVID &InitID = SPIRVID());
 
   SPIRVID getReflectionImport();
+  SPIRVID getPodSpecConstantImport();
+  SPIRVID getProfileCountersImport();
+  SPIRVID getKernelResourceUsageImport();
+  SPIRVID getImmutableSamplersImport();
   void GenerateReflection();
   void GenerateKernelReflection();
+  // Reports the memory used by kernel |F|, declared by |kernel_decl|, and its
+  // suggested local size for -kernel-resource-usage.
+  void GenerateKernelResourceUsage(Function &F, SPIRVID kernel_decl);
   void GeneratePushConstantReflection();
   void GenerateSpecConstantReflection();
   void AddArgumentReflection(SPIRVID kernel_decl, const std::string &name,
@@ -514,26 +617,31 @@ private:
   // Set of Capabilities required
   CapabilitySetType CapabilitySet;
 
+  // Computed by getUniformity().
+  std::unique_ptr<clspv::UniformityAnalysis> Uniformity;
+  // The IDs decorated NonUniformEXT, which a no-op cast may share.
+  DenseSet<uint32_t> NonUniformIDs;
+  // The values of the current function decorated RelaxedPrecision.
+  DenseSet<const Value *> RelaxedPrecisionValues;
+
   // Map from clspv::BuiltinType to SPIRV Global Variable
   BuiltinConstantMapType BuiltinConstantMap;
 
   ArrayRef<std::pair<unsigned, std::string>> samplerMap;
   raw_pwrite_stream &out;
 
-  // TODO(dneto): Wouldn't it be better to always just emit a binary, and then
-  // convert to other formats on demand?
+  // The binary is always assembled as words first, then converted to other
+  // formats on demand.
 
-  // When emitting a C initialization list, the WriteSPIRVBinary method
-  // will actually write its words to this vector via binaryTempOut.
-  SmallVector<char, 100> binaryTempUnderlyingVector;
-  raw_svector_ostream binaryTempOut;
+  // Holds the words when the caller did not supply a buffer for them.
+  std::vector<uint32_t> binaryTempWords;
 
-  // Binary output writes to this stream, which might be |out| or
-  // |binaryTempOut|.  It's the latter when we really want to write a C
-  // initializer list.
-  raw_pwrite_stream *binaryOut;
+  // Binary output writes to this buffer, which might be the caller's buffer or
+  // |binaryTempWords|.  Words in the caller's buffer are not copied to |out|.
+  std::vector<uint32_t> *binaryWords;
   const bool outputCInitList; // If true, output look like {0x7023, ... , 5}
-  uint64_t patchBoundOffset;
+  const bool optimizeSize;    // If true, shrink the module before output.
+  size_t patchBoundIndex;
   uint32_t nextID;
 
   SPIRVID incrNextID() { return nextID++; }
@@ -551,7 +659,28 @@ private:
   TypeList Types;
   // Maps an LLVM Value pointer to the corresponding SPIR-V Id.
   ValueMapType ValueMap;
+  // The structural key of a constant: its opcode followed by the words of its
+  // operands, starting with the result type ID.
+  typedef std::vector<uint32_t> ConstantKey;
+  struct ConstantKeyHash {
+    size_t operator()(const ConstantKey &Key) const {
+      return hash_combine_range(Key.begin(), Key.end());
+    }
+  };
+  // Maps the structural key of each emitted constant to its SPIR-V ID.
+  std::unordered_map<ConstantKey, SPIRVID, ConstantKeyHash> ConstantKeyMap;
   SPIRVInstructionList SPIRVSections[kSectionCount];
+  // The function section is kept as one buffer per function definition, in
+  // module order.  These are written after SPIRVSections[kFunctions].  A
+  // function that was streamed (see StreamFunction) is held as words, followed
+  // by any instructions added after it was streamed.
+  struct FunctionBuffer {
+    std::vector<uint32_t> Words;
+    SPIRVInstructionList Insts;
+  };
+  std::deque<FunctionBuffer> FunctionBuffers;
+  // True while generating a function that will be streamed.
+  bool StreamingFunction = false;
 
   EntryPointVecType EntryPointVec;
   DeferredInstVecType DeferredInstVec;
@@ -613,7 +742,7 @@ private:
   SmallVector<std::unique_ptr<ResourceVarInfo>, 8> ResourceVarInfoList;
   // This is a vector of pointers of all the resource vars, but ordered by
   // kernel function, and then by argument.
-  UniqueVector<ResourceVarInfo *> ModuleOrderedResourceVars;
+  SetVector<ResourceVarInfo *> ModuleOrderedResourceVars;
   // Map a function to the ordered list of resource variables it uses, one for
   // each argument.  If an argument does not use a resource variable, it
   // will have a null pointer entry.
@@ -625,7 +754,7 @@ private:
   // arrays and structures supporting storage buffers and uniform buffers.
   TypeList TypesNeedingLayout;
   // What LLVM struct types map to a SPIR-V struct type with Block decoration?
-  UniqueVector<StructType *> StructTypesNeedingBlock;
+  SetVector<StructType *> StructTypesNeedingBlock;
   // For a call that represents a load from an opaque type (samplers, images),
   // map it to the variable id it should load from.
   DenseMap<CallInst *, SPIRVID> ResourceVarDeferredLoadCalls;
@@ -652,26 +781,72 @@ private:
   DenseMap<const Argument *, int> LocalArgSpecIds;
   // A mapping from SpecId to its LocalArgInfo.
   DenseMap<int, LocalArgInfo> LocalSpecIdInfoMap;
-  // A mapping from a remapped type to its real offsets.
-  DenseMap<Type *, std::vector<uint32_t>> RemappedUBOTypeOffsets;
-  // A mapping from a remapped type to its real sizes.
-  DenseMap<Type *, std::tuple<uint64_t, uint64_t, uint64_t>>
-      RemappedUBOTypeSizes;
+  // A mapping from the SpecId of a POD argument to its OpSpecConstant.
+  DenseMap<uint32_t, SPIRVID> PodSpecConstantIDs;
+  // The sizes, offsets and alignments of the types, including the real ones of
+  // the types remapped for UBOs.
+  std::unique_ptr<clspv::TypeLayoutCache> TypeLayout;
 
   // Maps basic block to its merge block.
   DenseMap<BasicBlock *, BasicBlock *> MergeBlocks;
   // Maps basic block to its continue block.
   DenseMap<BasicBlock *, BasicBlock *> ContinueBlocks;
+  // Maps loop header to its loop control mask and partial unroll count.
+  DenseMap<BasicBlock *, std::pair<uint32_t, uint32_t>> LoopControls;
+
+  // The OpSampledImage already generated in |SampledImageBlock| for each
+  // image and sampler pair.
+  BasicBlock *SampledImageBlock = nullptr;
+  DenseMap<std::pair<Value *, Value *>, SPIRVID> SampledImages;
 
   SPIRVID ReflectionID;
+  SPIRVID PodSpecConstantImportID;
+  SPIRVID ProfileCountersImportID;
+  SPIRVID KernelResourceUsageImportID;
+  SPIRVID ImmutableSamplersImportID;
   DenseMap<Function *, SPIRVID> KernelDeclarations;
 
+  // Backing storage for instruction operands and string literals.  Everything
+  // in it lives until the producer is destroyed.
+  BumpPtrAllocator OperandArena;
+  // Backing storage for the operands of the function being streamed.  This is
+  // reset once the function is encoded.
+  BumpPtrAllocator StreamedFunctionArena;
+
 public:
-  static SPIRVProducerPass *Ptr;
+  // The producer running on this thread.  Compilations may run concurrently on
+  // different threads, each with its own producer.
+  static thread_local SPIRVProducerPass *Ptr;
+
+  StringRef saveOperandString(StringRef Str) {
+    // Round up to include the terminating null character.
+    size_t Size = alignTo(Str.size() + 1, 4);
+    char *Data = OperandArena.Allocate<char>(Size);
+    std::memcpy(Data, Str.data(), Str.size());
+    std::memset(Data + Str.size(), 0, Size - Str.size());
+    return StringRef(Data, Str.size());
+  }
+
+  // Copies |Ops| into the arena for instructions of |Section|.
+  ArrayRef<SPIRVOperand> saveOperands(ArrayRef<SPIRVOperand> Ops,
+                                      SPIRVSection Section) {
+    if (Ops.empty())
+      return {};
+    auto &Arena = Section == kFunctions && StreamingFunction
+                      ? StreamedFunctionArena
+                      : OperandArena;
+    auto *Data = Arena.Allocate<SPIRVOperand>(Ops.size());
+    std::uninitialized_copy(Ops.begin(), Ops.end(), Data);
+    return makeArrayRef(Data, Ops.size());
+  }
 };
 
 char SPIRVProducerPass::ID;
-SPIRVProducerPass *SPIRVProducerPass::Ptr = nullptr;
+thread_local SPIRVProducerPass *SPIRVProducerPass::Ptr = nullptr;
+
+StringRef SaveOperandString(StringRef Str) {
+  return SPIRVProducerPass::Ptr->saveOperandString(Str);
+}
 
 } // namespace
 
@@ -679,8 +854,11 @@ namespace clspv {
 ModulePass *
 createSPIRVProducerPass(raw_pwrite_stream &out,
                         ArrayRef<std::pair<unsigned, std::string>> samplerMap,
-                        bool outputCInitList) {
-  return new SPIRVProducerPass(out, samplerMap, outputCInitList);
+                        bool outputCInitList,
+                        std::vector<uint32_t> *outputWords,
+                        bool optimizeSize) {
+  return new SPIRVProducerPass(out, samplerMap, outputCInitList, outputWords,
+                               optimizeSize);
 }
 } // namespace clspv
 
@@ -719,6 +897,145 @@ SPIRVOperandVec &operator<<(SPIRVOperandVec &list, const SPIRVID &v) {
   list.emplace_back(NUMBERID, v.get());
   return list;
 }
+
+// Returns true if memory of |storage_class| may be shared with other
+// invocations.
+bool IsSharedStorageClass(spv::StorageClass storage_class) {
+  switch (storage_class) {
+  case spv::StorageClassStorageBuffer:
+  case spv::StorageClassUniform:
+  case spv::StorageClassWorkgroup:
+  case spv::StorageClassPhysicalStorageBuffer:
+  case spv::StorageClassImage:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool IsAtomicOpcode(spv::Op opcode) {
+  return (opcode >= spv::OpAtomicLoad && opcode <= spv::OpAtomicXor) ||
+         opcode == spv::OpAtomicFlagTestAndSet ||
+         opcode == spv::OpAtomicFlagClear || opcode == spv::OpAtomicFAddEXT;
+}
+
+// Returns true if operand |position| of |opcode|, counted after its result
+// type, is a memory semantics.
+bool IsMemorySemanticsOperand(spv::Op opcode, unsigned position) {
+  switch (opcode) {
+  case spv::OpControlBarrier:
+    return position == 2;
+  case spv::OpMemoryBarrier:
+    return position == 1;
+  case spv::OpAtomicCompareExchange:
+  case spv::OpAtomicCompareExchangeWeak:
+    return position == 2 || position == 3;
+  default:
+    return IsAtomicOpcode(opcode) && position == 2;
+  }
+}
+
+// Returns true if operand |position| of |opcode|, counted after its result
+// type, is a memory scope.
+bool IsMemoryScopeOperand(spv::Op opcode, unsigned position) {
+  switch (opcode) {
+  case spv::OpControlBarrier:
+    return position == 1;
+  case spv::OpMemoryBarrier:
+    return position == 0;
+  default:
+    return IsAtomicOpcode(opcode) && position == 1;
+  }
+}
+
+// Returns |semantics| for the Vulkan memory model. A relaxed operation orders
+// no storage class, sequentially consistent ordering is not available and
+// becomes acquire release, and the acquire and release orderings make the
+// memory of their storage classes visible and available respectively.
+uint32_t VulkanMemoryModelSemantics(uint32_t semantics) {
+  const uint32_t kOrderings = spv::MemorySemanticsAcquireMask |
+                              spv::MemorySemanticsReleaseMask |
+                              spv::MemorySemanticsAcquireReleaseMask |
+                              spv::MemorySemanticsSequentiallyConsistentMask;
+  if (!(semantics & kOrderings))
+    return spv::MemorySemanticsMaskNone;
+
+  if (semantics & spv::MemorySemanticsSequentiallyConsistentMask) {
+    semantics &= ~spv::MemorySemanticsSequentiallyConsistentMask;
+    semantics |= spv::MemorySemanticsAcquireReleaseMask;
+  }
+
+  const uint32_t kStorageClasses = spv::MemorySemanticsUniformMemoryMask |
+                                   spv::MemorySemanticsWorkgroupMemoryMask |
+                                   spv::MemorySemanticsImageMemoryMask;
+  if (!(semantics & kStorageClasses))
+    return semantics;
+  if (semantics & (spv::MemorySemanticsAcquireMask |
+                   spv::MemorySemanticsAcquireReleaseMask)) {
+    semantics |= spv::MemorySemanticsMakeVisibleMask;
+  }
+  if (semantics & (spv::MemorySemanticsReleaseMask |
+                   spv::MemorySemanticsAcquireReleaseMask)) {
+    semantics |= spv::MemorySemanticsMakeAvailableMask;
+  }
+  return semantics;
+}
+
+// Returns true if |GV| holds the id of the work-item along each dimension.
+bool IsWorkItemIdVariable(const GlobalVariable *GV) {
+  return GV->getName() == "__spirv_GlobalInvocationId" ||
+         GV->getName() == "__spirv_LocalInvocationId" ||
+         GV->getName() == "__spirv_WorkgroupId";
+}
+
+// Returns how many dimensions of a work-item id are read through |user| of
+// its variable: one more than the highest constant component read, or 3 when
+// a component is not known.
+unsigned DimensionsRead(const User *user) {
+  auto dimensions = [](const Value *index) -> unsigned {
+    if (auto *component = dyn_cast<ConstantInt>(index))
+      return std::min<uint64_t>(component->getZExtValue(), 2) + 1;
+    return 3;
+  };
+
+  if (isa<GEPOperator>(user)) {
+    return user->getNumOperands() == 3 ? dimensions(user->getOperand(2)) : 3;
+  }
+  if (isa<LoadInst>(user)) {
+    unsigned dims = 0;
+    for (auto *load_user : user->users()) {
+      auto *extract = dyn_cast<ExtractElementInst>(load_user);
+      if (!extract)
+        return 3;
+      dims = std::max(dims, dimensions(extract->getIndexOperand()));
+    }
+    return dims;
+  }
+  return 3;
+}
+
+// Fills |local_size| with a local size of |dims| dimensions for a kernel
+// using |workgroup_bytes| of workgroup memory and |private_bytes| of private
+// memory per invocation. The number of invocations is a multiple of 64, hence
+// of the usual subgroup sizes. It is 64 when the invocations use a lot of
+// private memory, which limits occupancy anyway, and 256 when the workgroup
+// memory takes more than half of the 16KB guaranteed by Vulkan, so that the
+// only workgroup fitting in it keeps a compute unit busy. The invocations are
+// spread over the dimensions as evenly as powers of two allow.
+void SuggestLocalSize(unsigned dims, uint64_t workgroup_bytes,
+                      uint64_t private_bytes, uint32_t local_size[3]) {
+  unsigned log2_invocations = 7;
+  if (private_bytes > 256)
+    log2_invocations = 6;
+  else if (workgroup_bytes > 8192)
+    log2_invocations = 8;
+
+  dims = std::max(dims, 1u);
+  for (unsigned i = 0; i < 3; ++i)
+    local_size[i] = 1;
+  for (unsigned i = 0; i < log2_invocations; ++i)
+    local_size[i % dims] *= 2;
+}
 } // namespace
 
 bool SPIRVProducerPass::runOnModule(Module &M) {
@@ -730,7 +1047,7 @@ bool SPIRVProducerPass::runOnModule(Module &M) {
   if (ShowProducerIR) {
     llvm::outs() << *module << "\n";
   }
-  binaryOut = outputCInitList ? &binaryTempOut : &out;
+  binaryWords->clear();
 
   PopulateUBOTypeMaps();
   PopulateStructuredCFGMaps();
@@ -767,6 +1084,7 @@ bool SPIRVProducerPass::runOnModule(Module &M) {
   }
   GenerateResourceVars();
   GenerateWorkgroupVars();
+  GeneratePodSpecConstants();
 
   // Generate SPIRV instructions for each function.
   for (Function &F : *module) {
@@ -774,6 +1092,15 @@ bool SPIRVProducerPass::runOnModule(Module &M) {
       continue;
     }
 
+    // Each function is generated into its own buffer.
+    FunctionBuffers.emplace_back();
+    StreamingFunction =
+        (clspv::Option::StreamFunctions() || clspv::Option::LeanMemory()) &&
+        CanStreamFunction(F);
+    const size_t FirstDeferred = DeferredInstVec.size();
+
+    FindRelaxedPrecisionValues(F);
+
     // Generate Function Prologue.
     GenerateFuncPrologue(F);
 
@@ -782,6 +1109,13 @@ bool SPIRVProducerPass::runOnModule(Module &M) {
 
     // Generate Function Epilogue.
     GenerateFuncEpilogue();
+
+    if (StreamingFunction) {
+      StreamFunction(FirstDeferred);
+      if (clspv::Option::LeanMemory()) {
+        ReleaseFunctionBody(F);
+      }
+    }
   }
 
   HandleDeferredInstruction();
@@ -798,62 +1132,110 @@ bool SPIRVProducerPass::runOnModule(Module &M) {
   // We need to patch the SPIR-V header to set bound correctly.
   patchHeader();
 
-  if (outputCInitList) {
-    bool first = true;
-    std::ostringstream os;
-
-    auto emit_word = [&os, &first](uint32_t word) {
-      if (!first)
-        os << ",\n";
-      os << word;
-      first = false;
-    };
+  // The size optimizer leaves the IDs numbered canonically too. If it fails,
+  // nothing is written so the compilation fails.
+  const bool rewritten =
+      optimizeSize ? clspv::OptimizeSPIRVForSize(binaryWords)
+                   : !clspv::Option::CanonicalIds() ||
+                         clspv::CanonicalizeSPIRVIds(binaryWords);
+  if (!rewritten) {
+    binaryWords->clear();
+    return false;
+  }
 
-    os << "{";
-    const std::string str(binaryTempOut.str());
-    for (unsigned i = 0; i < str.size(); i += 4) {
-      const uint32_t a = static_cast<unsigned char>(str[i]);
-      const uint32_t b = static_cast<unsigned char>(str[i + 1]);
-      const uint32_t c = static_cast<unsigned char>(str[i + 2]);
-      const uint32_t d = static_cast<unsigned char>(str[i + 3]);
-      emit_word(a | (b << 8) | (c << 16) | (d << 24));
-    }
-    os << "}\n";
-    out << os.str();
+  if (outputCInitList) {
+    WriteCInitList();
+  } else if (binaryWords == &binaryTempWords) {
+    out.write(reinterpret_cast<const char *>(binaryWords->data()),
+              binaryWords->size() * sizeof(uint32_t));
   }
 
   return false;
 }
 
 void SPIRVProducerPass::outputHeader() {
-  binaryOut->write(reinterpret_cast<const char *>(&spv::MagicNumber),
-                   sizeof(spv::MagicNumber));
+  WriteOneWord(spv::MagicNumber);
   uint32_t minor = 0;
   if (SpvVersion() == SPIRVVersion::SPIRV_1_3) {
     minor = 3;
   }
   uint32_t version = (1 << 16) | (minor << 8);
-  binaryOut->write(reinterpret_cast<const char *>(&version), sizeof(version));
+  WriteOneWord(version);
 
   // use Google's vendor ID
   const uint32_t vendor = 21 << 16;
-  binaryOut->write(reinterpret_cast<const char *>(&vendor), sizeof(vendor));
+  WriteOneWord(vendor);
 
   // we record where we need to come back to and patch in the bound value
-  patchBoundOffset = binaryOut->tell();
+  patchBoundIndex = binaryWords->size();
 
   // output a bad bound for now
-  binaryOut->write(reinterpret_cast<const char *>(&nextID), sizeof(nextID));
+  WriteOneWord(nextID);
 
   // output the schema (reserved for use and must be 0)
   const uint32_t schema = 0;
-  binaryOut->write(reinterpret_cast<const char *>(&schema), sizeof(schema));
+  WriteOneWord(schema);
+}
+
+void SPIRVProducerPass::WriteCInitList() {
+  // Pairs of decimal digits for 00 to 99.
+  static const char kDigitPairs[] =
+      "0001020304050607080910111213141516171819"
+      "2021222324252627282930313233343536373839"
+      "4041424344454647484950515253545556575859"
+      "6061626364656667686970717273747576777879"
+      "8081828384858687888990919293949596979899";
+
+  // The text is formatted into a fixed buffer and written out in chunks.  Each
+  // word takes at most 10 digits plus a separator.
+  const size_t kMaxWordSize = 12;
+  char Buffer[1 << 16];
+  size_t Size = 0;
+  auto Flush = [&]() {
+    out.write(Buffer, Size);
+    Size = 0;
+  };
+
+  Buffer[Size++] = '{';
+  bool First = true;
+  for (uint32_t Word : *binaryWords) {
+    if (Size + kMaxWordSize > sizeof(Buffer))
+      Flush();
+    if (!First) {
+      Buffer[Size++] = ',';
+      Buffer[Size++] = '\n';
+    }
+    First = false;
+
+    // Format the digits backwards, two at a time.
+    char Digits[10];
+    char *End = Digits + sizeof(Digits);
+    char *Begin = End;
+    while (Word >= 100) {
+      const uint32_t Pair = (Word % 100) * 2;
+      Word /= 100;
+      *--Begin = kDigitPairs[Pair + 1];
+      *--Begin = kDigitPairs[Pair];
+    }
+    if (Word >= 10) {
+      *--Begin = kDigitPairs[Word * 2 + 1];
+      *--Begin = kDigitPairs[Word * 2];
+    } else {
+      *--Begin = char('0' + Word);
+    }
+    std::memcpy(Buffer + Size, Begin, End - Begin);
+    Size += End - Begin;
+  }
+  if (Size + 2 > sizeof(Buffer))
+    Flush();
+  Buffer[Size++] = '}';
+  Buffer[Size++] = '\n';
+  Flush();
 }
 
 void SPIRVProducerPass::patchHeader() {
   // for a binary we just write the value of nextID over bound
-  binaryOut->pwrite(reinterpret_cast<char *>(&nextID), sizeof(nextID),
-                    patchBoundOffset);
+  (*binaryWords)[patchBoundIndex] = nextID;
 }
 
 void SPIRVProducerPass::GenerateLLVMIRInfo() {
@@ -901,10 +1283,15 @@ void SPIRVProducerPass::FindGlobalConstVars() {
   DeadGVList.clear();
 
   if (clspv::Option::ModuleConstantsInStorageBuffer()) {
-    // For now, we only support a single storage buffer.
-    if (!GVList.empty()) {
-      assert(GVList.size() == 1);
-      const auto *GV = GVList[0];
+    // For now, we only support a single storage buffer. The constants left
+    // out of it by ClusterModuleScopeConstantVars are emitted inline below.
+    auto clustered = std::find_if(GVList.begin(), GVList.end(),
+                                  [](const GlobalVariable *GV) {
+                                    return GV->getName() ==
+                                           clspv::ClusteredConstantsName();
+                                  });
+    if (clustered != GVList.end()) {
+      const auto *GV = *clustered;
       const auto constants_byte_size =
           (GetTypeSizeInBits(GV->getInitializer()->getType(), DL)) / 8;
       const size_t kConstantMaxSize = 65536;
@@ -913,71 +1300,72 @@ void SPIRVProducerPass::FindGlobalConstVars() {
                << " bytes exceeded: " << constants_byte_size << " bytes used\n";
         llvm_unreachable("Max __constant capacity exceeded");
       }
+      GVList.erase(clustered);
     }
-  } else {
-    // Change global constant variable's address space to ModuleScopePrivate.
-    auto &GlobalConstFuncTyMap = getGlobalConstFuncTypeMap();
-    for (auto GV : GVList) {
-      // Create new gv with ModuleScopePrivate address space.
-      Type *NewGVTy = GV->getType()->getPointerElementType();
-      GlobalVariable *NewGV = new GlobalVariable(
-          *module, NewGVTy, false, GV->getLinkage(), GV->getInitializer(), "",
-          nullptr, GV->getThreadLocalMode(), AddressSpace::ModuleScopePrivate);
-      NewGV->takeName(GV);
-
-      const SmallVector<User *, 8> GVUsers(GV->user_begin(), GV->user_end());
-      SmallVector<User *, 8> CandidateUsers;
-
-      auto record_called_function_type_as_user =
-          [&GlobalConstFuncTyMap](Value *gv, CallInst *call) {
-            // Find argument index.
-            unsigned index = 0;
-            for (unsigned i = 0; i < call->getNumArgOperands(); i++) {
-              if (gv == call->getOperand(i)) {
-                // TODO(dneto): Should we break here?
-                index = i;
-              }
-            }
+  }
 
-            // Record function type with global constant.
-            GlobalConstFuncTyMap[call->getFunctionType()] =
-                std::make_pair(call->getFunctionType(), index);
-          };
-
-      for (User *GVU : GVUsers) {
-        if (CallInst *Call = dyn_cast<CallInst>(GVU)) {
-          record_called_function_type_as_user(GV, Call);
-        } else if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(GVU)) {
-          // Check GEP users.
-          for (User *GEPU : GEP->users()) {
-            if (CallInst *GEPCall = dyn_cast<CallInst>(GEPU)) {
-              record_called_function_type_as_user(GEP, GEPCall);
+  // Change global constant variable's address space to ModuleScopePrivate.
+  auto &GlobalConstFuncTyMap = getGlobalConstFuncTypeMap();
+  for (auto GV : GVList) {
+    // Create new gv with ModuleScopePrivate address space.
+    Type *NewGVTy = GV->getType()->getPointerElementType();
+    GlobalVariable *NewGV = new GlobalVariable(
+        *module, NewGVTy, false, GV->getLinkage(), GV->getInitializer(), "",
+        nullptr, GV->getThreadLocalMode(), AddressSpace::ModuleScopePrivate);
+    NewGV->takeName(GV);
+
+    const SmallVector<User *, 8> GVUsers(GV->user_begin(), GV->user_end());
+    SmallVector<User *, 8> CandidateUsers;
+
+    auto record_called_function_type_as_user =
+        [&GlobalConstFuncTyMap](Value *gv, CallInst *call) {
+          // Find argument index.
+          unsigned index = 0;
+          for (unsigned i = 0; i < call->getNumArgOperands(); i++) {
+            if (gv == call->getOperand(i)) {
+              // TODO(dneto): Should we break here?
+              index = i;
             }
           }
-        }
 
-        CandidateUsers.push_back(GVU);
-      }
+          // Record function type with global constant.
+          GlobalConstFuncTyMap[call->getFunctionType()] =
+              std::make_pair(call->getFunctionType(), index);
+        };
 
-      for (User *U : CandidateUsers) {
-        // Update users of gv with new gv.
-        if (!isa<Constant>(U)) {
-          // #254: Can't change operands of a constant, but this shouldn't be
-          // something that sticks around in the module.
-          U->replaceUsesOfWith(GV, NewGV);
+    for (User *GVU : GVUsers) {
+      if (CallInst *Call = dyn_cast<CallInst>(GVU)) {
+        record_called_function_type_as_user(GV, Call);
+      } else if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(GVU)) {
+        // Check GEP users.
+        for (User *GEPU : GEP->users()) {
+          if (CallInst *GEPCall = dyn_cast<CallInst>(GEPU)) {
+            record_called_function_type_as_user(GEP, GEPCall);
+          }
         }
       }
 
-      // Delete original gv.
-      GV->eraseFromParent();
+      CandidateUsers.push_back(GVU);
+    }
+
+    for (User *U : CandidateUsers) {
+      // Update users of gv with new gv.
+      if (!isa<Constant>(U)) {
+        // #254: Can't change operands of a constant, but this shouldn't be
+        // something that sticks around in the module.
+        U->replaceUsesOfWith(GV, NewGV);
+      }
     }
+
+    // Delete original gv.
+    GV->eraseFromParent();
   }
 }
 
 void SPIRVProducerPass::FindResourceVars() {
   ResourceVarInfoList.clear();
   FunctionToResourceVarsMap.clear();
-  ModuleOrderedResourceVars.reset();
+  ModuleOrderedResourceVars.clear();
   // Normally, there is one resource variable per clspv.resource.var.*
   // function, since that is unique'd by arg type and index.  By design,
   // we can share these resource variables across kernels because all
@@ -1259,8 +1647,8 @@ void SPIRVProducerPass::FindTypesForSamplerMap() {
 
 void SPIRVProducerPass::FindTypesForResourceVars() {
   // Record types so they are generated.
-  TypesNeedingLayout.reset();
-  StructTypesNeedingBlock.reset();
+  TypesNeedingLayout.clear();
+  StructTypesNeedingBlock.clear();
 
   // To match older clspv codegen, generate the float type first if required
   // for images.
@@ -1345,10 +1733,38 @@ void SPIRVProducerPass::FindTypesForResourceVars() {
     }
   }
 
+  // The -profile-counters buffer is a storage buffer of its own.
+  if (auto *GV = module->getGlobalVariable(clspv::ProfileCountersName())) {
+    StructTypesNeedingBlock.insert(
+        cast<StructType>(GV->getType()->getPointerElementType()));
+  }
+
   // Traverse the arrays and structures underneath each Block, and
   // mark them as needing layout.
   std::vector<Type *> work_list(StructTypesNeedingBlock.begin(),
                                 StructTypesNeedingBlock.end());
+
+  // Memory accessed through physical pointers is laid out explicitly too.
+  if (clspv::Option::PhysicalStorageBuffers()) {
+    auto add_pointee = [this, &work_list](Type *type) {
+      if (auto *ptr_ty = dyn_cast<PointerType>(type)) {
+        if (GetStorageClass(ptr_ty->getAddressSpace()) ==
+            spv::StorageClassPhysicalStorageBuffer)
+          work_list.push_back(ptr_ty->getElementType());
+      }
+    };
+    for (Function &F : *module) {
+      for (Argument &Arg : F.args()) {
+        add_pointee(Arg.getType());
+      }
+      for (BasicBlock &BB : F) {
+        for (Instruction &I : BB) {
+          add_pointee(I.getType());
+        }
+      }
+    }
+  }
+
   while (!work_list.empty()) {
     Type *type = work_list.back();
     work_list.pop_back();
@@ -1433,10 +1849,38 @@ void SPIRVProducerPass::GenerateWorkgroupVars() {
   }
 }
 
+void SPIRVProducerPass::GeneratePodSpecConstants() {
+  for (Function &F : *module) {
+    if (Builtins::Lookup(&F) != Builtins::kClspvPodSpecConstant)
+      continue;
+    for (User *U : F.users()) {
+      auto *Call = cast<CallInst>(U);
+      const auto spec_id = static_cast<uint32_t>(
+          cast<ConstantInt>(Call->getArgOperand(0))->getZExtValue());
+      if (PodSpecConstantIDs.count(spec_id))
+        continue;
+
+      // The default value is zero. 64-bit types take two literal words.
+      Type *Ty = Call->getType();
+      SPIRVOperandVec Ops;
+      Ops << Ty << 0;
+      if (Ty->getPrimitiveSizeInBits() == 64)
+        Ops << 0;
+      SPIRVID ID = addSPIRVInst<kConstants>(spv::OpSpecConstant, Ops);
+
+      Ops.clear();
+      Ops << ID << spv::DecorationSpecId << spec_id;
+      addSPIRVInst<kAnnotations>(spv::OpDecorate, Ops);
+
+      PodSpecConstantIDs[spec_id] = ID;
+    }
+  }
+}
+
 void SPIRVProducerPass::FindType(Type *Ty) {
   TypeList &TyList = getTypeList();
 
-  if (0 != TyList.idFor(Ty)) {
+  if (TyList.count(Ty)) {
     return;
   }
 
@@ -1482,8 +1926,12 @@ spv::StorageClass SPIRVProducerPass::GetStorageClass(unsigned AddrSpace) const {
   case AddressSpace::Private:
     return spv::StorageClassFunction;
   case AddressSpace::Global:
-    return spv::StorageClassStorageBuffer;
+    return clspv::Option::PhysicalStorageBuffers()
+               ? spv::StorageClassPhysicalStorageBuffer
+               : spv::StorageClassStorageBuffer;
   case AddressSpace::Constant:
+    if (clspv::Option::PhysicalStorageBuffers())
+      return spv::StorageClassPhysicalStorageBuffer;
     return clspv::Option::ConstantArgsInUniformBuffer()
                ? spv::StorageClassUniform
                : spv::StorageClassStorageBuffer;
@@ -1649,7 +2097,11 @@ SPIRVID SPIRVProducerPass::getSPIRVType(Type *Ty) {
     auto CanonicalTI = TypeMap.find(Canonical);
     if (CanonicalTI != TypeMap.end()) {
       assert(CanonicalTI->second.isValid());
-      return CanonicalTI->second;
+      // Cache the non-canonical type too, so its canonical type is not
+      // recomputed on every lookup.
+      auto RID = CanonicalTI->second;
+      TypeMap[Ty] = RID;
+      return RID;
     }
   }
 
@@ -1839,8 +2291,8 @@ SPIRVID SPIRVProducerPass::getSPIRVType(Type *Ty) {
     // Generate OpMemberDecorate unless we are generating it for the canonical
     // type.
     StructType *canonical = cast<StructType>(CanonicalType(STy));
-    if (TypesNeedingLayout.idFor(STy) &&
-        (canonical == STy || !TypesNeedingLayout.idFor(canonical))) {
+    if (TypesNeedingLayout.count(STy) &&
+        (canonical == STy || !TypesNeedingLayout.count(canonical))) {
       for (unsigned MemberIdx = 0; MemberIdx < STy->getNumElements();
            MemberIdx++) {
         // Ops[0] = Structure Type ID
@@ -1858,8 +2310,8 @@ SPIRVID SPIRVProducerPass::getSPIRVType(Type *Ty) {
     }
 
     // Generate OpDecorate unless we are generating it for the canonical type.
-    if (StructTypesNeedingBlock.idFor(STy) &&
-        (canonical == STy || !StructTypesNeedingBlock.idFor(canonical))) {
+    if (StructTypesNeedingBlock.count(STy) &&
+        (canonical == STy || !StructTypesNeedingBlock.count(canonical))) {
       Ops.clear();
       // Use Block decorations with StorageBuffer storage class.
       Ops << RID << spv::DecorationBlock;
@@ -2194,7 +2646,24 @@ SPIRVID SPIRVProducerPass::getSPIRVConstant(Constant *Cst) {
   }
 
   if (RID == 0) {
-    RID = addSPIRVInst<kConstants>(Opcode, Ops);
+    // Distinct LLVM constants can have the same SPIR-V type and contents,
+    // e.g. when their types map to the same SPIR-V type.  Emit each of those
+    // once.
+    ConstantKey Key;
+    Key.push_back(Opcode);
+    for (const auto &Op : Ops) {
+      Key.push_back(Op.getLiteralNum()[0]);
+      if (Op.getType() == LITERAL_DWORD) {
+        Key.push_back(Op.getLiteralNum()[1]);
+      }
+    }
+    auto iter = ConstantKeyMap.find(Key);
+    if (iter != ConstantKeyMap.end()) {
+      RID = iter->second;
+    } else {
+      RID = addSPIRVInst<kConstants>(Opcode, Ops);
+      ConstantKeyMap.emplace(std::move(Key), RID);
+    }
   }
 
   VMap[Cst] = RID;
@@ -2308,6 +2777,22 @@ void SPIRVProducerPass::GenerateSamplers() {
           << getSPIRVInt32Constant(binding)
           << getSPIRVInt32Constant(sampler_value);
       addSPIRVInst<kReflection>(spv::OpExtInst, Ops);
+
+      if (clspv::Option::ImmutableLiteralSamplers()) {
+        // Literal samplers have a descriptor set of their own, so its layout
+        // can be created with all of them as immutable samplers.
+        const auto state = clspv::GetVulkanSamplerState(sampler_value);
+        Ops.clear();
+        Ops << getSPIRVType(Type::getVoidTy(module->getContext()))
+            << getImmutableSamplersImport() << clspv::kImmutableSampler
+            << getSPIRVInt32Constant(descriptor_set)
+            << getSPIRVInt32Constant(binding)
+            << getSPIRVInt32Constant(state.filter)
+            << getSPIRVInt32Constant(state.address_mode)
+            << getSPIRVInt32Constant(state.unnormalized_coordinates)
+            << getSPIRVInt32Constant(state.border_color);
+        addSPIRVInst<kReflection>(spv::OpExtInst, Ops);
+      }
     }
 
     // Ops[0] = Target ID
@@ -2397,8 +2882,10 @@ void SPIRVProducerPass::GenerateResourceVars() {
     Ops << info->var_id << spv::DecorationBinding << info->binding;
     addSPIRVInst<kAnnotations>(spv::OpDecorate, Ops);
 
-    if (info->coherent) {
-      // Decorate with Coherent if required for the variable.
+    if (info->coherent && !clspv::Option::VulkanMemoryModel()) {
+      // Decorate with Coherent if required for the variable. The Vulkan
+      // memory model does not allow the decoration, as the availability and
+      // visibility operations of barriers and atomics cover it.
       Ops.clear();
       Ops << info->var_id << spv::DecorationCoherent;
       addSPIRVInst<kAnnotations>(spv::OpDecorate, Ops);
@@ -2407,14 +2894,37 @@ void SPIRVProducerPass::GenerateResourceVars() {
     // Generate NonWritable and NonReadable
     switch (info->arg_kind) {
     case clspv::ArgKind::Buffer:
-    case clspv::ArgKind::BufferUBO:
-      if (info->var_fn->getReturnType()->getPointerAddressSpace() ==
-          clspv::AddressSpace::Constant) {
+    case clspv::ArgKind::BufferUBO: {
+      // __constant buffers are never written. The access of __global buffers
+      // is derived from their uses so the runtime can skip barriers between
+      // dispatches that only read them.
+      const uint32_t access =
+          info->var_fn->getReturnType()->getPointerAddressSpace() ==
+                  clspv::AddressSpace::Constant
+              ? clspv::kArgAccessRead
+              : GetResourceVarAccess(info);
+      if (!(access & clspv::kArgAccessWrite)) {
         Ops.clear();
         Ops << info->var_id << spv::DecorationNonWritable;
         addSPIRVInst<kAnnotations>(spv::OpDecorate, Ops);
       }
+      if (!(access & clspv::kArgAccessRead)) {
+        Ops.clear();
+        Ops << info->var_id << spv::DecorationNonReadable;
+        addSPIRVInst<kAnnotations>(spv::OpDecorate, Ops);
+      }
+      // Arguments that are not restrict may be bound to the same buffer.
+      if (clspv::Option::BufferAliasDecorations() &&
+          info->arg_kind == clspv::ArgKind::Buffer) {
+        Ops.clear();
+        Ops << info->var_id
+            << (info->var_fn->getMetadata(clspv::RestrictMetadataName())
+                    ? spv::DecorationRestrict
+                    : spv::DecorationAliased);
+        addSPIRVInst<kAnnotations>(spv::OpDecorate, Ops);
+      }
       break;
+    }
     case clspv::ArgKind::StorageImage: {
       auto *type = info->var_fn->getReturnType();
       auto *struct_ty = cast<StructType>(type->getPointerElementType());
@@ -2433,6 +2943,93 @@ void SPIRVProducerPass::GenerateResourceVars() {
   }
 }
 
+uint32_t SPIRVProducerPass::GetResourceVarAccess(const ResourceVarInfo *info) {
+  const uint32_t kReadWrite = clspv::kArgAccessRead | clspv::kArgAccessWrite;
+  uint32_t access = 0;
+
+  // Follow every pointer derived from the calls that map to the variable, into
+  // the functions they are passed to.
+  DenseSet<Value *> visited;
+  std::vector<Value *> stack;
+  for (auto *user : info->var_fn->users()) {
+    auto *call = dyn_cast<CallInst>(user);
+    if (!call)
+      continue;
+    const auto set =
+        unsigned(cast<ConstantInt>(call->getOperand(0))->getZExtValue());
+    const auto binding =
+        unsigned(cast<ConstantInt>(call->getOperand(1))->getZExtValue());
+    if (set == info->descriptor_set && binding == info->binding)
+      stack.push_back(call);
+  }
+
+  while (!stack.empty() && access != (kReadWrite | clspv::kArgAccessAtomic)) {
+    Value *ptr = stack.back();
+    stack.pop_back();
+    if (!visited.insert(ptr).second)
+      continue;
+
+    for (auto &use : ptr->uses()) {
+      auto *user = use.getUser();
+      if (isa<LoadInst>(user)) {
+        access |= clspv::kArgAccessRead;
+      } else if (auto *store = dyn_cast<StoreInst>(user)) {
+        // Storing the pointer itself lets it be accessed anywhere.
+        access |= store->getPointerOperand() == ptr ? clspv::kArgAccessWrite
+                                                    : kReadWrite;
+      } else if (isa<AtomicRMWInst>(user) || isa<AtomicCmpXchgInst>(user)) {
+        access |= kReadWrite | clspv::kArgAccessAtomic;
+      } else if (auto *call = dyn_cast<CallInst>(user)) {
+        auto *callee = call->getCalledFunction();
+        if (callee && !callee->isDeclaration()) {
+          stack.push_back(callee->getArg(use.getOperandNo()));
+          continue;
+        }
+        const auto &func_info = Builtins::Lookup(callee);
+        switch (func_info.getType()) {
+        case Builtins::kSpirvAtomicXor:
+          access |= kReadWrite | clspv::kArgAccessAtomic;
+          break;
+        case Builtins::kSpirvCopyMemory:
+          // The destination is the first operand.
+          access |= use.getOperandNo() == 0 ? clspv::kArgAccessWrite
+                                            : clspv::kArgAccessRead;
+          break;
+        case Builtins::kSpirvOp: {
+          const auto opcode = static_cast<spv::Op>(
+              cast<ConstantInt>(call->getArgOperand(0))->getZExtValue());
+          if (opcode == spv::OpAtomicLoad) {
+            access |= clspv::kArgAccessRead | clspv::kArgAccessAtomic;
+          } else if (opcode == spv::OpAtomicStore) {
+            access |= clspv::kArgAccessWrite | clspv::kArgAccessAtomic;
+          } else if ((opcode >= spv::OpAtomicLoad &&
+                      opcode <= spv::OpAtomicXor) ||
+                     opcode == spv::OpAtomicFAddEXT) {
+            access |= kReadWrite | clspv::kArgAccessAtomic;
+          } else {
+            access |= kReadWrite;
+          }
+          break;
+        }
+        default:
+          // Anything else may access the memory through the pointer.
+          access |= kReadWrite;
+          break;
+        }
+      } else if (user->getType()->isPointerTy()) {
+        // GEPs, casts, selects and phis derive new pointers.
+        stack.push_back(user);
+      } else {
+        // Anything else, such as returning the pointer, comparing it or
+        // converting it to an integer, means it can no longer be followed.
+        access |= kReadWrite;
+      }
+    }
+  }
+
+  return access;
+}
+
 void SPIRVProducerPass::GenerateGlobalVar(GlobalVariable &GV) {
   ValueMapType &VMap = getValueMap();
   std::vector<SPIRVID> &BuiltinDimVec = getBuiltinDimVec();
@@ -2714,6 +3311,39 @@ void SPIRVProducerPass::GenerateGlobalVar(GlobalVariable &GV) {
     addSPIRVInst<kAnnotations>(spv::OpDecorate, Ops);
 
     // OpDecorate %var Binding <binding>
+    Ops.clear();
+    Ops << var_id << spv::DecorationBinding << 0;
+    addSPIRVInst<kAnnotations>(spv::OpDecorate, Ops);
+  } else if (GV.getName() == clspv::ProfileCountersName()) {
+    // The counters are at binding 0 of the next descriptor set, which the
+    // reflection reports along with what each counter counts.
+    const uint32_t descriptor_set = TakeDescriptorIndex(module);
+    const auto *locations =
+        module->getNamedMetadata(clspv::ProfileCountersMetadataName());
+    auto void_id = getSPIRVType(Type::getVoidTy(module->getContext()));
+
+    SPIRVOperandVec Ops;
+    Ops << void_id << getProfileCountersImport()
+        << clspv::kProfileCountersBuffer
+        << getSPIRVInt32Constant(descriptor_set) << getSPIRVInt32Constant(0)
+        << getSPIRVInt32Constant(locations->getNumOperands());
+    addSPIRVInst<kReflection>(spv::OpExtInst, Ops);
+
+    for (unsigned i = 0; i < locations->getNumOperands(); ++i) {
+      auto location =
+          cast<MDString>(locations->getOperand(i)->getOperand(0))->getString();
+      auto location_id =
+          addSPIRVInst<kDebug>(spv::OpString, location.str().c_str());
+      Ops.clear();
+      Ops << void_id << getProfileCountersImport() << clspv::kProfileCounter
+          << getSPIRVInt32Constant(i) << location_id;
+      addSPIRVInst<kReflection>(spv::OpExtInst, Ops);
+    }
+
+    Ops.clear();
+    Ops << var_id << spv::DecorationDescriptorSet << descriptor_set;
+    addSPIRVInst<kAnnotations>(spv::OpDecorate, Ops);
+
     Ops.clear();
     Ops << var_id << spv::DecorationBinding << 0;
     addSPIRVInst<kAnnotations>(spv::OpDecorate, Ops);
@@ -2818,7 +3448,8 @@ void SPIRVProducerPass::GenerateFuncPrologue(Function &F) {
       SPIRVID param_id = addSPIRVInst(spv::OpFunctionParameter, Ops);
       VMap[&Arg] = param_id;
 
-      if (CalledWithCoherentResource(Arg)) {
+      if (!clspv::Option::VulkanMemoryModel() &&
+          CalledWithCoherentResource(Arg)) {
         // If the arg is passed a coherent resource ever, then decorate this
         // parameter with Coherent too.
         Ops.clear();
@@ -2826,6 +3457,19 @@ void SPIRVProducerPass::GenerateFuncPrologue(Function &F) {
         addSPIRVInst<kAnnotations>(spv::OpDecorate, Ops);
       }
 
+      if (Arg.getType()->isPointerTy() &&
+          GetStorageClass(Arg.getType()->getPointerAddressSpace()) ==
+              spv::StorageClassPhysicalStorageBuffer) {
+        // Physical pointer parameters must declare whether they alias.
+        Ops.clear();
+        Ops << param_id << spv::DecorationAliased;
+        addSPIRVInst<kAnnotations>(spv::OpDecorate, Ops);
+      }
+
+      if (clspv::Option::UniformityDecorations()) {
+        GenerateUniformityDecorations(&Arg, param_id);
+      }
+
       ArgIdx++;
     }
   }
@@ -2838,7 +3482,18 @@ void SPIRVProducerPass::GenerateModuleInfo() {
 
   SPIRVOperandVec Ops;
 
-  for (auto Capability : CapabilitySet) {
+  if (clspv::Option::PhysicalStorageBuffers()) {
+    addCapability(spv::CapabilityPhysicalStorageBufferAddresses);
+  }
+  if (clspv::Option::VulkanMemoryModel()) {
+    addCapability(spv::CapabilityVulkanMemoryModel);
+  }
+
+  // Capabilities are recorded as they are found, and listed in order.
+  SmallVector<uint32_t, 16> Capabilities(CapabilitySet.begin(),
+                                         CapabilitySet.end());
+  llvm::sort(Capabilities);
+  for (auto Capability : Capabilities) {
     //
     // Generate OpCapability
     //
@@ -2866,15 +3521,50 @@ void SPIRVProducerPass::GenerateModuleInfo() {
     addSPIRVInst<kExtensions>(spv::OpExtension, "SPV_KHR_variable_pointers");
   }
 
+  if (clspv::Option::PhysicalStorageBuffers()) {
+    //
+    // Generate OpExtension.
+    //
+    // Ops[0] = Name (Literal String)
+    //
+    addSPIRVInst<kExtensions>(spv::OpExtension,
+                              "SPV_KHR_physical_storage_buffer");
+  }
+
+  if (clspv::Option::VulkanMemoryModel() &&
+      clspv::Option::SpvVersion() < clspv::Option::SPIRVVersion::SPIRV_1_5) {
+    addSPIRVInst<kExtensions>(spv::OpExtension,
+                              "SPV_KHR_vulkan_memory_model");
+  }
+
+  if (CapabilitySet.count(spv::CapabilityShaderNonUniformEXT)) {
+    addSPIRVInst<kExtensions>(spv::OpExtension, "SPV_EXT_descriptor_indexing");
+  }
+
+  if (CapabilitySet.count(spv::CapabilityAtomicFloat32AddEXT) ||
+      CapabilitySet.count(spv::CapabilityAtomicFloat64AddEXT)) {
+    addSPIRVInst<kExtensions>(spv::OpExtension,
+                              "SPV_EXT_shader_atomic_float_add");
+  }
+
   //
   // Generate OpMemoryModel
   //
-  // Memory model for Vulkan will always be GLSL450.
+  // Memory model for Vulkan is GLSL450 unless -vulkan-memory-model is given.
 
   // Ops[0] = Addressing Model
   // Ops[1] = Memory Model
   Ops.clear();
-  Ops << spv::AddressingModelLogical << spv::MemoryModelGLSL450;
+  if (clspv::Option::PhysicalStorageBuffers()) {
+    Ops << spv::AddressingModelPhysicalStorageBuffer64;
+  } else {
+    Ops << spv::AddressingModelLogical;
+  }
+  if (clspv::Option::VulkanMemoryModel()) {
+    Ops << spv::MemoryModelVulkan;
+  } else {
+    Ops << spv::MemoryModelGLSL450;
+  }
 
   addSPIRVInst<kMemoryModel>(spv::OpMemoryModel, Ops);
 
@@ -3052,7 +3742,7 @@ void SPIRVProducerPass::GenerateFuncBody(Function &F) {
 }
 
 spv::Op SPIRVProducerPass::GetSPIRVCmpOpcode(CmpInst *I) {
-  const std::map<CmpInst::Predicate, spv::Op> Map = {
+  static const std::map<CmpInst::Predicate, spv::Op> Map = {
       {CmpInst::ICMP_EQ, spv::OpIEqual},
       {CmpInst::ICMP_NE, spv::OpINotEqual},
       {CmpInst::ICMP_UGT, spv::OpUGreaterThan},
@@ -3082,7 +3772,7 @@ spv::Op SPIRVProducerPass::GetSPIRVCmpOpcode(CmpInst *I) {
 }
 
 spv::Op SPIRVProducerPass::GetSPIRVCastOpcode(Instruction &I) {
-  const std::map<unsigned, spv::Op> Map{
+  static const std::map<unsigned, spv::Op> Map{
       {Instruction::Trunc, spv::OpUConvert},
       {Instruction::ZExt, spv::OpUConvert},
       {Instruction::SExt, spv::OpSConvert},
@@ -3113,7 +3803,7 @@ spv::Op SPIRVProducerPass::GetSPIRVBinaryOpcode(Instruction &I) {
     }
   }
 
-  const std::map<unsigned, spv::Op> Map{
+  static const std::map<unsigned, spv::Op> Map{
       {Instruction::Add, spv::OpIAdd},
       {Instruction::FAdd, spv::OpFAdd},
       {Instruction::Sub, spv::OpISub},
@@ -3205,6 +3895,22 @@ SPIRVProducerPass::GenerateClspvInstruction(CallInst *Call,
     RID = info.variable_id;
     break;
   }
+  case Builtins::kClspvPodSpecConstant: {
+    // Map this call directly to the specialization constant.
+    const auto spec_id = static_cast<uint32_t>(
+        cast<ConstantInt>(Call->getArgOperand(0))->getZExtValue());
+    RID = PodSpecConstantIDs[spec_id];
+    break;
+  }
+  case Builtins::kClspvPhysicalPointer: {
+    // Device addresses of __global and __constant arguments become
+    // PhysicalStorageBuffer pointers.
+    SPIRVOperandVec Ops;
+    Ops << Call->getType() << Call->getArgOperand(0);
+
+    RID = addSPIRVInst(spv::OpConvertUToPtr, Ops);
+    break;
+  }
   case Builtins::kClspvSamplerVarLiteral: {
     // Sampler initializers become a load of the corresponding sampler.
     // Map this to a load from the variable.
@@ -3233,7 +3939,7 @@ SPIRVProducerPass::GenerateClspvInstruction(CallInst *Call,
     }
 
     for (unsigned i = 0; i < Call->getNumArgOperands(); i++) {
-      Ops << Call->getArgOperand(i);
+      addMemoryModelOperand(spv::OpAtomicXor, i, Call->getArgOperand(i), Ops);
     }
 
     RID = addSPIRVInst(spv::OpAtomicXor, Ops);
@@ -3251,9 +3957,16 @@ SPIRVProducerPass::GenerateClspvInstruction(CallInst *Call,
       }
 
       for (unsigned i = 1; i < Call->getNumArgOperands(); i++) {
-        Ops << Call->getArgOperand(i);
+        addMemoryModelOperand(opcode, i - 1, Call->getArgOperand(i), Ops);
       }
 
+      // An atomic store has no result, so use the type of the value.
+      auto *value_ty = Call->getType()->isVoidTy()
+                           ? Call->getArgOperand(Call->getNumArgOperands() - 1)
+                                 ->getType()
+                           : Call->getType();
+      addAtomicCapabilities(opcode, value_ty);
+
       RID = addSPIRVInst(opcode, Ops);
     }
     break;
@@ -3275,6 +3988,17 @@ SPIRVProducerPass::GenerateClspvInstruction(CallInst *Call,
                                              : spv::MemoryAccessMaskNone;
 
     auto MemoryAccess = VolatileMemoryAccess | spv::MemoryAccessAlignedMask;
+    if (clspv::Option::VulkanMemoryModel()) {
+      // The memory access applies to both the target and the source.
+      auto *DstTy = Call->getArgOperand(0)->getType();
+      auto *SrcTy = Call->getArgOperand(1)->getType();
+      if (IsSharedStorageClass(
+              GetStorageClass(DstTy->getPointerAddressSpace())) ||
+          IsSharedStorageClass(
+              GetStorageClass(SrcTy->getPointerAddressSpace()))) {
+        MemoryAccess |= spv::MemoryAccessNonPrivatePointerMask;
+      }
+    }
 
     auto Alignment =
         dyn_cast<ConstantInt>(Call->getArgOperand(2))->getZExtValue();
@@ -3322,13 +4046,23 @@ SPIRVProducerPass::GenerateImageInstruction(CallInst *Call,
       Value *Sampler = Call->getArgOperand(1);
       Value *Coordinate = Call->getArgOperand(2);
 
-      TypeMapType &OpImageTypeMap = getImageTypeMap();
-      Type *ImageTy = Image->getType()->getPointerElementType();
-      SPIRVID ImageTyID = OpImageTypeMap[ImageTy];
+      // The result of OpSampledImage must be used in the block defining it,
+      // so only reads in the same block share it.
+      if (SampledImageBlock != Call->getParent()) {
+        SampledImageBlock = Call->getParent();
+        SampledImages.clear();
+      }
+
+      SPIRVID &SampledImageID = SampledImages[{Image, Sampler}];
+      if (!SampledImageID.isValid()) {
+        TypeMapType &OpImageTypeMap = getImageTypeMap();
+        Type *ImageTy = Image->getType()->getPointerElementType();
+        SPIRVID ImageTyID = OpImageTypeMap[ImageTy];
 
-      Ops << ImageTyID << Image << Sampler;
+        Ops << ImageTyID << Image << Sampler;
 
-      SPIRVID SampledImageID = addSPIRVInst(spv::OpSampledImage, Ops);
+        SampledImageID = addSPIRVInst(spv::OpSampledImage, Ops);
+      }
 
       //
       // Generate OpImageSampleExplicitLod.
@@ -3573,9 +4307,10 @@ SPIRVProducerPass::GenerateSubgroupInstruction(CallInst *Call,
   SPIRVID RID;
 
   // requires SPIRV version 1.3 or greater
-  if (SpvVersion() != SPIRVVersion::SPIRV_1_3) {
-    // llvm_unreachable("SubGroups extension requires SPIRV 1.3 or greater");
-    // TODO(sjw): error out gracefully
+  if (SpvVersion() < SPIRVVersion::SPIRV_1_3) {
+    errs() << "error: " << Call->getCalledFunction()->getName()
+           << " requires -spv-version=1.3 or greater\n";
+    llvm_unreachable("SubGroups extension requires SPIRV 1.3 or greater");
   }
 
   auto loadBuiltin = [this, Call](spv::BuiltIn spvBI,
@@ -3590,32 +4325,73 @@ SPIRVProducerPass::GenerateSubgroupInstruction(CallInst *Call,
   spv::Op op = spv::OpNop;
   switch (FuncInfo.getType()) {
   case Builtins::kGetSubGroupSize:
+  case Builtins::kGetMaxSubGroupSize:
+    // Vulkan only exposes the size of full subgroups.
     return loadBuiltin(spv::BuiltInSubgroupSize);
   case Builtins::kGetNumSubGroups:
+  case Builtins::kGetEnqueuedNumSubGroups:
+    // Work-groups are always uniform, so the enqueued count is the same.
     return loadBuiltin(spv::BuiltInNumSubgroups);
   case Builtins::kGetSubGroupId:
     return loadBuiltin(spv::BuiltInSubgroupId);
   case Builtins::kGetSubGroupLocalId:
     return loadBuiltin(spv::BuiltInSubgroupLocalInvocationId);
 
+  case Builtins::kSubGroupBroadcast:
+  case Builtins::kSubGroupReduceMin:
+  case Builtins::kSubGroupReduceMax:
+    // Every invocation of the subgroup already has the same value.
+    if (clspv::Option::UniformityDecorations() &&
+        getUniformity().isSubgroupUniform(Call->getArgOperand(0))) {
+      return getSPIRVValue(Call->getArgOperand(0));
+    }
+    break;
+  default:
+    break;
+  }
+
+  switch (FuncInfo.getType()) {
   case Builtins::kSubGroupBroadcast:
     if (SpvVersion() < SPIRVVersion::SPIRV_1_5 &&
         !dyn_cast<ConstantInt>(Call->getOperand(1))) {
-      llvm_unreachable("sub_group_broadcast requires constant lane Id for "
-                       "SPIRV version < 1.5");
+      // Before SPIR-V 1.5 the lane of OpGroupNonUniformBroadcast must be a
+      // constant. A shuffle reads any lane, and the lane is uniform here.
+      addCapability(spv::CapabilityGroupNonUniformShuffle);
+      SPIRVOperandVec Ops;
+      Ops << Call->getType() << getSPIRVInt32Constant(spv::ScopeSubgroup)
+          << Call->getArgOperand(0) << Call->getArgOperand(1);
+      return addSPIRVInst(spv::OpGroupNonUniformShuffle, Ops);
     }
     addCapability(spv::CapabilityGroupNonUniformBallot);
     op = spv::OpGroupNonUniformBroadcast;
     break;
 
   case Builtins::kSubGroupAll:
+  case Builtins::kSubGroupAny: {
+    // The predicate and the result are ints in OpenCL C, but bools in SPIR-V.
     addCapability(spv::CapabilityGroupNonUniformVote);
-    op = spv::OpGroupNonUniformAll;
-    break;
-  case Builtins::kSubGroupAny:
-    addCapability(spv::CapabilityGroupNonUniformVote);
-    op = spv::OpGroupNonUniformAny;
-    break;
+    auto *bool_ty = Type::getInt1Ty(module->getContext());
+    auto *int_ty = Call->getType();
+    SPIRVOperandVec Ops;
+    Ops << bool_ty << Call->getArgOperand(0) << ConstantInt::get(int_ty, 0);
+    auto vote = addSPIRVInst(spv::OpINotEqual, Ops);
+
+    // A predicate the whole subgroup agrees on is its own vote.
+    if (!clspv::Option::UniformityDecorations() ||
+        !getUniformity().isSubgroupUniform(Call->getArgOperand(0))) {
+      Ops.clear();
+      Ops << bool_ty << getSPIRVInt32Constant(spv::ScopeSubgroup) << vote;
+      vote = addSPIRVInst(FuncInfo.getType() == Builtins::kSubGroupAll
+                              ? spv::OpGroupNonUniformAll
+                              : spv::OpGroupNonUniformAny,
+                          Ops);
+    }
+
+    Ops.clear();
+    Ops << int_ty << vote << ConstantInt::get(int_ty, 1)
+        << ConstantInt::get(int_ty, 0);
+    return addSPIRVInst(spv::OpSelect, Ops);
+  }
   case Builtins::kSubGroupReduceAdd:
   case Builtins::kSubGroupScanExclusiveAdd:
   case Builtins::kSubGroupScanInclusiveAdd: {
@@ -3654,10 +4430,6 @@ SPIRVProducerPass::GenerateSubgroupInstruction(CallInst *Call,
     break;
   }
 
-  case Builtins::kGetEnqueuedNumSubGroups:
-    // TODO(sjw): requires CapabilityKernel (incompatible with Shader)
-  case Builtins::kGetMaxSubGroupSize:
-    // TODO(sjw): use SpecConstant, capability Kernel (incompatible with Shader)
   case Builtins::kSubGroupBarrier:
   case Builtins::kSubGroupReserveReadPipe:
   case Builtins::kSubGroupReserveWritePipe:
@@ -4041,6 +4813,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
       setVariablePointersCapabilities(address_space);
       switch (GetStorageClass(address_space)) {
       case spv::StorageClassStorageBuffer:
+      case spv::StorageClassPhysicalStorageBuffer:
         // Save the need to generate an ArrayStride decoration.  But defer
         // generation until later, so we only make one decoration.
         getTypesNeedingArrayStride().insert(GEP->getPointerOperandType());
@@ -4115,7 +4888,8 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
       if (PointeeTy->isStructTy() &&
           dyn_cast<StructType>(PointeeTy)->isOpaque()) {
         Ty = PointeeTy;
-      } else {
+      } else if (GetStorageClass(Ty->getPointerAddressSpace()) !=
+                 spv::StorageClassPhysicalStorageBuffer) {
         // Selecting between pointers requires variable pointers.
         setVariablePointersCapabilities(Ty->getPointerAddressSpace());
         if (!hasVariablePointers() && !selectFromSameObject(&I)) {
@@ -4465,6 +5239,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
 
     SPIRVOperandVec Ops;
     Ops << LD->getType() << LD->getPointerOperand();
+    addMemoryAccess(LD->getPointerOperandType(), LD->getAlign(), Ops);
 
     RID = addSPIRVInst(spv::OpLoad, Ops);
     break;
@@ -4488,6 +5263,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
     // TODO: Do we need to implement Optional Memory Access???
     SPIRVOperandVec Ops;
     Ops << ST->getPointerOperand() << ST->getValueOperand();
+    addMemoryAccess(ST->getPointerOperandType(), ST->getAlign(), Ops);
 
     RID = addSPIRVInst(spv::OpStore, Ops);
     break;
@@ -4548,11 +5324,37 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
     const auto ConstantScopeDevice = getSPIRVInt32Constant(spv::ScopeDevice);
     Ops << ConstantScopeDevice;
 
-    const auto ConstantMemorySemantics =
-        getSPIRVInt32Constant(spv::MemorySemanticsUniformMemoryMask |
-                              spv::MemorySemanticsSequentiallyConsistentMask);
+    uint32_t semantics = spv::MemorySemanticsUniformMemoryMask |
+                         spv::MemorySemanticsSequentiallyConsistentMask;
+    if (clspv::Option::VulkanMemoryModel()) {
+      // Order the storage class of the pointer as strongly as the
+      // instruction asks.
+      semantics = AtomicRMW->getPointerAddressSpace() ==
+                          clspv::AddressSpace::Local
+                      ? spv::MemorySemanticsWorkgroupMemoryMask
+                      : spv::MemorySemanticsUniformMemoryMask;
+      switch (AtomicRMW->getOrdering()) {
+      case AtomicOrdering::Unordered:
+      case AtomicOrdering::Monotonic:
+        break;
+      case AtomicOrdering::Acquire:
+        semantics |= spv::MemorySemanticsAcquireMask;
+        break;
+      case AtomicOrdering::Release:
+        semantics |= spv::MemorySemanticsReleaseMask;
+        break;
+      default:
+        semantics |= spv::MemorySemanticsAcquireReleaseMask;
+        break;
+      }
+      semantics = VulkanMemoryModelSemantics(semantics);
+      addCapability(spv::CapabilityVulkanMemoryModelDeviceScope);
+    }
+
+    const auto ConstantMemorySemantics = getSPIRVInt32Constant(semantics);
     Ops << ConstantMemorySemantics << AtomicRMW->getValOperand();
 
+    addAtomicCapabilities(opcode, I.getType());
     RID = addSPIRVInst(opcode, Ops);
     break;
   }
@@ -4593,6 +5395,107 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
   // Register Instruction to ValueMap.
   if (RID.isValid()) {
     VMap[&I] = RID;
+    if (clspv::Option::UniformityDecorations()) {
+      GenerateUniformityDecorations(&I, RID);
+    }
+    if (RelaxedPrecisionValues.count(&I)) {
+      SPIRVOperandVec Ops;
+      Ops << RID << spv::DecorationRelaxedPrecision;
+      addSPIRVInst<kAnnotations>(spv::OpDecorate, Ops);
+    }
+  }
+}
+
+void SPIRVProducerPass::FindRelaxedPrecisionValues(Function &F) {
+  RelaxedPrecisionValues.clear();
+  const auto mode = clspv::Option::RelaxedPrecisionMode();
+  if (mode == clspv::Option::RelaxedPrecision::kNone)
+    return;
+  // Clang marks functions with "unsafe-fp-math" under -cl-fast-relaxed-math
+  // and -cl-unsafe-math-optimizations.
+  const bool relaxed_math =
+      mode == clspv::Option::RelaxedPrecision::kRelaxedMath &&
+      F.getFnAttribute("unsafe-fp-math").getValueAsString() == "true";
+
+  // Returns true if the float operands of |I| in [first, last) are relaxed
+  // values or constants, and at least one is a relaxed value.
+  auto relaxed_operands = [this](Instruction &I, unsigned first,
+                                 unsigned last) {
+    bool any_relaxed = false;
+    for (unsigned i = first; i < last; ++i) {
+      auto *op = I.getOperand(i);
+      if (!op->getType()->getScalarType()->isFloatTy())
+        continue;
+      if (RelaxedPrecisionValues.count(op))
+        any_relaxed = true;
+      else if (!isa<Constant>(op))
+        return false;
+    }
+    return any_relaxed;
+  };
+
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  for (auto *BB : RPOT) {
+    for (auto &I : *BB) {
+      // Half values are already computed at 16 bits.
+      if (!I.getType()->getScalarType()->isFloatTy())
+        continue;
+
+      bool relaxed = false;
+      if (auto *Call = dyn_cast<CallInst>(&I)) {
+        auto *Callee = Call->getCalledFunction();
+        if (!Callee)
+          continue;
+        const auto &info = Builtins::Lookup(Callee);
+        if (Builtins::IsRelaxedPrecisionBuiltin(info.getType())) {
+          relaxed = true;
+        } else if (getDirectOrIndirectExtInstEnum(info) != kGlslExtInstBad) {
+          relaxed = relaxed_math ||
+                    relaxed_operands(I, 0, Call->getNumArgOperands());
+        }
+      } else if (I.getMetadata(clspv::RelaxedPrecisionMetadataName())) {
+        relaxed = true;
+      } else if (isa<BinaryOperator>(I) || isa<UnaryOperator>(I)) {
+        relaxed = relaxed_math || relaxed_operands(I, 0, I.getNumOperands());
+      } else if (isa<SelectInst>(I)) {
+        relaxed = relaxed_operands(I, 1, 3);
+      } else if (isa<PHINode>(I) || isa<ExtractElementInst>(I) ||
+                 isa<InsertElementInst>(I) || isa<ShuffleVectorInst>(I)) {
+        relaxed = relaxed_operands(I, 0, I.getNumOperands());
+      }
+      if (relaxed)
+        RelaxedPrecisionValues.insert(&I);
+    }
+  }
+}
+
+void SPIRVProducerPass::GenerateUniformityDecorations(Value *V, SPIRVID RID) {
+  auto &UA = getUniformity();
+  SPIRVOperandVec Ops;
+  Type *Ty = V->getType();
+  if (!Ty->isPointerTy()) {
+    if ((isa<LoadInst>(V) || isa<PHINode>(V) || isa<Argument>(V)) &&
+        UA.isWorkgroupUniform(V)) {
+      Ops << RID << spv::DecorationUniform;
+      addSPIRVInst<kAnnotations>(spv::OpDecorate, Ops);
+    }
+    return;
+  }
+
+  // Vulkan requires the pointer to a resource that is not dynamically uniform
+  // to be decorated when it is accessed.
+  switch (GetStorageClass(Ty->getPointerAddressSpace())) {
+  case spv::StorageClassStorageBuffer:
+  case spv::StorageClassUniform:
+  case spv::StorageClassUniformConstant:
+    break;
+  default:
+    return;
+  }
+  if (UA.hasNonUniformResource(V) && NonUniformIDs.insert(RID.get()).second) {
+    addCapability(spv::CapabilityShaderNonUniformEXT);
+    Ops << RID << spv::DecorationNonUniformEXT;
+    addSPIRVInst<kAnnotations>(spv::OpDecorate, Ops);
   }
 }
 
@@ -4619,10 +5522,61 @@ bool SPIRVProducerPass::is4xi8vec(Type *Ty) const {
   return false;
 }
 
-void SPIRVProducerPass::HandleDeferredInstruction() {
+bool SPIRVProducerPass::CanStreamFunction(Function &F) {
+  for (auto &BB : F) {
+    for (auto &I : BB) {
+      if (auto *Call = dyn_cast<CallInst>(&I)) {
+        auto *Callee = Call->getCalledFunction();
+        if (Callee && !Callee->isDeclaration() && !ValueMap.count(Callee))
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+void SPIRVProducerPass::StreamFunction(size_t FirstDeferred) {
+  HandleDeferredInstruction(FirstDeferred);
+  DeferredInstVec.resize(FirstDeferred);
+
+  auto &Buffer = FunctionBuffers.back();
+  size_t NumWords = 0;
+  for (const auto &Inst : Buffer.Insts) {
+    NumWords += Inst.getWordCount();
+  }
+  Buffer.Words.reserve(NumWords);
+
+  auto *ModuleWords = binaryWords;
+  binaryWords = &Buffer.Words;
+  WriteSPIRVBinary(Buffer.Insts);
+  binaryWords = ModuleWords;
+
+  SPIRVInstructionList().swap(Buffer.Insts);
+  StreamedFunctionArena.Reset();
+  StreamingFunction = false;
+}
+
+void SPIRVProducerPass::ReleaseFunctionBody(Function &F) {
+  // The memory of the freed values may be reused by constants created later,
+  // which must not find their IDs.
+  for (auto &BB : F) {
+    ValueMap.erase(&BB);
+    for (auto &I : BB) {
+      ValueMap.erase(&I);
+    }
+    BB.dropAllReferences();
+  }
+  while (!F.empty()) {
+    F.begin()->eraseFromParent();
+  }
+  auto *BB = BasicBlock::Create(F.getContext(), "", &F);
+  new UnreachableInst(F.getContext(), BB);
+}
+
+void SPIRVProducerPass::HandleDeferredInstruction(size_t Begin) {
   DeferredInstVecType &DeferredInsts = getDeferredInstVec();
 
-  for (size_t i = 0; i < DeferredInsts.size(); ++i) {
+  for (size_t i = Begin; i < DeferredInsts.size(); ++i) {
     Value *Inst = DeferredInsts[i].first;
     SPIRVInstruction *Placeholder = DeferredInsts[i].second;
     SPIRVOperandVec Operands;
@@ -4643,11 +5597,15 @@ void SPIRVProducerPass::HandleDeferredInstruction() {
         //
         // Ops[0] = Merge Block ID
         // Ops[1] = Continue Target ID
-        // Ops[2] = Selection Control
+        // Ops[2] = Loop Control
+        // Ops[3] = Partial Count (only with PartialCount)
         SPIRVOperandVec Ops;
 
-        Ops << MergeBlocks[BrBB] << ContinueBlocks[BrBB]
-            << spv::LoopControlMaskNone;
+        auto Controls = LoopControls.lookup(BrBB);
+        Ops << MergeBlocks[BrBB] << ContinueBlocks[BrBB] << Controls.first;
+        if (Controls.first & spv::LoopControlPartialCountMask) {
+          Ops << Controls.second;
+        }
 
         replaceSPIRVInst(Placeholder, spv::OpLoopMerge, Ops);
 
@@ -4696,7 +5654,9 @@ void SPIRVProducerPass::HandleDeferredInstruction() {
       }
     } else if (PHINode *PHI = dyn_cast<PHINode>(Inst)) {
       if (PHI->getType()->isPointerTy() && !IsSamplerType(PHI->getType()) &&
-          !IsImageType(PHI->getType())) {
+          !IsImageType(PHI->getType()) &&
+          GetStorageClass(PHI->getType()->getPointerAddressSpace()) !=
+              spv::StorageClassPhysicalStorageBuffer) {
         // OpPhi on pointers requires variable pointers.
         setVariablePointersCapabilities(
             PHI->getType()->getPointerAddressSpace());
@@ -5031,7 +5991,7 @@ glsl::ExtInst SPIRVProducerPass::getDirectOrIndirectExtInstEnum(
 }
 
 void SPIRVProducerPass::WriteOneWord(uint32_t Word) {
-  binaryOut->write(reinterpret_cast<const char *>(&Word), sizeof(uint32_t));
+  binaryWords->push_back(Word);
 }
 
 void SPIRVProducerPass::WriteResultID(const SPIRVInstruction &Inst) {
@@ -5063,22 +6023,13 @@ void SPIRVProducerPass::WriteOperand(const SPIRVOperand &Op) {
     break;
   }
   case SPIRVOperandType::LITERAL_STRING: {
-    std::string Str = Op.getLiteralStr();
-    const char *Data = Str.c_str();
-    size_t WordSize = Str.size() / 4;
-    for (unsigned Idx = 0; Idx < WordSize; Idx++) {
-      WriteOneWord(*reinterpret_cast<const uint32_t *>(&Data[4 * Idx]));
-    }
-
-    uint32_t Remainder = Str.size() % 4;
-    uint32_t LastWord = 0;
-    if (Remainder) {
-      for (unsigned Idx = 0; Idx < Remainder; Idx++) {
-        LastWord |= Data[4 * WordSize + Idx] << 8 * Idx;
-      }
+    // The string is stored null-terminated and zero-padded to whole words.
+    const char *Data = Op.getLiteralStr().data();
+    for (uint32_t Idx = 0; Idx < Op.GetNumWords(); Idx++) {
+      uint32_t Word;
+      std::memcpy(&Word, &Data[4 * Idx], sizeof(Word));
+      WriteOneWord(Word);
     }
-
-    WriteOneWord(LastWord);
     break;
   }
   case SPIRVOperandType::LITERAL_WORD: {
@@ -5094,8 +6045,31 @@ void SPIRVProducerPass::WriteOperand(const SPIRVOperand &Op) {
 }
 
 void SPIRVProducerPass::WriteSPIRVBinary() {
+  // Size the output up front so it is not regrown while writing.
+  size_t NumWords = binaryWords->size();
+  auto CountWords = [&NumWords](const SPIRVInstructionList &InstList) {
+    for (const auto &Inst : InstList) {
+      NumWords += Inst.getWordCount();
+    }
+  };
+  for (int i = 0; i < kSectionCount; ++i) {
+    CountWords(SPIRVSections[i]);
+  }
+  for (const auto &Buffer : FunctionBuffers) {
+    NumWords += Buffer.Words.size();
+    CountWords(Buffer.Insts);
+  }
+  binaryWords->reserve(NumWords);
+
   for (int i = 0; i < kSectionCount; ++i) {
     WriteSPIRVBinary(SPIRVSections[i]);
+    if (i == kFunctions) {
+      for (auto &Buffer : FunctionBuffers) {
+        binaryWords->insert(binaryWords->end(), Buffer.Words.begin(),
+                            Buffer.Words.end());
+        WriteSPIRVBinary(Buffer.Insts);
+      }
+    }
   }
 }
 
@@ -5272,6 +6246,7 @@ void SPIRVProducerPass::WriteSPIRVBinary(SPIRVInstructionList &SPIRVInstList) {
     case spv::OpAtomicAnd:
     case spv::OpAtomicOr:
     case spv::OpAtomicXor:
+    case spv::OpAtomicFAddEXT:
     case spv::OpDot:
     case spv::OpGroupNonUniformAll:
     case spv::OpGroupNonUniformAny:
@@ -5336,107 +6311,102 @@ bool SPIRVProducerPass::IsTypeNullable(const Type *type) const {
 }
 
 void SPIRVProducerPass::PopulateUBOTypeMaps() {
-  if (auto *offsets_md =
-          module->getNamedMetadata(clspv::RemappedTypeOffsetMetadataName())) {
-    // Metdata is stored as key-value pair operands. The first element of each
-    // operand is the type and the second is a vector of offsets.
-    for (const auto *operand : offsets_md->operands()) {
-      const auto *pair = cast<MDTuple>(operand);
-      auto *type =
-          cast<ConstantAsMetadata>(pair->getOperand(0))->getValue()->getType();
-      const auto *offset_vector = cast<MDTuple>(pair->getOperand(1));
-      std::vector<uint32_t> offsets;
-      for (const Metadata *offset_md : offset_vector->operands()) {
-        const auto *constant_md = cast<ConstantAsMetadata>(offset_md);
-        offsets.push_back(static_cast<uint32_t>(
-            cast<ConstantInt>(constant_md->getValue())->getZExtValue()));
-      }
-      RemappedUBOTypeOffsets.insert(std::make_pair(type, offsets));
-    }
-  }
-
-  if (auto *sizes_md =
-          module->getNamedMetadata(clspv::RemappedTypeSizesMetadataName())) {
-    // Metadata is stored as key-value pair operands. The first element of each
-    // operand is the type and the second is a triple of sizes: type size in
-    // bits, store size and alloc size.
-    for (const auto *operand : sizes_md->operands()) {
-      const auto *pair = cast<MDTuple>(operand);
-      auto *type =
-          cast<ConstantAsMetadata>(pair->getOperand(0))->getValue()->getType();
-      const auto *size_triple = cast<MDTuple>(pair->getOperand(1));
-      uint64_t type_size_in_bits =
-          cast<ConstantInt>(
-              cast<ConstantAsMetadata>(size_triple->getOperand(0))->getValue())
-              ->getZExtValue();
-      uint64_t type_store_size =
-          cast<ConstantInt>(
-              cast<ConstantAsMetadata>(size_triple->getOperand(1))->getValue())
-              ->getZExtValue();
-      uint64_t type_alloc_size =
-          cast<ConstantInt>(
-              cast<ConstantAsMetadata>(size_triple->getOperand(2))->getValue())
-              ->getZExtValue();
-      RemappedUBOTypeSizes.insert(std::make_pair(
-          type, std::make_tuple(type_size_in_bits, type_store_size,
-                                type_alloc_size)));
-    }
-  }
+  TypeLayout.reset(new clspv::TypeLayoutCache(*module));
 }
 
 uint64_t SPIRVProducerPass::GetTypeSizeInBits(Type *type,
-                                              const DataLayout &DL) {
-  auto iter = RemappedUBOTypeSizes.find(type);
-  if (iter != RemappedUBOTypeSizes.end()) {
-    return std::get<0>(iter->second);
-  }
+                                              const DataLayout &) {
+  return TypeLayout->getTypeSizeInBits(type);
+}
 
-  return DL.getTypeSizeInBits(type);
+uint64_t SPIRVProducerPass::GetTypeStoreSize(Type *type, const DataLayout &) {
+  return TypeLayout->getTypeStoreSize(type);
 }
 
-uint64_t SPIRVProducerPass::GetTypeStoreSize(Type *type, const DataLayout &DL) {
-  auto iter = RemappedUBOTypeSizes.find(type);
-  if (iter != RemappedUBOTypeSizes.end()) {
-    return std::get<1>(iter->second);
-  }
+uint64_t SPIRVProducerPass::GetTypeAllocSize(Type *type, const DataLayout &) {
+  return TypeLayout->getTypeAllocSize(type);
+}
 
-  return DL.getTypeStoreSize(type);
+uint32_t SPIRVProducerPass::GetExplicitLayoutStructMemberOffset(
+    StructType *type, unsigned member, const DataLayout &) {
+  return TypeLayout->getMemberOffset(type, member);
 }
 
-uint64_t SPIRVProducerPass::GetTypeAllocSize(Type *type, const DataLayout &DL) {
-  auto iter = RemappedUBOTypeSizes.find(type);
-  if (iter != RemappedUBOTypeSizes.end()) {
-    return std::get<2>(iter->second);
+void SPIRVProducerPass::setVariablePointersCapabilities(
+    unsigned address_space) {
+  const auto sc = GetStorageClass(address_space);
+  if (sc == spv::StorageClassPhysicalStorageBuffer) {
+    // Physical pointers do not need variable pointers.
+    return;
   }
 
-  return DL.getTypeAllocSize(type);
+  if (sc == spv::StorageClassStorageBuffer) {
+    setVariablePointersStorageBuffer();
+  } else {
+    setVariablePointers();
+  }
 }
 
-uint32_t SPIRVProducerPass::GetExplicitLayoutStructMemberOffset(
-    StructType *type, unsigned member, const DataLayout &DL) {
-  const auto StructLayout = DL.getStructLayout(type);
-  // Search for the correct offsets if this type was remapped.
-  std::vector<uint32_t> *offsets = nullptr;
-  auto iter = RemappedUBOTypeOffsets.find(type);
-  if (iter != RemappedUBOTypeOffsets.end()) {
-    offsets = &iter->second;
+void SPIRVProducerPass::addMemoryAccess(Type *ptr_type, Align alignment,
+                                        SPIRVOperandVec &Ops) {
+  const auto storage_class =
+      GetStorageClass(ptr_type->getPointerAddressSpace());
+  uint32_t memory_access = spv::MemoryAccessMaskNone;
+  if (storage_class == spv::StorageClassPhysicalStorageBuffer) {
+    memory_access |= spv::MemoryAccessAlignedMask;
   }
-  auto ByteOffset =
-      static_cast<uint32_t>(StructLayout->getElementOffset(member));
-  if (offsets) {
-    ByteOffset = (*offsets)[member];
+  if (clspv::Option::VulkanMemoryModel() &&
+      IsSharedStorageClass(storage_class)) {
+    memory_access |= spv::MemoryAccessNonPrivatePointerMask;
   }
+  if (memory_access == spv::MemoryAccessMaskNone)
+    return;
 
-  return ByteOffset;
+  // Ops[n] = Memory Access
+  // Ops[n + 1] = Alignment (Literal Number), if Aligned
+  Ops << memory_access;
+  if (memory_access & spv::MemoryAccessAlignedMask) {
+    Ops << static_cast<uint32_t>(alignment.value());
+  }
 }
 
-void SPIRVProducerPass::setVariablePointersCapabilities(
-    unsigned address_space) {
-  if (GetStorageClass(address_space) == spv::StorageClassStorageBuffer) {
-    setVariablePointersStorageBuffer();
-  } else {
-    setVariablePointers();
+void SPIRVProducerPass::addMemoryModelOperand(spv::Op opcode,
+                                              unsigned position, Value *value,
+                                              SPIRVOperandVec &Ops) {
+  auto *constant = dyn_cast<ConstantInt>(value);
+  if (!clspv::Option::VulkanMemoryModel() || !constant) {
+    Ops << value;
+    return;
   }
+
+  const auto operand = static_cast<uint32_t>(constant->getZExtValue());
+  if (IsMemorySemanticsOperand(opcode, position)) {
+    Ops << getSPIRVInt32Constant(VulkanMemoryModelSemantics(operand));
+    return;
+  }
+  if (IsMemoryScopeOperand(opcode, position) && operand == spv::ScopeDevice) {
+    addCapability(spv::CapabilityVulkanMemoryModelDeviceScope);
+  }
+  Ops << value;
+}
+
+void SPIRVProducerPass::addAtomicCapabilities(spv::Op opcode, Type *type) {
+  if (opcode == spv::OpAtomicFAddEXT) {
+    addCapability(type->isDoubleTy() ? spv::CapabilityAtomicFloat64AddEXT
+                                     : spv::CapabilityAtomicFloat32AddEXT);
+    return;
+  }
+
+  if (opcode < spv::OpAtomicLoad || opcode > spv::OpAtomicXor ||
+      !type->isIntegerTy(64))
+    return;
+
+  if (!clspv::Option::Int64Atomics()) {
+    errs() << "error: atomic operations on 64-bit integers require "
+              "-int64-atomics\n";
+    llvm_unreachable("64-bit atomics are not enabled");
+  }
+  addCapability(spv::CapabilityInt64Atomics);
 }
 
 Value *SPIRVProducerPass::GetBasePointer(Value *v) {
@@ -5651,6 +6621,7 @@ void SPIRVProducerPass::PopulateStructuredCFGMaps() {
         // Record the continue and merge blocks.
         MergeBlocks[BB] = MergeBB;
         ContinueBlocks[BB] = ContinueBB;
+        LoopControls[BB] = GetLoopControls(L);
         LoopMergesAndContinues.insert(MergeBB);
         LoopMergesAndContinues.insert(ContinueBB);
       } else if (branch && branch->isConditional()) {
@@ -5680,6 +6651,104 @@ void SPIRVProducerPass::PopulateStructuredCFGMaps() {
   }
 }
 
+std::pair<uint32_t, uint32_t> SPIRVProducerPass::GetLoopControls(Loop *L) {
+  // The structurizer drops the llvm.loop metadata from the latch branch, so
+  // fall back on the copy kept in the header.
+  MDNode *LoopID = L->getLoopID();
+  if (!LoopID) {
+    for (auto &I : *L->getHeader()) {
+      if (auto *MD = I.getMetadata(clspv::LoopMetadataName())) {
+        LoopID = MD;
+        break;
+      }
+    }
+  }
+  if (!LoopID)
+    return {spv::LoopControlMaskNone, 0};
+
+  uint32_t Mask = spv::LoopControlMaskNone;
+  uint32_t Count = 0;
+  SmallPtrSet<const MDNode *, 4> ParallelGroups;
+  // Operand 0 is the self reference.
+  for (unsigned i = 1; i < LoopID->getNumOperands(); ++i) {
+    auto *Hint = dyn_cast<MDNode>(LoopID->getOperand(i));
+    if (!Hint || Hint->getNumOperands() == 0)
+      continue;
+    auto *Name = dyn_cast<MDString>(Hint->getOperand(0));
+    if (!Name)
+      continue;
+
+    // llvm.loop.unroll.disable is ignored: the LLVM unroller also adds it to
+    // the loops it has unrolled. The source hint is marked separately.
+    if (Name->getString() == clspv::SourceDontUnrollHintName()) {
+      Mask |= spv::LoopControlDontUnrollMask;
+    } else if (Name->getString() == "llvm.loop.unroll.enable" ||
+               Name->getString() == "llvm.loop.unroll.full") {
+      Mask |= spv::LoopControlUnrollMask;
+    } else if (Name->getString() == "llvm.loop.unroll.count" &&
+               Hint->getNumOperands() == 2) {
+      if (auto *N = mdconst::dyn_extract<ConstantInt>(Hint->getOperand(1)))
+        Count = static_cast<uint32_t>(N->getZExtValue());
+    } else if (Name->getString() == "llvm.loop.parallel_accesses") {
+      for (unsigned j = 1; j < Hint->getNumOperands(); ++j) {
+        if (auto *Group = dyn_cast<MDNode>(Hint->getOperand(j)))
+          ParallelGroups.insert(Group);
+      }
+    }
+  }
+
+  if (Count == 1) {
+    Mask |= spv::LoopControlDontUnrollMask;
+  } else if (Count > 1) {
+    // PartialCount was added in SPIR-V 1.4.
+    if (SpvVersion() >= SPIRVVersion::SPIRV_1_5) {
+      Mask |= spv::LoopControlPartialCountMask;
+    } else {
+      Mask |= spv::LoopControlUnrollMask;
+    }
+  }
+
+  // Unroll and DontUnroll must not both be set; disabling wins, as it does in
+  // LLVM.
+  if (Mask & spv::LoopControlDontUnrollMask) {
+    Mask &= ~(spv::LoopControlUnrollMask | spv::LoopControlPartialCountMask);
+  }
+
+  // Like Loop::isAnnotatedParallel, the loop only has no loop-carried
+  // dependencies if every memory access in it belongs to one of the parallel
+  // access groups.
+  if (!ParallelGroups.empty()) {
+    auto InParallelGroup = [&ParallelGroups](const Instruction &I) {
+      auto *MD = I.getMetadata(LLVMContext::MD_access_group);
+      if (!MD)
+        return false;
+      if (MD->getNumOperands() == 0)
+        return ParallelGroups.count(MD) != 0;
+      for (auto &Op : MD->operands()) {
+        if (ParallelGroups.count(cast<MDNode>(Op)))
+          return true;
+      }
+      return false;
+    };
+
+    bool Parallel = true;
+    for (auto *BB : L->blocks()) {
+      for (auto &I : *BB) {
+        if (I.mayReadOrWriteMemory() && !InParallelGroup(I)) {
+          Parallel = false;
+          break;
+        }
+      }
+      if (!Parallel)
+        break;
+    }
+    if (Parallel)
+      Mask |= spv::LoopControlDependencyInfiniteMask;
+  }
+
+  return {Mask, Count};
+}
+
 SPIRVID SPIRVProducerPass::getReflectionImport() {
   if (!ReflectionID.isValid()) {
     addSPIRVInst<kExtensions>(spv::OpExtension, "SPV_KHR_non_semantic_info");
@@ -5689,12 +6758,149 @@ SPIRVID SPIRVProducerPass::getReflectionImport() {
   return ReflectionID;
 }
 
+SPIRVID SPIRVProducerPass::getPodSpecConstantImport() {
+  if (!PodSpecConstantImportID.isValid()) {
+    // The extension is declared along with the reflection import, which is
+    // always generated first.
+    getReflectionImport();
+    PodSpecConstantImportID = addSPIRVInst<kImports>(
+        spv::OpExtInstImport, clspv::kPodSpecConstantImportName);
+  }
+  return PodSpecConstantImportID;
+}
+
+SPIRVID SPIRVProducerPass::getProfileCountersImport() {
+  if (!ProfileCountersImportID.isValid()) {
+    getReflectionImport();
+    ProfileCountersImportID = addSPIRVInst<kImports>(
+        spv::OpExtInstImport, clspv::kProfileCountersImportName);
+  }
+  return ProfileCountersImportID;
+}
+
+SPIRVID SPIRVProducerPass::getKernelResourceUsageImport() {
+  if (!KernelResourceUsageImportID.isValid()) {
+    getReflectionImport();
+    KernelResourceUsageImportID = addSPIRVInst<kImports>(
+        spv::OpExtInstImport, clspv::kKernelResourceUsageImportName);
+  }
+  return KernelResourceUsageImportID;
+}
+
+SPIRVID SPIRVProducerPass::getImmutableSamplersImport() {
+  if (!ImmutableSamplersImportID.isValid()) {
+    getReflectionImport();
+    ImmutableSamplersImportID = addSPIRVInst<kImports>(
+        spv::OpExtInstImport, clspv::kImmutableSamplersImportName);
+  }
+  return ImmutableSamplersImportID;
+}
+
 void SPIRVProducerPass::GenerateReflection() {
   GenerateKernelReflection();
   GeneratePushConstantReflection();
   GenerateSpecConstantReflection();
 }
 
+void SPIRVProducerPass::GenerateKernelResourceUsage(Function &F,
+                                                    SPIRVID kernel_decl) {
+  const auto &DL = module->getDataLayout();
+
+  // The kernel uses the memory of every function it may call.
+  SetVector<Function *> Functions;
+  Functions.insert(&F);
+  for (unsigned i = 0; i < Functions.size(); ++i) {
+    for (auto &BB : *Functions[i]) {
+      for (auto &I : BB) {
+        if (auto *Call = dyn_cast<CallInst>(&I)) {
+          auto *Callee = Call->getCalledFunction();
+          if (Callee && !Callee->isDeclaration())
+            Functions.insert(Callee);
+        }
+      }
+    }
+  }
+
+  // Function variables are private memory. Module scope variables are counted
+  // once, whichever functions use them.
+  SmallPtrSet<GlobalVariable *, 8> Globals;
+  uint64_t private_bytes = 0;
+  unsigned dims = 0;
+  for (auto *Fn : Functions) {
+    for (auto &BB : *Fn) {
+      for (auto &I : BB) {
+        if (auto *Alloca = dyn_cast<AllocaInst>(&I)) {
+          uint64_t count = 1;
+          if (auto *Size = dyn_cast<ConstantInt>(Alloca->getArraySize()))
+            count = Size->getZExtValue();
+          private_bytes +=
+              count * GetTypeAllocSize(Alloca->getAllocatedType(), DL);
+        }
+
+        for (auto &Op : I.operands()) {
+          const User *U = &I;
+          auto *GV = dyn_cast<GlobalVariable>(Op.get());
+          if (auto *CE = dyn_cast<ConstantExpr>(Op.get())) {
+            U = CE;
+            GV = dyn_cast<GlobalVariable>(CE->getOperand(0));
+          }
+          if (!GV)
+            continue;
+          Globals.insert(GV);
+          if (IsWorkItemIdVariable(GV))
+            dims = std::max(dims, DimensionsRead(U));
+        }
+      }
+    }
+  }
+
+  uint64_t workgroup_bytes = 0;
+  uint64_t push_constant_bytes = 0;
+  for (auto *GV : Globals) {
+    const auto size = GetTypeAllocSize(GV->getValueType(), DL);
+    switch (GV->getType()->getPointerAddressSpace()) {
+    case AddressSpace::Local:
+      workgroup_bytes += size;
+      break;
+    case AddressSpace::ModuleScopePrivate:
+      private_bytes += size;
+      break;
+    case AddressSpace::PushConstant:
+      push_constant_bytes += size;
+      break;
+    default:
+      break;
+    }
+  }
+
+  uint32_t local_size[3];
+  if (const MDNode *MD = F.getMetadata("reqd_work_group_size")) {
+    for (unsigned i = 0; i < 3; ++i) {
+      local_size[i] = static_cast<uint32_t>(
+          mdconst::extract<ConstantInt>(MD->getOperand(i))->getZExtValue());
+    }
+  } else {
+    SuggestLocalSize(dims, workgroup_bytes, private_bytes, local_size);
+  }
+
+  auto void_id = getSPIRVType(Type::getVoidTy(module->getContext()));
+  SPIRVOperandVec Ops;
+  Ops << void_id << getKernelResourceUsageImport()
+      << clspv::kKernelResourceUsage << kernel_decl
+      << getSPIRVInt32Constant(static_cast<uint32_t>(workgroup_bytes))
+      << getSPIRVInt32Constant(static_cast<uint32_t>(private_bytes))
+      << getSPIRVInt32Constant(static_cast<uint32_t>(push_constant_bytes));
+  addSPIRVInst<kReflection>(spv::OpExtInst, Ops);
+
+  Ops.clear();
+  Ops << void_id << getKernelResourceUsageImport()
+      << clspv::kKernelSuggestedLocalSize << kernel_decl
+      << getSPIRVInt32Constant(local_size[0])
+      << getSPIRVInt32Constant(local_size[1])
+      << getSPIRVInt32Constant(local_size[2]);
+  addSPIRVInst<kReflection>(spv::OpExtInst, Ops);
+}
+
 void SPIRVProducerPass::GeneratePushConstantReflection() {
   if (auto GV = module->getGlobalVariable(clspv::PushConstantsVariableName())) {
     auto const &DL = module->getDataLayout();
@@ -5714,9 +6920,8 @@ void SPIRVProducerPass::GeneratePushConstantReflection() {
         previousOffset = GetExplicitLayoutStructMemberOffset(STy, i - 1, DL);
       }
       auto size = static_cast<uint32_t>(GetTypeSizeInBits(memberType, DL)) / 8;
-      assert(isValidExplicitLayout(*module, STy, i,
-                                   spv::StorageClassPushConstant, offset,
-                                   previousOffset));
+      assert(TypeLayout->isValidExplicitLayout(
+          STy, i, spv::StorageClassPushConstant, offset, previousOffset));
 
       reflection::ExtInst pc_inst = reflection::ExtInstMax;
       switch (pc) {
@@ -5762,8 +6967,10 @@ void SPIRVProducerPass::GenerateSpecConstantReflection() {
     auto kind = pair.first;
     auto id = pair.second;
 
-    // Local memory size is only used for kernel arguments.
-    if (kind == SpecConstant::kLocalMemorySize)
+    // Local memory size and POD arguments are only used for kernel
+    // arguments.
+    if (kind == SpecConstant::kLocalMemorySize ||
+        kind == SpecConstant::kPodArgument)
       continue;
 
     switch (kind) {
@@ -5866,9 +7073,57 @@ void SPIRVProducerPass::GenerateKernelReflection() {
       addSPIRVInst<kReflection>(spv::OpExtInst, Ops);
     }
 
+    if (clspv::Option::KernelResourceUsage()) {
+      GenerateKernelResourceUsage(F, kernel_decl);
+    }
+
     auto &resource_var_at_index = FunctionToResourceVarsMap[&F];
     auto *func_ty = F.getFunctionType();
 
+    // With -lean-memory the argument names were recorded before the context
+    // started discarding value names. Variants of a kernel share its names.
+    const MDNode *recorded_names = nullptr;
+    if (auto *names_md =
+            module->getNamedMetadata(clspv::KernelArgNamesMetadataName())) {
+      StringRef kernel_name = F.getName();
+      kernel_name.consume_back(clspv::UniformNDRangeKernelSuffix());
+      for (const auto *node : names_md->operands()) {
+        if (cast<MDString>(node->getOperand(0))->getString() == kernel_name)
+          recorded_names = node;
+      }
+    }
+    auto arg_name = [recorded_names](uint32_t ordinal, StringRef name) {
+      if (name.empty() && recorded_names &&
+          ordinal + 1 < recorded_names->getNumOperands()) {
+        if (auto *str = dyn_cast<MDString>(
+                recorded_names->getOperand(ordinal + 1))) {
+          return str->getString().str();
+        }
+      }
+      return name.str();
+    };
+
+    // Report the POD arguments read from specialization constants. Variants
+    // of a kernel share them.
+    if (auto *pod_md =
+            module->getNamedMetadata(clspv::PodSpecConstantMetadataName())) {
+      StringRef base_name = F.getName();
+      base_name.consume_back(clspv::UniformNDRangeKernelSuffix());
+      for (const auto *node : pod_md->operands()) {
+        if (cast<MDString>(node->getOperand(0))->getString() != base_name)
+          continue;
+        const auto ordinal = static_cast<uint32_t>(
+            mdconst::extract<ConstantInt>(node->getOperand(1))->getZExtValue());
+        const auto spec_id = static_cast<uint32_t>(
+            mdconst::extract<ConstantInt>(node->getOperand(2))->getZExtValue());
+        Ops.clear();
+        Ops << void_id << getPodSpecConstantImport()
+            << clspv::kPodSpecConstantArgument << kernel_decl
+            << getSPIRVInt32Constant(ordinal) << getSPIRVInt32Constant(spec_id);
+        addSPIRVInst<kReflection>(spv::OpExtInst, Ops);
+      }
+    }
+
     // If we've clustered POD arguments, then argument details are in metadata.
     // If an argument maps to a resource variable, then get descriptor set and
     // binding from the resource variable.  Other info comes from the metadata.
@@ -5896,7 +7151,7 @@ void SPIRVProducerPass::GenerateKernelReflection() {
         // If this is a local memory argument, find the right spec id for this
         // argument.
         int64_t spec_id = -1;
-        if (argKind == clspv::ArgKind::Local) {
+        if (argKind == clspv::ArgKind::Local && local_spec_id_md) {
           for (auto spec_id_arg : local_spec_id_md->operands()) {
             if ((&F == dyn_cast<Function>(
                            dyn_cast<ValueAsMetadata>(spec_id_arg->getOperand(0))
@@ -5912,6 +7167,11 @@ void SPIRVProducerPass::GenerateKernelReflection() {
           }
         }
 
+        // A local memory argument sized by -local-arg-size has no spec id and
+        // is left out of the reflection.
+        if (argKind == clspv::ArgKind::Local && spec_id < 0)
+          continue;
+
         // Generate the specific argument instruction.
         const uint32_t ordinal = static_cast<uint32_t>(old_index);
         const uint32_t arg_offset = static_cast<uint32_t>(offset);
@@ -5925,14 +7185,23 @@ void SPIRVProducerPass::GenerateKernelReflection() {
                                    ->getPointerElementType(),
                                DL));
         } else if (new_index >= 0) {
-          auto *info = resource_var_at_index[new_index];
-          assert(info);
+          auto *info = static_cast<unsigned>(new_index) <
+                               resource_var_at_index.size()
+                           ? resource_var_at_index[new_index]
+                           : nullptr;
+          // With -skip-unused-kernel-args, unused arguments have no resource
+          // variable and are left out of the reflection.
+          if (!info) {
+            assert(clspv::Option::SkipUnusedKernelArgs());
+            continue;
+          }
           descriptor_set = info->descriptor_set;
           binding = info->binding;
         }
-        AddArgumentReflection(kernel_decl, name.str(), argKind, ordinal,
-                              descriptor_set, binding, arg_offset, arg_size,
-                              static_cast<uint32_t>(spec_id), elem_size);
+        AddArgumentReflection(kernel_decl, arg_name(ordinal, name), argKind,
+                              ordinal, descriptor_set, binding, arg_offset,
+                              arg_size, static_cast<uint32_t>(spec_id),
+                              elem_size);
       }
     } else {
       // There is no argument map.
@@ -5958,7 +7227,8 @@ void SPIRVProducerPass::GenerateKernelReflection() {
 
           // Local pointer arguments are unused in this case.
           // offset, spec_id and elem_size always 0.
-          AddArgumentReflection(kernel_decl, arg->getName().str(),
+          AddArgumentReflection(kernel_decl,
+                                arg_name(arg_index, arg->getName()),
                                 info->arg_kind, arg_index, info->descriptor_set,
                                 info->binding, 0, arg_size, 0, 0);
         }
@@ -5972,7 +7242,8 @@ void SPIRVProducerPass::GenerateKernelReflection() {
           auto &local_arg_info = LocalSpecIdInfoMap[where->second];
 
           // descriptor_set, binding, offset and size are always 0.
-          AddArgumentReflection(kernel_decl, arg->getName().str(),
+          AddArgumentReflection(kernel_decl,
+                                arg_name(arg_index, arg->getName()),
                                 ArgKind::Local, arg_index, 0, 0, 0, 0,
                                 static_cast<uint32_t>(local_arg_info.spec_id),
                                 static_cast<uint32_t>(GetTypeAllocSize(
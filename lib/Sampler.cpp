@@ -54,4 +54,40 @@ const char *GetSamplerFilteringModeName(uint32_t mask) {
   return "";
 }
 
+VulkanSamplerState GetVulkanSamplerState(uint32_t mask) {
+  // Values of the VkFilter, VkSamplerAddressMode and VkBorderColor enums.
+  const uint32_t kFilterNearest = 0;
+  const uint32_t kFilterLinear = 1;
+  const uint32_t kAddressModeRepeat = 0;
+  const uint32_t kAddressModeMirroredRepeat = 1;
+  const uint32_t kAddressModeClampToEdge = 2;
+  const uint32_t kAddressModeClampToBorder = 3;
+  const uint32_t kBorderColorFloatTransparentBlack = 0;
+
+  VulkanSamplerState state;
+  state.filter = (mask & kSamplerFilterMask) == CLK_FILTER_LINEAR
+                     ? kFilterLinear
+                     : kFilterNearest;
+  switch (mask & kSamplerAddressMask) {
+  case CLK_ADDRESS_NONE:
+  case CLK_ADDRESS_CLAMP_TO_EDGE:
+  default:
+    state.address_mode = kAddressModeClampToEdge;
+    break;
+  case CLK_ADDRESS_CLAMP:
+    state.address_mode = kAddressModeClampToBorder;
+    break;
+  case CLK_ADDRESS_REPEAT:
+    state.address_mode = kAddressModeRepeat;
+    break;
+  case CLK_ADDRESS_MIRRORED_REPEAT:
+    state.address_mode = kAddressModeMirroredRepeat;
+    break;
+  }
+  state.unnormalized_coordinates =
+      (mask & kSamplerNormalizedCoordsMask) ? 0 : 1;
+  state.border_color = kBorderColorFloatTransparentBlack;
+  return state;
+}
+
 } // namespace clspv
@@ -0,0 +1,114 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "llvm/ADT/StringSet.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "clspv/Option.h"
+
+#include "Passes.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "SelectEntryPoints"
+
+namespace {
+struct SelectEntryPointsPass : public ModulePass {
+  static char ID;
+  SelectEntryPointsPass() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override;
+};
+} // namespace
+
+char SelectEntryPointsPass::ID = 0;
+INITIALIZE_PASS(SelectEntryPointsPass, "SelectEntryPoints",
+                "Select Entry Points Pass", false, false)
+
+namespace clspv {
+ModulePass *createSelectEntryPointsPass() {
+  return new SelectEntryPointsPass();
+}
+} // namespace clspv
+
+bool SelectEntryPointsPass::runOnModule(Module &M) {
+  const auto names = clspv::Option::EntryPoints();
+  if (names.empty())
+    return false;
+
+  StringSet<> keep;
+  for (const auto &name : names) {
+    keep.insert(name);
+  }
+
+  for (const auto &name : keep.keys()) {
+    auto *F = M.getFunction(name);
+    if (!F || F->isDeclaration() ||
+        F->getCallingConv() != CallingConv::SPIR_KERNEL) {
+      errs() << "warning: -entry-points names '" << name
+             << "', which is not a kernel of the program\n";
+    }
+  }
+
+  bool changed = false;
+  SmallVector<Function *, 8> worklist;
+  for (auto &F : M) {
+    if (F.getCallingConv() != CallingConv::SPIR_KERNEL ||
+        keep.count(F.getName()))
+      continue;
+    changed = true;
+    if (F.use_empty()) {
+      worklist.push_back(&F);
+      continue;
+    }
+    // A kernel called from a kept kernel stays as a helper function.
+    F.setCallingConv(CallingConv::SPIR_FUNC);
+    F.setLinkage(GlobalValue::InternalLinkage);
+    for (auto *U : F.users()) {
+      if (auto *call = dyn_cast<CallInst>(U))
+        call->setCallingConv(CallingConv::SPIR_FUNC);
+    }
+  }
+
+  // Remove the dropped kernels and then every helper that only they used, so
+  // that later passes never see them.
+  while (!worklist.empty()) {
+    Function *F = worklist.pop_back_val();
+    SmallVector<Function *, 8> callees;
+    for (auto &BB : *F) {
+      for (auto &I : BB) {
+        for (auto &op : I.operands()) {
+          if (auto *callee = dyn_cast<Function>(op->stripPointerCasts()))
+            callees.push_back(callee);
+        }
+      }
+    }
+    F->eraseFromParent();
+    for (auto *callee : callees) {
+      if (callee != F && callee->use_empty() &&
+          callee->getCallingConv() != CallingConv::SPIR_KERNEL &&
+          std::find(worklist.begin(), worklist.end(), callee) ==
+              worklist.end()) {
+        worklist.push_back(callee);
+      }
+    }
+  }
+
+  return changed;
+}
@@ -0,0 +1,503 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs the LLVM CFG structurizer only on the functions that need it. A
+// function whose control flow already has the shape the structurizer
+// produces, and that the SPIR-V producer expects, is left alone: every loop
+// has a single latch and a single exit, and the false successor of every
+// other conditional branch is the merge of the selection. Such functions are
+// common (straight-line code, counted loops and if-without-else) and the
+// structurizer only costs compile time on them, while regions it cannot prove
+// uniform may still get extra flow blocks.
+//
+// Early exits from loops, such as a return or a break out of two loops, are
+// handled before falling back on the structurizer. Each loop, innermost
+// first, gets a single exit block, and its exiting edges record in a phi
+// which exit they were taking:
+//   inner.exit:
+//     %exit.id = phi i32 [ 0, %inner ], [ 1, %inner.latch ]
+//     %0 = icmp eq i32 %exit.id, 0
+//     br i1 %0, label %outer.exit, label %outer.latch
+// A break out of two loops thus goes through the exit block of each. An exit
+// leaving every loop that only returns gets its own return, so that it needs
+// no merge. This is done on a copy of the function, which replaces it when
+// the result is structured. It costs a block per loop and per extra exit,
+// fewer than the flow blocks and predicate phis of the structurizer.
+
+#include <deque>
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+
+#include "ComputeStructuredOrder.h"
+#include "Passes.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "SelectiveStructurizeCFG"
+
+namespace {
+struct SelectiveStructurizeCFGPass : public ModulePass {
+  static char ID;
+  SelectiveStructurizeCFGPass() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override;
+
+private:
+  // Returns true if the control flow of |F| is already structured.
+  static bool IsStructured(Function &F);
+
+  // Gives the loops of a copy of |F| single exits and, if that makes the copy
+  // structured, replaces the body of |F| by it. Returns true if it did.
+  static bool StructurizeLoopExits(Function &F);
+
+  // Redirects the exiting edges of |L| to a new exit block, which branches to
+  // the original exits.
+  static void UnifyExits(Loop *L);
+
+  // Gives a new block to the edges to a block that would otherwise be the
+  // merge of several headers.
+  static void SplitSharedMerges(Function &F);
+};
+
+// Returns true if |L| needs UnifyExits to have a single exit dominated by its
+// header.
+bool NeedsUnifiedExit(Loop *L, const DominatorTree &DT) {
+  SmallVector<BasicBlock *, 4> exits;
+  L->getUniqueExitBlocks(exits);
+  return exits.size() > 1 ||
+         (exits.size() == 1 && !DT.dominates(L->getHeader(), exits[0]));
+}
+
+// Returns the exit and latch blocks of the loops containing |BB|, the targets
+// of its breaks and continues.
+DenseSet<BasicBlock *> EnclosingLoopTargets(BasicBlock *BB,
+                                            const LoopInfo &LI) {
+  DenseSet<BasicBlock *> targets;
+  for (auto *L = LI.getLoopFor(BB); L; L = L->getParentLoop()) {
+    SmallVector<BasicBlock *, 4> exits;
+    L->getExitBlocks(exits);
+    targets.insert(exits.begin(), exits.end());
+    if (auto *latch = L->getLoopLatch())
+      targets.insert(latch);
+  }
+  return targets;
+}
+
+// Returns true if |false_bb| can be the merge of the selection headed by
+// |header| even though it does not post-dominate it: the blocks reached from
+// |true_bb| before |false_bb| are only entered from |header|, and they leave
+// only to |false_bb|, by breaking or continuing, or by returning.
+bool ReachesOnlyMerge(BasicBlock *header, BasicBlock *true_bb,
+                      BasicBlock *false_bb, const DominatorTree &DT,
+                      const LoopInfo &LI) {
+  auto stops = EnclosingLoopTargets(header, LI);
+  stops.insert(false_bb);
+  if (stops.count(true_bb))
+    return true;
+
+  DenseSet<BasicBlock *> construct;
+  SmallVector<BasicBlock *, 8> worklist{true_bb};
+  construct.insert(true_bb);
+  while (!worklist.empty()) {
+    auto *BB = worklist.pop_back_val();
+    if (!DT.dominates(header, BB))
+      return false;
+    for (auto *succ : successors(BB)) {
+      if (!stops.count(succ) && construct.insert(succ).second)
+        worklist.push_back(succ);
+    }
+  }
+
+  for (auto *BB : construct) {
+    for (auto *pred : predecessors(BB)) {
+      if (pred != header && !construct.count(pred))
+        return false;
+    }
+  }
+  return true;
+}
+
+// If |BB| only returns, possibly a phi, and has other predecessors than
+// |Pred|, gives |Pred| its own return instead.
+void OwnReturn(BasicBlock *Pred, BasicBlock *BB) {
+  auto *Ret = dyn_cast<ReturnInst>(BB->getTerminator());
+  if (!Ret || BB->getSinglePredecessor())
+    return;
+  Value *V = Ret->getReturnValue();
+  for (auto &I : *BB) {
+    if (&I != Ret && (&I != V || !isa<PHINode>(I) || !I.hasOneUse()))
+      return;
+  }
+  if (auto *Phi = dyn_cast_or_null<PHINode>(V)) {
+    if (Phi->getParent() == BB)
+      V = Phi->getIncomingValueForBlock(Pred);
+  }
+
+  auto &C = BB->getContext();
+  BB->removePredecessor(Pred);
+  auto *Branch = cast<BranchInst>(Pred->getTerminator());
+  if (Branch->isUnconditional()) {
+    ReturnInst::Create(C, V, Branch);
+    Branch->eraseFromParent();
+  } else {
+    auto *NewBB = BasicBlock::Create(C, BB->getName(), BB->getParent(), BB);
+    ReturnInst::Create(C, V, NewBB);
+    Branch->replaceUsesOfWith(BB, NewBB);
+  }
+}
+} // namespace
+
+char SelectiveStructurizeCFGPass::ID = 0;
+INITIALIZE_PASS(SelectiveStructurizeCFGPass, "SelectiveStructurizeCFG",
+                "Selective Structurize CFG Pass", false, false)
+
+namespace clspv {
+ModulePass *createSelectiveStructurizeCFGPass() {
+  return new SelectiveStructurizeCFGPass();
+}
+} // namespace clspv
+
+bool SelectiveStructurizeCFGPass::runOnModule(Module &M) {
+  bool Changed = false;
+  SmallVector<Function *, 8> unstructured;
+  for (auto &F : M) {
+    if (F.isDeclaration() || IsStructured(F))
+      continue;
+    if (StructurizeLoopExits(F))
+      Changed = true;
+    else
+      unstructured.push_back(&F);
+  }
+  if (unstructured.empty())
+    return Changed;
+
+  legacy::FunctionPassManager FPM(&M);
+  FPM.add(createStructurizeCFGPass(false));
+  FPM.doInitialization();
+  for (auto *F : unstructured) {
+    Changed |= FPM.run(*F);
+  }
+  Changed |= FPM.doFinalization();
+  return Changed;
+}
+
+bool SelectiveStructurizeCFGPass::IsStructured(Function &F) {
+  DominatorTree DT(F);
+  PostDominatorTree PDT(F);
+  LoopInfo LI(DT);
+
+  // Every merge block belongs to a single header.
+  DenseSet<BasicBlock *> merges;
+  // Loop exits and latches, the targets of breaks and continues.
+  DenseSet<BasicBlock *> loop_targets;
+  for (auto *L : LI.getLoopsInPreorder()) {
+    auto *header = L->getHeader();
+    auto *latch = L->getLoopLatch();
+    auto *exit = L->getExitBlock();
+    if (!latch || !exit || !DT.dominates(header, exit) ||
+        !merges.insert(exit).second)
+      return false;
+
+    // The header cannot also be a selection header, so a conditional branch
+    // in it must break or continue.
+    auto *branch = dyn_cast<BranchInst>(header->getTerminator());
+    if (header != latch && branch && branch->isConditional()) {
+      auto *true_bb = branch->getSuccessor(0);
+      auto *false_bb = branch->getSuccessor(1);
+      if (true_bb != exit && true_bb != latch && false_bb != exit &&
+          false_bb != latch)
+        return false;
+    }
+
+    loop_targets.insert(exit);
+    loop_targets.insert(latch);
+  }
+
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  DenseMap<BasicBlock *, unsigned> rpo_index;
+  for (auto *BB : RPOT) {
+    rpo_index[BB] = rpo_index.size();
+  }
+
+  for (auto *BB : RPOT) {
+    auto *terminator = BB->getTerminator();
+    if (!isa<BranchInst>(terminator) && !isa<ReturnInst>(terminator) &&
+        !isa<UnreachableInst>(terminator))
+      return false;
+
+    // Every edge to an earlier block must be the back-edge of a natural
+    // loop; anything else is irreducible.
+    for (auto *succ : successors(BB)) {
+      if (rpo_index[succ] <= rpo_index[BB] &&
+          (!DT.dominates(succ, BB) || !LI.isLoopHeader(succ) ||
+           LI.getLoopFor(succ)->getLoopLatch() != BB))
+        return false;
+    }
+  }
+
+  // The producer assigns the merges in structured order.
+  std::deque<BasicBlock *> order;
+  DenseSet<BasicBlock *> visited;
+  clspv::ComputeStructuredOrder(&F.front(), &DT, LI, &order, &visited);
+  for (auto *BB : order) {
+    auto *branch = dyn_cast<BranchInst>(BB->getTerminator());
+    if (!branch || !branch->isConditional() || LI.isLoopHeader(BB))
+      continue;
+
+    // Breaks, continues and back-edges need no selection merge.
+    auto *true_bb = branch->getSuccessor(0);
+    auto *false_bb = branch->getSuccessor(1);
+    if (loop_targets.count(true_bb) || loop_targets.count(false_bb))
+      continue;
+
+    // The producer uses the false successor as the merge of the selection.
+    // Either it post-dominates the header, or the other side can only
+    // return before reaching it.
+    auto *node = PDT.getNode(BB);
+    auto *ipdom = node && node->getIDom() ? node->getIDom()->getBlock()
+                                          : nullptr;
+    if (true_bb == false_bb || !DT.dominates(BB, false_bb) ||
+        !merges.insert(false_bb).second ||
+        (ipdom != false_bb &&
+         !ReachesOnlyMerge(BB, true_bb, false_bb, DT, LI)))
+      return false;
+  }
+
+  return true;
+}
+
+bool SelectiveStructurizeCFGPass::StructurizeLoopExits(Function &F) {
+  // The copy would get its own debug info scope.
+  if (F.getSubprogram())
+    return false;
+
+  unsigned NumLoops = 0;
+  {
+    DominatorTree DT(F);
+    LoopInfo LI(DT);
+    NumLoops = LI.getLoopsInPreorder().size();
+  }
+  if (NumLoops == 0)
+    return false;
+
+  ValueToValueMapTy VMap;
+  auto *Copy = CloneFunction(&F, VMap);
+
+  // Inner loops first, as their new exit blocks can be exiting blocks of the
+  // outer loops. Each loop is handled once.
+  for (unsigned i = 0; i < NumLoops; ++i) {
+    DominatorTree DT(*Copy);
+    LoopInfo LI(DT);
+    Loop *Target = nullptr;
+    auto Loops = LI.getLoopsInPreorder();
+    for (auto it = Loops.rbegin(); it != Loops.rend() && !Target; ++it) {
+      if (NeedsUnifiedExit(*it, DT))
+        Target = *it;
+    }
+    if (!Target)
+      break;
+    // The values used after the loop go through phis in the exits, which
+    // UnifyExits moves to the new exit block.
+    formLCSSA(*Target, DT, &LI, nullptr);
+    UnifyExits(Target);
+  }
+  SplitSharedMerges(*Copy);
+
+  if (!IsStructured(*Copy)) {
+    Copy->eraseFromParent();
+    return false;
+  }
+
+  // Replace the body of |F| by the one of the copy, keeping the function and
+  // its metadata.
+  for (auto &BB : F) {
+    BB.dropAllReferences();
+  }
+  while (!F.empty()) {
+    F.begin()->eraseFromParent();
+  }
+  F.getBasicBlockList().splice(F.end(), Copy->getBasicBlockList());
+  for (auto &Arg : Copy->args()) {
+    Arg.replaceAllUsesWith(F.getArg(Arg.getArgNo()));
+  }
+  Copy->eraseFromParent();
+  return true;
+}
+
+void SelectiveStructurizeCFGPass::UnifyExits(Loop *L) {
+  SmallVector<BasicBlock *, 4> exits;
+  L->getUniqueExitBlocks(exits);
+
+  // The exit of the latch, or else of the header, is the last one, reached
+  // without a test, so that it is the merge of the other exits when they
+  // stay in the enclosing loop.
+  for (auto *BB : {L->getLoopLatch(), L->getHeader()}) {
+    if (!BB)
+      continue;
+    auto it = find_if(successors(BB),
+                      [L](BasicBlock *succ) { return !L->contains(succ); });
+    if (it != succ_end(BB)) {
+      auto *natural = *it;
+      exits.erase(find(exits, natural));
+      exits.push_back(natural);
+      break;
+    }
+  }
+
+  // The exiting edges, with the index of their exit.
+  SmallVector<std::pair<BasicBlock *, unsigned>, 8> edges;
+  for (auto *BB : L->blocks()) {
+    for (auto *succ : successors(BB)) {
+      auto it = find(exits, succ);
+      std::pair<BasicBlock *, unsigned> edge{BB, unsigned(it - exits.begin())};
+      if (it != exits.end() && !is_contained(edges, edge))
+        edges.push_back(edge);
+    }
+  }
+
+  auto *F = L->getHeader()->getParent();
+  auto &C = F->getContext();
+  auto *Exit = BasicBlock::Create(C, "loop.exit", F, exits.front());
+  IRBuilder<> Builder(Exit);
+  PHINode *Id = nullptr;
+  if (exits.size() > 1) {
+    Id = Builder.CreatePHI(Builder.getInt32Ty(), edges.size(), "exit.id");
+    for (auto &edge : edges) {
+      Id->addIncoming(Builder.getInt32(edge.second), edge.first);
+    }
+  }
+
+  // The phis of the exits take the values of the exiting edges from phis of
+  // the new exit block.
+  DenseMap<PHINode *, PHINode *> moved;
+  for (unsigned i = 0; i < exits.size(); ++i) {
+    for (auto &Phi : exits[i]->phis()) {
+      auto *NewPhi =
+          Builder.CreatePHI(Phi.getType(), edges.size(), Phi.getName());
+      for (auto &edge : edges) {
+        NewPhi->addIncoming(edge.second == i
+                                ? Phi.getIncomingValueForBlock(edge.first)
+                                : UndefValue::get(Phi.getType()),
+                            edge.first);
+      }
+      moved[&Phi] = NewPhi;
+    }
+  }
+  for (auto &edge : edges) {
+    edge.first->getTerminator()->replaceUsesOfWith(exits[edge.second], Exit);
+  }
+
+  // Dispatch on the exit taken, the last one without a test.
+  SmallVector<BasicBlock *, 4> preds;
+  auto *Dispatch = Exit;
+  for (unsigned i = 0; i + 1 < exits.size(); ++i) {
+    auto *Next = exits.back();
+    if (i + 2 < exits.size())
+      Next = BasicBlock::Create(C, "loop.exit.dispatch", F, exits.front());
+    Builder.SetInsertPoint(Dispatch);
+    Builder.CreateCondBr(Builder.CreateICmpEQ(Id, Builder.getInt32(i)),
+                         exits[i], Next);
+    preds.push_back(Dispatch);
+    if (i + 2 < exits.size())
+      Dispatch = Next;
+  }
+  if (exits.size() == 1) {
+    Builder.CreateBr(exits.front());
+  }
+  preds.push_back(Dispatch);
+
+  for (unsigned i = 0; i < exits.size(); ++i) {
+    for (auto &Phi : exits[i]->phis()) {
+      for (auto &edge : edges) {
+        if (edge.second == i)
+          Phi.removeIncomingValue(edge.first, false);
+      }
+      Phi.addIncoming(moved[&Phi], preds[i]);
+    }
+  }
+
+  // An exit leaving every loop that only returns needs no merge once it has
+  // its own return.
+  if (L->getParentLoop())
+    return;
+  for (unsigned i = 0; i + 1 < exits.size(); ++i) {
+    auto *branch = dyn_cast<BranchInst>(exits[i]->getTerminator());
+    if (branch && branch->isUnconditional() &&
+        exits[i]->getSinglePredecessor())
+      OwnReturn(exits[i], branch->getSuccessor(0));
+    else
+      OwnReturn(preds[i], exits[i]);
+  }
+}
+
+void SelectiveStructurizeCFGPass::SplitSharedMerges(Function &F) {
+  DominatorTree DT(F);
+  LoopInfo LI(DT);
+
+  DenseSet<BasicBlock *> merges;
+  DenseSet<BasicBlock *> loop_targets;
+  for (auto *L : LI.getLoopsInPreorder()) {
+    auto *exit = L->getExitBlock();
+    auto *latch = L->getLoopLatch();
+    // IsStructured rejects such loops.
+    if (!exit || !latch)
+      return;
+    merges.insert(exit);
+    loop_targets.insert(exit);
+    loop_targets.insert(latch);
+  }
+
+  // Claim the merges in the order the producer does.
+  std::deque<BasicBlock *> order;
+  DenseSet<BasicBlock *> visited;
+  clspv::ComputeStructuredOrder(&F.front(), &DT, LI, &order, &visited);
+  SmallVector<BranchInst *, 4> shared;
+  for (auto *BB : order) {
+    auto *branch = dyn_cast<BranchInst>(BB->getTerminator());
+    if (!branch || !branch->isConditional() || LI.isLoopHeader(BB))
+      continue;
+    auto *true_bb = branch->getSuccessor(0);
+    auto *false_bb = branch->getSuccessor(1);
+    if (loop_targets.count(true_bb) || loop_targets.count(false_bb) ||
+        true_bb == false_bb)
+      continue;
+    if (!merges.insert(false_bb).second)
+      shared.push_back(branch);
+  }
+
+  for (auto *branch : shared) {
+    auto *BB = branch->getParent();
+    auto *false_bb = branch->getSuccessor(1);
+    auto *Merge = BasicBlock::Create(F.getContext(), "merge", &F, false_bb);
+    BranchInst::Create(false_bb, Merge);
+    for (auto &Phi : false_bb->phis()) {
+      Phi.replaceIncomingBlockWith(BB, Merge);
+    }
+    branch->setSuccessor(1, Merge);
+  }
+}
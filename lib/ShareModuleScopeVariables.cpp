@@ -14,8 +14,12 @@
 
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/UniqueVector.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
@@ -27,8 +31,11 @@
 #include "clspv/Option.h"
 
 #include "ArgKind.h"
+#include "Builtins.h"
 #include "Passes.h"
 
+#include "spirv/unified1/spirv.hpp"
+
 using namespace llvm;
 
 namespace {
@@ -66,6 +73,25 @@ private:
   bool HasSharedEntryPoints(const DenseSet<Function *> &user_functions,
                             const UniqueVector<Function *> &other_entry_points);
 
+  // Attempts to share module scope variables of the same type that are only
+  // used by one kernel, when a work-group barrier separates all the accesses
+  // to one variable from all the accesses to the other. Returns true if any
+  // variables are shared.
+  bool ShareLocalLifetimes(Module &M);
+
+  // Collects the instructions accessing |value|, directly or through derived
+  // pointers, into |accesses|. Returns false if |value| is used outside of
+  // |kernel| or escapes through memory.
+  bool CollectAccesses(Value *value, Function *kernel,
+                       SmallPtrSetImpl<Instruction *> *accesses);
+
+  // Returns true if one of |barriers| dominates all of the |after| accesses
+  // and cannot reach any of the |before| accesses.
+  bool SeparatedByBarrier(const SmallPtrSetImpl<Instruction *> &before,
+                          const SmallPtrSetImpl<Instruction *> &after,
+                          ArrayRef<Instruction *> barriers,
+                          const DominatorTree &DT);
+
   EntryPointMap function_to_entry_points_;
 };
 
@@ -87,8 +113,13 @@ bool ShareModuleScopeVariablesPass::runOnModule(Module &M) {
   bool Changed = false;
 
   if (clspv::Option::ShareModuleScopeVariables()) {
+    // Packing within kernels first leaves fewer variables to share across
+    // kernels.
+    if (clspv::Option::PackLocalMemory()) {
+      Changed |= ShareLocalLifetimes(M);
+    }
     MapEntryPoints(M);
-    Changed = ShareModuleScopeVariables(M);
+    Changed |= ShareModuleScopeVariables(M);
   }
 
   return Changed;
@@ -214,4 +245,173 @@ bool ShareModuleScopeVariablesPass::HasSharedEntryPoints(
 
   return false;
 }
+
+bool ShareModuleScopeVariablesPass::ShareLocalLifetimes(Module &M) {
+  // Group the variables by the kernel using them.
+  struct Candidate {
+    GlobalVariable *var;
+    SmallPtrSet<Instruction *, 16> accesses;
+  };
+  DenseMap<Function *, SmallVector<Candidate, 8>> kernel_candidates;
+  for (auto &G : M.globals()) {
+    if (!clspv::IsLocalPtr(G.getType()) || G.user_empty())
+      continue;
+
+    auto *first = dyn_cast<Instruction>(*G.user_begin());
+    if (auto *CE = dyn_cast<ConstantExpr>(*G.user_begin())) {
+      if (!CE->user_empty())
+        first = dyn_cast<Instruction>(*CE->user_begin());
+    }
+    if (!first)
+      continue;
+    Function *kernel = first->getFunction();
+    if (kernel->getCallingConv() != CallingConv::SPIR_KERNEL)
+      continue;
+
+    Candidate candidate{&G, {}};
+    if (CollectAccesses(&G, kernel, &candidate.accesses))
+      kernel_candidates[kernel].push_back(std::move(candidate));
+  }
+
+  bool Changed = false;
+  SmallVector<GlobalVariable *, 8> dead_globals;
+  for (auto &entry : kernel_candidates) {
+    Function *kernel = entry.first;
+    auto &candidates = entry.second;
+    if (candidates.size() < 2)
+      continue;
+
+    SmallVector<Instruction *, 8> barriers;
+    for (auto &BB : *kernel) {
+      for (auto &I : BB) {
+        auto *call = dyn_cast<CallInst>(&I);
+        if (!call || clspv::Builtins::Lookup(call->getCalledFunction())
+                             .getType() != clspv::Builtins::kSpirvOp)
+          continue;
+        auto *opcode = dyn_cast<ConstantInt>(call->getArgOperand(0));
+        auto *scope = dyn_cast<ConstantInt>(call->getArgOperand(1));
+        auto *semantics = dyn_cast<ConstantInt>(call->getArgOperand(3));
+        if (opcode && opcode->getZExtValue() == spv::OpControlBarrier &&
+            scope && scope->getZExtValue() == spv::ScopeWorkgroup &&
+            semantics &&
+            (semantics->getZExtValue() &
+             spv::MemorySemanticsWorkgroupMemoryMask)) {
+          barriers.push_back(call);
+        }
+      }
+    }
+    if (barriers.empty())
+      continue;
+
+    DominatorTree DT(*kernel);
+    for (unsigned i = 0; i < candidates.size(); ++i) {
+      auto &kept = candidates[i];
+      if (!kept.var)
+        continue;
+      for (unsigned j = i + 1; j < candidates.size(); ++j) {
+        auto &other = candidates[j];
+        if (!other.var || other.var->getType() != kept.var->getType())
+          continue;
+        if (!SeparatedByBarrier(kept.accesses, other.accesses, barriers, DT) &&
+            !SeparatedByBarrier(other.accesses, kept.accesses, barriers, DT))
+          continue;
+
+        if (ShowSMSV) {
+          outs() << "SMSV: Combining module scope variables in "
+                 << kernel->getName() << "\n"
+                 << "  " << *kept.var << "\n"
+                 << "  " << *other.var << "\n";
+        }
+        other.var->replaceAllUsesWith(kept.var);
+        // The shared variable now lives as long as both.
+        kept.accesses.insert(other.accesses.begin(), other.accesses.end());
+        dead_globals.push_back(other.var);
+        other.var = nullptr;
+        Changed = true;
+      }
+    }
+  }
+
+  for (auto GV : dead_globals) {
+    GV->eraseFromParent();
+  }
+
+  return Changed;
+}
+
+bool ShareModuleScopeVariablesPass::CollectAccesses(
+    Value *value, Function *kernel, SmallPtrSetImpl<Instruction *> *accesses) {
+  for (auto *user : value->users()) {
+    if (auto *CE = dyn_cast<ConstantExpr>(user)) {
+      if (!CollectAccesses(CE, kernel, accesses))
+        return false;
+      continue;
+    }
+
+    auto *I = dyn_cast<Instruction>(user);
+    if (!I || I->getFunction() != kernel)
+      return false;
+    if (auto *store = dyn_cast<StoreInst>(I)) {
+      if (store->getValueOperand() == value)
+        return false;
+    }
+    if (isa<PtrToIntInst>(I))
+      return false;
+    if (!accesses->insert(I).second)
+      continue;
+
+    // Follow the pointers derived from |value|.
+    if (isa<GetElementPtrInst>(I) || isa<CastInst>(I) || isa<PHINode>(I) ||
+        isa<SelectInst>(I)) {
+      if (!CollectAccesses(I, kernel, accesses))
+        return false;
+    }
+  }
+
+  return true;
+}
+
+bool ShareModuleScopeVariablesPass::SeparatedByBarrier(
+    const SmallPtrSetImpl<Instruction *> &before,
+    const SmallPtrSetImpl<Instruction *> &after,
+    ArrayRef<Instruction *> barriers, const DominatorTree &DT) {
+  for (auto *barrier : barriers) {
+    bool dominates_after = true;
+    for (auto *I : after) {
+      if (!DT.dominates(barrier, I)) {
+        dominates_after = false;
+        break;
+      }
+    }
+    if (!dominates_after)
+      continue;
+
+    // Find the blocks that can execute after the barrier. Its own block only
+    // counts as a whole if it is in a loop.
+    BasicBlock *barrier_block = barrier->getParent();
+    SmallPtrSet<BasicBlock *, 16> reachable;
+    SmallVector<BasicBlock *, 16> work_list(succ_begin(barrier_block),
+                                            succ_end(barrier_block));
+    while (!work_list.empty()) {
+      BasicBlock *BB = work_list.pop_back_val();
+      if (!reachable.insert(BB).second)
+        continue;
+      work_list.append(succ_begin(BB), succ_end(BB));
+    }
+
+    bool reaches_before = false;
+    for (auto *I : before) {
+      BasicBlock *BB = I->getParent();
+      if (reachable.count(BB) ||
+          (BB == barrier_block && barrier->comesBefore(I))) {
+        reaches_before = true;
+        break;
+      }
+    }
+    if (!reaches_before)
+      return true;
+  }
+
+  return false;
+}
 } // namespace
@@ -31,10 +31,14 @@ struct SimplifyPointerBitcastPass : public ModulePass {
 
   bool runOnModule(Module &M) override;
 
-  bool runOnTrivialBitcast(Module &M) const;
-  bool runOnBitcastFromBitcast(Module &M) const;
-  bool runOnBitcastFromGEP(Module &M) const;
-  bool runOnGEPFromGEP(Module &M) const;
+  // Returns true if any of the simplifications below applies to an
+  // instruction of |F|.
+  bool HasCandidates(Function &F) const;
+
+  bool runOnTrivialBitcast(Function &F) const;
+  bool runOnBitcastFromBitcast(Function &F) const;
+  bool runOnBitcastFromGEP(Function &F) const;
+  bool runOnGEPFromGEP(Function &F) const;
 };
 } // namespace
 
@@ -51,36 +55,63 @@ llvm::ModulePass *createSimplifyPointerBitcastPass() {
 bool SimplifyPointerBitcastPass::runOnModule(Module &M) {
   bool Changed = false;
 
-  // Loop through our individual simplification passes until they stop changing
-  // things.
-  for (bool localChanged = true; localChanged; Changed |= localChanged) {
-    localChanged = false;
-
-    localChanged |= runOnTrivialBitcast(M);
-    localChanged |= runOnBitcastFromGEP(M);
-    localChanged |= runOnBitcastFromBitcast(M);
-    localChanged |= runOnGEPFromGEP(M);
+  // The simplifications only rewrite instructions within a function, so each
+  // function reaches its fixed point independently. Functions with nothing to
+  // simplify, which is most of them once the pass has run earlier in the
+  // pipeline, cost a single walk.
+  for (Function &F : M) {
+    if (!HasCandidates(F))
+      continue;
+
+    // Loop through our individual simplification passes until they stop
+    // changing things.
+    for (bool localChanged = true; localChanged; Changed |= localChanged) {
+      localChanged = false;
+
+      localChanged |= runOnTrivialBitcast(F);
+      localChanged |= runOnBitcastFromGEP(F);
+      localChanged |= runOnBitcastFromBitcast(F);
+      localChanged |= runOnGEPFromGEP(F);
+    }
   }
 
   return Changed;
 }
 
-bool SimplifyPointerBitcastPass::runOnTrivialBitcast(Module &M) const {
+bool SimplifyPointerBitcastPass::HasCandidates(Function &F) const {
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      if (auto Bitcast = dyn_cast<BitCastInst>(&I)) {
+        auto Source = Bitcast->getOperand(0);
+        if (Source->getType() == Bitcast->getType() ||
+            isa<BitCastInst>(Source) || isa<GetElementPtrInst>(Source)) {
+          return true;
+        }
+      } else if (auto GEP = dyn_cast<GetElementPtrInst>(&I)) {
+        if (isa<GetElementPtrInst>(GEP->getPointerOperand())) {
+          return true;
+        }
+      }
+    }
+  }
+
+  return false;
+}
+
+bool SimplifyPointerBitcastPass::runOnTrivialBitcast(Function &F) const {
   // Remove things like:
   //  bitcast i32 addrspace(1)* %ptr to i32 addrspace(1)*
 
   SmallVector<BitCastInst *, 16> WorkList;
-  for (Function &F : M) {
-    for (BasicBlock &BB : F) {
-      for (Instruction &I : BB) {
-        // If we have a bitcast instruction...
-        if (auto Bitcast = dyn_cast<BitCastInst>(&I)) {
-          // ... whose source type is the same as the destination type.
-          auto Source = Bitcast->getOperand(0);
-          if (Source->getType() == Bitcast->getType()) {
-            // ... record the bitcast as something we need to process.
-            WorkList.push_back(Bitcast);
-          }
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      // If we have a bitcast instruction...
+      if (auto Bitcast = dyn_cast<BitCastInst>(&I)) {
+        // ... whose source type is the same as the destination type.
+        auto Source = Bitcast->getOperand(0);
+        if (Source->getType() == Bitcast->getType()) {
+          // ... record the bitcast as something we need to process.
+          WorkList.push_back(Bitcast);
         }
       }
     }
@@ -107,25 +138,23 @@ bool SimplifyPointerBitcastPass::runOnTrivialBitcast(Module &M) const {
   return Changed;
 }
 
-bool SimplifyPointerBitcastPass::runOnBitcastFromGEP(Module &M) const {
+bool SimplifyPointerBitcastPass::runOnBitcastFromGEP(Function &F) const {
   SmallVector<BitCastInst *, 16> WorkList;
-  for (Function &F : M) {
-    for (BasicBlock &BB : F) {
-      for (Instruction &I : BB) {
-        // If we have a bitcast instruction...
-        if (auto Bitcast = dyn_cast<BitCastInst>(&I)) {
-          // ... whose source is a GEP instruction...
-          if (auto GEP = dyn_cast<GetElementPtrInst>(Bitcast->getOperand(0))) {
-            // ... where the GEP is retrieving an element of the same type...
-            if (GEP->getSourceElementType() == GEP->getResultElementType()) {
-              auto GEPTy = GEP->getResultElementType();
-              auto BitcastTy = Bitcast->getType()->getPointerElementType();
-              // ... and the types have a known compile time size...
-              if ((0 != GEPTy->getPrimitiveSizeInBits()) &&
-                  (0 != BitcastTy->getPrimitiveSizeInBits())) {
-                // ... record the bitcast as something we need to process.
-                WorkList.push_back(Bitcast);
-              }
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      // If we have a bitcast instruction...
+      if (auto Bitcast = dyn_cast<BitCastInst>(&I)) {
+        // ... whose source is a GEP instruction...
+        if (auto GEP = dyn_cast<GetElementPtrInst>(Bitcast->getOperand(0))) {
+          // ... where the GEP is retrieving an element of the same type...
+          if (GEP->getSourceElementType() == GEP->getResultElementType()) {
+            auto GEPTy = GEP->getResultElementType();
+            auto BitcastTy = Bitcast->getType()->getPointerElementType();
+            // ... and the types have a known compile time size...
+            if ((0 != GEPTy->getPrimitiveSizeInBits()) &&
+                (0 != BitcastTy->getPrimitiveSizeInBits())) {
+              // ... record the bitcast as something we need to process.
+              WorkList.push_back(Bitcast);
             }
           }
         }
@@ -190,18 +219,16 @@ bool SimplifyPointerBitcastPass::runOnBitcastFromGEP(Module &M) const {
   return Changed;
 }
 
-bool SimplifyPointerBitcastPass::runOnBitcastFromBitcast(Module &M) const {
+bool SimplifyPointerBitcastPass::runOnBitcastFromBitcast(Function &F) const {
   SmallVector<BitCastInst *, 16> WorkList;
-  for (Function &F : M) {
-    for (BasicBlock &BB : F) {
-      for (Instruction &I : BB) {
-        // If we have a bitcast instruction...
-        if (auto Bitcast = dyn_cast<BitCastInst>(&I)) {
-          // ... whose source is a bitcast instruction...
-          if (isa<BitCastInst>(Bitcast->getOperand(0))) {
-            // ... record the bitcast as something we need to process.
-            WorkList.push_back(Bitcast);
-          }
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      // If we have a bitcast instruction...
+      if (auto Bitcast = dyn_cast<BitCastInst>(&I)) {
+        // ... whose source is a bitcast instruction...
+        if (isa<BitCastInst>(Bitcast->getOperand(0))) {
+          // ... record the bitcast as something we need to process.
+          WorkList.push_back(Bitcast);
         }
       }
     }
@@ -237,18 +264,16 @@ bool SimplifyPointerBitcastPass::runOnBitcastFromBitcast(Module &M) const {
   return Changed;
 }
 
-bool SimplifyPointerBitcastPass::runOnGEPFromGEP(Module &M) const {
+bool SimplifyPointerBitcastPass::runOnGEPFromGEP(Function &F) const {
   SmallVector<GetElementPtrInst *, 16> WorkList;
-  for (Function &F : M) {
-    for (BasicBlock &BB : F) {
-      for (Instruction &I : BB) {
-        // If we have a GEP instruction...
-        if (auto GEP = dyn_cast<GetElementPtrInst>(&I)) {
-          // ... whose operand is also a GEP instruction...
-          if (isa<GetElementPtrInst>(GEP->getPointerOperand())) {
-            // ... record the GEP as something we need to process.
-            WorkList.push_back(GEP);
-          }
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      // If we have a GEP instruction...
+      if (auto GEP = dyn_cast<GetElementPtrInst>(&I)) {
+        // ... whose operand is also a GEP instruction...
+        if (isa<GetElementPtrInst>(GEP->getPointerOperand())) {
+          // ... record the GEP as something we need to process.
+          WorkList.push_back(GEP);
         }
       }
     }
@@ -0,0 +1,96 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "SizeOptimizer.h"
+
+#include <functional>
+#include <string>
+
+#include "llvm/Support/raw_ostream.h"
+
+#include "spirv-tools/optimizer.hpp"
+
+#include "clspv/Option.h"
+
+namespace {
+
+// Returns the SPIRV-Tools environment of the SPIR-V version being produced.
+spv_target_env TargetEnv() {
+  switch (clspv::Option::SpvVersion()) {
+  case clspv::Option::SPIRVVersion::SPIRV_1_0:
+    return SPV_ENV_VULKAN_1_0;
+  case clspv::Option::SPIRVVersion::SPIRV_1_3:
+    return SPV_ENV_VULKAN_1_1;
+  case clspv::Option::SPIRVVersion::SPIRV_1_5:
+    return SPV_ENV_VULKAN_1_2;
+  }
+  return SPV_ENV_VULKAN_1_2;
+}
+
+// Runs the passes |register_passes| adds to an optimizer over |words|. On
+// failure an error naming |what| is printed, with the messages of the
+// optimizer, and |words| is left unchanged.
+bool RunOptimizer(std::vector<uint32_t> *words, const char *what,
+                  const std::function<void(spvtools::Optimizer &)>
+                      &register_passes) {
+  spvtools::Optimizer optimizer(TargetEnv());
+  std::string message;
+  optimizer.SetMessageConsumer(
+      [&message](spv_message_level_t level, const char *,
+                 const spv_position_t &, const char *text) {
+        if (level <= SPV_MSG_ERROR) {
+          message += text;
+          message += '\n';
+        }
+      });
+  register_passes(optimizer);
+
+  std::vector<uint32_t> optimized;
+  spvtools::OptimizerOptions options;
+  options.set_run_validator(false);
+  if (!optimizer.Run(words->data(), words->size(), &optimized, options)) {
+    llvm::errs() << "error: SPIR-V " << what << " failed\n" << message;
+    return false;
+  }
+
+  words->swap(optimized);
+  return true;
+}
+
+} // namespace
+
+namespace clspv {
+
+bool OptimizeSPIRVForSize(std::vector<uint32_t> *words) {
+  // Only passes that cannot drop the embedded reflection instructions, which
+  // refer to kernels and arguments by ID and string.
+  return RunOptimizer(
+      words, "size optimization", [](spvtools::Optimizer &optimizer) {
+        optimizer.RegisterPass(spvtools::CreateRemoveDuplicatesPass())
+            .RegisterPass(spvtools::CreateEliminateDeadFunctionsPass())
+            .RegisterPass(spvtools::CreateDeadVariableEliminationPass())
+            .RegisterPass(spvtools::CreateEliminateDeadConstantPass())
+            .RegisterPass(spvtools::CreateCompactIdsPass());
+      });
+}
+
+bool CanonicalizeSPIRVIds(std::vector<uint32_t> *words) {
+  // CompactIds numbers the IDs in the order they first appear in the module.
+  return RunOptimizer(
+      words, "ID canonicalization", [](spvtools::Optimizer &optimizer) {
+        optimizer.RegisterPass(spvtools::CreateCompactIdsPass());
+      });
+}
+
+} // namespace clspv
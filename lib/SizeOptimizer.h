@@ -0,0 +1,36 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_LIB_SIZE_OPTIMIZER_H_
+#define CLSPV_LIB_SIZE_OPTIMIZER_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace clspv {
+
+// Shrinks the SPIR-V module in |words| in place: duplicate types and
+// decorations are merged, unused functions, global variables and constants
+// are removed, and IDs are renumbered compactly.  On failure an error is
+// printed, |words| is left unchanged and false is returned.
+bool OptimizeSPIRVForSize(std::vector<uint32_t> *words);
+
+// Renumbers the IDs of the SPIR-V module in |words| in place in the order they
+// first appear, so that the module does not depend on the order in which its
+// IDs were allocated.  Fails like OptimizeSPIRVForSize.
+bool CanonicalizeSPIRVIds(std::vector<uint32_t> *words);
+
+} // namespace clspv
+
+#endif // CLSPV_LIB_SIZE_OPTIMIZER_H_
@@ -60,6 +60,8 @@ const char *GetSpecConstantName(SpecConstant kind) {
     return "global_offset_y";
   case SpecConstant::kGlobalOffsetZ:
     return "global_offset_z";
+  case SpecConstant::kPodArgument:
+    return "pod_argument";
   }
   llvm::errs() << "Unhandled case in clspv::GetSpecConstantName: " << int(kind)
                << "\n";
@@ -83,6 +85,8 @@ SpecConstant GetSpecConstantFromName(const std::string &name) {
     return SpecConstant::kGlobalOffsetY;
   else if (name == "global_offset_z")
     return SpecConstant::kGlobalOffsetZ;
+  else if (name == "pod_argument")
+    return SpecConstant::kPodArgument;
 
   llvm::errs() << "Unhandled csae in clspv::GetSpecConstantFromName: " << name
                << "\n";
@@ -0,0 +1,289 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/CallingConv.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include "clspv/AddressSpace.h"
+#include "clspv/Passes.h"
+
+#include "CallGraphOrderedFunctions.h"
+#include "Passes.h"
+
+using namespace llvm;
+
+namespace {
+
+// Specializes functions with generic pointer parameters by the address space
+// of the pointers they are called with.
+//
+// Generic pointers cannot be represented in SPIR-V for Vulkan. Within a
+// function, InferAddressSpaces replaces them with pointers in the address space
+// they were cast from, but it cannot see through calls. Each call to a function
+// with generic pointer parameters whose arguments all resolve to a single
+// address space is redirected to a clone taking pointers in those address
+// spaces. Calls with the same address spaces share a clone. Calls that cannot
+// be resolved, and calls to functions returning a generic pointer, are inlined
+// instead.
+//
+// Functions are processed callers first, so the calls made by a clone are
+// resolved when its callees are processed.
+class SpecializeGenericAddressSpacePass final : public ModulePass {
+public:
+  static char ID;
+  SpecializeGenericAddressSpacePass() : ModulePass(ID) {}
+  bool runOnModule(Module &M) override;
+
+private:
+  // Returns the address space |v| points into, looking through casts, GEPs,
+  // selects and phis. Returns Generic if it cannot be resolved to a single
+  // address space, and kUnconstrained if |v| was already |visited|.
+  unsigned ResolveAddressSpace(Value *v, DenseSet<Value *> &visited);
+
+  static constexpr unsigned kUnconstrained = ~0u;
+
+  // Returns a clone of |fn| whose generic pointer parameters point into
+  // |address_spaces| instead.
+  Function *Specialize(Function *fn, ArrayRef<unsigned> address_spaces);
+};
+
+bool IsGenericPointer(Type *type) {
+  auto *ptr_type = dyn_cast<PointerType>(type);
+  return ptr_type &&
+         ptr_type->getAddressSpace() == clspv::AddressSpace::Generic;
+}
+
+} // namespace
+
+char SpecializeGenericAddressSpacePass::ID = 0;
+INITIALIZE_PASS(SpecializeGenericAddressSpacePass,
+                "SpecializeGenericAddressSpace",
+                "Specialize functions by the address space of generic pointer "
+                "arguments",
+                false, false)
+
+namespace clspv {
+ModulePass *createSpecializeGenericAddressSpacePass() {
+  return new SpecializeGenericAddressSpacePass();
+}
+} // namespace clspv
+
+bool SpecializeGenericAddressSpacePass::runOnModule(Module &M) {
+  bool changed = false;
+  SetVector<Function *> ordered_functions =
+      clspv::CallGraphOrderedFunctions(M);
+
+  for (auto fn : ordered_functions) {
+    // Kernels cannot have generic pointer parameters.
+    if (fn->isDeclaration() || fn->getCallingConv() == CallingConv::SPIR_KERNEL)
+      continue;
+
+    bool has_generic_param = false;
+    for (auto &arg : fn->args()) {
+      has_generic_param |= IsGenericPointer(arg.getType());
+    }
+    const bool generic_return = IsGenericPointer(fn->getReturnType());
+    if (!has_generic_param && !generic_return)
+      continue;
+
+    // Maps the address spaces of the parameters to the clone using them.
+    std::map<std::vector<unsigned>, Function *> clones;
+    SmallVector<User *, 8> users(fn->users());
+    for (auto user : users) {
+      auto call = dyn_cast<CallInst>(user);
+      if (!call)
+        continue;
+
+      std::vector<unsigned> address_spaces;
+      bool resolved = !generic_return;
+      for (auto &arg : fn->args()) {
+        if (!resolved)
+          break;
+        if (!IsGenericPointer(arg.getType()))
+          continue;
+
+        DenseSet<Value *> visited;
+        const unsigned address_space =
+            ResolveAddressSpace(call->getArgOperand(arg.getArgNo()), visited);
+        resolved = address_space != clspv::AddressSpace::Generic &&
+                   address_space != kUnconstrained;
+        address_spaces.push_back(address_space);
+      }
+
+      changed = true;
+      if (!resolved) {
+        // A generic pointer cannot cross the call, so the callee must be
+        // inlined into a context where its address space can be inferred.
+        InlineFunctionInfo IFI;
+        InlineFunction(*call, IFI, nullptr, false);
+        continue;
+      }
+
+      auto &clone = clones[address_spaces];
+      if (!clone) {
+        clone = Specialize(fn, address_spaces);
+      }
+
+      // Cast the arguments to the address spaces of the clone. These casts
+      // cancel out the ones the arguments were resolved through once
+      // InferAddressSpaces runs on the caller.
+      IRBuilder<> builder(call);
+      SmallVector<Value *, 8> args;
+      for (auto &arg : clone->args()) {
+        Value *operand = call->getArgOperand(arg.getArgNo());
+        if (operand->getType() != arg.getType()) {
+          operand = builder.CreateAddrSpaceCast(operand, arg.getType());
+        }
+        args.push_back(operand);
+      }
+      auto *replacement = builder.CreateCall(clone, args);
+      replacement->setCallingConv(call->getCallingConv());
+      replacement->setAttributes(call->getAttributes());
+      replacement->takeName(call);
+      call->replaceAllUsesWith(replacement);
+      call->eraseFromParent();
+    }
+
+    fn->removeDeadConstantUsers();
+    if (fn->use_empty()) {
+      // All calls to this function were either specialized or inlined.
+      fn->eraseFromParent();
+    }
+  }
+
+  return changed;
+}
+
+unsigned SpecializeGenericAddressSpacePass::ResolveAddressSpace(
+    Value *v, DenseSet<Value *> &visited) {
+  auto *ptr_type = cast<PointerType>(v->getType());
+  if (ptr_type->getAddressSpace() != clspv::AddressSpace::Generic)
+    return ptr_type->getAddressSpace();
+
+  // A value already visited, e.g. through a cycle of phis, does not constrain
+  // the address space any further. Its address space was combined where it was
+  // first visited.
+  if (!visited.insert(v).second)
+    return kUnconstrained;
+
+  // Returns the common address space of |values|.
+  auto resolve_all = [this, &visited](ArrayRef<Value *> values) {
+    unsigned address_space = kUnconstrained;
+    for (auto value : values) {
+      const unsigned value_space = ResolveAddressSpace(value, visited);
+      if (value_space == kUnconstrained)
+        continue;
+      if (address_space != kUnconstrained && address_space != value_space)
+        return static_cast<unsigned>(clspv::AddressSpace::Generic);
+      address_space = value_space;
+    }
+    return address_space;
+  };
+
+  unsigned address_space = clspv::AddressSpace::Generic;
+  if (auto *op = dyn_cast<Operator>(v)) {
+    switch (op->getOpcode()) {
+    case Instruction::AddrSpaceCast:
+    case Instruction::BitCast:
+    case Instruction::GetElementPtr:
+      address_space = ResolveAddressSpace(op->getOperand(0), visited);
+      break;
+    case Instruction::Select:
+      address_space = resolve_all({op->getOperand(1), op->getOperand(2)});
+      break;
+    case Instruction::PHI: {
+      SmallVector<Value *, 4> incoming(cast<PHINode>(v)->incoming_values());
+      address_space = resolve_all(incoming);
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  return address_space;
+}
+
+Function *SpecializeGenericAddressSpacePass::Specialize(
+    Function *fn, ArrayRef<unsigned> address_spaces) {
+  SmallVector<Type *, 8> arg_types;
+  auto address_space_iter = address_spaces.begin();
+  std::string name;
+  raw_string_ostream str(name);
+  str << fn->getName() << "_clspv_as";
+  for (auto &arg : fn->args()) {
+    Type *type = arg.getType();
+    if (IsGenericPointer(type)) {
+      const unsigned address_space = *address_space_iter++;
+      type = PointerType::get(type->getPointerElementType(), address_space);
+      str << "_" << address_space;
+    }
+    arg_types.push_back(type);
+  }
+  FunctionType *new_type =
+      FunctionType::get(fn->getReturnType(), arg_types, fn->isVarArg());
+
+  // Clone the body, then move it into a function with the new type and
+  // copy calling conv, attributes and metadata.
+  ValueToValueMapTy remapped;
+  auto *clone = CloneFunction(fn, remapped);
+  auto *specialized = Function::Create(new_type, fn->getLinkage(), str.str(),
+                                       fn->getParent());
+  specialized->setCallingConv(fn->getCallingConv());
+  specialized->setAttributes(fn->getAttributes());
+  specialized->copyMetadata(fn, 0);
+
+  std::vector<BasicBlock *> blocks;
+  for (auto &BB : *clone) {
+    blocks.push_back(&BB);
+  }
+  for (auto *BB : blocks) {
+    BB->removeFromParent();
+    BB->insertInto(specialized);
+  }
+
+  // Generic parameters are cast back to generic at the start of the body.
+  // InferAddressSpaces propagates the specific address space from there.
+  auto where = specialized->begin()->begin();
+  while (isa<AllocaInst>(where)) {
+    ++where;
+  }
+  IRBuilder<> builder(&*where);
+  for (auto old_arg_iter = clone->arg_begin(),
+            new_arg_iter = specialized->arg_begin();
+       old_arg_iter != clone->arg_end(); ++old_arg_iter, ++new_arg_iter) {
+    Value *new_arg = &*new_arg_iter;
+    new_arg->setName(old_arg_iter->getName());
+    if (new_arg->getType() != old_arg_iter->getType()) {
+      new_arg = builder.CreateAddrSpaceCast(new_arg, old_arg_iter->getType());
+    }
+    old_arg_iter->replaceAllUsesWith(new_arg);
+  }
+
+  clone->eraseFromParent();
+  return specialized;
+}
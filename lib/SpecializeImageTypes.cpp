@@ -47,6 +47,11 @@ private:
   // Returns the specialized image type for operand |operand_no| in |value|.
   Type *RemapUse(Value *value, unsigned operand_no);
 
+  // Returns the specialized image type inferred from the uses of |arg|, a
+  // parameter of a helper function. The result is memoized, so helpers called
+  // from many kernels are only analyzed once.
+  Type *RemapParameter(Argument *arg);
+
   // Specializes |arg| as |new_type|. Recursively updates the use chain.
   void SpecializeArg(Function *f, Argument *arg, Type *new_type);
 
@@ -64,6 +69,10 @@ private:
   // Maps an argument to a specialized type.
   DenseMap<Argument *, Type *> remapped_args_;
 
+  // Memoized results of RemapParameter. A null type means the uses of the
+  // parameter carry no specializing information.
+  DenseMap<Argument *, Type *> parameter_types_;
+
   // Tracks which functions need rewritten due to modified arguments.
   DenseSet<Function *> functions_to_modify_;
 };
@@ -212,11 +221,7 @@ Type *SpecializeImageTypesPass::RemapUse(Value *value, unsigned operand_no) {
     }
     default:
       if (!called->isDeclaration()) {
-        for (auto &U : called->getArg(operand_no)->uses()) {
-          if (auto new_type = RemapUse(U.getUser(), U.getOperandNo())) {
-            return new_type;
-          }
-        }
+        return RemapParameter(called->getArg(operand_no));
       }
       break;
     }
@@ -231,6 +236,20 @@ Type *SpecializeImageTypesPass::RemapUse(Value *value, unsigned operand_no) {
   return nullptr;
 }
 
+Type *SpecializeImageTypesPass::RemapParameter(Argument *arg) {
+  auto where = parameter_types_.find(arg);
+  if (where != parameter_types_.end())
+    return where->second;
+
+  Type *new_type = nullptr;
+  for (auto &U : arg->uses()) {
+    if ((new_type = RemapUse(U.getUser(), U.getOperandNo())))
+      break;
+  }
+  parameter_types_[arg] = new_type;
+  return new_type;
+}
+
 void SpecializeImageTypesPass::SpecializeArg(Function *f, Argument *arg,
                                              Type *new_type) {
   auto where = remapped_args_.find(arg);
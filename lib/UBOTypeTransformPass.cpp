@@ -18,6 +18,8 @@
 // Assumes the following passes have run:
 // UndoGetElementPtrConstantExprPass
 
+#include <memory>
+
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/CallingConv.h"
@@ -32,7 +34,7 @@
 #include "clspv/Option.h"
 
 #include "ArgKind.h"
-#include "Constants.h"
+#include "Layout.h"
 #include "Passes.h"
 
 using namespace llvm;
@@ -111,6 +113,9 @@ private:
 
   // Whether char arrays are supported in UBOs.
   bool support_int8_array_;
+
+  // Records the layout of the rebuilt types for the SPIR-V producer.
+  std::unique_ptr<clspv::TypeLayoutCache> layout_;
 };
 
 } // namespace
@@ -129,6 +134,7 @@ bool UBOTypeTransformPass::runOnModule(Module &M) {
   // Record whether char arrays are supported.
   support_int8_array_ = clspv::Option::Int8Support() &&
                         clspv::Option::Std430UniformBufferLayout();
+  layout_.reset(new clspv::TypeLayoutCache(M));
 
   bool changed = false;
   for (auto &F : M) {
@@ -206,22 +212,7 @@ Type *UBOTypeTransformPass::MapType(Type *type, Module &M, bool rewrite) {
   if (remapped != type && result.second && !remapped->isFunctionTy()) {
     // Record the type sizes from data layout to generate correct SPIRV-V
     // information later.
-    const auto &DL = M.getDataLayout();
-    NamedMDNode *type_sizes_md =
-        M.getOrInsertNamedMetadata(clspv::RemappedTypeSizesMetadataName());
-    auto *i64 = Type::getInt32Ty(M.getContext());
-    Metadata *size_values[3];
-    size_values[0] = ConstantAsMetadata::get(
-        ConstantInt::get(i64, DL.getTypeSizeInBits(type)));
-    size_values[1] = ConstantAsMetadata::get(
-        ConstantInt::get(i64, DL.getTypeStoreSize(type)));
-    size_values[2] = ConstantAsMetadata::get(
-        ConstantInt::get(i64, DL.getTypeAllocSize(type)));
-    MDTuple *values_md = MDTuple::get(M.getContext(), size_values);
-    MDTuple *entry = MDTuple::get(
-        M.getContext(),
-        {ConstantAsMetadata::get(Constant::getNullValue(remapped)), values_md});
-    type_sizes_md->addOperand(entry);
+    layout_->addSizes(remapped, type);
   }
 
   return remapped;
@@ -267,19 +258,7 @@ StructType *UBOTypeTransformPass::MapStructType(StructType *struct_ty,
         StructType::create(elements, "", struct_ty->isPacked());
 
     // Record the correct offsets for use when generating the SPIR-V binary.
-    NamedMDNode *offsets_md =
-        M.getOrInsertNamedMetadata(clspv::RemappedTypeOffsetMetadataName());
-    SmallVector<Metadata *, 8> offset_values;
-    for (auto offset : offsets) {
-      offset_values.push_back(ConstantAsMetadata::get(
-          ConstantInt::get(Type::getInt32Ty(M.getContext()), offset)));
-    }
-    MDTuple *values_md = MDTuple::get(M.getContext(), offset_values);
-    MDTuple *entry = MDTuple::get(
-        M.getContext(),
-        {ConstantAsMetadata::get(Constant::getNullValue(replacement)),
-         values_md});
-    offsets_md->addOperand(entry);
+    layout_->addOffsets(replacement, offsets);
 
     return replacement;
   } else {
@@ -359,17 +338,10 @@ bool UBOTypeTransformPass::RemapFunctions(
     replacement->setCallingConv(func->getCallingConv());
     replacement->copyMetadata(func, 0);
 
-    // Move the basic blocks into the replacement function.
-    if (!func->isDeclaration()) {
-      std::vector<BasicBlock *> blocks;
-      for (auto &BB : *func) {
-        blocks.push_back(&BB);
-      }
-      for (auto *BB : blocks) {
-        BB->removeFromParent();
-        BB->insertInto(replacement);
-      }
-    }
+    // Move the basic blocks into the replacement function in one splice
+    // rather than unlinking them one by one.
+    replacement->getBasicBlockList().splice(replacement->end(),
+                                            func->getBasicBlockList());
   }
 
   return changed;
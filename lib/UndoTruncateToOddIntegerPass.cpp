@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <utility>
 
 #include "llvm/ADT/UniqueVector.h"
@@ -21,6 +22,8 @@
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include "clspv/Option.h"
+
 #include "Passes.h"
 
 using namespace llvm;
@@ -203,12 +206,20 @@ bool UndoTruncateToOddIntegerPass::runOnModule(Module &M) {
         if (auto trunc = dyn_cast<TruncInst>(&I)) {
           if (trunc->getType()->isVectorTy())
             continue;
-          auto desired_bit_width =
-              trunc->getOperand(0)->getType()->getIntegerBitWidth();
-          switch (trunc->getType()->getIntegerBitWidth()) {
+          auto desired_bit_width = static_cast<uint32_t>(PowerOf2Ceil(
+              trunc->getOperand(0)->getType()->getIntegerBitWidth()));
+          const auto bit_width = trunc->getType()->getIntegerBitWidth();
+          // Keep the value as narrow as the target allows rather than
+          // widening it back to the width it was truncated from.
+          if (clspv::Option::NarrowIntegerArithmetic()) {
+            if (bit_width < 8 && clspv::Option::Int8Support())
+              desired_bit_width = std::min(desired_bit_width, 8u);
+            else if (bit_width < 16)
+              desired_bit_width = std::min(desired_bit_width, 16u);
+          }
+          switch (bit_width) {
           default:
-            WorkList.push_back(std::make_pair(
-                trunc, static_cast<uint32_t>(PowerOf2Ceil(desired_bit_width))));
+            WorkList.push_back(std::make_pair(trunc, desired_bit_width));
             break;
           case 1: // i1 is a bool.
           case 8:
@@ -0,0 +1,415 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "UniformityAnalysis.h"
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Operator.h"
+
+#include "clspv/AddressSpace.h"
+#include "clspv/ArgKind.h"
+
+#include "Builtins.h"
+
+using namespace llvm;
+
+namespace {
+
+// Collects the values |Ptr| may be derived from through GEPs, casts, selects
+// and phis into |Roots|.
+void CollectRoots(const Value *Ptr, SmallVectorImpl<const Value *> &Roots) {
+  SmallPtrSet<const Value *, 8> Visited;
+  SmallVector<const Value *, 8> Stack{Ptr};
+  while (!Stack.empty()) {
+    auto *V = Stack.pop_back_val();
+    if (!Visited.insert(V).second)
+      continue;
+    if (auto *Op = dyn_cast<Operator>(V)) {
+      switch (Op->getOpcode()) {
+      case Instruction::GetElementPtr:
+      case Instruction::BitCast:
+      case Instruction::AddrSpaceCast:
+        Stack.push_back(Op->getOperand(0));
+        continue;
+      case Instruction::Select:
+        Stack.push_back(Op->getOperand(1));
+        Stack.push_back(Op->getOperand(2));
+        continue;
+      case Instruction::PHI:
+        for (auto &Incoming : cast<PHINode>(V)->incoming_values())
+          Stack.push_back(Incoming);
+        continue;
+      default:
+        break;
+      }
+    }
+    Roots.push_back(V);
+  }
+}
+
+// Returns true if the contents of the private memory |Object| may be accessed
+// other than by loads and stores through pointers derived from it in its
+// function, e.g. by a callee it is passed to.
+bool Escapes(const Value *Object) {
+  SmallPtrSet<const Value *, 8> Visited;
+  SmallVector<const Value *, 8> Stack{Object};
+  while (!Stack.empty()) {
+    auto *V = Stack.pop_back_val();
+    if (!Visited.insert(V).second)
+      continue;
+    for (auto *User : V->users()) {
+      if (isa<LoadInst>(User) || isa<ICmpInst>(User))
+        continue;
+      if (auto *Store = dyn_cast<StoreInst>(User)) {
+        if (Store->getValueOperand() == V)
+          return true;
+        continue;
+      }
+      if (auto *Op = dyn_cast<Operator>(User)) {
+        switch (Op->getOpcode()) {
+        case Instruction::GetElementPtr:
+        case Instruction::BitCast:
+        case Instruction::AddrSpaceCast:
+        case Instruction::Select:
+        case Instruction::PHI:
+          Stack.push_back(User);
+          continue;
+        default:
+          break;
+        }
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns true if |Root| is the storage buffer holding the POD arguments of a
+// kernel, which the kernel does not write.
+bool IsPodArgsBuffer(const Value *Root) {
+  auto *Call = dyn_cast<CallInst>(Root);
+  if (!Call || !Call->getCalledFunction())
+    return false;
+  if (Builtins::Lookup(Call->getCalledFunction()).getType() !=
+      Builtins::kClspvResource)
+    return false;
+  // The third operand of the resource accessor is the argument kind.
+  auto *Kind = dyn_cast<ConstantInt>(Call->getArgOperand(2));
+  return Kind && Kind->getZExtValue() == unsigned(ArgKind::Pod);
+}
+
+bool IsPrivateMemory(const Value *V) {
+  auto AS = V->getType()->getPointerAddressSpace();
+  return AS == clspv::AddressSpace::Private ||
+         AS == clspv::AddressSpace::ModuleScopePrivate;
+}
+
+} // namespace
+
+namespace clspv {
+
+UniformityAnalysis::UniformityAnalysis(Module &M) {
+  // Track the contents of the private memory that does not escape.
+  auto Track = [this](const Value *Object) {
+    if (!Escapes(Object))
+      ObjectLoads[Object];
+  };
+  for (auto &GV : M.globals()) {
+    if (IsPrivateMemory(&GV))
+      Track(&GV);
+  }
+  for (auto &F : M) {
+    for (auto &BB : F) {
+      for (auto &I : BB) {
+        if (isa<AllocaInst>(I))
+          Track(&I);
+      }
+    }
+  }
+
+  for (auto &F : M) {
+    if (F.isDeclaration())
+      continue;
+
+    // The parameters of a function used other than by direct calls are
+    // unknown.
+    if (F.getCallingConv() != CallingConv::SPIR_KERNEL) {
+      for (auto *User : F.users()) {
+        auto *Call = dyn_cast<CallInst>(User);
+        if (!Call || Call->getCalledFunction() != &F) {
+          for (auto &Arg : F.args())
+            raise(&Arg, Uniformity::Divergent);
+          break;
+        }
+      }
+    }
+
+    for (auto &BB : F) {
+      for (auto &I : BB) {
+        if (auto *Load = dyn_cast<LoadInst>(&I)) {
+          raise(Load, loadSeed(Load));
+          SmallVector<const Value *, 4> Roots;
+          CollectRoots(Load->getPointerOperand(), Roots);
+          for (auto *Root : Roots) {
+            auto Loads = ObjectLoads.find(Root);
+            if (Loads != ObjectLoads.end())
+              Loads->second.push_back(Load);
+          }
+        } else if (isa<AtomicRMWInst>(I) || isa<AtomicCmpXchgInst>(I)) {
+          raise(&I, Uniformity::Divergent);
+        } else if (auto *Call = dyn_cast<CallInst>(&I)) {
+          auto *Callee = Call->getCalledFunction();
+          if (!Callee) {
+            raise(Call, Uniformity::Divergent);
+          } else if (Callee->isDeclaration()) {
+            bool FromArgs = false;
+            raise(Call, callSeed(Call, &FromArgs));
+          }
+        }
+      }
+    }
+  }
+
+  while (!WorkList.empty()) {
+    propagate(WorkList.pop_back_val());
+  }
+}
+
+Uniformity UniformityAnalysis::get(const Value *V) const {
+  auto It = Values.find(V);
+  return It == Values.end() ? Uniformity::Workgroup : It->second;
+}
+
+bool UniformityAnalysis::hasNonUniformResource(const Value *V) const {
+  if (!V->getType()->isPointerTy() || isWorkgroupUniform(V))
+    return false;
+  // A non-uniform pointer derived from a single resource only indexes it
+  // differently.
+  SmallVector<const Value *, 4> Roots;
+  CollectRoots(V, Roots);
+  return Roots.size() > 1;
+}
+
+void UniformityAnalysis::raise(const Value *V, Uniformity U) {
+  if (U == Uniformity::Workgroup || isa<Constant>(V))
+    return;
+  auto &Current = Values[V];
+  if (U <= Current)
+    return;
+  Current = U;
+  WorkList.push_back(V);
+}
+
+void UniformityAnalysis::raiseObject(const Value *Object, Uniformity U) {
+  auto Loads = ObjectLoads.find(Object);
+  if (Loads == ObjectLoads.end())
+    return;
+  auto &Current = Objects[Object];
+  if (U <= Current)
+    return;
+  Current = U;
+  for (auto *Load : Loads->second)
+    raise(Load, U);
+}
+
+void UniformityAnalysis::raiseReturn(const Function *F, Uniformity U) {
+  auto &Current = Returns[F];
+  if (U <= Current)
+    return;
+  Current = U;
+  for (auto *User : F->users()) {
+    auto *Call = dyn_cast<CallInst>(User);
+    if (Call && Call->getCalledFunction() == F)
+      raise(Call, U);
+  }
+}
+
+void UniformityAnalysis::propagate(const Value *V) {
+  const Uniformity U = get(V);
+  for (auto *User : V->users()) {
+    auto *I = dyn_cast<Instruction>(User);
+    if (!I)
+      continue;
+
+    if (auto *Call = dyn_cast<CallInst>(I)) {
+      auto *Callee = Call->getCalledFunction();
+      if (!Callee)
+        continue;
+      if (!Callee->isDeclaration()) {
+        for (auto &Arg : Callee->args()) {
+          if (Call->getArgOperand(Arg.getArgNo()) == V)
+            raise(&Arg, U);
+        }
+        continue;
+      }
+      bool FromArgs = false;
+      callSeed(Call, &FromArgs);
+      if (FromArgs)
+        raise(Call, U);
+    } else if (auto *Store = dyn_cast<StoreInst>(I)) {
+      SmallVector<const Value *, 4> Roots;
+      CollectRoots(Store->getPointerOperand(), Roots);
+      for (auto *Root : Roots)
+        raiseObject(Root, U);
+    } else if (isa<ReturnInst>(I)) {
+      raiseReturn(I->getFunction(), U);
+    } else if (isa<BranchInst>(I) || isa<SwitchInst>(I)) {
+      propagateBranch(I, U);
+    } else if (!I->getType()->isVoidTy()) {
+      raise(I, U);
+    }
+  }
+}
+
+void UniformityAnalysis::propagateBranch(const Instruction *Term,
+                                         Uniformity U) {
+  auto *BB = Term->getParent();
+  auto *F = BB->getParent();
+  auto &PDT = PostDomTrees[F];
+  if (!PDT)
+    PDT.reset(new PostDominatorTree(const_cast<Function &>(*F)));
+
+  // The invocations taking different successors reconverge at the immediate
+  // post-dominator, or when returning if there is none.
+  const BasicBlock *IPD = nullptr;
+  if (auto *Node = PDT->getNode(BB)) {
+    if (auto *IDom = Node->getIDom())
+      IPD = IDom->getBlock();
+  }
+
+  SmallPtrSet<const BasicBlock *, 16> Region;
+  SmallVector<const BasicBlock *, 16> Stack;
+  auto Visit = [&](const BasicBlock *From) {
+    for (auto *Succ : successors(From)) {
+      if (Succ != IPD && Region.insert(Succ).second)
+        Stack.push_back(Succ);
+    }
+  };
+  Visit(BB);
+  while (!Stack.empty())
+    Visit(Stack.pop_back_val());
+
+  if (IPD) {
+    for (auto &Phi : IPD->phis())
+      raise(&Phi, U);
+  } else {
+    raiseReturn(F, U);
+  }
+
+  for (auto *B : Region) {
+    for (auto &I : *B) {
+      if (isa<PHINode>(I)) {
+        raise(&I, U);
+      } else if (auto *Store = dyn_cast<StoreInst>(&I)) {
+        SmallVector<const Value *, 4> Roots;
+        CollectRoots(Store->getPointerOperand(), Roots);
+        for (auto *Root : Roots)
+          raiseObject(Root, U);
+      }
+
+      // Values leaving a loop the invocations exit in different iterations
+      // differ.
+      for (auto *User : I.users()) {
+        auto *UI = dyn_cast<Instruction>(User);
+        if (!UI || Region.count(UI->getParent()) || UI->getType()->isVoidTy())
+          continue;
+        raise(UI, U);
+      }
+    }
+  }
+}
+
+Uniformity UniformityAnalysis::callSeed(const CallInst *Call,
+                                        bool *FromArgs) const {
+  *FromArgs = true;
+  auto *Callee = Call->getCalledFunction();
+  switch (Builtins::Lookup(Callee).getType()) {
+  case Builtins::kGetGroupId:
+  case Builtins::kGetGlobalSize:
+  case Builtins::kGetGlobalOffset:
+  case Builtins::kGetLocalSize:
+  case Builtins::kGetEnqueuedLocalSize:
+  case Builtins::kGetNumGroups:
+  case Builtins::kGetWorkDim:
+  case Builtins::kClspvResource:
+  case Builtins::kClspvLocal:
+  case Builtins::kClspvPhysicalPointer:
+  case Builtins::kClspvPodSpecConstant:
+  case Builtins::kClspvSamplerVarLiteral:
+  case Builtins::kClspvCompositeConstruct:
+  case Builtins::kSpirvPack:
+  case Builtins::kSpirvUnpack:
+    return Uniformity::Workgroup;
+  case Builtins::kGetSubGroupSize:
+  case Builtins::kGetMaxSubGroupSize:
+  case Builtins::kGetNumSubGroups:
+  case Builtins::kGetEnqueuedNumSubGroups:
+    *FromArgs = false;
+    return Uniformity::Workgroup;
+  case Builtins::kGetSubGroupId:
+  case Builtins::kSubGroupAll:
+  case Builtins::kSubGroupAny:
+  case Builtins::kSubGroupBroadcast:
+  case Builtins::kSubGroupReduceAdd:
+  case Builtins::kSubGroupReduceMin:
+  case Builtins::kSubGroupReduceMax:
+    *FromArgs = false;
+    return Uniformity::Subgroup;
+  case Builtins::kGetGlobalId:
+  case Builtins::kGetGlobalLinearId:
+  case Builtins::kGetLocalId:
+  case Builtins::kGetLocalLinearId:
+  case Builtins::kGetSubGroupLocalId:
+    *FromArgs = false;
+    return Uniformity::Divergent;
+  default:
+    break;
+  }
+
+  // Other builtins reading memory may see the writes of other invocations or,
+  // like atomics and scans, give each invocation a different result.
+  if (Callee->doesNotAccessMemory())
+    return Uniformity::Workgroup;
+  *FromArgs = false;
+  return Uniformity::Divergent;
+}
+
+Uniformity UniformityAnalysis::loadSeed(const LoadInst *Load) const {
+  SmallVector<const Value *, 4> Roots;
+  CollectRoots(Load->getPointerOperand(), Roots);
+  for (auto *Root : Roots) {
+    if (Root->getName() == "__spirv_GlobalInvocationId" ||
+        Root->getName() == "__spirv_LocalInvocationId")
+      return Uniformity::Divergent;
+    if (ObjectLoads.count(Root) || IsPodArgsBuffer(Root))
+      continue;
+    switch (Root->getType()->getPointerAddressSpace()) {
+    case AddressSpace::Constant:
+    case AddressSpace::Input:
+    case AddressSpace::Uniform:
+    case AddressSpace::UniformConstant:
+    case AddressSpace::PushConstant:
+      // Read-only memory holds the same value for every invocation.
+      break;
+    default:
+      // Other invocations may write global and local memory, and private
+      // memory that escapes is not tracked.
+      return Uniformity::Divergent;
+    }
+  }
+  return Uniformity::Workgroup;
+}
+
+} // namespace clspv
@@ -0,0 +1,111 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_LIB_UNIFORMITY_ANALYSIS_H_
+#define CLSPV_LIB_UNIFORMITY_ANALYSIS_H_
+
+#include <map>
+#include <memory>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+namespace clspv {
+
+// How widely a value is known to be the same across the invocations executing
+// it, from most to least uniform. Each level implies the ones after it.
+enum class Uniformity {
+  // The same for all invocations of a workgroup, i.e. dynamically uniform.
+  Workgroup,
+  // The same for all invocations of a subgroup.
+  Subgroup,
+  // May differ between the invocations of a subgroup.
+  Divergent,
+};
+
+// Computes the uniformity of the values of a module, like LLVM's
+// LegacyDivergenceAnalysis but for the IR clspv hands to the SPIR-V producer
+// and across calls.
+//
+// Invocation IDs, atomics and loads from memory other invocations may write
+// are divergent. Work-group IDs, push constants, uniform buffers and kernel
+// arguments are uniform. Subgroup collectives are uniform within a subgroup.
+// Uniformity flows through operands, through the private memory a function
+// does not let escape, into the parameters of the functions called and back
+// out of their return values. A branch on a value that is not uniform makes
+// the phis of the blocks it controls and the values leaving them just as
+// non-uniform, as well as the private memory stored to in those blocks.
+class UniformityAnalysis {
+public:
+  explicit UniformityAnalysis(llvm::Module &M);
+
+  // Returns the uniformity of |V|.
+  Uniformity get(const llvm::Value *V) const;
+
+  bool isWorkgroupUniform(const llvm::Value *V) const {
+    return get(V) == Uniformity::Workgroup;
+  }
+  bool isSubgroupUniform(const llvm::Value *V) const {
+    return get(V) != Uniformity::Divergent;
+  }
+
+  // Returns true if the resource the pointer |V| points into may differ
+  // between the invocations of a workgroup, e.g. a pointer selected from two
+  // storage buffers on a divergent condition.
+  bool hasNonUniformResource(const llvm::Value *V) const;
+
+private:
+  // Raises the uniformity of |V| to |U|.
+  void raise(const llvm::Value *V, Uniformity U);
+
+  // Raises the uniformity of the contents of the private memory |Object| to
+  // |U|.
+  void raiseObject(const llvm::Value *Object, Uniformity U);
+
+  // Raises the uniformity of the value returned by |F| to |U|.
+  void raiseReturn(const llvm::Function *F, Uniformity U);
+
+  // Propagates the uniformity of |V| to its users.
+  void propagate(const llvm::Value *V);
+
+  // Makes the values controlled by the terminator |Term| at least as
+  // non-uniform as |U|.
+  void propagateBranch(const llvm::Instruction *Term, Uniformity U);
+
+  // Returns the uniformity the result of |Call|, a call to a declaration,
+  // starts at. Sets |FromArgs| if the result also follows the arguments.
+  Uniformity callSeed(const llvm::CallInst *Call, bool *FromArgs) const;
+
+  // Returns the uniformity |Load| starts at, from the memory it reads other
+  // than the private memory whose contents are tracked.
+  Uniformity loadSeed(const llvm::LoadInst *Load) const;
+
+  llvm::DenseMap<const llvm::Value *, Uniformity> Values;
+  llvm::DenseMap<const llvm::Value *, Uniformity> Objects;
+  llvm::DenseMap<const llvm::Function *, Uniformity> Returns;
+  // The loads from each private memory object whose uniformity is tracked.
+  llvm::DenseMap<const llvm::Value *,
+                 llvm::SmallVector<const llvm::LoadInst *, 4>>
+      ObjectLoads;
+  llvm::SmallVector<const llvm::Value *, 32> WorkList;
+  std::map<const llvm::Function *, std::unique_ptr<llvm::PostDominatorTree>>
+      PostDomTrees;
+};
+
+} // namespace clspv
+
+#endif // CLSPV_LIB_UNIFORMITY_ANALYSIS_H_
@@ -0,0 +1,322 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Declares the type-punned __global and __constant buffers of kernels as
+// arrays of 32-bit words. A float buffer also accessed as float2, e.g.
+//   %p = bitcast float addrspace(1)* %buf to <2 x float> addrspace(1)*
+//   %q = getelementptr <2 x float>, <2 x float> addrspace(1)* %p, i32 %i
+//   %v = load <2 x float>, <2 x float> addrspace(1)* %q
+// becomes an i32 addrspace(1)* argument, and each access loads or stores the
+// words it covers:
+//   %o = mul i32 %i, 8
+//   %w = lshr i32 %o, 2
+//   %q0 = getelementptr i32, i32 addrspace(1)* %buf, i32 %w
+//   %v0 = load i32, i32 addrspace(1)* %q0
+//   ... and the same for %w + 1, inserted into a <2 x i32> %v01 ...
+//   %v = bitcast <2 x i32> %v01 to <2 x float>
+// ReplacePointerBitcastPass would instead combine accesses of the declared
+// type with shifts and masks whenever the sizes differ.
+//
+// Only buffers whose accesses are all word-aligned loads and stores of
+// scalars or vectors of at most four words, with 16-bit or wider elements,
+// are rewritten. Buffers accessed with 8-bit types or through calls, atomics
+// or selected pointers keep their type, and so do buffers accessed with a
+// single type, which already take one access each.
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/GetElementPtrTypeIterator.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+#include "clspv/AddressSpace.h"
+#include "clspv/Option.h"
+
+#include "Passes.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "UntypedBuffers"
+
+namespace {
+// The largest access rewritten, in words.
+const uint64_t kMaxAccessWords = 4;
+
+struct UntypedBuffersPass : public ModulePass {
+  static char ID;
+  UntypedBuffersPass() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override;
+
+private:
+  // Returns true if |arg| is a buffer that should be declared as words. Its
+  // loads and stores are added to |accesses|.
+  bool IsTypePunnedBuffer(Argument &arg,
+                          SmallVectorImpl<Instruction *> *accesses);
+
+  // Returns the byte offset of |ptr| from the buffer it is derived from,
+  // generating the computation right before |ptr|.
+  Value *GetByteOffset(Value *ptr);
+
+  // Replaces |access| with accesses of the words of |words|.
+  void RewriteAccess(Instruction *access, Value *words);
+
+  const DataLayout *DL = nullptr;
+  DenseMap<Value *, Value *> ByteOffsets;
+};
+} // namespace
+
+char UntypedBuffersPass::ID = 0;
+INITIALIZE_PASS(UntypedBuffersPass, "UntypedBuffers", "Untyped Buffers Pass",
+                false, false)
+
+namespace clspv {
+ModulePass *createUntypedBuffersPass() { return new UntypedBuffersPass(); }
+} // namespace clspv
+
+bool UntypedBuffersPass::runOnModule(Module &M) {
+  DL = &M.getDataLayout();
+
+  bool Changed = false;
+  SmallVector<Function *, 8> kernels;
+  for (auto &F : M) {
+    // Callers would pass pointers of the declared types.
+    if (!F.isDeclaration() && F.getCallingConv() == CallingConv::SPIR_KERNEL &&
+        F.use_empty())
+      kernels.push_back(&F);
+  }
+
+  for (auto *F : kernels) {
+    SmallVector<Type *, 8> ParamTys;
+    DenseMap<Argument *, SmallVector<Instruction *, 16>> Accesses;
+    for (auto &Arg : F->args()) {
+      SmallVector<Instruction *, 16> ArgAccesses;
+      if (IsTypePunnedBuffer(Arg, &ArgAccesses)) {
+        ParamTys.push_back(PointerType::get(
+            Type::getInt32Ty(M.getContext()),
+            Arg.getType()->getPointerAddressSpace()));
+        Accesses[&Arg] = std::move(ArgAccesses);
+      } else {
+        ParamTys.push_back(Arg.getType());
+      }
+    }
+    if (Accesses.empty())
+      continue;
+
+    auto *NewFTy = FunctionType::get(F->getReturnType(), ParamTys, false);
+    auto *NewF = Function::Create(NewFTy, F->getLinkage());
+    M.getFunctionList().insert(F->getIterator(), NewF);
+    NewF->takeName(F);
+    NewF->setCallingConv(F->getCallingConv());
+    NewF->copyMetadata(F, 0);
+
+    // Attributes such as dereferenceable describe the declared type.
+    auto Attributes = F->getAttributes();
+    for (unsigned i = 0; i < ParamTys.size(); ++i) {
+      if (ParamTys[i] != F->getFunctionType()->getParamType(i))
+        Attributes = Attributes.removeParamAttributes(M.getContext(), i);
+    }
+    NewF->setAttributes(Attributes);
+
+    NewF->getBasicBlockList().splice(NewF->begin(), F->getBasicBlockList());
+
+    for (auto &Arg : F->args()) {
+      auto *NewArg = NewF->getArg(Arg.getArgNo());
+      NewArg->takeName(&Arg);
+      auto It = Accesses.find(&Arg);
+      if (It == Accesses.end()) {
+        Arg.replaceAllUsesWith(NewArg);
+        continue;
+      }
+
+      ByteOffsets.clear();
+      ByteOffsets[&Arg] = ConstantInt::get(Type::getInt32Ty(M.getContext()), 0);
+      for (auto *Access : It->second)
+        RewriteAccess(Access, NewArg);
+
+      // Only the address computations remain. Erase them, users first.
+      SmallVector<Instruction *, 16> Worklist;
+      for (auto *U : Arg.users())
+        Worklist.push_back(cast<Instruction>(U));
+      SmallVector<Instruction *, 16> Dead;
+      while (!Worklist.empty()) {
+        auto *I = Worklist.pop_back_val();
+        Dead.push_back(I);
+        for (auto *U : I->users())
+          Worklist.push_back(cast<Instruction>(U));
+      }
+      for (auto *I : reverse(Dead)) {
+        if (I->use_empty())
+          I->eraseFromParent();
+      }
+      assert(Arg.use_empty() && "Buffer address still used");
+    }
+
+    F->eraseFromParent();
+    Changed = true;
+  }
+
+  return Changed;
+}
+
+bool UntypedBuffersPass::IsTypePunnedBuffer(
+    Argument &arg, SmallVectorImpl<Instruction *> *accesses) {
+  auto *PTy = dyn_cast<PointerType>(arg.getType());
+  if (!PTy)
+    return false;
+  if (PTy->getAddressSpace() != clspv::AddressSpace::Global &&
+      PTy->getAddressSpace() != clspv::AddressSpace::Constant)
+    return false;
+  // Arrays of words in uniform buffers would have a 16-byte stride.
+  if (PTy->getAddressSpace() == clspv::AddressSpace::Constant &&
+      clspv::Option::ConstantArgsInUniformBuffer())
+    return false;
+
+  SmallVector<Value *, 16> Worklist{&arg};
+  SmallPtrSet<Type *, 4> AccessTypes;
+  while (!Worklist.empty()) {
+    auto *V = Worklist.pop_back_val();
+    for (auto *U : V->users()) {
+      if (isa<GetElementPtrInst>(U) || isa<BitCastInst>(U)) {
+        Worklist.push_back(U);
+        continue;
+      }
+
+      Type *Ty = nullptr;
+      Align Alignment;
+      if (auto *LI = dyn_cast<LoadInst>(U)) {
+        Ty = LI->getType();
+        Alignment = LI->getAlign();
+      } else if (auto *SI = dyn_cast<StoreInst>(U)) {
+        // Storing the address itself.
+        if (SI->getValueOperand() == V)
+          return false;
+        Ty = SI->getValueOperand()->getType();
+        Alignment = SI->getAlign();
+      } else {
+        return false;
+      }
+
+      auto *EleTy = Ty->isVectorTy() ? cast<VectorType>(Ty)->getElementType()
+                                     : Ty;
+      if (!EleTy->isIntegerTy() && !EleTy->isFloatingPointTy())
+        return false;
+      if (DL->getTypeSizeInBits(EleTy) < 16)
+        return false;
+      const auto Size = DL->getTypeStoreSize(Ty);
+      if (Size % 4 || Size / 4 > kMaxAccessWords || Alignment.value() < 4)
+        return false;
+
+      AccessTypes.insert(Ty);
+      accesses->push_back(cast<Instruction>(U));
+    }
+  }
+
+  return AccessTypes.size() > 1;
+}
+
+Value *UntypedBuffersPass::GetByteOffset(Value *ptr) {
+  auto It = ByteOffsets.find(ptr);
+  if (It != ByteOffsets.end())
+    return It->second;
+
+  auto *I = cast<Instruction>(ptr);
+  Value *Offset = GetByteOffset(I->getOperand(0));
+  if (auto *GEP = dyn_cast<GetElementPtrInst>(I)) {
+    IRBuilder<> Builder(GEP);
+    auto *Int32Ty = Builder.getInt32Ty();
+    // Adds |term| to the offset, skipping zeros.
+    auto AddOffset = [&Builder, &Offset](Value *term) {
+      if (auto *C = dyn_cast<ConstantInt>(term)) {
+        if (C->isZero())
+          return;
+      }
+      if (auto *C = dyn_cast<ConstantInt>(Offset)) {
+        if (C->isZero()) {
+          Offset = term;
+          return;
+        }
+      }
+      Offset = Builder.CreateAdd(Offset, term);
+    };
+    for (auto GTI = gep_type_begin(GEP), E = gep_type_end(GEP); GTI != E;
+         ++GTI) {
+      Value *Idx = GTI.getOperand();
+      if (auto *STy = GTI.getStructTypeOrNull()) {
+        const auto Field = cast<ConstantInt>(Idx)->getZExtValue();
+        const auto FieldOffset =
+            DL->getStructLayout(STy)->getElementOffset(Field);
+        AddOffset(Builder.getInt32(FieldOffset));
+        continue;
+      }
+
+      const auto Stride = DL->getTypeAllocSize(GTI.getIndexedType());
+      Idx = Builder.CreateSExtOrTrunc(Idx, Int32Ty);
+      AddOffset(Builder.CreateMul(Idx, Builder.getInt32(Stride)));
+    }
+  }
+
+  ByteOffsets[ptr] = Offset;
+  return Offset;
+}
+
+void UntypedBuffersPass::RewriteAccess(Instruction *access, Value *words) {
+  auto *LI = dyn_cast<LoadInst>(access);
+  auto *SI = dyn_cast<StoreInst>(access);
+  Value *Ptr = LI ? LI->getPointerOperand() : SI->getPointerOperand();
+  Type *Ty = LI ? LI->getType() : SI->getValueOperand()->getType();
+  const bool IsVolatile = LI ? LI->isVolatile() : SI->isVolatile();
+
+  Value *ByteOffset = GetByteOffset(Ptr);
+  IRBuilder<> Builder(access);
+  auto *Int32Ty = Builder.getInt32Ty();
+  const unsigned NumWords = DL->getTypeStoreSize(Ty) / 4;
+  Type *WordsTy = Int32Ty;
+  if (NumWords > 1)
+    WordsTy = FixedVectorType::get(Int32Ty, NumWords);
+  Value *Index = Builder.CreateLShr(ByteOffset, Builder.getInt32(2));
+
+  SmallVector<Value *, 4> Addresses;
+  for (unsigned i = 0; i < NumWords; ++i) {
+    Value *WordIndex =
+        i ? Builder.CreateAdd(Index, Builder.getInt32(i)) : Index;
+    Addresses.push_back(Builder.CreateGEP(words, WordIndex));
+  }
+
+  if (LI) {
+    Value *Val = UndefValue::get(WordsTy);
+    for (unsigned i = 0; i < NumWords; ++i) {
+      Value *Word = Builder.CreateAlignedLoad(Int32Ty, Addresses[i], Align(4),
+                                              IsVolatile);
+      Val = NumWords == 1 ? Word : Builder.CreateInsertElement(Val, Word, i);
+    }
+    if (Val->getType() != Ty)
+      Val = Builder.CreateBitCast(Val, Ty);
+    Val->takeName(LI);
+    LI->replaceAllUsesWith(Val);
+  } else {
+    Value *Val = SI->getValueOperand();
+    if (Val->getType() != WordsTy)
+      Val = Builder.CreateBitCast(Val, WordsTy);
+    for (unsigned i = 0; i < NumWords; ++i) {
+      Value *Word = NumWords == 1 ? Val : Builder.CreateExtractElement(Val, i);
+      Builder.CreateAlignedStore(Word, Addresses[i], Align(4), IsVolatile);
+    }
+  }
+  access->eraseFromParent();
+}
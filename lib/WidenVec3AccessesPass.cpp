@@ -0,0 +1,163 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Widens the 3-element vector accesses made through a bitcast of a pointer to
+// a 4-element vector of the same element type, e.g.
+//   %p = bitcast <4 x float> addrspace(1)* %buf to <3 x float> addrspace(1)*
+//   %q = getelementptr <3 x float>, <3 x float> addrspace(1)* %p, i32 %i
+//   %v = load <3 x float>, <3 x float> addrspace(1)* %q
+// A vec3 is padded to the size of a vec4, so each such access covers the
+// first three lanes of a vec4 of the buffer. ReplacePointerBitcastPass would
+// split it into one access per lane. Instead this pass produces
+//   %q = getelementptr <4 x float>, <4 x float> addrspace(1)* %buf, i32 %i
+//   %w = load <4 x float>, <4 x float> addrspace(1)* %q
+//   %v = shufflevector <4 x float> %w, <4 x float> undef, <0, 1, 2>
+// and, for a store, loads the vec4, replaces its first three lanes and stores
+// it back. That store is not atomic with respect to the fourth lane, so the
+// pass only runs when -widen-vec3-accesses states that no other invocation
+// writes it concurrently.
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+#include "Passes.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "WidenVec3Accesses"
+
+namespace {
+struct WidenVec3AccessesPass : public FunctionPass {
+  static char ID;
+  WidenVec3AccessesPass() : FunctionPass(ID) {}
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  // Returns the address of the vec4 whose first three lanes |Ptr| points to,
+  // built at |Builder|, or null if |Ptr| is not such a pointer.
+  Value *getWidePointer(Value *Ptr, IRBuilder<> &Builder);
+};
+} // namespace
+
+char WidenVec3AccessesPass::ID = 0;
+INITIALIZE_PASS(WidenVec3AccessesPass, "WidenVec3Accesses",
+                "Widen Vec3 Accesses Pass", false, false)
+
+namespace clspv {
+FunctionPass *createWidenVec3AccessesPass() {
+  return new WidenVec3AccessesPass();
+}
+} // namespace clspv
+
+bool WidenVec3AccessesPass::runOnFunction(Function &F) {
+  SmallVector<Instruction *, 16> WorkList;
+  for (auto &BB : F) {
+    for (auto &I : BB) {
+      if (auto *load = dyn_cast<LoadInst>(&I)) {
+        if (load->isSimple())
+          WorkList.push_back(load);
+      } else if (auto *store = dyn_cast<StoreInst>(&I)) {
+        if (store->isSimple())
+          WorkList.push_back(store);
+      }
+    }
+  }
+
+  bool Changed = false;
+  SmallVector<Value *, 16> OldPointers;
+  for (auto *I : WorkList) {
+    IRBuilder<> Builder(I);
+    if (auto *load = dyn_cast<LoadInst>(I)) {
+      auto *Wide = getWidePointer(load->getPointerOperand(), Builder);
+      if (!Wide)
+        continue;
+
+      auto *WideTy = Wide->getType()->getPointerElementType();
+      auto *Narrow = Builder.CreateShuffleVector(
+          Builder.CreateLoad(Wide), UndefValue::get(WideTy), {0, 1, 2});
+      Narrow->takeName(load);
+      load->replaceAllUsesWith(Narrow);
+      OldPointers.push_back(load->getPointerOperand());
+    } else {
+      auto *store = cast<StoreInst>(I);
+      auto *Wide = getWidePointer(store->getPointerOperand(), Builder);
+      if (!Wide)
+        continue;
+
+      // Keep the fourth lane of the vec4 in memory. Widen the stored value to
+      // four lanes first, as both operands of a shuffle have the same type.
+      auto *Old = Builder.CreateLoad(Wide);
+      auto *Stored = store->getValueOperand();
+      auto *New = Builder.CreateShuffleVector(
+          Stored, UndefValue::get(Stored->getType()),
+          ArrayRef<int>{0, 1, 2, 3});
+      Builder.CreateStore(Builder.CreateShuffleVector(New, Old, {0, 1, 2, 7}),
+                          Wide);
+      OldPointers.push_back(store->getPointerOperand());
+    }
+    I->eraseFromParent();
+    Changed = true;
+  }
+
+  // Remove the vec3 pointers left without uses.
+  for (auto *Ptr : OldPointers) {
+    RecursivelyDeleteTriviallyDeadInstructions(Ptr);
+  }
+
+  return Changed;
+}
+
+Value *WidenVec3AccessesPass::getWidePointer(Value *Ptr,
+                                             IRBuilder<> &Builder) {
+  auto *VecTy =
+      dyn_cast<FixedVectorType>(Ptr->getType()->getPointerElementType());
+  if (!VecTy || VecTy->getNumElements() != 3)
+    return nullptr;
+
+  // Look through a single-index GEP, which steps over whole vec3s.
+  Value *Index = nullptr;
+  bool InBounds = false;
+  auto *GEP = dyn_cast<GetElementPtrInst>(Ptr);
+  if (GEP && GEP->getNumIndices() == 1) {
+    Index = GEP->getOperand(1);
+    InBounds = GEP->isInBounds();
+    Ptr = GEP->getPointerOperand();
+  }
+
+  auto *Cast = dyn_cast<BitCastInst>(Ptr);
+  if (!Cast)
+    return nullptr;
+  auto *Src = Cast->getOperand(0);
+  auto *WideTy =
+      dyn_cast<FixedVectorType>(Src->getType()->getPointerElementType());
+  if (!WideTy || WideTy->getNumElements() != 4 ||
+      WideTy->getElementType() != VecTy->getElementType())
+    return nullptr;
+
+  // The vec3 must be padded to exactly the vec4 for the lanes to line up.
+  const auto &DL = Cast->getModule()->getDataLayout();
+  if (DL.getTypeAllocSize(VecTy) != DL.getTypeAllocSize(WideTy))
+    return nullptr;
+
+  if (!Index)
+    return Src;
+  return InBounds ? Builder.CreateInBoundsGEP(Src, Index)
+                  : Builder.CreateGEP(Src, Index);
+}
@@ -12,13 +12,26 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+// Zero-initializes stack variables, so that a read of an uninitialized
+// variable yields zero. Parts of a variable that are provably written before
+// anything can read it are not zeroed: the instructions that must run after
+// the alloca, up to the first one that may read it, are scanned for stores
+// and memsets or memcpys at constant offsets.
+
+#include <algorithm>
 #include <utility>
+#include <vector>
 
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/UniqueVector.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
@@ -35,12 +48,63 @@ llvm::cl::opt<bool>
     no_zero_allocas("no-zero-allocas", llvm::cl::init(false),
                     llvm::cl::desc("Don't zero-initialize stack variables"));
 
+// The most instructions scanned after an alloca for the writes initializing
+// it.
+const unsigned kMaxScannedInstructions = 1024;
+
+// The most stores used to zero the uninitialized parts of an alloca. Beyond
+// this, the whole alloca is zeroed by a single store.
+const unsigned kMaxPartialStores = 16;
+
+// A range of bytes, [first, second).
+using ByteRange = std::pair<uint64_t, uint64_t>;
+
+// A part of an alloca to zero: the indices to it and its type.
+using AllocaPart = std::pair<SmallVector<Value *, 4>, Type *>;
+
 struct ZeroInitializeAllocasPass : public ModulePass {
   static char ID;
   ZeroInitializeAllocasPass() : ModulePass(ID) {}
 
   bool runOnModule(Module &M) override;
+
+private:
+  // Collects the pointers derived from |alloca| into |derived|, with their
+  // offset from |alloca| when it is constant. Returns true if any use of a
+  // derived pointer may read from the alloca.
+  bool CollectDerivedPointers(const DataLayout &DL, AllocaInst *alloca,
+                              DenseMap<Value *, Optional<uint64_t>> *derived);
+
+  // Returns the sorted, disjoint byte ranges of |alloca| that are written
+  // before anything may read them.
+  std::vector<ByteRange>
+  InitializedRanges(const DataLayout &DL, AllocaInst *alloca,
+                    const DenseMap<Value *, Optional<uint64_t>> &derived);
+
+  // Adds the parts of |type|, found at |offset| in the alloca by |indices|,
+  // that are not entirely in |initialized| to |parts|. Returns false if that
+  // takes more than kMaxPartialStores parts.
+  bool AddUninitializedParts(const DataLayout &DL, Type *type, uint64_t offset,
+                             SmallVectorImpl<Value *> &indices,
+                             const std::vector<ByteRange> &initialized,
+                             std::vector<AllocaPart> *parts);
 };
+
+// Returns the number of bytes of [begin, end) in the sorted, disjoint
+// |ranges|.
+uint64_t CoveredBytes(const std::vector<ByteRange> &ranges, uint64_t begin,
+                      uint64_t end) {
+  uint64_t covered = 0;
+  auto iter = std::upper_bound(
+      ranges.begin(), ranges.end(), begin,
+      [](uint64_t offset, const ByteRange &range) {
+        return offset < range.second;
+      });
+  for (; iter != ranges.end() && iter->first < end; ++iter) {
+    covered += std::min(iter->second, end) - std::max(iter->first, begin);
+  }
+  return covered;
+}
 } // namespace
 
 char ZeroInitializeAllocasPass::ID = 0;
@@ -69,12 +133,215 @@ bool ZeroInitializeAllocasPass::runOnModule(Module &M) {
     }
   }
 
+  const auto &DL = M.getDataLayout();
   for (AllocaInst *alloca : WorkList) {
     auto *valueTy = alloca->getType()->getPointerElementType();
-    auto *store = new StoreInst(Constant::getNullValue(valueTy), alloca, false,
-                                Align(alloca->getAlignment()));
-    store->insertAfter(alloca);
+
+    // Nothing to do if the alloca is never read.
+    DenseMap<Value *, Optional<uint64_t>> derived;
+    if (!CollectDerivedPointers(DL, alloca, &derived))
+      continue;
+
+    const auto initialized = InitializedRanges(DL, alloca, derived);
+    std::vector<AllocaPart> parts;
+    SmallVector<Value *, 4> indices{
+        ConstantInt::get(Type::getInt32Ty(M.getContext()), 0)};
+    if (initialized.empty() ||
+        !AddUninitializedParts(DL, valueTy, 0, indices, initialized, &parts)) {
+      parts.assign(1, AllocaPart({}, valueTy));
+    }
+
+    Instruction *insert_before = alloca->getNextNode();
+    for (const auto &part : parts) {
+      Value *ptr = alloca;
+      uint64_t offset = 0;
+      if (part.first.size() > 1) {
+        auto *gep = GetElementPtrInst::CreateInBounds(valueTy, alloca,
+                                                      part.first, "",
+                                                      insert_before);
+        APInt gep_offset(DL.getIndexTypeSizeInBits(gep->getType()), 0);
+        if (gep->accumulateConstantOffset(DL, gep_offset))
+          offset = gep_offset.getZExtValue();
+        ptr = gep;
+      }
+      new StoreInst(Constant::getNullValue(part.second), ptr, false,
+                    commonAlignment(Align(alloca->getAlignment()), offset),
+                    insert_before);
+      Changed = true;
+    }
   }
 
   return Changed;
 }
+
+bool ZeroInitializeAllocasPass::CollectDerivedPointers(
+    const DataLayout &DL, AllocaInst *alloca,
+    DenseMap<Value *, Optional<uint64_t>> *derived) {
+  bool reads = false;
+  SmallVector<Value *, 8> worklist{alloca};
+  (*derived)[alloca] = uint64_t(0);
+  while (!worklist.empty()) {
+    auto *ptr = worklist.pop_back_val();
+    const auto offset = (*derived)[ptr];
+    for (auto &use : ptr->uses()) {
+      auto *user = use.getUser();
+      if (auto *gep = dyn_cast<GetElementPtrInst>(user)) {
+        Optional<uint64_t> gep_offset;
+        APInt delta(DL.getIndexTypeSizeInBits(gep->getType()), 0);
+        if (offset && gep->accumulateConstantOffset(DL, delta) &&
+            !delta.isNegative())
+          gep_offset = *offset + delta.getZExtValue();
+        if (derived->try_emplace(gep, gep_offset).second)
+          worklist.push_back(gep);
+      } else if (isa<BitCastInst>(user)) {
+        if (derived->try_emplace(user, offset).second)
+          worklist.push_back(user);
+      } else if (auto *store = dyn_cast<StoreInst>(user)) {
+        // Storing the pointer itself lets it be read later.
+        reads |= use.getOperandNo() != store->getPointerOperandIndex();
+      } else if (auto *intrinsic = dyn_cast<IntrinsicInst>(user)) {
+        switch (intrinsic->getIntrinsicID()) {
+        case Intrinsic::lifetime_start:
+        case Intrinsic::lifetime_end:
+        case Intrinsic::memset:
+          break;
+        case Intrinsic::memcpy:
+          reads |= use.getOperandNo() != 0;
+          break;
+        default:
+          reads = true;
+          break;
+        }
+      } else {
+        reads = true;
+      }
+    }
+  }
+  return reads;
+}
+
+std::vector<ByteRange> ZeroInitializeAllocasPass::InitializedRanges(
+    const DataLayout &DL, AllocaInst *alloca,
+    const DenseMap<Value *, Optional<uint64_t>> &derived) {
+  auto derived_offset = [&derived](Value *value, bool *is_derived) {
+    auto iter = derived.find(value);
+    *is_derived = iter != derived.end();
+    return *is_derived ? iter->second : None;
+  };
+
+  // Scans the instructions that must run after the alloca: the rest of its
+  // block and the chain of blocks that can only be entered from the previous
+  // one.
+  std::vector<ByteRange> ranges;
+  SmallPtrSet<BasicBlock *, 8> visited;
+  unsigned scanned = 0;
+  Instruction *inst = alloca->getNextNode();
+  while (inst && scanned++ < kMaxScannedInstructions) {
+    bool is_derived = false;
+    if (auto *store = dyn_cast<StoreInst>(inst)) {
+      derived_offset(store->getValueOperand(), &is_derived);
+      if (is_derived)
+        break;
+      auto offset = derived_offset(store->getPointerOperand(), &is_derived);
+      if (offset) {
+        ranges.emplace_back(
+            *offset,
+            *offset + DL.getTypeStoreSize(store->getValueOperand()->getType()));
+      }
+    } else if (auto *mem = dyn_cast<MemIntrinsic>(inst)) {
+      if (auto *transfer = dyn_cast<MemTransferInst>(mem)) {
+        derived_offset(transfer->getRawSource(), &is_derived);
+        if (is_derived)
+          break;
+      }
+      auto offset = derived_offset(mem->getRawDest(), &is_derived);
+      auto *length = dyn_cast<ConstantInt>(mem->getLength());
+      if (offset && length)
+        ranges.emplace_back(*offset, *offset + length->getZExtValue());
+    } else if (inst->isLifetimeStartOrEnd()) {
+      // The markers are removed later on.
+    } else if (auto *branch = dyn_cast<BranchInst>(inst)) {
+      auto *next = branch->isUnconditional() ? branch->getSuccessor(0)
+                                             : nullptr;
+      if (!next || !next->getSinglePredecessor() ||
+          !visited.insert(next).second)
+        break;
+      inst = &next->front();
+      continue;
+    } else if (inst->isTerminator()) {
+      break;
+    } else if (!isa<GetElementPtrInst>(inst) && !isa<BitCastInst>(inst)) {
+      // Any other use of the alloca may read it, or let it escape to be read
+      // through another pointer. Instructions using only other pointers
+      // cannot read it.
+      bool reads = false;
+      for (auto &operand : inst->operands()) {
+        derived_offset(operand, &is_derived);
+        reads |= is_derived;
+      }
+      if (reads)
+        break;
+    }
+    inst = inst->getNextNode();
+  }
+
+  std::sort(ranges.begin(), ranges.end());
+  std::vector<ByteRange> merged;
+  for (const auto &range : ranges) {
+    if (!merged.empty() && range.first <= merged.back().second) {
+      merged.back().second = std::max(merged.back().second, range.second);
+    } else {
+      merged.push_back(range);
+    }
+  }
+  return merged;
+}
+
+bool ZeroInitializeAllocasPass::AddUninitializedParts(
+    const DataLayout &DL, Type *type, uint64_t offset,
+    SmallVectorImpl<Value *> &indices,
+    const std::vector<ByteRange> &initialized,
+    std::vector<AllocaPart> *parts) {
+  const uint64_t size = DL.getTypeStoreSize(type);
+  const uint64_t covered = CoveredBytes(initialized, offset, offset + size);
+  if (covered == size)
+    return true;
+
+  auto *i32 = Type::getInt32Ty(type->getContext());
+  auto add_element = [&](uint64_t index, Type *element_type,
+                         uint64_t element_offset) {
+    indices.push_back(ConstantInt::get(i32, index));
+    const bool ok = AddUninitializedParts(DL, element_type,
+                                          offset + element_offset, indices,
+                                          initialized, parts);
+    indices.pop_back();
+    return ok;
+  };
+
+  if (covered != 0) {
+    if (auto *struct_type = dyn_cast<StructType>(type)) {
+      const auto *layout = DL.getStructLayout(struct_type);
+      for (unsigned i = 0; i < struct_type->getNumElements(); ++i) {
+        if (!add_element(i, struct_type->getElementType(i),
+                         layout->getElementOffset(i)))
+          return false;
+      }
+      return true;
+    }
+    if (auto *array_type = dyn_cast<ArrayType>(type)) {
+      auto *element_type = array_type->getElementType();
+      const uint64_t stride = DL.getTypeAllocSize(element_type);
+      for (uint64_t i = 0; i < array_type->getNumElements(); ++i) {
+        if (!add_element(i, element_type, i * stride))
+          return false;
+      }
+      return true;
+    }
+  }
+
+  // Zero the whole of a scalar or vector that is partly initialized: the writes
+  // initializing it come later.
+  parts->emplace_back(SmallVector<Value *, 4>(indices.begin(), indices.end()),
+                      type);
+  return parts->size() <= kMaxPartialStores;
+}
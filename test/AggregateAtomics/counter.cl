@@ -0,0 +1,38 @@
+// RUN: clspv %s -o %t.spv -spv-version=1.3 -subgroup-atomic-aggregation
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.1 %t.spv
+
+// The increments of the shared counter are summed per subgroup, and the
+// lowest invocation adds the sum. Each invocation then gets its own slot from
+// the broadcast result and an exclusive scan. The atomic on a per-invocation
+// address is left alone.
+
+// CHECK-DAG: OpCapability GroupNonUniformArithmetic
+// CHECK-DAG: OpCapability GroupNonUniformShuffle
+// CHECK-DAG: [[uint:%[a-zA-Z0-9_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[uint_1:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 1
+// CHECK-DAG: [[uint_3:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 3
+// CHECK: [[id:%[a-zA-Z0-9_]+]] = OpLoad [[uint]]
+// CHECK: [[leader:%[a-zA-Z0-9_]+]] = OpGroupNonUniformUMin [[uint]] [[uint_3]] Reduce [[id]]
+// CHECK: [[total:%[a-zA-Z0-9_]+]] = OpGroupNonUniformIAdd [[uint]] [[uint_3]] Reduce [[uint_1]]
+// CHECK: [[prefix:%[a-zA-Z0-9_]+]] = OpGroupNonUniformIAdd [[uint]] [[uint_3]] ExclusiveScan [[uint_1]]
+// CHECK: [[is_leader:%[a-zA-Z0-9_]+]] = OpIEqual {{%[a-zA-Z0-9_]+}} [[id]] [[leader]]
+// CHECK: OpSelectionMerge
+// CHECK: OpBranchConditional [[is_leader]]
+// CHECK: [[old:%[a-zA-Z0-9_]+]] = OpAtomicIAdd [[uint]] {{%[a-zA-Z0-9_]+}} {{%[a-zA-Z0-9_]+}} {{%[a-zA-Z0-9_]+}} [[total]]
+// CHECK: [[phi:%[a-zA-Z0-9_]+]] = OpPhi [[uint]] [[old]]
+// CHECK: [[base:%[a-zA-Z0-9_]+]] = OpGroupNonUniformShuffle [[uint]] [[uint_3]] [[phi]] [[leader]]
+// CHECK: OpIAdd [[uint]] [[base]] [[prefix]]
+// CHECK: OpAtomicIIncrement [[uint]]
+// CHECK-NOT: OpAtomicIAdd
+
+kernel void compact(global const float *in, global float *out,
+                    global uint *count, global uint *histogram) {
+  uint i = get_global_id(0);
+  float value = in[i];
+  if (value > 0.0f) {
+    out[atomic_inc(&count[0])] = value;
+  }
+  atomic_inc(&histogram[i]);
+}
@@ -0,0 +1,17 @@
+// RUN: clspv %s -o %t.spv -int64-atomics
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable
+
+// CHECK-DAG: OpCapability Int64Atomics
+// CHECK-DAG: %[[ulong:[0-9a-zA-Z_]+]] = OpTypeInt 64 0
+// CHECK-DAG: %[[ulong_42:[0-9a-zA-Z_]+]] = OpConstant %[[ulong]] 42
+// CHECK:     %[[add:[0-9]+]] = OpAtomicIAdd %[[ulong]] {{.*}} %[[ulong_42]]
+// CHECK:     OpStore {{.*}} %[[add]]
+
+kernel void __attribute__((reqd_work_group_size(1, 1, 1))) foo(global long* a, global long* b)
+{
+    *a = atom_add(b, 42);
+}
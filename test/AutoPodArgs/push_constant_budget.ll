@@ -0,0 +1,46 @@
+; RUN: clspv-opt -AutoPodArgs -global-offset-push-constant -max-pushconstant-size=32 %s -o %t.ll
+; RUN: FileCheck %s --check-prefix=PUSH < %t.ll
+; RUN: clspv-opt -AutoPodArgs -global-offset -max-pushconstant-size=32 %s -o %t2.ll
+; RUN: FileCheck %s --check-prefix=SPEC < %t2.ll
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+; The global offset push constant shares the budget with the POD arguments:
+; @small and @medium fit after it in the shared block, @large does not. With
+; the global offset in specialization constants the whole budget is left for
+; per-kernel push constants.
+
+; PUSH: define spir_kernel void @small({{.*}}) !clspv.pod_args_impl [[GLOBAL:![0-9]+]]
+; PUSH: define spir_kernel void @medium({{.*}}) !clspv.pod_args_impl [[GLOBAL]]
+; PUSH: define spir_kernel void @large({{.*}}) !clspv.pod_args_impl [[UBO:![0-9]+]]
+; PUSH-DAG: [[GLOBAL]] = !{i32 3}
+; PUSH-DAG: [[UBO]] = !{i32 1}
+
+; SPEC: define spir_kernel void @small({{.*}}) !clspv.pod_args_impl [[PC:![0-9]+]]
+; SPEC: define spir_kernel void @medium({{.*}}) !clspv.pod_args_impl [[PC]]
+; SPEC: define spir_kernel void @large({{.*}}) !clspv.pod_args_impl [[PC]]
+; SPEC: [[PC]] = !{i32 2}
+
+define spir_kernel void @small(i32 addrspace(1)* %out, i32 %pod) {
+entry:
+  %gid = call i32 @_Z13get_global_idj(i32 0)
+  %add = add i32 %pod, %gid
+  store i32 %add, i32 addrspace(1)* %out
+  ret void
+}
+
+define spir_kernel void @medium(<4 x i32> addrspace(1)* %out, <4 x i32> %pod) {
+entry:
+  store <4 x i32> %pod, <4 x i32> addrspace(1)* %out
+  ret void
+}
+
+define spir_kernel void @large(<4 x i32> addrspace(1)* %out, <4 x i32> %a, <4 x i32> %b) {
+entry:
+  %add = add <4 x i32> %a, %b
+  store <4 x i32> %add, <4 x i32> addrspace(1)* %out
+  ret void
+}
+
+declare i32 @_Z13get_global_idj(i32)
@@ -0,0 +1,25 @@
+// RUN: clspv %s -o %t.spv -buffer-alias-decorations
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck --check-prefix=NONE %s < %t2.spvasm
+
+// The restrict arguments are Restrict, the other one may alias them.
+// CHECK-DAG: OpDecorate %[[out:[0-9a-zA-Z_]+]] Binding 0
+// CHECK-DAG: OpDecorate %[[in:[0-9a-zA-Z_]+]] Binding 1
+// CHECK-DAG: OpDecorate %[[other:[0-9a-zA-Z_]+]] Binding 2
+// CHECK-DAG: OpDecorate %[[out]] Restrict
+// CHECK-DAG: OpDecorate %[[in]] Restrict
+// CHECK-DAG: OpDecorate %[[other]] Aliased
+
+// NONE-NOT: Restrict
+// NONE-NOT: Aliased
+
+kernel void foo(global float *restrict out, global const float *restrict in,
+                global int *other) {
+  uint i = get_global_id(0);
+  out[i] = in[i] * 2.0f;
+  other[i] = 1;
+}
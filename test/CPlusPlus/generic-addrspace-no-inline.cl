@@ -0,0 +1,23 @@
+// RUN: clspv -cl-std=CLC++ %s -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// Without -inline-entry-points, fill is specialized by the address space of
+// its argument and no variable pointers are needed.
+// CHECK-NOT: OpCapability VariablePointers
+// CHECK-DAG: %[[uint:[0-9a-zA-Z_]+]] = OpTypeInt 32 0
+// CHECK-DAG: %[[_ptr_StorageBuffer_uint:[0-9a-zA-Z_]+]] = OpTypePointer StorageBuffer %[[uint]]
+// CHECK-DAG: %[[_ptr_Workgroup_uint:[0-9a-zA-Z_]+]] = OpTypePointer Workgroup %[[uint]]
+// CHECK-DAG: %[[uint_42:[0-9a-zA-Z_]+]] = OpConstant %[[uint]] 42
+// CHECK:     OpStore {{.*}} %[[uint_42]]
+// CHECK:     OpStore {{.*}} %[[uint_42]]
+
+__attribute__((noinline)) void fill(int* out) {
+    *out = 42;
+}
+
+void kernel test(global int* gout, local int* lout) {
+    fill(gout);
+    fill(lout);
+}
@@ -0,0 +1,19 @@
+// RUN: clspv %s -o %t.spv -cost-report=%t.json
+// RUN: spirv-dis -o %t.spvasm %t.spv
+// RUN: FileCheck %s < %t.spvasm
+// RUN: FileCheck -check-prefix=REPORT %s < %t.json
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// Each invocation only reads and writes its own element of |data|, so no
+// invocation reads what another wrote across the barrier.
+
+__attribute__((reqd_work_group_size(64, 1, 1)))
+kernel void foo(global int *data, global int *other) {
+  size_t i = get_global_id(0);
+  int x = data[i];
+  barrier(CLK_GLOBAL_MEM_FENCE);
+  data[i] = x + other[0];
+}
+
+// CHECK-NOT: OpDecorate {{.*}} Coherent
+// REPORT: "coherent_resources": 0
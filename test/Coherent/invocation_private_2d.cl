@@ -0,0 +1,19 @@
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-dis -o %t.spvasm %t.spv
+// RUN: FileCheck %s < %t.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The invocations of a row of the workgroup share the element indexed by
+// their x coordinate.
+
+__attribute__((reqd_work_group_size(8, 8, 1)))
+kernel void foo(global int *data) {
+  size_t i = get_global_id(0);
+  int x = data[i];
+  barrier(CLK_GLOBAL_MEM_FENCE);
+  data[i] = x + 1;
+}
+
+// CHECK: OpDecorate [[var:%[a-zA-Z0-9_]+]] DescriptorSet 0
+// CHECK: OpDecorate [[var]] Binding 0
+// CHECK: OpDecorate [[var]] Coherent
@@ -0,0 +1,20 @@
+// RUN: clspv %s -o %t.spv -cost-report=%t.json
+// RUN: spirv-dis -o %t.spvasm %t.spv
+// RUN: FileCheck %s < %t.spvasm
+// RUN: FileCheck -check-prefix=REPORT %s < %t.json
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// Each invocation reads the element its neighbour wrote before the barrier.
+
+__attribute__((reqd_work_group_size(64, 1, 1)))
+kernel void foo(global int *data) {
+  size_t i = get_global_id(0);
+  data[i] = 1;
+  barrier(CLK_GLOBAL_MEM_FENCE);
+  data[i] += data[i + 1];
+}
+
+// CHECK: OpDecorate [[var:%[a-zA-Z0-9_]+]] DescriptorSet 0
+// CHECK: OpDecorate [[var]] Binding 0
+// CHECK: OpDecorate [[var]] Coherent
+// REPORT: "coherent_resources": 1
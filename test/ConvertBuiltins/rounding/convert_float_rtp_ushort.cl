@@ -0,0 +1,16 @@
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// Every ushort is a float, so the rounding mode does not matter.
+
+// CHECK-DAG: %[[float:[0-9a-zA-Z_]+]] = OpTypeFloat 32
+// CHECK:     %[[converted:[0-9]+]] = OpConvertUToF %[[float]]
+// CHECK-NOT: OpBitcast
+// CHECK:     OpStore {{%[0-9a-zA-Z_]+}} %[[converted]]
+
+kernel void __attribute__((reqd_work_group_size(1, 1, 1))) foo(global float* dst, global ushort* src)
+{
+    *dst = convert_float_rtp(*src);
+}
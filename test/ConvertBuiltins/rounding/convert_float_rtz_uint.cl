@@ -0,0 +1,30 @@
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The conversion rounds to nearest. A result greater than the source is
+// replaced by the float before it. 2^32 is the only result out of range.
+
+// CHECK-DAG: %[[glsl:[0-9a-zA-Z_]+]] = OpExtInstImport "GLSL.std.450"
+// CHECK-DAG: %[[uint:[0-9a-zA-Z_]+]] = OpTypeInt 32 0
+// CHECK-DAG: %[[float:[0-9a-zA-Z_]+]] = OpTypeFloat 32
+// CHECK-DAG: %[[bool:[0-9a-zA-Z_]+]] = OpTypeBool
+// CHECK-DAG: %[[uint_max:[0-9a-zA-Z_]+]] = OpConstant %[[uint]] 4294967295
+// CHECK-DAG: %[[limit:[0-9a-zA-Z_]+]] = OpConstant %[[float]] 4.2949673{{[0-9]*}}e+09
+// CHECK-DAG: %[[below:[0-9a-zA-Z_]+]] = OpConstant %[[float]] 4.2949670{{[0-9]*}}e+09
+// CHECK:     %[[src:[0-9]+]] = OpLoad %[[uint]]
+// CHECK:     %[[nearest:[0-9]+]] = OpConvertUToF %[[float]] %[[src]]
+// CHECK-DAG: OpFOrdGreaterThanEqual %[[bool]] %[[nearest]] %[[limit]]
+// CHECK-DAG: %[[min:[0-9]+]] = OpExtInst %[[float]] %[[glsl]] FMin %[[nearest]] %[[below]]
+// CHECK-DAG: %[[back:[0-9]+]] = OpConvertFToU %[[uint]] %[[min]]
+// CHECK-DAG: OpUGreaterThan %[[bool]] %[[back]] %[[src]]
+// CHECK-DAG: %[[bits:[0-9]+]] = OpBitcast %[[uint]] %[[nearest]]
+// CHECK-DAG: %[[prev:[0-9]+]] = OpIAdd %[[uint]] %[[bits]] %[[uint_max]]
+// CHECK-DAG: %[[prev_float:[0-9]+]] = OpBitcast %[[float]] %[[prev]]
+// CHECK:     OpSelect %[[float]] {{%[0-9a-zA-Z_]+}} %[[prev_float]] %[[nearest]]
+
+kernel void __attribute__((reqd_work_group_size(1, 1, 1))) foo(global float* dst, global uint* src)
+{
+    *dst = convert_float_rtz(*src);
+}
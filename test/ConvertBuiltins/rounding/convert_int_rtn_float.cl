@@ -0,0 +1,16 @@
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// CHECK-DAG: %[[glsl:[0-9a-zA-Z_]+]] = OpExtInstImport "GLSL.std.450"
+// CHECK-DAG: %[[uint:[0-9a-zA-Z_]+]] = OpTypeInt 32 0
+// CHECK-DAG: %[[float:[0-9a-zA-Z_]+]] = OpTypeFloat 32
+// CHECK:     %[[src:[0-9]+]] = OpLoad %[[float]]
+// CHECK:     %[[floor:[0-9]+]] = OpExtInst %[[float]] %[[glsl]] Floor %[[src]]
+// CHECK:     OpConvertFToS %[[uint]] %[[floor]]
+
+kernel void __attribute__((reqd_work_group_size(1, 1, 1))) foo(global int* dst, global float* src)
+{
+    *dst = convert_int_rtn(*src);
+}
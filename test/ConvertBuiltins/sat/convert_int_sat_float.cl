@@ -0,0 +1,28 @@
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// INT_MAX is not a float: the clamp stops at the float below it, and the
+// values above that saturate to INT_MAX with a select. INT_MIN is a float.
+
+// CHECK-DAG: %[[glsl:[0-9a-zA-Z_]+]] = OpExtInstImport "GLSL.std.450"
+// CHECK-DAG: %[[uint:[0-9a-zA-Z_]+]] = OpTypeInt 32 0
+// CHECK-DAG: %[[float:[0-9a-zA-Z_]+]] = OpTypeFloat 32
+// CHECK-DAG: %[[bool:[0-9a-zA-Z_]+]] = OpTypeBool
+// CHECK-DAG: %[[int_max:[0-9a-zA-Z_]+]] = OpConstant %[[uint]] 2147483647
+// CHECK-DAG: %[[float_min:[0-9a-zA-Z_]+]] = OpConstant %[[float]] -2.1474836{{[0-9]*}}e+09
+// CHECK-DAG: %[[float_max:[0-9a-zA-Z_]+]] = OpConstant %[[float]] 2.1474835{{[0-9]*}}e+09
+// CHECK:     %[[src:[0-9]+]] = OpLoad %[[float]]
+// CHECK:     %[[clamped:[0-9]+]] = OpExtInst %[[float]] %[[glsl]] FClamp %[[src]] %[[float_min]] %[[float_max]]
+// CHECK:     %[[converted:[0-9]+]] = OpConvertFToS %[[uint]] %[[clamped]]
+// CHECK:     %[[above:[0-9]+]] = OpFOrdGreaterThan %[[bool]] %[[src]] %[[float_max]]
+// CHECK:     %[[saturated:[0-9]+]] = OpSelect %[[uint]] %[[above]] %[[int_max]] %[[converted]]
+// CHECK-NOT: OpFOrdLessThan
+// CHECK:     %[[nan:[0-9]+]] = OpIsNan %[[bool]] %[[src]]
+// CHECK:     OpSelect %[[uint]] %[[nan]] {{%[0-9a-zA-Z_]+}} %[[saturated]]
+
+kernel void __attribute__((reqd_work_group_size(1, 1, 1))) foo(global int* dst, global float* src)
+{
+    *dst = convert_int_sat(*src);
+}
@@ -0,0 +1,18 @@
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// CHECK-DAG: %[[glsl:[0-9a-zA-Z_]+]] = OpExtInstImport "GLSL.std.450"
+// CHECK-DAG: %[[ushort:[0-9a-zA-Z_]+]] = OpTypeInt 16 0
+// CHECK-DAG: %[[uint:[0-9a-zA-Z_]+]] = OpTypeInt 32 0
+// CHECK-DAG: %[[uint_min:[0-9a-zA-Z_]+]] = OpConstant %[[uint]] 4294934528
+// CHECK-DAG: %[[uint_max:[0-9a-zA-Z_]+]] = OpConstant %[[uint]] 32767
+// CHECK:     %[[src:[0-9]+]] = OpLoad %[[uint]]
+// CHECK:     %[[clamped:[0-9]+]] = OpExtInst %[[uint]] %[[glsl]] SClamp %[[src]] %[[uint_min]] %[[uint_max]]
+// CHECK:     OpUConvert %[[ushort]] %[[clamped]]
+
+kernel void __attribute__((reqd_work_group_size(1, 1, 1))) foo(global short* dst, global int* src)
+{
+    *dst = convert_short_sat(*src);
+}
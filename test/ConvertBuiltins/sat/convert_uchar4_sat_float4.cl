@@ -0,0 +1,28 @@
+// RUN: clspv -int8 %s -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// 0 and 255 are floats, so clamping makes the conversion exact. NaN is
+// selected to 0.
+
+// CHECK-DAG: %[[glsl:[0-9a-zA-Z_]+]] = OpExtInstImport "GLSL.std.450"
+// CHECK-DAG: %[[uchar:[0-9a-zA-Z_]+]] = OpTypeInt 8 0
+// CHECK-DAG: %[[v4uchar:[0-9a-zA-Z_]+]] = OpTypeVector %[[uchar]] 4
+// CHECK-DAG: %[[float:[0-9a-zA-Z_]+]] = OpTypeFloat 32
+// CHECK-DAG: %[[v4float:[0-9a-zA-Z_]+]] = OpTypeVector %[[float]] 4
+// CHECK-DAG: %[[bool:[0-9a-zA-Z_]+]] = OpTypeBool
+// CHECK-DAG: %[[v4bool:[0-9a-zA-Z_]+]] = OpTypeVector %[[bool]] 4
+// CHECK-DAG: %[[float_255:[0-9a-zA-Z_]+]] = OpConstant %[[float]] 255
+// CHECK-DAG: %[[v4float_255:[0-9a-zA-Z_]+]] = OpConstantComposite %[[v4float]] %[[float_255]] %[[float_255]] %[[float_255]] %[[float_255]]
+// CHECK:     %[[src:[0-9]+]] = OpLoad %[[v4float]]
+// CHECK:     %[[clamped:[0-9]+]] = OpExtInst %[[v4float]] %[[glsl]] FClamp %[[src]] {{%[0-9a-zA-Z_]+}} %[[v4float_255]]
+// CHECK:     %[[converted:[0-9]+]] = OpConvertFToU %[[v4uchar]] %[[clamped]]
+// CHECK:     %[[nan:[0-9]+]] = OpIsNan %[[v4bool]] %[[src]]
+// CHECK:     OpSelect %[[v4uchar]] %[[nan]] {{%[0-9a-zA-Z_]+}} %[[converted]]
+// CHECK-NOT: OpFOrdGreaterThan
+
+kernel void __attribute__((reqd_work_group_size(1, 1, 1))) foo(global uchar4* dst, global float4* src)
+{
+    *dst = convert_uchar4_sat(*src);
+}
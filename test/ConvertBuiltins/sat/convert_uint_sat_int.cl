@@ -0,0 +1,18 @@
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// Only the negative values are out of range.
+
+// CHECK-DAG: %[[glsl:[0-9a-zA-Z_]+]] = OpExtInstImport "GLSL.std.450"
+// CHECK-DAG: %[[uint:[0-9a-zA-Z_]+]] = OpTypeInt 32 0
+// CHECK-DAG: %[[uint_0:[0-9a-zA-Z_]+]] = OpConstant %[[uint]] 0
+// CHECK:     %[[src:[0-9]+]] = OpLoad %[[uint]]
+// CHECK:     %[[max:[0-9]+]] = OpExtInst %[[uint]] %[[glsl]] SMax %[[src]] %[[uint_0]]
+// CHECK:     OpStore {{%[0-9a-zA-Z_]+}} %[[max]]
+
+kernel void __attribute__((reqd_work_group_size(1, 1, 1))) foo(global uint* dst, global int* src)
+{
+    *dst = convert_uint_sat(*src);
+}
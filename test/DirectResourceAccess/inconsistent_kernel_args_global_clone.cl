@@ -0,0 +1,30 @@
+// RUN: clspv %s -o %t.spv -keep-unused-arguments -cluster-pod-kernel-args=0 -dra-clone-limit=100
+// RUN: spirv-dis -o %t.spvasm %t.spv
+// RUN: FileCheck %s < %t.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+//
+// RUN: clspv %s -o %t2.spv -keep-unused-arguments -cluster-pod-kernel-args=0 -dra-clone-limit=1
+// RUN: spirv-dis -o %t2.spvasm %t2.spv
+// RUN: FileCheck --check-prefix=LIMIT %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t2.spv
+
+void apple(global int *B, global int *A, int n) { A[n] = B[n + 2]; }
+
+kernel void foo(global int *A, global int *B, int n) { apple(B, A, n); }
+
+kernel void bar(global int *A, int n, global int *B) { apple(B, A, n); }
+
+// foo and bar pass different resources, so each gets its own copy of apple
+// that accesses them directly.
+// CHECK-DAG: [[int:%[a-zA-Z0-9_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[ptr:%[a-zA-Z0-9_]+]] = OpTypePointer StorageBuffer [[int]]
+// CHECK-NOT: OpFunctionParameter [[ptr]]
+// CHECK: OpFunctionParameter [[int]]
+// CHECK-NOT: OpFunctionParameter [[ptr]]
+// CHECK: OpFunctionParameter [[int]]
+// CHECK-NOT: OpFunctionParameter [[ptr]]
+
+// A limit smaller than apple leaves the pointer parameters.
+// LIMIT-DAG: [[int:%[a-zA-Z0-9_]+]] = OpTypeInt 32 0
+// LIMIT-DAG: [[ptr:%[a-zA-Z0-9_]+]] = OpTypePointer StorageBuffer [[int]]
+// LIMIT: OpFunctionParameter [[ptr]]
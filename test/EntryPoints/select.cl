@@ -0,0 +1,15 @@
+// RUN: clspv %s -o %t.spv -entry-points=foo,baz
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm --implicit-check-not='"bar"' --implicit-check-not=Sin
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// CHECK-DAG: OpEntryPoint GLCompute %{{[a-zA-Z0-9_]+}} "foo"
+// CHECK-DAG: OpEntryPoint GLCompute %{{[a-zA-Z0-9_]+}} "baz"
+
+float only_bar(float x) { return sin(x); }
+
+kernel void foo(global float *out, float in) { out[0] = in + 1.0f; }
+
+kernel void bar(global float *out, float in) { out[0] = only_bar(in); }
+
+kernel void baz(global float *out, float in) { out[0] = in * 2.0f; }
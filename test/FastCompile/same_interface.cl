@@ -0,0 +1,30 @@
+// RUN: clspv %s -o %t.fast.spv -Ofast
+// RUN: spirv-val --target-env vulkan1.0 %t.fast.spv
+// RUN: clspv-reflection %t.fast.spv -o %t.fast.map
+// RUN: clspv %s -o %t.spv -O3
+// RUN: clspv-reflection %t.spv -o %t.map
+// RUN: diff %t.fast.map %t.map
+// RUN: FileCheck %s < %t.fast.map
+
+// A kernel compiled with -Ofast can be replaced by the same kernel compiled
+// with -O3 without changing the pipeline layout.
+
+// CHECK: kernel,foo,arg,out,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,buffer
+// CHECK: kernel,foo,arg,in,argOrdinal,1,descriptorSet,0,binding,1,offset,0,argKind,buffer
+// CHECK: kernel,foo,arg,n,argOrdinal,2,{{.*}}argKind,pod
+
+typedef struct {
+  float a;
+  int b;
+} S;
+
+float scale(S s, float x) { return s.a * x + s.b; }
+
+kernel void foo(global float *out, global float *in, int n) {
+  S s = {2.0f, n};
+  float sum = 0.0f;
+  for (int i = 0; i < n; ++i) {
+    sum += scale(s, in[i]);
+  }
+  out[get_global_id(0)] = sum;
+}
@@ -0,0 +1,5 @@
+// RUN: not clspv %s -o %t.spv -Ofaster 2>&1 | FileCheck %s
+
+// CHECK: Unknown optimization level -Ofaster specified!
+
+kernel void foo(global int *out) { *out = 0; }
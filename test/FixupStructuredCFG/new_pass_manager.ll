@@ -0,0 +1,42 @@
+; RUN: clspv-opt -passes=FixupStructuredCFG %s -o %t
+; RUN: FileCheck %s < %t
+; RUN: clspv-opt -passes='legacy<FixupStructuredCFG>' %s -o %t2
+; RUN: FileCheck %s < %t2
+; RUN: clspv-opt -passes='function(FixupStructuredCFG,ReorderBasicBlocks)' %s -o %t3
+; RUN: FileCheck --check-prefix=REORDER %s < %t3
+
+; The new pass manager version of the pass, and the legacy pass run through
+; the adaptor, give the inner loop its own merge block.
+; CHECK-LABEL: @foo
+; CHECK: inner:
+; CHECK-NEXT: br i1 undef, label %inner, label %[[new:[a-zA-Z0-9_]+]]
+; CHECK: [[new]]:
+; CHECK-NEXT: br label %outer_latch
+; CHECK: outer_latch:
+; CHECK-NEXT: br i1 undef, label %outer, label %exit
+
+; Both passes share the analyses of the function.
+; REORDER-LABEL: @foo
+; REORDER: br i1 undef, label %inner, label %[[new:[a-zA-Z0-9_]+]]
+; REORDER: [[new]]:
+; REORDER-NEXT: br label %outer_latch
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+define spir_kernel void @foo(i32 %x) {
+entry:
+  br label %outer
+
+outer:
+  br i1 undef, label %inner, label %outer_latch
+
+inner:
+  br i1 undef, label %inner, label %outer_latch
+
+outer_latch:
+  br i1 undef, label %outer, label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,36 @@
+// RUN: clspv %s -o %t.spv -fuse-kernels=scale:1:bias:0,scale_bias:3:clamp_to:0
+// RUN: clspv-reflection %t.spv -o %t.map
+// RUN: FileCheck -check-prefix=MAP %s < %t.map
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The fused kernels are added next to the original ones, and a fused kernel
+// can be fused again. The arguments of the second kernel follow those of the
+// first, without the shared buffer.
+
+// CHECK-DAG: OpEntryPoint GLCompute %{{[a-zA-Z0-9_]+}} "scale"
+// CHECK-DAG: OpEntryPoint GLCompute %{{[a-zA-Z0-9_]+}} "bias"
+// CHECK-DAG: OpEntryPoint GLCompute %{{[a-zA-Z0-9_]+}} "clamp_to"
+// CHECK-DAG: OpEntryPoint GLCompute %{{[a-zA-Z0-9_]+}} "scale_bias"
+// CHECK-DAG: OpEntryPoint GLCompute %{{[a-zA-Z0-9_]+}} "scale_bias_clamp_to"
+
+// MAP: kernel_decl,scale_bias_clamp_to
+// MAP-NEXT: kernel,scale_bias_clamp_to,arg,in,argOrdinal,0,
+// MAP-NEXT: kernel,scale_bias_clamp_to,arg,tmp,argOrdinal,1,
+// MAP-NEXT: kernel,scale_bias_clamp_to,arg,s,argOrdinal,2,
+// MAP-NEXT: kernel,scale_bias_clamp_to,arg,out,argOrdinal,3,
+// MAP-NEXT: kernel,scale_bias_clamp_to,arg,b,argOrdinal,4,
+// MAP-NEXT: kernel,scale_bias_clamp_to,arg,hi,argOrdinal,5,
+
+kernel void scale(global float *in, global float *tmp, float s) {
+  tmp[get_global_id(0)] = in[get_global_id(0)] * s;
+}
+
+kernel void bias(global float *tmp, global float *out, float b) {
+  out[get_global_id(0)] = tmp[get_global_id(0)] + b;
+}
+
+kernel void clamp_to(global float *data, float hi) {
+  data[get_global_id(0)] = fmin(data[get_global_id(0)], hi);
+}
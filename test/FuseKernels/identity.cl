@@ -0,0 +1,33 @@
+// RUN: clspv %s -o %t.spv -fuse-kernels=add_one:1:square:0 -entry-points=add_one_square
+// RUN: clspv-reflection %t.spv -o %t.map
+// RUN: FileCheck -check-prefix=MAP %s < %t.map
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// tmp is shared by both bodies and the value stored to it is reused by the
+// second body instead of being loaded back.
+
+// MAP: kernel_decl,add_one_square
+// MAP: kernel,add_one_square,arg,in,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,buffer
+// MAP: kernel,add_one_square,arg,tmp,argOrdinal,1,descriptorSet,0,binding,1,offset,0,argKind,buffer
+// MAP: kernel,add_one_square,arg,out,argOrdinal,2,descriptorSet,0,binding,2,offset,0,argKind,buffer
+// MAP-NOT: kernel_decl
+
+// CHECK: OpEntryPoint GLCompute %{{[a-zA-Z0-9_]+}} "add_one_square"
+// CHECK-NOT: OpEntryPoint
+// CHECK: [[float:%[a-zA-Z0-9_]+]] = OpTypeFloat 32
+// CHECK: [[ld:%[a-zA-Z0-9_]+]] = OpLoad [[float]]
+// CHECK: [[add:%[a-zA-Z0-9_]+]] = OpFAdd [[float]] [[ld]]
+// CHECK: OpStore {{%[a-zA-Z0-9_]+}} [[add]]
+// CHECK-NOT: OpLoad
+// CHECK: OpFMul [[float]] [[add]] [[add]]
+
+kernel void add_one(global float *in, global float *tmp) {
+  size_t i = get_global_id(0);
+  tmp[i] = in[i] + 1.0f;
+}
+
+kernel void square(global float *tmp, global float *out) {
+  out[get_global_id(0)] = tmp[get_global_id(0)] * tmp[get_global_id(0)];
+}
@@ -0,0 +1,29 @@
+// RUN: clspv %s -o %t.spv -hoist-access-chains
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The load of tile[3] stays in the loop, as the loop stores to tile, but its
+// access chain is computed once before the loop and reused after it.
+
+// CHECK-DAG: [[uint:%[a-zA-Z0-9_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[uint_3:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 3
+// CHECK-DAG: [[tile:%[a-zA-Z0-9_]+]] = OpVariable {{%[a-zA-Z0-9_]+}} Workgroup
+// CHECK: [[tile_3:%[a-zA-Z0-9_]+]] = OpAccessChain {{%[a-zA-Z0-9_]+}} [[tile]] [[uint_3]]
+// CHECK: OpLoopMerge
+// CHECK-NOT: OpAccessChain {{%[a-zA-Z0-9_]+}} [[tile]] [[uint_3]]
+// CHECK: OpLoad [[uint]] [[tile_3]]
+// CHECK-NOT: OpAccessChain {{%[a-zA-Z0-9_]+}} [[tile]] [[uint_3]]
+// CHECK: OpLoad [[uint]] [[tile_3]]
+
+kernel void foo(global int *out, int n) {
+  local int tile[64];
+  tile[get_local_id(0)] = n;
+  barrier(CLK_LOCAL_MEM_FENCE);
+  int sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += tile[3];
+    tile[i & 63] = i;
+  }
+  out[0] = sum + tile[3];
+}
@@ -42,7 +42,7 @@
 // CHECK: [[image:%[a-zA-Z0-9_]+]] = OpLoad [[f_ro_image]]
 // CHECK: [[sample:%[a-zA-Z0-9_]+]] = OpSampledImage [[f_sampled]] [[image]]
 // CHECK: OpImageSampleExplicitLod [[float4]] [[sample]] {{.*}} Lod [[float_0]]
-// CHECK: [[sample:%[a-zA-Z0-9_]+]] = OpSampledImage [[f_sampled]] [[image]]
+// CHECK-NOT: OpSampledImage
 // CHECK: OpImageSampleExplicitLod [[float4]] [[sample]] {{.*}} Lod [[float_0]]
 // CHECK: OpImageFetch [[float4]] [[image]] {{.*}} Lod [[uint_0]]
 kernel void read_float(read_only image2d_array_t image, sampler_t s, global float4* out) {
@@ -62,7 +62,7 @@ kernel void write_float(write_only image2d_array_t image) {
 // CHECK: [[image:%[a-zA-Z0-9_]+]] = OpLoad [[u_ro_image]]
 // CHECK: [[sample:%[a-zA-Z0-9_]+]] = OpSampledImage [[u_sampled]] [[image]]
 // CHECK: OpImageSampleExplicitLod [[uint4]] [[sample]] {{.*}} Lod [[float_0]]
-// CHECK: [[sample:%[a-zA-Z0-9_]+]] = OpSampledImage [[u_sampled]] [[image]]
+// CHECK-NOT: OpSampledImage
 // CHECK: OpImageSampleExplicitLod [[uint4]] [[sample]] {{.*}} Lod [[float_0]]
 // CHECK: OpImageFetch [[uint4]] [[image]] {{.*}} Lod [[uint_0]]
 kernel void read_uint(read_only image2d_array_t image, sampler_t s, global uint4* out) {
@@ -83,7 +83,7 @@ kernel void write_uint(write_only image2d_array_t image) {
 // CHECK: [[sample:%[a-zA-Z0-9_]+]] = OpSampledImage [[i_sampled]] [[image]]
 // CHECK: [[read:%[a-zA-Z0-9_]+]] = OpImageSampleExplicitLod [[int4]] [[sample]] {{.*}} Lod [[float_0]]
 // CHECK: OpBitcast [[uint4]] [[read]]
-// CHECK: [[sample:%[a-zA-Z0-9_]+]] = OpSampledImage [[i_sampled]] [[image]]
+// CHECK-NOT: OpSampledImage
 // CHECK: [[read:%[a-zA-Z0-9_]+]] = OpImageSampleExplicitLod [[int4]] [[sample]] {{.*}} Lod [[float_0]]
 // CHECK: OpBitcast [[uint4]] [[read]]
 // CHECK: [[read:%[a-zA-Z0-9_]+]] = OpImageFetch [[int4]] [[image]] {{.*}} Lod [[uint_0]]
@@ -107,7 +107,7 @@ kernel void write_int(write_only image2d_array_t image) {
 // CHECK: [[sample:%[a-zA-Z0-9_]+]] = OpSampledImage [[f_sampled]] [[image]]
 // CHECK: [[read:%[a-zA-Z0-9_]+]] = OpImageSampleExplicitLod [[float4]] [[sample]] {{.*}} Lod [[float_0]]
 // CHECK: OpFConvert [[half4]] [[read]]
-// CHECK: [[sample:%[a-zA-Z0-9_]+]] = OpSampledImage [[f_sampled]] [[image]]
+// CHECK-NOT: OpSampledImage
 // CHECK: [[read:%[a-zA-Z0-9_]+]] = OpImageSampleExplicitLod [[float4]] [[sample]] {{.*}} Lod [[float_0]]
 // CHECK: OpFConvert [[half4]] [[read]]
 // CHECK: [[read:%[a-zA-Z0-9_]+]] = OpImageFetch [[float4]] [[image]] {{.*}} Lod [[uint_0]]
@@ -0,0 +1,22 @@
+// RUN: clspv %s -o %t.spv -image-fetch-int-coords
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The sampler is not needed to read texels directly.
+// CHECK-NOT: OpTypeSampler
+// CHECK-NOT: OpSampledImage
+// CHECK-NOT: OpImageSampleExplicitLod
+// CHECK-DAG: [[float:%[0-9a-zA-Z_]+]] = OpTypeFloat 32
+// CHECK-DAG: [[image:%[0-9a-zA-Z_]+]] = OpTypeImage [[float]] 2D 0 0 0 1 Unknown
+// CHECK-DAG: [[v4float:%[0-9a-zA-Z_]+]] = OpTypeVector [[float]] 4
+// CHECK: [[im:%[0-9a-zA-Z_]+]] = OpLoad [[image]]
+// CHECK: OpImageFetch [[v4float]] [[im]]
+
+const sampler_t sampler =
+    CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_NONE | CLK_FILTER_NEAREST;
+
+void kernel __attribute__((reqd_work_group_size(1, 1, 1)))
+foo(read_only image2d_t i, int2 c, global float4 *a) {
+  *a = read_imagef(i, sampler, c);
+}
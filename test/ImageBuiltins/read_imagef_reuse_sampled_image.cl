@@ -0,0 +1,22 @@
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// Reads of the same image with the same sampler in one block share a single
+// OpSampledImage.
+
+// CHECK: [[sample:%[a-zA-Z0-9_]+]] = OpSampledImage
+// CHECK: OpImageSampleExplicitLod {{.*}} [[sample]]
+// CHECK-NOT: OpSampledImage
+// CHECK: OpImageSampleExplicitLod {{.*}} [[sample]]
+// CHECK-NOT: OpSampledImage
+// CHECK: OpImageSampleExplicitLod {{.*}} [[sample]]
+
+kernel void foo(read_only image2d_t im, sampler_t s, global float4 *out,
+                float2 c) {
+  float4 a = read_imagef(im, s, c);
+  float4 b = read_imagef(im, s, c + (float2)(1.0f, 0.0f));
+  float4 d = read_imagef(im, s, c + (float2)(0.0f, 1.0f));
+  *out = a + b + d;
+}
@@ -0,0 +1,58 @@
+; RUN: clspv-opt -ReplaceOpenCLBuiltin -image-fetch-int-coords %s -o %t
+; RUN: FileCheck %s < %t
+
+; CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_NONE | CLK_FILTER_NEAREST
+; CHECK: call <4 x float> @_Z11read_imagef14ocl_image2d_roDv2_i(%opencl.image2d_ro_t addrspace(1)* %im2d, <2 x i32> <i32 3, i32 7>)
+; CHECK: call <4 x i32> @_Z11read_imagei14ocl_image3d_roDv4_i(%opencl.image3d_ro_t addrspace(1)* %im3d, <4 x i32> <i32 3, i32 7, i32 5, i32 0>)
+
+; CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST
+; CHECK: [[dim:%[a-zA-Z0-9_.]+]] = call <2 x i32> @_Z13get_image_dim14ocl_image2d_ro(%opencl.image2d_ro_t addrspace(1)* %im2d)
+; CHECK: [[max:%[a-zA-Z0-9_.]+]] = sub <2 x i32> [[dim]], <i32 1, i32 1>
+; CHECK: [[clamp:%[a-zA-Z0-9_.]+]] = call <2 x i32> @_Z5clampDv2_iS_S_(<2 x i32> %coord, <2 x i32> zeroinitializer, <2 x i32> [[max]])
+; CHECK: call <4 x i32> @_Z12read_imageui14ocl_image2d_roDv2_i(%opencl.image2d_ro_t addrspace(1)* %im2d, <2 x i32> [[clamp]])
+; CHECK: [[width:%[a-zA-Z0-9_.]+]] = call i32 @_Z15get_image_width14ocl_image1d_ro(%opencl.image1d_ro_t addrspace(1)* %im1d)
+; CHECK: [[max:%[a-zA-Z0-9_.]+]] = sub i32 [[width]], 1
+; CHECK: [[clamp:%[a-zA-Z0-9_.]+]] = call i32 @_Z5clampiii(i32 %x, i32 0, i32 [[max]])
+; CHECK: call <4 x float> @_Z11read_imagef14ocl_image1d_roi(%opencl.image1d_ro_t addrspace(1)* %im1d, i32 [[clamp]])
+
+; Clamping is not supported for 3D images.
+; CHECK: [[float_coord:%[a-zA-Z0-9_.]+]] = sitofp <4 x i32> <i32 3, i32 7, i32 5, i32 0> to <4 x float>
+; CHECK: call <4 x float> @_Z11read_imagef14ocl_image3d_ro11ocl_samplerDv4_f(%opencl.image3d_ro_t addrspace(1)* %im3d, %opencl.sampler_t addrspace(2)* %clamp_sampler, <4 x float> [[float_coord]])
+
+; CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR
+; CHECK: [[float_coord:%[a-zA-Z0-9_.]+]] = sitofp <2 x i32> %coord to <2 x float>
+; CHECK: call <4 x float> @_Z11read_imagef14ocl_image2d_ro11ocl_samplerDv2_f(%opencl.image2d_ro_t addrspace(1)* %im2d, %opencl.sampler_t addrspace(2)* %linear_sampler, <2 x float> [[float_coord]])
+
+; The sampler of a kernel argument is unknown.
+; CHECK: [[float_coord:%[a-zA-Z0-9_.]+]] = sitofp <2 x i32> %coord to <2 x float>
+; CHECK: call <4 x float> @_Z11read_imagef14ocl_image2d_ro11ocl_samplerDv2_f(%opencl.image2d_ro_t addrspace(1)* %im2d, %opencl.sampler_t addrspace(2)* %sampler, <2 x float> [[float_coord]])
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+%opencl.sampler_t = type opaque
+%opencl.image1d_ro_t = type opaque
+%opencl.image2d_ro_t = type opaque
+%opencl.image3d_ro_t = type opaque
+
+define spir_kernel void @test(%opencl.sampler_t addrspace(2)* %sampler, %opencl.image1d_ro_t addrspace(1)* %im1d, %opencl.image2d_ro_t addrspace(1)* %im2d, %opencl.image3d_ro_t addrspace(1)* %im3d, <2 x i32> %coord, i32 %x) {
+entry:
+  %none_sampler = tail call %opencl.sampler_t addrspace(2)* @__translate_sampler_initializer(i32 16)
+  %call0 = tail call spir_func <4 x float> @_Z11read_imagef14ocl_image2d_ro11ocl_samplerDv2_i(%opencl.image2d_ro_t addrspace(1)* %im2d, %opencl.sampler_t addrspace(2)* %none_sampler, <2 x i32> <i32 3, i32 7>)
+  %call1 = tail call spir_func <4 x i32> @_Z11read_imagei14ocl_image3d_ro11ocl_samplerDv4_i(%opencl.image3d_ro_t addrspace(1)* %im3d, %opencl.sampler_t addrspace(2)* %none_sampler, <4 x i32> <i32 3, i32 7, i32 5, i32 0>)
+  %clamp_sampler = tail call %opencl.sampler_t addrspace(2)* @__translate_sampler_initializer(i32 18)
+  %call2 = tail call spir_func <4 x i32> @_Z12read_imageui14ocl_image2d_ro11ocl_samplerDv2_i(%opencl.image2d_ro_t addrspace(1)* %im2d, %opencl.sampler_t addrspace(2)* %clamp_sampler, <2 x i32> %coord)
+  %call3 = tail call spir_func <4 x float> @_Z11read_imagef14ocl_image1d_ro11ocl_sampleri(%opencl.image1d_ro_t addrspace(1)* %im1d, %opencl.sampler_t addrspace(2)* %clamp_sampler, i32 %x)
+  %call4 = tail call spir_func <4 x float> @_Z11read_imagef14ocl_image3d_ro11ocl_samplerDv4_i(%opencl.image3d_ro_t addrspace(1)* %im3d, %opencl.sampler_t addrspace(2)* %clamp_sampler, <4 x i32> <i32 3, i32 7, i32 5, i32 0>)
+  %linear_sampler = tail call %opencl.sampler_t addrspace(2)* @__translate_sampler_initializer(i32 34)
+  %call5 = tail call spir_func <4 x float> @_Z11read_imagef14ocl_image2d_ro11ocl_samplerDv2_i(%opencl.image2d_ro_t addrspace(1)* %im2d, %opencl.sampler_t addrspace(2)* %linear_sampler, <2 x i32> %coord)
+  %call6 = tail call spir_func <4 x float> @_Z11read_imagef14ocl_image2d_ro11ocl_samplerDv2_i(%opencl.image2d_ro_t addrspace(1)* %im2d, %opencl.sampler_t addrspace(2)* %sampler, <2 x i32> %coord)
+  ret void
+}
+
+declare %opencl.sampler_t addrspace(2)* @__translate_sampler_initializer(i32)
+declare spir_func <4 x float> @_Z11read_imagef14ocl_image2d_ro11ocl_samplerDv2_i(%opencl.image2d_ro_t addrspace(1)*, %opencl.sampler_t addrspace(2)*, <2 x i32>)
+declare spir_func <4 x i32> @_Z11read_imagei14ocl_image3d_ro11ocl_samplerDv4_i(%opencl.image3d_ro_t addrspace(1)*, %opencl.sampler_t addrspace(2)*, <4 x i32>)
+declare spir_func <4 x i32> @_Z12read_imageui14ocl_image2d_ro11ocl_samplerDv2_i(%opencl.image2d_ro_t addrspace(1)*, %opencl.sampler_t addrspace(2)*, <2 x i32>)
+declare spir_func <4 x float> @_Z11read_imagef14ocl_image1d_ro11ocl_sampleri(%opencl.image1d_ro_t addrspace(1)*, %opencl.sampler_t addrspace(2)*, i32)
+declare spir_func <4 x float> @_Z11read_imagef14ocl_image3d_ro11ocl_samplerDv4_i(%opencl.image3d_ro_t addrspace(1)*, %opencl.sampler_t addrspace(2)*, <4 x i32>)
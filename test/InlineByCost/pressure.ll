@@ -0,0 +1,55 @@
+; RUN: clspv-opt %s -o %t.ll -InlineByCost -inline-cost-threshold=100 -inline-pressure-threshold=4 -inline-pressure-callee-size=4
+; RUN: FileCheck %s < %t.ll
+; RUN: clspv-opt %s -o %t.ll -InlineByCost -inline-cost-threshold=100
+; RUN: FileCheck --check-prefix=NOPRESSURE %s < %t.ll
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+; The call outside the loop is inlined. The call in the loop, where %a, %b, %c,
+; %d and %i are live across it, is not.
+; CHECK-LABEL: define spir_kernel void @test
+; CHECK: entry:
+; CHECK-NOT: call
+; CHECK: loop:
+; CHECK: call spir_func i32 @big
+; NOPRESSURE-LABEL: define spir_kernel void @test
+; NOPRESSURE-NOT: call
+; NOPRESSURE: ret void
+define spir_kernel void @test(i32 addrspace(1)* %out, i32 %n) {
+entry:
+  %a = load i32, i32 addrspace(1)* %out
+  %b = add i32 %a, 1
+  %c = add i32 %a, 2
+  %d = add i32 %a, 3
+  %first = call spir_func i32 @big(i32 %a)
+  store i32 %first, i32 addrspace(1)* %out
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %sum4, %loop ]
+  %r = call spir_func i32 @big(i32 %i)
+  %sum0 = add i32 %acc, %r
+  %sum1 = add i32 %sum0, %b
+  %sum2 = add i32 %sum1, %c
+  %sum3 = add i32 %sum2, %d
+  %sum4 = add i32 %sum3, %a
+  %next = add i32 %i, 1
+  %cmp = icmp slt i32 %next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  store i32 %sum4, i32 addrspace(1)* %out
+  ret void
+}
+
+define spir_func i32 @big(i32 %x) {
+entry:
+  %0 = mul i32 %x, %x
+  %1 = add i32 %0, 7
+  %2 = xor i32 %1, %x
+  %3 = shl i32 %2, 3
+  %4 = sub i32 %3, %0
+  ret i32 %4
+}
@@ -0,0 +1,38 @@
+// RUN: clspv %s -o %t.spv -inline-cost-threshold=8
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: FileCheck --check-prefix=INLINED %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck --check-prefix=DEFAULT %s < %t2.spvasm
+
+// The small helper is inlined at both call sites, the large one is not.
+// CHECK: OpName [[large:%[0-9a-zA-Z_]+]] "large"
+// CHECK: [[large]] = OpFunction
+// CHECK-NOT: OpFunctionCall
+// CHECK: OpFunctionEnd
+// CHECK: OpFunctionCall {{%[0-9a-zA-Z_]+}} [[large]]
+// CHECK: OpFunctionCall {{%[0-9a-zA-Z_]+}} [[large]]
+// INLINED-NOT: "small"
+
+// Without -inline-cost-threshold, neither helper is inlined.
+// DEFAULT-DAG: OpName {{%[0-9a-zA-Z_]+}} "small"
+// DEFAULT-DAG: OpName {{%[0-9a-zA-Z_]+}} "large"
+
+int small(int a, int b) { return a * b + 1; }
+
+int large(global int *data, int n) {
+  int sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += data[i] * data[i + 1] - data[i + 2];
+    sum ^= data[i + 3] << 2;
+    sum += data[i + 4] / (data[i + 5] | 1);
+  }
+  return sum;
+}
+
+kernel void foo(global int *data, int n) {
+  data[0] = small(data[1], n) + large(data, n);
+  data[1] = small(data[2], n) + large(data, n + 1);
+}
@@ -198,9 +198,7 @@ int main() {
                 std::to_string(MaxValue(width, is_signed));
             const std::string min_value =
                 std::to_string(MinValue(width, is_signed));
-            const std::string max_plus_one =
-                (width == 32 ? "-" : "") +
-                std::to_string(MaxValue(width, is_signed) + 1);
+            const std::string shift = std::to_string(width - 1);
 
             str << "; CHECK: [[mul_ext:%[a-zA-Z0-9_.]+]] = call { " << llvm_name
                 << ", " << llvm_name << " } @_Z8spirv.op.152.{{.*}}(i32 152, "
@@ -209,80 +207,39 @@ int main() {
                 << llvm_name << ", " << llvm_name << " } [[mul_ext]], 0\n";
             str << "; CHECK: [[mul_hi:%[a-zA-Z0-9_.]+]] = extractvalue { "
                 << llvm_name << ", " << llvm_name << " } [[mul_ext]], 1\n";
-            str << "; CHECK: [[add:%[a-zA-Z0-9_.]+]] = add " << llvm_name
-                << " [[mul_lo]], %c\n";
-            str << "; CHECK: [[xor:%[a-zA-Z0-9_.]+]] = xor " << llvm_name
-                << " %a, %b\n";
-            str << "; CHECK: [[same_sign:%[a-zA-Z0-9_.]+]] = icmp sgt "
-                << llvm_name << " [[xor]], "
-                << SplatConstant(size, LLVMTypeName(width, 1), "-1") << "\n";
-            str << "; CHECK: [[diff_sign:%[a-zA-Z0-9_.]+]] = xor "
-                << selector_name << " [[same_sign]], " << NotConstant(size)
+            str << "; CHECK: [[add_carry:%[a-zA-Z0-9_.]+]] = call { "
+                << llvm_name << ", " << llvm_name
+                << " } @_Z8spirv.op.149.{{.*}}(i32 149, " << llvm_name
+                << " [[mul_lo]], " << llvm_name << " %c)\n";
+            str << "; CHECK: [[add:%[a-zA-Z0-9_.]+]] = extractvalue { "
+                << llvm_name << ", " << llvm_name << " } [[add_carry]], 0\n";
+            str << "; CHECK: [[carry:%[a-zA-Z0-9_.]+]] = extractvalue { "
+                << llvm_name << ", " << llvm_name << " } [[add_carry]], 1\n";
+            str << "; CHECK: [[c_hi:%[a-zA-Z0-9_.]+]] = ashr " << llvm_name
+                << " %c, " << SplatConstant(size, LLVMTypeName(width, 1), shift)
                 << "\n";
-            str << "; CHECK: [[hi_eq_0:%[a-zA-Z0-9_.]+]] = icmp eq "
-                << llvm_name << " [[mul_hi]], "
+            str << "; CHECK: [[hi_sum:%[a-zA-Z0-9_.]+]] = add " << llvm_name
+                << " [[mul_hi]], [[c_hi]]\n";
+            str << "; CHECK: [[res_hi:%[a-zA-Z0-9_.]+]] = add " << llvm_name
+                << " [[hi_sum]], [[carry]]\n";
+            str << "; CHECK: [[add_sign:%[a-zA-Z0-9_.]+]] = ashr " << llvm_name
+                << " [[add]], "
+                << SplatConstant(size, LLVMTypeName(width, 1), shift) << "\n";
+            str << "; CHECK: [[fits:%[a-zA-Z0-9_.]+]] = icmp eq " << llvm_name
+                << " [[res_hi]], [[add_sign]]\n";
+            str << "; CHECK: [[negative:%[a-zA-Z0-9_.]+]] = icmp slt "
+                << llvm_name << " [[res_hi]], "
                 << (size > 1 ? "zeroinitializer" : "0") << "\n";
-            str << "; CHECK: [[hi_ne_0:%[a-zA-Z0-9_.]+]] = xor "
-                << selector_name << " [[hi_eq_0]], " << NotConstant(size)
-                << "\n";
-            str << "; CHECK: [[lo_ge_max:%[a-zA-Z0-9_.]+]] = icmp uge "
-                << llvm_name << " [[mul_lo]], "
-                << SplatConstant(size, LLVMTypeName(width, 1), max_value)
-                << "\n";
-            str << "; CHECK: [[c_gt_0:%[a-zA-Z0-9_.]+]] = icmp sgt "
-                << llvm_name << " %c, " << (size > 1 ? "zeroinitializer" : "0")
-                << "\n";
-            str << "; CHECK: [[c_lt_0:%[a-zA-Z0-9_.]+]] = icmp slt "
-                << llvm_name << " %c, " << (size > 1 ? "zeroinitializer" : "0")
-                << "\n";
-            str << "; CHECK: [[add_gt_max:%[a-zA-Z0-9_.]+]] = icmp ugt "
-                << llvm_name << " [[add]], "
-                << SplatConstant(size, LLVMTypeName(width, 1), max_value)
-                << "\n";
-            str << "; CHECK: [[hi_eq_m1:%[a-zA-Z0-9_.]+]] = icmp eq "
-                << llvm_name << " [[mul_hi]], "
-                << SplatConstant(size, LLVMTypeName(width, 1), "-1") << "\n";
-            str << "; CHECK: [[hi_ne_m1:%[a-zA-Z0-9_.]+]] = xor "
-                << selector_name << " [[hi_eq_m1]], " << NotConstant(size)
-                << "\n";
-            str << "; CHECK: [[lo_le_max_plus_1:%[a-zA-Z0-9_.]+]] = icmp ule "
-                << llvm_name << " [[mul_lo]], "
-                << SplatConstant(size, LLVMTypeName(width, 1), max_plus_one)
-                << "\n";
-            str << "; CHECK: [[max_sub_lo:%[a-zA-Z0-9_.]+]] = sub " << llvm_name
-                << " " << SplatConstant(size, LLVMTypeName(width, 1), max_value)
-                << ", [[mul_lo]]\n";
-            str << "; CHECK: [[c_lt_max_sub_lo:%[a-zA-Z0-9_.]+]] = icmp ult "
-                << llvm_name << " %c, [[max_sub_lo]]\n";
-            str << "; CHECK: [[max_clamp1:%[a-zA-Z0-9_.]+]] = and "
-                << selector_name << " [[same_sign]], [[hi_ne_0]]\n";
-            str << "; CHECK: [[tmp:%[a-zA-Z0-9_.]+]] = or " << selector_name
-                << " [[c_gt_0]], [[add_gt_max]]\n";
-            str << "; CHECK: [[tmp2:%[a-zA-Z0-9_.]+]] = and " << selector_name
-                << " [[hi_eq_0]], [[lo_ge_max]]\n";
-            str << "; CHECK: [[max_clamp2:%[a-zA-Z0-9_.]+]] = and "
-                << selector_name << " [[tmp2]], [[tmp]]\n";
-            str << "; CHECK: [[max_clamp:%[a-zA-Z0-9_.]+]] = or "
-                << selector_name << " [[max_clamp1]], [[max_clamp2]]\n";
-            str << "; CHECK: [[min_clamp1:%[a-zA-Z0-9_.]+]] = and "
-                << selector_name << " [[diff_sign]], [[hi_ne_m1]]\n";
-            str << "; CHECK: [[tmp:%[a-zA-Z0-9_.]+]] = or " << selector_name
-                << " [[c_lt_0]], [[c_lt_max_sub_lo]]\n";
-            str << "; CHECK: [[tmp2:%[a-zA-Z0-9_.]+]] = and " << selector_name
-                << " [[hi_eq_m1]], [[lo_le_max_plus_1]]\n";
-            str << "; CHECK: [[min_clamp2:%[a-zA-Z0-9_.]+]] = and "
-                << selector_name << " [[tmp2]], [[tmp]]\n";
-            str << "; CHECK: [[min_clamp:%[a-zA-Z0-9_.]+]] = or "
-                << selector_name << " [[min_clamp1]], [[min_clamp2]]\n";
-            str << "; CHECK: [[sel1:%[a-zA-Z0-9_.]+]] = select "
-                << selector_name << " [[min_clamp]], " << llvm_name << " "
+            str << "; CHECK: [[clamp:%[a-zA-Z0-9_.]+]] = select "
+                << selector_name << " [[negative]], " << llvm_name << " "
                 << SplatConstant(size, LLVMTypeName(width, 1), min_value)
-                << ", " << llvm_name << " [[add]]\n";
-            str << "; CHECK: [[sel2:%[a-zA-Z0-9_.]+]] = select "
-                << selector_name << " [[max_clamp]], " << llvm_name << " "
+                << ", " << llvm_name << " "
                 << SplatConstant(size, LLVMTypeName(width, 1), max_value)
-                << ", " << llvm_name << " [[sel1]]\n";
-            str << "; CHECK: ret " << llvm_name << " [[sel2]]\n";
+                << "\n";
+            str << "; CHECK: [[sel:%[a-zA-Z0-9_.]+]] = select "
+                << selector_name << " [[fits]], " << llvm_name << " [[add]], "
+                << llvm_name << " [[clamp]]\n";
+            str << "; CHECK: ret " << llvm_name << " [[sel]]\n";
           }
         } else {
           str << "; CHECK: [[mul_ext:%[a-zA-Z0-9_.]+]] = call { " << llvm_name
@@ -0,0 +1,33 @@
+; RUN: clspv-opt %s -o %t.ll -ReplaceLLVMIntrinsics
+; RUN: FileCheck %s < %t.ll
+
+; Copies of the same types call the same function.
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+define void @first([2 x float] addrspace(1)* %A) {
+entry:
+  %dst = alloca [2 x float], align 4
+  %src_cast = bitcast [2 x float] addrspace(1)* %A to i8 addrspace(1)*
+  %dst_cast = bitcast [2 x float]* %dst to i8*
+  call void @llvm.memcpy.p0i8.p1i8.i64(i8* align 4 %dst_cast, i8 addrspace(1)* align 4 %src_cast, i64 8, i1 false)
+  ret void
+}
+
+define void @second([2 x float] addrspace(1)* %A) {
+entry:
+  %dst = alloca [2 x float], align 4
+  %src_cast = bitcast [2 x float] addrspace(1)* %A to i8 addrspace(1)*
+  %dst_cast = bitcast [2 x float]* %dst to i8*
+  call void @llvm.memcpy.p0i8.p1i8.i64(i8* align 4 %dst_cast, i8 addrspace(1)* align 4 %src_cast, i64 8, i1 false)
+  ret void
+}
+
+declare void @llvm.memcpy.p0i8.p1i8.i64(i8*, i8 addrspace(1)*, i64, i1)
+
+; CHECK: define void @first
+; CHECK: call void @_Z17spirv.copy_memory([2 x float]* %dst, [2 x float] addrspace(1)* %A, i32 4, i32 0)
+; CHECK: define void @second
+; CHECK: call void @_Z17spirv.copy_memory([2 x float]* %dst, [2 x float] addrspace(1)* %A, i32 4, i32 0)
+; CHECK-NOT: @_Z17spirv.copy_memory.1
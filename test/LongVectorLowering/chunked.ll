@@ -0,0 +1,27 @@
+; RUN: clspv-opt --LongVectorLowering -long-vector-chunk-width=4 %s -o %t
+; RUN: FileCheck %s < %t
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+define spir_func <8 x float> @test(<8 x float> %a, <8 x float> %b) {
+entry:
+  %add = fadd <8 x float> %a, %b
+  %elt = extractelement <8 x float> %add, i32 5
+  %ins = insertelement <8 x float> %add, float %elt, i32 2
+  ret <8 x float> %ins
+}
+
+; CHECK-LABEL: define spir_func { <4 x float>, <4 x float> } @test(
+; CHECK-SAME: { <4 x float>, <4 x float> } [[A:%[^,]+]],
+; CHECK-SAME: { <4 x float>, <4 x float> } [[B:%[^)]+]])
+; CHECK-DAG: [[A0:%[^ ]+]] = extractvalue { <4 x float>, <4 x float> } [[A]], 0
+; CHECK-DAG: [[B0:%[^ ]+]] = extractvalue { <4 x float>, <4 x float> } [[B]], 0
+; CHECK: fadd <4 x float> [[A0]], [[B0]]
+; CHECK: fadd <4 x float>
+; CHECK-NOT: fadd
+; CHECK: [[HI:%[^ ]+]] = extractvalue { <4 x float>, <4 x float> } [[ADD:%[^,]+]], 1
+; CHECK: [[ELT:%[^ ]+]] = extractelement <4 x float> [[HI]], i32 1
+; CHECK: [[LO:%[^ ]+]] = extractvalue { <4 x float>, <4 x float> } [[ADD]], 0
+; CHECK: [[NEWLO:%[^ ]+]] = insertelement <4 x float> [[LO]], float [[ELT]], i32 2
+; CHECK: insertvalue { <4 x float>, <4 x float> } [[ADD]], <4 x float> [[NEWLO]], 0
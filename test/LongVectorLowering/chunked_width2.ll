@@ -0,0 +1,15 @@
+; RUN: clspv-opt --LongVectorLowering -long-vector-chunk-width=2 %s -o %t
+; RUN: FileCheck %s < %t
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+define spir_func <8 x i32> @test(<8 x i32> %a, <8 x i32> %b) {
+entry:
+  %add = add <8 x i32> %a, %b
+  ret <8 x i32> %add
+}
+
+; CHECK: define spir_func { <2 x i32>, <2 x i32>, <2 x i32>, <2 x i32> } @test(
+; CHECK-COUNT-4: add <2 x i32>
+; CHECK-NOT: add
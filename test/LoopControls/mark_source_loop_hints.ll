@@ -0,0 +1,51 @@
+; RUN: clspv-opt -MarkSourceLoopHints %s -o %t
+; RUN: FileCheck %s < %t
+
+; The loop asking not to be unrolled gets the marker, on both of its latches.
+; CHECK: br i1 %cmp, label %loop, label %exit, !llvm.loop [[nounroll:![0-9]+]]
+; CHECK: br label %loop, !llvm.loop [[nounroll]]
+; CHECK: br i1 %cmp2, label %loop2, label %exit2, !llvm.loop [[count:![0-9]+]]
+; CHECK: [[nounroll]] = distinct !{[[nounroll]], [[disable:![0-9]+]], [[marker:![0-9]+]]}
+; CHECK: [[disable]] = !{!"llvm.loop.unroll.disable"}
+; CHECK: [[marker]] = !{!"clspv.loop.source.dont_unroll"}
+; CHECK: [[count]] = distinct !{[[count]], !{{[0-9]+}}}
+; CHECK-NOT: clspv.loop.source.dont_unroll
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+define spir_kernel void @foo(i32 addrspace(1)* %out, i32 %n, i1 %c) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %check ], [ %i.next, %latch ]
+  %i.next = add i32 %i, 1
+  %gep = getelementptr i32, i32 addrspace(1)* %out, i32 %i
+  store i32 %i, i32 addrspace(1)* %gep
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %c, label %latch, label %check
+
+check:
+  br i1 %cmp, label %loop, label %exit, !llvm.loop !0
+
+latch:
+  br label %loop, !llvm.loop !0
+
+exit:
+  br label %loop2
+
+loop2:
+  %j = phi i32 [ 0, %exit ], [ %j.next, %loop2 ]
+  %j.next = add i32 %j, 1
+  %cmp2 = icmp slt i32 %j.next, %n
+  br i1 %cmp2, label %loop2, label %exit2, !llvm.loop !2
+
+exit2:
+  ret void
+}
+
+!0 = distinct !{!0, !1}
+!1 = !{!"llvm.loop.unroll.disable"}
+!2 = distinct !{!2, !3}
+!3 = !{!"llvm.loop.unroll.count", i32 4}
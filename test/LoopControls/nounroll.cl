@@ -0,0 +1,20 @@
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// CHECK: OpLoopMerge {{.*}} DontUnroll
+// CHECK: OpLoopMerge {{.*}} None
+
+kernel void foo(global int *out, global int *in, int n) {
+#pragma nounroll
+  for (int i = 0; i < n; ++i) {
+    out[i] = in[i] * 2;
+  }
+}
+
+kernel void bar(global int *out, global int *in, int n) {
+  for (int i = 0; i < n; ++i) {
+    out[i] = in[i] * 3;
+  }
+}
@@ -0,0 +1,28 @@
+; RUN: clspv-opt -PreserveLoopMetadata %s -o %t
+; RUN: FileCheck %s < %t
+
+; CHECK: loop:
+; CHECK: %i.next = add i32 %i, 1, !clspv.loop [[loop:![0-9]+]]
+; CHECK: br i1 %cmp, label %loop, label %exit, !llvm.loop [[loop]]
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+define spir_kernel void @foo(i32 addrspace(1)* %out, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %i.next = add i32 %i, 1
+  %gep = getelementptr i32, i32 addrspace(1)* %out, i32 %i
+  store i32 %i, i32 addrspace(1)* %gep
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit, !llvm.loop !0
+
+exit:
+  ret void
+}
+
+!0 = distinct !{!0, !1}
+!1 = !{!"llvm.loop.unroll.count", i32 4}
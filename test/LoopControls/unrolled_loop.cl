@@ -0,0 +1,16 @@
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The LLVM unroller marks the loops it unrolls with llvm.loop.unroll.disable.
+// The source did not ask for DontUnroll, so no loop gets it.
+// CHECK: OpLoopMerge
+// CHECK-NOT: DontUnroll
+
+kernel void foo(global int *out, global int *in, int n) {
+#pragma unroll 2
+  for (int i = 0; i < n; ++i) {
+    out[i] = in[i] * 2;
+  }
+}
@@ -0,0 +1,86 @@
+; RUN: clspv-opt -NarrowHalfArithmetic -native-fp16 %s -o %t
+; RUN: FileCheck %s < %t
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+; CHECK-LABEL: @mad_half
+; CHECK: [[mul:%[a-zA-Z0-9_.]+]] = fmul half %a, %b
+; CHECK-NEXT: [[add:%[a-zA-Z0-9_.]+]] = fadd half [[mul]], 0xH3800
+; CHECK-NEXT: ret half [[add]]
+define half @mad_half(half %a, half %b) {
+entry:
+  %ext_a = fpext half %a to float
+  %ext_b = fpext half %b to float
+  %mul = fmul float %ext_a, %ext_b
+  %add = fadd float %mul, 5.000000e-01
+  %trunc = fptrunc float %add to half
+  ret half %trunc
+}
+
+; CHECK-LABEL: @sin_half4
+; CHECK: [[neg:%[a-zA-Z0-9_.]+]] = fneg <4 x half> %a
+; CHECK-NEXT: [[sin:%[a-zA-Z0-9_.]+]] = call spir_func <4 x half> @_Z3sinDv4_Dh(<4 x half> [[neg]])
+; CHECK-NEXT: ret <4 x half> [[sin]]
+define <4 x half> @sin_half4(<4 x half> %a) {
+entry:
+  %ext = fpext <4 x half> %a to <4 x float>
+  %neg = fneg <4 x float> %ext
+  %sin = call spir_func <4 x float> @_Z3sinDv4_f(<4 x float> %neg)
+  %trunc = fptrunc <4 x float> %sin to <4 x half>
+  ret <4 x half> %trunc
+}
+
+; CHECK-LABEL: @mix_half2
+; CHECK: [[mix:%[a-zA-Z0-9_.]+]] = call spir_func <2 x half> @_Z3mixDv2_DhS_Dh(<2 x half> %a, <2 x half> %b, half %t)
+; CHECK-NEXT: ret <2 x half> [[mix]]
+define <2 x half> @mix_half2(<2 x half> %a, <2 x half> %b, half %t) {
+entry:
+  %ext_a = fpext <2 x half> %a to <2 x float>
+  %ext_b = fpext <2 x half> %b to <2 x float>
+  %ext_t = fpext half %t to float
+  %mix = call spir_func <2 x float> @_Z3mixDv2_fS_f(<2 x float> %ext_a, <2 x float> %ext_b, float %ext_t)
+  %trunc = fptrunc <2 x float> %mix to <2 x half>
+  ret <2 x half> %trunc
+}
+
+; 0.1 is not representable in half, so the sum stays in float.
+; CHECK-LABEL: @inexact_constant
+; CHECK: fadd float
+; CHECK: fptrunc float {{.*}} to half
+define half @inexact_constant(half %a) {
+entry:
+  %ext = fpext half %a to float
+  %add = fadd float %ext, 0x3FB99999A0000000
+  %trunc = fptrunc float %add to half
+  ret half %trunc
+}
+
+; The float sum has another user, so it stays in float.
+; CHECK-LABEL: @shared_add
+; CHECK: fadd float
+; CHECK: fptrunc float {{.*}} to half
+define half @shared_add(half %a, half %b, float addrspace(1)* %out) {
+entry:
+  %ext_a = fpext half %a to float
+  %ext_b = fpext half %b to float
+  %add = fadd float %ext_a, %ext_b
+  store float %add, float addrspace(1)* %out
+  %trunc = fptrunc float %add to half
+  ret half %trunc
+}
+
+; A float operand keeps the expression in float.
+; CHECK-LABEL: @float_operand
+; CHECK: call spir_func float @_Z3powff
+define half @float_operand(half %a, float %b) {
+entry:
+  %ext = fpext half %a to float
+  %pow = call spir_func float @_Z3powff(float %ext, float %b)
+  %trunc = fptrunc float %pow to half
+  ret half %trunc
+}
+
+declare spir_func <4 x float> @_Z3sinDv4_f(<4 x float>)
+declare spir_func <2 x float> @_Z3mixDv2_fS_f(<2 x float>, <2 x float>, float)
+declare spir_func float @_Z3powff(float, float)
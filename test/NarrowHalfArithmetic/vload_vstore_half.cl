@@ -0,0 +1,22 @@
+// RUN: clspv %s -o %t.spv -native-fp16
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The halves are loaded, multiplied and stored without converting to float.
+// CHECK-NOT: OpExtInst {{.*}} UnpackHalf2x16
+// CHECK-NOT: OpExtInst {{.*}} PackHalf2x16
+// CHECK-NOT: OpFConvert
+// CHECK-DAG: [[half:%[0-9a-zA-Z_]+]] = OpTypeFloat 16
+// CHECK: [[a:%[0-9a-zA-Z_]+]] = OpLoad [[half]]
+// CHECK: [[b:%[0-9a-zA-Z_]+]] = OpLoad [[half]]
+// CHECK: [[mul:%[0-9a-zA-Z_]+]] = OpFMul [[half]] [[a]] [[b]]
+// CHECK: [[sqrt:%[0-9a-zA-Z_]+]] = OpExtInst [[half]] {{.*}} Sqrt [[mul]]
+// CHECK: OpStore {{.*}} [[sqrt]]
+
+#pragma OPENCL EXTENSION cl_khr_fp16 : enable
+
+kernel void foo(global half *a, global half *b, global half *out) {
+  size_t i = get_global_id(0);
+  vstore_half(sqrt(vload_half(i, a) * vload_half(i, b)), i, out);
+}
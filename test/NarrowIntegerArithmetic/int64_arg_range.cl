@@ -0,0 +1,20 @@
+// RUN: clspv %s -o %t.spv -narrow-int64-arithmetic -int64-arg-range=foo:1:0:1000
+// RUN: spirv-dis %t.spv -o %t.spvasm
+// RUN: FileCheck %s < %t.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The range of n fits in 32 bits, so it is passed as a uint2 of which only
+// the low word is read, and no 64-bit value remains.
+// CHECK-NOT: OpCapability Int64
+// CHECK-NOT: OpTypeInt 64
+// CHECK: [[uint:%[a-zA-Z0-9_]+]] = OpTypeInt 32 0
+// CHECK: [[uint2:%[a-zA-Z0-9_]+]] = OpTypeVector [[uint]] 2
+// CHECK-NOT: OpTypeInt 64
+// CHECK: OpCompositeExtract [[uint]]
+// CHECK-NOT: OpTypeInt 64
+
+kernel void foo(global int *out, long n) {
+  out[0] = (int)(n * 3 + 1);
+  if (n < 100)
+    out[1] = 5;
+}
@@ -0,0 +1,59 @@
+; RUN: clspv-opt -NarrowIntegerArithmetic -narrow-integer-arithmetic %s -o %t
+; RUN: FileCheck %s < %t
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+; CHECK-LABEL: @mad_char
+; CHECK: [[mul:%[a-zA-Z0-9_.]+]] = mul i8 %a, %b
+; CHECK-NEXT: [[add:%[a-zA-Z0-9_.]+]] = add i8 [[mul]], %c
+; CHECK-NEXT: ret i8 [[add]]
+define i8 @mad_char(i8 %a, i8 %b, i8 %c) {
+entry:
+  %ext_a = sext i8 %a to i32
+  %ext_b = sext i8 %b to i32
+  %ext_c = zext i8 %c to i32
+  %mul = mul nsw i32 %ext_a, %ext_b
+  %add = add nsw i32 %mul, %ext_c
+  %trunc = trunc i32 %add to i8
+  ret i8 %trunc
+}
+
+; CHECK-LABEL: @shl_short2
+; CHECK: [[shl:%[a-zA-Z0-9_.]+]] = shl <2 x i16> %a, <i16 3, i16 3>
+; CHECK-NEXT: [[or:%[a-zA-Z0-9_.]+]] = or <2 x i16> [[shl]], <i16 1, i16 1>
+; CHECK-NEXT: ret <2 x i16> [[or]]
+define <2 x i16> @shl_short2(<2 x i16> %a) {
+entry:
+  %ext = zext <2 x i16> %a to <2 x i32>
+  %shl = shl <2 x i32> %ext, <i32 3, i32 3>
+  %or = or <2 x i32> %shl, <i32 1, i32 1>
+  %trunc = trunc <2 x i32> %or to <2 x i16>
+  ret <2 x i16> %trunc
+}
+
+; The wide product has another user, so it stays 32-bit.
+; CHECK-LABEL: @shared_mul
+; CHECK: mul i32
+; CHECK: trunc i32 {{.*}} to i8
+define i8 @shared_mul(i8 %a, i8 %b, i32 addrspace(1)* %out) {
+entry:
+  %ext_a = sext i8 %a to i32
+  %ext_b = sext i8 %b to i32
+  %mul = mul i32 %ext_a, %ext_b
+  store i32 %mul, i32 addrspace(1)* %out
+  %trunc = trunc i32 %mul to i8
+  ret i8 %trunc
+}
+
+; A right shift needs the high bits.
+; CHECK-LABEL: @lshr_char
+; CHECK: lshr i32
+; CHECK: trunc i32 {{.*}} to i8
+define i8 @lshr_char(i8 %a) {
+entry:
+  %ext = zext i8 %a to i32
+  %shr = lshr i32 %ext, 1
+  %trunc = trunc i32 %shr to i8
+  ret i8 %trunc
+}
@@ -0,0 +1,60 @@
+; RUN: clspv-opt %s -o %t.ll -NarrowInt64Arithmetic
+; RUN: FileCheck %s < %t.ll
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+; The masked value and the arithmetic on it fit in 32 bits.
+; CHECK-LABEL: @masked
+; CHECK-NOT: i64
+; CHECK: [[b:%[a-zA-Z0-9_.]+]] = add i32 %m, 1
+; CHECK-NOT: i64
+; CHECK: [[c:%[a-zA-Z0-9_.]+]] = mul i32 [[b]], 3
+; CHECK-NOT: i64
+; CHECK: store i32 [[c]], i32 addrspace(1)* %out
+define spir_kernel void @masked(i32 addrspace(1)* %out, i32 %x) {
+entry:
+  %m = and i32 %x, 1023
+  %a = zext i32 %m to i64
+  %b = add nuw nsw i64 %a, 1
+  %c = mul nuw nsw i64 %b, 3
+  %t = trunc i64 %c to i32
+  store i32 %t, i32 addrspace(1)* %out, align 4
+  ret void
+}
+
+; The range of %n comes from the assumptions, which are removed.
+; CHECK-LABEL: @assumed
+; CHECK-NOT: llvm.assume
+; CHECK: [[n:%[a-zA-Z0-9_.]+]] = trunc i64 %n to i32
+; CHECK-NOT: llvm.assume
+; CHECK: [[d:%[a-zA-Z0-9_.]+]] = udiv i32 [[n]], 3
+; CHECK-NOT: llvm.assume
+; CHECK: store i32 [[d]], i32 addrspace(1)* %out
+define spir_kernel void @assumed(i32 addrspace(1)* %out, i64 %n) {
+entry:
+  %lo = icmp sge i64 %n, 0
+  call void @llvm.assume(i1 %lo)
+  %hi = icmp sle i64 %n, 4096
+  call void @llvm.assume(i1 %hi)
+  %d = udiv i64 %n, 3
+  %t = trunc i64 %d to i32
+  store i32 %t, i32 addrspace(1)* %out, align 4
+  ret void
+}
+
+; The sum of two unbounded 32-bit values needs 33 bits.
+; CHECK-LABEL: @wide
+; CHECK: [[sum:%[a-zA-Z0-9_.]+]] = add i64 %a, %a
+; CHECK: lshr i64 [[sum]], 1
+define spir_kernel void @wide(i32 addrspace(1)* %out, i32 %x) {
+entry:
+  %a = zext i32 %x to i64
+  %sum = add i64 %a, %a
+  %half = lshr i64 %sum, 1
+  %t = trunc i64 %half to i32
+  store i32 %t, i32 addrspace(1)* %out, align 4
+  ret void
+}
+
+declare void @llvm.assume(i1)
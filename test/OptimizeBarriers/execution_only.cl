@@ -0,0 +1,27 @@
+// RUN: clspv %s -o %t.spv -optimize-barriers
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// No __local memory is written: the barrier only synchronizes execution and
+// the fence is removed.
+
+// CHECK-DAG: %[[UINT_TYPE_ID:[a-zA-Z0-9_]*]] = OpTypeInt 32 0
+
+// Workgroup
+// CHECK-DAG: %[[CONSTANT_2_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 2
+
+// None
+// CHECK-DAG: %[[CONSTANT_0_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 0
+
+// CHECK: OpControlBarrier %[[CONSTANT_2_ID]] %[[CONSTANT_2_ID]] %[[CONSTANT_0_ID]]
+// CHECK-NOT: OpMemoryBarrier
+
+void kernel __attribute__((reqd_work_group_size(64, 1, 1)))
+foo(global int *data) {
+  uint i = get_local_id(0);
+  int x = data[i];
+  barrier(CLK_LOCAL_MEM_FENCE);
+  mem_fence(CLK_LOCAL_MEM_FENCE);
+  data[i] = x + 1;
+}
@@ -0,0 +1,29 @@
+// RUN: clspv %s -o %t.spv -optimize-barriers
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The consecutive barriers are merged into one ordering both storage classes.
+
+// CHECK-DAG: %[[UINT_TYPE_ID:[a-zA-Z0-9_]*]] = OpTypeInt 32 0
+
+// Workgroup
+// CHECK-DAG: %[[CONSTANT_2_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 2
+
+// AcquireRelease | StorageBufferMemory | WorkgroupMemory
+// CHECK-DAG: %[[CONSTANT_328_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 328
+
+// CHECK: OpControlBarrier %[[CONSTANT_2_ID]] %[[CONSTANT_2_ID]] %[[CONSTANT_328_ID]]
+// CHECK-NOT: OpControlBarrier
+// CHECK-NOT: OpMemoryBarrier
+
+void kernel __attribute__((reqd_work_group_size(64, 1, 1)))
+foo(global int *data, local int *tmp) {
+  uint i = get_local_id(0);
+  tmp[i] = data[i];
+  data[i] = 0;
+  barrier(CLK_LOCAL_MEM_FENCE);
+  mem_fence(CLK_GLOBAL_MEM_FENCE);
+  barrier(CLK_GLOBAL_MEM_FENCE);
+  data[i] = tmp[63 - i];
+}
@@ -0,0 +1,24 @@
+// RUN: clspv %s -o %t.spv -optimize-barriers
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// A read fence (Acquire) merged with a write fence (Release) orders with
+// AcquireRelease alone, as SPIR-V allows a single ordering.
+
+// CHECK-DAG: %[[UINT_TYPE_ID:[a-zA-Z0-9_]*]] = OpTypeInt 32 0
+
+// AcquireRelease | StorageBufferMemory
+// CHECK-DAG: %[[CONSTANT_72_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 72
+
+// CHECK: OpMemoryBarrier {{%[a-zA-Z0-9_]*}} %[[CONSTANT_72_ID]]
+// CHECK-NOT: OpMemoryBarrier
+
+void kernel __attribute__((reqd_work_group_size(64, 1, 1)))
+foo(global int *data) {
+  uint i = get_local_id(0);
+  data[i] = 1;
+  read_mem_fence(CLK_GLOBAL_MEM_FENCE);
+  write_mem_fence(CLK_GLOBAL_MEM_FENCE);
+  data[i + 64] = 2;
+}
@@ -0,0 +1,24 @@
+// RUN: clspv %s -o %t.spv -optimize-barriers
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// No __local memory is written, so WorkgroupMemory is dropped.
+
+// CHECK-DAG: %[[UINT_TYPE_ID:[a-zA-Z0-9_]*]] = OpTypeInt 32 0
+
+// Workgroup
+// CHECK-DAG: %[[CONSTANT_2_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 2
+
+// AcquireRelease | StorageBufferMemory
+// CHECK-DAG: %[[CONSTANT_72_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 72
+
+// CHECK: OpControlBarrier %[[CONSTANT_2_ID]] %[[CONSTANT_2_ID]] %[[CONSTANT_72_ID]]
+
+void kernel __attribute__((reqd_work_group_size(64, 1, 1)))
+foo(global int *data) {
+  uint i = get_local_id(0);
+  int x = data[i];
+  barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
+  data[63 - i] = x;
+}
@@ -0,0 +1,39 @@
+// RUN: clspv %s -o %t.spv -O2 -opt-jobs=2
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+// RUN: clspv-reflection %t.spv -o %t.map
+// RUN: clspv %s -o %t.serial.spv -O2
+// RUN: clspv-reflection %t.serial.spv -o %t.serial.map
+// RUN: diff %t.map %t.serial.map
+// RUN: FileCheck %s < %t.map
+
+// Kernels optimized on separate threads keep the interface of a serial
+// compilation, including for the helper and the table they share.
+
+// CHECK: kernel,foo,arg,out,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,buffer
+// CHECK: kernel,foo,arg,n,argOrdinal,1,{{.*}}argKind,pod
+// CHECK: kernel,bar,arg,out,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,buffer
+// CHECK: kernel,bar,arg,x,argOrdinal,1,{{.*}}argKind,pod
+// CHECK: kernel,baz,arg,out,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,buffer
+
+constant float table[4] = {1.0f, 2.0f, 4.0f, 8.0f};
+
+__attribute__((noinline)) float lookup(int i) { return table[i & 3]; }
+
+kernel void foo(global float *out, int n) {
+  float sum = 0.0f;
+  for (int i = 0; i < n; ++i) {
+    sum += lookup(i);
+  }
+  out[get_global_id(0)] = sum;
+}
+
+kernel void bar(global float *out, float x) {
+  out[get_global_id(0)] = x * lookup(get_global_id(0));
+}
+
+kernel void baz(global float *out) {
+  local float tmp[64];
+  tmp[get_local_id(0)] = table[get_local_id(0) & 3];
+  barrier(CLK_LOCAL_MEM_FENCE);
+  out[get_global_id(0)] = tmp[63 - get_local_id(0)];
+}
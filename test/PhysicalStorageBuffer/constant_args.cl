@@ -0,0 +1,28 @@
+// RUN: clspv %s -o %t.spv -physical-storage-buffers -pod-ubo
+// RUN: clspv-reflection %t.spv -o %t.map
+// RUN: FileCheck -check-prefix=MAP %s < %t.map
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.2 %t.spv
+
+// Pointer-to-constant arguments are device addresses too, so all the buffers
+// of the kernel share the uniform buffer of its POD arguments.
+
+// MAP: kernel,foo,arg,A,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,pod_ubo,argSize,8
+// MAP: kernel,foo,arg,B,argOrdinal,1,descriptorSet,0,binding,0,offset,8,argKind,pod_ubo,argSize,8
+// MAP: kernel,foo,arg,C,argOrdinal,2,descriptorSet,0,binding,0,offset,16,argKind,pod_ubo,argSize,8
+// MAP-NOT: binding,1
+
+// CHECK-DAG: [[int:%[a-zA-Z0-9_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[ptr:%[a-zA-Z0-9_]+]] = OpTypePointer PhysicalStorageBuffer [[int]]
+// CHECK: [[b:%[a-zA-Z0-9_]+]] = OpConvertUToPtr [[ptr]]
+// CHECK: [[c:%[a-zA-Z0-9_]+]] = OpConvertUToPtr [[ptr]]
+// CHECK: [[b_gep:%[a-zA-Z0-9_]+]] = OpPtrAccessChain [[ptr]] [[b]]
+// CHECK: OpLoad [[int]] [[b_gep]] Aligned 4
+// CHECK: [[c_gep:%[a-zA-Z0-9_]+]] = OpPtrAccessChain [[ptr]] [[c]]
+// CHECK: OpLoad [[int]] [[c_gep]] Aligned 4
+
+kernel void foo(global int *A, constant int *B, constant int *C) {
+  uint gid = get_global_id(0);
+  A[gid] = B[gid] + C[gid];
+}
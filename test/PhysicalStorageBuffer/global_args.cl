@@ -0,0 +1,35 @@
+// RUN: clspv %s -o %t.spv -physical-storage-buffers -pod-pushconstant
+// RUN: clspv-reflection %t.spv -o %t.map
+// RUN: FileCheck -check-prefix=MAP %s < %t.map
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.2 %t.spv
+
+// The buffers are passed as device addresses next to the other POD
+// arguments, so the kernel uses no descriptors.
+
+// MAP-NOT: descriptorSet
+// MAP: kernel,foo,arg,A,argOrdinal,0,offset,0,argKind,pod_pushconstant,argSize,8
+// MAP: kernel,foo,arg,B,argOrdinal,1,offset,8,argKind,pod_pushconstant,argSize,8
+// MAP: kernel,foo,arg,n,argOrdinal,2,offset,16,argKind,pod_pushconstant,argSize,4
+// MAP-NOT: descriptorSet
+
+// CHECK-DAG: OpCapability PhysicalStorageBufferAddresses
+// CHECK-DAG: OpCapability Int64
+// CHECK-NOT: OpCapability VariablePointers
+// CHECK: OpExtension "SPV_KHR_physical_storage_buffer"
+// CHECK: OpMemoryModel PhysicalStorageBuffer64 GLSL450
+// CHECK: OpDecorate [[ptr:%[a-zA-Z0-9_]+]] ArrayStride 4
+// CHECK-DAG: [[float:%[a-zA-Z0-9_]+]] = OpTypeFloat 32
+// CHECK-DAG: [[ptr]] = OpTypePointer PhysicalStorageBuffer [[float]]
+// CHECK: OpConvertUToPtr [[ptr]]
+// CHECK: OpConvertUToPtr [[ptr]]
+// CHECK: [[b_gep:%[a-zA-Z0-9_]+]] = OpPtrAccessChain [[ptr]]
+// CHECK: [[ld:%[a-zA-Z0-9_]+]] = OpLoad [[float]] [[b_gep]] Aligned 4
+// CHECK: [[a_gep:%[a-zA-Z0-9_]+]] = OpPtrAccessChain [[ptr]]
+// CHECK: OpStore [[a_gep]] [[ld]] Aligned 4
+
+kernel void foo(global float *A, global float *B, uint n) {
+  uint gid = get_global_id(0);
+  A[gid] = B[gid + n];
+}
@@ -0,0 +1,25 @@
+// RUN: clspv %s -o %t.spv -pod-spec-constants=foo:1 -pod-pushconstant
+// RUN: clspv-reflection %t.spv -o %t.map
+// RUN: FileCheck -check-prefix=MAP %s < %t.map
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// Only foo is specialized. Its argument stays in the push constants.
+
+// MAP: kernel_decl,foo
+// MAP: spec_constant,pod_argument,spec_id,3,kernel,foo,argOrdinal,1
+// MAP: kernel,foo,arg,mask,argOrdinal,1,offset,0,argKind,pod_pushconstant,argSize,8
+// MAP: kernel_decl,bar
+// MAP-NOT: pod_argument
+
+// CHECK: OpCapability Int64
+// CHECK: OpDecorate [[mask:%[a-zA-Z0-9_]+]] SpecId 3
+// CHECK-NOT: SpecId 4
+// CHECK: [[ulong:%[a-zA-Z0-9_]+]] = OpTypeInt 64 0
+// CHECK: [[mask]] = OpSpecConstant [[ulong]] 0 0
+// CHECK: OpBitwiseAnd [[ulong]] {{.*}} [[mask]]
+
+kernel void foo(global ulong *out, ulong mask) { *out &= mask; }
+
+kernel void bar(global ulong *out, ulong mask) { *out &= mask; }
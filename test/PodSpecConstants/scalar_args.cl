@@ -0,0 +1,38 @@
+// RUN: clspv %s -o %t.spv -pod-spec-constants=foo:1,foo:2
+// RUN: clspv-reflection %t.spv -o %t.map
+// RUN: FileCheck -check-prefix=MAP %s < %t.map
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// n and scale are read from specialization constants, but keep their POD
+// argument.
+
+// MAP: kernel_decl,foo
+// MAP: spec_constant,pod_argument,spec_id,3,kernel,foo,argOrdinal,1
+// MAP: spec_constant,pod_argument,spec_id,4,kernel,foo,argOrdinal,2
+// MAP: kernel,foo,arg,out,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,buffer
+// MAP: kernel,foo,arg,n,argOrdinal,1,{{.*}},argKind,pod
+// MAP: kernel,foo,arg,scale,argOrdinal,2,{{.*}},argKind,pod
+
+// CHECK: [[import:%[a-zA-Z0-9_]+]] = OpExtInstImport "NonSemantic.ClspvPodSpecConstant.1"
+// CHECK-DAG: OpDecorate [[n:%[a-zA-Z0-9_]+]] SpecId 3
+// CHECK-DAG: OpDecorate [[scale:%[a-zA-Z0-9_]+]] SpecId 4
+// CHECK-DAG: [[uint:%[a-zA-Z0-9_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[float:%[a-zA-Z0-9_]+]] = OpTypeFloat 32
+// CHECK-DAG: [[n]] = OpSpecConstant [[uint]] 0
+// CHECK-DAG: [[scale]] = OpSpecConstant [[float]] 0
+// CHECK-DAG: [[uint_1:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 1
+// CHECK-DAG: [[uint_2:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 2
+// CHECK-DAG: [[uint_3:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 3
+// CHECK-DAG: [[uint_4:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 4
+// CHECK: = OpS{{[a-zA-Z]+}}Than {{.*}}[[n]]
+// CHECK: = OpFMul [[float]] {{.*}}[[scale]]
+// CHECK: [[decl:%[a-zA-Z0-9_]+]] = OpExtInst {{%[a-zA-Z0-9_]+}} {{%[a-zA-Z0-9_]+}} Kernel
+// CHECK: OpExtInst {{%[a-zA-Z0-9_]+}} [[import]] 1 [[decl]] [[uint_1]] [[uint_3]]
+// CHECK: OpExtInst {{%[a-zA-Z0-9_]+}} [[import]] 1 [[decl]] [[uint_2]] [[uint_4]]
+
+kernel void foo(global int *out, int n, float scale) {
+  for (int i = 0; i < n; ++i)
+    out[i] = (int)(i * scale);
+}
@@ -0,0 +1,53 @@
+; RUN: clspv-opt %s -o %t.ll -UntypedBuffers
+; RUN: FileCheck %s < %t.ll
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+; A float buffer also read as float2 is declared as words.
+; CHECK-LABEL: define spir_kernel void @punned(i32 addrspace(1)* %buf, i32 %i)
+; CHECK: [[off:%[a-zA-Z0-9_.]+]] = mul i32 %i, 8
+; CHECK: [[word:%[a-zA-Z0-9_.]+]] = lshr i32 [[off]], 2
+; CHECK: [[gep0:%[a-zA-Z0-9_.]+]] = getelementptr i32, i32 addrspace(1)* %buf, i32 [[word]]
+; CHECK: [[next:%[a-zA-Z0-9_.]+]] = add i32 [[word]], 1
+; CHECK: [[gep1:%[a-zA-Z0-9_.]+]] = getelementptr i32, i32 addrspace(1)* %buf, i32 [[next]]
+; CHECK: [[ld0:%[a-zA-Z0-9_.]+]] = load i32, i32 addrspace(1)* [[gep0]], align 4
+; CHECK: [[ins0:%[a-zA-Z0-9_.]+]] = insertelement <2 x i32> undef, i32 [[ld0]], i64 0
+; CHECK: [[ld1:%[a-zA-Z0-9_.]+]] = load i32, i32 addrspace(1)* [[gep1]], align 4
+; CHECK: [[ins1:%[a-zA-Z0-9_.]+]] = insertelement <2 x i32> [[ins0]], i32 [[ld1]], i64 1
+; CHECK: %v = bitcast <2 x i32> [[ins1]] to <2 x float>
+; CHECK: [[x:%[a-zA-Z0-9_.]+]] = extractelement <2 x float> %v, i32 0
+; CHECK: [[soff:%[a-zA-Z0-9_.]+]] = mul i32 %i, 4
+; CHECK: [[sword:%[a-zA-Z0-9_.]+]] = lshr i32 [[soff]], 2
+; CHECK: [[sgep:%[a-zA-Z0-9_.]+]] = getelementptr i32, i32 addrspace(1)* %buf, i32 [[sword]]
+; CHECK: [[xi:%[a-zA-Z0-9_.]+]] = bitcast float [[x]] to i32
+; CHECK: store i32 [[xi]], i32 addrspace(1)* [[sgep]], align 4
+; CHECK-NOT: <2 x float> addrspace(1)*
+define spir_kernel void @punned(float addrspace(1)* %buf, i32 %i) {
+entry:
+  %p = bitcast float addrspace(1)* %buf to <2 x float> addrspace(1)*
+  %q = getelementptr inbounds <2 x float>, <2 x float> addrspace(1)* %p, i32 %i
+  %v = load <2 x float>, <2 x float> addrspace(1)* %q, align 8
+  %x = extractelement <2 x float> %v, i32 0
+  %r = getelementptr inbounds float, float addrspace(1)* %buf, i32 %i
+  store float %x, float addrspace(1)* %r, align 4
+  ret void
+}
+
+; Buffers accessed with a single type, or with bytes, keep their type.
+; CHECK-LABEL: define spir_kernel void @typed(<4 x float> addrspace(1)* %in, i8 addrspace(1)* %bytes, i32 %i)
+; CHECK: load <4 x float>, <4 x float> addrspace(1)*
+; CHECK: store <4 x float>
+; CHECK: load i8, i8 addrspace(1)*
+define spir_kernel void @typed(<4 x float> addrspace(1)* %in, i8 addrspace(1)* %bytes, i32 %i) {
+entry:
+  %a = getelementptr inbounds <4 x float>, <4 x float> addrspace(1)* %in, i32 %i
+  %v = load <4 x float>, <4 x float> addrspace(1)* %a, align 16
+  store <4 x float> %v, <4 x float> addrspace(1)* %in, align 16
+  %b = getelementptr inbounds i8, i8 addrspace(1)* %bytes, i32 %i
+  %c = load i8, i8 addrspace(1)* %b, align 1
+  %w = bitcast i8 addrspace(1)* %bytes to i32 addrspace(1)*
+  %d = zext i8 %c to i32
+  store i32 %d, i32 addrspace(1)* %w, align 4
+  ret void
+}
@@ -0,0 +1,26 @@
+; RUN: clspv-opt %s -o %t.ll -WidenVec3Accesses
+; RUN: FileCheck %s < %t.ll
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+define spir_kernel void @foo(<4 x float> addrspace(1)* %in, <4 x float> addrspace(1)* %out, i32 %i) {
+entry:
+  ; CHECK-NOT: bitcast
+  ; CHECK: [[in_gep:%[a-zA-Z0-9_.]+]] = getelementptr inbounds <4 x float>, <4 x float> addrspace(1)* %in, i32 %i
+  ; CHECK: [[wide:%[a-zA-Z0-9_.]+]] = load <4 x float>, <4 x float> addrspace(1)* [[in_gep]]
+  ; CHECK: %ld = shufflevector <4 x float> [[wide]], <4 x float> undef, <3 x i32> <i32 0, i32 1, i32 2>
+  %in3 = bitcast <4 x float> addrspace(1)* %in to <3 x float> addrspace(1)*
+  %in_gep = getelementptr inbounds <3 x float>, <3 x float> addrspace(1)* %in3, i32 %i
+  %ld = load <3 x float>, <3 x float> addrspace(1)* %in_gep, align 16
+  %add = fadd <3 x float> %ld, <float 1.0, float 1.0, float 1.0>
+
+  ; CHECK: [[old:%[a-zA-Z0-9_.]+]] = load <4 x float>, <4 x float> addrspace(1)* %out
+  ; CHECK: [[new:%[a-zA-Z0-9_.]+]] = shufflevector <3 x float> %add, <3 x float> undef, <4 x i32> <i32 0, i32 1, i32 2, i32 3>
+  ; CHECK: [[merged:%[a-zA-Z0-9_.]+]] = shufflevector <4 x float> [[new]], <4 x float> [[old]], <4 x i32> <i32 0, i32 1, i32 2, i32 7>
+  ; CHECK: store <4 x float> [[merged]], <4 x float> addrspace(1)* %out
+  ; CHECK-NOT: bitcast
+  %out3 = bitcast <4 x float> addrspace(1)* %out to <3 x float> addrspace(1)*
+  store <3 x float> %add, <3 x float> addrspace(1)* %out3, align 16
+  ret void
+}
@@ -0,0 +1,28 @@
+// RUN: rm -rf %t.pch
+// RUN: clspv %s -o %t.spv -builtins-pch-dir=%t.pch -DVALUE=7
+// RUN: spirv-dis -o %t.spvasm %t.spv
+// RUN: FileCheck %s < %t.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The second compile loads the builtins from the cache.
+// RUN: clspv %s -o %t2.spv -builtins-pch-dir=%t.pch -DVALUE=7
+// RUN: spirv-dis -o %t2.spvasm %t2.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t2.spv
+
+// A different define gets its own precompiled builtins.
+// RUN: clspv %s -o %t3.spv -builtins-pch-dir=%t.pch -DVALUE=9
+// RUN: spirv-dis -o %t3.spvasm %t3.spv
+// RUN: FileCheck %s --check-prefix=NINE < %t3.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t3.spv
+
+// CHECK: OpEntryPoint GLCompute %[[FOO_ID:[a-zA-Z0-9_]*]] "foo"
+// CHECK: OpExecutionMode %[[FOO_ID]] LocalSize 4 2 7
+
+// NINE: OpEntryPoint GLCompute %[[FOO_ID:[a-zA-Z0-9_]*]] "foo"
+// NINE: OpExecutionMode %[[FOO_ID]] LocalSize 4 2 9
+
+void kernel __attribute__((reqd_work_group_size(4, 2, VALUE)))
+foo(global uint *out, uint in) {
+  *out = min(in, (uint)VALUE);
+}
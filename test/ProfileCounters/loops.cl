@@ -0,0 +1,31 @@
+// RUN: clspv %s -o %t.spv -profile-counters=loops
+// RUN: clspv-reflection %t.spv -o %t.map
+// RUN: FileCheck -check-prefix=MAP %s < %t.map
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// Only the loop is counted, and every invocation increments its counter.
+
+// MAP: profile_counters,descriptorSet,1,binding,0,count,1
+// MAP: profile_counter,0,location,foo:{{.+}}
+// MAP: kernel,foo,arg,out,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,buffer
+
+// CHECK: [[import:%[a-zA-Z0-9_]+]] = OpExtInstImport "NonSemantic.ClspvProfileCounters.1"
+// CHECK-DAG: OpDecorate [[counters:%[a-zA-Z0-9_]+]] DescriptorSet 1
+// CHECK-DAG: OpDecorate [[counters]] Binding 0
+// CHECK-DAG: [[uint:%[a-zA-Z0-9_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[uint_0:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 0
+// CHECK-DAG: [[uint_1:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 1
+// CHECK: [[counters]] = OpVariable {{%[a-zA-Z0-9_]+}} StorageBuffer
+// CHECK: OpLoopMerge
+// CHECK: [[counter:%[a-zA-Z0-9_]+]] = OpAccessChain {{%[a-zA-Z0-9_]+}} [[counters]] [[uint_0]] [[uint_0]]
+// CHECK: OpAtomicIAdd [[uint]] [[counter]] {{%[a-zA-Z0-9_]+}} {{%[a-zA-Z0-9_]+}} [[uint_1]]
+// CHECK-NOT: OpAtomicIAdd
+// CHECK: OpExtInst {{%[a-zA-Z0-9_]+}} [[import]] 1 [[uint_1]] [[uint_0]] [[uint_1]]
+// CHECK: OpExtInst {{%[a-zA-Z0-9_]+}} [[import]] 2 [[uint_0]]
+
+kernel void foo(global int *out, int n) {
+  for (int i = 0; i < n; ++i)
+    out[i] = i;
+}
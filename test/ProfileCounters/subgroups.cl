@@ -0,0 +1,33 @@
+// RUN: clspv %s -o %t.spv -profile-counters=blocks -spv-version=1.3
+// RUN: clspv-reflection %t.spv -o %t.map
+// RUN: FileCheck -check-prefix=MAP %s < %t.map
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.1 %t.spv
+
+// Each block counts the invocations of the subgroup entering it, and only
+// the lowest of them increments the counter.
+
+// MAP: profile_counters,descriptorSet,1,binding,0,count,3
+// MAP: profile_counter,0,location,foo:entry
+// MAP: profile_counter,1,location,foo:{{.+}}
+// MAP: profile_counter,2,location,foo:{{.+}}
+
+// CHECK-DAG: OpCapability GroupNonUniformArithmetic
+// CHECK-DAG: OpDecorate [[counters:%[a-zA-Z0-9_]+]] DescriptorSet 1
+// CHECK-DAG: [[uint:%[a-zA-Z0-9_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[uint_1:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 1
+// CHECK-DAG: [[uint_3:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 3
+// CHECK: [[id:%[a-zA-Z0-9_]+]] = OpLoad [[uint]]
+// CHECK: [[leader:%[a-zA-Z0-9_]+]] = OpGroupNonUniformUMin [[uint]] [[uint_3]] Reduce [[id]]
+// CHECK: [[count:%[a-zA-Z0-9_]+]] = OpGroupNonUniformIAdd [[uint]] [[uint_3]] Reduce [[uint_1]]
+// CHECK: [[is_leader:%[a-zA-Z0-9_]+]] = OpIEqual {{%[a-zA-Z0-9_]+}} [[id]] [[leader]]
+// CHECK: OpSelectionMerge
+// CHECK: OpBranchConditional [[is_leader]]
+// CHECK: [[counter:%[a-zA-Z0-9_]+]] = OpAccessChain {{%[a-zA-Z0-9_]+}} [[counters]]
+// CHECK: OpAtomicIAdd [[uint]] [[counter]] {{%[a-zA-Z0-9_]+}} {{%[a-zA-Z0-9_]+}} [[count]]
+
+kernel void foo(global int *out, int n) {
+  if (n > 0)
+    out[0] = n;
+}
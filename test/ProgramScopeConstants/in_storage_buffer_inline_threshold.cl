@@ -0,0 +1,28 @@
+// RUN: clspv %s -o %t.spv -module-constants-in-storage-buffer -module-constants-inline-threshold=16
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: clspv-reflection %t.spv -o %t.map
+// RUN: FileCheck -check-prefix=MAP %s < %t.map
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The small table stays inline. The big one goes to the storage buffer.
+__constant uint small[4] = {1, 2, 3, 4};
+__constant uint big[8] = {5, 6, 7, 8, 9, 10, 11, 12};
+
+kernel void foo(global uint* A, uint i) {
+  A[0] = small[i];
+  A[1] = big[i];
+}
+
+// MAP: constant,descriptorSet,1,binding,0,kind,buffer,hexbytes,05000000060000000700000008000000090000000a0000000b0000000c000000
+// MAP-NOT: constant
+
+// CHECK-DAG: OpDecorate [[clustered:%[a-zA-Z0-9_]+]] DescriptorSet 1
+// CHECK-DAG: [[uint:%[a-zA-Z0-9_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[uint_1:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 1
+// CHECK-DAG: [[uint_2:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 2
+// CHECK-DAG: [[uint_3:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 3
+// CHECK-DAG: [[uint_4:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 4
+// CHECK-DAG: [[small_init:%[a-zA-Z0-9_]+]] = OpConstantComposite {{%[a-zA-Z0-9_]+}} [[uint_1]] [[uint_2]] [[uint_3]] [[uint_4]]
+// CHECK-DAG: {{%[a-zA-Z0-9_]+}} = OpVariable {{%[a-zA-Z0-9_]+}} Private [[small_init]]
+// CHECK-DAG: [[clustered]] = OpVariable {{%[a-zA-Z0-9_]+}} StorageBuffer
@@ -0,0 +1,27 @@
+// RUN: clspv %s -o %t.spv -module-constants-in-storage-buffer
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: clspv-reflection %t.spv -o %t.map
+// RUN: FileCheck -check-prefix=MAP %s < %t.map
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The trailing elements of |table| and the second row of |rows| are not
+// stored again for |tail| and |row|.
+
+__constant uint table[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+__constant uint tail[3] = {6, 7, 8};
+__constant uint rows[2][3] = {{9, 10, 11}, {12, 13, 14}};
+__constant uint row[3] = {12, 13, 14};
+
+kernel void foo(global uint* A, uint i) {
+  A[0] = table[i];
+  A[1] = tail[i];
+  A[2] = rows[i][i];
+  A[3] = row[i];
+}
+
+// CHECK-DAG: [[uint:%[a-zA-Z0-9_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[uint_5:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 5
+// CHECK: OpIAdd [[uint]] {{%[a-zA-Z0-9_]+}} [[uint_5]]
+
+// MAP: constant,descriptorSet,1,binding,0,kind,buffer,hexbytes,0100000002000000030000000400000005000000060000000700000008000000090000000a0000000b0000000c0000000d0000000e000000
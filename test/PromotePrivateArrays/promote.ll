@@ -0,0 +1,70 @@
+; RUN: clspv-opt %s -o %t.ll -PromotePrivateArrays -private-array-promotion-threshold=8
+; RUN: FileCheck %s < %t.ll
+; RUN: clspv-opt %s -o %t.ll -PromotePrivateArrays -private-array-promotion-threshold=4
+; RUN: FileCheck --check-prefix=SMALL %s < %t.ll
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+; An array of 4 floats becomes a vector.
+; CHECK-LABEL: define spir_kernel void @vector
+; CHECK-NOT: alloca
+; CHECK: [[insert:%[a-zA-Z0-9_.]+]] = insertelement <4 x float> {{.*}}, float %x, i32 %i
+; CHECK: extractelement <4 x float> [[insert]], i32 %j
+; SMALL-LABEL: define spir_kernel void @vector
+; SMALL-NOT: alloca
+; SMALL: insertelement <4 x float>
+define spir_kernel void @vector(float addrspace(1)* %out, i32 %i, i32 %j, float %x) {
+entry:
+  %acc = alloca [4 x float], align 4
+  store [4 x float] zeroinitializer, [4 x float]* %acc
+  %p = getelementptr [4 x float], [4 x float]* %acc, i32 0, i32 %i
+  store float %x, float* %p
+  %q = getelementptr [4 x float], [4 x float]* %acc, i32 0, i32 %j
+  %v = load float, float* %q
+  store float %v, float addrspace(1)* %out
+  ret void
+}
+
+; An array of 8 floats becomes 8 values selected by the index.
+; CHECK-LABEL: define spir_kernel void @select
+; CHECK-NOT: alloca
+; CHECK: icmp eq i32 %i, 7
+; CHECK: select i1
+; CHECK: [[cmp:%[a-zA-Z0-9_.]+]] = icmp eq i32 %j, 7
+; CHECK: [[v:%[a-zA-Z0-9_.]+]] = select i1 [[cmp]]
+; CHECK: store float [[v]], float addrspace(1)* %out
+; It is too large with a threshold of 4.
+; SMALL-LABEL: define spir_kernel void @select
+; SMALL: alloca [8 x float]
+define spir_kernel void @select(float addrspace(1)* %out, i32 %i, i32 %j, float %x) {
+entry:
+  %acc = alloca [8 x float], align 4
+  %cast = bitcast [8 x float]* %acc to i8*
+  call void @llvm.lifetime.start.p0i8(i64 32, i8* %cast)
+  store [8 x float] zeroinitializer, [8 x float]* %acc
+  %p = getelementptr [8 x float], [8 x float]* %acc, i32 0, i32 %i
+  store float %x, float* %p
+  %q = getelementptr [8 x float], [8 x float]* %acc, i32 0, i32 %j
+  %v = load float, float* %q
+  store float %v, float addrspace(1)* %out
+  call void @llvm.lifetime.end.p0i8(i64 32, i8* %cast)
+  ret void
+}
+
+; An array whose address escapes stays in memory.
+; CHECK-LABEL: define spir_kernel void @escape
+; CHECK: alloca [4 x i32]
+define spir_kernel void @escape(i32 addrspace(1)* %out, i32 %i) {
+entry:
+  %arr = alloca [4 x i32], align 4
+  %p = getelementptr [4 x i32], [4 x i32]* %arr, i32 0, i32 %i
+  call spir_func void @init(i32* %p)
+  %v = load i32, i32* %p
+  store i32 %v, i32 addrspace(1)* %out
+  ret void
+}
+
+declare spir_func void @init(i32*)
+declare void @llvm.lifetime.start.p0i8(i64, i8*)
+declare void @llvm.lifetime.end.p0i8(i64, i8*)
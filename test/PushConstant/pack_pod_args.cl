@@ -0,0 +1,28 @@
+// RUN: clspv %s -o %t.spv -cluster-pod-kernel-args -pack-pod-args
+// RUN: clspv-reflection %t.spv -o %t.map
+// RUN: FileCheck -check-prefix=MAP %s < %t.map
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The float4 is placed first, so the struct needs no padding: 24 bytes
+// instead of 48 in declaration order.
+
+// MAP: kernel,foo,arg,A,argOrdinal,0,descriptorSet,0,binding,0,offset,0
+// MAP: kernel,foo,arg,n,argOrdinal,1,offset,16
+// MAP: kernel,foo,arg,c,argOrdinal,2,offset,0
+// MAP: kernel,foo,arg,m,argOrdinal,3,offset,20
+
+// CHECK: OpMemberDecorate [[podty:%[a-zA-Z0-9_]+]] 0 Offset 0
+// CHECK: OpMemberDecorate [[podty]] 1 Offset 16
+// CHECK: OpMemberDecorate [[podty]] 2 Offset 20
+// CHECK-DAG: [[float:%[a-zA-Z0-9_]+]] = OpTypeFloat 32
+// CHECK-DAG: [[uint:%[a-zA-Z0-9_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[float4:%[a-zA-Z0-9_]+]] = OpTypeVector [[float]] 4
+// CHECK-DAG: [[podty]] = OpTypeStruct [[float4]] [[uint]] [[uint]]
+
+void kernel __attribute__((reqd_work_group_size(1, 1, 1)))
+foo(global float *A, uint n, float4 c, uint m) {
+  A[n] = c.x + c.w;
+  A[m] = c.y;
+}
@@ -0,0 +1,31 @@
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-dis %t.spv -o %t.spvasm
+// RUN: FileCheck %s < %t.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+// RUN: clspv-reflection --arg-access %t.spv -o %t.map
+// RUN: FileCheck --check-prefix=MAP %s < %t.map
+
+void copy(global int *dst, global int *src) { *dst = *src; }
+
+kernel void foo(global int *in, global int *out, global int *inout,
+                global int *counter) {
+  copy(out, in);
+  inout[0] += 1;
+  atomic_inc(counter);
+}
+
+// CHECK-DAG: OpDecorate [[in:%[a-zA-Z0-9_]+]] Binding 0
+// CHECK-DAG: OpDecorate [[out:%[a-zA-Z0-9_]+]] Binding 1
+// CHECK-DAG: OpDecorate [[inout:%[a-zA-Z0-9_]+]] Binding 2
+// CHECK-DAG: OpDecorate [[counter:%[a-zA-Z0-9_]+]] Binding 3
+// CHECK-DAG: OpDecorate [[in]] NonWritable
+// CHECK-DAG: OpDecorate [[out]] NonReadable
+// CHECK-NOT: OpDecorate [[inout]] NonWritable
+// CHECK-NOT: OpDecorate [[inout]] NonReadable
+// CHECK-NOT: OpDecorate [[counter]] NonWritable
+// CHECK-NOT: OpDecorate [[counter]] NonReadable
+
+// MAP: kernel,foo,arg,in,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,buffer,argAccess,read_only
+// MAP: kernel,foo,arg,out,argOrdinal,1,descriptorSet,0,binding,1,offset,0,argKind,buffer,argAccess,write_only
+// MAP: kernel,foo,arg,inout,argOrdinal,2,descriptorSet,0,binding,2,offset,0,argKind,buffer,argAccess,read_write
+// MAP: kernel,foo,arg,counter,argOrdinal,3,descriptorSet,0,binding,3,offset,0,argKind,buffer,argAccess,atomic
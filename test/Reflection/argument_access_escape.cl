@@ -0,0 +1,14 @@
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-dis %t.spv -o %t.spvasm
+// RUN: FileCheck %s < %t.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The pointer returned by the helper is written through by the caller, so the
+// buffer must not be NonWritable.
+__attribute__((noinline)) global int *at(global int *p, int i) {
+  return p + i;
+}
+
+kernel void foo(global int *out) { *at(out, get_global_id(0)) = 1; }
+
+// CHECK-NOT: NonWritable
@@ -0,0 +1,28 @@
+// RUN: clspv %s -o %t.spv -immutable-literal-samplers
+// RUN: clspv-reflection %t.spv -o %t.map
+// RUN: FileCheck %s < %t.map
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The literal samplers share a descriptor set that holds nothing else.
+// CHECK-DAG: sampler,23,{{.*}},descriptorSet,0,binding,[[B0:[0-9]+]]
+// CHECK-DAG: immutable_sampler,descriptorSet,0,binding,[[B0]],filter,0,addressMode,0,unnormalizedCoordinates,0,borderColor,0
+// CHECK-DAG: sampler,34,{{.*}},descriptorSet,0,binding,[[B1:[0-9]+]]
+// CHECK-DAG: immutable_sampler,descriptorSet,0,binding,[[B1]],filter,1,addressMode,2,unnormalizedCoordinates,1,borderColor,0
+// CHECK-DAG: sampler,21,{{.*}},descriptorSet,0,binding,[[B2:[0-9]+]]
+// CHECK-DAG: immutable_sampler,descriptorSet,0,binding,[[B2]],filter,0,addressMode,3,unnormalizedCoordinates,1,borderColor,0
+// CHECK-DAG: kernel,foo,arg,i1,argOrdinal,0,descriptorSet,1,
+
+const sampler_t s0 =
+CLK_NORMALIZED_COORDS_TRUE | CLK_ADDRESS_REPEAT | CLK_FILTER_NEAREST;
+
+const sampler_t s1 =
+CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR;
+
+const sampler_t s2 =
+CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP | CLK_FILTER_NEAREST;
+
+kernel void foo(read_only image2d_t i1, global float4 *out) {
+  out[0] = read_imagef(i1, s0, (float2)(0.0));
+  out[1] = read_imagef(i1, s1, (float2)(0.0));
+  out[2] = read_imagef(i1, s2, (float2)(0.0));
+}
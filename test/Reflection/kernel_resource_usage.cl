@@ -0,0 +1,34 @@
+// RUN: clspv %s -o %t.spv -kernel-resource-usage
+// RUN: clspv-reflection %t.spv -o %t.map
+// RUN: FileCheck %s < %t.map
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// CHECK: kernel,copy2d,resource_usage,workgroupBytes,0,privateBytes,{{[0-9]+}},pushConstantBytes,{{[0-9]+}}
+// CHECK-NEXT: kernel,copy2d,suggested_local_size,16,8,1
+kernel void copy2d(global float *out, global float *in, int width) {
+  int i = get_global_id(1) * width + get_global_id(0);
+  out[i] = in[i];
+}
+
+// The required work-group size is the suggested local size.
+// CHECK: kernel,tiled,resource_usage,workgroupBytes,256,privateBytes,{{[0-9]+}},pushConstantBytes,{{[0-9]+}}
+// CHECK-NEXT: kernel,tiled,suggested_local_size,8,8,1
+__attribute__((reqd_work_group_size(8, 8, 1)))
+kernel void tiled(global float *out) {
+  local float tile[64];
+  int i = get_local_id(1) * 8 + get_local_id(0);
+  tile[i] = out[get_global_id(0)];
+  barrier(CLK_LOCAL_MEM_FENCE);
+  out[get_global_id(0)] = tile[63 - i];
+}
+
+// More than 8KB of workgroup memory asks for larger workgroups.
+// CHECK: kernel,large,resource_usage,workgroupBytes,16384,privateBytes,{{[0-9]+}},pushConstantBytes,{{[0-9]+}}
+// CHECK-NEXT: kernel,large,suggested_local_size,256,1,1
+kernel void large(global float *out) {
+  local float data[4096];
+  uint i = get_global_id(0);
+  data[i % 4096] = out[i];
+  barrier(CLK_LOCAL_MEM_FENCE);
+  out[i] = data[(i + 1) % 4096];
+}
@@ -0,0 +1,24 @@
+// RUN: clspv %s -o %t.spv -DNAME=foo
+// RUN: clspv %s -o %t2.spv -DNAME=bar
+// RUN: clspv-reflection -j 2 %t.spv %t2.spv -o %t.map
+// RUN: FileCheck %s < %t.map
+// RUN: echo %t.spv > %t.manifest
+// RUN: echo %t2.spv >> %t.manifest
+// RUN: clspv-reflection --format json --manifest %t.manifest -o %t.json
+// RUN: FileCheck --check-prefix=JSON %s < %t.json
+
+// The modules are listed in input order, whatever order they are parsed in.
+
+// CHECK: module,{{.*}}.spv
+// CHECK-NEXT: kernel,foo,arg,out,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,buffer
+// CHECK-NEXT: kernel,foo,arg,in,argOrdinal,1,descriptorSet,0,binding,1,offset,0,argKind,buffer
+// CHECK: module,{{.*}}2.spv
+// CHECK-NEXT: kernel,bar,arg,out,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,buffer
+// CHECK-NEXT: kernel,bar,arg,in,argOrdinal,1,descriptorSet,0,binding,1,offset,0,argKind,buffer
+
+// JSON: {
+// JSON-NEXT: "{{.*}}.spv":{"kernels":[{"name":"foo","args":[{"name":"out","ordinal":0,"kind":"buffer","descriptor_set":0,"binding":0,"access":[{{.*}}]},{"name":"in","ordinal":1,"kind":"buffer","descriptor_set":0,"binding":1,"access":[{{.*}}]}]}],"push_constants":[{{.*}}],"literal_samplers":[]},
+// JSON-NEXT: "{{.*}}2.spv":{"kernels":[{"name":"bar",{{.*}}],"literal_samplers":[]}
+// JSON-NEXT: }
+
+kernel void NAME(global int *out, global int *in) { *out = *in; }
@@ -0,0 +1,31 @@
+// RUN: clspv %s -o %t.spv -global-offset
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+// RUN: clspv-reflection --format json --shared-bindings %t.spv -o %t.json
+// RUN: FileCheck %s < %t.json
+
+// The JSON output is written from the clspv_reflection_info parser, so this
+// covers each kind of entry it reads.
+
+// CHECK: "kernels":[{"name":"foo","reqd_work_group_size":[4,2,1],"args":[
+// CHECK-SAME: {"name":"out","ordinal":0,"kind":"buffer","descriptor_set":0,"binding":0,"access":[{{[^]]*}}"write"{{[^]]*}}]}
+// CHECK-SAME: {"name":"tmp","ordinal":1,"kind":"local","spec_id":[[SPEC:[0-9]+]],"element_size":4}
+// CHECK-SAME: {"name":"n","ordinal":2,"kind":"pod{{[_a-z]*}}",{{.*}}"offset":0,"size":4}
+// CHECK-SAME: {"name":"img","ordinal":3,"kind":"ro_image","descriptor_set":0,"binding":{{[0-9]+}},
+// CHECK-SAME: {"name":"bar","args":[{"name":"out","ordinal":0,"kind":"buffer","descriptor_set":0,"binding":0,
+// CHECK-SAME: "push_constants":[{"kind":"global_offset","offset":0,"size":{{[0-9]+}}}]
+// CHECK-SAME: "spec_constants":[
+// CHECK-SAME: {"kind":"local_memory_size","spec_id":[[SPEC]],"kernel":"foo","ordinal":1}
+// CHECK-SAME: "literal_samplers":[{"mask":{{[0-9]+}},"descriptor_set":{{[0-9]+}},"binding":{{[0-9]+}}}]
+// CHECK-SAME: "shared_bindings":[{"descriptor_set":0,"binding":0,"kind":"buffer","kernels":2}]
+
+const sampler_t smp =
+    CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP | CLK_FILTER_NEAREST;
+
+kernel __attribute__((reqd_work_group_size(4, 2, 1))) void
+foo(global float4 *out, local float *tmp, int n, read_only image2d_t img) {
+  tmp[get_local_id(0)] = n;
+  barrier(CLK_LOCAL_MEM_FENCE);
+  out[get_global_id(0)] = read_imagef(img, smp, (int2)(0, 0)) * tmp[0];
+}
+
+kernel void bar(global float4 *out) { out[get_global_id(0)] = 0.0f; }
@@ -0,0 +1,5 @@
+// A module header with the largest id bound, followed by an OpExtInstImport
+// too short to hold its name, must be rejected rather than crash the
+// clspv_reflection_info parser.
+// RUN: printf '\003\002\043\007\000\000\001\000\000\000\000\000\377\377\377\377\000\000\000\000\013\000\002\000\001\000\000\000' > %t.spv
+// RUN: not clspv-reflection -d --format json %t.spv -o %t.json
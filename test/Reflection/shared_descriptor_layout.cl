@@ -0,0 +1,28 @@
+// RUN: clspv %s -o %t.spv -shared-descriptor-layout
+// RUN: clspv-reflection --shared-bindings %t.spv -o %t.map
+// RUN: FileCheck %s < %t.map
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+// RUN: clspv %s -o %t2.spv
+// RUN: clspv-reflection --shared-bindings %t2.spv -o %t2.map
+// RUN: FileCheck --check-prefix=DEFAULT %s < %t2.map
+
+// The second argument is an image in one kernel and a buffer in the other.
+// With a shared layout they get different bindings so that one descriptor set
+// layout fits both kernels.
+
+// CHECK: kernel,foo,arg,data,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,buffer
+// CHECK: kernel,foo,arg,im,argOrdinal,1,descriptorSet,0,binding,1,offset,0,argKind,ro_image
+// CHECK: kernel,bar,arg,data,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,buffer
+// CHECK: kernel,bar,arg,out,argOrdinal,1,descriptorSet,0,binding,2,offset,0,argKind,buffer
+// CHECK: shared_binding,descriptorSet,0,binding,0,argKind,buffer,kernels,2
+// CHECK-NOT: shared_binding
+
+// DEFAULT: kernel,bar,arg,out,argOrdinal,1,descriptorSet,0,binding,1,offset,0,argKind,buffer
+// DEFAULT: shared_binding,descriptorSet,0,binding,0,argKind,buffer,kernels,2
+// DEFAULT: shared_binding,descriptorSet,0,binding,1,argKind,ro_image,kernels,2
+
+kernel void foo(global float4 *data, read_only image2d_t im) {
+  *data = read_imagef(im, (int2)(0, 0));
+}
+
+kernel void bar(global float4 *data, global float4 *out) { *out = *data; }
@@ -0,0 +1,32 @@
+// RUN: clspv %s -o %t.spv -relaxed-precision=builtins
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: FileCheck --check-prefix=COUNT %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck --check-prefix=NONE %s < %t2.spvasm
+
+// The results of native_sin and native_divide are relaxed, and so is the
+// addition of a constant to them, but not the multiplication by a value read
+// from memory.
+// CHECK-DAG: OpDecorate %[[sin:[0-9a-zA-Z_]+]] RelaxedPrecision
+// CHECK-DAG: OpDecorate %[[div:[0-9a-zA-Z_]+]] RelaxedPrecision
+// CHECK-DAG: OpDecorate %[[add:[0-9a-zA-Z_]+]] RelaxedPrecision
+// CHECK: %[[sin]] = OpExtInst %{{[0-9a-zA-Z_]+}} %{{[0-9a-zA-Z_]+}} Sin
+// CHECK: %[[div]] = OpFDiv %{{[0-9a-zA-Z_]+}} %[[sin]]
+// CHECK: %[[add]] = OpFAdd %{{[0-9a-zA-Z_]+}} %[[div]]
+// CHECK: OpFMul %{{[0-9a-zA-Z_]+}} {{.*}}%[[add]]
+
+// COUNT-COUNT-3: RelaxedPrecision
+// COUNT-NOT: RelaxedPrecision
+
+// NONE-NOT: RelaxedPrecision
+
+kernel void foo(global float *out, global float *in, float x) {
+  uint i = get_global_id(0);
+  float s = native_sin(in[i]);
+  float d = native_divide(s, x);
+  float t = d + 1.0f;
+  out[i] = t * in[i + 1];
+}
@@ -0,0 +1,21 @@
+// RUN: clspv %s -o %t.spv -relaxed-precision=relaxed-math -cl-fast-relaxed-math
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+// RUN: clspv %s -o %t.spv -relaxed-precision=relaxed-math
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck --check-prefix=PRECISE %s < %t2.spvasm
+
+// Under relaxed math, all float arithmetic and builtins are relaxed.
+// CHECK-DAG: OpDecorate %[[exp:[0-9a-zA-Z_]+]] RelaxedPrecision
+// CHECK-DAG: OpDecorate %[[mul:[0-9a-zA-Z_]+]] RelaxedPrecision
+// CHECK: %[[exp]] = OpExtInst %{{[0-9a-zA-Z_]+}} %{{[0-9a-zA-Z_]+}} Exp
+// CHECK: %[[mul]] = OpFMul %{{[0-9a-zA-Z_]+}} {{.*}}%[[exp]]
+
+// Without it, they are not.
+// PRECISE-NOT: RelaxedPrecision
+
+kernel void foo(global float *out, global float *in, float x) {
+  uint i = get_global_id(0);
+  out[i] = exp(in[i]) * x;
+}
@@ -0,0 +1,42 @@
+; RUN: clspv-opt %s -RewriteInserts -member-stores-for-inserts -o %t.ll
+; RUN: FileCheck %s < %t.ll
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+%s = type { i32, float, i32 }
+
+; CHECK-LABEL: @complete
+; CHECK-NOT: insertvalue
+; CHECK: [[gep0:%[0-9a-zA-Z_.]+]] = getelementptr inbounds %s, %s addrspace(1)* %p, i32 0, i32 0
+; CHECK: store i32 %a, i32 addrspace(1)* [[gep0]], align 16
+; CHECK: [[gep1:%[0-9a-zA-Z_.]+]] = getelementptr inbounds %s, %s addrspace(1)* %p, i32 0, i32 1
+; CHECK: store float %b, float addrspace(1)* [[gep1]], align 4
+; CHECK: [[gep2:%[0-9a-zA-Z_.]+]] = getelementptr inbounds %s, %s addrspace(1)* %p, i32 0, i32 2
+; CHECK: store i32 %c, i32 addrspace(1)* [[gep2]], align 8
+; CHECK-NOT: store
+; CHECK: ret void
+define void @complete(%s addrspace(1)* %p, i32 %a, float %b, i32 %c) {
+entry:
+  %0 = insertvalue %s undef, i32 %a, 0
+  %1 = insertvalue %s %0, float %b, 1
+  %2 = insertvalue %s %1, i32 %c, 2
+  store %s %2, %s addrspace(1)* %p, align 16
+  ret void
+}
+
+; The base provides the members that are not inserted.
+; CHECK-LABEL: @partial
+; CHECK-NOT: insertvalue
+; CHECK: store %s %in, %s addrspace(1)* %p, align 4
+; CHECK: [[gep:%[0-9a-zA-Z_.]+]] = getelementptr inbounds %s, %s addrspace(1)* %p, i32 0, i32 1
+; CHECK: store float %b, float addrspace(1)* [[gep]], align 4
+; CHECK-NOT: store
+; CHECK: ret void
+define void @partial(%s addrspace(1)* %p, %s %in, float %a, float %b) {
+entry:
+  %0 = insertvalue %s %in, float %a, 1
+  %1 = insertvalue %s %0, float %b, 1
+  store %s %1, %s addrspace(1)* %p, align 4
+  ret void
+}
@@ -0,0 +1,29 @@
+// RUN: %python %S/server_frames.py request %s --id 7 -o %t.req0
+// RUN: %python %S/server_frames.py request %s --id 8 --options=-DBROKEN -o %t.req1
+// RUN: cat %t.req0 %t.req1 | clspv-server --options=-cl-std=CL1.2 > %t.resp
+// RUN: %python %S/server_frames.py response %t.resp --binary-prefix %t.resp | FileCheck %s
+// RUN: spirv-dis -o %t.spvasm %t.resp0.spv
+// RUN: FileCheck %s --check-prefix=SPIRV < %t.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.resp0.spv
+
+// The first request compiles, and its response carries the module and its
+// reflection sidecar.
+// CHECK: response,0,magic,ok,id,7,status,ok
+// CHECK-NEXT: response,0,binary_words,{{[1-9][0-9]*}},sidecar_words,{{[1-9][0-9]*}},log_size,0
+// CHECK-NEXT: response,0,sidecar_magic,ok
+
+// The second fails, with the diagnostics in the log and no module.
+// CHECK-NEXT: response,1,magic,ok,id,8,status,error
+// CHECK-NEXT: response,1,binary_words,0,sidecar_words,0,log_size,{{[1-9][0-9]*}}
+// CHECK-NEXT: response,1,log,{{.*}}error: use of undeclared identifier 'broken'
+
+// SPIRV: OpEntryPoint GLCompute %{{[a-zA-Z0-9_]+}} "foo"
+// SPIRV: OpConstant %{{[a-zA-Z0-9_]+}} 42
+
+kernel void foo(global int *out) {
+#ifdef BROKEN
+  out[0] = broken;
+#else
+  out[0] = 42;
+#endif
+}
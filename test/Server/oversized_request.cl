@@ -0,0 +1,6 @@
+// A request claiming a 4 GiB source is rejected before anything is allocated.
+// RUN: printf 'CLSQ\000\000\000\000\000\000\000\000\000\000\000\000\377\377\377\377' > %t.req
+// RUN: not clspv-server < %t.req > %t.resp 2> %t.err
+// RUN: FileCheck %s < %t.err
+
+// CHECK: error: malformed request
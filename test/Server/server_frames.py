@@ -0,0 +1,105 @@
+#!/usr/bin/env python
+# Copyright 2021 The Clspv Authors. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Writes clspv-server requests and reads its responses for the tests. See
+# tools/server/main.cpp for the framing.
+
+import struct
+import sys
+
+REQUEST_MAGIC = 0x51534c43
+RESPONSE_MAGIC = 0x52534c43
+SIDECAR_MAGIC = 0x46524c43
+
+def request(args):
+    with open(args.source, 'rb') as source:
+        contents = source.read()
+    options = args.options.encode('utf-8')
+    with open(args.output, 'wb') as output:
+        output.write(struct.pack('=5I', REQUEST_MAGIC, args.id, len(options),
+                                 0, len(contents)))
+        output.write(options)
+        output.write(contents)
+
+def response(args):
+    with open(args.input, 'rb') as input:
+        data = input.read()
+    index = 0
+    offset = 0
+    while offset < len(data):
+        magic, id, status, binary_words, sidecar_words, log_size = \
+                struct.unpack_from('=6I', data, offset)
+        offset += 24
+        binary = data[offset:offset + 4 * binary_words]
+        offset += 4 * binary_words
+        sidecar = data[offset:offset + 4 * sidecar_words]
+        offset += 4 * sidecar_words
+        log = data[offset:offset + log_size].decode('utf-8')
+        offset += log_size
+
+        print('response,%d,magic,%s,id,%d,status,%s' %
+              (index, 'ok' if magic == RESPONSE_MAGIC else 'bad', id,
+               'ok' if status == 0 else 'error'))
+        print('response,%d,binary_words,%d,sidecar_words,%d,log_size,%d' %
+              (index, binary_words, sidecar_words, log_size))
+        if sidecar:
+            sidecar_magic, = struct.unpack_from('=I', sidecar)
+            print('response,%d,sidecar_magic,%s' %
+                  (index, 'ok' if sidecar_magic == SIDECAR_MAGIC else 'bad'))
+        for line in log.splitlines():
+            print('response,%d,log,%s' % (index, line))
+        if binary and args.binary_prefix:
+            with open('%s%d.spv' % (args.binary_prefix, index), 'wb') as out:
+                out.write(binary)
+        index += 1
+    if offset != len(data):
+        print('error: truncated response')
+        sys.exit(1)
+
+def main():
+    import argparse
+    parser = argparse.ArgumentParser(
+            description='Write clspv-server requests and read its responses')
+    subparsers = parser.add_subparsers(dest='command')
+
+    request_parser = subparsers.add_parser('request',
+            help='frame a request for a source file')
+    request_parser.add_argument('source', metavar='<path>', type=str,
+            help='OpenCL C source file')
+    request_parser.add_argument('--id', type=int, default=0,
+            help='request id')
+    request_parser.add_argument('--options', type=str, default='',
+            help='compile options of the request')
+    request_parser.add_argument('-o', dest='output', metavar='<path>',
+            type=str, required=True, help='output file')
+
+    response_parser = subparsers.add_parser('response',
+            help='print the responses in a file')
+    response_parser.add_argument('input', metavar='<path>', type=str,
+            help='responses written by clspv-server')
+    response_parser.add_argument('--binary-prefix', metavar='<path>',
+            type=str, help='write the binary of response N to <path>N.spv')
+
+    args = parser.parse_args()
+    if args.command == 'request':
+        request(args)
+    elif args.command == 'response':
+        response(args)
+    else:
+        parser.print_help()
+        sys.exit(1)
+
+if __name__ == '__main__':
+    main()
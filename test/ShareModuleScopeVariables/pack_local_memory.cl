@@ -0,0 +1,32 @@
+// RUN: clspv %s -o %t.spv -pack-local-memory
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+// RUN: clspv %s -o %t3.spv
+// RUN: spirv-dis -o %t4.spvasm %t3.spv
+// RUN: FileCheck -check-prefix=NOPACK %s < %t4.spvasm
+
+// A barrier separates the accesses to |a| from the accesses to |b|, so with
+// -pack-local-memory they share one workgroup variable.
+
+kernel void foo(global int *in, global int *out, int n) {
+  local int a[32];
+  local int b[32];
+  a[n] = in[n];
+  barrier(CLK_LOCAL_MEM_FENCE);
+  out[n] = a[n + 1];
+  barrier(CLK_LOCAL_MEM_FENCE);
+  b[n] = in[n + 2];
+  barrier(CLK_LOCAL_MEM_FENCE);
+  out[n + 3] = b[n + 4];
+}
+
+// CHECK-NOT: OpVariable {{.*}} Workgroup
+// CHECK: [[shared:%[a-zA-Z0-9_]+]] = OpVariable {{.*}} Workgroup
+// CHECK-NOT: OpVariable {{.*}} Workgroup
+// CHECK: OpAccessChain {{.*}} [[shared]]
+// CHECK: OpControlBarrier
+// CHECK: OpAccessChain {{.*}} [[shared]]
+
+// NOPACK: OpVariable {{.*}} Workgroup
+// NOPACK: OpVariable {{.*}} Workgroup
@@ -0,0 +1,32 @@
+// RUN: clspv %s -o %t.spv -pack-local-memory
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// |a| is read again after |b| is written, so they cannot share storage, and
+// neither can variables used across a barrier in a loop.
+
+kernel void foo(global int *in, global int *out, int n) {
+  local int a[32];
+  local int b[32];
+  a[n] = in[n];
+  barrier(CLK_LOCAL_MEM_FENCE);
+  b[n] = in[n + 2];
+  barrier(CLK_LOCAL_MEM_FENCE);
+  out[n] = a[n + 1] + b[n + 4];
+}
+
+kernel void bar(global int *in, global int *out, int n) {
+  local int c[32];
+  local int d[32];
+  for (int i = 0; i < n; ++i) {
+    c[n] = in[i];
+    barrier(CLK_LOCAL_MEM_FENCE);
+    d[n] = c[n + 1];
+    barrier(CLK_LOCAL_MEM_FENCE);
+    out[i] = d[n + 2];
+  }
+}
+
+// CHECK: OpVariable {{.*}} Workgroup
+// CHECK: OpVariable {{.*}} Workgroup
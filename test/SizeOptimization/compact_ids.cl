@@ -0,0 +1,15 @@
+// RUN: clspv %s -o %t.spv -Os
+// RUN: spirv-opt --compact-ids %t.spv -o %t.compact.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv --raw-id
+// RUN: spirv-dis -o %t3.spvasm %t.compact.spv --raw-id
+// RUN: cat %t2.spvasm %t3.spvasm | FileCheck %s
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// IDs are renumbered compactly, so compacting them again leaves the bound
+// unchanged.
+// CHECK: ; Bound: [[BOUND:[0-9]+]]
+// CHECK: ; Bound: [[BOUND]]{{$}}
+
+kernel void foo(global int *out, int a, int b) {
+  out[0] = a + b;
+}
@@ -0,0 +1,16 @@
+// RUN: clspv %s -o %t.spv -Os
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+// RUN: clspv-reflection %t.spv -o %t.map
+// RUN: FileCheck %s < %t.map
+// RUN: clspv %s -o %t2.spv -Oz
+// RUN: spirv-val --target-env vulkan1.0 %t2.spv
+// RUN: clspv-reflection %t2.spv -o %t2.map
+// RUN: FileCheck %s < %t2.map
+
+// The reflection instructions survive the size optimization.
+// CHECK: kernel,foo,arg,out,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,buffer
+// CHECK-NEXT: kernel,foo,arg,in,argOrdinal,1,descriptorSet,0,binding,1,offset,0,argKind,buffer
+
+kernel void foo(global float *out, global float *in) {
+  out[get_global_id(0)] = in[get_global_id(0)] * 2.0f;
+}
@@ -0,0 +1,18 @@
+// RUN: clspv %s -o %t.spv -skip-unused-kernel-args
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// Only |out| and |in| get bindings, and they are contiguous.
+// CHECK-DAG: OpDecorate [[out:%[a-zA-Z0-9_]+]] Binding 0
+// CHECK-DAG: OpDecorate [[in:%[a-zA-Z0-9_]+]] Binding 1
+// CHECK-NOT: Binding 2
+// CHECK-DAG: [[uint_0:%[a-zA-Z0-9_]+]] = OpConstant {{%[a-zA-Z0-9_]+}} 0
+// CHECK-DAG: [[uint_2:%[a-zA-Z0-9_]+]] = OpConstant {{%[a-zA-Z0-9_]+}} 2
+// CHECK: ArgumentStorageBuffer {{%[a-zA-Z0-9_]+}} [[uint_0]]
+// CHECK: ArgumentStorageBuffer {{%[a-zA-Z0-9_]+}} [[uint_2]]
+// CHECK-NOT: ArgumentStorageBuffer
+
+kernel void foo(global int *out, global int *unused, global int *in) {
+  *out = *in;
+}
@@ -0,0 +1,47 @@
+; RUN: clspv-opt %s -o %t.ll -SpecializeGenericAddressSpace
+; RUN: FileCheck %s < %t.ll
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+; Global and local arguments each get a clone, shared by calls with the same
+; address spaces.
+; CHECK-LABEL: define spir_kernel void @test
+; CHECK: call spir_func void @fill_clspv_as_1(i32 addrspace(1)*
+; CHECK: call spir_func void @fill_clspv_as_3(i32 addrspace(3)*
+; CHECK: call spir_func void @fill_clspv_as_1(i32 addrspace(1)*
+define spir_kernel void @test(i32 addrspace(1)* %gout, i32 addrspace(3)* %lout) {
+entry:
+  %g = addrspacecast i32 addrspace(1)* %gout to i32 addrspace(4)*
+  %l = addrspacecast i32 addrspace(3)* %lout to i32 addrspace(4)*
+  call spir_func void @fill(i32 addrspace(4)* %g)
+  call spir_func void @fill(i32 addrspace(4)* %l)
+  %g1 = getelementptr i32, i32 addrspace(4)* %g, i32 1
+  %g2 = getelementptr i32, i32 addrspace(4)* %g1, i32 -1
+  call spir_func void @fill(i32 addrspace(4)* %g2)
+  ret void
+}
+
+; A select between address spaces cannot be specialized: the call is inlined.
+; CHECK-LABEL: define spir_kernel void @mixed
+; CHECK-NOT: call
+; CHECK: [[sel:%[a-zA-Z0-9_.]+]] = select i1 %c, i32 addrspace(4)* %g, i32 addrspace(4)* %l
+; CHECK: store i32 42, i32 addrspace(4)* [[sel]]
+define spir_kernel void @mixed(i32 addrspace(1)* %gout, i32 addrspace(3)* %lout, i1 %c) {
+entry:
+  %g = addrspacecast i32 addrspace(1)* %gout to i32 addrspace(4)*
+  %l = addrspacecast i32 addrspace(3)* %lout to i32 addrspace(4)*
+  %sel = select i1 %c, i32 addrspace(4)* %g, i32 addrspace(4)* %l
+  call spir_func void @fill(i32 addrspace(4)* %sel)
+  ret void
+}
+
+; The original function is removed once every call is rewritten.
+; CHECK-NOT: define spir_func void @fill(
+; CHECK-DAG: define spir_func void @fill_clspv_as_1(i32 addrspace(1)* %out)
+; CHECK-DAG: define spir_func void @fill_clspv_as_3(i32 addrspace(3)* %out)
+define spir_func void @fill(i32 addrspace(4)* %out) {
+entry:
+  store i32 42, i32 addrspace(4)* %out
+  ret void
+}
@@ -0,0 +1,26 @@
+// RUN: clspv %s -o %t.spv -split-kernels -cl-kernel-arg-info
+// RUN: spirv-dis -o %t.foo.spvasm %t.foo.spv
+// RUN: FileCheck %s --check-prefix=FOO < %t.foo.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.foo.spv
+// RUN: spirv-dis -o %t.bar.spvasm %t.bar.spv
+// RUN: FileCheck %s --check-prefix=BAR < %t.bar.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.bar.spv
+
+// Each module has a single entry point and only the reflection of its kernel.
+// FOO: OpEntryPoint GLCompute %{{[0-9a-zA-Z_]+}} "foo"
+// FOO-NOT: OpEntryPoint
+// FOO-NOT: OpFMul
+// FOO: ArgumentInfo %{{[0-9a-zA-Z_]+}}
+// FOO-NOT: "scale"
+// FOO-NOT: ArgumentInfo
+
+// BAR: OpEntryPoint GLCompute %{{[0-9a-zA-Z_]+}} "bar"
+// BAR-NOT: OpEntryPoint
+// BAR: OpFMul
+// BAR: ArgumentInfo %{{[0-9a-zA-Z_]+}}
+// BAR-NOT: "dst"
+// BAR-NOT: ArgumentInfo
+
+kernel void foo(global int *dst) { dst[0] = 1; }
+
+kernel void bar(global float *scale) { scale[0] = scale[1] * scale[2]; }
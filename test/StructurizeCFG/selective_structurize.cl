@@ -0,0 +1,28 @@
+// RUN: clspv %s -o %t.spv -structurize-unstructured-only
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// CHECK: OpLoopMerge
+// CHECK: OpLoopMerge
+// CHECK: OpSelectionMerge
+
+// Already structured, so the structurizer is skipped.
+kernel void foo(global int *out, global int *in, int n) {
+  for (int i = 0; i < n; ++i) {
+    if (in[i] > 0)
+      out[i] = in[i];
+  }
+}
+
+// An if/else, which the structurizer handles unless one side can only
+// continue.
+kernel void bar(global int *out, global int *in, int n) {
+  for (int i = 0; i < n; ++i) {
+    if (in[i] > 0) {
+      out[i] = in[i];
+    } else {
+      out[i] = -in[i];
+    }
+  }
+}
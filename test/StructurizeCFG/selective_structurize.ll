@@ -0,0 +1,59 @@
+; RUN: clspv-opt -SelectiveStructurizeCFG %s -o %t
+; RUN: FileCheck %s < %t
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+; A counted loop containing an if without else is already structured and is
+; left untouched.
+; CHECK-LABEL: define spir_func void @structured
+; CHECK-NOT: Flow
+; CHECK: ret void
+define spir_func void @structured(i32 addrspace(1)* %out, i32 %n) {
+entry:
+  %cmp = icmp sgt i32 %n, 0
+  br i1 %cmp, label %loop, label %exit
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %inc, %latch ]
+  %odd = and i32 %i, 1
+  %is_odd = icmp ne i32 %odd, 0
+  br i1 %is_odd, label %then, label %latch
+
+then:
+  %gep = getelementptr i32, i32 addrspace(1)* %out, i32 %i
+  store i32 %i, i32 addrspace(1)* %gep
+  br label %latch
+
+latch:
+  %inc = add nuw nsw i32 %i, 1
+  %done = icmp eq i32 %inc, %n
+  br i1 %done, label %loop_exit, label %loop
+
+loop_exit:
+  br label %exit
+
+exit:
+  ret void
+}
+
+; An if/else diamond still goes through the structurizer.
+; CHECK-LABEL: define spir_func void @diamond
+; CHECK: Flow
+; CHECK: ret void
+define spir_func void @diamond(i32 addrspace(1)* %out, i32 %x) {
+entry:
+  %cmp = icmp sgt i32 %x, 0
+  br i1 %cmp, label %then, label %else
+
+then:
+  store i32 1, i32 addrspace(1)* %out
+  br label %merge
+
+else:
+  store i32 2, i32 addrspace(1)* %out
+  br label %merge
+
+merge:
+  ret void
+}
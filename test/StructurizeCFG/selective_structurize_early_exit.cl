@@ -0,0 +1,21 @@
+// RUN: clspv %s -o %t.spv -structurize-unstructured-only
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// CHECK: OpLoopMerge
+// CHECK: OpLoopMerge
+// CHECK: OpSelectionMerge
+
+// The return out of both loops gets single loop exits rather than the
+// structurizer.
+kernel void find(global int *out, global int *data, int n) {
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      if (data[i * n + j] == 0) {
+        out[0] = i * n + j;
+        return;
+      }
+    }
+  }
+}
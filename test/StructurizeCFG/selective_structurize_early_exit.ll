@@ -0,0 +1,64 @@
+; RUN: clspv-opt -SelectiveStructurizeCFG %s -o %t
+; RUN: FileCheck %s < %t
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+; A return out of two nested loops. Each loop gets a single exit block, which
+; dispatches on the exit taken, and the return gets its own block instead of
+; going through flow blocks.
+; CHECK-LABEL: define spir_func void @find
+; CHECK-NOT: Flow
+; CHECK: inner:
+; CHECK: br i1 %zero, label %loop.exit, label %inner.latch
+; CHECK: inner.latch:
+; CHECK: br i1 %j.done, label %loop.exit, label %inner
+; CHECK: outer.latch:
+; CHECK: br i1 %i.done, label %[[outer_exit:[a-zA-Z0-9_.]+]], label %outer
+; CHECK: loop.exit:
+; CHECK: [[id:%[a-zA-Z0-9_.]+]] = phi i32 [ 0, %inner ], [ 1, %inner.latch ]
+; CHECK: [[cmp:%[a-zA-Z0-9_.]+]] = icmp eq i32 [[id]], 0
+; CHECK: br i1 [[cmp]], label %[[outer_exit]], label %outer.latch
+; CHECK: [[outer_exit]]:
+; CHECK: [[id:%[a-zA-Z0-9_.]+]] = phi i32
+; CHECK: [[cmp:%[a-zA-Z0-9_.]+]] = icmp eq i32 [[id]], 0
+; CHECK: br i1 [[cmp]], label %found, label %exit
+; CHECK: found:
+; CHECK: store i32
+; CHECK-NEXT: ret void
+; CHECK: exit:
+; CHECK-NEXT: ret void
+define spir_func void @find(i32 addrspace(1)* %data, i32 addrspace(1)* %out, i32 %n) {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i32 [ 0, %entry ], [ %i.inc, %outer.latch ]
+  br label %inner
+
+inner:
+  %j = phi i32 [ 0, %outer ], [ %j.inc, %inner.latch ]
+  %row = mul i32 %i, %n
+  %idx = add i32 %row, %j
+  %gep = getelementptr i32, i32 addrspace(1)* %data, i32 %idx
+  %ld = load i32, i32 addrspace(1)* %gep
+  %zero = icmp eq i32 %ld, 0
+  br i1 %zero, label %found, label %inner.latch
+
+inner.latch:
+  %j.inc = add i32 %j, 1
+  %j.done = icmp eq i32 %j.inc, %n
+  br i1 %j.done, label %outer.latch, label %inner
+
+outer.latch:
+  %i.inc = add i32 %i, 1
+  %i.done = icmp eq i32 %i.inc, %n
+  br i1 %i.done, label %exit, label %outer
+
+found:
+  store i32 %idx, i32 addrspace(1)* %out
+  br label %exit
+
+exit:
+  ret void
+}
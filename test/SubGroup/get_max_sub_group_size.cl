@@ -0,0 +1,17 @@
+// RUN: clspv %s -cl-std=CL2.0 -spv-version=1.3 -inline-entry-points -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.2 %t.spv
+
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
+
+// CHECK-DAG: OpDecorate %[[SUBGROUP_SIZE:[a-zA-Z0-9_]*]] BuiltIn SubgroupSize
+// CHECK-DAG: OpDecorate %[[NUM_SUBGROUPS:[a-zA-Z0-9_]*]] BuiltIn NumSubgroups
+// CHECK-DAG: %[[UINT_TYPE_ID:[a-zA-Z0-9_]*]] = OpTypeInt 32 0
+// CHECK-DAG: OpLoad %[[UINT_TYPE_ID]] %[[SUBGROUP_SIZE]]
+// CHECK-DAG: OpLoad %[[UINT_TYPE_ID]] %[[NUM_SUBGROUPS]]
+void kernel test(global uint *c)
+{
+  uint i = get_global_id(0);
+  c[i] = get_max_sub_group_size() + get_enqueued_num_sub_groups();
+}
@@ -0,0 +1,25 @@
+// RUN: clspv %s -cl-std=CL2.0 -spv-version=1.3 -inline-entry-points -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.2 %t.spv
+
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
+
+// CHECK: OpCapability GroupNonUniformVote
+// CHECK-DAG: %[[UINT_TYPE_ID:[a-zA-Z0-9_]*]] = OpTypeInt 32 0
+// CHECK-DAG: %[[BOOL_TYPE_ID:[a-zA-Z0-9_]*]] = OpTypeBool
+// CHECK-DAG: %[[UINT_0:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 0
+// CHECK-DAG: %[[UINT_1:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 1
+// CHECK-DAG: %[[UINT_3:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 3
+void kernel test(global int *a, global int *b, global int *c)
+{
+  uint i = get_global_id(0);
+  // CHECK: %[[PRED_ALL:[a-zA-Z0-9_]*]] = OpINotEqual %[[BOOL_TYPE_ID]] {{.*}} %[[UINT_0]]
+  // CHECK: %[[ALL:[a-zA-Z0-9_]*]] = OpGroupNonUniformAll %[[BOOL_TYPE_ID]] %[[UINT_3]] %[[PRED_ALL]]
+  // CHECK: OpSelect %[[UINT_TYPE_ID]] %[[ALL]] %[[UINT_1]] %[[UINT_0]]
+  b[i] = sub_group_all(a[i]);
+  // CHECK: %[[PRED_ANY:[a-zA-Z0-9_]*]] = OpINotEqual %[[BOOL_TYPE_ID]] {{.*}} %[[UINT_0]]
+  // CHECK: %[[ANY:[a-zA-Z0-9_]*]] = OpGroupNonUniformAny %[[BOOL_TYPE_ID]] %[[UINT_3]] %[[PRED_ANY]]
+  // CHECK: OpSelect %[[UINT_TYPE_ID]] %[[ANY]] %[[UINT_1]] %[[UINT_0]]
+  c[i] = sub_group_any(a[i]);
+}
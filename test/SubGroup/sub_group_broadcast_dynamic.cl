@@ -0,0 +1,20 @@
+// RUN: clspv %s -cl-std=CL2.0 -spv-version=1.3 -inline-entry-points -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.2 %t.spv
+
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
+
+// A lane that is not a constant is read with a shuffle before SPIR-V 1.5.
+// CHECK: OpCapability GroupNonUniformShuffle
+// CHECK-DAG: %[[FLOAT_TYPE_ID:[a-zA-Z0-9_]*]] = OpTypeFloat 32
+// CHECK-DAG: %[[UINT_TYPE_ID:[a-zA-Z0-9_]*]] = OpTypeInt 32 0
+// CHECK-DAG: %[[UINT_3:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 3
+// CHECK: %[[LANE:[a-zA-Z0-9_]*]] = OpLoad %[[UINT_TYPE_ID]]
+// CHECK: %[[VALUE:[a-zA-Z0-9_]*]] = OpLoad %[[FLOAT_TYPE_ID]]
+// CHECK: OpGroupNonUniformShuffle %[[FLOAT_TYPE_ID]] %[[UINT_3]] %[[VALUE]] %[[LANE]]
+void kernel test(global float *a, global float *b, uint lane)
+{
+  uint i = get_global_id(0);
+  b[i] = sub_group_broadcast(a[i], lane);
+}
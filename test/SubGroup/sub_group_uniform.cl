@@ -0,0 +1,23 @@
+// RUN: clspv %s -cl-std=CL2.0 -spv-version=1.3 -inline-entry-points -uniformity-decorations -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.2 %t.spv
+
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
+
+// The argument is the same for the whole subgroup, so the collectives fold.
+// CHECK-NOT: OpCapability GroupNonUniform
+// CHECK: OpDecorate [[n:%[a-zA-Z0-9_]+]] Uniform
+// CHECK: [[n]] = OpLoad
+// CHECK-NOT: OpGroupNonUniform
+// CHECK: OpINotEqual
+// CHECK-NOT: OpGroupNonUniform
+// CHECK: OpSelect
+// CHECK-NOT: OpGroupNonUniform
+// CHECK: OpFunctionEnd
+void kernel test(global int *a, int n)
+{
+  uint i = get_global_id(0);
+  a[i] = sub_group_broadcast(n, 0) + sub_group_reduce_max(n) +
+         sub_group_all(n);
+}
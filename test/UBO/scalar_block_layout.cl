@@ -0,0 +1,32 @@
+// RUN: clspv -constant-args-ubo -inline-entry-points -scalar-block-layout %s -o %t.spv
+// RUN: spirv-dis %t.spv -o %t.spvasm
+// RUN: FileCheck %s < %t.spvasm
+// RUN: clspv-reflection -d %t.spv -o %t.map
+// RUN: FileCheck -check-prefix=MAP %s < %t.map
+// RUN: spirv-val --target-env vulkan1.0 --scalar-block-layout %t.spv
+
+// With scalar block layout, an array in a uniform buffer is laid out with the
+// stride of its elements instead of being rejected for not being aligned to
+// 16 bytes.
+typedef struct {
+  float a;
+  float b[3];
+  int4 c;
+} S;
+
+kernel void foo(global float* out, constant S* in) {
+  out[0] = in->b[1] + in->c.y;
+}
+
+//      MAP: kernel,foo,arg,out,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,buffer
+// MAP-NEXT: kernel,foo,arg,in,argOrdinal,1,descriptorSet,0,binding,1,offset,0,argKind,buffer_ubo
+
+// CHECK-DAG: OpMemberDecorate [[s:%[0-9a-zA-Z_]+]] 0 Offset 0
+// CHECK-DAG: OpMemberDecorate [[s]] 1 Offset 4
+// CHECK-DAG: OpMemberDecorate [[s]] 2 Offset 16
+// CHECK-DAG: OpDecorate [[float_array:%[0-9a-zA-Z_]+]] ArrayStride 4
+// CHECK-DAG: OpDecorate [[ubo_array:%[0-9a-zA-Z_]+]] ArrayStride 32
+// CHECK-DAG: [[s]] = OpTypeStruct {{%[0-9a-zA-Z_]+}} [[float_array]] {{%[0-9a-zA-Z_]+}}
+// CHECK-DAG: [[ubo_block:%[0-9a-zA-Z_]+]] = OpTypeStruct [[ubo_array]]
+// CHECK-DAG: [[ubo_ptr:%[0-9a-zA-Z_]+]] = OpTypePointer Uniform [[ubo_block]]
+// CHECK-DAG: OpVariable [[ubo_ptr]] Uniform
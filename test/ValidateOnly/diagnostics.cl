@@ -0,0 +1,21 @@
+// RUN: not clspv -validate-only %s -o %t.txt 2> %t.log
+// RUN: FileCheck %s < %t.log
+// RUN: FileCheck %s --check-prefix=KERNELS < %t.txt
+
+// The diagnostics are those of a compilation, including the clspv frontend
+// checks, and refer to the input file.
+// CHECK: diagnostics.cl:[[# @LINE + 12]]:{{[0-9]+}}: error: use of undeclared identifier 'undeclared'
+// CHECK: diagnostics.cl:[[# @LINE + 13]]:{{[0-9]+}}: error: pointer-to-void is not supported
+
+// The kernels parsed before an error are still reported.
+// KERNELS: kernel,ok,reqd_work_group_size,2,2,2,
+// KERNELS: kernel,ok,arg,0,name,out,type,int*,
+
+kernel __attribute__((reqd_work_group_size(2, 2, 2))) void
+ok(global int *out) {
+  out[0] = 1;
+}
+
+kernel void bad_body(global int *out) { out[0] = undeclared; }
+
+kernel void bad_arg(global void *p) {}
@@ -0,0 +1,28 @@
+// RUN: clspv -validate-only %s -o %t.txt
+// RUN: FileCheck %s < %t.txt
+
+// CHECK: kernel,foo,reqd_work_group_size,8,4,1,work_group_size_hint,0,0,0,vec_type_hint,{{$}}
+// CHECK-NEXT: kernel,foo,arg,0,name,out,type,float4*,address_space,global,access_qualifier,none,type_qualifiers,{{$}}
+// CHECK-NEXT: kernel,foo,arg,1,name,tmp,type,int*,address_space,local,access_qualifier,none,type_qualifiers,{{$}}
+// CHECK-NEXT: kernel,foo,arg,2,name,n,type,uint,address_space,private,access_qualifier,none,type_qualifiers,{{$}}
+// CHECK-NEXT: kernel,foo,arg,3,name,img,type,image2d_t,address_space,private,access_qualifier,read_only,type_qualifiers,{{$}}
+// CHECK-NEXT: kernel,bar,reqd_work_group_size,0,0,0,work_group_size_hint,16,1,1,vec_type_hint,float4{{$}}
+// CHECK-NEXT: kernel,bar,arg,0,name,in,type,int*,address_space,global,access_qualifier,none,type_qualifiers,const restrict{{$}}
+// CHECK-NEXT: kernel,bar,arg,1,name,out,type,int*,address_space,global,access_qualifier,none,type_qualifiers,volatile{{$}}
+// CHECK-NEXT: kernel,baz,arg,0,name,dst,type,image2d_t,address_space,private,access_qualifier,write_only,type_qualifiers,{{$}}
+// CHECK-NOT: kernel,helper
+
+void helper(global float4 *out) { out[0] = 0.0f; }
+
+kernel __attribute__((reqd_work_group_size(8, 4, 1))) void
+foo(global float4 *out, local int *tmp, uint n, read_only image2d_t img) {
+  helper(out);
+}
+
+kernel __attribute__((work_group_size_hint(16, 1, 1)))
+__attribute__((vec_type_hint(float4))) void
+bar(global const int *restrict in, global volatile int *out) {
+  out[0] = in[0];
+}
+
+kernel void baz(write_only image2d_t dst) {}
@@ -0,0 +1,24 @@
+; RUN: clspv-opt -ReplaceOpenCLBuiltin -vector-buffer-args %s -o %t
+; RUN: FileCheck %s < %t
+
+; %in is only read by vload4 and becomes a float4 pointer. %other is also read
+; by a scalar load and keeps its type.
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+define spir_kernel void @foo(float addrspace(1)* %in, float addrspace(1)* %other, i32 %offset) {
+entry:
+  %0 = call spir_func <4 x float> @_Z6vload4jPU3AS1f(i32 %offset, float addrspace(1)* %in)
+  %1 = call spir_func <4 x float> @_Z6vload4jPU3AS1f(i32 %offset, float addrspace(1)* %other)
+  %2 = load float, float addrspace(1)* %other
+  ret void
+}
+
+declare <4 x float> @_Z6vload4jPU3AS1f(i32, float addrspace(1)*)
+
+; CHECK: define spir_kernel void @foo(<4 x float> addrspace(1)* %in, float addrspace(1)* %other, i32 %offset)
+; CHECK: [[gep:%[a-zA-Z0-9_.]+]] = getelementptr <4 x float>, <4 x float> addrspace(1)* %in, i32 %offset
+; CHECK: load <4 x float>, <4 x float> addrspace(1)* [[gep]]
+; CHECK: getelementptr float, float addrspace(1)* %other
+; CHECK: load float, float addrspace(1)*
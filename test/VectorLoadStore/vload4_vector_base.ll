@@ -0,0 +1,25 @@
+; RUN: clspv-opt -ReplaceOpenCLBuiltin %s -o %t
+; RUN: FileCheck %s < %t
+
+; vload4 and vstore4 through a cast of a float4 pointer access it directly.
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+define void @foo(<4 x float> addrspace(1)* %in, <4 x float> addrspace(1)* %out, i32 %offset) {
+entry:
+  %cast_in = bitcast <4 x float> addrspace(1)* %in to float addrspace(1)*
+  %cast_out = bitcast <4 x float> addrspace(1)* %out to float addrspace(1)*
+  %0 = call spir_func <4 x float> @_Z6vload4jPU3AS1f(i32 %offset, float addrspace(1)* %cast_in)
+  call spir_func void @_Z7vstore4Dv4_fjPU3AS1f(<4 x float> %0, i32 %offset, float addrspace(1)* %cast_out)
+  ret void
+}
+
+declare <4 x float> @_Z6vload4jPU3AS1f(i32, float addrspace(1)*)
+declare void @_Z7vstore4Dv4_fjPU3AS1f(<4 x float>, i32, float addrspace(1)*)
+
+; CHECK: [[gep_in:%[a-zA-Z0-9_.]+]] = getelementptr <4 x float>, <4 x float> addrspace(1)* %in, i32 %offset
+; CHECK: [[ld:%[a-zA-Z0-9_.]+]] = load <4 x float>, <4 x float> addrspace(1)* [[gep_in]]
+; CHECK: [[gep_out:%[a-zA-Z0-9_.]+]] = getelementptr <4 x float>, <4 x float> addrspace(1)* %out, i32 %offset
+; CHECK: store <4 x float> [[ld]], <4 x float> addrspace(1)* [[gep_out]]
+; CHECK-NOT: load float
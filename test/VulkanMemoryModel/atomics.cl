@@ -0,0 +1,29 @@
+// RUN: clspv --cl-std=CL2.0 --inline-entry-points -vulkan-memory-model %s -o %t.spv
+// RUN: spirv-dis %t.spv -o %t.spvasm
+// RUN: FileCheck %s < %t.spvasm
+// RUN: spirv-val --target-env vulkan1.1 %t.spv
+
+// CHECK-DAG: OpCapability VulkanMemoryModel
+// CHECK-DAG: OpCapability VulkanMemoryModelDeviceScope
+// CHECK: OpExtension "SPV_KHR_vulkan_memory_model"
+// CHECK: OpMemoryModel Logical Vulkan
+// CHECK-NOT: Coherent
+// CHECK: [[uint:%[a-zA-Z0-9_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[uint_0:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 0
+// CHECK-DAG: [[uint_1:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 1
+// Uniform | Acquire | MakeVisible
+// CHECK-DAG: [[acquire:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 16450
+// Uniform | Release | MakeAvailable
+// CHECK-DAG: [[release:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 8260
+// CHECK: OpAtomicIAdd [[uint]] {{%[a-zA-Z0-9_]+}} [[uint_1]] [[uint_0]] [[uint_1]]
+// CHECK: OpAtomicLoad [[uint]] {{%[a-zA-Z0-9_]+}} [[uint_1]] [[acquire]]
+// CHECK: OpStore {{%[a-zA-Z0-9_]+}} {{%[a-zA-Z0-9_]+}} NonPrivatePointer
+// CHECK: OpAtomicStore {{%[a-zA-Z0-9_]+}} [[uint_1]] [[release]] [[uint_0]]
+
+kernel void foo(global int *out, global atomic_int *count,
+                global atomic_int *flag) {
+  atomic_fetch_add_explicit(count, 1, memory_order_relaxed);
+  int v = atomic_load_explicit(flag, memory_order_acquire);
+  out[get_global_id(0)] = v;
+  atomic_store_explicit(flag, 0, memory_order_release);
+}
@@ -0,0 +1,22 @@
+// RUN: clspv -vulkan-memory-model %s -o %t.spv
+// RUN: spirv-dis %t.spv -o %t.spvasm
+// RUN: FileCheck %s < %t.spvasm
+// RUN: spirv-val --target-env vulkan1.1 %t.spv
+
+// Workgroup memory is made available and visible by the barrier, and the
+// accesses to it take part in that with NonPrivatePointer.
+
+// CHECK: OpMemoryModel Logical Vulkan
+// CHECK: [[uint:%[a-zA-Z0-9_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[uint_2:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 2
+// Workgroup | AcquireRelease | MakeAvailable | MakeVisible
+// CHECK-DAG: [[semantics:%[a-zA-Z0-9_]+]] = OpConstant [[uint]] 24840
+// CHECK: OpStore {{%[a-zA-Z0-9_]+}} {{%[a-zA-Z0-9_]+}} NonPrivatePointer
+// CHECK: OpControlBarrier [[uint_2]] [[uint_2]] [[semantics]]
+// CHECK: OpLoad [[uint]] {{%[a-zA-Z0-9_]+}} NonPrivatePointer
+
+kernel void foo(global int *out, local int *tile) {
+  tile[get_local_id(0)] = out[get_global_id(0)];
+  barrier(CLK_LOCAL_MEM_FENCE);
+  out[get_global_id(0)] = tile[get_local_size(0) - 1 - get_local_id(0)];
+}
@@ -0,0 +1,38 @@
+// RUN: clspv -cl-std=CL2.0 -inline-entry-points %s -o %t.spv -local-size=16,1,1
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The enqueued local size is a constant, so no push constant is needed.
+// CHECK-NOT: PushConstant
+// CHECK: OpExecutionMode {{%[0-9a-zA-Z_]+}} LocalSize 16 1 1
+// CHECK-DAG: [[uint:%[0-9a-zA-Z_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[uint_16:%[0-9a-zA-Z_]+]] = OpConstant [[uint]] 16
+// CHECK: OpStore {{%[0-9a-zA-Z_]+}} [[uint_16]]
+
+// With a uniform NDRange, get_local_size folds to the same constant.
+// RUN: clspv -cl-std=CL1.2 %s -o %t3.spv -local-size=16,1,1
+// RUN: spirv-dis -o %t4.spvasm %t3.spv
+// RUN: FileCheck %s --check-prefix=UNIFORM < %t4.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t3.spv
+
+// UNIFORM-NOT: BuiltIn WorkgroupSize
+// UNIFORM: OpExecutionMode {{%[0-9a-zA-Z_]+}} LocalSize 16 1 1
+// UNIFORM-DAG: [[uint:%[0-9a-zA-Z_]+]] = OpTypeInt 32 0
+// UNIFORM-DAG: [[uint_16:%[0-9a-zA-Z_]+]] = OpConstant [[uint]] 16
+// UNIFORM: OpStore {{%[0-9a-zA-Z_]+}} [[uint_16]]
+
+// A reqd_work_group_size attribute must match -local-size.
+// RUN: not clspv -cl-std=CL2.0 -DCONFLICT %s -o %t5.spv -local-size=16,1,1 2>&1 | FileCheck %s --check-prefix=CONFLICT
+// CONFLICT: error: reqd_work_group_size conflicts with -local-size=16,1,1
+
+#ifdef CONFLICT
+__attribute__((reqd_work_group_size(8, 1, 1)))
+#endif
+void kernel test(global int *out) {
+#if __OPENCL_C_VERSION__ >= 200
+  out[0] = get_enqueued_local_size(0);
+#else
+  out[0] = get_local_size(0);
+#endif
+}
@@ -0,0 +1,25 @@
+// RUN: clspv -global-offset-push-constant -uniform-ndrange-variants %s -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: clspv-reflection %t.spv -o %t.dmap
+// RUN: FileCheck --check-prefix=DMAP %s < %t.dmap
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// DMAP-DAG: kernel,test,arg,out,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,buffer
+// DMAP-DAG: kernel,test.uniform,arg,out,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,buffer
+// DMAP-DAG: pushconstant,name,global_offset,offset,0,size,12
+
+// CHECK-DAG: OpEntryPoint GLCompute %[[test:[0-9a-zA-Z_]+]] "test"
+// CHECK-DAG: OpEntryPoint GLCompute %[[uniform:[0-9a-zA-Z_]+]] "test.uniform"
+// CHECK:     %[[test]] = OpFunction
+// CHECK:     OpIAdd
+// CHECK:     OpFunctionEnd
+// CHECK:     %[[uniform]] = OpFunction
+// CHECK-NOT: OpIAdd
+// CHECK:     OpFunctionEnd
+
+int index(void) { return get_global_id(0); }
+
+void kernel __attribute__((reqd_work_group_size(1,1,1))) test(global int *out) {
+    out[index()] = get_global_offset(0);
+}
@@ -0,0 +1,20 @@
+// RUN: clspv -cl-std=CL2.0 -inline-entry-points -uniform-ndrange-variants %s -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// CHECK-DAG: OpEntryPoint GLCompute %[[test:[0-9a-zA-Z_]+]] "test"
+// CHECK-DAG: OpEntryPoint GLCompute %[[uniform:[0-9a-zA-Z_]+]] "test.uniform"
+// CHECK-DAG: OpDecorate %[[num_groups:[0-9a-zA-Z_]+]] BuiltIn NumWorkgroups
+// CHECK:     %[[test]] = OpFunction
+// CHECK:     OpIAdd
+// CHECK:     OpFunctionEnd
+// CHECK:     %[[uniform]] = OpFunction
+// CHECK-NOT: OpIAdd
+// CHECK:     OpAccessChain %{{[0-9a-zA-Z_]+}} %[[num_groups]]
+// CHECK-NOT: OpIAdd
+// CHECK:     OpFunctionEnd
+
+void kernel __attribute__((reqd_work_group_size(1,1,1))) test(global int *out) {
+    out[get_group_id(0)] = get_num_groups(0);
+}
@@ -0,0 +1,21 @@
+// RUN: clspv %s -o %t.spv -local-size=8,4,1
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: clspv-reflection %t.spv -o %t.dmap
+// RUN: FileCheck --check-prefix=DMAP %s < %t.dmap
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The local size is the LocalSize execution mode rather than specialization
+// constants, and get_local_size folds to constants.
+// DMAP-NOT: spec_constant,workgroup_size
+// DMAP: kernel_decl,test
+// CHECK-NOT: BuiltIn WorkgroupSize
+// CHECK-NOT: OpSpecConstant
+// CHECK: OpExecutionMode {{%[0-9a-zA-Z_]+}} LocalSize 8 4 1
+// CHECK-DAG: [[uint:%[0-9a-zA-Z_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[uint_32:%[0-9a-zA-Z_]+]] = OpConstant [[uint]] 32
+// CHECK: OpStore {{%[0-9a-zA-Z_]+}} [[uint_32]]
+
+void kernel test(global uint *out) {
+  out[0] = get_local_size(0) * get_local_size(1) * get_local_size(2);
+}
@@ -0,0 +1,97 @@
+; RUN: clspv-opt %s -o %t.ll -ZeroInitializeAllocasPass
+; RUN: FileCheck %s < %t.ll
+
+target datalayout = "e-p:32:32-i64:64-v16:16-v24:32-v32:32-v48:64-v96:128-v192:256-v256:256-v512:512-v1024:1024"
+target triple = "spir-unknown-unknown"
+
+%struct.S = type { i32, [4 x float], i32 }
+
+; Stored before it is loaded: not zeroed.
+; CHECK-LABEL: @stored
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %x = alloca i32
+; CHECK-NEXT: store i32 %n, i32* %x
+define i32 @stored(i32 %n) {
+entry:
+  %x = alloca i32, align 4
+  store i32 %n, i32* %x, align 4
+  br label %next
+
+next:
+  %ld = load i32, i32* %x, align 4
+  ret i32 %ld
+}
+
+; Fully covered by a memset: not zeroed.
+; CHECK-LABEL: @memset
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %a = alloca [4 x float]
+; CHECK-NEXT: %cast = bitcast
+; CHECK-NEXT: call void @llvm.memset
+define float @memset(i32 %i) {
+entry:
+  %a = alloca [4 x float], align 4
+  %cast = bitcast [4 x float]* %a to i8*
+  call void @llvm.memset.p0i8.i32(i8* align 4 %cast, i8 1, i32 16, i1 false)
+  %gep = getelementptr [4 x float], [4 x float]* %a, i32 0, i32 %i
+  %ld = load float, float* %gep, align 4
+  ret float %ld
+}
+
+; Only the fields not stored before the load are zeroed.
+; CHECK-LABEL: @partial
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %s = alloca %struct.S
+; CHECK-NEXT: [[gep:%[0-9a-zA-Z_.]+]] = getelementptr inbounds %struct.S, %struct.S* %s, i32 0, i32 1
+; CHECK-NEXT: store [4 x float] zeroinitializer, [4 x float]* [[gep]], align 4
+; CHECK-NEXT: %first = getelementptr
+; CHECK-NOT: store {{.*}}zeroinitializer
+define i32 @partial(i32 %n, i32 %i) {
+entry:
+  %s = alloca %struct.S, align 4
+  %first = getelementptr %struct.S, %struct.S* %s, i32 0, i32 0
+  store i32 %n, i32* %first, align 4
+  %last = getelementptr %struct.S, %struct.S* %s, i32 0, i32 2
+  store i32 %n, i32* %last, align 4
+  %cast = bitcast %struct.S* %s to i32*
+  %gep = getelementptr i32, i32* %cast, i32 %i
+  %ld = load i32, i32* %gep, align 4
+  ret i32 %ld
+}
+
+; Loaded before it is stored in a loop: zeroed.
+; CHECK-LABEL: @loop
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %a = alloca [8 x i32]
+; CHECK-NEXT: store [8 x i32] zeroinitializer, [8 x i32]* %a
+define i32 @loop(i32 %n) {
+entry:
+  %a = alloca [8 x i32], align 4
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %inc, %loop ]
+  %gep = getelementptr [8 x i32], [8 x i32]* %a, i32 0, i32 %i
+  store i32 %i, i32* %gep, align 4
+  %inc = add i32 %i, 1
+  %cmp = icmp ult i32 %inc, 8
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  %ld_gep = getelementptr [8 x i32], [8 x i32]* %a, i32 0, i32 %n
+  %ld = load i32, i32* %ld_gep, align 4
+  ret i32 %ld
+}
+
+; Never read: not zeroed.
+; CHECK-LABEL: @unread
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %x = alloca i32
+; CHECK-NEXT: ret void
+define void @unread() {
+entry:
+  %x = alloca i32, align 4
+  ret void
+}
+
+declare void @llvm.memset.p0i8.i32(i8*, i8, i32, i1)
@@ -0,0 +1,10 @@
+// RUN: clspv %s --emit-ir=%t.bc
+// RUN: clspv -x ir %t.bc -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// CHECK: OpEntryPoint GLCompute {{%[a-zA-Z0-9_]+}} "foo"
+// CHECK: OpIMul
+
+void kernel foo(global int *out, int in) { *out = in * 3; }
@@ -0,0 +1,19 @@
+// RUN: clspv %s -o %t.spv -canonical-ids
+// RUN: spirv-dis --raw-id -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// IDs are numbered in the order they first appear, starting with the first
+// import.
+
+// CHECK: ; Bound:
+// CHECK: OpCapability Shader
+// CHECK-NOT: = Op
+// CHECK: %1 = OpExtInstImport
+// CHECK: OpEntryPoint GLCompute %{{[0-9]+}} "foo"
+
+kernel void foo(global int *A, int n) {
+  for (int i = 0; i < n; ++i) {
+    A[i] = i * n;
+  }
+}
@@ -0,0 +1,23 @@
+// RUN: rm -rf %t.cache
+// RUN: clspv %s -o %t.spv -cache-dir=%t.cache
+// RUN: clspv %s -o %t2.spv -cache-dir=%t.cache
+// RUN: diff %t.spv %t2.spv
+// RUN: spirv-dis -o %t2.spvasm %t2.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t2.spv
+
+// Different options must not hit the same entry.
+// RUN: clspv %s -o %t3.spv -cache-dir=%t.cache -pod-ubo
+// RUN: spirv-dis -o %t3.spvasm %t3.spv
+// RUN: FileCheck %s --check-prefix=UBO < %t3.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t3.spv
+
+// CHECK: OpEntryPoint GLCompute %[[FOO_ID:[a-zA-Z0-9_]*]] "foo"
+// CHECK: OpDecorate {{.*}} DescriptorSet 0
+// CHECK-NOT: OpTypePointer Uniform
+
+// UBO: OpTypePointer Uniform
+
+kernel void foo(global float *out, float in) {
+  *out = in;
+}
@@ -0,0 +1,31 @@
+// RUN: rm -rf %t.cache
+// RUN: clspv %s -o %t.spv -cache-dir=%t.cache -cache-ir
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// Changing a function no kernel calls leaves the reachable IR unchanged, so
+// the pipeline does not run at all: the pass statistics only record the hit.
+// RUN: sed -e 's/return 1;/return 2;/' %s > %t.unused.cl
+// RUN: rm -f %t.json
+// RUN: clspv %t.unused.cl -o %t2.spv -cache-dir=%t.cache -cache-ir -pass-stats=%t.json
+// RUN: FileCheck --check-prefix=HIT %s < %t.json
+// RUN: diff %t.spv %t2.spv
+
+// HIT: "passes": []
+// HIT: "cache_hit": true
+
+// Changing a called function must miss.
+// RUN: sed -e 's/x \* 2.0f/x * 3.0f/' %s > %t.used.cl
+// RUN: clspv %t.used.cl -o %t3.spv -cache-dir=%t.cache -cache-ir -pass-stats=%t.json
+// RUN: FileCheck --check-prefix=MISS %s < %t.json
+// RUN: spirv-dis -o %t3.spvasm %t3.spv
+// RUN: FileCheck %s < %t3.spvasm
+
+// CHECK: OpConstant %{{[a-zA-Z0-9_]+}} 3
+
+// MISS: "cache_hit": false
+
+int unused_helper() { return 1; }
+
+float scale(float x) { return x * 2.0f; }
+
+kernel void foo(global float *out, float in) { *out = scale(in); }
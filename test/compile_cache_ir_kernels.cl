@@ -0,0 +1,27 @@
+// RUN: rm -rf %t.cache
+// RUN: clspv %s -o %t.spv -cache-dir=%t.cache -cache-ir
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The source key, the IR key and one entry per kernel for its optimizations.
+// RUN: ls %t.cache | wc -l | FileCheck --check-prefix=FIRST %s
+// FIRST: 4
+
+// Changing the helper of one kernel only adds the entry of that kernel to the
+// new source and IR keys: the other kernel is not optimized again.
+// RUN: sed -e 's/x \* 2.0f/x * 3.0f/' %s > %t.edit.cl
+// RUN: clspv %t.edit.cl -o %t2.spv -cache-dir=%t.cache -cache-ir
+// RUN: spirv-val --target-env vulkan1.0 %t2.spv
+// RUN: ls %t.cache | wc -l | FileCheck --check-prefix=EDIT %s
+// EDIT: 7
+// RUN: spirv-dis -o %t2.spvasm %t2.spv
+// RUN: FileCheck %s < %t2.spvasm
+
+// CHECK: OpConstant %{{[a-zA-Z0-9_]+}} 3
+
+float scale(float x) { return x * 2.0f; }
+
+float shift(float x) { return x + 5.0f; }
+
+kernel void foo(global float *out, float in) { *out = scale(in); }
+
+kernel void bar(global float *out, float in) { *out = shift(in); }
@@ -0,0 +1,40 @@
+// RUN: clspv %s -o %t.spv
+// RUN: clspv %s -o %t.cspv -mfmt=cspv
+// RUN: clspv %s -o %t2.cspv -mfmt=cspv -cspv-entropy=false
+// RUN: od -A n -t x4 -N 12 %t.cspv | FileCheck %s --check-prefix=ENTROPY
+// RUN: od -A n -t x4 -N 12 %t2.cspv | FileCheck %s --check-prefix=VARINT
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// ENTROPY: 56505343 00000001
+// VARINT: 56505343 00000001 00000000
+
+// Both encodings expand back to the same, valid module.
+// RUN: clspv-reflection --decompress %t.cspv -o %t.entropy.spv
+// RUN: clspv-reflection --decompress %t2.cspv -o %t.varint.spv
+// RUN: spirv-val --target-env vulkan1.0 %t.entropy.spv
+// RUN: spirv-val --target-env vulkan1.0 %t.varint.spv
+// RUN: cmp %t.spv %t.entropy.spv
+// RUN: cmp %t.spv %t.varint.spv
+
+// The reflection can be read from the compressed modules directly.
+// RUN: clspv-reflection %t.spv -o %t.map
+// RUN: clspv-reflection %t.cspv -o %t.entropy.map
+// RUN: clspv-reflection %t2.cspv -o %t.varint.map
+// RUN: diff %t.map %t.entropy.map
+// RUN: diff %t.map %t.varint.map
+
+// The cache stores compressed entries and expands them back to the same
+// binary.
+// RUN: rm -rf %t.cache
+// RUN: clspv %s -o %t3.spv -cache-dir=%t.cache
+// RUN: clspv %s -o %t4.spv -cache-dir=%t.cache
+// RUN: diff %t.spv %t4.spv
+// RUN: od -A n -t x4 -N 4 %t.cache/*.spvcache | FileCheck %s --check-prefix=CACHE
+
+// CACHE: 56505343
+
+kernel void foo(global float *out, global float *in, int n) {
+  for (int i = 0; i < n; ++i) {
+    out[i] = in[i] * 2.0f;
+  }
+}
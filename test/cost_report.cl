@@ -0,0 +1,43 @@
+// RUN: clspv %s -o %t.spv -cost-report=%t.json
+// RUN: FileCheck %s < %t.json
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// CHECK: "kernels": [
+// CHECK: "name": "foo",
+// CHECK-NEXT: "instructions": {{[0-9]+}},
+// CHECK-NEXT: "classes": {
+// CHECK-DAG: "arithmetic": {{[1-9][0-9]*}}
+// CHECK-DAG: "barrier": 1
+// CHECK-DAG: "memory": {{[1-9][0-9]*}}
+// CHECK: "barriers": 1,
+// CHECK-NEXT: "access_chains": {{[1-9][0-9]*}},
+// CHECK-NEXT: "max_access_chain_depth": {{[1-9][0-9]*}},
+// CHECK-NEXT: "loads": {
+// CHECK-DAG: "StorageBuffer": {{[1-9][0-9]*}}
+// CHECK-DAG: "Workgroup": {{[1-9][0-9]*}}
+// CHECK: "stores": {
+// CHECK-DAG: "StorageBuffer": 1
+// CHECK-DAG: "Workgroup": 1
+// CHECK: "variable_pointers": 0,
+// CHECK-NEXT: "loops": 1,
+// CHECK-NEXT: "max_loop_live_values": {{[1-9][0-9]*}},
+// CHECK-NEXT: "uniform_values": 0,
+// CHECK-NEXT: "non_uniform_pointers": 0,
+// CHECK-NEXT: "coherent_resources": 0
+// CHECK: "name": "bar",
+// CHECK: "barriers": 0,
+// CHECK: "loops": 0,
+
+kernel void foo(global float *out, global float *in, local float *tmp,
+                int n) {
+  size_t i = get_local_id(0);
+  tmp[i] = in[i];
+  barrier(CLK_LOCAL_MEM_FENCE);
+  float sum = 0.0f;
+  for (int j = 0; j < n; ++j) {
+    sum += tmp[j] * in[j];
+  }
+  out[i] = sum;
+}
+
+kernel void bar(global int *out) { out[get_global_id(0)] = 1; }
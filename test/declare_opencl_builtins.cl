@@ -0,0 +1,18 @@
+// RUN: clspv %s -o %t.spv -fdeclare-opencl-builtins
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// Builtins from Clang's table and from the clspv header both resolve.
+
+// CHECK-DAG: [[glsl:%[0-9a-zA-Z_]+]] = OpExtInstImport "GLSL.std.450"
+// CHECK: OpExtInst {{.*}} [[glsl]] Sqrt
+// CHECK: OpExtInst {{.*}} [[glsl]] UnpackHalf2x16
+// CHECK: OpControlBarrier
+
+kernel void foo(global float *A, global float2 *B, global uint *C) {
+  size_t i = get_global_id(0);
+  A[i] = sqrt(A[i]);
+  B[i] = __clspv_vloada_half2(i, C);
+  work_group_barrier(CLK_GLOBAL_MEM_FENCE);
+}
@@ -0,0 +1,30 @@
+// RUN: clspv %s -o %t.spv -no-inline-single -lean-memory
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: clspv-reflection %t.spv -o %t.dmap
+// RUN: FileCheck --check-prefix=DMAP %s < %t.dmap
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// CHECK: %[[SUM_ID:[a-zA-Z0-9_]*]] = OpFunction
+// CHECK: OpLoopMerge
+// CHECK: OpFunctionEnd
+// CHECK: OpFunction
+// CHECK: OpFunctionCall {{.*}} %[[SUM_ID]]
+// CHECK: OpFunctionEnd
+
+// Value names are discarded, but kernel argument names are kept.
+// DMAP: kernel,foo,arg,out,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,buffer
+// DMAP: kernel,foo,arg,in,argOrdinal,1,descriptorSet,0,binding,1,offset,0,argKind,buffer
+// DMAP: kernel,foo,arg,n,argOrdinal,2,{{.*}}argKind,pod
+
+int sum(global int *in, int n) {
+  int total = 0;
+  for (int i = 0; i < n; ++i) {
+    total += in[i];
+  }
+  return total;
+}
+
+kernel void foo(global int *out, global int *in, int n) {
+  out[0] = sum(in, n);
+}
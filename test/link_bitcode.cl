@@ -0,0 +1,16 @@
+// RUN: rm -rf %t && mkdir -p %t
+// RUN: echo "int triple(int x) { return x * 3; }" > %t/lib.cl
+// RUN: echo "int unused(int x) { return x / 5; }" >> %t/lib.cl
+// RUN: clspv %t/lib.cl --emit-ir=%t/lib.bc
+// RUN: clspv %s -link-bitcode=%t/lib.bc -o %t/out.spv
+// RUN: spirv-dis -o %t/out.spvasm %t/out.spv
+// RUN: FileCheck %s < %t/out.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t/out.spv
+
+// CHECK: OpEntryPoint GLCompute {{%[a-zA-Z0-9_]+}} "foo"
+// CHECK: OpIMul
+// CHECK-NOT: OpSDiv
+
+int triple(int x);
+
+void kernel foo(global int *out, int in) { *out = triple(in); }
@@ -0,0 +1,37 @@
+// RUN: clspv %s -o %t.spv -local-arg-size=foo:0:256,foo:2:20
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: clspv-reflection %t.spv -o %t2.map
+// RUN: FileCheck %s < %t2.map -check-prefix=MAP
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+typedef struct S {
+  int a; int b;
+} S;
+
+kernel void foo(local float *L, global float* A, S local* LS, local int *I) {
+  *A = *L + LS->a + *I;
+}
+
+// Only I is sized by a spec constant.
+//      MAP: kernel,foo,arg,A,argOrdinal,1,descriptorSet,0,binding,0,offset,0,argKind,buffer
+// MAP-NEXT: kernel,foo,arg,I,argOrdinal,3,argKind,local,arrayElemSize,4,arrayNumElemSpecId,3
+// MAP-NOT: kernel
+
+// CHECK:     OpDecorate [[spec:%[0-9a-zA-Z_]+]] SpecId 3
+// CHECK-NOT: SpecId
+// CHECK-DAG: [[float:%[0-9a-zA-Z_]+]] = OpTypeFloat 32
+// CHECK-DAG: [[uint:%[0-9a-zA-Z_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[struct:%[0-9a-zA-Z_]+]] = OpTypeStruct [[uint]] [[uint]]
+// CHECK-DAG: [[uint_64:%[0-9a-zA-Z_]+]] = OpConstant [[uint]] 64
+// CHECK-DAG: [[uint_3:%[0-9a-zA-Z_]+]] = OpConstant [[uint]] 3
+// CHECK-DAG: [[float_arr:%[0-9a-zA-Z_]+]] = OpTypeArray [[float]] [[uint_64]]
+// CHECK-DAG: [[struct_arr:%[0-9a-zA-Z_]+]] = OpTypeArray [[struct]] [[uint_3]]
+// CHECK-DAG: [[spec]] = OpSpecConstant [[uint]] 1
+// CHECK-DAG: [[uint_arr:%[0-9a-zA-Z_]+]] = OpTypeArray [[uint]] [[spec]]
+// CHECK-DAG: [[float_ptr:%[0-9a-zA-Z_]+]] = OpTypePointer Workgroup [[float_arr]]
+// CHECK-DAG: [[struct_ptr:%[0-9a-zA-Z_]+]] = OpTypePointer Workgroup [[struct_arr]]
+// CHECK-DAG: [[uint_ptr:%[0-9a-zA-Z_]+]] = OpTypePointer Workgroup [[uint_arr]]
+// CHECK-DAG: OpVariable [[float_ptr]] Workgroup
+// CHECK-DAG: OpVariable [[struct_ptr]] Workgroup
+// CHECK-DAG: OpVariable [[uint_ptr]] Workgroup
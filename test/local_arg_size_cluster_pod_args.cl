@@ -0,0 +1,23 @@
+// RUN: clspv %s -o %t.spv -cluster-pod-kernel-args -pod-ubo -local-arg-size=foo:2:32
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: clspv-reflection %t.spv -o %t2.map
+// RUN: FileCheck %s < %t2.map -check-prefix=MAP
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The ordinal is the one of the source, before POD arguments are clustered.
+kernel void foo(float f, global float* A, local float *L) {
+  *A = *L + f;
+}
+
+//      MAP: kernel,foo,arg,f,argOrdinal,0,descriptorSet,0,binding,1,offset,0,argKind,pod_ubo,argSize,4
+// MAP-NEXT: kernel,foo,arg,A,argOrdinal,1,descriptorSet,0,binding,0,offset,0,argKind,buffer
+// MAP-NOT: kernel
+
+// CHECK-NOT: SpecId
+// CHECK-DAG: [[float:%[0-9a-zA-Z_]+]] = OpTypeFloat 32
+// CHECK-DAG: [[uint:%[0-9a-zA-Z_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[uint_8:%[0-9a-zA-Z_]+]] = OpConstant [[uint]] 8
+// CHECK-DAG: [[float_arr:%[0-9a-zA-Z_]+]] = OpTypeArray [[float]] [[uint_8]]
+// CHECK-DAG: [[float_ptr:%[0-9a-zA-Z_]+]] = OpTypePointer Workgroup [[float_arr]]
+// CHECK-DAG: OpVariable [[float_ptr]] Workgroup
@@ -0,0 +1,22 @@
+// RUN: rm -rf %t && mkdir -p %t
+// RUN: cp %s %t/a.cl
+// RUN: cp %s %t/b.cl
+// RUN: clspv -j 2 %t/a.cl %t/b.cl
+// RUN: spirv-dis -o %t/a.spvasm %t/a.spv
+// RUN: FileCheck %s < %t/a.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t/a.spv
+// RUN: diff %t/a.spv %t/b.spv
+
+// RUN: echo "# input output" > %t/manifest
+// RUN: echo "%t/a.cl %t/c.spv" >> %t/manifest
+// RUN: echo "%t/b.cl %t/d.spv" >> %t/manifest
+// RUN: clspv -manifest=%t/manifest -j 0
+// RUN: diff %t/a.spv %t/c.spv
+// RUN: diff %t/a.spv %t/d.spv
+
+// RUN: not clspv %t/a.cl %t/b.cl -o %t/e.spv 2>&1 | FileCheck %s --check-prefix=ERROR
+
+// CHECK: OpEntryPoint GLCompute {{%[a-zA-Z0-9_]+}} "foo"
+// ERROR: -o cannot be used when compiling several inputs
+
+kernel void foo(global int *out, int a) { *out = a; }
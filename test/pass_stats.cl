@@ -0,0 +1,19 @@
+// RUN: clspv %s -o %t.spv -pass-stats=%t.json
+// RUN: FileCheck %s < %t.json
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// CHECK: "passes": [
+// CHECK: "name": "Replace OpenCL Builtins Pass",
+// CHECK-NEXT: "wall_seconds": {{[0-9.e+-]+}},
+// CHECK-NEXT: "instructions_before": {{[0-9]+}},
+// CHECK-NEXT: "instructions_after": {{[0-9]+}},
+// CHECK-NEXT: "malloc_bytes_before": {{[0-9]+}},
+// CHECK-NEXT: "malloc_bytes_after": {{[0-9]+}},
+// CHECK-NEXT: "blocks_before": {{[0-9]+}},
+// CHECK-NEXT: "blocks_after": {{[0-9]+}}
+// CHECK: "total_wall_seconds": {{[0-9.e+-]+}},
+// CHECK-NEXT: "peak_malloc_bytes": {{[0-9]+}}
+
+kernel void foo(global float *out, global float *in) {
+  out[0] = fabs(in[0]) + mad(in[1], in[2], in[3]);
+}
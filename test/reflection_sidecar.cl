@@ -0,0 +1,9 @@
+// RUN: clspv %s -o %t.spv -reflection-sidecar=%t.refl
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+// RUN: od -An -tx4 -w28 -N28 %t.refl | FileCheck %s
+
+// Magic, version, size, then the kernel table (one entry right after the
+// header) and the argument table (two entries after the kernel table).
+// CHECK: 46524c43 00000003 {{[0-9a-f]+}} 00000044 00000001 0000005c 00000002
+
+kernel void foo(global float *out, float in) { out[0] = in; }
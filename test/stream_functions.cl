@@ -0,0 +1,25 @@
+// RUN: clspv %s -o %t.spv -no-inline-single -stream-functions
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// CHECK: %[[SUM_ID:[a-zA-Z0-9_]*]] = OpFunction
+// CHECK: OpLoopMerge
+// CHECK: OpBranchConditional
+// CHECK: OpPhi
+// CHECK: OpFunctionEnd
+// CHECK: OpFunction
+// CHECK: OpFunctionCall {{.*}} %[[SUM_ID]]
+// CHECK: OpFunctionEnd
+
+int sum(global int *in, int n) {
+  int total = 0;
+  for (int i = 0; i < n; ++i) {
+    total += in[i];
+  }
+  return total;
+}
+
+kernel void foo(global int *out, global int *in, int n) {
+  out[0] = sum(in, n);
+}
@@ -0,0 +1,33 @@
+// RUN: clspv %s -o %t.spv -target-profile=compatible -no-inline-single
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// Options given explicitly override the profile.
+// RUN: clspv %s -o %t3.spv -target-profile=compatible -hack-inserts=false -no-inline-single
+// RUN: spirv-dis -o %t4.spvasm %t3.spv
+// RUN: FileCheck --check-prefix=INSERT %s < %t4.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t3.spv
+
+// RUN: not clspv %s -o %t5.spv -target-profile=unknown 2> %t5.txt
+// RUN: FileCheck --check-prefix=UNKNOWN %s < %t5.txt
+
+typedef struct { float a, b, c, d; } S;
+
+S boo(S in) {
+  in.c = 2.0f;
+  in.b = 1.0f;
+  return in;
+}
+
+kernel void foo(global S* data, float f) {
+  data[0] = boo(data[1]);
+}
+
+// -hack-inserts replaces the insertions by a construction.
+// CHECK-NOT: OpCompositeInsert
+// CHECK: OpCompositeConstruct
+
+// INSERT: OpCompositeInsert
+
+// UNKNOWN: unknown target profile 'unknown'
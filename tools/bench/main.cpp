@@ -0,0 +1,510 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures compiler throughput over a corpus of OpenCL C kernels.
+//
+// Every kernel is compiled once untimed to warm up and to drop kernels that
+// do not compile with the given options.  The remaining kernels are then
+// compiled repeatedly through clspv::CompileFromSourceString, first on a
+// single thread and then concurrently, and the results are printed as JSON.
+//
+// With --scaling the corpus is replaced by generated kernels calling chains of
+// helper functions of the given lengths, to check that the compile time grows
+// linearly with the number of functions in the module.
+//
+// With --blocks the kernels are compiled once with the CFG structurizer run
+// on every function and once with -structurize-unstructured-only, and the
+// number of basic blocks reaching the SPIR-V producer is compared.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "clspv/Compiler.h"
+
+namespace {
+
+const char *const kUsage =
+    "usage: clspv_bench [--iterations=N] [--threads=N] [--options=<clspv "
+    "options>]\n"
+    "                   [--phases] <file or directory>...\n"
+    "       clspv_bench [--iterations=N] [--options=<clspv options>]\n"
+    "                   --scaling=<num functions>,...\n"
+    "       clspv_bench [--options=<clspv options>] --blocks <file or "
+    "directory>...\n"
+    "\n"
+    "Compiles every .cl file given, or found under the given directories, N\n"
+    "times on one thread and then on --threads threads, and prints latency\n"
+    "percentiles, kernels per second and peak RSS as JSON.  --phases also\n"
+    "reports the frontend, clspv passes and SPIR-V producer times.\n"
+    "\n"
+    "--scaling compiles instead a generated kernel calling each number of\n"
+    "helper functions N times on one thread, and prints the median time per\n"
+    "function for each.\n"
+    "\n"
+    "--blocks compiles each kernel once with and once without\n"
+    "-structurize-unstructured-only, and prints the number of basic blocks\n"
+    "reaching the SPIR-V producer for each.\n";
+
+struct Kernel {
+  std::string path;
+  std::string source;
+};
+
+// Timings of one compilation, in seconds.
+struct Sample {
+  double total = 0;
+  double frontend = 0;
+  double passes = 0;
+  double producer = 0;
+};
+
+struct BenchOptions {
+  unsigned iterations = 5;
+  unsigned threads = 0;
+  std::string options;
+  bool phases = false;
+  bool blocks = false;
+  std::vector<unsigned> scaling;
+  std::vector<std::string> inputs;
+};
+
+bool ParseArguments(int argc, const char *const argv[], BenchOptions *opts) {
+  for (int i = 1; i < argc; ++i) {
+    llvm::StringRef arg(argv[i]);
+    if (arg.consume_front("--iterations=")) {
+      if (arg.getAsInteger(10, opts->iterations) || opts->iterations == 0)
+        return false;
+    } else if (arg.consume_front("--threads=")) {
+      if (arg.getAsInteger(10, opts->threads))
+        return false;
+    } else if (arg.consume_front("--options=")) {
+      opts->options = arg.str();
+    } else if (arg == "--phases") {
+      opts->phases = true;
+    } else if (arg == "--blocks") {
+      opts->blocks = true;
+    } else if (arg.consume_front("--scaling=")) {
+      llvm::SmallVector<llvm::StringRef, 8> sizes;
+      arg.split(sizes, ',');
+      for (auto size : sizes) {
+        unsigned num_functions = 0;
+        if (size.getAsInteger(10, num_functions) || num_functions == 0)
+          return false;
+        opts->scaling.push_back(num_functions);
+      }
+    } else if (arg.startswith("-")) {
+      return false;
+    } else {
+      opts->inputs.push_back(arg.str());
+    }
+  }
+  if (opts->threads == 0) {
+    opts->threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (opts->blocks && !opts->scaling.empty())
+    return false;
+  return opts->scaling.empty() != opts->inputs.empty();
+}
+
+bool AddKernel(const std::string &path, std::vector<Kernel> *kernels) {
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer) {
+    llvm::errs() << "error: unable to read " << path << ": "
+                 << buffer.getError().message() << "\n";
+    return false;
+  }
+  kernels->push_back({path, (*buffer)->getBuffer().str()});
+  return true;
+}
+
+// Collects the kernels named by |inputs|, in a stable order so that results
+// are comparable across revisions.
+bool CollectKernels(const std::vector<std::string> &inputs,
+                    std::vector<Kernel> *kernels) {
+  for (const auto &input : inputs) {
+    if (!llvm::sys::fs::is_directory(input)) {
+      if (!AddKernel(input, kernels))
+        return false;
+      continue;
+    }
+
+    std::vector<std::string> paths;
+    std::error_code error;
+    for (llvm::sys::fs::recursive_directory_iterator it(input, error), end;
+         it != end && !error; it.increment(error)) {
+      if (llvm::sys::path::extension(it->path()) == ".cl")
+        paths.push_back(it->path());
+    }
+    std::sort(paths.begin(), paths.end());
+    for (const auto &path : paths) {
+      if (!AddKernel(path, kernels))
+        return false;
+    }
+  }
+  return true;
+}
+
+// Reads the per-pass statistics written by -pass-stats and splits the time
+// of |sample| into phases.  The SPIR-V producer is the last pass of the
+// pipeline.
+void ReadPhases(const std::string &stats_file, Sample *sample) {
+  auto buffer = llvm::MemoryBuffer::getFile(stats_file);
+  if (!buffer)
+    return;
+  auto json = llvm::json::parse((*buffer)->getBuffer());
+  if (!json) {
+    llvm::consumeError(json.takeError());
+    return;
+  }
+  const auto *stats = json->getAsObject();
+  const auto *passes = stats ? stats->getArray("passes") : nullptr;
+  if (!passes)
+    return;
+
+  double pipeline = 0;
+  double last = 0;
+  for (const auto &pass : *passes) {
+    const auto *object = pass.getAsObject();
+    if (!object)
+      continue;
+    last = object->getNumber("wall_seconds").getValueOr(0);
+    pipeline += last;
+  }
+  sample->producer = last;
+  sample->passes = pipeline - last;
+  sample->frontend = std::max(0.0, sample->total - pipeline);
+}
+
+// Reads the per-pass statistics written by -pass-stats and returns the number
+// of basic blocks the SPIR-V producer, the last pass, started from, or -1.
+int64_t ReadBlocks(const std::string &stats_file) {
+  auto buffer = llvm::MemoryBuffer::getFile(stats_file);
+  if (!buffer)
+    return -1;
+  auto json = llvm::json::parse((*buffer)->getBuffer());
+  if (!json) {
+    llvm::consumeError(json.takeError());
+    return -1;
+  }
+  const auto *stats = json->getAsObject();
+  const auto *passes = stats ? stats->getArray("passes") : nullptr;
+  if (!passes || passes->empty())
+    return -1;
+  const auto *producer = passes->back().getAsObject();
+  return producer ? producer->getInteger("blocks_before").getValueOr(-1) : -1;
+}
+
+// Returns a kernel calling a chain of |num_functions| helper functions.  Each
+// helper calls the previous one twice and is not inlined, so that they all
+// reach the SPIR-V producer.
+std::string ScalingKernel(unsigned num_functions) {
+  std::string source;
+  for (unsigned i = 0; i < num_functions; ++i) {
+    const std::string index = std::to_string(i);
+    source += "__attribute__((noinline)) int f" + index + "(int x) { return ";
+    if (i == 0) {
+      source += "x * 3 + 1";
+    } else {
+      const std::string previous = "f" + std::to_string(i - 1);
+      source += previous + "(x) * 3 + " + previous + "(x ^ " + index + ")";
+    }
+    source += "; }\n";
+  }
+  source += "kernel void k(global int *A) {\n"
+            "  size_t i = get_global_id(0);\n"
+            "  A[i] = f" +
+            std::to_string(num_functions - 1) + "(A[i]);\n}\n";
+  return source;
+}
+
+uint64_t PeakRSSBytes() {
+#if defined(_WIN32)
+  return 0;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#if defined(__APPLE__)
+  return uint64_t(usage.ru_maxrss);
+#else
+  return uint64_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+double Percentile(std::vector<double> values, double fraction) {
+  if (values.empty())
+    return 0;
+  std::sort(values.begin(), values.end());
+  size_t index = size_t(fraction * (values.size() - 1) + 0.5);
+  return values[std::min(index, values.size() - 1)];
+}
+
+class Bench {
+public:
+  Bench(const BenchOptions &opts, std::vector<Kernel> kernels)
+      : opts_(opts), kernels_(std::move(kernels)) {}
+
+  // Compiles every kernel once and drops the ones that fail.  Returns the
+  // number of kernels dropped.
+  size_t WarmUp() {
+    std::vector<Kernel> compiled;
+    for (auto &kernel : kernels_) {
+      std::vector<uint32_t> binary;
+      if (clspv::CompileFromSourceString(kernel.source, "", opts_.options,
+                                         &binary) == 0) {
+        compiled.push_back(std::move(kernel));
+      }
+    }
+    size_t failed = kernels_.size() - compiled.size();
+    kernels_ = std::move(compiled);
+    return failed;
+  }
+
+  size_t NumKernels() const { return kernels_.size(); }
+
+  void Run(llvm::json::OStream &json, const char *name, unsigned threads) {
+    const size_t num_jobs = kernels_.size() * opts_.iterations;
+    std::vector<Sample> samples(num_jobs);
+    std::atomic<size_t> next_job(0);
+
+    auto worker = [&]() {
+      std::string options = opts_.options;
+      llvm::SmallString<128> stats_file;
+      if (opts_.phases) {
+        llvm::sys::fs::createTemporaryFile("clspv_bench", "json", stats_file);
+        options += " -pass-stats=" + stats_file.str().str();
+      }
+      for (;;) {
+        size_t job = next_job++;
+        if (job >= num_jobs)
+          break;
+        const auto &kernel = kernels_[job % kernels_.size()];
+        std::vector<uint32_t> binary;
+        auto start = std::chrono::steady_clock::now();
+        clspv::CompileFromSourceString(kernel.source, "", options, &binary);
+        samples[job].total = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+        if (opts_.phases) {
+          ReadPhases(stats_file.str().str(), &samples[job]);
+        }
+      }
+      if (opts_.phases) {
+        llvm::sys::fs::remove(stats_file);
+      }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; ++i) {
+      workers.emplace_back(worker);
+    }
+    worker();
+    for (auto &t : workers) {
+      t.join();
+    }
+    double wall = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+
+    auto percentiles = [&](const char *phase, double Sample::*field) {
+      std::vector<double> values;
+      for (const auto &sample : samples) {
+        values.push_back(sample.*field * 1000);
+      }
+      json.attributeObject(phase, [&] {
+        json.attribute("p50_ms", Percentile(values, 0.50));
+        json.attribute("p99_ms", Percentile(values, 0.99));
+      });
+    };
+
+    json.object([&] {
+      json.attribute("mode", name);
+      json.attribute("threads", int64_t(threads));
+      json.attribute("compiles", int64_t(num_jobs));
+      json.attribute("wall_seconds", wall);
+      json.attribute("kernels_per_second", wall > 0 ? num_jobs / wall : 0);
+      json.attribute("peak_rss_bytes", int64_t(PeakRSSBytes()));
+      percentiles("latency", &Sample::total);
+      if (opts_.phases) {
+        percentiles("frontend", &Sample::frontend);
+        percentiles("passes", &Sample::passes);
+        percentiles("producer", &Sample::producer);
+      }
+    });
+  }
+
+private:
+  const BenchOptions &opts_;
+  std::vector<Kernel> kernels_;
+};
+
+// Compiles the scaling kernel of each size in |opts| and prints the median
+// compile time per function.  The time per function of the largest module
+// over the one of the smallest is reported as |growth|; near 1 means linear.
+int RunScaling(const BenchOptions &opts) {
+  std::vector<unsigned> sizes = opts.scaling;
+  std::sort(sizes.begin(), sizes.end());
+
+  std::vector<double> per_function;
+  llvm::json::OStream json(llvm::outs(), 2);
+  json.object([&] {
+    json.attribute("options", opts.options);
+    json.attribute("iterations", int64_t(opts.iterations));
+    json.attributeArray("scaling", [&] {
+      for (unsigned num_functions : sizes) {
+        const std::string source = ScalingKernel(num_functions);
+        std::vector<double> seconds;
+        for (unsigned i = 0; i < opts.iterations; ++i) {
+          std::vector<uint32_t> binary;
+          auto start = std::chrono::steady_clock::now();
+          const int result = clspv::CompileFromSourceString(
+              source, "", opts.options, &binary);
+          seconds.push_back(std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - start)
+                                .count());
+          if (result != 0) {
+            llvm::errs() << "error: the kernel with " << num_functions
+                         << " functions did not compile\n";
+            return;
+          }
+        }
+        const double median = Percentile(seconds, 0.5);
+        per_function.push_back(median / num_functions);
+        json.object([&] {
+          json.attribute("functions", int64_t(num_functions));
+          json.attribute("p50_ms", median * 1000);
+          json.attribute("us_per_function", median * 1e6 / num_functions);
+        });
+      }
+    });
+    if (per_function.size() == sizes.size() && per_function.front() > 0) {
+      json.attribute("growth", per_function.back() / per_function.front());
+    }
+  });
+  llvm::outs() << "\n";
+  return per_function.size() == sizes.size() ? 0 : 1;
+}
+
+// Compiles each kernel with the CFG structurizer run on every function and
+// with -structurize-unstructured-only, and prints the number of basic blocks
+// reaching the SPIR-V producer with each.  Kernels that fail to compile
+// either way are skipped.
+int RunBlocks(const BenchOptions &opts, const std::vector<Kernel> &kernels) {
+  llvm::SmallString<128> stats_file;
+  llvm::sys::fs::createTemporaryFile("clspv_bench", "json", stats_file);
+  auto count = [&](const Kernel &kernel, const std::string &options) {
+    std::vector<uint32_t> binary;
+    if (clspv::CompileFromSourceString(
+            kernel.source, "",
+            options + " -pass-stats=" + stats_file.str().str(),
+            &binary) != 0)
+      return int64_t(-1);
+    return ReadBlocks(stats_file.str().str());
+  };
+
+  int64_t total_all = 0;
+  int64_t total_selective = 0;
+  size_t failed = 0;
+  llvm::json::OStream json(llvm::outs(), 2);
+  json.object([&] {
+    json.attribute("options", opts.options);
+    json.attributeArray("blocks", [&] {
+      for (const auto &kernel : kernels) {
+        const int64_t all = count(kernel, opts.options);
+        const int64_t selective =
+            count(kernel, opts.options + " -structurize-unstructured-only");
+        if (all < 0 || selective < 0) {
+          ++failed;
+          continue;
+        }
+        total_all += all;
+        total_selective += selective;
+        json.object([&] {
+          json.attribute("kernel", kernel.path);
+          json.attribute("structurize_all", all);
+          json.attribute("structurize_unstructured_only", selective);
+        });
+      }
+    });
+    json.attribute("failed_kernels", int64_t(failed));
+    json.attribute("total_structurize_all", total_all);
+    json.attribute("total_structurize_unstructured_only", total_selective);
+  });
+  llvm::outs() << "\n";
+  llvm::sys::fs::remove(stats_file);
+  return failed == kernels.size() ? 1 : 0;
+}
+
+} // namespace
+
+int main(const int argc, const char *const argv[]) {
+  BenchOptions opts;
+  if (!ParseArguments(argc, argv, &opts)) {
+    llvm::errs() << kUsage;
+    return 1;
+  }
+
+  if (!opts.scaling.empty())
+    return RunScaling(opts);
+
+  std::vector<Kernel> kernels;
+  if (!CollectKernels(opts.inputs, &kernels))
+    return 1;
+
+  if (opts.blocks)
+    return RunBlocks(opts, kernels);
+
+  Bench bench(opts, std::move(kernels));
+  const size_t failed = bench.WarmUp();
+  if (bench.NumKernels() == 0) {
+    llvm::errs() << "error: none of the kernels compiled\n";
+    return 1;
+  }
+
+  // Peak RSS is process-wide, so the concurrent mode runs last and reports the
+  // peak over both modes.
+  llvm::json::OStream json(llvm::outs(), 2);
+  json.object([&] {
+    json.attribute("options", opts.options);
+    json.attribute("kernels", int64_t(bench.NumKernels()));
+    json.attribute("failed_kernels", int64_t(failed));
+    json.attribute("iterations", int64_t(opts.iterations));
+    json.attributeArray("modes", [&] {
+      bench.Run(json, "single", 1);
+      bench.Run(json, "concurrent", opts.threads);
+    });
+  });
+  llvm::outs() << "\n";
+  return 0;
+}
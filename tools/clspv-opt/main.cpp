@@ -24,6 +24,7 @@
 #include "llvm/IR/Verifier.h"
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/InitializePasses.h"
+#include "llvm/Passes/PassBuilder.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/InitLLVM.h"
 #include "llvm/Support/SourceMgr.h"
@@ -38,6 +39,14 @@ using namespace llvm;
 static llvm::cl::list<const PassInfo *, bool, PassNameParser>
     PassList(llvm::cl::desc("Transformations available:"));
 
+static llvm::cl::opt<std::string> NewPMPipeline(
+    "passes",
+    llvm::cl::desc("A pipeline to run with the new pass manager, in the syntax "
+                   "of opt -passes. FixupStructuredCFG and ReorderBasicBlocks "
+                   "are function passes, other clspv passes are written "
+                   "legacy<PassName>."),
+    llvm::cl::value_desc("pipeline"));
+
 static llvm::cl::opt<std::string>
     InputFile(llvm::cl::Positional, llvm::cl::desc("<input LLVM IR file>"),
               llvm::cl::init("-"), llvm::cl::value_desc("filename"));
@@ -94,6 +103,36 @@ int main(int argc, char **argv) {
     return 1;
   }
 
+  if (!NewPMPipeline.empty()) {
+    if (!PassList.empty()) {
+      errs() << argv[0] << ": -passes cannot be combined with legacy passes\n";
+      return 1;
+    }
+
+    llvm::LoopAnalysisManager lam;
+    llvm::FunctionAnalysisManager fam;
+    llvm::CGSCCAnalysisManager cgam;
+    llvm::ModuleAnalysisManager mam;
+    llvm::PassBuilder pb;
+    clspv::registerNewPMPasses(pb);
+    pb.registerModuleAnalyses(mam);
+    pb.registerCGSCCAnalyses(cgam);
+    pb.registerFunctionAnalyses(fam);
+    pb.registerLoopAnalyses(lam);
+    pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+    llvm::ModulePassManager mpm;
+    if (auto error = pb.parsePassPipeline(mpm, NewPMPipeline)) {
+      errs() << argv[0] << ": " << toString(std::move(error)) << "\n";
+      return 1;
+    }
+    mpm.addPass(llvm::VerifierPass());
+    mpm.addPass(llvm::PrintModulePass(out->os(), "", false));
+    mpm.run(*module, mam);
+    out->keep();
+    return 0;
+  }
+
   // Add a pass for each pass requested on the command-line.
   llvm::legacy::PassManager passes;
   for (unsigned i = 0; i < PassList.size(); ++i) {
@@ -0,0 +1,623 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstring>
+
+#include "spirv/unified1/spirv.hpp"
+
+#include "clspv/ReflectionInfo.h"
+#include "clspv/spirv_reflection.hpp"
+
+namespace {
+
+using namespace clspv;
+using namespace clspv::reflection;
+
+const char kReflectionImportPrefix[] = "NonSemantic.ClspvReflection.";
+
+// Parser state. Ids are dense up to the module bound, so per-id data is kept
+// in flat tables rather than hash maps.
+class Parser {
+public:
+  Parser(const uint32_t *words, size_t num_words, ReflectionInfo *info)
+      : words(words), num_words(num_words), info(info) {}
+
+  bool Run();
+
+private:
+  // Returns the literal string starting at word |offset| of |inst|.
+  BlobString LiteralString(const uint32_t *inst, uint32_t offset) const;
+
+  bool ParseExtInst(const uint32_t *inst, uint32_t word_count);
+
+  // Parses an instruction of the NonSemantic.ClspvPodSpecConstant set.
+  bool ParsePodSpecConstantExtInst(const uint32_t *inst, uint32_t word_count);
+
+  uint32_t Constant(uint32_t id) const {
+    return id < values.size() ? values[id] : 0;
+  }
+
+  BlobString String(uint32_t id) const {
+    return id < strings.size() ? strings[id] : BlobString();
+  }
+
+  // Records that the pointer |id| is derived from the same variable as
+  // |base|.
+  void DerivePointer(uint32_t id, uint32_t base) {
+    if (id < roots.size() && base < roots.size())
+      roots[id] = roots[base];
+  }
+
+  // Sets the access of the resource arguments from the decorations and
+  // atomics of the variables bound at their descriptor set and binding.
+  void SetArgAccess();
+
+  // Points each kernel at its <name>.uniform variant, if any.
+  void LinkUniformVariants();
+
+  // Decorations and uses of a variable relevant to the access of the
+  // arguments bound to it.
+  struct Variable {
+    uint32_t descriptor_set = 0;
+    uint32_t binding = 0;
+    bool has_descriptor_set = false;
+    bool has_binding = false;
+    bool non_writable = false;
+    bool non_readable = false;
+    bool atomic = false;
+  };
+
+  const uint32_t *words;
+  size_t num_words;
+  ReflectionInfo *info;
+
+  uint32_t import_id = 0;
+  uint32_t pod_spec_constant_import_id = 0;
+  uint32_t int_id = 0;
+
+  // Value of 32-bit integer constants and the kernel index of Kernel
+  // instructions, by result id.
+  std::vector<uint32_t> values;
+  // OpString values and argument names, by result id.
+  std::vector<BlobString> strings;
+  // Decorations and uses of each id, only meaningful for variables.
+  std::vector<Variable> variables;
+  // The variable each pointer is derived from through access chains, or 0.
+  std::vector<uint32_t> roots;
+};
+
+BlobString Parser::LiteralString(const uint32_t *inst, uint32_t offset) const {
+  const uint32_t word_count = inst[0] >> 16;
+  BlobString str;
+  if (offset >= word_count)
+    return str;
+  str.data = reinterpret_cast<const char *>(inst + offset);
+  str.size = static_cast<uint32_t>(
+      strnlen(str.data, (word_count - offset) * sizeof(uint32_t)));
+  return str;
+}
+
+bool Parser::Run() {
+  // Header: magic, version, generator, bound, schema.
+  if (num_words < 5 || words[0] != spv::MagicNumber)
+    return false;
+  // Every id is defined by an instruction of at least two words, so the ids
+  // of a module without large gaps stay below its word count. The tables are
+  // not sized from an untrusted bound beyond that, and larger ids are
+  // ignored.
+  const uint32_t bound =
+      static_cast<uint32_t>(std::min<size_t>(words[3], num_words));
+  values.assign(bound, 0);
+  strings.assign(bound, BlobString());
+  variables.assign(bound, Variable());
+  roots.assign(bound, 0);
+
+  for (size_t i = 5; i < num_words;) {
+    const uint32_t *inst = words + i;
+    const uint32_t word_count = inst[0] >> 16;
+    const auto opcode = static_cast<spv::Op>(inst[0] & spv::OpCodeMask);
+    if (word_count == 0 || i + word_count > num_words)
+      return false;
+    i += word_count;
+
+    switch (opcode) {
+    case spv::OpExtInstImport: {
+      if (word_count < 3)
+        break;
+      auto name = LiteralString(inst, 2);
+      if (strncmp(name.data, kReflectionImportPrefix,
+                  sizeof(kReflectionImportPrefix) - 1) == 0) {
+        import_id = inst[1];
+      } else if (name.size == sizeof(kPodSpecConstantImportName) - 1 &&
+                 std::memcmp(name.data, kPodSpecConstantImportName,
+                             name.size) == 0) {
+        pod_spec_constant_import_id = inst[1];
+      }
+      break;
+    }
+    case spv::OpString:
+      if (word_count > 2 && inst[1] < bound)
+        strings[inst[1]] = LiteralString(inst, 2);
+      break;
+    case spv::OpTypeInt:
+      if (word_count == 4 && inst[2] == 32 && inst[3] == 0)
+        int_id = inst[1];
+      break;
+    case spv::OpConstant:
+      if (word_count == 4 && inst[1] == int_id && inst[2] < bound)
+        values[inst[2]] = inst[3];
+      break;
+    case spv::OpDecorate:
+      if (word_count >= 3 && inst[1] < bound) {
+        auto &var = variables[inst[1]];
+        switch (static_cast<spv::Decoration>(inst[2])) {
+        case spv::DecorationDescriptorSet:
+          if (word_count == 4) {
+            var.descriptor_set = inst[3];
+            var.has_descriptor_set = true;
+          }
+          break;
+        case spv::DecorationBinding:
+          if (word_count == 4) {
+            var.binding = inst[3];
+            var.has_binding = true;
+          }
+          break;
+        case spv::DecorationNonWritable:
+          var.non_writable = true;
+          break;
+        case spv::DecorationNonReadable:
+          var.non_readable = true;
+          break;
+        default:
+          break;
+        }
+      }
+      break;
+    case spv::OpVariable:
+      if (word_count >= 4 && inst[2] < bound)
+        roots[inst[2]] = inst[2];
+      break;
+    case spv::OpAccessChain:
+    case spv::OpInBoundsAccessChain:
+    case spv::OpPtrAccessChain:
+    case spv::OpInBoundsPtrAccessChain:
+    case spv::OpCopyObject:
+      if (word_count >= 4)
+        DerivePointer(inst[2], inst[3]);
+      break;
+    case spv::OpAtomicStore:
+    case spv::OpAtomicFlagClear:
+      if (word_count >= 2 && inst[1] < bound && roots[inst[1]] != 0)
+        variables[roots[inst[1]]].atomic = true;
+      break;
+    case spv::OpAtomicLoad:
+    case spv::OpAtomicExchange:
+    case spv::OpAtomicCompareExchange:
+    case spv::OpAtomicCompareExchangeWeak:
+    case spv::OpAtomicIIncrement:
+    case spv::OpAtomicIDecrement:
+    case spv::OpAtomicIAdd:
+    case spv::OpAtomicISub:
+    case spv::OpAtomicSMin:
+    case spv::OpAtomicUMin:
+    case spv::OpAtomicSMax:
+    case spv::OpAtomicUMax:
+    case spv::OpAtomicAnd:
+    case spv::OpAtomicOr:
+    case spv::OpAtomicXor:
+    case spv::OpAtomicFlagTestAndSet:
+    case spv::OpAtomicFAddEXT:
+      if (word_count >= 4 && inst[3] < bound && roots[inst[3]] != 0)
+        variables[roots[inst[3]]].atomic = true;
+      break;
+    case spv::OpExtInst:
+      if (word_count >= 5 && inst[3] == import_id && import_id != 0) {
+        if (!ParseExtInst(inst, word_count))
+          return false;
+      } else if (word_count >= 5 && inst[3] == pod_spec_constant_import_id &&
+                 pod_spec_constant_import_id != 0) {
+        if (!ParsePodSpecConstantExtInst(inst, word_count))
+          return false;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  if (import_id == 0)
+    return false;
+
+  // Group the arguments by kernel. The producer emits them in ordinal order
+  // per kernel, but not necessarily contiguously.
+  std::stable_sort(info->args.begin(), info->args.end(),
+                   [](const ArgInfo &lhs, const ArgInfo &rhs) {
+                     if (lhs.kernel != rhs.kernel)
+                       return lhs.kernel < rhs.kernel;
+                     return lhs.ordinal < rhs.ordinal;
+                   });
+  for (uint32_t a = 0; a < info->args.size(); ++a) {
+    auto &kernel = info->kernels[info->args[a].kernel];
+    if (kernel.num_args++ == 0)
+      kernel.first_arg = a;
+  }
+
+  SetArgAccess();
+  LinkUniformVariants();
+
+  return true;
+}
+
+void Parser::SetArgAccess() {
+  // Several variables of different types can be bound at the same descriptor
+  // set and binding, so the access of an argument is the union of theirs.
+  struct Binding {
+    uint32_t descriptor_set;
+    uint32_t binding;
+    uint32_t access;
+  };
+  std::vector<Binding> bindings;
+  for (uint32_t id = 0; id < variables.size(); ++id) {
+    const auto &var = variables[id];
+    if (roots[id] != id || !var.has_descriptor_set || !var.has_binding)
+      continue;
+    uint32_t access = 0;
+    if (!var.non_readable)
+      access |= kArgAccessRead;
+    if (!var.non_writable)
+      access |= kArgAccessWrite;
+    if (var.atomic)
+      access |= kArgAccessAtomic;
+    bindings.push_back({var.descriptor_set, var.binding, access});
+  }
+
+  for (auto &arg : info->args) {
+    if (arg.kind == ArgKind::Local || arg.kind == ArgKind::PodPushConstant)
+      continue;
+    uint32_t access = 0;
+    bool found = false;
+    for (const auto &binding : bindings) {
+      if (binding.descriptor_set == arg.descriptor_set &&
+          binding.binding == arg.binding) {
+        access |= binding.access;
+        found = true;
+      }
+    }
+    if (found)
+      arg.access = access;
+  }
+}
+
+void Parser::LinkUniformVariants() {
+  static const char kSuffix[] = ".uniform";
+  const uint32_t suffix_size = sizeof(kSuffix) - 1;
+  auto &kernels = info->kernels;
+  for (uint32_t v = 0; v < kernels.size(); ++v) {
+    const auto &name = kernels[v].name;
+    if (name.size <= suffix_size ||
+        std::memcmp(name.data + name.size - suffix_size, kSuffix,
+                    suffix_size) != 0)
+      continue;
+    const uint32_t base_size = name.size - suffix_size;
+    for (auto &kernel : kernels) {
+      if (kernel.name.size == base_size &&
+          std::memcmp(kernel.name.data, name.data, base_size) == 0) {
+        kernel.uniform_variant = v;
+        break;
+      }
+    }
+  }
+}
+
+bool Parser::ParseExtInst(const uint32_t *inst, uint32_t word_count) {
+  const uint32_t result_id = inst[2];
+  const auto ext_inst = static_cast<ExtInst>(inst[4]);
+  // Operands of the extended instruction.
+  const uint32_t *ops = inst + 5;
+  const uint32_t num_ops = word_count - 5;
+
+  auto add_arg = [this, ops](ArgKind kind) -> ArgInfo * {
+    const uint32_t kernel = Constant(ops[0]);
+    if (kernel >= info->kernels.size())
+      return nullptr;
+    info->args.emplace_back();
+    auto &arg = info->args.back();
+    arg.kernel = kernel;
+    arg.kind = kind;
+    arg.ordinal = Constant(ops[1]);
+    return &arg;
+  };
+
+  switch (ext_inst) {
+  case ExtInstKernel: {
+    if (num_ops < 2 || result_id >= values.size())
+      return false;
+    values[result_id] = static_cast<uint32_t>(info->kernels.size());
+    info->kernels.emplace_back();
+    info->kernels.back().name = String(ops[1]);
+    break;
+  }
+  case ExtInstArgumentInfo:
+    if (num_ops < 1 || result_id >= strings.size())
+      return false;
+    strings[result_id] = String(ops[0]);
+    break;
+  case ExtInstArgumentStorageBuffer:
+  case ExtInstArgumentUniform:
+  case ExtInstArgumentSampledImage:
+  case ExtInstArgumentStorageImage:
+  case ExtInstArgumentSampler: {
+    if (num_ops < 4)
+      return false;
+    ArgKind kind = ArgKind::Buffer;
+    switch (ext_inst) {
+    case ExtInstArgumentUniform:
+      kind = ArgKind::BufferUBO;
+      break;
+    case ExtInstArgumentSampledImage:
+      kind = ArgKind::SampledImage;
+      break;
+    case ExtInstArgumentStorageImage:
+      kind = ArgKind::StorageImage;
+      break;
+    case ExtInstArgumentSampler:
+      kind = ArgKind::Sampler;
+      break;
+    default:
+      break;
+    }
+    auto *arg = add_arg(kind);
+    if (!arg)
+      return false;
+    arg->descriptor_set = Constant(ops[2]);
+    arg->binding = Constant(ops[3]);
+    if (num_ops > 4)
+      arg->name = String(ops[4]);
+    break;
+  }
+  case ExtInstArgumentPodStorageBuffer:
+  case ExtInstArgumentPodUniform: {
+    if (num_ops < 6)
+      return false;
+    auto *arg = add_arg(ext_inst == ExtInstArgumentPodUniform ? ArgKind::PodUBO
+                                                              : ArgKind::Pod);
+    if (!arg)
+      return false;
+    arg->descriptor_set = Constant(ops[2]);
+    arg->binding = Constant(ops[3]);
+    arg->offset = Constant(ops[4]);
+    arg->size = Constant(ops[5]);
+    if (num_ops > 6)
+      arg->name = String(ops[6]);
+    break;
+  }
+  case ExtInstArgumentPodPushConstant: {
+    if (num_ops < 4)
+      return false;
+    auto *arg = add_arg(ArgKind::PodPushConstant);
+    if (!arg)
+      return false;
+    arg->offset = Constant(ops[2]);
+    arg->size = Constant(ops[3]);
+    if (num_ops > 4)
+      arg->name = String(ops[4]);
+    break;
+  }
+  case ExtInstArgumentWorkgroup: {
+    if (num_ops < 4)
+      return false;
+    auto *arg = add_arg(ArgKind::Local);
+    if (!arg)
+      return false;
+    arg->spec_id = Constant(ops[2]);
+    arg->size = Constant(ops[3]);
+    if (num_ops > 4)
+      arg->name = String(ops[4]);
+    break;
+  }
+  case ExtInstConstantDataStorageBuffer:
+  case ExtInstConstantDataUniform: {
+    if (num_ops < 3)
+      return false;
+    info->constant_data.emplace_back();
+    auto &data = info->constant_data.back();
+    data.kind = ext_inst == ExtInstConstantDataUniform ? ArgKind::BufferUBO
+                                                       : ArgKind::Buffer;
+    data.descriptor_set = Constant(ops[0]);
+    data.binding = Constant(ops[1]);
+    data.hex_bytes = String(ops[2]);
+    break;
+  }
+  case ExtInstSpecConstantWorkgroupSize:
+  case ExtInstSpecConstantGlobalOffset: {
+    if (num_ops < 3)
+      return false;
+    const bool wgs = ext_inst == ExtInstSpecConstantWorkgroupSize;
+    const SpecConstant kinds[3] = {
+        wgs ? SpecConstant::kWorkgroupSizeX : SpecConstant::kGlobalOffsetX,
+        wgs ? SpecConstant::kWorkgroupSizeY : SpecConstant::kGlobalOffsetY,
+        wgs ? SpecConstant::kWorkgroupSizeZ : SpecConstant::kGlobalOffsetZ};
+    for (int d = 0; d < 3; ++d) {
+      info->spec_constants.emplace_back();
+      info->spec_constants.back().kind = kinds[d];
+      info->spec_constants.back().spec_id = Constant(ops[d]);
+    }
+    break;
+  }
+  case ExtInstSpecConstantWorkDim:
+    if (num_ops < 1)
+      return false;
+    info->spec_constants.emplace_back();
+    info->spec_constants.back().kind = SpecConstant::kWorkDim;
+    info->spec_constants.back().spec_id = Constant(ops[0]);
+    break;
+  case ExtInstPushConstantGlobalOffset:
+  case ExtInstPushConstantEnqueuedLocalSize:
+  case ExtInstPushConstantGlobalSize:
+  case ExtInstPushConstantRegionOffset:
+  case ExtInstPushConstantNumWorkgroups:
+  case ExtInstPushConstantRegionGroupOffset: {
+    if (num_ops < 2)
+      return false;
+    PushConstant kind = PushConstant::GlobalOffset;
+    switch (ext_inst) {
+    case ExtInstPushConstantEnqueuedLocalSize:
+      kind = PushConstant::EnqueuedLocalSize;
+      break;
+    case ExtInstPushConstantGlobalSize:
+      kind = PushConstant::GlobalSize;
+      break;
+    case ExtInstPushConstantRegionOffset:
+      kind = PushConstant::RegionOffset;
+      break;
+    case ExtInstPushConstantNumWorkgroups:
+      kind = PushConstant::NumWorkgroups;
+      break;
+    case ExtInstPushConstantRegionGroupOffset:
+      kind = PushConstant::RegionGroupOffset;
+      break;
+    default:
+      break;
+    }
+    info->push_constants.emplace_back();
+    auto &pc = info->push_constants.back();
+    pc.kind = kind;
+    pc.offset = Constant(ops[0]);
+    pc.size = Constant(ops[1]);
+    break;
+  }
+  case ExtInstPropertyRequiredWorkgroupSize: {
+    if (num_ops < 4)
+      return false;
+    const uint32_t kernel = Constant(ops[0]);
+    if (kernel >= info->kernels.size())
+      return false;
+    for (int d = 0; d < 3; ++d)
+      info->kernels[kernel].required_workgroup_size[d] = Constant(ops[d + 1]);
+    break;
+  }
+  case ExtInstLiteralSampler: {
+    if (num_ops < 3)
+      return false;
+    info->literal_samplers.emplace_back();
+    auto &sampler = info->literal_samplers.back();
+    sampler.descriptor_set = Constant(ops[0]);
+    sampler.binding = Constant(ops[1]);
+    sampler.mask = Constant(ops[2]);
+    break;
+  }
+  default:
+    break;
+  }
+
+  return true;
+}
+
+bool Parser::ParsePodSpecConstantExtInst(const uint32_t *inst,
+                                         uint32_t word_count) {
+  const uint32_t *ops = inst + 5;
+  const uint32_t num_ops = word_count - 5;
+  switch (inst[4]) {
+  case kPodSpecConstantArgument: {
+    if (num_ops < 3)
+      return false;
+    const uint32_t kernel = Constant(ops[0]);
+    if (kernel >= info->kernels.size())
+      return false;
+    info->spec_constants.emplace_back();
+    auto &sc = info->spec_constants.back();
+    sc.kind = SpecConstant::kPodArgument;
+    sc.kernel = kernel;
+    sc.ordinal = Constant(ops[1]);
+    sc.spec_id = Constant(ops[2]);
+    break;
+  }
+  default:
+    break;
+  }
+
+  return true;
+}
+
+} // namespace
+
+namespace clspv {
+namespace reflection {
+
+void ReflectionInfo::clear() {
+  kernels.clear();
+  args.clear();
+  push_constants.clear();
+  spec_constants.clear();
+  constant_data.clear();
+  literal_samplers.clear();
+}
+
+bool ParseReflectionInfo(const uint32_t *words, size_t num_words,
+                         ReflectionInfo *info) {
+  info->clear();
+  Parser parser(words, num_words, info);
+  return parser.Run();
+}
+
+std::vector<SharedBindingInfo> SharedBindings(const ReflectionInfo &info) {
+  // Collect the (set, binding, kernel) of every descriptor argument.
+  struct Use {
+    uint32_t descriptor_set;
+    uint32_t binding;
+    uint32_t kernel;
+    ArgKind kind;
+  };
+  std::vector<Use> uses;
+  for (const auto &arg : info.args) {
+    if (arg.kind == ArgKind::Local || arg.kind == ArgKind::PodPushConstant)
+      continue;
+    uses.push_back({arg.descriptor_set, arg.binding, arg.kernel, arg.kind});
+  }
+  std::stable_sort(uses.begin(), uses.end(), [](const Use &a, const Use &b) {
+    if (a.descriptor_set != b.descriptor_set)
+      return a.descriptor_set < b.descriptor_set;
+    if (a.binding != b.binding)
+      return a.binding < b.binding;
+    return a.kernel < b.kernel;
+  });
+
+  std::vector<SharedBindingInfo> shared;
+  auto same_binding = [](const Use &a, const Use &b) {
+    return a.descriptor_set == b.descriptor_set && a.binding == b.binding;
+  };
+  for (size_t i = 0; i < uses.size();) {
+    size_t end = i + 1;
+    uint32_t num_kernels = 1;
+    for (; end < uses.size() && same_binding(uses[i], uses[end]); ++end) {
+      if (uses[end].kernel != uses[end - 1].kernel)
+        ++num_kernels;
+    }
+    if (num_kernels > 1) {
+      SharedBindingInfo binding;
+      binding.descriptor_set = uses[i].descriptor_set;
+      binding.binding = uses[i].binding;
+      binding.kind = uses[i].kind;
+      binding.num_kernels = num_kernels;
+      shared.push_back(binding);
+    }
+    i = end;
+  }
+  return shared;
+}
+
+} // namespace reflection
+} // namespace clspv
@@ -0,0 +1,205 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iomanip>
+#include <ostream>
+
+#include "clspv/ArgKind.h"
+#include "clspv/PushConstant.h"
+#include "clspv/SpecConstant.h"
+
+#include "ReflectionJson.h"
+
+namespace {
+
+using namespace clspv;
+using namespace clspv::reflection;
+
+std::string ToString(const BlobString &str) {
+  return std::string(str.data, str.size);
+}
+
+// Returns true if arguments of |kind| are bound to a descriptor.
+bool HasDescriptor(ArgKind kind) {
+  switch (kind) {
+  case ArgKind::Local:
+  case ArgKind::PodPushConstant:
+    return false;
+  default:
+    return true;
+  }
+}
+
+// Returns true if arguments of |kind| are plain-old-data.
+bool IsPod(ArgKind kind) {
+  return kind == ArgKind::Pod || kind == ArgKind::PodUBO ||
+         kind == ArgKind::PodPushConstant;
+}
+
+void WriteAccess(uint32_t access, std::ostream *str) {
+  *str << "[";
+  const char *sep = "";
+  if (access & kArgAccessRead) {
+    *str << sep << "\"read\"";
+    sep = ",";
+  }
+  if (access & kArgAccessWrite) {
+    *str << sep << "\"write\"";
+    sep = ",";
+  }
+  if (access & kArgAccessAtomic) {
+    *str << sep << "\"atomic\"";
+  }
+  *str << "]";
+}
+
+void WriteArg(const ArgInfo &arg, std::ostream *str) {
+  *str << "{\"name\":";
+  WriteJsonString(ToString(arg.name), str);
+  *str << ",\"ordinal\":" << arg.ordinal << ",\"kind\":\""
+       << GetArgKindName(arg.kind) << "\"";
+  if (HasDescriptor(arg.kind)) {
+    *str << ",\"descriptor_set\":" << arg.descriptor_set
+         << ",\"binding\":" << arg.binding << ",\"access\":";
+    WriteAccess(arg.access, str);
+  }
+  if (IsPod(arg.kind)) {
+    *str << ",\"offset\":" << arg.offset << ",\"size\":" << arg.size;
+  }
+  if (arg.kind == ArgKind::Local) {
+    *str << ",\"spec_id\":" << arg.spec_id << ",\"element_size\":"
+         << arg.size;
+  }
+  *str << "}";
+}
+
+void WriteKernel(const ReflectionInfo &info, const KernelInfo &kernel,
+                 std::ostream *str) {
+  *str << "{\"name\":";
+  WriteJsonString(ToString(kernel.name), str);
+  const auto *size = kernel.required_workgroup_size;
+  if (size[0] || size[1] || size[2]) {
+    *str << ",\"reqd_work_group_size\":[" << size[0] << "," << size[1] << ","
+         << size[2] << "]";
+  }
+  if (kernel.uniform_variant != kNoKernel) {
+    *str << ",\"uniform_variant\":";
+    WriteJsonString(ToString(info.kernels[kernel.uniform_variant].name), str);
+  }
+  *str << ",\"args\":[";
+  for (uint32_t i = 0; i < kernel.num_args; ++i) {
+    if (i)
+      *str << ",";
+    WriteArg(info.args[kernel.first_arg + i], str);
+  }
+  *str << "]}";
+}
+
+} // namespace
+
+namespace clspv {
+
+void WriteJsonString(const std::string &value, std::ostream *str) {
+  *str << "\"";
+  for (unsigned char c : value) {
+    switch (c) {
+    case '"':
+      *str << "\\\"";
+      break;
+    case '\\':
+      *str << "\\\\";
+      break;
+    case '\n':
+      *str << "\\n";
+      break;
+    case '\t':
+      *str << "\\t";
+      break;
+    default:
+      if (c < 0x20) {
+        *str << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+             << static_cast<unsigned>(c) << std::dec << std::setfill(' ');
+      } else {
+        *str << c;
+      }
+      break;
+    }
+  }
+  *str << "\"";
+}
+
+void WriteReflectionJson(const reflection::ReflectionInfo &info,
+                         bool shared_bindings, std::ostream *str) {
+  *str << "{\"kernels\":[";
+  for (size_t i = 0; i < info.kernels.size(); ++i) {
+    if (i)
+      *str << ",";
+    WriteKernel(info, info.kernels[i], str);
+  }
+
+  *str << "],\"push_constants\":[";
+  for (size_t i = 0; i < info.push_constants.size(); ++i) {
+    const auto &pc = info.push_constants[i];
+    *str << (i ? "," : "") << "{\"kind\":\"" << GetPushConstantName(pc.kind)
+         << "\",\"offset\":" << pc.offset << ",\"size\":" << pc.size << "}";
+  }
+
+  *str << "],\"spec_constants\":[";
+  for (size_t i = 0; i < info.spec_constants.size(); ++i) {
+    const auto &sc = info.spec_constants[i];
+    *str << (i ? "," : "") << "{\"kind\":\"" << GetSpecConstantName(sc.kind)
+         << "\",\"spec_id\":" << sc.spec_id;
+    if (sc.kernel != kNoKernel) {
+      *str << ",\"kernel\":";
+      WriteJsonString(ToString(info.kernels[sc.kernel].name), str);
+      *str << ",\"ordinal\":" << sc.ordinal;
+    }
+    *str << "}";
+  }
+
+  *str << "],\"constant_data\":[";
+  for (size_t i = 0; i < info.constant_data.size(); ++i) {
+    const auto &data = info.constant_data[i];
+    *str << (i ? "," : "") << "{\"kind\":\"" << GetArgKindName(data.kind)
+         << "\",\"descriptor_set\":" << data.descriptor_set
+         << ",\"binding\":" << data.binding << ",\"hex_bytes\":";
+    WriteJsonString(ToString(data.hex_bytes), str);
+    *str << "}";
+  }
+
+  *str << "],\"literal_samplers\":[";
+  for (size_t i = 0; i < info.literal_samplers.size(); ++i) {
+    const auto &sampler = info.literal_samplers[i];
+    *str << (i ? "," : "") << "{\"mask\":" << sampler.mask
+         << ",\"descriptor_set\":" << sampler.descriptor_set
+         << ",\"binding\":" << sampler.binding << "}";
+  }
+  *str << "]";
+
+  if (shared_bindings) {
+    *str << ",\"shared_bindings\":[";
+    const char *sep = "";
+    for (const auto &binding : SharedBindings(info)) {
+      *str << sep << "{\"descriptor_set\":" << binding.descriptor_set
+           << ",\"binding\":" << binding.binding << ",\"kind\":\""
+           << GetArgKindName(binding.kind)
+           << "\",\"kernels\":" << binding.num_kernels << "}";
+      sep = ",";
+    }
+    *str << "]";
+  }
+  *str << "}";
+}
+
+} // namespace clspv
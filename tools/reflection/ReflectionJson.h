@@ -0,0 +1,31 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iosfwd>
+#include <string>
+
+#include "clspv/ReflectionInfo.h"
+
+namespace clspv {
+
+// Writes |info| to |str| as a JSON object with one array per kind of entry.
+// The bindings shared between kernels are included if |shared_bindings| is
+// true.
+void WriteReflectionJson(const reflection::ReflectionInfo &info,
+                         bool shared_bindings, std::ostream *str);
+
+// Writes |value| to |str| as a JSON string.
+void WriteJsonString(const std::string &value, std::ostream *str);
+
+} // namespace clspv
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <cassert>
+#include <cstring>
 #include <ostream>
 #include <unordered_map>
 
@@ -20,6 +21,9 @@
 #include "spirv/unified1/spirv.hpp"
 
 #include "clspv/ArgKind.h"
+#include "clspv/ImmutableSamplers.h"
+#include "clspv/KernelResourceUsage.h"
+#include "clspv/ProfileCounters.h"
 #include "clspv/PushConstant.h"
 #include "clspv/Sampler.h"
 #include "clspv/SpecConstant.h"
@@ -30,7 +34,8 @@
 namespace {
 class ReflectionParser {
 public:
-  ReflectionParser(std::ostream *ostr) : str(ostr) {}
+  ReflectionParser(std::ostream *ostr, bool arg_access)
+      : str(ostr), arg_access(arg_access) {}
 
   // Parses |inst| and emits descriptor map entries as necessary.
   spv_result_t ParseInstruction(const spv_parsed_instruction_t *inst);
@@ -45,15 +50,46 @@ private:
   // Descriptor map output stream.
   std::ostream *str;
 
+  // Whether buffer arguments get an argAccess entry.
+  bool arg_access;
+
   // Tracks OpTypeInt 32 0 result id.
   uint32_t int_id = 0;
 
+  // Tracks the NonSemantic.ClspvPodSpecConstant import result id.
+  uint32_t pod_spec_constant_import_id = 0;
+  // Tracks the NonSemantic.ClspvProfileCounters import result id.
+  uint32_t profile_counters_import_id = 0;
+  // Tracks the NonSemantic.ClspvKernelResourceUsage import result id.
+  uint32_t kernel_resource_usage_import_id = 0;
+  // Tracks the NonSemantic.ClspvImmutableSamplers import result id.
+  uint32_t immutable_samplers_import_id = 0;
+
   // String mappings. Includes OpString value to result id, Kernel name to
   // result id and argument name to result id.
   std::unordered_map<uint32_t, std::string> strings;
 
   // Maps u32 constant result ids to their values.
   std::unordered_map<uint32_t, uint32_t> constants;
+
+  // Returns the argAccess entry of the argument bound at |descriptor_set| and
+  // |binding|, which is the union of the access of the variables bound there.
+  const char *GetArgAccessName(uint32_t descriptor_set, uint32_t binding);
+
+  // Decorations and atomic uses of the resource variables, by result id.
+  struct Variable {
+    uint32_t descriptor_set = 0;
+    uint32_t binding = 0;
+    bool has_descriptor_set = false;
+    bool has_binding = false;
+    bool non_writable = false;
+    bool non_readable = false;
+    bool atomic = false;
+  };
+  std::unordered_map<uint32_t, Variable> variables;
+
+  // Maps pointers derived through access chains to their variable.
+  std::unordered_map<uint32_t, uint32_t> roots;
 };
 
 spv_result_t ParseInstruction(void *user_data,
@@ -115,9 +151,103 @@ ReflectionParser::GetPushConstantFromExtInst(uint32_t value) {
   }
 }
 
+const char *ReflectionParser::GetArgAccessName(uint32_t descriptor_set,
+                                               uint32_t binding) {
+  uint32_t access = 0;
+  for (const auto &entry : variables) {
+    const auto &var = entry.second;
+    if (!var.has_descriptor_set || !var.has_binding ||
+        var.descriptor_set != descriptor_set || var.binding != binding)
+      continue;
+    if (!var.non_readable)
+      access |= clspv::kArgAccessRead;
+    if (!var.non_writable)
+      access |= clspv::kArgAccessWrite;
+    if (var.atomic)
+      access |= clspv::kArgAccessAtomic;
+  }
+
+  if (access & clspv::kArgAccessAtomic)
+    return "atomic";
+  switch (access) {
+  case clspv::kArgAccessRead:
+    return "read_only";
+  case clspv::kArgAccessWrite:
+    return "write_only";
+  case 0:
+    return "none";
+  default:
+    return "read_write";
+  }
+}
+
 spv_result_t
 ReflectionParser::ParseInstruction(const spv_parsed_instruction_t *inst) {
   switch (inst->opcode) {
+  case spv::OpDecorate: {
+    auto &var = variables[inst->words[inst->operands[0].offset]];
+    const auto decoration =
+        static_cast<spv::Decoration>(inst->words[inst->operands[1].offset]);
+    switch (decoration) {
+    case spv::DecorationDescriptorSet:
+      var.descriptor_set = inst->words[inst->operands[2].offset];
+      var.has_descriptor_set = true;
+      break;
+    case spv::DecorationBinding:
+      var.binding = inst->words[inst->operands[2].offset];
+      var.has_binding = true;
+      break;
+    case spv::DecorationNonWritable:
+      var.non_writable = true;
+      break;
+    case spv::DecorationNonReadable:
+      var.non_readable = true;
+      break;
+    default:
+      break;
+    }
+    break;
+  }
+  case spv::OpVariable:
+    roots[inst->result_id] = inst->result_id;
+    break;
+  case spv::OpAccessChain:
+  case spv::OpInBoundsAccessChain:
+  case spv::OpPtrAccessChain:
+  case spv::OpInBoundsPtrAccessChain:
+  case spv::OpCopyObject: {
+    auto iter = roots.find(inst->words[inst->operands[2].offset]);
+    if (iter != roots.end())
+      roots[inst->result_id] = iter->second;
+    break;
+  }
+  case spv::OpAtomicStore:
+  case spv::OpAtomicFlagClear:
+  case spv::OpAtomicLoad:
+  case spv::OpAtomicExchange:
+  case spv::OpAtomicCompareExchange:
+  case spv::OpAtomicCompareExchangeWeak:
+  case spv::OpAtomicIIncrement:
+  case spv::OpAtomicIDecrement:
+  case spv::OpAtomicIAdd:
+  case spv::OpAtomicISub:
+  case spv::OpAtomicSMin:
+  case spv::OpAtomicUMin:
+  case spv::OpAtomicSMax:
+  case spv::OpAtomicUMax:
+  case spv::OpAtomicAnd:
+  case spv::OpAtomicOr:
+  case spv::OpAtomicXor:
+  case spv::OpAtomicFlagTestAndSet:
+  case spv::OpAtomicFAddEXT: {
+    // The pointer is the first operand after the result type and id, if any.
+    const bool has_result = inst->result_id != 0;
+    auto iter =
+        roots.find(inst->words[inst->operands[has_result ? 2 : 0].offset]);
+    if (iter != roots.end())
+      variables[iter->second].atomic = true;
+    break;
+  }
   case spv::OpTypeInt:
     if (inst->words[inst->operands[1].offset] == 32 &&
         inst->words[inst->operands[2].offset] == 0) {
@@ -130,6 +260,25 @@ ReflectionParser::ParseInstruction(const spv_parsed_instruction_t *inst) {
       constants[inst->result_id] = value;
     }
     break;
+  case spv::OpExtInstImport:
+    if (strcmp(reinterpret_cast<const char *>(inst->words +
+                                              inst->operands[1].offset),
+               clspv::kPodSpecConstantImportName) == 0) {
+      pod_spec_constant_import_id = inst->result_id;
+    } else if (strcmp(reinterpret_cast<const char *>(
+                          inst->words + inst->operands[1].offset),
+                      clspv::kProfileCountersImportName) == 0) {
+      profile_counters_import_id = inst->result_id;
+    } else if (strcmp(reinterpret_cast<const char *>(
+                          inst->words + inst->operands[1].offset),
+                      clspv::kKernelResourceUsageImportName) == 0) {
+      kernel_resource_usage_import_id = inst->result_id;
+    } else if (strcmp(reinterpret_cast<const char *>(
+                          inst->words + inst->operands[1].offset),
+                      clspv::kImmutableSamplersImportName) == 0) {
+      immutable_samplers_import_id = inst->result_id;
+    }
+    break;
   case spv::OpString: {
     std::string value =
         reinterpret_cast<const char *>(inst->words + inst->operands[1].offset);
@@ -172,7 +321,12 @@ ReflectionParser::ParseInstruction(const spv_parsed_instruction_t *inst) {
         *str << "kernel," << strings[kernel_id] << ",arg," << arg_name
              << ",argOrdinal," << constants[ordinal_id] << ",descriptorSet,"
              << constants[ds_id] << ",binding," << constants[binding_id]
-             << ",offset,0,argKind," << clspv::GetArgKindName(kind) << "\n";
+             << ",offset,0,argKind," << clspv::GetArgKindName(kind);
+        if (arg_access && kind == clspv::ArgKind::Buffer) {
+          *str << ",argAccess,"
+               << GetArgAccessName(constants[ds_id], constants[binding_id]);
+        }
+        *str << "\n";
         break;
       }
       case clspv::reflection::ExtInstArgumentPodStorageBuffer:
@@ -318,6 +472,82 @@ ReflectionParser::ParseInstruction(const spv_parsed_instruction_t *inst) {
       }
       break;
     }
+    if (pod_spec_constant_import_id != 0 &&
+        inst->words[inst->operands[2].offset] == pod_spec_constant_import_id &&
+        inst->words[inst->operands[3].offset] ==
+            clspv::kPodSpecConstantArgument) {
+      // Emit a spec constant entry naming the argument it replaces.
+      auto kernel_id = inst->words[inst->operands[4].offset];
+      auto ordinal_id = inst->words[inst->operands[5].offset];
+      auto spec_id = inst->words[inst->operands[6].offset];
+      *str << "spec_constant,"
+           << clspv::GetSpecConstantName(clspv::SpecConstant::kPodArgument)
+           << ",spec_id," << constants[spec_id] << ",kernel,"
+           << strings[kernel_id] << ",argOrdinal," << constants[ordinal_id]
+           << "\n";
+    }
+    if (profile_counters_import_id != 0 &&
+        inst->words[inst->operands[2].offset] == profile_counters_import_id) {
+      switch (inst->words[inst->operands[3].offset]) {
+      case clspv::kProfileCountersBuffer: {
+        auto ds_id = inst->words[inst->operands[4].offset];
+        auto binding_id = inst->words[inst->operands[5].offset];
+        auto count_id = inst->words[inst->operands[6].offset];
+        *str << "profile_counters,descriptorSet," << constants[ds_id]
+             << ",binding," << constants[binding_id] << ",count,"
+             << constants[count_id] << "\n";
+        break;
+      }
+      case clspv::kProfileCounter: {
+        auto index_id = inst->words[inst->operands[4].offset];
+        auto location_id = inst->words[inst->operands[5].offset];
+        *str << "profile_counter," << constants[index_id] << ",location,"
+             << strings[location_id] << "\n";
+        break;
+      }
+      default:
+        break;
+      }
+    }
+    if (kernel_resource_usage_import_id != 0 &&
+        inst->words[inst->operands[2].offset] ==
+            kernel_resource_usage_import_id) {
+      // Both instructions have the kernel and three integers.
+      const auto &kernel = strings[inst->words[inst->operands[4].offset]];
+      auto first = constants[inst->words[inst->operands[5].offset]];
+      auto second = constants[inst->words[inst->operands[6].offset]];
+      auto third = constants[inst->words[inst->operands[7].offset]];
+      switch (inst->words[inst->operands[3].offset]) {
+      case clspv::kKernelResourceUsage:
+        *str << "kernel," << kernel << ",resource_usage,workgroupBytes,"
+             << first << ",privateBytes," << second << ",pushConstantBytes,"
+             << third << "\n";
+        break;
+      case clspv::kKernelSuggestedLocalSize:
+        *str << "kernel," << kernel << ",suggested_local_size," << first
+             << "," << second << "," << third << "\n";
+        break;
+      default:
+        break;
+      }
+    }
+    if (immutable_samplers_import_id != 0 &&
+        inst->words[inst->operands[2].offset] ==
+            immutable_samplers_import_id &&
+        inst->words[inst->operands[3].offset] == clspv::kImmutableSampler) {
+      auto ds_id = inst->words[inst->operands[4].offset];
+      auto binding_id = inst->words[inst->operands[5].offset];
+      auto filter_id = inst->words[inst->operands[6].offset];
+      auto address_mode_id = inst->words[inst->operands[7].offset];
+      auto unnormalized_id = inst->words[inst->operands[8].offset];
+      auto border_color_id = inst->words[inst->operands[9].offset];
+      *str << "immutable_sampler,descriptorSet," << constants[ds_id]
+           << ",binding," << constants[binding_id] << ",filter,"
+           << constants[filter_id] << ",addressMode,"
+           << constants[address_mode_id] << ",unnormalizedCoordinates,"
+           << constants[unnormalized_id] << ",borderColor,"
+           << constants[border_color_id] << "\n";
+    }
     break;
   default:
     break;
@@ -330,8 +560,8 @@ ReflectionParser::ParseInstruction(const spv_parsed_instruction_t *inst) {
 namespace clspv {
 
 bool ParseReflection(const std::vector<uint32_t> &binary, spv_target_env env,
-                     std::ostream *str) {
-  ReflectionParser parser(str);
+                     std::ostream *str, bool arg_access) {
+  ReflectionParser parser(str, arg_access);
   auto MessageConsumer = [](spv_message_level_t, const char *,
                             const spv_position_t, const char *) {};
   spvtools::Context context(env);
@@ -19,7 +19,9 @@
 
 namespace clspv {
 
+// Writes the descriptor map of |binary| to |str|. With |arg_access|, the
+// entries of buffer arguments end with an argAccess field.
 bool ParseReflection(const std::vector<uint32_t> &binary, spv_target_env env,
-                     std::ostream *str);
+                     std::ostream *str, bool arg_access = false);
 
 } // namespace clspv
@@ -0,0 +1,203 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+
+#include "clspv/ReflectionSidecar.h"
+
+namespace {
+
+using namespace clspv::reflection;
+
+static_assert(sizeof(SidecarHeader) == 17 * sizeof(uint32_t),
+              "sidecar header must not be padded");
+static_assert(sizeof(SidecarKernel) == 6 * sizeof(uint32_t),
+              "sidecar kernel must not be padded");
+static_assert(sizeof(SidecarArg) == 10 * sizeof(uint32_t),
+              "sidecar arg must not be padded");
+
+// Number of words used by |count| entries of type T.
+template <typename T> uint32_t Words(size_t count) {
+  return static_cast<uint32_t>(count * sizeof(T) / sizeof(uint32_t));
+}
+
+// Appends strings to the string table of a sidecar.
+class StringTable {
+public:
+  uint32_t add(const BlobString &str) {
+    uint32_t offset = static_cast<uint32_t>(bytes.size());
+    bytes.insert(bytes.end(), str.data, str.data + str.size);
+    bytes.push_back('\0');
+    return offset;
+  }
+
+  std::vector<char> bytes;
+};
+
+} // namespace
+
+namespace clspv {
+namespace reflection {
+
+void WriteSidecar(const ReflectionInfo &info, std::vector<uint32_t> *out) {
+  StringTable strings;
+
+  std::vector<SidecarKernel> kernels(info.kernels.size());
+  for (size_t i = 0; i < info.kernels.size(); ++i) {
+    const auto &k = info.kernels[i];
+    kernels[i].name = strings.add(k.name);
+    kernels[i].first_arg = k.first_arg;
+    kernels[i].num_args = k.num_args;
+    for (int d = 0; d < 3; ++d)
+      kernels[i].required_workgroup_size[d] = k.required_workgroup_size[d];
+  }
+
+  std::vector<SidecarArg> args(info.args.size());
+  for (size_t i = 0; i < info.args.size(); ++i) {
+    const auto &a = info.args[i];
+    args[i].kernel = a.kernel;
+    args[i].name = strings.add(a.name);
+    args[i].kind = static_cast<uint32_t>(a.kind);
+    args[i].ordinal = a.ordinal;
+    args[i].descriptor_set = a.descriptor_set;
+    args[i].binding = a.binding;
+    args[i].offset = a.offset;
+    args[i].size = a.size;
+    args[i].spec_id = a.spec_id;
+    args[i].access = a.access;
+  }
+
+  std::vector<SidecarPushConstant> push_constants;
+  for (const auto &pc : info.push_constants)
+    push_constants.push_back(
+        {static_cast<uint32_t>(pc.kind), pc.offset, pc.size});
+
+  std::vector<SidecarSpecConstant> spec_constants;
+  for (const auto &sc : info.spec_constants)
+    spec_constants.push_back(
+        {static_cast<uint32_t>(sc.kind), sc.spec_id, sc.kernel, sc.ordinal});
+
+  std::vector<SidecarConstantData> constant_data;
+  for (const auto &data : info.constant_data)
+    constant_data.push_back({static_cast<uint32_t>(data.kind),
+                             data.descriptor_set, data.binding,
+                             strings.add(data.hex_bytes)});
+
+  std::vector<SidecarLiteralSampler> literal_samplers;
+  for (const auto &sampler : info.literal_samplers)
+    literal_samplers.push_back(
+        {sampler.mask, sampler.descriptor_set, sampler.binding});
+
+  // Lay out the tables after the header, then the string table padded to a
+  // whole word.
+  SidecarHeader header;
+  header.magic = kSidecarMagic;
+  header.version = kSidecarVersion;
+  uint32_t words = Words<SidecarHeader>(1);
+  auto place = [&words](SidecarTable *table, size_t count, uint32_t size) {
+    table->offset = words * sizeof(uint32_t);
+    table->count = static_cast<uint32_t>(count);
+    words += size;
+  };
+  place(&header.kernels, kernels.size(), Words<SidecarKernel>(kernels.size()));
+  place(&header.args, args.size(), Words<SidecarArg>(args.size()));
+  place(&header.push_constants, push_constants.size(),
+        Words<SidecarPushConstant>(push_constants.size()));
+  place(&header.spec_constants, spec_constants.size(),
+        Words<SidecarSpecConstant>(spec_constants.size()));
+  place(&header.constant_data, constant_data.size(),
+        Words<SidecarConstantData>(constant_data.size()));
+  place(&header.literal_samplers, literal_samplers.size(),
+        Words<SidecarLiteralSampler>(literal_samplers.size()));
+  place(&header.strings, strings.bytes.size(),
+        static_cast<uint32_t>((strings.bytes.size() + 3) / 4));
+  header.size = words * sizeof(uint32_t);
+
+  out->assign(words, 0);
+  char *base = reinterpret_cast<char *>(out->data());
+  auto copy = [base](const SidecarTable &table, const void *data,
+                     size_t size) {
+    if (size)
+      memcpy(base + table.offset, data, size);
+  };
+  memcpy(base, &header, sizeof(header));
+  copy(header.kernels, kernels.data(), kernels.size() * sizeof(SidecarKernel));
+  copy(header.args, args.data(), args.size() * sizeof(SidecarArg));
+  copy(header.push_constants, push_constants.data(),
+       push_constants.size() * sizeof(SidecarPushConstant));
+  copy(header.spec_constants, spec_constants.data(),
+       spec_constants.size() * sizeof(SidecarSpecConstant));
+  copy(header.constant_data, constant_data.data(),
+       constant_data.size() * sizeof(SidecarConstantData));
+  copy(header.literal_samplers, literal_samplers.data(),
+       literal_samplers.size() * sizeof(SidecarLiteralSampler));
+  copy(header.strings, strings.bytes.data(), strings.bytes.size());
+}
+
+bool SidecarView::init(const void *data, size_t size) {
+  base_ = nullptr;
+  header_ = nullptr;
+  if (size < sizeof(SidecarHeader) ||
+      reinterpret_cast<uintptr_t>(data) % alignof(uint32_t) != 0)
+    return false;
+
+  const auto *header = static_cast<const SidecarHeader *>(data);
+  if (header->magic != kSidecarMagic || header->version != kSidecarVersion ||
+      header->size > size)
+    return false;
+
+  auto fits = [header](const SidecarTable &table, size_t entry_size) {
+    return table.offset % alignof(uint32_t) == 0 &&
+           table.offset <= header->size &&
+           uint64_t(table.count) * entry_size <= header->size - table.offset;
+  };
+  if (!fits(header->kernels, sizeof(SidecarKernel)) ||
+      !fits(header->args, sizeof(SidecarArg)) ||
+      !fits(header->push_constants, sizeof(SidecarPushConstant)) ||
+      !fits(header->spec_constants, sizeof(SidecarSpecConstant)) ||
+      !fits(header->constant_data, sizeof(SidecarConstantData)) ||
+      !fits(header->literal_samplers, sizeof(SidecarLiteralSampler)) ||
+      !fits(header->strings, 1))
+    return false;
+
+  // Strings must be terminated inside the table.
+  const char *strings =
+      static_cast<const char *>(data) + header->strings.offset;
+  if (header->strings.count != 0 && strings[header->strings.count - 1] != '\0')
+    return false;
+
+  base_ = static_cast<const uint8_t *>(data);
+  header_ = header;
+
+  // String and argument references must stay inside their tables.
+  const uint32_t strings_size = header->strings.count;
+  bool ok = true;
+  for (uint32_t i = 0; ok && i < num_kernels(); ++i) {
+    const auto &k = kernel(i);
+    ok = k.name < strings_size && k.first_arg <= num_args() &&
+         k.num_args <= num_args() - k.first_arg;
+  }
+  for (uint32_t i = 0; ok && i < num_args(); ++i)
+    ok = arg(i).name < strings_size && arg(i).kernel < num_kernels();
+  for (uint32_t i = 0; ok && i < num_constant_data(); ++i)
+    ok = constant_data(i).hex_bytes < strings_size;
+  if (!ok) {
+    base_ = nullptr;
+    header_ = nullptr;
+  }
+  return ok;
+}
+
+} // namespace reflection
+} // namespace clspv
@@ -12,17 +12,29 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "spirv-tools/libspirv.hpp"
 
+#include "clspv/CompressedSPIRV.h"
+#include "clspv/ReflectionInfo.h"
+
+#include "ReflectionJson.h"
 #include "ReflectionParser.h"
 
 void PrintUsage() {
   const std::string help =
-      R"(Usage: clspv-reflection [--target-env <env>] [-o <outfile>] <infile>
+      R"(Usage: clspv-reflection [--target-env <env>] [-o <outfile>] <infile>...
+
+Inputs may be SPIR-V modules or compressed modules written by -mfmt=cspv.
 
 Options:
 --target-env <env>              Specify the SPIR-V environment. Must be one of:
@@ -39,16 +51,168 @@ Options:
                                 stdout.
 
 -d                              Disable validation.
+
+--shared-bindings               Also list the descriptor bindings used by more
+                                than one kernel.
+
+--arg-access                    Also give the access of each buffer argument,
+                                as an argAccess field of its entry.
+
+--manifest <file>               Also read the input filenames from <file>, one
+                                per line.
+
+--format <format>               Specify the output format. Must be one of:
+                                 * text: the descriptor map of each module,
+                                   preceded by a module,<infile> line when
+                                   there are several inputs.
+                                 * json: one object mapping each input
+                                   filename to its reflection.
+                                Default is text.
+
+-j <n>                          Parse up to <n> modules concurrently.
+                                Default is the number of hardware threads.
+
+--decompress                    Write the SPIR-V module of the single input
+                                instead of its reflection, expanding it if it
+                                is compressed.
 )";
 
   std::cout << help;
 }
 
-int main(const int argc, const char *const argv[]) {
+namespace {
+
+enum class Format { kText, kJson };
+
+struct Options {
+  spv_target_env env = SPV_ENV_UNIVERSAL_1_0;
+  bool validate = true;
+  bool shared_bindings = false;
+  bool arg_access = false;
+  bool decompress = false;
+  Format format = Format::kText;
+};
+
+// The reflection of one input module.
+struct Module {
   std::string filename;
+  // The reflection in the output format, if |error| is empty.
+  std::string output;
+  std::string error;
+};
+
+bool ReadBinary(const std::string &filename, std::vector<uint32_t> *binary,
+                size_t *size) {
+  std::ifstream str(filename.c_str(), std::ifstream::in |
+                                          std::ifstream::binary |
+                                          std::ifstream::ate);
+  if (!str) {
+    return false;
+  }
+  *size = static_cast<size_t>(str.tellg());
+  binary->assign((*size + 3) / 4, 0);
+  str.seekg(std::ios::beg);
+  str.read(reinterpret_cast<char *>(binary->data()), *size);
+  return true;
+}
+
+void ProcessModule(const Options &options, Module *module) {
+  std::vector<uint32_t> binary;
+  size_t size = 0;
+  if (!ReadBinary(module->filename, &binary, &size)) {
+    module->error = "failed to open '" + module->filename + "'";
+    return;
+  }
+  if (clspv::IsCompressedSPIRV(binary.data(), size)) {
+    std::vector<uint32_t> compressed;
+    compressed.swap(binary);
+    if (!clspv::DecompressSPIRV(compressed.data(), size, &binary)) {
+      module->error = "failed to decompress '" + module->filename + "'";
+      return;
+    }
+  } else {
+    binary.resize(size / 4);
+  }
+
+  // TODO: worth forwarding some validator options (e.g. layout options)?
+  if (options.validate) {
+    // The parser assumes valid SPIR-V, so verify that assumption now.
+    spvtools::SpirvTools tools(options.env);
+    if (!tools.Validate(binary)) {
+      module->error = "invalid binary '" + module->filename + "'";
+      return;
+    }
+  }
+
+  if (options.decompress) {
+    module->output.assign(reinterpret_cast<const char *>(binary.data()),
+                          binary.size() * sizeof(uint32_t));
+    return;
+  }
+
+  std::ostringstream str;
+  clspv::reflection::ReflectionInfo info;
+  bool ok = true;
+  if (options.format == Format::kText) {
+    ok = clspv::ParseReflection(binary, options.env, &str, options.arg_access);
+    if (ok && options.shared_bindings) {
+      ok = clspv::reflection::ParseReflectionInfo(binary.data(),
+                                                  binary.size(), &info);
+      for (const auto &binding : clspv::reflection::SharedBindings(info)) {
+        str << "shared_binding,descriptorSet," << binding.descriptor_set
+            << ",binding," << binding.binding << ",argKind,"
+            << clspv::GetArgKindName(binding.kind) << ",kernels,"
+            << binding.num_kernels << "\n";
+      }
+    }
+  } else {
+    ok = clspv::reflection::ParseReflectionInfo(binary.data(), binary.size(),
+                                                &info);
+    if (ok) {
+      clspv::WriteReflectionJson(info, options.shared_bindings, &str);
+    }
+  }
+
+  if (!ok) {
+    module->error =
+        "failed to parse reflection info of '" + module->filename + "'";
+    return;
+  }
+  module->output = str.str();
+}
+
+// Processes |modules| on up to |num_threads| threads. Each module is
+// independent, so the workers only share the index of the next one.
+void ProcessModules(const Options &options, unsigned num_threads,
+                    std::vector<Module> *modules) {
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < modules->size(); i = next++) {
+      ProcessModule(options, &(*modules)[i]);
+    }
+  };
+
+  num_threads = std::min<size_t>(num_threads, modules->size());
+  if (num_threads <= 1) {
+    worker();
+    return;
+  }
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < num_threads; ++i) {
+    threads.emplace_back(worker);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+} // namespace
+
+int main(const int argc, const char *const argv[]) {
+  std::vector<std::string> filenames;
   std::string outfile;
-  bool validate = true;
-  spv_target_env env(SPV_ENV_UNIVERSAL_1_0);
+  Options options;
+  unsigned num_threads = std::max(1u, std::thread::hardware_concurrency());
   for (int i = 1; i < argc; ++i) {
     const std::string option(argv[i]);
     if (option == "-h" || option == "--help") {
@@ -56,11 +220,11 @@ int main(const int argc, const char *const argv[]) {
       return 0;
     } else if (option == "--target-env") {
       ++i;
-      if (!spvParseTargetEnv(argv[i], &env)) {
+      if (!spvParseTargetEnv(argv[i], &options.env)) {
         std::cerr << "Error: invalid target env: " << argv[i] << "\n";
         return -1;
       }
-      switch (env) {
+      switch (options.env) {
       case SPV_ENV_UNIVERSAL_1_0:
       case SPV_ENV_UNIVERSAL_1_3:
       case SPV_ENV_UNIVERSAL_1_5:
@@ -76,65 +240,118 @@ int main(const int argc, const char *const argv[]) {
       ++i;
       outfile = std::string(argv[i]);
     } else if (option == "-d") {
-      validate = false;
+      options.validate = false;
+    } else if (option == "--shared-bindings") {
+      options.shared_bindings = true;
+    } else if (option == "--arg-access") {
+      options.arg_access = true;
+    } else if (option == "--decompress") {
+      options.decompress = true;
+    } else if (option == "--manifest") {
+      ++i;
+      std::ifstream manifest(argv[i]);
+      if (!manifest) {
+        std::cerr << "Error: failed to open '" << argv[i] << "'\n";
+        return -1;
+      }
+      std::string line;
+      while (std::getline(manifest, line)) {
+        if (!line.empty() && line.back() == '\r')
+          line.pop_back();
+        if (!line.empty())
+          filenames.push_back(line);
+      }
+    } else if (option == "--format") {
+      ++i;
+      const std::string format(argv[i] ? argv[i] : "");
+      if (format == "text") {
+        options.format = Format::kText;
+      } else if (format == "json") {
+        options.format = Format::kJson;
+      } else {
+        std::cerr << "Error: invalid format: " << format << "\n";
+        return -1;
+      }
+    } else if (option == "-j") {
+      ++i;
+      const int n = argv[i] ? std::atoi(argv[i]) : 0;
+      if (n <= 0) {
+        std::cerr << "Error: invalid number of threads\n";
+        return -1;
+      }
+      num_threads = static_cast<unsigned>(n);
     } else if (option[0] == '-') {
       std::cerr << "Error: unrecognized option '" << argv[i] << "'\n";
       return -1;
     } else {
-      if (!filename.empty()) {
-        std::cerr << "Error: too many positional arguments specified\n";
-        return -1;
-      }
-      filename = std::string(argv[i]);
+      filenames.push_back(option);
     }
   }
 
-  if (filename.empty()) {
+  if (filenames.empty()) {
     std::cerr << "Error: no binary file specified\n";
     return -1;
   }
-
-  // Read the binary.
-  std::ifstream str(filename.c_str(), std::ifstream::in |
-                                          std::ifstream::binary |
-                                          std::ifstream::ate);
-  if (!str) {
-    std::cerr << "Error: failed to open '" << filename << "'\n";
+  if (options.decompress &&
+      (filenames.size() != 1 || options.format != Format::kText)) {
+    std::cerr << "Error: --decompress takes a single binary file and no "
+                 "--format json\n";
     return -1;
   }
-  std::streampos size = str.tellg();
-  std::vector<uint32_t> binary(size / 4, 0);
-  str.seekg(std::ios::beg);
-  str.read(reinterpret_cast<char *>(binary.data()), size);
-  str.close();
 
-  // TODO: worth forwarding some validator options (e.g. layout options)?
-  if (validate) {
-    // The parser assumes valid SPIR-V, so verify that assumption now.
-    spvtools::SpirvTools tools(env);
-    if (!tools.Validate(binary)) {
-      std::cerr << "Error: invalid binary\n";
-      return -1;
-    }
+  std::vector<Module> modules(filenames.size());
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    modules[i].filename = filenames[i];
   }
+  ProcessModules(options, num_threads, &modules);
 
   std::ostream *ostr = &std::cout;
   if (!outfile.empty()) {
-    ostr = new std::ofstream(outfile.c_str());
-    if (!ostr) {
+    ostr = new std::ofstream(
+        outfile.c_str(), options.decompress
+                             ? std::ofstream::out | std::ofstream::binary
+                             : std::ofstream::out);
+    if (!*ostr) {
       std::cerr << "Error: failed to open '" << outfile << "'\n";
       delete ostr;
       return -1;
     }
   }
-  bool ok = clspv::ParseReflection(binary, env, ostr);
+
+  // Write the modules in input order, whatever order they were parsed in.
+  bool ok = true;
+  const char *sep = "";
+  if (options.format == Format::kJson) {
+    *ostr << "{";
+  }
+  for (const auto &module : modules) {
+    if (!module.error.empty()) {
+      std::cerr << "Error: " << module.error << "\n";
+      ok = false;
+      continue;
+    }
+    if (options.format == Format::kJson) {
+      *ostr << sep << "\n";
+      clspv::WriteJsonString(module.filename, ostr);
+      *ostr << ":" << module.output;
+      sep = ",";
+    } else {
+      if (modules.size() > 1) {
+        *ostr << "module," << module.filename << "\n";
+      }
+      *ostr << module.output;
+    }
+  }
+  if (options.format == Format::kJson) {
+    *ostr << "\n}\n";
+  }
+
   if (!outfile.empty()) {
     auto fstr = reinterpret_cast<std::ofstream *>(ostr);
     fstr->close();
     delete fstr;
   }
   if (!ok) {
-    std::cerr << "Error: failed to parse reflection info\n";
     return -1;
   }
 
@@ -0,0 +1,266 @@
+// Copyright 2021 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A persistent compiler process. Requests are read from stdin and responses
+// written to stdout, so the pass registry, the builtin headers and the other
+// process-wide state stay warm between compilations. Each request is compiled
+// with clspv::CompileFromSourceString.
+//
+// Every field is a uint32_t in host byte order.
+//
+// Request:
+//   kRequestMagic, id, options size, sampler map size, source size,
+//   followed by the options, sampler map and source bytes. Requests whose
+//   sizes add up to more than kMaxRequestSize bytes are malformed.
+// Response:
+//   kResponseMagic, id, status, binary size in words, sidecar size in words,
+//   log size in bytes, followed by the SPIR-V binary, the reflection sidecar
+//   (see clspv/ReflectionSidecar.h) and the compilation log.
+//
+// The options of a request are appended to the --options of the server. A
+// status of 0 means success. Responses may come out of order when --threads
+// is more than 1; the id of a response is the id of its request. The server
+// exits once stdin is closed and every request has been answered.
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "clspv/Compiler.h"
+#include "clspv/ReflectionInfo.h"
+#include "clspv/ReflectionSidecar.h"
+
+namespace {
+
+const char *const kUsage =
+    "usage: clspv-server [--threads=N] [--options=<clspv options>]\n"
+    "\n"
+    "Serves compile requests framed on stdin, writing SPIR-V and reflection\n"
+    "to stdout.  See tools/server/main.cpp for the framing.\n";
+
+const uint32_t kRequestMagic = 0x51534c43;  // "CLSQ"
+const uint32_t kResponseMagic = 0x52534c43; // "CLSR"
+
+// The largest request accepted, so that a corrupt frame cannot make the
+// server allocate gigabytes.
+const uint64_t kMaxRequestSize = 64u << 20;
+
+struct ServerOptions {
+  unsigned threads = 1;
+  std::string options;
+};
+
+struct Request {
+  uint32_t id = 0;
+  std::string options;
+  std::string sampler_map;
+  std::string source;
+};
+
+bool ParseArguments(int argc, const char *const argv[], ServerOptions *opts) {
+  for (int i = 1; i < argc; ++i) {
+    llvm::StringRef arg(argv[i]);
+    if (arg.consume_front("--threads=")) {
+      if (arg.getAsInteger(10, opts->threads))
+        return false;
+    } else if (arg.consume_front("--options=")) {
+      opts->options = arg.str();
+    } else {
+      return false;
+    }
+  }
+  if (opts->threads == 0) {
+    opts->threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  return true;
+}
+
+bool ReadString(FILE *in, uint32_t size, std::string *str) {
+  str->resize(size);
+  return size == 0 || std::fread(&(*str)[0], 1, size, in) == size;
+}
+
+enum class ReadStatus { kRequest, kEnd, kError };
+
+ReadStatus ReadRequest(FILE *in, Request *request) {
+  uint32_t header[5];
+  const size_t read = std::fread(header, 1, sizeof(header), in);
+  if (read == 0 && std::feof(in))
+    return ReadStatus::kEnd;
+  if (read != sizeof(header) || header[0] != kRequestMagic)
+    return ReadStatus::kError;
+
+  request->id = header[1];
+  if (uint64_t(header[2]) + header[3] + header[4] > kMaxRequestSize)
+    return ReadStatus::kError;
+  if (!ReadString(in, header[2], &request->options) ||
+      !ReadString(in, header[3], &request->sampler_map) ||
+      !ReadString(in, header[4], &request->source))
+    return ReadStatus::kError;
+  return ReadStatus::kRequest;
+}
+
+class Server {
+public:
+  Server(const ServerOptions &opts, FILE *out) : opts_(opts), out_(out) {}
+
+  // Reads and answers requests from |in| until it is closed. Returns false if
+  // a malformed request was read.
+  bool Run(FILE *in) {
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < opts_.threads; ++i) {
+      workers.emplace_back([this]() { Work(); });
+    }
+
+    ReadStatus status;
+    for (;;) {
+      Request request;
+      status = ReadRequest(in, &request);
+      if (status != ReadStatus::kRequest)
+        break;
+      std::lock_guard<std::mutex> lock(queue_mutex_);
+      queue_.push_back(std::move(request));
+      queue_cv_.notify_one();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex_);
+      done_ = true;
+      queue_cv_.notify_all();
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+
+    if (status == ReadStatus::kError) {
+      llvm::errs() << "error: malformed request\n";
+      return false;
+    }
+    return true;
+  }
+
+private:
+  void Work() {
+    for (;;) {
+      Request request;
+      {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        queue_cv_.wait(lock, [this]() { return done_ || !queue_.empty(); });
+        if (queue_.empty())
+          return;
+        request = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      Compile(request);
+    }
+  }
+
+  void Compile(const Request &request) {
+    std::vector<uint32_t> binary;
+    std::string log;
+    const int status = clspv::CompileFromSourceString(
+        request.source, request.sampler_map,
+        opts_.options + " " + request.options, &binary, &log);
+
+    std::vector<uint32_t> sidecar;
+    clspv::reflection::ReflectionInfo info;
+    if (status == 0 && clspv::reflection::ParseReflectionInfo(
+                           binary.data(), binary.size(), &info)) {
+      clspv::reflection::WriteSidecar(info, &sidecar);
+    }
+
+    const uint32_t header[6] = {kResponseMagic,
+                                request.id,
+                                static_cast<uint32_t>(status),
+                                static_cast<uint32_t>(binary.size()),
+                                static_cast<uint32_t>(sidecar.size()),
+                                static_cast<uint32_t>(log.size())};
+    std::lock_guard<std::mutex> lock(out_mutex_);
+    std::fwrite(header, sizeof(header), 1, out_);
+    std::fwrite(binary.data(), sizeof(uint32_t), binary.size(), out_);
+    std::fwrite(sidecar.data(), sizeof(uint32_t), sidecar.size(), out_);
+    std::fwrite(log.data(), 1, log.size(), out_);
+    std::fflush(out_);
+  }
+
+  const ServerOptions &opts_;
+  FILE *out_;
+
+  std::mutex queue_mutex_;
+  std::condition_variable queue_cv_;
+  std::deque<Request> queue_;
+  bool done_ = false;
+
+  std::mutex out_mutex_;
+};
+
+// Returns a stream on the original stdout for the responses, and points
+// stdout at stderr so that messages printed by the compiler cannot corrupt
+// them.
+FILE *TakeStdout() {
+  std::fflush(stdout);
+#if defined(_WIN32)
+  const int fd = _dup(_fileno(stdout));
+  if (fd < 0)
+    return nullptr;
+  _dup2(_fileno(stderr), _fileno(stdout));
+  _setmode(fd, _O_BINARY);
+  return _fdopen(fd, "wb");
+#else
+  const int fd = dup(STDOUT_FILENO);
+  if (fd < 0)
+    return nullptr;
+  dup2(STDERR_FILENO, STDOUT_FILENO);
+  return fdopen(fd, "wb");
+#endif
+}
+
+} // namespace
+
+int main(const int argc, const char *const argv[]) {
+  ServerOptions opts;
+  if (!ParseArguments(argc, argv, &opts)) {
+    llvm::errs() << kUsage;
+    return 1;
+  }
+
+  llvm::sys::ChangeStdinToBinary();
+  FILE *out = TakeStdout();
+  if (!out) {
+    llvm::errs() << "error: unable to open the response stream\n";
+    return 1;
+  }
+
+  Server server(opts, out);
+  const bool ok = server.Run(stdin);
+  std::fclose(out);
+  return ok ? 0 : 1;
+}